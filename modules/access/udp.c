@@ -49,6 +49,9 @@
 #ifdef HAVE_SYS_UIO_H
 # include <sys/uio.h>
 #endif
+#ifdef HAVE_RECVMMSG
+# include <sys/socket.h>
+#endif
 
 /*****************************************************************************
  * Module descriptor
@@ -59,6 +62,12 @@ static void Close( vlc_object_t * );
 #define BUFFER_TEXT N_("Receive buffer")
 #define BUFFER_LONGTEXT N_("UDP receive buffer size (bytes)" )
 #define TIMEOUT_TEXT N_("UDP Source timeout (sec)")
+#define BATCH_TEXT N_("Datagrams per receive call")
+#define BATCH_LONGTEXT N_("Receive up to this many queued datagrams with a single system call " \
+                          "(1 receives one datagram at a time).")
+
+#define UDP_BATCH_DEFAULT 32
+#define UDP_BATCH_MAX     1024
 
 vlc_module_begin ()
     set_shortname( N_("UDP" ) )
@@ -69,6 +78,8 @@ vlc_module_begin ()
     add_obsolete_integer( "server-port" ) /* since 2.0.0 */
     add_obsolete_integer( "udp-buffer" ) /* since 3.0.0 */
     add_integer( "udp-timeout", -1, TIMEOUT_TEXT, NULL, true )
+    add_integer( "udp-batch", UDP_BATCH_DEFAULT, BATCH_TEXT, BATCH_LONGTEXT, true )
+        change_integer_range( 1, UDP_BATCH_MAX )
 
     set_capability( "access", 0 )
     add_shortcut( "udp", "udpstream", "udp4", "udp6" )
@@ -76,12 +87,41 @@ vlc_module_begin ()
     set_callbacks( Open, Close )
 vlc_module_end ()
 
+/* ancillary data received with each datagram */
+#if defined(SO_TIMESTAMPNS) && defined(SO_RXQ_OVFL)
+# define UDP_CONTROL_SIZE (CMSG_SPACE(sizeof (struct timespec)) + \
+                           CMSG_SPACE(sizeof (uint32_t)))
+#elif defined(SO_TIMESTAMPNS)
+# define UDP_CONTROL_SIZE CMSG_SPACE(sizeof (struct timespec))
+#else
+# define UDP_CONTROL_SIZE sizeof (max_align_t)
+#endif
+
+typedef union
+{
+    char buf[UDP_CONTROL_SIZE];
+    max_align_t align;
+} udp_control_t;
+
 typedef struct
 {
     int fd;
     int timeout;
     size_t mtu;
     block_t *overflow_block;
+    /* SO_RXQ_OVFL: datagrams the kernel dropped on this socket so far */
+    uint32_t drops;
+#ifdef HAVE_RECVMMSG
+    /* recvmmsg() batch: slots are allocated ahead of the call, received
+     * datagrams are then handed out one per BlockUDP() call */
+    unsigned batch;
+    unsigned batch_next;
+    unsigned batch_count;
+    block_t **batch_blocks;
+    struct mmsghdr *batch_msgs;
+    struct iovec *batch_iov;
+    udp_control_t *batch_control;
+#endif
 } access_sys_t;
 
 /*****************************************************************************
@@ -183,6 +223,37 @@ static int Open( vlc_object_t *p_this )
     if( sys->timeout > 0)
         sys->timeout *= 1000;
 
+#ifdef SO_TIMESTAMPNS
+    /* kernel arrival time, see ParseAncillary() */
+    if( setsockopt( sys->fd, SOL_SOCKET, SO_TIMESTAMPNS, &(int){ 1 },
+                    sizeof (int) ) )
+        msg_Dbg( p_access, "kernel receive timestamps unavailable" );
+#endif
+    sys->drops = 0;
+#ifdef SO_RXQ_OVFL
+    if( setsockopt( sys->fd, SOL_SOCKET, SO_RXQ_OVFL, &(int){ 1 },
+                    sizeof (int) ) )
+        msg_Dbg( p_access, "socket drop counter unavailable" );
+#endif
+
+#ifdef HAVE_RECVMMSG
+    sys->batch = var_InheritInteger( p_access, "udp-batch" );
+    sys->batch_next = sys->batch_count = 0;
+    if( sys->batch > 1 )
+    {
+        sys->batch_blocks = vlc_obj_calloc( p_this, sys->batch, sizeof (block_t *) );
+        sys->batch_msgs = vlc_obj_calloc( p_this, sys->batch, sizeof (struct mmsghdr) );
+        sys->batch_iov = vlc_obj_calloc( p_this, sys->batch, sizeof (struct iovec) );
+        sys->batch_control = vlc_obj_calloc( p_this, sys->batch, sizeof (udp_control_t) );
+        if( unlikely( sys->batch_blocks == NULL || sys->batch_msgs == NULL ||
+                      sys->batch_iov == NULL || sys->batch_control == NULL ) )
+        {
+            net_Close( sys->fd );
+            return VLC_ENOMEM;
+        }
+    }
+#endif
+
     return VLC_SUCCESS;
 }
 
@@ -196,6 +267,12 @@ static void Close( vlc_object_t *p_this )
     if( sys->overflow_block )
         block_Release( sys->overflow_block );
 
+#ifdef HAVE_RECVMMSG
+    for( unsigned i = 0; i < sys->batch && sys->batch_blocks != NULL; i++ )
+        if( sys->batch_blocks[i] != NULL )
+            block_Release( sys->batch_blocks[i] );
+#endif
+
     net_Close( sys->fd );
 }
 
@@ -222,12 +299,181 @@ static int Control( stream_t *p_access, int i_query, va_list args )
                 VLC_TICK_FROM_MS(var_InheritInteger(p_access, "network-caching"));
             break;
 
+#ifdef SO_RXQ_OVFL
+        case STREAM_GET_RECV_DROPS:
+        {
+            access_sys_t *sys = p_access->p_sys;
+            *va_arg( args, uint64_t * ) = sys->drops;
+            break;
+        }
+#endif
+
         default:
             return VLC_EGENERIC;
     }
     return VLC_SUCCESS;
 }
 
+/*****************************************************************************
+ * ParseAncillary: arrival time (vlc_tick_now() timebase) and drop counter
+ *****************************************************************************
+ * SO_TIMESTAMPNS stamps datagrams against the real-time clock as they are
+ * queued on the socket, so the time spent waiting in the socket buffer and
+ * in userspace does not show up as network jitter.
+ *
+ * SO_RXQ_OVFL reports, with each datagram, how many the kernel has dropped
+ * on this socket so far because the receive buffer was full.
+ *****************************************************************************/
+static vlc_tick_t ParseAncillary( access_sys_t *sys, struct msghdr *msg,
+                                  vlc_tick_t now, vlc_tick_t wall_now )
+{
+    vlc_tick_t arrival = now;
+
+#if defined(SO_TIMESTAMPNS) || defined(SO_RXQ_OVFL)
+    for( struct cmsghdr *cmsg = CMSG_FIRSTHDR( msg ); cmsg != NULL;
+         cmsg = CMSG_NXTHDR( msg, cmsg ) )
+    {
+        if( cmsg->cmsg_level != SOL_SOCKET )
+            continue;
+# ifdef SO_TIMESTAMPNS
+        if( cmsg->cmsg_type == SCM_TIMESTAMPNS )
+        {
+            struct timespec ts;
+            memcpy( &ts, CMSG_DATA( cmsg ), sizeof (ts) );
+
+            vlc_tick_t age = wall_now - vlc_tick_from_timespec( &ts );
+            /* the real-time clock stepped, the receive time is the best we have */
+            if( age >= 0 )
+                arrival = now - age;
+        }
+# endif
+# ifdef SO_RXQ_OVFL
+        if( cmsg->cmsg_type == SO_RXQ_OVFL )
+            memcpy( &sys->drops, CMSG_DATA( cmsg ), sizeof (sys->drops) );
+# endif
+    }
+#else
+    VLC_UNUSED( sys ); VLC_UNUSED( msg ); VLC_UNUSED( wall_now );
+#endif
+    return arrival;
+}
+
+static vlc_tick_t WallClock( void )
+{
+    struct timespec ts;
+
+    timespec_get( &ts, TIME_UTC );
+    return vlc_tick_from_timespec( &ts );
+}
+
+#ifdef HAVE_RECVMMSG
+static block_t *BatchDequeue(access_sys_t *sys)
+{
+    while (sys->batch_next < sys->batch_count)
+    {
+        block_t *pkt = sys->batch_blocks[sys->batch_next];
+
+        sys->batch_blocks[sys->batch_next++] = NULL;
+        if (pkt != NULL)
+            return pkt;
+    }
+    return NULL;
+}
+
+/*****************************************************************************
+ * BlockUDPBatch: one recvmmsg() for every datagram already queued
+ *****************************************************************************/
+static block_t *BlockUDPBatch(stream_t *access, bool *restrict eof)
+{
+    access_sys_t *sys = access->p_sys;
+
+    block_t *pkt = BatchDequeue(sys);
+    if (pkt != NULL)
+        return pkt;
+
+    /* refill the slots handed out since the last call */
+    unsigned vlen = 0;
+    while (vlen < sys->batch)
+    {
+        block_t *pkt = sys->batch_blocks[vlen];
+        if (pkt == NULL)
+        {
+            pkt = block_Alloc(sys->mtu);
+            if (unlikely(pkt == NULL))
+                break;
+            sys->batch_blocks[vlen] = pkt;
+        }
+
+        sys->batch_iov[vlen].iov_base = pkt->p_buffer;
+        sys->batch_iov[vlen].iov_len = pkt->i_buffer;
+        sys->batch_msgs[vlen].msg_hdr = (struct msghdr) {
+            .msg_iov = &sys->batch_iov[vlen],
+            .msg_iovlen = 1,
+            .msg_control = sys->batch_control[vlen].buf,
+            .msg_controllen = sizeof (sys->batch_control[vlen].buf),
+        };
+        vlen++;
+    }
+
+    if (unlikely(vlen == 0))
+    {   /* OOM - dequeue and discard one packet */
+        char dummy;
+        recv(sys->fd, &dummy, 1, 0);
+        return NULL;
+    }
+
+    struct pollfd ufd[1];
+
+    ufd[0].fd = sys->fd;
+    ufd[0].events = POLLIN;
+
+    switch (vlc_poll_i11e(ufd, 1, sys->timeout))
+    {
+        case 0:
+            msg_Err(access, "receive time-out");
+            *eof = true;
+            /* fall through */
+        case -1:
+            return NULL;
+    }
+
+    /* MSG_TRUNC: msg_len is the full datagram size even if it did not fit */
+    int count = recvmmsg(sys->fd, sys->batch_msgs, vlen,
+                         MSG_DONTWAIT | MSG_TRUNC, NULL);
+    if (count <= 0)
+        return NULL;
+
+    vlc_tick_t now = vlc_tick_now();
+    vlc_tick_t wall_now = WallClock();
+
+    for (int i = 0; i < count; i++)
+    {
+        block_t *pkt = sys->batch_blocks[i];
+        size_t len = sys->batch_msgs[i].msg_len;
+
+        if (unlikely(len > pkt->i_buffer))
+        {   /* unlike recvmsg() there is no overflow block per slot,
+             * drop it and size the next slots for it */
+            msg_Warn(access, "%zu bytes packet received (MTU was %zu), "
+                     "dropping it and adjusting mtu", len, pkt->i_buffer);
+            if (len > sys->mtu)
+                sys->mtu = len;
+            block_Release(pkt);
+            sys->batch_blocks[i] = NULL;
+            continue;
+        }
+
+        pkt->i_buffer = len;
+        pkt->i_dts = ParseAncillary(sys, &sys->batch_msgs[i].msg_hdr, now, wall_now);
+    }
+
+    sys->batch_next = 0;
+    sys->batch_count = count;
+
+    return BatchDequeue(sys);
+}
+#endif
+
 /*****************************************************************************
  * BlockUDP:
  *****************************************************************************/
@@ -235,7 +481,10 @@ static block_t *BlockUDP(stream_t *access, bool *restrict eof)
 {
     access_sys_t *sys = access->p_sys;
 
-    msg_Dbg(access, "udp:: enterBlockUDP");
+#ifdef HAVE_RECVMMSG
+    if (sys->batch > 1)
+        return BlockUDPBatch(access, eof);
+#endif
 
     block_t *pkt = block_Alloc(sys->mtu);
     if (unlikely(pkt == NULL))
@@ -253,9 +502,12 @@ static block_t *BlockUDP(stream_t *access, bool *restrict eof)
         .iov_base = sys->overflow_block->p_buffer,
         .iov_len = sys->overflow_block->i_buffer,
     }};
+    udp_control_t control;
     struct msghdr msg = {
         .msg_iov = iov,
         .msg_iovlen = 2,
+        .msg_control = control.buf,
+        .msg_controllen = sizeof (control.buf),
     };
 
     struct pollfd ufd[1];
@@ -300,11 +552,9 @@ skip:
 
         sys->mtu = len;
     }
-    else {
+    else
         pkt->i_buffer = len;
 
-        msg_Dbg(access, "udp:: recv packet raw size of: %d", len);
-
-    }
+    pkt->i_dts = ParseAncillary(sys, &msg, vlc_tick_now(), WallClock());
     return pkt;
 }
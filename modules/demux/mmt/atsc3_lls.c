@@ -9,32 +9,23 @@
 #include "xml.h"
 
 static lls_table_t* __lls_create_base_table_raw(uint8_t* lls, int size) {
+	if(size <= 4) {
+		_LLS_ERROR("__lls_create_base_table_raw: LLS table too short, size: %d", size);
+		return NULL;
+	}
 
 	//zero out full struct
 	lls_table_t *base_table = calloc(1, sizeof(lls_table_t));
+	if(!base_table) {
+		return NULL;
+	}
 
-	//read first 32 bytes in
+	//read first 32 bits in
 	base_table->lls_table_id = lls[0];
 	base_table->lls_group_id = lls[1];
 	base_table->group_count_minus1 = lls[2];
 	base_table->lls_table_version = lls[3];
 
-	int remaining_payload_size = (size > 65531) ? 65531 : size;
-
-	uint8_t *temp_gzip_payload = calloc(size, sizeof(uint8_t));
-	//FILE *f = fopen("slt.gz", "w");
-
-	for(int i=4; i < remaining_payload_size; i++) {
-		//printf("i:0x%x ", lls[i]);
-		//fwrite(&lls[i], 1, 1, f);
-		temp_gzip_payload[i-4] = lls[i];
-	}
-	base_table->raw_xml.xml_payload_compressed = temp_gzip_payload;
-	base_table->raw_xml.xml_payload_compressed_size = remaining_payload_size - 4;
-
-
-	//printf("first 4 hex: 0x%x 0x%x 0x%x 0x%x", temp_gzip_payload[0], temp_gzip_payload[1], temp_gzip_payload[2], temp_gzip_payload[3]);
-
 	return base_table;
 }
 
@@ -45,150 +36,195 @@ static lls_table_t* __lls_create_base_table_raw(uint8_t* lls, int size) {
  * The maximum UDP data payload is 65,535 minus 20 bytes for the IP header minus 8 bytes for the UDP header.
  */
 
-#define GZIP_CHUNK_INPUT_SIZE_MAX 65507
-#define GZIP_CHUNK_INPUT_READ_SIZE 1024
-#define GZIP_CHUNK_OUTPUT_BUFFER_SIZE 1024*8
+#define GZIP_MIN_OUTPUT_SIZE 4096
 
-int __unzip_gzip_payload(uint8_t *input_payload, uint input_payload_size, uint8_t **decompressed_payload) {
-
-	if(input_payload_size > GZIP_CHUNK_INPUT_SIZE_MAX) return -1;
-
-	uint input_payload_offset = 0;
-	uint output_payload_offset = 0;
-    unsigned char *output_payload = NULL;
-
-    int ret;
-    unsigned have;
-    z_stream strm;
-
-    uint8_t *decompressed;
-
-    strm.zalloc = Z_NULL;
-	strm.zfree = Z_NULL;
-	strm.opaque = Z_NULL;
-	strm.avail_in = 0;
-	strm.next_in = Z_NULL;
-	strm.data_type = Z_TEXT;
+void lls_inflate_context_init(lls_inflate_context_t* lls_inflate_context) {
+	memset(lls_inflate_context, 0, sizeof(lls_inflate_context_t));
+}
 
-	//treat this input_payload as gzip not just delfate
-	ret = inflateInit2(&strm, 16+MAX_WBITS);
+//ISIZE, the uncompressed size mod 2^32 from the gzip trailer
+static size_t __gzip_isize(const uint8_t* gzip_payload, size_t gzip_payload_size) {
+	if(gzip_payload_size < 18) {
+		return 0;
+	}
+	const uint8_t* trailer = &gzip_payload[gzip_payload_size - 4];
+	return (size_t)trailer[0] | (size_t)trailer[1] << 8 | (size_t)trailer[2] << 16 | (size_t)trailer[3] << 24;
+}
 
-	if (ret != Z_OK)
-	   return ret;
+//room for size payload bytes and the NUL terminator
+static int __lls_inflate_reserve(lls_inflate_context_t* lls_inflate_context, size_t size) {
+	if(size > LLS_INFLATE_OUTPUT_MAX) {
+		size = LLS_INFLATE_OUTPUT_MAX;
+	}
+	if(lls_inflate_context->buffer_size >= size + 1) {
+		return 0;
+	}
+	uint8_t* buffer = realloc(lls_inflate_context->buffer, size + 1);
+	if(!buffer) {
+		return -1;
+	}
+	lls_inflate_context->buffer = buffer;
+	lls_inflate_context->buffer_size = size + 1;
+	return 0;
+}
 
-	do {
+int lls_inflate(lls_inflate_context_t* lls_inflate_context, const uint8_t* gzip_payload, size_t gzip_payload_size, uint8_t** payload) {
+	z_stream* strm = &lls_inflate_context->strm;
+	int ret;
+
+	//treat this input_payload as gzip not just deflate, the stream is set up once and reset per table
+	if(!lls_inflate_context->strm_initialized) {
+		strm->zalloc = Z_NULL;
+		strm->zfree = Z_NULL;
+		strm->opaque = Z_NULL;
+		strm->avail_in = 0;
+		strm->next_in = Z_NULL;
+		ret = inflateInit2(strm, 16 + MAX_WBITS);
+		if(ret != Z_OK) {
+			return ret;
+		}
+		lls_inflate_context->strm_initialized = true;
+	} else if((ret = inflateReset(strm)) != Z_OK) {
+		return ret;
+	}
 
-		strm.next_in = &input_payload[input_payload_offset];
+	//the trailer says how much to expect, zlib checks it against the payload at the end of the member
+	size_t isize = __gzip_isize(gzip_payload, gzip_payload_size);
+	if(__lls_inflate_reserve(lls_inflate_context, isize ? isize : gzip_payload_size * 4)) {
+		return Z_MEM_ERROR;
+	}
 
-		uint payload_chunk_size = input_payload_size - input_payload_offset > GZIP_CHUNK_INPUT_READ_SIZE ? GZIP_CHUNK_INPUT_READ_SIZE : input_payload_size - input_payload_offset;
-		strm.avail_in = payload_chunk_size;
+	strm->next_in = (Bytef*)gzip_payload;
+	strm->avail_in = gzip_payload_size;
+	strm->next_out = lls_inflate_context->buffer;
+	strm->avail_out = lls_inflate_context->buffer_size - 1;
 
-		if (strm.avail_in <= 0)
+	for(;;) {
+		ret = inflate(strm, Z_NO_FLUSH);
+		if(ret == Z_STREAM_END) {
 			break;
+		}
+		if(ret != Z_OK && ret != Z_BUF_ERROR) {
+			return ret == Z_NEED_DICT ? Z_DATA_ERROR : ret;
+		}
 
-		do {
-			if(!output_payload) {
-				output_payload = calloc(GZIP_CHUNK_OUTPUT_BUFFER_SIZE + 1, sizeof(uint8_t));
-			} else {
-				output_payload = realloc(output_payload, output_payload_offset + GZIP_CHUNK_OUTPUT_BUFFER_SIZE + 1);
-			}
-
-			if(!output_payload)
-				return -1;
-
-			strm.avail_out = GZIP_CHUNK_OUTPUT_BUFFER_SIZE;
-			strm.next_out = &output_payload[output_payload_offset];
-
-			ret = inflate(&strm, Z_NO_FLUSH);
-
-			//assert(ret != Z_STREAM_ERROR);  /* state not clobbered */
-			switch (ret) {
-				case Z_NEED_DICT:
-					ret = Z_DATA_ERROR;     /* and fall through */
-				case Z_DATA_ERROR:
-				case Z_MEM_ERROR:
-					(void)inflateEnd(&strm);
-				return ret;
-			}
-
-			if(strm.avail_out == 0) {
-				output_payload_offset += GZIP_CHUNK_OUTPUT_BUFFER_SIZE;
-			}
-		} while (strm.avail_out == 0);
-
-		input_payload_offset += GZIP_CHUNK_INPUT_READ_SIZE;
-
-	} while (ret != Z_STREAM_END && input_payload_offset < input_payload_size);
+		if(strm->avail_out) {
+			//all input used without reaching the end of the member
+			_LLS_ERROR("lls_inflate: truncated gzip payload, size: %zu, inflated: %lu", gzip_payload_size, strm->total_out);
+			return Z_DATA_ERROR;
+		}
 
+		size_t used = strm->total_out;
+		if(used >= LLS_INFLATE_OUTPUT_MAX || __lls_inflate_reserve(lls_inflate_context, used ? used * 2 : GZIP_MIN_OUTPUT_SIZE)) {
+			_LLS_ERROR("lls_inflate: payload inflates past %d bytes", LLS_INFLATE_OUTPUT_MAX);
+			return Z_MEM_ERROR;
+		}
+		strm->next_out = &lls_inflate_context->buffer[used];
+		strm->avail_out = lls_inflate_context->buffer_size - 1 - used;
+	}
 
-	int paylod_len = (output_payload_offset + (GZIP_CHUNK_OUTPUT_BUFFER_SIZE - strm.avail_out));
-	/* clean up and return */
-	output_payload[paylod_len] = '\0';
-	*decompressed_payload = output_payload;
+	lls_inflate_context->buffer[strm->total_out] = '\0';
+	*payload = lls_inflate_context->buffer;
+	return (int)strm->total_out;
+}
 
-	(void)inflateEnd(&strm);
-	return ret == Z_STREAM_END ?  paylod_len : Z_DATA_ERROR;
+void lls_inflate_context_free(lls_inflate_context_t* lls_inflate_context) {
+	if(lls_inflate_context->strm_initialized) {
+		(void)inflateEnd(&lls_inflate_context->strm);
+	}
+	freesafe(lls_inflate_context->buffer);
+	lls_inflate_context_init(lls_inflate_context);
+}
 
+int __unzip_gzip_payload(uint8_t *input_payload, uint input_payload_size, uint8_t **decompressed_payload) {
+	lls_inflate_context_t lls_inflate_context;
+	lls_inflate_context_init(&lls_inflate_context);
+
+	uint8_t* payload;
+	int ret = lls_inflate(&lls_inflate_context, input_payload, input_payload_size, &payload);
+	if(ret >= 0) {
+		//hand the buffer over to the caller
+		*decompressed_payload = payload;
+		lls_inflate_context.buffer = NULL;
+	}
+	lls_inflate_context_free(&lls_inflate_context);
+	return ret;
 }
 
-lls_table_t* lls_create_xml_table( uint8_t* lls_packet, int size) {
+//payload is the inflated xml, still owned by the inflate context
+static lls_table_t* __lls_create_xml_table(lls_inflate_context_t* lls_inflate_context, uint8_t* lls_packet, int size, uint8_t** payload, int* payload_size) {
 	lls_table_t *lls_table = __lls_create_base_table_raw(lls_packet, size);
+	if(!lls_table) {
+		return NULL;
+	}
 
-	uint8_t *decompressed_payload;
-	int ret = __unzip_gzip_payload(lls_table->raw_xml.xml_payload_compressed, lls_table->raw_xml.xml_payload_compressed_size, &decompressed_payload);
+	*payload_size = lls_inflate(lls_inflate_context, &lls_packet[4], size - 4, payload);
+	if(*payload_size <= 0) {
+		lls_table_free(lls_table);
+		return NULL;
+	}
+	return lls_table;
+}
 
-	if(ret > 0) {
-		lls_table->raw_xml.xml_payload = decompressed_payload;
-		lls_table->raw_xml.xml_payload_size = ret;
+//copy the xml over to the table, it is only kept for dumps
+static int __lls_table_keep_xml(lls_table_t* lls_table, const uint8_t* payload, int payload_size) {
+	lls_table->raw_xml.xml_payload = malloc(payload_size + 1);
+	if(!lls_table->raw_xml.xml_payload) {
+		return -1;
+	}
+	memcpy(lls_table->raw_xml.xml_payload, payload, payload_size + 1);
+	lls_table->raw_xml.xml_payload_size = payload_size;
+	return 0;
+}
 
-		return lls_table;
+lls_table_t* lls_create_xml_table( uint8_t* lls_packet, int size) {
+	lls_inflate_context_t lls_inflate_context;
+	lls_inflate_context_init(&lls_inflate_context);
+
+	uint8_t* payload;
+	int payload_size;
+	lls_table_t* lls_table = __lls_create_xml_table(&lls_inflate_context, lls_packet, size, &payload, &payload_size);
+	if(lls_table && __lls_table_keep_xml(lls_table, payload, payload_size)) {
+		lls_table_free(lls_table);
+		lls_table = NULL;
 	}
 
-	return NULL;
+	lls_inflate_context_free(&lls_inflate_context);
+	return lls_table;
 }
 
-lls_table_t* lls_table_create( uint8_t* lls_packet, int size) {
-	int res = 0;
-	xml_document_t* xml_document = NULL;
-	xml_node_t* xml_root_node = NULL;
-
-	lls_table_t* lls_table = lls_create_xml_table(lls_packet, size);
+lls_table_t* lls_table_create_with_inflate_context(lls_inflate_context_t* lls_inflate_context, uint8_t* lls_packet, int size) {
+	uint8_t* payload;
+	int payload_size;
+	lls_table_t* lls_table = __lls_create_xml_table(lls_inflate_context, lls_packet, size, &payload, &payload_size);
 
 	if(!lls_table) {
 		_LLS_ERROR("lls_create_table - error creating instance of LLS table and subclass");
 		return NULL;
 	}
 
-	//create the xml document payload
-	_LLS_TRACE("lls_create_table, raw xml payload is: \n%s", lls_table->raw_xml.xml_payload);
-	xml_document = xml_payload_document_parse(lls_table->raw_xml.xml_payload, lls_table->raw_xml.xml_payload_size);
-
-	//extract the root node
-	xml_root_node = xml_payload_document_extract_root_node(xml_document);
-	if(!xml_root_node)
-			goto cleanup;
-
-	_LLS_TRACE("lls_create_table: calling lls_create_table_type_instance with xml children count: %d\n", xml_node_children(xml_root));
+	_LLS_TRACE("lls_create_table, raw xml payload is: \n%s", payload);
 
-	res = lls_create_table_type_instance(lls_table, xml_root_node);
+	//the table is built straight from the inflate buffer, no document tree
+	atsc3_xml_pull_t xml_pull;
+	atsc3_xml_pull_init(&xml_pull, payload, payload_size);
 
-	if(res) {
-		//unable to instantiate lls_table, set lls_table ptr to null
-		//TODO free our lls_xml_table
+	if(lls_create_table_type_instance(lls_table, &xml_pull) || __lls_table_keep_xml(lls_table, payload, payload_size)) {
 		_LLS_ERROR("lls_table_create: Unable to instantiate lls_table!");
-		lls_table = NULL;
-		goto cleanup;
+		lls_table_free(lls_table);
+		return NULL;
 	}
 
-cleanup:
+	return lls_table;
+}
 
+lls_table_t* lls_table_create( uint8_t* lls_packet, int size) {
+	lls_inflate_context_t lls_inflate_context;
+	lls_inflate_context_init(&lls_inflate_context);
 
-	if(xml_document) {
-		//xml_document_free will release the root node for us... but keep the ra
-		xml_document_free(xml_document, false);
-		xml_document = NULL;
-	}
+	lls_table_t* lls_table = lls_table_create_with_inflate_context(&lls_inflate_context, lls_packet, size);
 
+	lls_inflate_context_free(&lls_inflate_context);
 	return lls_table;
 }
 
@@ -239,10 +275,6 @@ void lls_table_free(lls_table_t* lls_table) {
 	//free any cloned xmlstrings
 
 	//free global table object
-	if(lls_table->raw_xml.xml_payload_compressed) {
-		free(lls_table->raw_xml.xml_payload_compressed);
-		lls_table->raw_xml.xml_payload_compressed = NULL;
-	}
 	if(lls_table->raw_xml.xml_payload) {
 		free(lls_table->raw_xml.xml_payload);
 		lls_table->raw_xml.xml_payload = NULL;
@@ -284,23 +316,25 @@ xml_node_t* xml_payload_document_extract_root_node(xml_document_t* document) {
 	return root;
 }
 
-//caller must free xml_root
-int lls_create_table_type_instance(lls_table_t* lls_table, xml_node_t* xml_root) {
+int lls_create_table_type_instance(lls_table_t* lls_table, atsc3_xml_pull_t* xml_pull) {
+	atsc3_xml_pull_event_t event;
+	while((event = atsc3_xml_pull_next(xml_pull)) == ATSC3_XML_PULL_TEXT);
 
-	xml_string_t* root_node_name = xml_node_name(xml_root); //root
-
-	uint8_t* node_name = xml_string_clone(root_node_name);
-	_LLS_TRACE("lls_create_table_type_instance: lls_table_id: %d, node ptr: %p, name is: %s", lls_table->lls_table_id, root_node_name, node_name);
+	if(event != ATSC3_XML_PULL_START) {
+		_LLS_ERROR("lls_create_table_type_instance: no root element, lls_table_id: %d", lls_table->lls_table_id);
+		return -1;
+	}
+	_LLS_TRACE("lls_create_table_type_instance: lls_table_id: %d, root element: %.*s", lls_table->lls_table_id, (int)xml_pull->name.len, xml_pull->name.p);
 
 	int ret = -1;
 	if(lls_table->lls_table_id == SLT) {
 		//build SLT table
-		ret = build_SLT_table(lls_table, xml_root);
+		ret = build_SLT_table(lls_table, xml_pull);
 
 	} else if(lls_table->lls_table_id == RRT) {
 		_LLS_ERROR("lls_create_table_type_instance: LLS table RRT not supported yet");
 	} else if(lls_table->lls_table_id == SystemTime) {
-		ret = build_SystemTime_table(lls_table, xml_root);
+		ret = build_SystemTime_table(lls_table, xml_pull);
 	} else if(lls_table->lls_table_id == AEAT) {
 		_LLS_ERROR("lls_create_table_type_instance: LLS table AEAT not supported yet");
 	} else if(lls_table->lls_table_id == OnscreenMessageNotification) {
@@ -309,237 +343,171 @@ int lls_create_table_type_instance(lls_table_t* lls_table, xml_node_t* xml_root)
 		_LLS_ERROR("lls_create_table_type_instance: Unknown LLS table type: %d",  lls_table->lls_table_id);
 
 	}
-	_LLS_DEBUG("lls_create_table_type_instance: returning ret: %d, lls_table_id: %d, node ptr: %p, name is: %s", ret, lls_table->lls_table_id, root_node_name, node_name);
-
-	freesafe(node_name);
 
 	return ret;
 }
 
+static bool __lls_attribute_int(atsc3_xml_pull_t* xml_pull, const char* name, int* value) {
+	atsc3_xml_view_t view;
+	return atsc3_xml_pull_attribute(xml_pull, name, &view) && atsc3_xml_view_to_int(view, value);
+}
+
+static char* __lls_attribute_strdup(atsc3_xml_pull_t* xml_pull, const char* name) {
+	atsc3_xml_view_t view;
+	return atsc3_xml_pull_attribute(xml_pull, name, &view) ? atsc3_xml_view_strdup(view) : NULL;
+}
+
+#define LLS_SLT_SERVICE						"Service"
 #define LLS_SLT_SIMULCAST_TSID 				"SimulcastTSID"
 #define LLS_SLT_SVC_CAPABILITIES			"SvcCapabilities"
 #define LLS_SLT_BROADCAST_SVC_SIGNALING 	"BroadcastSvcSignaling"
 #define LLS_SLT_SVC_INET_URL				"SvcInetUrl"
 #define LLS_SLT_OTHER_BSID					"OtherBsid"
 
-int build_SLT_table(lls_table_t *lls_table, xml_node_t *xml_root) {
-	/** bsid **/
-
-	xml_string_t* root_node_name = xml_node_name(xml_root); //root
-	dump_xml_string(root_node_name);
-
-	uint8_t* slt_attributes = xml_attributes_clone(root_node_name);
-	_LLS_DEBUG("build_SLT_table, attributes are: %s", (const char*)slt_attributes);
-
-	kvp_collection_t* slt_attributes_collecton = kvp_collection_parse(slt_attributes);
-	char* bsid_char = kvp_collection_get(slt_attributes_collecton, "bsid");
-	//if there is a space, split and callocif(strnstr(bsid, "", ))
-
-	//TODO: fix me
-	if(bsid_char) {
-		int bsid_i;
-		bsid_i = atoi(bsid_char);
-		freesafe(bsid_char);
+static service_t* __slt_table_service_push(slt_table_t* slt_table) {
+	if(slt_table->service_entry_n == slt_table->service_entry_capacity) {
+		int capacity = slt_table->service_entry_capacity ? slt_table->service_entry_capacity * 2 : 8;
+		service_t** service_entry = realloc(slt_table->service_entry, capacity * sizeof(service_t*));
+		if(!service_entry) {
+			return NULL;
+		}
+		slt_table->service_entry = service_entry;
+		slt_table->service_entry_capacity = capacity;
+	}
 
-		lls_table->slt_table.bsid_n = 1;
-		lls_table->slt_table.bsid =  (int*)calloc(lls_table->slt_table.bsid_n , sizeof(int));
-		lls_table->slt_table.bsid[0] = bsid_i;
+	service_t* service = calloc(1, sizeof(service_t));
+	if(service) {
+		slt_table->service_entry[slt_table->service_entry_n++] = service;
 	}
+	return service;
+}
 
-	_LLS_TRACE("build_SLT_table, attributes are: %s\n", slt_attributes);
+static int __build_SLT_service(service_t* service_entry, atsc3_xml_pull_t* xml_pull) {
+	int scratch_i = 0;
+	if(!__lls_attribute_int(xml_pull, "serviceId", &scratch_i)) {
+		_LLS_ERROR("missing required element - serviceId!");
+		return -1;
+	}
+	service_entry->service_id = scratch_i & 0xFFFF;
 
-	int svc_size = xml_node_children(xml_root);
+	//copy our char* elements
+	service_entry->global_service_id  = __lls_attribute_strdup(xml_pull, "globalServiceID");
+	service_entry->short_service_name = __lls_attribute_strdup(xml_pull, "shortServiceName");
 
-	//build our service rows
-	for(int i=0; i < svc_size; i++) {
-		xml_node_t* service_row_node = xml_node_child(xml_root, i);
-		xml_string_t* service_row_node_xml_string = xml_node_name(service_row_node);
+	//optional parameters here
+	if(__lls_attribute_int(xml_pull, "majorChannelNo", &scratch_i)) {
+		service_entry->major_channel_no = scratch_i & 0xFFFF;
+	}
+	if(__lls_attribute_int(xml_pull, "minorChannelNo", &scratch_i)) {
+		service_entry->minor_channel_no = scratch_i & 0xFFFF;
+	}
+	if(__lls_attribute_int(xml_pull, "serviceCategory", &scratch_i)) {
+		service_entry->service_category = scratch_i & 0xFFFF;
+	}
+	if(__lls_attribute_int(xml_pull, "sltSvcSeqNum", &scratch_i)) {
+		service_entry->slt_svc_seq_num = scratch_i & 0xFF;
+	}
+	return 0;
+}
 
-		/** push service row **/
-		lls_table->slt_table.service_entry_n++;
-		//TODO - grow this dynamically to N?
-		if(!lls_table->slt_table.service_entry) {
-			lls_table->slt_table.service_entry = (service_t**)calloc(32, sizeof(service_t**));
+/**
+ * single pass over the document: SLT attributes, then each Service with its BroadcastSvcSignaling,
+ * every other element is skipped with its content
+ */
+int build_SLT_table(lls_table_t *lls_table, atsc3_xml_pull_t *xml_pull) {
+	slt_table_t* slt_table = &lls_table->slt_table;
+
+	/** bsid, a list of unsignedShort **/
+	atsc3_xml_view_t bsid_list;
+	if(atsc3_xml_pull_attribute(xml_pull, "bsid", &bsid_list)) {
+		atsc3_xml_view_t list = bsid_list;
+		atsc3_xml_view_t token;
+		int bsid_max = 0;
+		while(atsc3_xml_view_next_token(&list, &token)) {
+			bsid_max++;
 		}
 
-		//service_row_node_xml_string
-		uint8_t* child_row_node_attributes_s = xml_attributes_clone(service_row_node_xml_string);
-		kvp_collection_t* service_attributes_collecton = kvp_collection_parse(child_row_node_attributes_s);
-
-		lls_table->slt_table.service_entry[lls_table->slt_table.service_entry_n-1] = calloc(1, sizeof(service_t));
-		service_t* service_entry = lls_table->slt_table.service_entry[lls_table->slt_table.service_entry_n-1];
-		//map in other attributes, e.g
-
-
-		int scratch_i = 0;
-		char* serviceId = kvp_collection_get(service_attributes_collecton, "serviceId");
-
-		if(!serviceId) {
-			_LLS_ERROR("missing required element - serviceId!");
+		slt_table->bsid = (int*)calloc(bsid_max ? bsid_max : 1, sizeof(int));
+		if(!slt_table->bsid) {
 			return -1;
 		}
-
-		scratch_i = atoi(serviceId);
-		freesafe(serviceId);
-		service_entry->service_id = scratch_i & 0xFFFF;
-		_LLS_TRACE("service id is: %s, int is: %d, uint_16: %u", serviceId, scratch_i, (scratch_i & 0xFFFF));
-
-		//copy our char* elements
-		service_entry->global_service_id  = kvp_collection_get(service_attributes_collecton, "globalServiceID");
-		service_entry->short_service_name = kvp_collection_get(service_attributes_collecton, "shortServiceName");
-
-		char* majorChannelNo  = kvp_collection_get(service_attributes_collecton, "majorChannelNo");
-		char* minorChannelNo  = kvp_collection_get(service_attributes_collecton, "minorChannelNo");
-		char* serviceCategory = kvp_collection_get(service_attributes_collecton, "serviceCategory");
-		char* sltSvcSeqNum    = kvp_collection_get(service_attributes_collecton, "sltSvcSeqNum");
-
-		//optional parameters here
-		if(majorChannelNo) {
-			scratch_i = atoi(majorChannelNo);
-			service_entry->major_channel_no = scratch_i & 0xFFFF;
-			freesafe(majorChannelNo);
+		list = bsid_list;
+		int bsid_i;
+		while(atsc3_xml_view_next_token(&list, &token)) {
+			if(atsc3_xml_view_to_int(token, &bsid_i)) {
+				slt_table->bsid[slt_table->bsid_n++] = bsid_i;
+			}
 		}
+	}
 
-		if(minorChannelNo) {
-			scratch_i = atoi(minorChannelNo);
-			service_entry->minor_channel_no = scratch_i & 0xFFFF;
-			freesafe(minorChannelNo);
+	service_t* service_entry = NULL;
+	for(;;) {
+		atsc3_xml_pull_event_t event = atsc3_xml_pull_next(xml_pull);
+		if(event == ATSC3_XML_PULL_ERROR || event == ATSC3_XML_PULL_EOF) {
+			_LLS_ERROR("build_SLT_table: malformed SLT after %d services", slt_table->service_entry_n);
+			return -1;
 		}
 
-		if(serviceCategory) {
-			scratch_i = atoi(serviceCategory);
-			service_entry->service_category = scratch_i & 0xFFFF;
-			freesafe(serviceCategory);
+		if(event == ATSC3_XML_PULL_END) {
+			if(!xml_pull->depth) {
+				return 0;
+			}
+			if(xml_pull->depth == 1) {
+				service_entry = NULL;
+			}
+			continue;
 		}
 
-		if(sltSvcSeqNum) {
-			scratch_i = atoi(sltSvcSeqNum);
-			service_entry->slt_svc_seq_num = scratch_i & 0xFFFF;
-			freesafe(sltSvcSeqNum);
+		if(event != ATSC3_XML_PULL_START) {
+			continue;
 		}
 
-		int svc_child_size = xml_node_children(service_row_node);
-
-		dump_xml_string(service_row_node_xml_string);
-
-		for(int j=0; j < svc_child_size; j++) {
-
-			xml_node_t* child_row_node = xml_node_child(service_row_node, j);
-			xml_string_t* child_row_node_xml_string = xml_node_name(child_row_node);
-
-			//this is a malloc
-			uint8_t* child_row_node_attributes_s = xml_attributes_clone(child_row_node_xml_string);
-			kvp_collection_t* kvp_child_attributes = kvp_collection_parse(child_row_node_attributes_s);
-
-			dump_xml_string(child_row_node_xml_string);
-
-			if(xml_string_equals_ignore_case(child_row_node_xml_string, LLS_SLT_SIMULCAST_TSID)) {
-				_LLS_ERROR("build_SLT_table - not supported: LLS_SLT_SIMULCAST_TSID");
-			} else if(xml_string_equals_ignore_case(child_row_node_xml_string, LLS_SLT_SVC_CAPABILITIES)) {
-				_LLS_ERROR("build_SLT_table - not supported: LLS_SLT_SVC_CAPABILITIES");
-			} else if(xml_string_equals_ignore_case(child_row_node_xml_string, LLS_SLT_BROADCAST_SVC_SIGNALING)) {
-				build_SLT_BROADCAST_SVC_SIGNALING_table(service_entry, service_row_node, kvp_child_attributes);
-
-			} else if(xml_string_equals_ignore_case(child_row_node_xml_string, LLS_SLT_SVC_INET_URL)) {
-				_LLS_ERROR("build_SLT_table - not supported: LLS_SLT_SVC_INET_URL");
-			} else if(xml_string_equals_ignore_case(child_row_node_xml_string, LLS_SLT_OTHER_BSID)) {
-				_LLS_ERROR("build_SLT_table - not supported: LLS_SLT_OTHER_BSID");
-			} else {
-				_LLS_ERROR("build_SLT_table - unknown type: %s\n", xml_string_clone(child_row_node_xml_string));
+		if(xml_pull->depth == 2 && atsc3_xml_view_equals(xml_pull->name, LLS_SLT_SERVICE)) {
+			/** push service row **/
+			service_entry = __slt_table_service_push(slt_table);
+			if(!service_entry || __build_SLT_service(service_entry, xml_pull)) {
+				return -1;
+			}
+		} else if(xml_pull->depth == 3 && service_entry && atsc3_xml_view_equals(xml_pull->name, LLS_SLT_BROADCAST_SVC_SIGNALING)) {
+			build_SLT_BROADCAST_SVC_SIGNALING_table(service_entry, xml_pull);
+		} else {
+			//SimulcastTSID, SvcCapabilities, SvcInetUrl, OtherBsid..
+			_LLS_TRACE("build_SLT_table - not supported: %.*s", (int)xml_pull->name.len, xml_pull->name.p);
+			if(atsc3_xml_pull_skip_element(xml_pull) != ATSC3_XML_PULL_END) {
+				return -1;
 			}
-
-			//cleanup
-			free(child_row_node_attributes_s);
-			kvp_collection_free(kvp_child_attributes);
-		}
-
-		//cleanup
-
-		if(service_attributes_collecton) {
-			kvp_collection_free(service_attributes_collecton);
-		}
-		if(child_row_node_attributes_s) {
-			free(child_row_node_attributes_s);
 		}
 	}
-
-	if(slt_attributes) {
-		free(slt_attributes);
-	}
-	if(slt_attributes_collecton) {
-		kvp_collection_free(slt_attributes_collecton);
-	}
-
-	return 0;
 }
 
-int build_SLT_BROADCAST_SVC_SIGNALING_table(service_t* service_table, xml_node_t *service_row_node, kvp_collection_t* kvp_collection) {
-	int ret = 0;
-	xml_string_t* service_row_node_xml_string = xml_node_name(service_row_node);
-	uint8_t *svc_attributes = xml_attributes_clone(service_row_node_xml_string);
-	_LLS_TRACE("build_SLT_BROADCAST_SVC_SIGNALING_table - attributes are: %s", svc_attributes);
-
-	char* slsProtocol = kvp_collection_get(kvp_collection, "slsProtocol");
-	if(!slsProtocol) {
+int build_SLT_BROADCAST_SVC_SIGNALING_table(service_t* service_table, atsc3_xml_pull_t *xml_pull) {
+	int sls_protocol;
+	if(!__lls_attribute_int(xml_pull, "slsProtocol", &sls_protocol)) {
 		_LLS_ERROR("build_SLT_BROADCAST_SVC_SIGNALING_table: missing slsProtocol value");
-		ret = -1;
-		goto cleanup;
+		return -1;
 	}
 
-	int scratch_i=0;
-	service_table->broadcast_svc_signaling.sls_protocol = atoi(slsProtocol);
-	freesafe(slsProtocol);
-
-	service_table->broadcast_svc_signaling.sls_destination_ip_address = kvp_collection_get(kvp_collection, "slsDestinationIpAddress");
-	service_table->broadcast_svc_signaling.sls_destination_udp_port = kvp_collection_get(kvp_collection, "slsDestinationUdpPort");
-	service_table->broadcast_svc_signaling.sls_source_ip_address = kvp_collection_get(kvp_collection, "slsSourceIpAddress");
+	service_table->broadcast_svc_signaling.sls_protocol = sls_protocol;
+	service_table->broadcast_svc_signaling.sls_destination_ip_address = __lls_attribute_strdup(xml_pull, "slsDestinationIpAddress");
+	service_table->broadcast_svc_signaling.sls_destination_udp_port = __lls_attribute_strdup(xml_pull, "slsDestinationUdpPort");
+	service_table->broadcast_svc_signaling.sls_source_ip_address = __lls_attribute_strdup(xml_pull, "slsSourceIpAddress");
 
-
-	//kvp_find_key(kvp_collection, "slsProtocol";
-
-cleanup:
-	//cleanup
-	if(svc_attributes) {
-		free(svc_attributes);
-	}
-
-	return ret;
+	return 0;
 }
 
 /** payload looks like:
  *
  * <SystemTime xmlns="http://www.atsc.org/XMLSchemas/ATSC3/Delivery/SYSTIME/1.0/" currentUtcOffset="37" utcLocalOffset="-PT5H" dsStatus="false"/>
  */
-int build_SystemTime_table(lls_table_t* lls_table, xml_node_t* xml_root) {
-
-	int ret = 0;
-
-	xml_string_t* root_node_name = xml_node_name(xml_root); //root
-	dump_xml_string(root_node_name);
-
-	uint8_t* SystemTime_attributes = xml_attributes_clone(root_node_name);
-	kvp_collection_t* SystemTime_attributes_collecton = kvp_collection_parse(SystemTime_attributes);
-
+int build_SystemTime_table(lls_table_t* lls_table, atsc3_xml_pull_t* xml_pull) {
 	int scratch_i = 0;
+	atsc3_xml_view_t value;
 
-	char* currentUtcOffset =	kvp_collection_get(SystemTime_attributes_collecton, "currentUtcOffset");
-	char* ptpPrepend = 			kvp_collection_get(SystemTime_attributes_collecton, "ptpPrepend");
-	char* leap59 =				kvp_collection_get(SystemTime_attributes_collecton, "leap59");
-	char* leap61 = 				kvp_collection_get(SystemTime_attributes_collecton, "leap61");
-	char* utcLocalOffset = 		kvp_collection_get(SystemTime_attributes_collecton, "utcLocalOffset");
-	char* dsStatus = 			kvp_collection_get(SystemTime_attributes_collecton, "dsStatus");
-	char* dsDayOfMonth = 		kvp_collection_get(SystemTime_attributes_collecton, "dsDayOfMonth");
-	char* dsHour = 				kvp_collection_get(SystemTime_attributes_collecton, "dsHour");
-
-	if(!currentUtcOffset || !utcLocalOffset) {
-		_LLS_ERROR("build_SystemTime_table, required elements missing: currentUtcOffset: %p, utcLocalOffset: %p", currentUtcOffset, utcLocalOffset);
-		ret = -1;
-		goto cleanup;
+	if(!__lls_attribute_int(xml_pull, "currentUtcOffset", &scratch_i) || !atsc3_xml_pull_attribute(xml_pull, "utcLocalOffset", &value)) {
+		_LLS_ERROR("build_SystemTime_table, required elements missing: currentUtcOffset or utcLocalOffset");
+		return -1;
 	}
 
-	scratch_i = atoi(currentUtcOffset);
-	freesafe(currentUtcOffset);
-
 	//munge negative sign
 	if(scratch_i < 0) {
 		lls_table->system_time_table.current_utc_offset = (1 << 15) | (scratch_i & 0x7FFF);
@@ -547,48 +515,34 @@ int build_SystemTime_table(lls_table_t* lls_table, xml_node_t* xml_root) {
 		lls_table->system_time_table.current_utc_offset = scratch_i & 0x7FFF;
 	}
 
-	lls_table->system_time_table.utc_local_offset = utcLocalOffset;
+	lls_table->system_time_table.utc_local_offset = atsc3_xml_view_strdup(value);
 
-	if(ptpPrepend) {
-		scratch_i = atoi(ptpPrepend);
+	if(__lls_attribute_int(xml_pull, "ptpPrepend", &scratch_i)) {
 		lls_table->system_time_table.ptp_prepend = scratch_i & 0xFFFF;
 	}
 
-	if(leap59) {
-		lls_table->system_time_table.leap59 = strcasecmp(leap59, "t") == 0;
-	}
-
-	if(leap61) {
-		lls_table->system_time_table.leap61 = strcasecmp(leap61, "t") == 0;
+	if(atsc3_xml_pull_attribute(xml_pull, "leap59", &value)) {
+		lls_table->system_time_table.leap59 = atsc3_xml_view_to_bool(value);
 	}
 
-	if(dsStatus) {
-		lls_table->system_time_table.ds_status = strcasecmp(dsStatus, "t") == 0;
-		freesafe(dsStatus);
+	if(atsc3_xml_pull_attribute(xml_pull, "leap61", &value)) {
+		lls_table->system_time_table.leap61 = atsc3_xml_view_to_bool(value);
 	}
 
-	if(dsDayOfMonth) {
-		scratch_i = atoi(dsDayOfMonth);
-		lls_table->system_time_table.ds_status = scratch_i & 0xFF;
-		freesafe(dsDayOfMonth);
+	if(atsc3_xml_pull_attribute(xml_pull, "dsStatus", &value)) {
+		lls_table->system_time_table.ds_status = atsc3_xml_view_to_bool(value);
 	}
 
-	if(dsHour) {
-		scratch_i = atoi(dsHour);
-		lls_table->system_time_table.ds_status = scratch_i & 0xFF;
-		freesafe(dsHour);
+	if(__lls_attribute_int(xml_pull, "dsDayOfMonth", &scratch_i)) {
+		lls_table->system_time_table.ds_day_of_month = scratch_i & 0xFF;
 	}
 
-cleanup:
-	if(SystemTime_attributes_collecton) {
-		kvp_collection_free(SystemTime_attributes_collecton);
+	if(__lls_attribute_int(xml_pull, "dsHour", &scratch_i)) {
+		lls_table->system_time_table.ds_hour = scratch_i & 0xFF;
 	}
 
-	if(SystemTime_attributes) {
-		free(SystemTime_attributes);
-	}
-
-	return ret;
+	//SystemTime has no children, the rest of the document is not looked at
+	return 0;
 }
 
 
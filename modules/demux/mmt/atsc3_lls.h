@@ -14,6 +14,7 @@
 #include "atsc3_utils.h"
 #include "zlib.h"
 #include "xml.h"
+#include "atsc3_xml_pull.h"
 
 #define _LLS_PRINTLN(...) printf(__VA_ARGS__);printf("\n")
 #define _LLS_PRINTF(...)  printf(__VA_ARGS__);
@@ -109,14 +110,26 @@ See Annex F Sec. 6.4 Sec. 6.5 Sec. 6.6
  */
 
 typedef struct llt_xml_payload {
-	uint8_t *xml_payload_compressed;
-	uint xml_payload_compressed_size;
 	uint8_t *xml_payload;
 	uint xml_payload_size;
 
 
 } lls_xml_payload_t;
 
+//inflated LLS tables are capped, a 65,507 byte datagram of XML rarely inflates past 1MB
+#define LLS_INFLATE_OUTPUT_MAX (8 * 1024 * 1024)
+
+/**
+ * one per listener: the gzip stream is set up once and reset for every table, and the output buffer is
+ * sized from the gzip ISIZE trailer and kept, so inflating a table does not allocate once it has warmed up
+ */
+typedef struct lls_inflate_context {
+	z_stream	strm;
+	bool		strm_initialized;
+	uint8_t*	buffer;
+	size_t		buffer_size;
+} lls_inflate_context_t;
+
 /**
  *  |SLT|, attributes len: 70, val: xmlns="tag:atsc.org,2016:XMLSchemas/ATSC3/Delivery/SLT/1.0/" bsid="50"
 children: 569:dump_xml_string::xml_string: len: 7, is_self_closing: 0, val: |Service|, attributes len: 172, val: serviceId="1001" globalServiceID="urn:atsc:serviceid:ateme_mmt_1" majorChannelNo="10" minorChannelNo="1" serviceCategory="1" shortServiceName="ATEME MMT 1" sltSvcSeqNum="0"
@@ -179,6 +192,7 @@ typedef struct slt_table {
 	char*			 	slt_capabilities;
 	service_t**			service_entry; 	//list
 	int					service_entry_n;
+	int					service_entry_capacity;
 
 } slt_table_t;
 
@@ -221,7 +235,7 @@ typedef enum {
 	SystemTime,
 	AEAT,
 	OnscreenMessageNotification,
-	RESERVED
+	LLS_RESERVED
 } lls_table_type_t;
 
 typedef struct lls_table {
@@ -305,9 +319,11 @@ see atsc3_lls_test.c for base64 string getters of test payloads
 lls_table_t* lls_create_xml_table( uint8_t* lls_packet, int size);
 //todo - rename this lls_table_create
 lls_table_t* lls_table_create( uint8_t* lls_packet, int size);
+//inflates into the context's buffer and builds the table from it in place
+lls_table_t* lls_table_create_with_inflate_context(lls_inflate_context_t* lls_inflate_context, uint8_t* lls_packet, int size);
 //todo - rename this lls_table_free
 void lls_table_free(lls_table_t* lls_table);
-int lls_create_table_type_instance(lls_table_t* lls_table, xml_node_t* xml_node);
+int lls_create_table_type_instance(lls_table_t* lls_table, atsc3_xml_pull_t* xml_pull);
 
 void lls_dump_instance_table(lls_table_t *base_table);
 
@@ -317,12 +333,21 @@ xml_node_t* xml_payload_document_extract_root_node(xml_document_t*);
 
 //etst methods
 
-int build_SLT_table(lls_table_t *lls_table, xml_node_t *xml_root);
-int build_SystemTime_table(lls_table_t* lls_table, xml_node_t* xml_root);
+//table builders, called with xml_pull on the START of the root element
+int build_SLT_table(lls_table_t *lls_table, atsc3_xml_pull_t *xml_pull);
+int build_SystemTime_table(lls_table_t* lls_table, atsc3_xml_pull_t* xml_pull);
+
+int build_SLT_BROADCAST_SVC_SIGNALING_table(service_t* service_table, atsc3_xml_pull_t *xml_pull);
+
+void lls_inflate_context_init(lls_inflate_context_t* lls_inflate_context);
+
+//inflates one gzip member, the NUL terminated payload stays owned by the context until the next call. returns its length or a zlib error
+int lls_inflate(lls_inflate_context_t* lls_inflate_context, const uint8_t* gzip_payload, size_t gzip_payload_size, uint8_t** payload);
 
-int build_SLT_BROADCAST_SVC_SIGNALING_table(service_t* service_table, xml_node_t *xml_node, kvp_collection_t* kvp_collection);
+void lls_inflate_context_free(lls_inflate_context_t* lls_inflate_context);
 
 // internal helper methods here
+//one-shot lls_inflate, the caller owns and frees decompressed_payload
 int __unzip_gzip_payload(uint8_t *input_payload, uint input_payload_size, uint8_t **decompressed_payload);
 
 
@@ -0,0 +1,184 @@
+/*
+ *
+ * atsc3_lls_inflate_test.c:  driver for the reusable LLS gzip inflate context
+ *
+ */
+
+#include "atsc3_lls.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define __UNIT_TEST 1
+#ifdef __UNIT_TEST
+
+int test_lls_inflate_reuse();
+int test_lls_inflate_large();
+int test_lls_inflate_invalid();
+
+int main() {
+	int failed = 0;
+
+	failed |= test_lls_inflate_reuse();
+	failed |= test_lls_inflate_large();
+	failed |= test_lls_inflate_invalid();
+
+	return failed;
+}
+
+//gzip member of payload, as carried after the 4 byte LLS_table() header
+static uint8_t* __gzip(const uint8_t* payload, size_t payload_size, size_t* gzip_size) {
+	z_stream strm;
+	memset(&strm, 0, sizeof(z_stream));
+	if(deflateInit2(&strm, Z_BEST_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		return NULL;
+	}
+	size_t bound = deflateBound(&strm, payload_size);
+	uint8_t* gzip = malloc(bound);
+	strm.next_in = (Bytef*)payload;
+	strm.avail_in = payload_size;
+	strm.next_out = gzip;
+	strm.avail_out = bound;
+	int ret = deflate(&strm, Z_FINISH);
+	*gzip_size = strm.total_out;
+	deflateEnd(&strm);
+	if(ret != Z_STREAM_END) {
+		free(gzip);
+		return NULL;
+	}
+	return gzip;
+}
+
+static char* __test_slt(int services, size_t* size) {
+	size_t xml_size = 256 + services * 384;
+	char* xml = malloc(xml_size);
+	size_t len = snprintf(xml, xml_size, "<?xml version=\"1.0\" encoding=\"UTF-8\"?><SLT xmlns=\"tag:atsc.org,2016:XMLSchemas/ATSC3/Delivery/SLT/1.0/\" bsid=\"50\">");
+	for(int i=0; i < services; i++) {
+		len += snprintf(xml + len, xml_size - len, "<Service serviceId=\"%d\" globalServiceID=\"urn:atsc:serviceid:%d\" majorChannelNo=\"10\" minorChannelNo=\"%d\" "
+				"serviceCategory=\"1\" shortServiceName=\"S%d\" sltSvcSeqNum=\"0\"><BroadcastSvcSignaling slsProtocol=\"2\" "
+				"slsDestinationIpAddress=\"239.255.%d.%d\" slsDestinationUdpPort=\"%d\" slsSourceIpAddress=\"172.16.200.1\"/></Service>",
+				i, i, i, i, (i >> 8) & 0xFF, i & 0xFF, 50000 + i);
+	}
+	len += snprintf(xml + len, xml_size - len, "</SLT>");
+	*size = len;
+	return xml;
+}
+
+//the second table inflates into the same buffer without growing it
+int test_lls_inflate_reuse() {
+	size_t xml_size, gzip_size;
+	char* xml = __test_slt(10, &xml_size);
+	uint8_t* gzip = __gzip((uint8_t*)xml, xml_size, &gzip_size);
+
+	lls_inflate_context_t lls_inflate_context;
+	lls_inflate_context_init(&lls_inflate_context);
+
+	int ret = 0;
+	uint8_t* payload;
+	if(lls_inflate(&lls_inflate_context, gzip, gzip_size, &payload) != (int)xml_size || memcmp(payload, xml, xml_size) || payload[xml_size]) {
+		printf("test_lls_inflate_reuse: first inflate\n");
+		ret = -1;
+	}
+	uint8_t* buffer = lls_inflate_context.buffer;
+	size_t buffer_size = lls_inflate_context.buffer_size;
+	if(buffer_size != xml_size + 1) {
+		printf("test_lls_inflate_reuse: buffer not sized from ISIZE: %zu, payload: %zu\n", buffer_size, xml_size);
+		ret = -1;
+	}
+
+	if(lls_inflate(&lls_inflate_context, gzip, gzip_size, &payload) != (int)xml_size || memcmp(payload, xml, xml_size) ||
+			lls_inflate_context.buffer != buffer || lls_inflate_context.buffer_size != buffer_size) {
+		printf("test_lls_inflate_reuse: second inflate\n");
+		ret = -1;
+	}
+
+	uint8_t* decompressed_payload = NULL;
+	if(__unzip_gzip_payload(gzip, gzip_size, &decompressed_payload) != (int)xml_size || memcmp(decompressed_payload, xml, xml_size)) {
+		printf("test_lls_inflate_reuse: one-shot inflate\n");
+		ret = -1;
+	}
+
+	free(decompressed_payload);
+	lls_inflate_context_free(&lls_inflate_context);
+	free(gzip);
+	free(xml);
+	return ret;
+}
+
+//an SLT filling most of a datagram and inflating to ~1MB, and a table built from it through the context
+int test_lls_inflate_large() {
+	size_t xml_size, gzip_size;
+	char* xml = __test_slt(3000, &xml_size);
+	uint8_t* gzip = __gzip((uint8_t*)xml, xml_size, &gzip_size);
+
+	uint8_t* lls_packet = malloc(gzip_size + 4);
+	lls_packet[0] = SLT;
+	lls_packet[1] = 1;
+	lls_packet[2] = 0;
+	lls_packet[3] = 7;
+	memcpy(&lls_packet[4], gzip, gzip_size);
+
+	lls_inflate_context_t lls_inflate_context;
+	lls_inflate_context_init(&lls_inflate_context);
+
+	int ret = 0;
+	lls_table_t* lls_table = lls_table_create_with_inflate_context(&lls_inflate_context, lls_packet, gzip_size + 4);
+	if(gzip_size > 65507 || !lls_table || lls_table->slt_table.service_entry_n != 3000 ||
+			lls_table->raw_xml.xml_payload_size != xml_size || lls_table->raw_xml.xml_payload == lls_inflate_context.buffer) {
+		printf("test_lls_inflate_large: gzip: %zu, xml: %zu, services: %d\n", gzip_size, xml_size, lls_table ? lls_table->slt_table.service_entry_n : -1);
+		ret = -1;
+	}
+
+	lls_table_free(lls_table);
+	lls_inflate_context_free(&lls_inflate_context);
+	free(lls_packet);
+	free(gzip);
+	free(xml);
+	return ret;
+}
+
+//truncated members and payloads inflating past LLS_INFLATE_OUTPUT_MAX are refused, the context stays usable
+int test_lls_inflate_invalid() {
+	size_t xml_size, gzip_size, bomb_gzip_size;
+	char* xml = __test_slt(10, &xml_size);
+	uint8_t* gzip = __gzip((uint8_t*)xml, xml_size, &gzip_size);
+
+	uint8_t* bomb = calloc(1, LLS_INFLATE_OUTPUT_MAX + 1);
+	uint8_t* bomb_gzip = __gzip(bomb, LLS_INFLATE_OUTPUT_MAX + 1, &bomb_gzip_size);
+	free(bomb);
+
+	lls_inflate_context_t lls_inflate_context;
+	lls_inflate_context_init(&lls_inflate_context);
+
+	int ret = 0;
+	uint8_t* payload;
+	if(lls_inflate(&lls_inflate_context, gzip, gzip_size - 10, &payload) >= 0) {
+		printf("test_lls_inflate_invalid: truncated member accepted\n");
+		ret = -1;
+	}
+	if(lls_inflate(&lls_inflate_context, bomb_gzip, bomb_gzip_size, &payload) >= 0) {
+		printf("test_lls_inflate_invalid: oversized payload accepted\n");
+		ret = -1;
+	}
+	gzip[gzip_size - 5] ^= 0xFF;
+	if(lls_inflate(&lls_inflate_context, gzip, gzip_size, &payload) >= 0) {
+		printf("test_lls_inflate_invalid: bad crc accepted\n");
+		ret = -1;
+	}
+	gzip[gzip_size - 5] ^= 0xFF;
+	if(lls_inflate(&lls_inflate_context, gzip, gzip_size, &payload) != (int)xml_size) {
+		printf("test_lls_inflate_invalid: context not reusable after errors\n");
+		ret = -1;
+	}
+
+	lls_inflate_context_free(&lls_inflate_context);
+	free(bomb_gzip);
+	free(gzip);
+	free(xml);
+	return ret;
+}
+
+#endif
@@ -0,0 +1,149 @@
+/*
+ * atsc3_lls_table_manager.c
+ *
+ *  Created on: Feb 24, 2019
+ *      Author: jjustman
+ */
+
+#include "atsc3_lls_table_manager.h"
+
+lls_table_ref_t* lls_table_ref_hold(lls_table_ref_t* lls_table_ref) {
+	atomic_fetch_add_explicit(&lls_table_ref->refs, 1, memory_order_relaxed);
+	return lls_table_ref;
+}
+
+void lls_table_ref_release(lls_table_ref_t* lls_table_ref) {
+	if(!lls_table_ref) {
+		return;
+	}
+	if(atomic_fetch_sub_explicit(&lls_table_ref->refs, 1, memory_order_acq_rel) == 1) {
+		lls_table_free(lls_table_ref->lls_table);
+		free(lls_table_ref);
+	}
+}
+
+static lls_table_ref_t* __lls_table_ref_create(lls_table_t* lls_table) {
+	lls_table_ref_t* lls_table_ref = calloc(1, sizeof(lls_table_ref_t));
+	if(!lls_table_ref) {
+		return NULL;
+	}
+	atomic_init(&lls_table_ref->refs, 1);
+	lls_table_ref->lls_table = lls_table;
+	return lls_table_ref;
+}
+
+void lls_table_manager_init(lls_table_manager_t* lls_table_manager) {
+	memset(lls_table_manager, 0, sizeof(lls_table_manager_t));
+	lls_inflate_context_init(&lls_table_manager->lls_inflate_context);
+}
+
+int lls_table_manager_subscribe(lls_table_manager_t* lls_table_manager, uint8_t lls_table_id, lls_table_manager_callback_f callback, void* context) {
+	if(lls_table_manager->subscribers_n >= LLS_TABLE_MANAGER_MAX_SUBSCRIBERS) {
+		_LLS_TABLE_MANAGER_ERROR("lls_table_manager_subscribe: too many subscribers, lls_table_id: %u", lls_table_id);
+		return -1;
+	}
+	lls_table_manager_subscriber_t* subscriber = &lls_table_manager->subscribers[lls_table_manager->subscribers_n++];
+	subscriber->lls_table_id = lls_table_id;
+	subscriber->callback = callback;
+	subscriber->context = context;
+	return 0;
+}
+
+static lls_table_manager_entry_t* __lls_table_manager_find(lls_table_manager_t* lls_table_manager, uint8_t lls_table_id, uint8_t lls_group_id) {
+	for(int i=0; i < lls_table_manager->entries_n; i++) {
+		lls_table_manager_entry_t* entry = &lls_table_manager->entries[i];
+		if(entry->lls_table_id == lls_table_id && entry->lls_group_id == lls_group_id) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+int lls_table_manager_push(lls_table_manager_t* lls_table_manager, uint8_t* lls_packet, int size) {
+	lls_table_manager->tables_received++;
+	if(size <= LLS_TABLE_HEADER_SIZE) {
+		lls_table_manager->tables_invalid++;
+		return -1;
+	}
+
+	uint8_t lls_table_id = lls_packet[0];
+	uint8_t lls_group_id = lls_packet[1];
+	uint8_t lls_table_version = lls_packet[3];
+
+	lls_table_manager_entry_t* entry = __lls_table_manager_find(lls_table_manager, lls_table_id, lls_group_id);
+	if(entry && entry->lls_table_version == lls_table_version) {
+		lls_table_manager->tables_unchanged++;
+		return 0;
+	}
+
+	if(!entry && lls_table_manager->entries_n >= LLS_TABLE_MANAGER_MAX_TABLES) {
+		_LLS_TABLE_MANAGER_ERROR("lls_table_manager_push: no room left for lls_table_id: %u, lls_group_id: %u", lls_table_id, lls_group_id);
+		lls_table_manager->tables_invalid++;
+		return -1;
+	}
+
+	//a table that fails to parse leaves the entry alone, its version is tried again on its next repetition
+	lls_table_t* lls_table = lls_table_create_with_inflate_context(&lls_table_manager->lls_inflate_context, lls_packet, size);
+	if(!lls_table) {
+		lls_table_manager->tables_invalid++;
+		return -1;
+	}
+	lls_table_ref_t* lls_table_ref = __lls_table_ref_create(lls_table);
+	if(!lls_table_ref) {
+		lls_table_free(lls_table);
+		lls_table_manager->tables_invalid++;
+		return -1;
+	}
+
+	if(!entry) {
+		entry = &lls_table_manager->entries[lls_table_manager->entries_n++];
+		entry->lls_table_id = lls_table_id;
+		entry->lls_group_id = lls_group_id;
+	}
+
+	//the new version replaces the old snapshot, holders keep theirs
+	lls_table_ref_release(entry->lls_table_ref);
+	entry->lls_table_version = lls_table_version;
+	entry->lls_table_ref = lls_table_ref;
+	lls_table_manager->tables_changed++;
+
+	//the manager's ref keeps the snapshot alive through the callbacks
+	for(int i=0; i < lls_table_manager->subscribers_n; i++) {
+		lls_table_manager_subscriber_t* subscriber = &lls_table_manager->subscribers[i];
+		if(!subscriber->lls_table_id || subscriber->lls_table_id == lls_table_id) {
+			subscriber->callback(subscriber->context, entry->lls_table_ref);
+		}
+	}
+	return 1;
+}
+
+lls_table_ref_t* lls_table_manager_get(lls_table_manager_t* lls_table_manager, uint8_t lls_table_id, uint8_t lls_group_id) {
+	lls_table_manager_entry_t* entry = __lls_table_manager_find(lls_table_manager, lls_table_id, lls_group_id);
+	if(!entry) {
+		return NULL;
+	}
+	return lls_table_ref_hold(entry->lls_table_ref);
+}
+
+void lls_table_manager_reset(lls_table_manager_t* lls_table_manager) {
+	for(int i=0; i < lls_table_manager->entries_n; i++) {
+		lls_table_ref_release(lls_table_manager->entries[i].lls_table_ref);
+		lls_table_manager->entries[i].lls_table_ref = NULL;
+	}
+	lls_table_manager->entries_n = 0;
+}
+
+void lls_table_manager_stats_dump(const lls_table_manager_t* lls_table_manager) {
+	_LLS_TABLE_MANAGER_INFO("lls_table_manager: tables received: %llu, unchanged: %llu, changed: %llu, invalid: %llu, tracked: %d",
+			(unsigned long long)lls_table_manager->tables_received,
+			(unsigned long long)lls_table_manager->tables_unchanged,
+			(unsigned long long)lls_table_manager->tables_changed,
+			(unsigned long long)lls_table_manager->tables_invalid,
+			lls_table_manager->entries_n);
+}
+
+void lls_table_manager_free(lls_table_manager_t* lls_table_manager) {
+	lls_table_manager_reset(lls_table_manager);
+	lls_table_manager->subscribers_n = 0;
+	lls_inflate_context_free(&lls_table_manager->lls_inflate_context);
+}
@@ -0,0 +1,105 @@
+/*
+ * atsc3_lls_table_manager.h
+ *
+ *  Created on: Feb 24, 2019
+ *      Author: jjustman
+ *
+ * LLS tables are repeated about once a second, but only change when their LLS_table_version does.
+ *
+ * the manager keeps the last parsed table for every (LLS_table_id, LLS_group_id) and compares the version
+ * byte of each pushed LLS_table() against it before anything is gunzipped or parsed, so a repeated table
+ * costs 4 byte compares. a table that did change is inflated into the manager's reusable buffer, parsed
+ * once into an immutable snapshot and handed to the subscribers for its table_id.
+ *
+ * snapshots are ref-counted: the manager holds one ref on the current snapshot of each table, anyone
+ * keeping a snapshot past a callback or a get must hold their own, and the table is freed with the last
+ * ref. refs are atomic so a snapshot may be passed to and released on another thread, the manager itself
+ * must only be used from one thread.
+ */
+
+#ifndef MODULES_DEMUX_MMT_ATSC3_LLS_TABLE_MANAGER_H_
+#define MODULES_DEMUX_MMT_ATSC3_LLS_TABLE_MANAGER_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "atsc3_lls.h"
+
+#define _LLS_TABLE_MANAGER_PRINTLN(...) printf(__VA_ARGS__);printf("\n")
+#define _LLS_TABLE_MANAGER_ERROR(...)   printf("%s:%d:ERROR:",__FILE__,__LINE__);_LLS_TABLE_MANAGER_PRINTLN(__VA_ARGS__);
+#define _LLS_TABLE_MANAGER_INFO(...)    printf("%s:%d:INFO :",__FILE__,__LINE__);_LLS_TABLE_MANAGER_PRINTLN(__VA_ARGS__);
+
+//(table_id, group_id) pairs tracked, a broadcast carries a handful of groups of up to 5 table types
+#define LLS_TABLE_MANAGER_MAX_TABLES		32
+#define LLS_TABLE_MANAGER_MAX_SUBSCRIBERS	8
+
+//LLS_table_id, LLS_group_id, group_count_minus1, LLS_table_version
+#define LLS_TABLE_HEADER_SIZE				4
+
+typedef struct lls_table_ref {
+	atomic_uint		refs;
+	lls_table_t*	lls_table;		//read only once published
+} lls_table_ref_t;
+
+lls_table_ref_t* lls_table_ref_hold(lls_table_ref_t* lls_table_ref);
+
+//frees the table with the last ref
+void lls_table_ref_release(lls_table_ref_t* lls_table_ref);
+
+//the snapshot is only borrowed for the duration of the call
+typedef void (*lls_table_manager_callback_f)(void* context, lls_table_ref_t* lls_table_ref);
+
+typedef struct lls_table_manager_subscriber {
+	uint8_t							lls_table_id;	//0 for every table
+	lls_table_manager_callback_f	callback;
+	void*							context;
+} lls_table_manager_subscriber_t;
+
+typedef struct lls_table_manager_entry {
+	uint8_t				lls_table_id;
+	uint8_t				lls_group_id;
+	uint8_t				lls_table_version;
+	lls_table_ref_t*	lls_table_ref;		//of lls_table_version, entries are only added once a table parsed
+} lls_table_manager_entry_t;
+
+typedef struct lls_table_manager {
+	lls_table_manager_entry_t		entries[LLS_TABLE_MANAGER_MAX_TABLES];
+	int								entries_n;
+
+	lls_table_manager_subscriber_t	subscribers[LLS_TABLE_MANAGER_MAX_SUBSCRIBERS];
+	int								subscribers_n;
+
+	lls_inflate_context_t			lls_inflate_context;
+
+	uint64_t	tables_received;
+	uint64_t	tables_unchanged;	//skipped on their version
+	uint64_t	tables_changed;		//parsed and published
+	uint64_t	tables_invalid;		//short, failed to parse, or no room left to track them
+} lls_table_manager_t;
+
+void lls_table_manager_init(lls_table_manager_t* lls_table_manager);
+
+//lls_table_id 0 subscribes to every table, -1 if there are too many subscribers
+int lls_table_manager_subscribe(lls_table_manager_t* lls_table_manager, uint8_t lls_table_id, lls_table_manager_callback_f callback, void* context);
+
+/**
+ * 1 if the table is new or its version changed, it was parsed and the subscribers were called,
+ * 0 if the version is the one already held and the payload was not looked at,
+ * -1 if the table could not be parsed. the version held and its snapshot are kept, so a corrupt repetition
+ * does not hide the good ones that follow it, at the cost of gunzipping an unsupported table type (RRT, AEAT..)
+ * on every repetition.
+ */
+int lls_table_manager_push(lls_table_manager_t* lls_table_manager, uint8_t* lls_packet, int size);
+
+//current snapshot with a ref held for the caller, NULL if none was parsed yet
+lls_table_ref_t* lls_table_manager_get(lls_table_manager_t* lls_table_manager, uint8_t lls_table_id, uint8_t lls_group_id);
+
+//forget every version, the next repetition of each table is parsed and published again
+void lls_table_manager_reset(lls_table_manager_t* lls_table_manager);
+
+void lls_table_manager_stats_dump(const lls_table_manager_t* lls_table_manager);
+
+void lls_table_manager_free(lls_table_manager_t* lls_table_manager);
+
+#endif /* MODULES_DEMUX_MMT_ATSC3_LLS_TABLE_MANAGER_H_ */
@@ -0,0 +1,218 @@
+/*
+ *
+ * atsc3_lls_table_manager_test.c:  driver for LLS table version tracking and snapshot refs
+ *
+ */
+
+#include "atsc3_lls_table_manager.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define __UNIT_TEST 1
+#ifdef __UNIT_TEST
+
+//slt, version 2
+static char* __get_test_slt()					{ return "010100021f8b08089217185c0003534c5400b5d55b6f82301400e0f7fd0ad2e70d4a41370d609c9ac5448d092ed99ba9d06117685d5bcdfcf73ba8cbe2bc44167d229c4bcfe9f70041ebabc8ad15539a4b1122d7c6c86222912917598896e6fde109b5a2bb201e4c2ca8143a4486664d6a74624b95dd13ecd69b6fc3419ccc5941b5d39ec41dcfe9b29cc3996b07da1c38d341d64cf33444358ca220666ac51366e9edb30f7117631759592e6734dfa5fb5d98afc466547357ca537865059b1685994243413fa4eacca9102c1fc9f2188871b11f433f833ad09b49b5dec6e65299dda8112d5888da93deb0670d8713ab4ce7265e2531fb1c2d8b10955b3f2b49d384ea4d9c6782e64004757aaca49189cc4344ca3edd65da70410d80f617ed34554c831af11a36a9d56c17dbeedfb2d77431866d8067eb00d9582e1518fcf6bb8fc476eb36c165bf1305ce6ef7539ca42a27b98c9354e724b7e53c28dbe324d7e1f4aa727a97717ad539bddb727a6739bdeb70fa5539fdcb38fdea9cfe6d39fdb39cfe15386b18372ee3643a3be2e31ff3e9c52fff7439f8ba1d7121d86e9c76219b0b557329ff34d1dd372e0efb8fce060000"; }
+//system_time_message, version 1
+static char* __get_test_system_time_message()	{ return "030100011f8b08089717185c000353797374656d54696d6500358dcb0a82401440f77ec570f77a0b89227c10151428056350cb61bc3e601cc3b966fe7d6eda1e38e744e9b733e243836b7b1bc33a588120abfbb2b5750c2357fe0ed2c48be4ec98baa2ed482c82753134ccef3de2344d8162a7837ea8f199675237d4298787421e433c916997f88cf2258b6b7ec6658020f4380c64f9c1fa56558e3886700b62649df55a993ff3efc5e602a27492158fcbb252c61160e2fd003518c11fb6000000"; }
+
+typedef struct __test_subscriber {
+	int					calls;
+	lls_table_ref_t*	lls_table_ref;
+} __test_subscriber_t;
+
+void __test_callback(void* context, lls_table_ref_t* lls_table_ref) {
+	__test_subscriber_t* subscriber = (__test_subscriber_t*)context;
+	subscriber->calls++;
+	lls_table_ref_release(subscriber->lls_table_ref);
+	subscriber->lls_table_ref = lls_table_ref_hold(lls_table_ref);
+}
+
+void __create_binary_payload(char *test_payload_base64, uint8_t **binary_payload, int * binary_payload_size) {
+	int test_payload_base64_length = strlen(test_payload_base64);
+	int test_payload_binary_size = test_payload_base64_length/2;
+
+	uint8_t *test_payload_binary = calloc(test_payload_binary_size, sizeof(uint8_t));
+
+	for (size_t count = 0; count < test_payload_binary_size; count++) {
+	        sscanf(test_payload_base64, "%2hhx", &test_payload_binary[count]);
+	        test_payload_base64 += 2;
+	}
+
+	*binary_payload = test_payload_binary;
+	*binary_payload_size = test_payload_binary_size;
+}
+
+int test_lls_table_manager_unchanged();
+int test_lls_table_manager_version_change();
+int test_lls_table_manager_invalid();
+
+int main() {
+	int failed = 0;
+
+	failed |= test_lls_table_manager_unchanged();
+	failed |= test_lls_table_manager_version_change();
+	failed |= test_lls_table_manager_invalid();
+
+	return failed;
+}
+
+//the SLT is parsed and published once, its repetitions are skipped, the SystemTime only goes to its own subscriber
+int test_lls_table_manager_unchanged() {
+	uint8_t *slt, *system_time;
+	int slt_size, system_time_size;
+	__create_binary_payload(__get_test_slt(), &slt, &slt_size);
+	__create_binary_payload(__get_test_system_time_message(), &system_time, &system_time_size);
+
+	lls_table_manager_t lls_table_manager;
+	lls_table_manager_init(&lls_table_manager);
+	__test_subscriber_t slt_subscriber = { 0 };
+	__test_subscriber_t all_subscriber = { 0 };
+	lls_table_manager_subscribe(&lls_table_manager, SLT, __test_callback, &slt_subscriber);
+	lls_table_manager_subscribe(&lls_table_manager, 0, __test_callback, &all_subscriber);
+
+	int ret = 0;
+	if(lls_table_manager_push(&lls_table_manager, slt, slt_size) != 1) {
+		printf("test_lls_table_manager_unchanged: first SLT not published\n");
+		ret = -1;
+	}
+	for(int i=0; i < 10; i++) {
+		if(lls_table_manager_push(&lls_table_manager, slt, slt_size) != 0) {
+			printf("test_lls_table_manager_unchanged: repeated SLT %d not skipped\n", i);
+			ret = -1;
+		}
+	}
+	if(lls_table_manager_push(&lls_table_manager, system_time, system_time_size) != 1) {
+		printf("test_lls_table_manager_unchanged: SystemTime not published\n");
+		ret = -1;
+	}
+
+	if(slt_subscriber.calls != 1 || all_subscriber.calls != 2 || lls_table_manager.tables_unchanged != 10 ||
+			lls_table_manager.tables_changed != 2 || !slt_subscriber.lls_table_ref ||
+			slt_subscriber.lls_table_ref->lls_table->slt_table.service_entry_n < 1) {
+		printf("test_lls_table_manager_unchanged: slt calls: %d, all calls: %d, unchanged: %llu, changed: %llu\n",
+				slt_subscriber.calls, all_subscriber.calls,
+				(unsigned long long)lls_table_manager.tables_unchanged, (unsigned long long)lls_table_manager.tables_changed);
+		ret = -1;
+	}
+
+	lls_table_manager_stats_dump(&lls_table_manager);
+	lls_table_manager_free(&lls_table_manager);
+	lls_table_ref_release(slt_subscriber.lls_table_ref);
+	lls_table_ref_release(all_subscriber.lls_table_ref);
+	free(slt);
+	free(system_time);
+	return ret;
+}
+
+//a new version is published while a snapshot of the old one is still held and stays valid
+int test_lls_table_manager_version_change() {
+	uint8_t *slt;
+	int slt_size;
+	__create_binary_payload(__get_test_slt(), &slt, &slt_size);
+
+	lls_table_manager_t lls_table_manager;
+	lls_table_manager_init(&lls_table_manager);
+	__test_subscriber_t slt_subscriber = { 0 };
+	lls_table_manager_subscribe(&lls_table_manager, SLT, __test_callback, &slt_subscriber);
+
+	lls_table_manager_push(&lls_table_manager, slt, slt_size);
+	lls_table_ref_t* old_ref = lls_table_manager_get(&lls_table_manager, SLT, slt[1]);
+
+	slt[3]++;
+	int ret = 0;
+	if(lls_table_manager_push(&lls_table_manager, slt, slt_size) != 1 || slt_subscriber.calls != 2) {
+		printf("test_lls_table_manager_version_change: new version not published, calls: %d\n", slt_subscriber.calls);
+		ret = -1;
+	}
+
+	lls_table_ref_t* new_ref = lls_table_manager_get(&lls_table_manager, SLT, slt[1]);
+	if(!old_ref || !new_ref || old_ref == new_ref || old_ref->lls_table->lls_table_version + 1 != new_ref->lls_table->lls_table_version ||
+			atomic_load(&old_ref->refs) != 1 || old_ref->lls_table->slt_table.service_entry_n != new_ref->lls_table->slt_table.service_entry_n) {
+		printf("test_lls_table_manager_version_change: snapshots not kept apart\n");
+		ret = -1;
+	}
+
+	if(lls_table_manager_get(&lls_table_manager, SLT, slt[1] + 1) || lls_table_manager_get(&lls_table_manager, SystemTime, slt[1])) {
+		printf("test_lls_table_manager_version_change: unknown table returned\n");
+		ret = -1;
+	}
+
+	//after a reset the same version is published again
+	lls_table_manager_reset(&lls_table_manager);
+	if(lls_table_manager_push(&lls_table_manager, slt, slt_size) != 1 || slt_subscriber.calls != 3) {
+		printf("test_lls_table_manager_version_change: not published after reset\n");
+		ret = -1;
+	}
+
+	lls_table_ref_release(old_ref);
+	lls_table_ref_release(new_ref);
+	lls_table_manager_free(&lls_table_manager);
+	lls_table_ref_release(slt_subscriber.lls_table_ref);
+	free(slt);
+	return ret;
+}
+
+//short and corrupt tables are refused without touching the version or snapshot held
+int test_lls_table_manager_invalid() {
+	uint8_t *slt;
+	int slt_size;
+	__create_binary_payload(__get_test_slt(), &slt, &slt_size);
+
+	lls_table_manager_t lls_table_manager;
+	lls_table_manager_init(&lls_table_manager);
+	__test_subscriber_t slt_subscriber = { 0 };
+	lls_table_manager_subscribe(&lls_table_manager, SLT, __test_callback, &slt_subscriber);
+
+	int ret = 0;
+	if(lls_table_manager_push(&lls_table_manager, slt, LLS_TABLE_HEADER_SIZE) != -1) {
+		printf("test_lls_table_manager_invalid: header only table accepted\n");
+		ret = -1;
+	}
+
+	//truncated gzip member, each repetition is parsed again and refused
+	if(lls_table_manager_push(&lls_table_manager, slt, LLS_TABLE_HEADER_SIZE + 16) != -1 ||
+			lls_table_manager_push(&lls_table_manager, slt, LLS_TABLE_HEADER_SIZE + 16) != -1 ||
+			lls_table_manager_get(&lls_table_manager, SLT, slt[1]) || lls_table_manager.entries_n) {
+		printf("test_lls_table_manager_invalid: truncated table not refused\n");
+		ret = -1;
+	}
+
+	//a good repetition of the same version after a corrupt one is still published
+	if(lls_table_manager_push(&lls_table_manager, slt, slt_size) != 1 || slt_subscriber.calls != 1 ||
+			lls_table_manager.tables_invalid != 3) {
+		printf("test_lls_table_manager_invalid: good repetition not published, calls: %d, invalid: %llu\n",
+				slt_subscriber.calls, (unsigned long long)lls_table_manager.tables_invalid);
+		ret = -1;
+	}
+
+	//a corrupt next version keeps the current snapshot, the good one is published once it comes
+	slt[3]++;
+	lls_table_ref_t* lls_table_ref = NULL;
+	if(lls_table_manager_push(&lls_table_manager, slt, LLS_TABLE_HEADER_SIZE + 16) != -1 ||
+			!(lls_table_ref = lls_table_manager_get(&lls_table_manager, SLT, slt[1])) ||
+			lls_table_ref != slt_subscriber.lls_table_ref ||
+			lls_table_manager.entries[0].lls_table_version != slt[3] - 1) {
+		printf("test_lls_table_manager_invalid: corrupt version replaced the snapshot\n");
+		ret = -1;
+	}
+	lls_table_ref_release(lls_table_ref);
+
+	if(lls_table_manager_push(&lls_table_manager, slt, slt_size) != 1 || slt_subscriber.calls != 2 ||
+			lls_table_manager.tables_invalid != 4 || lls_table_manager.entries[0].lls_table_version != slt[3]) {
+		printf("test_lls_table_manager_invalid: next version not published, calls: %d, invalid: %llu\n",
+				slt_subscriber.calls, (unsigned long long)lls_table_manager.tables_invalid);
+		ret = -1;
+	}
+
+	lls_table_manager_free(&lls_table_manager);
+	lls_table_ref_release(slt_subscriber.lls_table_ref);
+	free(slt);
+	return ret;
+}
+
+#endif
@@ -24,207 +24,673 @@ raw base64 payload:
  */
 
 
-uint8_t* signaling_message_parse_payload_header(mmtp_payload_fragments_union_t *mmtp_packet, uint8_t* udp_raw_buf, uint8_t udp_raw_buf_size) {
-
-	if(mmtp_packet->mmtp_packet_header.mmtp_payload_type != 0x02) {
-		_MMSM_ERROR("signaling_message_parse_payload_header: mmtp_payload_type 0x02 != 0x%x", mmtp_packet->mmtp_packet_header.mmtp_payload_type);
-		return NULL;
-	}
+//PA and MPI messages carry a 32 bit length, everything else 16
+static bool __signaling_message_has_32bit_length(uint16_t message_id) {
+	return message_id == PA_message || (message_id >= MPI_message_start && message_id <= MPI_message_end);
+}
 
-	uint8_t *raw_buf = udp_raw_buf;
-	uint8_t *buf = udp_raw_buf;
-	//parse the mmtp payload header for signaling message mode
-	uint8_t	mmtp_payload_header[2];
-	buf = extract(buf, mmtp_payload_header, 2);
+static void __signaling_message_parse_si_header(mmtp_payload_fragments_union_t* si_message, atsc3_cursor_t* cursor) {
+	uint8_t mmtp_payload_header = atsc3_cursor_read_u8(cursor);
 
-	/* TODO:
+	/*
 	 * f_i: bits 0-1 fragmentation indicator:
 	 * 0x00 = payload contains one or more complete signaling messages
 	 * 0x01 = payload contains the first fragment of a signaling message
 	 * 0x10 = payload contains a fragment of a signaling message that is neither first/last
 	 * 0x11 = payload contains the last fragment of a signaling message
 	 */
-
-	mmtp_packet->mmtp_signalling_message_fragments.si_fragmentation_indiciator = (mmtp_payload_header[0] >> 6) & 0x03;
+	si_message->mmtp_signalling_message_fragments.si_fragmentation_indiciator = (mmtp_payload_header >> 6) & 0x03;
 	//next 4 bits are 0x0000 reserved
-	if((mmtp_payload_header[0] >> 2) & 0xF) {
-		_MMTP_ERROR("signaling message mmtp header bits 2-5 are not reserved 0");
-	}
 
-	//bit 6 is additional Header
-	mmtp_packet->mmtp_signalling_message_fragments.si_additional_length_header = ((mmtp_payload_header[0] >> 1) & 0x1);
+	//bit 6 is additional Header, aggregated MSG_length is 32 bits instead of 16
+	si_message->mmtp_signalling_message_fragments.si_additional_length_header = ((mmtp_payload_header >> 1) & 0x1);
 
 	//bit 7 is Aggregation
-	mmtp_packet->mmtp_signalling_message_fragments.si_aggregation_flag = (mmtp_payload_header[0] & 0x1);
-	mmtp_packet->mmtp_signalling_message_fragments.si_fragmentation_counter = mmtp_payload_header[1];
+	si_message->mmtp_signalling_message_fragments.si_aggregation_flag = (mmtp_payload_header & 0x1);
+	si_message->mmtp_signalling_message_fragments.si_fragmentation_counter = atsc3_cursor_read_u8(cursor);
+}
 
-	if(mmtp_packet->mmtp_signalling_message_fragments.si_aggregation_flag) {
-		//read additional MSG_length attribute
-		uint8_t	mmtp_aggregation_msg_length[2];
-		buf = extract(buf, mmtp_aggregation_msg_length, 2);
+//message_id, version and length, leaves the cursor at the start of the message body
+static void __signaling_message_parse_message_header(mmtp_payload_fragments_union_t* si_message, atsc3_cursor_t* cursor) {
+	uint16_t message_id = atsc3_cursor_read_u16(cursor);
+	si_message->mmtp_signalling_message_fragments.message_id = message_id;
+	si_message->mmtp_signalling_message_fragments.version = atsc3_cursor_read_u8(cursor);
 
-		mmtp_packet->mmtp_signalling_message_fragments.si_aggregation_message_length = (mmtp_aggregation_msg_length[0] << 8) | mmtp_aggregation_msg_length[1];
+	if(__signaling_message_has_32bit_length(message_id)) {
+		si_message->mmtp_signalling_message_fragments.length = atsc3_cursor_read_u32(cursor);
+	} else {
+		si_message->mmtp_signalling_message_fragments.length = atsc3_cursor_read_u16(cursor);
+	}
+}
+
+uint8_t* signaling_message_parse_payload_header(mmtp_payload_fragments_union_t *mmtp_packet, uint8_t* udp_raw_buf, uint32_t udp_raw_buf_size) {
+
+	if(mmtp_packet->mmtp_packet_header.mmtp_payload_type != 0x02) {
+		_MMSM_ERROR("signaling_message_parse_payload_header: mmtp_payload_type 0x02 != 0x%x", mmtp_packet->mmtp_packet_header.mmtp_payload_type);
+		return NULL;
 	}
 
+	atsc3_cursor_t cursor;
+	atsc3_cursor_init(&cursor, udp_raw_buf, udp_raw_buf_size);
+
+	__signaling_message_parse_si_header(mmtp_packet, &cursor);
+
+	if(mmtp_packet->mmtp_signalling_message_fragments.si_aggregation_flag) {
+		//read additional MSG_length attribute
+		mmtp_packet->mmtp_signalling_message_fragments.si_aggregation_message_length = mmtp_packet->mmtp_signalling_message_fragments.si_additional_length_header ?
+				atsc3_cursor_read_u32(&cursor) : atsc3_cursor_read_u16(&cursor);
+	}
 
 	//create general signaling message format
-	uint8_t  message_id_t[2];
-	buf = extract(buf, message_id_t, 2);
-	uint16_t message_id = (message_id_t[0] << 8) | message_id_t[1];
-	mmtp_packet->mmtp_signalling_message_fragments.message_id = message_id;
-
-	uint8_t signaling_version;
-	buf = extract(buf, &signaling_version, 1);
-	mmtp_packet->mmtp_signalling_message_fragments.version = signaling_version;
-
-	if(message_id != PA_message && !(message_id > MPI_message_start && message_id < MPI_message_end)) {
-		uint8_t length[2];
-		buf = extract(buf, length, 2);
-		mmtp_packet->mmtp_signalling_message_fragments.length = (length[0] << 8) | length[1] ;
-	} else {
-		uint8_t length[4];
-		buf = extract(buf, length, 4);
-		mmtp_packet->mmtp_signalling_message_fragments.length = (length[0] << 24) | (length[1] << 16) | (length[2] << 8) | length[3];
+	__signaling_message_parse_message_header(mmtp_packet, &cursor);
+
+	if(cursor.overrun) {
+		_MMSM_ERROR("signaling_message_parse_payload_header: short payload: %u bytes", udp_raw_buf_size);
+		return NULL;
 	}
 
-	return buf;
+	return cursor.pos;
 }
 
 /**
  * create our concrete (void*) extension or (void*) payload instances
  */
-uint8_t* signaling_message_parse_payload_table(mmtp_payload_fragments_union_t *si_message, uint8_t* udp_raw_buf, uint8_t buf_size) {
+uint8_t* signaling_message_parse_payload_table(mmtp_payload_fragments_union_t *si_message, uint8_t* udp_raw_buf, uint32_t buf_size) {
 
 	if(si_message->mmtp_packet_header.mmtp_payload_type != 0x02) {
 		_MMSM_ERROR("signaling_message_parse_payload_header: mmtp_payload_type 0x02 != 0x%x", si_message->mmtp_packet_header.mmtp_payload_type);
 		return NULL;
 	}
 
-	uint8_t *buf = udp_raw_buf;
-	if(si_message->mmtp_signalling_message_fragments.message_id == PA_message) {
-		buf = pa_message_parse(si_message, buf, buf_size);
-	} else if(si_message->mmtp_signalling_message_fragments.message_id >= MPI_message_start && si_message->mmtp_signalling_message_fragments.message_id < MPI_message_end) {
-		buf = mpi_message_parse(si_message, buf, buf_size);
-	} else if(si_message->mmtp_signalling_message_fragments.message_id >= MPT_message_start && si_message->mmtp_signalling_message_fragments.message_id < MPT_message_end) {
-		buf = mpt_message_parse(si_message, buf, buf_size);
-	} else if(si_message->mmtp_signalling_message_fragments.message_id == CRI_message) {
-		//0x200
-		buf = si_message_not_supported(si_message, buf, buf_size);
-	} else if(si_message->mmtp_signalling_message_fragments.message_id == DCI_message) {
-		buf = si_message_not_supported(si_message, buf, buf_size);
-	} else if(si_message->mmtp_signalling_message_fragments.message_id == SSWR_message) {
-		buf = si_message_not_supported(si_message, buf, buf_size);
-	} else if(si_message->mmtp_signalling_message_fragments.message_id == AL_FEC_message) {
-		buf = si_message_not_supported(si_message, buf, buf_size);
-	} else if(si_message->mmtp_signalling_message_fragments.message_id == HRBM_message) {
-		buf = si_message_not_supported(si_message, buf, buf_size);
-	} else if(si_message->mmtp_signalling_message_fragments.message_id == MC_message) {
-		buf = si_message_not_supported(si_message, buf, buf_size);
-	} else if(si_message->mmtp_signalling_message_fragments.message_id == AC_message) {
-		buf = si_message_not_supported(si_message, buf, buf_size);
-	} else if(si_message->mmtp_signalling_message_fragments.message_id == AF_message) {
-		buf = si_message_not_supported(si_message, buf, buf_size);
-	} else if(si_message->mmtp_signalling_message_fragments.message_id == RQF_message) {
-		buf = si_message_not_supported(si_message, buf, buf_size);
-	} else if(si_message->mmtp_signalling_message_fragments.message_id == ADC_message) {
-		buf = si_message_not_supported(si_message, buf, buf_size);
-	} else if(si_message->mmtp_signalling_message_fragments.message_id == HRB_removal_message) {
-		buf = si_message_not_supported(si_message, buf, buf_size);
-	} else if(si_message->mmtp_signalling_message_fragments.message_id == LS_message) {
-		buf = si_message_not_supported(si_message, buf, buf_size);
-	} else if(si_message->mmtp_signalling_message_fragments.message_id == LR_message) {
-		buf = si_message_not_supported(si_message, buf, buf_size);
-	} else if(si_message->mmtp_signalling_message_fragments.message_id == NAMF_message) {
-		buf = si_message_not_supported(si_message, buf, buf_size);
-	} else if(si_message->mmtp_signalling_message_fragments.message_id == LDC_message) {
-		buf = si_message_not_supported(si_message, buf, buf_size);
-	} else {
-		buf = si_message_not_supported(si_message, buf, buf_size);
+	if(!udp_raw_buf) {
+		return NULL;
 	}
 
+	atsc3_cursor_t cursor;
+	atsc3_cursor_init(&cursor, udp_raw_buf, buf_size);
 
+	si_message->mmtp_signalling_message_fragments.payload = mmt_signaling_message_payload_parse_body(si_message->mmtp_signalling_message_fragments.message_id,
+			si_message->mmtp_signalling_message_fragments.version, si_message->mmtp_signalling_message_fragments.length, &cursor);
 
+	if(!si_message->mmtp_signalling_message_fragments.payload) {
+		si_message_not_supported(si_message);
+	}
 
-	return buf;
-
+	return cursor.pos;
 }
-////parse the mmtp payload header for signaling message mode
-//uint8_t	mmtp_payload_header[2];
-//buf = extract(buf, mmtp_payload_header, 2);
 
+/**
+ * body of one message, the cursor is advanced past length bytes whatever we make of them.
+ * returns NULL for messages we don't decode or can't parse
+ */
+void* mmt_signaling_message_payload_parse_body(uint16_t message_id, uint8_t version, uint32_t length, atsc3_cursor_t* cursor) {
+	uint8_t* body = atsc3_cursor_take(cursor, length);
+	if(!body) {
+		_MMSM_WARN("signaling message id: 0x%04x, length: %u past the end of the payload", message_id, length);
+		return NULL;
+	}
 
+	atsc3_cursor_t body_cursor;
+	atsc3_cursor_init(&body_cursor, body, length);
 
-uint8_t* pa_message_parse(mmtp_payload_fragments_union_t* si_message, uint8_t* udp_raw_buf, uint8_t udp_raw_buf_size) {
-	_MMSM_WARN("signalling information message id not supported: 0x%04x", si_message->mmtp_signalling_message_fragments.message_id);
+	if(message_id == PA_message) {
+		return pa_message_parse(&body_cursor);
+	} else if(message_id >= MPT_message_start && message_id <= MPT_message_end) {
+		return mpt_message_parse(message_id, version, length, &body_cursor);
+	} else if(message_id == HRBM_message) {
+		return hrbm_message_parse(&body_cursor);
+	}
 
+	//MPI (presentation information), CRI, DCI, AL_FEC, mmt_atsc3_message... are passed up undecoded
 	return NULL;
 }
-uint8_t* mpi_message_parse(mmtp_payload_fragments_union_t* si_message, uint8_t* buf, uint8_t buf_size) {
 
+static uint8_t* __signaling_message_dup(atsc3_cursor_t* cursor, size_t len) {
+	uint8_t* src = atsc3_cursor_take(cursor, len);
+	if(!src) {
+		return NULL;
+	}
 
-	return NULL;
+	//keep a trailing nul so ids and urls can be printed
+	uint8_t* dst = calloc(len + 1, sizeof(uint8_t));
+	if(dst) {
+		memcpy(dst, src, len);
+	}
+	return dst;
 }
-uint8_t* mpt_message_parse(mmtp_payload_fragments_union_t* si_message, uint8_t* buf, uint8_t buf_size) {
-	_MMSM_WARN("signalling information message id not supported: 0x%04x", si_message->mmtp_signalling_message_fragments.message_id);
 
+static void __mmt_general_location_info_parse(mmt_general_location_info_t* mmt_general_location_info, atsc3_cursor_t* cursor) {
+	mmt_general_location_info->location_type = atsc3_cursor_read_u8(cursor);
+
+	switch(mmt_general_location_info->location_type) {
+		case MMT_GENERAL_LOCATION_INFO_PACKET_ID:
+			mmt_general_location_info->packet_id = atsc3_cursor_read_u16(cursor);
+			break;
+
+		case MMT_GENERAL_LOCATION_INFO_IPV4:
+			mmt_general_location_info->ipv4_src_addr = atsc3_cursor_read_u32(cursor);
+			mmt_general_location_info->ipv4_dst_addr = atsc3_cursor_read_u32(cursor);
+			mmt_general_location_info->dst_port = atsc3_cursor_read_u16(cursor);
+			mmt_general_location_info->packet_id = atsc3_cursor_read_u16(cursor);
+			break;
+
+		case MMT_GENERAL_LOCATION_INFO_IPV6:
+		case MMT_GENERAL_LOCATION_INFO_MPEG2_TS_IPV6: {
+			uint8_t* addrs = atsc3_cursor_take(cursor, 32);
+			if(addrs) {
+				memcpy(mmt_general_location_info->ipv6_src_addr, addrs, 16);
+				memcpy(mmt_general_location_info->ipv6_dst_addr, addrs + 16, 16);
+			}
+			mmt_general_location_info->dst_port = atsc3_cursor_read_u16(cursor);
+			if(mmt_general_location_info->location_type == MMT_GENERAL_LOCATION_INFO_IPV6) {
+				mmt_general_location_info->packet_id = atsc3_cursor_read_u16(cursor);
+			} else {
+				mmt_general_location_info->MPEG_2_PID = atsc3_cursor_read_u16(cursor) & 0x1FFF;
+			}
+			break;
+		}
+
+		case MMT_GENERAL_LOCATION_INFO_MPEG2_TS:
+			mmt_general_location_info->network_id = atsc3_cursor_read_u16(cursor);
+			mmt_general_location_info->MPEG_2_transport_stream_id = atsc3_cursor_read_u16(cursor);
+			mmt_general_location_info->MPEG_2_PID = atsc3_cursor_read_u16(cursor) & 0x1FFF;
+			break;
+
+		case MMT_GENERAL_LOCATION_INFO_URL: {
+			uint8_t url_length = atsc3_cursor_read_u8(cursor);
+			mmt_general_location_info->url = (char*)__signaling_message_dup(cursor, url_length);
+			break;
+		}
+
+		default:
+			//0x06 (byte range) and up have no length we could skip by
+			_MMSM_WARN("mp_table: general_location_info location_type: 0x%02x not supported", mmt_general_location_info->location_type);
+			cursor->overrun = true;
+			break;
+	}
+}
+
+static mmt_signaling_message_mpu_timestamp_descriptor_t* __mpu_timestamp_descriptor_parse(uint16_t descriptor_tag, uint8_t descriptor_length, atsc3_cursor_t* cursor) {
+	mmt_signaling_message_mpu_timestamp_descriptor_t* mpu_timestamp_descriptor = calloc(1, sizeof(mmt_signaling_message_mpu_timestamp_descriptor_t));
+	if(!mpu_timestamp_descriptor) {
+		return NULL;
+	}
+	mpu_timestamp_descriptor->descriptor_tag = descriptor_tag;
+	mpu_timestamp_descriptor->descriptor_length = descriptor_length;
+	mpu_timestamp_descriptor->mpu_tuple_n = descriptor_length / 12;
+
+	if(mpu_timestamp_descriptor->mpu_tuple_n) {
+		mpu_timestamp_descriptor->mpu_tuple = calloc(mpu_timestamp_descriptor->mpu_tuple_n, sizeof(mmt_signaling_message_mpu_tuple_t));
+		if(!mpu_timestamp_descriptor->mpu_tuple) {
+			free(mpu_timestamp_descriptor);
+			return NULL;
+		}
+	}
+
+	for(int i=0; i < mpu_timestamp_descriptor->mpu_tuple_n; i++) {
+		mpu_timestamp_descriptor->mpu_tuple[i].mpu_sequence_number = atsc3_cursor_read_u32(cursor);
+		mpu_timestamp_descriptor->mpu_tuple[i].mpu_presentation_time = atsc3_cursor_read_u64(cursor);
+	}
+
+	return mpu_timestamp_descriptor;
+}
+
+static void __mp_table_asset_descriptors_parse(mp_table_asset_t* mp_table_asset, atsc3_cursor_t* cursor) {
+	while(atsc3_cursor_remaining(cursor) >= 3) {
+		uint16_t descriptor_tag = atsc3_cursor_read_u16(cursor);
+		//mmt descriptors we know of all have an 8 bit length
+		uint8_t descriptor_length = atsc3_cursor_read_u8(cursor);
+		uint8_t* descriptor = atsc3_cursor_take(cursor, descriptor_length);
+		if(!descriptor) {
+			_MMSM_WARN("mp_table: asset descriptor tag: 0x%04x, length: %u past the end of asset_descriptors", descriptor_tag, descriptor_length);
+			return;
+		}
+
+		if(descriptor_tag == MMT_MPU_TIMESTAMP_DESCRIPTOR_TAG && !mp_table_asset->mpu_timestamp_descriptor) {
+			atsc3_cursor_t descriptor_cursor;
+			atsc3_cursor_init(&descriptor_cursor, descriptor, descriptor_length);
+			mp_table_asset->mpu_timestamp_descriptor = __mpu_timestamp_descriptor_parse(descriptor_tag, descriptor_length, &descriptor_cursor);
+		}
+	}
+}
+
+static void __mp_table_asset_free(mp_table_asset_t* mp_table_asset) {
+	free(mp_table_asset->asset_id);
+
+	if(mp_table_asset->mmt_general_location_info) {
+		for(int i=0; i < mp_table_asset->location_count; i++) {
+			free(mp_table_asset->mmt_general_location_info[i].url);
+		}
+		free(mp_table_asset->mmt_general_location_info);
+	}
+
+	if(mp_table_asset->mpu_timestamp_descriptor) {
+		free(mp_table_asset->mpu_timestamp_descriptor->mpu_tuple);
+		free(mp_table_asset->mpu_timestamp_descriptor);
+	}
+	memset(mp_table_asset, 0, sizeof(mp_table_asset_t));
+}
+
+static int __mp_table_asset_parse(mp_table_asset_t* mp_table_asset, atsc3_cursor_t* cursor) {
+	//identifier_mapping()
+	mp_table_asset->identifier_type = atsc3_cursor_read_u8(cursor);
+	if(mp_table_asset->identifier_type == 0x00) {
+		mp_table_asset->asset_id_scheme = atsc3_cursor_read_u32(cursor);
+		mp_table_asset->asset_id_length = atsc3_cursor_read_u32(cursor);
+	} else {
+		//url, regex, dash representation id and private are all length prefixed
+		mp_table_asset->asset_id_length = atsc3_cursor_read_u16(cursor);
+	}
+	if(cursor->overrun || !(mp_table_asset->asset_id = __signaling_message_dup(cursor, mp_table_asset->asset_id_length))) {
+		return -1;
+	}
+
+	mp_table_asset->asset_type = atsc3_cursor_read_u32(cursor);
+
+	uint8_t flags = atsc3_cursor_read_u8(cursor);
+	mp_table_asset->default_asset_flag = (flags >> 1) & 0x1;
+	mp_table_asset->asset_clock_relation_flag = flags & 0x1;
+
+	if(mp_table_asset->asset_clock_relation_flag) {
+		mp_table_asset->asset_clock_relation_id = atsc3_cursor_read_u8(cursor);
+		mp_table_asset->asset_timescale_flag = atsc3_cursor_read_u8(cursor) & 0x1;
+		if(mp_table_asset->asset_timescale_flag) {
+			mp_table_asset->asset_timescale = atsc3_cursor_read_u32(cursor);
+		}
+	}
+
+	mp_table_asset->location_count = atsc3_cursor_read_u8(cursor);
+	if(cursor->overrun) {
+		return -1;
+	}
+	if(mp_table_asset->location_count) {
+		mp_table_asset->mmt_general_location_info = calloc(mp_table_asset->location_count, sizeof(mmt_general_location_info_t));
+		if(!mp_table_asset->mmt_general_location_info) {
+			return -1;
+		}
+	}
+	for(int i=0; i < mp_table_asset->location_count && !cursor->overrun; i++) {
+		__mmt_general_location_info_parse(&mp_table_asset->mmt_general_location_info[i], cursor);
+	}
+
+	mp_table_asset->asset_descriptors_length = atsc3_cursor_read_u16(cursor);
+	uint8_t* asset_descriptors = atsc3_cursor_take(cursor, mp_table_asset->asset_descriptors_length);
+	if(!asset_descriptors) {
+		return -1;
+	}
+
+	atsc3_cursor_t asset_descriptors_cursor;
+	atsc3_cursor_init(&asset_descriptors_cursor, asset_descriptors, mp_table_asset->asset_descriptors_length);
+	__mp_table_asset_descriptors_parse(mp_table_asset, &asset_descriptors_cursor);
+
+	return 0;
+}
+
+/**
+ * one mp_table(), header included. the cursor is left after the table even when it is malformed,
+ * assets before the one that failed are kept
+ */
+int mp_table_parse(mp_table_t* mp_table, atsc3_cursor_t* cursor) {
+	memset(mp_table, 0, sizeof(mp_table_t));
+
+	mp_table->table_id = atsc3_cursor_read_u8(cursor);
+	mp_table->version = atsc3_cursor_read_u8(cursor);
+	mp_table->length = atsc3_cursor_read_u16(cursor);
+
+	uint8_t* table = atsc3_cursor_take(cursor, mp_table->length);
+	if(!table) {
+		_MMSM_WARN("mp_table: table_id: 0x%02x, length: %u past the end of the message", mp_table->table_id, mp_table->length);
+		return -1;
+	}
+
+	atsc3_cursor_t table_cursor;
+	atsc3_cursor_init(&table_cursor, table, mp_table->length);
+
+	//reserved bits are not always set by senders, don't hold it against them
+	mp_table->mp_table_mode = atsc3_cursor_read_u8(&table_cursor) & 0x3;
+
+	if(mp_table->table_id == MP_table_complete || mp_table->table_id == MPT_message_start) {
+		mp_table->mmt_package_id_length = atsc3_cursor_read_u8(&table_cursor);
+		mp_table->mmt_package_id_byte = __signaling_message_dup(&table_cursor, mp_table->mmt_package_id_length);
+
+		mp_table->mp_table_descriptors_length = atsc3_cursor_read_u16(&table_cursor);
+		mp_table->mp_table_descriptors_byte = __signaling_message_dup(&table_cursor, mp_table->mp_table_descriptors_length);
+	}
+
+	mp_table->number_of_assets = atsc3_cursor_read_u8(&table_cursor);
+	if(table_cursor.overrun) {
+		return -1;
+	}
+
+	if(mp_table->number_of_assets) {
+		mp_table->mp_table_asset = calloc(mp_table->number_of_assets, sizeof(mp_table_asset_t));
+		if(!mp_table->mp_table_asset) {
+			mp_table->number_of_assets = 0;
+			return -1;
+		}
+	}
+
+	for(int i=0; i < mp_table->number_of_assets; i++) {
+		if(__mp_table_asset_parse(&mp_table->mp_table_asset[i], &table_cursor) || table_cursor.overrun) {
+			_MMSM_WARN("mp_table: table_id: 0x%02x, asset %d of %u is truncated", mp_table->table_id, i, mp_table->number_of_assets);
+
+			//keep the assets before it
+			__mp_table_asset_free(&mp_table->mp_table_asset[i]);
+			mp_table->number_of_assets = i;
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+mpt_message_t* mpt_message_parse(uint16_t message_id, uint8_t version, uint16_t length, atsc3_cursor_t* cursor) {
 	mpt_message_t* mpt_message = calloc(1, sizeof(mpt_message_t));
+	if(!mpt_message) {
+		return NULL;
+	}
 
-	uint8_t scratch[2];
-	buf = extract(buf, scratch, 2);
-	mpt_message->message_id = (scratch[0] << 8) | (scratch[1]);
+	mpt_message->message_id = message_id;
+	mpt_message->version = version;
+	mpt_message->length = length;
 
-	uint8_t scratch_single;
-	buf = extract(buf, &scratch_single, 1);
-	mpt_message->version = scratch_single;
+	if(mp_table_parse(&mpt_message->mp_table, cursor) && !mpt_message->mp_table.number_of_assets) {
+		mp_table_free(&mpt_message->mp_table);
+		free(mpt_message);
+		return NULL;
+	}
 
-	buf = extract(buf, scratch, 2);
-	mpt_message->length = (scratch[0] << 8) | (scratch[1]);
+	return mpt_message;
+}
 
-	si_message->mmtp_signalling_message_fragments.payload = (void*) mpt_message;
+pa_message_t* pa_message_parse(atsc3_cursor_t* cursor) {
+	pa_message_t* pa_message = calloc(1, sizeof(pa_message_t));
+	if(!pa_message) {
+		return NULL;
+	}
 
+	pa_message->number_of_tables = atsc3_cursor_read_u8(cursor);
+	if(pa_message->number_of_tables) {
+		pa_message->pa_table_header = calloc(pa_message->number_of_tables, sizeof(pa_table_header_t));
+		pa_message->mp_table = calloc(pa_message->number_of_tables, sizeof(mp_table_t));
+		if(!pa_message->pa_table_header || !pa_message->mp_table) {
+			mmt_signaling_message_payload_free(PA_message, pa_message);
+			return NULL;
+		}
+	}
 
-	buf = extract(buf, &scratch_single, 1);
-	mpt_message->mp_table.table_id = scratch_single;
+	for(int i=0; i < pa_message->number_of_tables; i++) {
+		pa_message->pa_table_header[i].table_id = atsc3_cursor_read_u8(cursor);
+		pa_message->pa_table_header[i].table_version = atsc3_cursor_read_u8(cursor);
+		pa_message->pa_table_header[i].table_length = atsc3_cursor_read_u16(cursor);
+	}
 
-	buf = extract(buf, &scratch_single, 1);
-	mpt_message->mp_table.version = scratch_single;
+	//tables follow in the order listed, stop at the first one that isn't an MP table as MPI tables are not decoded
+	for(int i=0; i < pa_message->number_of_tables && !cursor->overrun; i++) {
+		uint8_t table_id = pa_message->pa_table_header[i].table_id;
+		if(table_id < MPT_message_start || table_id > MPT_message_end) {
+			break;
+		}
+
+		int ret = mp_table_parse(&pa_message->mp_table[pa_message->mp_table_n], cursor);
+		if(!ret || pa_message->mp_table[pa_message->mp_table_n].number_of_assets) {
+			pa_message->mp_table_n++;
+		} else {
+			mp_table_free(&pa_message->mp_table[pa_message->mp_table_n]);
+		}
+		if(ret) {
+			break;
+		}
+	}
 
-	buf = extract(buf, scratch, 2);
-	mpt_message->mp_table.length = (scratch[0] << 8) | scratch[1];
+	return pa_message;
+}
 
-	buf = extract(buf, &scratch_single, 1);
-	if((scratch_single >> 2) != 0x3F) {
-		_MMSM_WARN("mp_table reserved 6 bits are not set")
+hrbm_message_t* hrbm_message_parse(atsc3_cursor_t* cursor) {
+	hrbm_message_t* hrbm_message = calloc(1, sizeof(hrbm_message_t));
+	if(!hrbm_message) {
+		return NULL;
 	}
 
-	mpt_message->mp_table.mp_table_mode = scratch_single & 0x2;
+	hrbm_message->max_buffer_size = atsc3_cursor_read_u32(cursor);
+	hrbm_message->fixed_end_to_end_delay = atsc3_cursor_read_u32(cursor);
+	hrbm_message->max_transmission_delay = atsc3_cursor_read_u32(cursor);
 
-	if(mpt_message->mp_table.table_id == 0x20 || mpt_message->mp_table.table_id == 0x11) {
-		//process packages & descriptors
-		_MMSM_WARN("mp_table processing for mmt_package_id not supported yet!");
+	if(cursor->overrun) {
+		_MMSM_WARN("hrbm_message: truncated");
+		free(hrbm_message);
+		return NULL;
 	}
 
+	return hrbm_message;
+}
 
-	buf = extract(buf, &scratch_single, 1);
-	mpt_message->mp_table.number_of_assets = scratch_single;
+bool mp_table_asset_get_packet_id(mp_table_asset_t* mp_table_asset, uint16_t* packet_id) {
+	for(int i=0; i < mp_table_asset->location_count; i++) {
+		if(mp_table_asset->mmt_general_location_info[i].location_type == MMT_GENERAL_LOCATION_INFO_PACKET_ID) {
+			*packet_id = mp_table_asset->mmt_general_location_info[i].packet_id;
+			return true;
+		}
+	}
+	return false;
+}
 
-	for(int i=0; i < mpt_message->mp_table.number_of_assets; i++ ) {
+static void __signaling_message_dispatch(mmt_signaling_message_reassembly_t* reassembly, uint16_t packet_id, atsc3_cursor_t* message_cursor,
+		mmt_signaling_message_f on_message, void* context) {
+	mmt_signaling_message_t mmt_signaling_message;
+	memset(&mmt_signaling_message, 0, sizeof(mmt_signaling_message_t));
 
+	mmt_signaling_message.packet_id = packet_id;
+	mmt_signaling_message.message_id = atsc3_cursor_read_u16(message_cursor);
+	mmt_signaling_message.version = atsc3_cursor_read_u8(message_cursor);
+	mmt_signaling_message.length = __signaling_message_has_32bit_length(mmt_signaling_message.message_id) ?
+			atsc3_cursor_read_u32(message_cursor) : atsc3_cursor_read_u16(message_cursor);
+
+	if(message_cursor->overrun) {
+		reassembly->stats.messages_malformed++;
+		return;
 	}
 
+	mmt_signaling_message.payload = mmt_signaling_message_payload_parse_body(mmt_signaling_message.message_id, mmt_signaling_message.version,
+			mmt_signaling_message.length, message_cursor);
+
+	reassembly->stats.messages++;
+	if(!mmt_signaling_message.payload) {
+		bool is_decoded = mmt_signaling_message.message_id == PA_message || mmt_signaling_message.message_id == HRBM_message ||
+				(mmt_signaling_message.message_id >= MPT_message_start && mmt_signaling_message.message_id <= MPT_message_end);
+		if(is_decoded) {
+			reassembly->stats.messages_malformed++;
+			return;
+		}
+		reassembly->stats.messages_not_supported++;
+	}
 
+	on_message(context, &mmt_signaling_message);
 
+	mmt_signaling_message_payload_free(mmt_signaling_message.message_id, mmt_signaling_message.payload);
+}
 
-	return NULL;
+static void __signaling_message_reassembly_reset(mmt_signaling_message_reassembly_t* reassembly, bool dropped) {
+	if(reassembly->in_progress && dropped) {
+		reassembly->stats.fragments_dropped++;
+	}
+	reassembly->in_progress = false;
+	reassembly->len = 0;
 }
 
+static int __signaling_message_reassembly_append(mmt_signaling_message_reassembly_t* reassembly, atsc3_cursor_t* cursor) {
+	size_t len = atsc3_cursor_remaining(cursor);
+	if(reassembly->len + len > MMT_SIGNALING_MESSAGE_REASSEMBLY_MAX) {
+		return -1;
+	}
+
+	if(reassembly->len + len > reassembly->capacity) {
+		size_t capacity = reassembly->capacity ? reassembly->capacity : 4096;
+		while(capacity < reassembly->len + len) {
+			capacity *= 2;
+		}
+		uint8_t* buf = realloc(reassembly->buf, capacity);
+		if(!buf) {
+			return -1;
+		}
+		reassembly->buf = buf;
+		reassembly->capacity = capacity;
+	}
+
+	memcpy(reassembly->buf + reassembly->len, atsc3_cursor_take(cursor, len), len);
+	reassembly->len += len;
 
-uint8_t* si_message_not_supported(mmtp_payload_fragments_union_t* si_message, uint8_t* udp_raw_buf, uint8_t udp_raw_buf_size) {
+	return 0;
+}
+
+int mmt_signaling_message_payload_parse(mmt_signaling_message_reassembly_t* reassembly, mmtp_payload_fragments_union_t* si_message, atsc3_cursor_t* cursor,
+		mmt_signaling_message_f on_message, void* context) {
+
+	if(si_message->mmtp_packet_header.mmtp_payload_type != 0x02) {
+		_MMSM_ERROR("mmt_signaling_message_payload_parse: mmtp_payload_type 0x02 != 0x%x", si_message->mmtp_packet_header.mmtp_payload_type);
+		return -1;
+	}
+
+	uint16_t packet_id = si_message->mmtp_packet_header.mmtp_packet_id;
+	__signaling_message_parse_si_header(si_message, cursor);
+	if(cursor->overrun) {
+		reassembly->stats.messages_malformed++;
+		return -1;
+	}
+
+	__signalling_message_fragments_t* si_header = &si_message->mmtp_signalling_message_fragments;
+
+	if(si_header->si_fragmentation_indiciator == SI_FRAGMENTATION_INDICATOR_COMPLETE) {
+		__signaling_message_reassembly_reset(reassembly, true);
+
+		if(!si_header->si_aggregation_flag) {
+			__signaling_message_dispatch(reassembly, packet_id, cursor, on_message, context);
+			return 0;
+		}
+
+		//aggregated messages, each with its own MSG_length
+		while(atsc3_cursor_remaining(cursor)) {
+			uint32_t message_length = si_header->si_additional_length_header ? atsc3_cursor_read_u32(cursor) : atsc3_cursor_read_u16(cursor);
+			uint8_t* message = atsc3_cursor_take(cursor, message_length);
+			if(!message) {
+				reassembly->stats.messages_malformed++;
+				return -1;
+			}
+			si_header->si_aggregation_message_length = message_length;
+
+			atsc3_cursor_t message_cursor;
+			atsc3_cursor_init(&message_cursor, message, message_length);
+			__signaling_message_dispatch(reassembly, packet_id, &message_cursor, on_message, context);
+		}
+		return 0;
+	}
+
+	//fragments of one message, the fragmentation_counter counts down the fragments still to come
+	if(si_header->si_fragmentation_indiciator == SI_FRAGMENTATION_INDICATOR_FIRST) {
+		__signaling_message_reassembly_reset(reassembly, true);
+		reassembly->in_progress = true;
+		reassembly->packet_id = packet_id;
+	} else if(!reassembly->in_progress || reassembly->packet_id != packet_id || reassembly->next_fragmentation_counter != si_header->si_fragmentation_counter) {
+		__signaling_message_reassembly_reset(reassembly, true);
+		return 0;
+	}
+
+	if(__signaling_message_reassembly_append(reassembly, cursor)) {
+		__signaling_message_reassembly_reset(reassembly, true);
+		return -1;
+	}
+	reassembly->next_fragmentation_counter = si_header->si_fragmentation_counter - 1;
+
+	if(si_header->si_fragmentation_indiciator == SI_FRAGMENTATION_INDICATOR_LAST) {
+		atsc3_cursor_t message_cursor;
+		atsc3_cursor_init(&message_cursor, reassembly->buf, reassembly->len);
+		__signaling_message_dispatch(reassembly, packet_id, &message_cursor, on_message, context);
+		__signaling_message_reassembly_reset(reassembly, false);
+	}
+
+	return 0;
+}
+
+void mmt_signaling_message_reassembly_free(mmt_signaling_message_reassembly_t* reassembly) {
+	free(reassembly->buf);
+	memset(reassembly, 0, sizeof(mmt_signaling_message_reassembly_t));
+}
+
+void mmt_signaling_message_stats_dump(mmt_signaling_message_reassembly_t* reassembly) {
+	_MMSM_INFO("mmt_signaling_message: messages: %llu, not supported: %llu, malformed: %llu, fragmented messages dropped: %llu",
+			(unsigned long long)reassembly->stats.messages,
+			(unsigned long long)reassembly->stats.messages_not_supported,
+			(unsigned long long)reassembly->stats.messages_malformed,
+			(unsigned long long)reassembly->stats.fragments_dropped);
+}
+
+void si_message_not_supported(mmtp_payload_fragments_union_t* si_message) {
 	_MMSM_WARN("signalling information message id not supported: 0x%04x", si_message->mmtp_signalling_message_fragments.message_id);
+}
 
-	return NULL;
+void mp_table_free(mp_table_t* mp_table) {
+	for(int i=0; i < mp_table->number_of_assets; i++) {
+		__mp_table_asset_free(&mp_table->mp_table_asset[i]);
+	}
+	free(mp_table->mp_table_asset);
+	free(mp_table->mmt_package_id_byte);
+	free(mp_table->mp_table_descriptors_byte);
+	memset(mp_table, 0, sizeof(mp_table_t));
+}
+
+void mmt_signaling_message_payload_free(uint16_t message_id, void* payload) {
+	if(!payload) {
+		return;
+	}
+
+	if(message_id == PA_message) {
+		pa_message_t* pa_message = payload;
+		for(int i=0; i < pa_message->mp_table_n; i++) {
+			mp_table_free(&pa_message->mp_table[i]);
+		}
+		free(pa_message->mp_table);
+		free(pa_message->pa_table_header);
+	} else if(message_id >= MPT_message_start && message_id <= MPT_message_end) {
+		mp_table_free(&((mpt_message_t*)payload)->mp_table);
+	}
+
+	free(payload);
+}
+
+void signaling_message_free(mmtp_payload_fragments_union_t* si_message) {
+	mmt_signaling_message_payload_free(si_message->mmtp_signalling_message_fragments.message_id, si_message->mmtp_signalling_message_fragments.payload);
+	si_message->mmtp_signalling_message_fragments.payload = NULL;
 }
 
+void mp_table_dump(mp_table_t* mp_table) {
+	_MMSM_INFO(" MP Table");
+	_MMSM_INFO("  table_id         : 0x%02x", mp_table->table_id);
+	_MMSM_INFO("  version          : %d", mp_table->version);
+	_MMSM_INFO("  length           : %hu", mp_table->length);
+	_MMSM_INFO("  mp_table_mode    : %d", mp_table->mp_table_mode);
+	_MMSM_INFO("  number_of_assets : %d", mp_table->number_of_assets);
+
+	for(int i=0; i < mp_table->number_of_assets; i++) {
+		mp_table_asset_t* mp_table_asset = &mp_table->mp_table_asset[i];
+		_MMSM_INFO("  asset %d: identifier_type: %d, asset_id_length: %u, asset_type: %c%c%c%c, default_asset_flag: %d, asset_timescale: %u",
+				i, mp_table_asset->identifier_type, mp_table_asset->asset_id_length,
+				(mp_table_asset->asset_type >> 24) & 0xFF, (mp_table_asset->asset_type >> 16) & 0xFF, (mp_table_asset->asset_type >> 8) & 0xFF, mp_table_asset->asset_type & 0xFF,
+				mp_table_asset->default_asset_flag, mp_table_asset->asset_timescale);
+
+		for(int j=0; j < mp_table_asset->location_count; j++) {
+			_MMSM_INFO("   location %d: location_type: 0x%02x, packet_id: %hu", j,
+					mp_table_asset->mmt_general_location_info[j].location_type, mp_table_asset->mmt_general_location_info[j].packet_id);
+		}
+
+		if(mp_table_asset->mpu_timestamp_descriptor) {
+			for(int j=0; j < mp_table_asset->mpu_timestamp_descriptor->mpu_tuple_n; j++) {
+				_MMSM_INFO("   mpu_sequence_number: %u, mpu_presentation_time: 0x%016llx",
+						mp_table_asset->mpu_timestamp_descriptor->mpu_tuple[j].mpu_sequence_number,
+						(unsigned long long)mp_table_asset->mpu_timestamp_descriptor->mpu_tuple[j].mpu_presentation_time);
+			}
+		}
+	}
+}
 
 void signaling_message_dump(mmtp_payload_fragments_union_t* mmtp_payload_fragments) {
 	if(mmtp_payload_fragments->mmtp_packet_header.mmtp_payload_type != 0x02) {
@@ -261,10 +727,17 @@ void signaling_message_dump(mmtp_payload_fragments_union_t* mmtp_payload_fragmen
 	_MMSM_INFO(" Payload          : %p", 			mmtp_payload_fragments->mmtp_signalling_message_fragments.payload);
 	_MMSM_INFO("------------------");
 
-
-
-
-
-	//_MMSM_INFO("--------------------------------------");
+	uint16_t message_id = mmtp_payload_fragments->mmtp_signalling_message_fragments.message_id;
+	void* payload = mmtp_payload_fragments->mmtp_signalling_message_fragments.payload;
+	if(payload && message_id >= MPT_message_start && message_id <= MPT_message_end) {
+		mp_table_dump(&((mpt_message_t*)payload)->mp_table);
+	} else if(payload && message_id == PA_message) {
+		for(int i=0; i < ((pa_message_t*)payload)->mp_table_n; i++) {
+			mp_table_dump(&((pa_message_t*)payload)->mp_table[i]);
+		}
+	} else if(payload && message_id == HRBM_message) {
+		_MMSM_INFO(" HRBM max_buffer_size: %u, fixed_end_to_end_delay: %u ms, max_transmission_delay: %u ms",
+				((hrbm_message_t*)payload)->max_buffer_size, ((hrbm_message_t*)payload)->fixed_end_to_end_delay, ((hrbm_message_t*)payload)->max_transmission_delay);
+	}
 
 }
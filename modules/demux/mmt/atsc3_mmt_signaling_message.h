@@ -69,6 +69,84 @@ raw base64 payload:
 
 //Reserved for private use 0x8000 ~ 0xFFFF
 
+//mmt_atsc3_message, A/331
+#define MMT_ATSC3_message	0x8100
+
+//general_location_info() location_type values
+#define MMT_GENERAL_LOCATION_INFO_PACKET_ID			0x00
+#define MMT_GENERAL_LOCATION_INFO_IPV4				0x01
+#define MMT_GENERAL_LOCATION_INFO_IPV6				0x02
+#define MMT_GENERAL_LOCATION_INFO_MPEG2_TS			0x03
+#define MMT_GENERAL_LOCATION_INFO_MPEG2_TS_IPV6		0x04
+#define MMT_GENERAL_LOCATION_INFO_URL				0x05
+
+//descriptor tags
+#define MMT_MPU_TIMESTAMP_DESCRIPTOR_TAG	0x0001
+
+//complete MP table, 0x11 ~ 0x1F are subsets
+#define MP_table_complete	0x20
+
+//si payload header f_i
+#define SI_FRAGMENTATION_INDICATOR_COMPLETE	0x0
+#define SI_FRAGMENTATION_INDICATOR_FIRST	0x1
+#define SI_FRAGMENTATION_INDICATOR_MIDDLE	0x2
+#define SI_FRAGMENTATION_INDICATOR_LAST		0x3
+
+//largest signaling message we will put back together from fragments
+#define MMT_SIGNALING_MESSAGE_REASSEMBLY_MAX	(256 * 1024)
+
+typedef struct mmt_general_location_info {
+	uint8_t		location_type;
+
+	uint16_t	packet_id;				//0x00, 0x01, 0x02
+	uint32_t	ipv4_src_addr;			//0x01
+	uint32_t	ipv4_dst_addr;
+	uint8_t		ipv6_src_addr[16];		//0x02, 0x04
+	uint8_t		ipv6_dst_addr[16];
+	uint16_t	dst_port;				//0x01, 0x02, 0x04
+	uint16_t	network_id;				//0x03
+	uint16_t	MPEG_2_transport_stream_id;
+	uint16_t	MPEG_2_PID;				//13 bits, 0x03, 0x04
+	char*		url;					//0x05, nul terminated
+} mmt_general_location_info_t;
+
+typedef struct mmt_signaling_message_mpu_tuple {
+	uint32_t mpu_sequence_number;
+	uint64_t mpu_presentation_time;
+} mmt_signaling_message_mpu_tuple_t;
+
+typedef struct mmt_signaling_message_mpu_timestamp_descriptor {
+	uint16_t							descriptor_tag;
+	uint8_t								descriptor_length;
+	uint8_t								mpu_tuple_n; //mpu_tuple_n = descriptor_length/12 = (32+64)/8
+	mmt_signaling_message_mpu_tuple_t*	mpu_tuple;
+} mmt_signaling_message_mpu_timestamp_descriptor_t;
+
+typedef struct mp_table_asset {
+	//identifier_mapping()
+	uint8_t		identifier_type;
+	uint32_t	asset_id_scheme;		//identifier_type == 0x00
+	uint32_t	asset_id_length;		//or the length of the url/regex/dash representation id
+	uint8_t*	asset_id;
+
+	uint32_t	asset_type;				//fourcc, e.g. hev1, mp4a
+	//6 bits reserved
+	uint8_t		default_asset_flag;
+	uint8_t		asset_clock_relation_flag;
+	uint8_t		asset_clock_relation_id;
+	//7bits reserved
+	uint8_t		asset_timescale_flag;
+	uint32_t	asset_timescale;
+
+	//asset_location (
+	uint8_t								location_count;
+	mmt_general_location_info_t*		mmt_general_location_info;
+
+	//asset_descriptors (
+	uint16_t	asset_descriptors_length;
+	mmt_signaling_message_mpu_timestamp_descriptor_t* mpu_timestamp_descriptor;
+} mp_table_asset_t;
+
 typedef struct mp_table {
 	uint8_t		table_id;
 	uint8_t		version;
@@ -86,26 +164,8 @@ typedef struct mp_table {
 	uint16_t	mp_table_descriptors_length;
 	uint8_t*	mp_table_descriptors_byte;
 
-	uint8_t		number_of_assets;
-
-	//identifer_mapping()
-	uint32_t	asset_type;
-	//6 bits reserved
-	uint8_t		default_asset_flag;
-
-	uint8_t		asset_clock_relation_flag;
-	uint8_t		asset_clock_relation_id;
-	//7bits reserved
-	uint8_t		asset_timescale_flag;
-	uint32_t	asset_timescale;
-
-	//asset_location (
-	uint8_t		location_count;
-	//mmt_generation_location_info() //?
-
-	//asset_descriptors (
-	uint16_t	asset_descriptors_length;
-	uint8_t		asset_descriptors_byte;
+	uint8_t				number_of_assets;
+	mp_table_asset_t*	mp_table_asset;
 } mp_table_t;
 
 typedef struct mpt_message {
@@ -116,27 +176,92 @@ typedef struct mpt_message {
 
 } mpt_message_t;
 
-typedef struct mmt_signaling_message_mpu_tuple {
-	uint32_t mpu_sequence_number;
-	uint64_t mpu_presentation_time;
-} mmt_signaling_message_mpu_tuple_t;
+typedef struct pa_table_header {
+	uint8_t		table_id;
+	uint8_t		table_version;
+	uint16_t	table_length;
+} pa_table_header_t;
+
+//only the MP tables a PA message carries are decoded
+typedef struct pa_message {
+	uint8_t				number_of_tables;
+	pa_table_header_t*	pa_table_header;
+
+	uint8_t				mp_table_n;
+	mp_table_t*			mp_table;
+} pa_message_t;
+
+//hypothetical receiver buffer model, delays are in ms
+typedef struct hrbm_message {
+	uint32_t	max_buffer_size;
+	uint32_t	fixed_end_to_end_delay;
+	uint32_t	max_transmission_delay;
+} hrbm_message_t;
 
-typedef struct mmt_signaling_message_mpu_timestamp_descriptor {
-	uint16_t							descriptor_tag;
-	uint8_t								descriptor_length;
-	uint8_t								mpu_tuple_n; //mpu_tuple_n = descriptor_length/12 = (32+64)/8
-	mmt_signaling_message_mpu_tuple_t*	mpu_tuple;
-} mmt_signaling_message_mpu_timestamp_descriptor_t;
+/**
+ * one complete signaling message out of a payload, payload points to a pa_message_t, mpt_message_t or
+ * hrbm_message_t depending on message_id, or is NULL for messages we don't decode.
+ * only valid for the duration of the callback
+ */
+typedef struct mmt_signaling_message {
+	uint16_t	packet_id;
+	uint16_t	message_id;
+	uint8_t		version;
+	uint32_t	length;
+	void*		payload;
+} mmt_signaling_message_t;
+
+typedef void (*mmt_signaling_message_f)(void* context, mmt_signaling_message_t* mmt_signaling_message);
+
+typedef struct mmt_signaling_message_stats {
+	uint64_t	messages;
+	uint64_t	messages_not_supported;
+	uint64_t	messages_malformed;
+	uint64_t	fragments_dropped;
+} mmt_signaling_message_stats_t;
+
+//fragments of one message are gathered here until f_i says last
+typedef struct mmt_signaling_message_reassembly {
+	bool		in_progress;
+	uint16_t	packet_id;
+	uint8_t		next_fragmentation_counter;
+	uint8_t*	buf;
+	size_t		len;
+	size_t		capacity;
+
+	mmt_signaling_message_stats_t stats;
+} mmt_signaling_message_reassembly_t;
+
+/**
+ * parse the signaling message payload following the mmtp packet header in si_message,
+ * handing each complete message to on_message. fragmented messages are held in reassembly
+ * until their last fragment arrives. returns -1 if the payload could not be parsed
+ */
+int mmt_signaling_message_payload_parse(mmt_signaling_message_reassembly_t* reassembly, mmtp_payload_fragments_union_t* si_message, atsc3_cursor_t* cursor,
+		mmt_signaling_message_f on_message, void* context);
+
+void mmt_signaling_message_reassembly_free(mmt_signaling_message_reassembly_t* reassembly);
+void mmt_signaling_message_stats_dump(mmt_signaling_message_reassembly_t* reassembly);
+
+uint8_t* signaling_message_parse_payload_header(mmtp_payload_fragments_union_t* si_message, uint8_t* udp_raw_buf, uint32_t udp_raw_buf_size);
+uint8_t* signaling_message_parse_payload_table(mmtp_payload_fragments_union_t* si_message, uint8_t* udp_raw_buf, uint32_t udp_raw_buf_size);
 
+pa_message_t* pa_message_parse(atsc3_cursor_t* cursor);
+mpt_message_t* mpt_message_parse(uint16_t message_id, uint8_t version, uint16_t length, atsc3_cursor_t* cursor);
+hrbm_message_t* hrbm_message_parse(atsc3_cursor_t* cursor);
+int mp_table_parse(mp_table_t* mp_table, atsc3_cursor_t* cursor);
 
-uint8_t* signaling_message_parse_payload_header(mmtp_payload_fragments_union_t* si_message, uint8_t* udp_raw_buf, uint8_t udp_raw_buf_size);
+void si_message_not_supported(mmtp_payload_fragments_union_t* si_message);
 
-uint8_t* pa_message_parse(mmtp_payload_fragments_union_t* si_message, uint8_t* udp_raw_buf, uint8_t udp_raw_buf_size);
-uint8_t* mpi_message_parse(mmtp_payload_fragments_union_t* si_message, uint8_t* udp_raw_buf, uint8_t udp_raw_buf_size);
-uint8_t* mpt_message_parse(mmtp_payload_fragments_union_t* si_message, uint8_t* udp_raw_buf, uint8_t udp_raw_buf_size);
+void* mmt_signaling_message_payload_parse_body(uint16_t message_id, uint8_t version, uint32_t length, atsc3_cursor_t* cursor);
+void mmt_signaling_message_payload_free(uint16_t message_id, void* payload);
+void mp_table_free(mp_table_t* mp_table);
 
-uint8_t* si_message_not_supported(mmtp_payload_fragments_union_t* si_message, uint8_t* udp_raw_buf, uint8_t udp_raw_buf_size);
+//the first packet_id location of an asset, i.e. carried in this mmtp flow. returns false if there is none
+bool mp_table_asset_get_packet_id(mp_table_asset_t* mp_table_asset, uint16_t* packet_id);
 
+void signaling_message_free(mmtp_payload_fragments_union_t* si_message);
 void signaling_message_dump(mmtp_payload_fragments_union_t* si_message);
+void mp_table_dump(mp_table_t* mp_table);
 
 #endif /* MODULES_DEMUX_MMT_ATSC3_MMT_SIGNALING_MESSAGE_H_ */
@@ -19,12 +19,17 @@
 static char* __get_test_mmt_signaling_message_mpu_timestamp_descriptor()	{ return "62020023afb90000002b4f2f00351058a40000000012ce003f12ce003b04010000000000000000101111111111111111111111111111111168657631fd00ff00015f9001000023000f00010c000016cedfc2afb8d6459fff"; }
 
 int test_mmt_signaling_message_mpu_timestamp_descriptor_table(char* base64_payload);
+int test_mmt_signaling_message_aggregated(char* base64_payload);
+int test_mmt_signaling_message_fragmented(char* base64_payload);
 
 int main() {
+	int failed = 0;
 
-	test_mmt_signaling_message_mpu_timestamp_descriptor_table(__get_test_mmt_signaling_message_mpu_timestamp_descriptor());
+	failed |= test_mmt_signaling_message_mpu_timestamp_descriptor_table(__get_test_mmt_signaling_message_mpu_timestamp_descriptor());
+	failed |= test_mmt_signaling_message_aggregated(__get_test_mmt_signaling_message_mpu_timestamp_descriptor());
+	failed |= test_mmt_signaling_message_fragmented(__get_test_mmt_signaling_message_mpu_timestamp_descriptor());
 
-	return 0;
+	return failed;
 }
 
 
@@ -45,6 +50,32 @@ void __create_binary_payload(char *test_payload_base64, uint8_t **binary_payload
 }
 
 
+//one hev1 asset on packet_id 35 at 90 kHz, with mpu 5838 presented at 0xdfc2afb8d6459fff
+static int __test_check_sample_mp_table(mp_table_t* mp_table) {
+	if(mp_table->table_id != 0x12 || mp_table->number_of_assets != 1) {
+		_MMSM_ERROR("test mp_table: table_id: 0x%02x, number_of_assets: %d", mp_table->table_id, mp_table->number_of_assets);
+		return -1;
+	}
+
+	mp_table_asset_t* mp_table_asset = &mp_table->mp_table_asset[0];
+	uint16_t packet_id = 0;
+	if(mp_table_asset->asset_id_length != 16 || mp_table_asset->asset_id[15] != 0x11 || mp_table_asset->asset_type != 0x68657631 ||
+		mp_table_asset->asset_timescale != 90000 || !mp_table_asset_get_packet_id(mp_table_asset, &packet_id) || packet_id != 35) {
+		_MMSM_ERROR("test mp_table: asset_id_length: %u, asset_type: 0x%08x, timescale: %u, packet_id: %hu",
+				mp_table_asset->asset_id_length, mp_table_asset->asset_type, mp_table_asset->asset_timescale, packet_id);
+		return -1;
+	}
+
+	mmt_signaling_message_mpu_timestamp_descriptor_t* mpu_timestamp_descriptor = mp_table_asset->mpu_timestamp_descriptor;
+	if(!mpu_timestamp_descriptor || mpu_timestamp_descriptor->mpu_tuple_n != 1 || mpu_timestamp_descriptor->mpu_tuple[0].mpu_sequence_number != 5838 ||
+		mpu_timestamp_descriptor->mpu_tuple[0].mpu_presentation_time != 0xdfc2afb8d6459fffULL) {
+		_MMSM_ERROR("test mp_table: missing or wrong MPU_timestamp_descriptor");
+		return -1;
+	}
+
+	return 0;
+}
+
 int test_mmt_signaling_message_mpu_timestamp_descriptor_table(char* base64_payload) {
 
 	uint8_t* binary_payload;
@@ -67,18 +98,156 @@ int test_mmt_signaling_message_mpu_timestamp_descriptor_table(char* base64_paylo
 	new_size = binary_payload_size - (raw_packet_ptr - binary_payload);
 	raw_packet_ptr = signaling_message_parse_payload_table(mmtp_payload_fragments, raw_packet_ptr, new_size);
 
+	if(!mmtp_payload_fragments->mmtp_signalling_message_fragments.payload) {
+		_MMSM_ERROR("test_mmt_signaling_message_mpu_timestamp_descriptor_table - no mpt_message");
+		return -1;
+	}
 
 	signaling_message_dump(mmtp_payload_fragments);
 
+	int ret = __test_check_sample_mp_table(&((mpt_message_t*)mmtp_payload_fragments->mmtp_signalling_message_fragments.payload)->mp_table);
+
+	signaling_message_free(mmtp_payload_fragments);
+	free(mmtp_payload_fragments);
+	free(binary_payload);
+
+	return ret;
+}
+
+typedef struct test_messages {
+	int				count;
+	uint16_t		message_id[4];
+	int				mp_table_ok;
+	hrbm_message_t	hrbm_message;
+} test_messages_t;
+
+static void __test_on_message(void* context, mmt_signaling_message_t* mmt_signaling_message) {
+	test_messages_t* test_messages = context;
+	if(test_messages->count < 4) {
+		test_messages->message_id[test_messages->count] = mmt_signaling_message->message_id;
+	}
+	test_messages->count++;
+
+	if(mmt_signaling_message->message_id >= MPT_message_start && mmt_signaling_message->message_id <= MPT_message_end && mmt_signaling_message->payload) {
+		test_messages->mp_table_ok = !__test_check_sample_mp_table(&((mpt_message_t*)mmt_signaling_message->payload)->mp_table);
+	} else if(mmt_signaling_message->message_id == HRBM_message && mmt_signaling_message->payload) {
+		test_messages->hrbm_message = *(hrbm_message_t*)mmt_signaling_message->payload;
+	}
+}
 
+/**
+ * build a signaling packet from the mmtp header of the sample, with our own si payload header and body
+ */
+static int __test_parse_packet(mmt_signaling_message_reassembly_t* reassembly, uint8_t* mmtp_header, size_t mmtp_header_size,
+		uint8_t si_header, uint8_t si_fragmentation_counter, uint8_t* body, size_t body_size, test_messages_t* test_messages) {
+	uint8_t packet[1500];
+	memcpy(packet, mmtp_header, mmtp_header_size);
+	packet[mmtp_header_size] = si_header;
+	packet[mmtp_header_size + 1] = si_fragmentation_counter;
+	memcpy(&packet[mmtp_header_size + 2], body, body_size);
+
+	mmtp_payload_fragments_union_t mmtp_payload_fragments;
+	memset(&mmtp_payload_fragments, 0, sizeof(mmtp_payload_fragments_union_t));
+
+	atsc3_cursor_t cursor;
+	atsc3_cursor_init(&cursor, packet, mmtp_header_size + 2 + body_size);
+	if(mmtp_packet_header_parse_from_cursor(&mmtp_payload_fragments, &cursor)) {
+		return -1;
+	}
+
+	return mmt_signaling_message_payload_parse(reassembly, &mmtp_payload_fragments, &cursor, __test_on_message, test_messages);
+}
+
+//split the sample's mmtp header from its single MPT message (message_id onwards)
+static void __test_split_sample(char* base64_payload, uint8_t** binary_payload, size_t* mmtp_header_size, uint8_t** message, size_t* message_size) {
+	int binary_payload_size;
+	__create_binary_payload(base64_payload, binary_payload, &binary_payload_size);
+
+	mmtp_payload_fragments_union_t mmtp_payload_fragments;
+	memset(&mmtp_payload_fragments, 0, sizeof(mmtp_payload_fragments_union_t));
+	uint8_t* raw_packet_ptr = mmtp_packet_header_parse_from_raw_packet(&mmtp_payload_fragments, *binary_payload, binary_payload_size);
+
+	*mmtp_header_size = raw_packet_ptr - *binary_payload;
+	*message = raw_packet_ptr + 2;
+	*message_size = binary_payload_size - *mmtp_header_size - 2;
+}
+
+//an MPT and an HRBM message aggregated in one payload
+int test_mmt_signaling_message_aggregated(char* base64_payload) {
+	uint8_t* binary_payload;
+	size_t mmtp_header_size;
+	uint8_t* mpt;
+	size_t mpt_size;
+	__test_split_sample(base64_payload, &binary_payload, &mmtp_header_size, &mpt, &mpt_size);
+
+	uint8_t hrbm[] = { 0x02, 0x04, 0x00, 0x00, 0x0c, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x03, 0xe8, 0x00, 0x00, 0x00, 0xc8 };
+
+	uint8_t body[512];
+	size_t body_size = 0;
+	body[body_size++] = (mpt_size >> 8) & 0xFF;
+	body[body_size++] = mpt_size & 0xFF;
+	memcpy(&body[body_size], mpt, mpt_size);
+	body_size += mpt_size;
+	body[body_size++] = 0x00;
+	body[body_size++] = sizeof(hrbm);
+	memcpy(&body[body_size], hrbm, sizeof(hrbm));
+	body_size += sizeof(hrbm);
+
+	mmt_signaling_message_reassembly_t reassembly;
+	memset(&reassembly, 0, sizeof(mmt_signaling_message_reassembly_t));
+	test_messages_t test_messages;
+	memset(&test_messages, 0, sizeof(test_messages_t));
+
+	int ret = __test_parse_packet(&reassembly, binary_payload, mmtp_header_size, 0x01, 0, body, body_size, &test_messages);
+
+	if(ret || test_messages.count != 2 || test_messages.message_id[0] != 0x0012 || test_messages.message_id[1] != HRBM_message || !test_messages.mp_table_ok ||
+		test_messages.hrbm_message.max_buffer_size != 0x100000 || test_messages.hrbm_message.fixed_end_to_end_delay != 1000 || test_messages.hrbm_message.max_transmission_delay != 200) {
+		_MMSM_ERROR("test_mmt_signaling_message_aggregated: ret: %d, messages: %d, mp_table ok: %d, fixed_end_to_end_delay: %u",
+				ret, test_messages.count, test_messages.mp_table_ok, test_messages.hrbm_message.fixed_end_to_end_delay);
+		return -1;
+	}
+
+	mmt_signaling_message_reassembly_free(&reassembly);
+	free(binary_payload);
+	return 0;
+}
+
+//the MPT split over three packets, then again with the middle one lost
+int test_mmt_signaling_message_fragmented(char* base64_payload) {
+	uint8_t* binary_payload;
+	size_t mmtp_header_size;
+	uint8_t* mpt;
+	size_t mpt_size;
+	__test_split_sample(base64_payload, &binary_payload, &mmtp_header_size, &mpt, &mpt_size);
+
+	mmt_signaling_message_reassembly_t reassembly;
+	memset(&reassembly, 0, sizeof(mmt_signaling_message_reassembly_t));
+	test_messages_t test_messages;
+	memset(&test_messages, 0, sizeof(test_messages_t));
+
+	__test_parse_packet(&reassembly, binary_payload, mmtp_header_size, SI_FRAGMENTATION_INDICATOR_FIRST << 6, 2, mpt, 20, &test_messages);
+	__test_parse_packet(&reassembly, binary_payload, mmtp_header_size, SI_FRAGMENTATION_INDICATOR_MIDDLE << 6, 1, mpt + 20, 20, &test_messages);
+	if(test_messages.count != 0) {
+		_MMSM_ERROR("test_mmt_signaling_message_fragmented: message dispatched before its last fragment");
+		return -1;
+	}
+	__test_parse_packet(&reassembly, binary_payload, mmtp_header_size, SI_FRAGMENTATION_INDICATOR_LAST << 6, 0, mpt + 40, mpt_size - 40, &test_messages);
+	if(test_messages.count != 1 || !test_messages.mp_table_ok) {
+		_MMSM_ERROR("test_mmt_signaling_message_fragmented: messages: %d, mp_table ok: %d", test_messages.count, test_messages.mp_table_ok);
+		return -1;
+	}
+
+	__test_parse_packet(&reassembly, binary_payload, mmtp_header_size, SI_FRAGMENTATION_INDICATOR_FIRST << 6, 2, mpt, 20, &test_messages);
+	__test_parse_packet(&reassembly, binary_payload, mmtp_header_size, SI_FRAGMENTATION_INDICATOR_LAST << 6, 0, mpt + 40, mpt_size - 40, &test_messages);
+	if(test_messages.count != 1 || reassembly.stats.fragments_dropped != 1) {
+		_MMSM_ERROR("test_mmt_signaling_message_fragmented: incomplete message dispatched, messages: %d, dropped: %llu",
+				test_messages.count, (unsigned long long)reassembly.stats.fragments_dropped);
+		return -1;
+	}
 
-//	lls_table_t* lls = lls_table_create(binary_payload, binary_payload_size);
-//	if(lls) {
-//		lls_dump_instance_table(lls);
-//	} else {
-//		_LLS_ERROR("test_lls_create_SystemTime_table() - lls_table_t* is NULL");
-//	}
-//
+	mmt_signaling_message_stats_dump(&reassembly);
+	mmt_signaling_message_reassembly_free(&reassembly);
+	free(binary_payload);
 	return 0;
 }
 
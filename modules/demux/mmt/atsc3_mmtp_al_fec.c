@@ -0,0 +1,430 @@
+/*
+ * atsc3_mmtp_al_fec.c
+ *
+ *  Created on: Feb 16, 2019
+ *      Author: jjustman
+ */
+
+#include "atsc3_mmtp_al_fec.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+//x^8 + x^4 + x^3 + x^2 + 1
+#define MMTP_AL_FEC_GF256_POLYNOMIAL 0x11D
+
+void mmtp_al_fec_gf256_init(mmtp_al_fec_gf256_t* gf256) {
+	unsigned x = 1;
+
+	memset(gf256, 0, sizeof(mmtp_al_fec_gf256_t));
+	for(int i = 0; i < 255; i++) {
+		gf256->exp[i] = x;
+		gf256->log[x] = i;
+		x <<= 1;
+		if(x & 0x100) {
+			x ^= MMTP_AL_FEC_GF256_POLYNOMIAL;
+		}
+	}
+	//so exp[log[a] + log[b]] never needs a modulo
+	for(int i = 255; i < 512; i++) {
+		gf256->exp[i] = gf256->exp[i - 255];
+	}
+}
+
+static uint8_t __mmtp_al_fec_gf256_inv(const mmtp_al_fec_gf256_t* gf256, uint8_t a) {
+	return gf256->exp[255 - gf256->log[a]];
+}
+
+static uint8_t __mmtp_al_fec_gf256_mul(const mmtp_al_fec_gf256_t* gf256, uint8_t a, uint8_t b) {
+	if(!a || !b) {
+		return 0;
+	}
+	return gf256->exp[gf256->log[a] + gf256->log[b]];
+}
+
+//dst += coefficient * src
+static void __mmtp_al_fec_gf256_mul_add(const mmtp_al_fec_gf256_t* gf256, uint8_t* dst, const uint8_t* src, size_t length, uint8_t coefficient) {
+	if(!coefficient) {
+		return;
+	}
+	unsigned log_coefficient = gf256->log[coefficient];
+	for(size_t i = 0; i < length; i++) {
+		if(src[i]) {
+			dst[i] ^= gf256->exp[gf256->log[src[i]] + log_coefficient];
+		}
+	}
+}
+
+//C[j][i] of a block of k source symbols, k + j < 256 and i < k keep (k + j) ^ i non-zero
+static uint8_t __mmtp_al_fec_cauchy(const mmtp_al_fec_gf256_t* gf256, uint32_t k, uint32_t j, uint32_t i) {
+	return __mmtp_al_fec_gf256_inv(gf256, (uint8_t)((k + j) ^ i));
+}
+
+//dst += coefficient * source symbol, the zero padding past the packet adds nothing
+static void __mmtp_al_fec_source_symbol_mul_add(const mmtp_al_fec_gf256_t* gf256, uint8_t* dst, const uint8_t* packet, size_t packet_length, uint8_t coefficient) {
+	uint8_t packet_length_field[2] = { (uint8_t)(packet_length >> 8), (uint8_t)packet_length };
+
+	__mmtp_al_fec_gf256_mul_add(gf256, dst, packet_length_field, 2, coefficient);
+	__mmtp_al_fec_gf256_mul_add(gf256, dst + 2, packet, packet_length, coefficient);
+}
+
+int mmtp_al_fec_repair_symbol_encode(const mmtp_al_fec_gf256_t* gf256, const uint8_t* const* packets, const size_t* packet_lengths,
+		uint32_t k, uint32_t rs_id, size_t symbol_size, uint8_t* repair_symbol) {
+	if(!k || k + rs_id >= MMTP_AL_FEC_MAX_BLOCK_SYMBOLS || symbol_size > MMTP_AL_FEC_MAX_SYMBOL_SIZE) {
+		return -1;
+	}
+
+	memset(repair_symbol, 0, symbol_size);
+	for(uint32_t i = 0; i < k; i++) {
+		if(packet_lengths[i] > 0xFFFF || packet_lengths[i] + 2 > symbol_size) {
+			return -1;
+		}
+		__mmtp_al_fec_source_symbol_mul_add(gf256, repair_symbol, packets[i], packet_lengths[i], __mmtp_al_fec_cauchy(gf256, k, rs_id, i));
+	}
+	return 0;
+}
+
+void mmtp_al_fec_decoder_init(mmtp_al_fec_decoder_t* mmtp_al_fec_decoder, int64_t max_hold_us) {
+	memset(mmtp_al_fec_decoder, 0, sizeof(mmtp_al_fec_decoder_t));
+	mmtp_al_fec_decoder->max_hold_us = max_hold_us;
+	mmtp_al_fec_gf256_init(&mmtp_al_fec_decoder->gf256);
+}
+
+static mmtp_al_fec_source_packet_t* __mmtp_al_fec_source_find(mmtp_al_fec_decoder_t* mmtp_al_fec_decoder, uint32_t ss_id) {
+	if(!mmtp_al_fec_decoder->source_ring) {
+		return NULL;
+	}
+	mmtp_al_fec_source_packet_t* source_packet = &mmtp_al_fec_decoder->source_ring[ss_id & (MMTP_AL_FEC_SOURCE_RING_SIZE - 1)];
+	return source_packet->in_use && source_packet->ss_id == ss_id ? source_packet : NULL;
+}
+
+static int __mmtp_al_fec_source_store(mmtp_al_fec_decoder_t* mmtp_al_fec_decoder, uint32_t ss_id, const uint8_t* packet, size_t packet_length) {
+	if(!mmtp_al_fec_decoder->source_ring) {
+		mmtp_al_fec_decoder->source_ring = calloc(MMTP_AL_FEC_SOURCE_RING_SIZE, sizeof(mmtp_al_fec_source_packet_t));
+		if(!mmtp_al_fec_decoder->source_ring) {
+			return -1;
+		}
+	}
+
+	mmtp_al_fec_source_packet_t* source_packet = &mmtp_al_fec_decoder->source_ring[ss_id & (MMTP_AL_FEC_SOURCE_RING_SIZE - 1)];
+	if(source_packet->packet_capacity < packet_length) {
+		uint8_t* buf = realloc(source_packet->packet, packet_length);
+		if(!buf) {
+			source_packet->in_use = false;
+			return -1;
+		}
+		source_packet->packet = buf;
+		source_packet->packet_capacity = packet_length;
+	}
+	memcpy(source_packet->packet, packet, packet_length);
+	source_packet->packet_length = packet_length;
+	source_packet->ss_id = ss_id;
+	source_packet->in_use = true;
+	return 0;
+}
+
+static uint32_t __mmtp_al_fec_block_missing(mmtp_al_fec_decoder_t* mmtp_al_fec_decoder, mmtp_al_fec_block_t* block) {
+	uint32_t missing = 0;
+	for(uint32_t i = 0; i < block->ssb_length; i++) {
+		if(!__mmtp_al_fec_source_find(mmtp_al_fec_decoder, block->ss_start + i)) {
+			missing++;
+		}
+	}
+	return missing;
+}
+
+static void __mmtp_al_fec_block_release(mmtp_al_fec_decoder_t* mmtp_al_fec_decoder, mmtp_al_fec_block_t* block) {
+	if(!block->done && __mmtp_al_fec_block_missing(mmtp_al_fec_decoder, block)) {
+		mmtp_al_fec_decoder->stats.blocks_unrecoverable++;
+	}
+	free(block->repair_symbols);
+	free(block->repair_present);
+	memset(block, 0, sizeof(mmtp_al_fec_block_t));
+}
+
+void mmtp_al_fec_decoder_expire(mmtp_al_fec_decoder_t* mmtp_al_fec_decoder, int64_t now_us) {
+	for(int i = 0; i < MMTP_AL_FEC_MAX_BLOCKS; i++) {
+		mmtp_al_fec_block_t* block = &mmtp_al_fec_decoder->blocks[i];
+		if(block->in_use && now_us - block->first_seen_us > mmtp_al_fec_decoder->max_hold_us) {
+			__mmtp_al_fec_block_release(mmtp_al_fec_decoder, block);
+		}
+	}
+}
+
+static mmtp_al_fec_block_t* __mmtp_al_fec_block_find(mmtp_al_fec_decoder_t* mmtp_al_fec_decoder, uint32_t ss_start) {
+	for(int i = 0; i < MMTP_AL_FEC_MAX_BLOCKS; i++) {
+		if(mmtp_al_fec_decoder->blocks[i].in_use && mmtp_al_fec_decoder->blocks[i].ss_start == ss_start) {
+			return &mmtp_al_fec_decoder->blocks[i];
+		}
+	}
+	return NULL;
+}
+
+//a free slot, or the oldest block given up on to make one
+static mmtp_al_fec_block_t* __mmtp_al_fec_block_new(mmtp_al_fec_decoder_t* mmtp_al_fec_decoder, uint32_t ss_start, uint32_t ssb_length,
+		uint32_t rsb_length, size_t symbol_size, int64_t now_us) {
+	mmtp_al_fec_block_t* block = NULL;
+
+	for(int i = 0; i < MMTP_AL_FEC_MAX_BLOCKS; i++) {
+		mmtp_al_fec_block_t* candidate = &mmtp_al_fec_decoder->blocks[i];
+		if(!candidate->in_use) {
+			block = candidate;
+			break;
+		}
+		if(!block || candidate->first_seen_us < block->first_seen_us) {
+			block = candidate;
+		}
+	}
+	if(block->in_use) {
+		__mmtp_al_fec_block_release(mmtp_al_fec_decoder, block);
+	}
+
+	block->repair_symbols = malloc(rsb_length * symbol_size);
+	block->repair_present = calloc(rsb_length, sizeof(bool));
+	if(!block->repair_symbols || !block->repair_present) {
+		free(block->repair_symbols);
+		free(block->repair_present);
+		memset(block, 0, sizeof(mmtp_al_fec_block_t));
+		return NULL;
+	}
+
+	block->in_use = true;
+	block->ss_start = ss_start;
+	block->ssb_length = ssb_length;
+	block->rsb_length = rsb_length;
+	block->symbol_size = symbol_size;
+	block->first_seen_us = now_us;
+	return block;
+}
+
+//invert the e x e matrix a in place into inv, returns -1 if it is singular
+static int __mmtp_al_fec_matrix_invert(const mmtp_al_fec_gf256_t* gf256, uint8_t* a, uint8_t* inv, uint32_t e) {
+	memset(inv, 0, e * e);
+	for(uint32_t i = 0; i < e; i++) {
+		inv[i * e + i] = 1;
+	}
+
+	for(uint32_t col = 0; col < e; col++) {
+		uint32_t pivot = col;
+		while(pivot < e && !a[pivot * e + col]) {
+			pivot++;
+		}
+		if(pivot == e) {
+			return -1;
+		}
+		if(pivot != col) {
+			for(uint32_t c = 0; c < e; c++) {
+				uint8_t t = a[col * e + c]; a[col * e + c] = a[pivot * e + c]; a[pivot * e + c] = t;
+				t = inv[col * e + c]; inv[col * e + c] = inv[pivot * e + c]; inv[pivot * e + c] = t;
+			}
+		}
+
+		uint8_t scale = __mmtp_al_fec_gf256_inv(gf256, a[col * e + col]);
+		for(uint32_t c = 0; c < e; c++) {
+			a[col * e + c] = __mmtp_al_fec_gf256_mul(gf256, a[col * e + c], scale);
+			inv[col * e + c] = __mmtp_al_fec_gf256_mul(gf256, inv[col * e + c], scale);
+		}
+
+		for(uint32_t row = 0; row < e; row++) {
+			uint8_t factor = a[row * e + col];
+			if(row == col || !factor) {
+				continue;
+			}
+			__mmtp_al_fec_gf256_mul_add(gf256, &a[row * e], &a[col * e], e, factor);
+			__mmtp_al_fec_gf256_mul_add(gf256, &inv[row * e], &inv[col * e], e, factor);
+		}
+	}
+	return 0;
+}
+
+/**
+ * once no more source symbols are missing than repair symbols are in, solve for the missing ones:
+ * 	repair_j - sum(C[j][i] * present source_i) = sum(C[j][m] * missing source_m)
+ */
+static void __mmtp_al_fec_block_recover(mmtp_al_fec_decoder_t* mmtp_al_fec_decoder, mmtp_al_fec_block_t* block,
+		mmtp_al_fec_recovered_f recovered, void* context) {
+	const mmtp_al_fec_gf256_t* gf256 = &mmtp_al_fec_decoder->gf256;
+	uint32_t missing[MMTP_AL_FEC_MAX_BLOCK_SYMBOLS];
+	uint32_t repair_ids[MMTP_AL_FEC_MAX_BLOCK_SYMBOLS];
+	uint32_t e = 0;
+	size_t symbol_size = block->symbol_size;
+
+	if(block->done) {
+		return;
+	}
+	for(uint32_t i = 0; i < block->ssb_length; i++) {
+		if(!__mmtp_al_fec_source_find(mmtp_al_fec_decoder, block->ss_start + i)) {
+			missing[e++] = i;
+		}
+	}
+	if(!e) {
+		block->done = true;
+		return;
+	}
+	if(e > block->repair_count) {
+		return;
+	}
+
+	uint32_t r = 0;
+	for(uint32_t j = 0; j < block->rsb_length && r < e; j++) {
+		if(block->repair_present[j]) {
+			repair_ids[r++] = j;
+		}
+	}
+
+	uint8_t* rhs = malloc(e * symbol_size);
+	uint8_t* a = malloc(e * e);
+	uint8_t* inv = malloc(e * e);
+	uint8_t* symbol = malloc(symbol_size);
+	if(!rhs || !a || !inv || !symbol) {
+		goto cleanup;
+	}
+
+	for(r = 0; r < e; r++) {
+		uint32_t j = repair_ids[r];
+		memcpy(&rhs[r * symbol_size], &block->repair_symbols[j * symbol_size], symbol_size);
+
+		for(uint32_t i = 0; i < block->ssb_length; i++) {
+			mmtp_al_fec_source_packet_t* source_packet = __mmtp_al_fec_source_find(mmtp_al_fec_decoder, block->ss_start + i);
+			if(!source_packet) {
+				continue;
+			}
+			if(source_packet->packet_length + 2 > symbol_size) {
+				_MMTP_AL_FEC_ERROR("ss_id: %u, packet_length: %zu does not fit symbol_size: %zu", source_packet->ss_id, source_packet->packet_length, symbol_size);
+				block->done = true;
+				goto cleanup;
+			}
+			__mmtp_al_fec_source_symbol_mul_add(gf256, &rhs[r * symbol_size], source_packet->packet, source_packet->packet_length,
+					__mmtp_al_fec_cauchy(gf256, block->ssb_length, j, i));
+		}
+
+		for(uint32_t c = 0; c < e; c++) {
+			a[r * e + c] = __mmtp_al_fec_cauchy(gf256, block->ssb_length, j, missing[c]);
+		}
+	}
+
+	if(__mmtp_al_fec_matrix_invert(gf256, a, inv, e)) {
+		_MMTP_AL_FEC_ERROR("ss_start: %u, singular recovery matrix", block->ss_start);
+		block->done = true;
+		goto cleanup;
+	}
+
+	block->done = true;
+	mmtp_al_fec_decoder->stats.blocks_recovered++;
+
+	for(uint32_t c = 0; c < e; c++) {
+		memset(symbol, 0, symbol_size);
+		for(r = 0; r < e; r++) {
+			__mmtp_al_fec_gf256_mul_add(gf256, symbol, &rhs[r * symbol_size], symbol_size, inv[c * e + r]);
+		}
+
+		uint32_t ss_id = block->ss_start + missing[c];
+		size_t packet_length = (symbol[0] << 8) | symbol[1];
+		if(!packet_length || packet_length + 2 > symbol_size) {
+			_MMTP_AL_FEC_ERROR("ss_id: %u, recovered packet_length: %zu is invalid", ss_id, packet_length);
+			continue;
+		}
+
+		_MMTP_AL_FEC_DEBUG("ss_id: %u, recovered %zu bytes", ss_id, packet_length);
+		__mmtp_al_fec_source_store(mmtp_al_fec_decoder, ss_id, &symbol[2], packet_length);
+		mmtp_al_fec_decoder->stats.packets_recovered++;
+		recovered(context, ss_id, &symbol[2], packet_length);
+	}
+
+cleanup:
+	free(rhs);
+	free(a);
+	free(inv);
+	free(symbol);
+}
+
+void mmtp_al_fec_decoder_push_source(mmtp_al_fec_decoder_t* mmtp_al_fec_decoder, uint32_t ss_id, const uint8_t* packet, size_t packet_length,
+		int64_t now_us, mmtp_al_fec_recovered_f recovered, void* context) {
+	mmtp_al_fec_decoder->stats.source_packets++;
+	mmtp_al_fec_decoder_expire(mmtp_al_fec_decoder, now_us);
+
+	if(__mmtp_al_fec_source_store(mmtp_al_fec_decoder, ss_id, packet, packet_length)) {
+		return;
+	}
+
+	//a source packet arriving after its repair symbols may be all its block was waiting on
+	for(int i = 0; i < MMTP_AL_FEC_MAX_BLOCKS; i++) {
+		mmtp_al_fec_block_t* block = &mmtp_al_fec_decoder->blocks[i];
+		if(block->in_use && !block->done && (uint32_t)(ss_id - block->ss_start) < block->ssb_length) {
+			__mmtp_al_fec_block_recover(mmtp_al_fec_decoder, block, recovered, context);
+		}
+	}
+}
+
+int mmtp_al_fec_decoder_push_repair(mmtp_al_fec_decoder_t* mmtp_al_fec_decoder, const uint8_t* payload, size_t payload_length,
+		int64_t now_us, mmtp_al_fec_recovered_f recovered, void* context) {
+	if(payload_length <= MMTP_AL_FEC_REPAIR_FEC_PAYLOAD_ID_LENGTH + 2) {
+		mmtp_al_fec_decoder->stats.repair_packets_malformed++;
+		return -1;
+	}
+
+	uint32_t ss_start = ((uint32_t)payload[0] << 24) | ((uint32_t)payload[1] << 16) | ((uint32_t)payload[2] << 8) | payload[3];
+	uint32_t rsb_length = ((uint32_t)payload[4] << 16) | ((uint32_t)payload[5] << 8) | payload[6];
+	uint32_t rs_id = ((uint32_t)payload[7] << 16) | ((uint32_t)payload[8] << 8) | payload[9];
+	uint32_t ssb_length = ((uint32_t)payload[10] << 24) | ((uint32_t)payload[11] << 16) | ((uint32_t)payload[12] << 8) | payload[13];
+	const uint8_t* repair_symbol = &payload[MMTP_AL_FEC_REPAIR_FEC_PAYLOAD_ID_LENGTH];
+	size_t symbol_size = payload_length - MMTP_AL_FEC_REPAIR_FEC_PAYLOAD_ID_LENGTH;
+
+	if(!ssb_length || !rsb_length || rs_id >= rsb_length || ssb_length > MMTP_AL_FEC_MAX_BLOCK_SYMBOLS ||
+			rsb_length > MMTP_AL_FEC_MAX_BLOCK_SYMBOLS - ssb_length || symbol_size > MMTP_AL_FEC_MAX_SYMBOL_SIZE) {
+		_MMTP_AL_FEC_DEBUG("ss_start: %u, ssb_length: %u, rsb_length: %u, rs_id: %u out of range", ss_start, ssb_length, rsb_length, rs_id);
+		mmtp_al_fec_decoder->stats.repair_packets_malformed++;
+		return -1;
+	}
+
+	mmtp_al_fec_decoder_expire(mmtp_al_fec_decoder, now_us);
+
+	mmtp_al_fec_block_t* block = __mmtp_al_fec_block_find(mmtp_al_fec_decoder, ss_start);
+	if(block && (block->ssb_length != ssb_length || block->rsb_length != rsb_length || block->symbol_size != symbol_size)) {
+		mmtp_al_fec_decoder->stats.repair_packets_malformed++;
+		return -1;
+	}
+	mmtp_al_fec_decoder->stats.repair_packets++;
+
+	if(!block) {
+		block = __mmtp_al_fec_block_new(mmtp_al_fec_decoder, ss_start, ssb_length, rsb_length, symbol_size, now_us);
+		if(!block) {
+			return -1;
+		}
+	}
+	if(block->done || block->repair_present[rs_id]) {
+		return 0;
+	}
+
+	memcpy(&block->repair_symbols[rs_id * symbol_size], repair_symbol, symbol_size);
+	block->repair_present[rs_id] = true;
+	block->repair_count++;
+
+	__mmtp_al_fec_block_recover(mmtp_al_fec_decoder, block, recovered, context);
+	return 0;
+}
+
+void mmtp_al_fec_decoder_stats_dump(mmtp_al_fec_decoder_t* mmtp_al_fec_decoder) {
+	_MMTP_AL_FEC_INFO("mmtp_al_fec: source packets: %llu, repair packets: %llu (malformed: %llu), recovered: %llu packets in %llu blocks, unrecoverable blocks: %llu",
+			(unsigned long long)mmtp_al_fec_decoder->stats.source_packets,
+			(unsigned long long)mmtp_al_fec_decoder->stats.repair_packets,
+			(unsigned long long)mmtp_al_fec_decoder->stats.repair_packets_malformed,
+			(unsigned long long)mmtp_al_fec_decoder->stats.packets_recovered,
+			(unsigned long long)mmtp_al_fec_decoder->stats.blocks_recovered,
+			(unsigned long long)mmtp_al_fec_decoder->stats.blocks_unrecoverable);
+}
+
+void mmtp_al_fec_decoder_free(mmtp_al_fec_decoder_t* mmtp_al_fec_decoder) {
+	for(int i = 0; i < MMTP_AL_FEC_MAX_BLOCKS; i++) {
+		free(mmtp_al_fec_decoder->blocks[i].repair_symbols);
+		free(mmtp_al_fec_decoder->blocks[i].repair_present);
+	}
+	if(mmtp_al_fec_decoder->source_ring) {
+		for(int i = 0; i < MMTP_AL_FEC_SOURCE_RING_SIZE; i++) {
+			free(mmtp_al_fec_decoder->source_ring[i].packet);
+		}
+		free(mmtp_al_fec_decoder->source_ring);
+	}
+	memset(mmtp_al_fec_decoder->blocks, 0, sizeof(mmtp_al_fec_decoder->blocks));
+	mmtp_al_fec_decoder->source_ring = NULL;
+}
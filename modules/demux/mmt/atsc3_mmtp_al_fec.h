@@ -0,0 +1,138 @@
+/*
+ * atsc3_mmtp_al_fec.h
+ *
+ *  Created on: Feb 16, 2019
+ *      Author: jjustman
+ *
+ * MMTP AL-FEC (ISO 23008-1 annex C) source packet recovery with a systematic Reed-Solomon erasure code over GF(2^8).
+ *
+ * source packets (FEC_type 1) carry a 32 bit source_FEC_payload_ID (SS_ID) at their end. each is kept, less its
+ * SS_ID, as the source symbol
+ *
+ * 	u16 packet_length, packet, zero padding up to the symbol size
+ *
+ * repair packets (payload_type 0x03) carry the repair_FEC_payload_ID, then one repair symbol:
+ *
+ * 	SS_start	32	SS_ID of the first source symbol of the block
+ * 	RSB_length	24	repair symbols in the block
+ * 	RS_ID		24	this repair symbol, 0..RSB_length-1
+ * 	SSB_length	32	source symbols in the block, SSB_length + RSB_length <= 256
+ *
+ * repair symbol RS_ID is sum(C[RS_ID][i] * source symbol i), with the cauchy matrix C[j][i] = 1 / ((SSB_length + j) ^ i),
+ * so any SSB_length of the SSB_length + RSB_length symbols of a block rebuild the rest. the symbol size is the repair symbol length.
+ *
+ * recent source packets are kept in a ring, and a block's repair symbols for max_hold_us after its first one
+ * arrived. missing source packets are handed back as soon as enough symbols of their block are in.
+ *
+ * this is one sender's layout, the fec_code_id of an AL_FEC message is not decoded to check a flow uses it,
+ * so the demuxer only feeds the decoder with mmtp-al-fec.
+ *
+ * not thread-safe.
+ */
+
+#ifndef MODULES_DEMUX_MMT_ATSC3_MMTP_AL_FEC_H_
+#define MODULES_DEMUX_MMT_ATSC3_MMTP_AL_FEC_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define _MMTP_AL_FEC_PRINTLN(...) printf(__VA_ARGS__);printf("\n")
+#define _MMTP_AL_FEC_ERROR(...)   printf("%s:%d:ERROR:",__FILE__,__LINE__);_MMTP_AL_FEC_PRINTLN(__VA_ARGS__);
+#define _MMTP_AL_FEC_INFO(...)    printf("%s:%d:INFO :",__FILE__,__LINE__);_MMTP_AL_FEC_PRINTLN(__VA_ARGS__);
+#define _MMTP_AL_FEC_DEBUG(...)
+
+#define MMTP_AL_FEC_SOURCE_FEC_PAYLOAD_ID_LENGTH	4
+#define MMTP_AL_FEC_REPAIR_FEC_PAYLOAD_ID_LENGTH	14
+
+//GF(2^8): at most 256 symbols per block
+#define MMTP_AL_FEC_MAX_BLOCK_SYMBOLS		256
+#define MMTP_AL_FEC_MAX_SYMBOL_SIZE			16384
+
+//source packets kept for recovery, power of two
+#define MMTP_AL_FEC_SOURCE_RING_SIZE		1024
+//blocks collecting repair symbols at once, the oldest is given up on past this
+#define MMTP_AL_FEC_MAX_BLOCKS				16
+
+//hands back a recovered source packet, less its source_FEC_payload_ID
+typedef void (*mmtp_al_fec_recovered_f)(void* context, uint32_t ss_id, const uint8_t* packet, size_t packet_length);
+
+typedef struct mmtp_al_fec_gf256 {
+	uint8_t		exp[512];
+	uint8_t		log[256];
+} mmtp_al_fec_gf256_t;
+
+typedef struct mmtp_al_fec_source_packet {
+	bool		in_use;
+	uint32_t	ss_id;
+	uint8_t*	packet;
+	size_t		packet_length;
+	size_t		packet_capacity;
+} mmtp_al_fec_source_packet_t;
+
+typedef struct mmtp_al_fec_block {
+	bool		in_use;
+	bool		done;				//every source symbol is in or was recovered, late repair symbols are ignored
+	uint32_t	ss_start;
+	uint32_t	ssb_length;
+	uint32_t	rsb_length;
+	size_t		symbol_size;
+	int64_t		first_seen_us;
+
+	uint8_t*	repair_symbols;		//rsb_length * symbol_size
+	bool*		repair_present;
+	uint32_t	repair_count;
+} mmtp_al_fec_block_t;
+
+typedef struct mmtp_al_fec_stats {
+	uint64_t	source_packets;
+	uint64_t	repair_packets;
+	uint64_t	repair_packets_malformed;
+	uint64_t	packets_recovered;
+	uint64_t	blocks_recovered;
+	uint64_t	blocks_unrecoverable;	//given up on with source packets still missing
+} mmtp_al_fec_stats_t;
+
+typedef struct mmtp_al_fec_decoder {
+	int64_t							max_hold_us;
+	mmtp_al_fec_gf256_t				gf256;
+
+	mmtp_al_fec_source_packet_t*	source_ring;	//allocated on the first source packet
+	mmtp_al_fec_block_t				blocks[MMTP_AL_FEC_MAX_BLOCKS];
+
+	mmtp_al_fec_stats_t				stats;
+} mmtp_al_fec_decoder_t;
+
+void mmtp_al_fec_gf256_init(mmtp_al_fec_gf256_t* gf256);
+
+/**
+ * repair symbol rs_id of a block of k source packets, symbol_size bytes into repair_symbol.
+ * returns -1 if a packet does not fit a symbol or the block is too large
+ */
+int mmtp_al_fec_repair_symbol_encode(const mmtp_al_fec_gf256_t* gf256, const uint8_t* const* packets, const size_t* packet_lengths,
+		uint32_t k, uint32_t rs_id, size_t symbol_size, uint8_t* repair_symbol);
+
+void mmtp_al_fec_decoder_init(mmtp_al_fec_decoder_t* mmtp_al_fec_decoder, int64_t max_hold_us);
+
+/**
+ * a received source packet, its source_FEC_payload_ID already stripped.
+ * source packets this completes a block with are handed to recovered before returning
+ */
+void mmtp_al_fec_decoder_push_source(mmtp_al_fec_decoder_t* mmtp_al_fec_decoder, uint32_t ss_id, const uint8_t* packet, size_t packet_length,
+		int64_t now_us, mmtp_al_fec_recovered_f recovered, void* context);
+
+/**
+ * the payload of a repair packet: repair_FEC_payload_ID and repair symbol.
+ * returns -1 if it is malformed
+ */
+int mmtp_al_fec_decoder_push_repair(mmtp_al_fec_decoder_t* mmtp_al_fec_decoder, const uint8_t* payload, size_t payload_length,
+		int64_t now_us, mmtp_al_fec_recovered_f recovered, void* context);
+
+//give up on blocks collecting for longer than max_hold_us
+void mmtp_al_fec_decoder_expire(mmtp_al_fec_decoder_t* mmtp_al_fec_decoder, int64_t now_us);
+
+void mmtp_al_fec_decoder_stats_dump(mmtp_al_fec_decoder_t* mmtp_al_fec_decoder);
+void mmtp_al_fec_decoder_free(mmtp_al_fec_decoder_t* mmtp_al_fec_decoder);
+
+#endif /* MODULES_DEMUX_MMT_ATSC3_MMTP_AL_FEC_H_ */
@@ -0,0 +1,240 @@
+/*
+ *
+ * atsc3_mmtp_al_fec_test.c:  driver for AL-FEC reed-solomon repair symbol encoding and source packet recovery
+ *
+ */
+
+#include "atsc3_mmtp_al_fec.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define __UNIT_TEST 1
+#ifdef __UNIT_TEST
+
+#define TEST_K				10
+#define TEST_REPAIR			4
+#define TEST_SS_START		0xFFFFFFFC		//block straddles the SS_ID wrap
+#define TEST_MAX_PACKET		200
+#define TEST_SYMBOL_SIZE	(TEST_MAX_PACKET + 2)
+#define TEST_MAX_HOLD_US	100000
+
+typedef struct test_block {
+	uint8_t		packets[TEST_K][TEST_MAX_PACKET];
+	size_t		packet_lengths[TEST_K];
+	uint8_t		repair_payloads[TEST_REPAIR][MMTP_AL_FEC_REPAIR_FEC_PAYLOAD_ID_LENGTH + TEST_SYMBOL_SIZE];
+} test_block_t;
+
+typedef struct test_recovered {
+	int			count;
+	bool		matched[TEST_K];
+	bool		mismatch;
+	test_block_t* test_block;
+} test_recovered_t;
+
+void __test_recovered(void* context, uint32_t ss_id, const uint8_t* packet, size_t packet_length) {
+	test_recovered_t* test_recovered = context;
+	uint32_t i = ss_id - TEST_SS_START;
+
+	test_recovered->count++;
+	if(i >= TEST_K || packet_length != test_recovered->test_block->packet_lengths[i] ||
+			memcmp(packet, test_recovered->test_block->packets[i], packet_length)) {
+		_MMTP_AL_FEC_ERROR("ss_id: %u, recovered packet does not match", ss_id);
+		test_recovered->mismatch = true;
+		return;
+	}
+	test_recovered->matched[i] = true;
+}
+
+//packets of varying length and content, and their repair packet payloads
+void __test_block_create(test_block_t* test_block) {
+	mmtp_al_fec_gf256_t gf256;
+	mmtp_al_fec_gf256_init(&gf256);
+	const uint8_t* packets[TEST_K];
+
+	srand(1);
+	for(int i = 0; i < TEST_K; i++) {
+		test_block->packet_lengths[i] = 20 + (rand() % (TEST_MAX_PACKET - 20));
+		for(size_t b = 0; b < test_block->packet_lengths[i]; b++) {
+			test_block->packets[i][b] = rand();
+		}
+		packets[i] = test_block->packets[i];
+	}
+
+	for(uint32_t j = 0; j < TEST_REPAIR; j++) {
+		uint8_t* p = test_block->repair_payloads[j];
+		uint32_t ss_start = TEST_SS_START;
+		p[0] = ss_start >> 24; p[1] = ss_start >> 16; p[2] = ss_start >> 8; p[3] = ss_start;
+		p[4] = 0; p[5] = 0; p[6] = TEST_REPAIR;
+		p[7] = 0; p[8] = 0; p[9] = j;
+		p[10] = 0; p[11] = 0; p[12] = 0; p[13] = TEST_K;
+		mmtp_al_fec_repair_symbol_encode(&gf256, packets, test_block->packet_lengths, TEST_K, j, TEST_SYMBOL_SIZE, &p[MMTP_AL_FEC_REPAIR_FEC_PAYLOAD_ID_LENGTH]);
+	}
+}
+
+//push every source packet not in lost, then repairs repair symbols
+int __test_push_block(mmtp_al_fec_decoder_t* mmtp_al_fec_decoder, test_block_t* test_block, const bool* lost, int repairs, test_recovered_t* test_recovered) {
+	for(int i = 0; i < TEST_K; i++) {
+		if(!lost[i]) {
+			mmtp_al_fec_decoder_push_source(mmtp_al_fec_decoder, TEST_SS_START + i, test_block->packets[i], test_block->packet_lengths[i], 0, __test_recovered, test_recovered);
+		}
+	}
+	for(int j = 0; j < repairs; j++) {
+		if(mmtp_al_fec_decoder_push_repair(mmtp_al_fec_decoder, test_block->repair_payloads[j], sizeof(test_block->repair_payloads[j]), 0, __test_recovered, test_recovered)) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int test_mmtp_al_fec_gf256();
+int test_mmtp_al_fec_recover();
+int test_mmtp_al_fec_unrecoverable();
+int test_mmtp_al_fec_late_source();
+int test_mmtp_al_fec_malformed();
+
+int main() {
+	int failed = 0;
+
+	failed |= test_mmtp_al_fec_gf256();
+	failed |= test_mmtp_al_fec_recover();
+	failed |= test_mmtp_al_fec_unrecoverable();
+	failed |= test_mmtp_al_fec_late_source();
+	failed |= test_mmtp_al_fec_malformed();
+
+	return failed;
+}
+
+//every non-zero element has an inverse, and the repair of a single packet block is the packet scaled back
+int test_mmtp_al_fec_gf256() {
+	mmtp_al_fec_gf256_t gf256;
+	mmtp_al_fec_gf256_init(&gf256);
+
+	for(int a = 1; a < 256; a++) {
+		uint8_t inv = gf256.exp[255 - gf256.log[a]];
+		if(gf256.exp[gf256.log[a] + gf256.log[inv]] != 1) {
+			_MMTP_AL_FEC_ERROR("test_mmtp_al_fec_gf256: %d * %d != 1", a, inv);
+			return -1;
+		}
+	}
+
+	const uint8_t packet[] = { 0x12, 0x34 };
+	const uint8_t* packets[] = { packet };
+	const size_t packet_lengths[] = { sizeof(packet) };
+	uint8_t repair_symbol[8];
+	if(mmtp_al_fec_repair_symbol_encode(&gf256, packets, packet_lengths, 1, 255, sizeof(repair_symbol), repair_symbol) != -1 ||
+			mmtp_al_fec_repair_symbol_encode(&gf256, packets, packet_lengths, 1, 0, 3, repair_symbol) != -1) {
+		_MMTP_AL_FEC_ERROR("test_mmtp_al_fec_gf256: out of range block encoded");
+		return -1;
+	}
+	return 0;
+}
+
+//as many lost source packets as repair symbols are rebuilt byte for byte
+int test_mmtp_al_fec_recover() {
+	test_block_t test_block;
+	__test_block_create(&test_block);
+	test_recovered_t test_recovered = { .test_block = &test_block };
+	mmtp_al_fec_decoder_t mmtp_al_fec_decoder;
+	mmtp_al_fec_decoder_init(&mmtp_al_fec_decoder, TEST_MAX_HOLD_US);
+
+	bool lost[TEST_K] = { false };
+	lost[0] = lost[4] = lost[5] = lost[9] = true;
+	__test_push_block(&mmtp_al_fec_decoder, &test_block, lost, TEST_REPAIR, &test_recovered);
+
+	if(test_recovered.mismatch || test_recovered.count != 4 || !test_recovered.matched[0] || !test_recovered.matched[4] ||
+			!test_recovered.matched[5] || !test_recovered.matched[9] ||
+			mmtp_al_fec_decoder.stats.packets_recovered != 4 || mmtp_al_fec_decoder.stats.blocks_recovered != 1) {
+		_MMTP_AL_FEC_ERROR("test_mmtp_al_fec_recover: recovered: %d", test_recovered.count);
+		return -1;
+	}
+
+	//the block is done, a repeated repair symbol recovers nothing more
+	mmtp_al_fec_decoder_push_repair(&mmtp_al_fec_decoder, test_block.repair_payloads[0], sizeof(test_block.repair_payloads[0]), 0, __test_recovered, &test_recovered);
+	if(test_recovered.count != 4) {
+		_MMTP_AL_FEC_ERROR("test_mmtp_al_fec_recover: recovered again: %d", test_recovered.count);
+		return -1;
+	}
+
+	mmtp_al_fec_decoder_free(&mmtp_al_fec_decoder);
+	return 0;
+}
+
+//more losses than repair symbols: nothing is handed back, the block is given up on once it expires
+int test_mmtp_al_fec_unrecoverable() {
+	test_block_t test_block;
+	__test_block_create(&test_block);
+	test_recovered_t test_recovered = { .test_block = &test_block };
+	mmtp_al_fec_decoder_t mmtp_al_fec_decoder;
+	mmtp_al_fec_decoder_init(&mmtp_al_fec_decoder, TEST_MAX_HOLD_US);
+
+	bool lost[TEST_K] = { false };
+	lost[1] = lost[2] = lost[3] = true;
+	__test_push_block(&mmtp_al_fec_decoder, &test_block, lost, 2, &test_recovered);
+	mmtp_al_fec_decoder_expire(&mmtp_al_fec_decoder, TEST_MAX_HOLD_US + 1);
+
+	if(test_recovered.count || mmtp_al_fec_decoder.stats.blocks_unrecoverable != 1) {
+		_MMTP_AL_FEC_ERROR("test_mmtp_al_fec_unrecoverable: recovered: %d, unrecoverable: %llu", test_recovered.count,
+				(unsigned long long)mmtp_al_fec_decoder.stats.blocks_unrecoverable);
+		return -1;
+	}
+
+	mmtp_al_fec_decoder_free(&mmtp_al_fec_decoder);
+	return 0;
+}
+
+//a source packet arriving after the repair symbols completes the block
+int test_mmtp_al_fec_late_source() {
+	test_block_t test_block;
+	__test_block_create(&test_block);
+	test_recovered_t test_recovered = { .test_block = &test_block };
+	mmtp_al_fec_decoder_t mmtp_al_fec_decoder;
+	mmtp_al_fec_decoder_init(&mmtp_al_fec_decoder, TEST_MAX_HOLD_US);
+
+	bool lost[TEST_K] = { false };
+	lost[6] = lost[7] = true;
+	__test_push_block(&mmtp_al_fec_decoder, &test_block, lost, 1, &test_recovered);
+	if(test_recovered.count) {
+		_MMTP_AL_FEC_ERROR("test_mmtp_al_fec_late_source: recovered %d with too few symbols", test_recovered.count);
+		return -1;
+	}
+
+	mmtp_al_fec_decoder_push_source(&mmtp_al_fec_decoder, TEST_SS_START + 7, test_block.packets[7], test_block.packet_lengths[7], 0, __test_recovered, &test_recovered);
+	if(test_recovered.mismatch || test_recovered.count != 1 || !test_recovered.matched[6]) {
+		_MMTP_AL_FEC_ERROR("test_mmtp_al_fec_late_source: recovered: %d", test_recovered.count);
+		return -1;
+	}
+
+	mmtp_al_fec_decoder_free(&mmtp_al_fec_decoder);
+	return 0;
+}
+
+int test_mmtp_al_fec_malformed() {
+	test_block_t test_block;
+	__test_block_create(&test_block);
+	test_recovered_t test_recovered = { .test_block = &test_block };
+	mmtp_al_fec_decoder_t mmtp_al_fec_decoder;
+	mmtp_al_fec_decoder_init(&mmtp_al_fec_decoder, TEST_MAX_HOLD_US);
+
+	uint8_t* payload = test_block.repair_payloads[0];
+	payload[9] = TEST_REPAIR;	//rs_id past rsb_length
+	int out_of_range = mmtp_al_fec_decoder_push_repair(&mmtp_al_fec_decoder, payload, sizeof(test_block.repair_payloads[0]), 0, __test_recovered, &test_recovered);
+	payload[9] = 0;
+	int truncated = mmtp_al_fec_decoder_push_repair(&mmtp_al_fec_decoder, payload, MMTP_AL_FEC_REPAIR_FEC_PAYLOAD_ID_LENGTH, 0, __test_recovered, &test_recovered);
+	int valid = mmtp_al_fec_decoder_push_repair(&mmtp_al_fec_decoder, payload, sizeof(test_block.repair_payloads[0]), 0, __test_recovered, &test_recovered);
+	//same block, another symbol size
+	int mismatched = mmtp_al_fec_decoder_push_repair(&mmtp_al_fec_decoder, test_block.repair_payloads[1], sizeof(test_block.repair_payloads[1]) - 1, 0, __test_recovered, &test_recovered);
+
+	if(out_of_range != -1 || truncated != -1 || valid || mismatched != -1 || mmtp_al_fec_decoder.stats.repair_packets_malformed != 3) {
+		_MMTP_AL_FEC_ERROR("test_mmtp_al_fec_malformed: out_of_range: %d, truncated: %d, valid: %d, mismatched: %d", out_of_range, truncated, valid, mismatched);
+		return -1;
+	}
+
+	mmtp_al_fec_decoder_free(&mmtp_al_fec_decoder);
+	return 0;
+}
+
+#endif
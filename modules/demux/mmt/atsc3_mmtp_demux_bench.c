@@ -0,0 +1,678 @@
+/*
+ *
+ * atsc3_mmtp_demux_bench.c:  throughput benchmark of the mmtp demux path, no decoder and no vlc
+ *
+ * every udp payload of the corpus goes through what the demuxer does with it before es_out:
+ * mmtp header and mpu payload header parse, data unit parse, MPU metadata / movie fragment metadata
+ * reassembly, box walk of the moov (timescale) and moof (tfhd + trun sample table), and MFU sample emission.
+ *
+ * usage: atsc3_mmtp_demux_bench [-n iterations] [-d dst_ip:dst_port] [capture.pcap ...]
+ *
+ * captures are read into memory first, the pipeline then runs over them -n times from a clean state.
+ * without a capture a synthetic corpus is used: 1080p-sized video and audio MPUs of one second each.
+ *
+ * reports per corpus: packets/s, MB/s (udp payload), allocations per packet, p50/p99 per-packet latency.
+ * allocations are counted with GNU ld --wrap, build with make -f makefile_atsc3 benchmarks (not part of all)
+ */
+
+#include "atsc3_mmtp_types.h"
+#include "atsc3_mmtp_mpu_reassembly.h"
+#include "atsc3_mmtp_mfu_sample_emitter.h"
+#include "atsc3_pcap_reader.h"
+#include "atsc3_udp_flow.h"
+#include "atsc3_utils.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define _BENCH_PRINTLN(...) printf(__VA_ARGS__);printf("\n")
+#define _BENCH_ERROR(...)   printf("%s:%d:ERROR:",__FILE__,__LINE__);_BENCH_PRINTLN(__VA_ARGS__);
+
+#define BENCH_DEFAULT_ITERATIONS	5
+#define BENCH_MAX_ASSETS			16
+
+#define BENCH_SYNTHETIC_MPUS		20
+#define BENCH_SYNTHETIC_VIDEO_ID	0x100
+#define BENCH_SYNTHETIC_AUDIO_ID	0x200
+
+/**
+ * allocation counting: the bench links with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,
+ * so every allocation libatsc3 makes while bench_counting is set is seen here
+ */
+static bool		bench_counting;
+static uint64_t	bench_allocations;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t nmemb, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size) {
+	if(bench_counting) {
+		bench_allocations++;
+	}
+	return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t nmemb, size_t size) {
+	if(bench_counting) {
+		bench_allocations++;
+	}
+	return __real_calloc(nmemb, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+	if(bench_counting) {
+		bench_allocations++;
+	}
+	return __real_realloc(ptr, size);
+}
+
+//udp payloads, back to back
+typedef struct bench_corpus {
+	const char*	name;
+	uint8_t*	data;
+	size_t		size;
+	size_t		capacity;
+	size_t*		offsets;		//packets_n + 1 entries
+	size_t		packets_n;
+	size_t		packets_capacity;
+} bench_corpus_t;
+
+typedef struct bench_asset {
+	bool					in_use;
+	uint16_t				packet_id;
+	uint32_t				timescale;
+
+	mpu_reassembly_buffer_t	mpu_metadata;
+	mpu_reassembly_buffer_t	movie_fragment_metadata;
+	mfu_sample_emitter_t	mfu_sample_emitter;
+
+	mpu_sample_timing_t*	sample_table;
+	uint32_t				sample_table_capacity;
+} bench_asset_t;
+
+typedef struct bench_stats {
+	uint64_t	packets_parsed;
+	uint64_t	packets_rejected;
+	uint64_t	data_units;
+	uint64_t	samples;
+	uint64_t	sample_bytes;
+	uint64_t	sample_tables;
+	uint32_t	checksum;		//touches every sample byte, as a decoder would
+} bench_stats_t;
+
+typedef struct bench_pipeline {
+	bench_asset_t	assets[BENCH_MAX_ASSETS];
+	bench_stats_t	stats;
+} bench_pipeline_t;
+
+static int bench_corpus_add(bench_corpus_t* corpus, const uint8_t* payload, size_t length) {
+	if(corpus->packets_n + 2 > corpus->packets_capacity) {
+		size_t capacity = corpus->packets_capacity ? corpus->packets_capacity * 2 : 4096;
+		size_t* offsets = realloc(corpus->offsets, capacity * sizeof(size_t));
+		if(!offsets) {
+			return -1;
+		}
+		corpus->offsets = offsets;
+		corpus->packets_capacity = capacity;
+	}
+	if(corpus->size + length > corpus->capacity) {
+		size_t capacity = corpus->capacity ? corpus->capacity * 2 : 1024 * 1024;
+		while(capacity < corpus->size + length) {
+			capacity *= 2;
+		}
+		uint8_t* data = realloc(corpus->data, capacity);
+		if(!data) {
+			return -1;
+		}
+		corpus->data = data;
+		corpus->capacity = capacity;
+	}
+
+	memcpy(&corpus->data[corpus->size], payload, length);
+	corpus->offsets[corpus->packets_n++] = corpus->size;
+	corpus->size += length;
+	corpus->offsets[corpus->packets_n] = corpus->size;
+	return 0;
+}
+
+static void bench_corpus_free(bench_corpus_t* corpus) {
+	free(corpus->data);
+	free(corpus->offsets);
+	memset(corpus, 0, sizeof(bench_corpus_t));
+}
+
+//the udp payloads of a capture, all but LLS, or only those sent to dst_ip_addr:dst_port
+static int bench_corpus_load_pcap(bench_corpus_t* corpus, const char* path, uint32_t dst_ip_addr, uint16_t dst_port) {
+	FILE* fp = fopen(path, "rb");
+	atsc3_pcap_reader_t atsc3_pcap_reader;
+	if(!fp) {
+		_BENCH_ERROR("%s: cannot open", path);
+		return -1;
+	}
+	if(atsc3_pcap_reader_open(&atsc3_pcap_reader, fp)) {
+		fclose(fp);
+		return -1;
+	}
+
+	atsc3_pcap_record_t atsc3_pcap_record;
+	int ret;
+	while(!(ret = atsc3_pcap_reader_next(&atsc3_pcap_reader, &atsc3_pcap_record))) {
+		uint8_t* ipv4;
+		size_t ipv4_length;
+		udp_flow_t udp_flow;
+		uint8_t* payload;
+		size_t payload_length;
+
+		if(atsc3_pcap_link_to_ipv4(atsc3_pcap_reader.linktype, atsc3_pcap_record.data, atsc3_pcap_record.length, &ipv4, &ipv4_length) ||
+				udp_flow_parse_ipv4(ipv4, ipv4_length, &udp_flow, &payload, &payload_length) || udp_flow_is_lls(&udp_flow) ||
+				(dst_ip_addr && udp_flow.dst_ip_addr != dst_ip_addr) || (dst_port && udp_flow.dst_port != dst_port)) {
+			continue;
+		}
+		if(bench_corpus_add(corpus, payload, payload_length)) {
+			ret = -1;
+			break;
+		}
+	}
+	atsc3_pcap_reader_close(&atsc3_pcap_reader);
+
+	corpus->name = path;
+	return ret < 0 ? -1 : 0;
+}
+
+/**
+ * synthetic corpus
+ */
+
+static uint8_t* bench_put_u32(uint8_t* p, uint32_t v) {
+	p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+	return p + 4;
+}
+
+static uint8_t* bench_put_u16(uint8_t* p, uint16_t v) {
+	p[0] = v >> 8; p[1] = v;
+	return p + 2;
+}
+
+static uint8_t* bench_put_box(uint8_t* p, uint32_t size, const char* type) {
+	p = bench_put_u32(p, size);
+	memcpy(p, type, 4);
+	return p + 4;
+}
+
+//v=0 mmtp header, mpu payload header and, for a timed MFU, its DU header (and MMTHSample on a first fragment)
+static int bench_synthetic_packet(bench_corpus_t* corpus, uint16_t packet_id, uint32_t* packet_sequence_number, uint32_t timestamp,
+		uint8_t fragment_type, uint8_t fragmentation_indicator, uint8_t fragmentation_counter, uint32_t mpu_sequence_number,
+		uint32_t sample_number, const uint8_t* payload, size_t length) {
+	uint8_t packet[MAX_MMTP_SIZE];
+	uint8_t* p = packet;
+
+	*p++ = 0x00;
+	*p++ = 0x00;
+	p = bench_put_u16(p, packet_id);
+	p = bench_put_u32(p, timestamp);
+	p = bench_put_u32(p, (*packet_sequence_number)++);
+	p = bench_put_u32(p, 0);
+
+	uint8_t* mpu_payload_length = p;
+	p += 2;
+	*p++ = fragment_type << 4 | (fragment_type == 0x2) << 3 | fragmentation_indicator << 1;
+	*p++ = fragmentation_counter;
+	p = bench_put_u32(p, mpu_sequence_number);
+
+	if(fragment_type == 0x2) {
+		p = bench_put_u32(p, 1);
+		p = bench_put_u32(p, sample_number);
+		p = bench_put_u32(p, 0);
+		*p++ = 0;
+		*p++ = 0;
+		if(fragmentation_indicator == 0 || fragmentation_indicator == 1) {
+			memset(p, 0, 4 + 19 + 4 + 4 + 1 + 2);
+			p += 4 + 19 + 4 + 4 + 1 + 2;
+		}
+	}
+
+	memcpy(p, payload, length);
+	p += length;
+	bench_put_u16(mpu_payload_length, p - mpu_payload_length - 2);
+	return bench_corpus_add(corpus, packet, p - packet);
+}
+
+//one data unit, split into fragments that fit a packet
+static int bench_synthetic_data_unit(bench_corpus_t* corpus, uint16_t packet_id, uint32_t* packet_sequence_number, uint32_t timestamp,
+		uint8_t fragment_type, uint32_t mpu_sequence_number, uint32_t sample_number, const uint8_t* payload, size_t length) {
+	const size_t fragment_max = UPPER_BOUND_MPU_FRAGMENT_SIZE - 64;
+	size_t fragments = length ? (length + fragment_max - 1) / fragment_max : 1;
+
+	for(size_t i = 0; i < fragments; i++) {
+		size_t offset = i * fragment_max;
+		size_t fragment_length = length - offset < fragment_max ? length - offset : fragment_max;
+		uint8_t fragmentation_indicator = fragments == 1 ? 0 : i == 0 ? 1 : i == fragments - 1 ? 3 : 2;
+		if(bench_synthetic_packet(corpus, packet_id, packet_sequence_number, timestamp, fragment_type, fragmentation_indicator,
+				(fragments - 1 - i) & 0xFF, mpu_sequence_number, sample_number, &payload[offset], fragment_length)) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int bench_synthetic_mpu(bench_corpus_t* corpus, uint16_t packet_id, uint32_t* packet_sequence_number, uint32_t mpu_sequence_number,
+		uint32_t timescale, uint32_t samples, uint32_t sample_duration, uint32_t sync_size, uint32_t sample_size, uint8_t* scratch) {
+	uint32_t timestamp = mpu_sequence_number << 16;
+
+	//ftyp + moov/trak/mdia/mdhd
+	uint8_t* p = scratch;
+	p = bench_put_box(p, 16, "ftyp");
+	memcpy(p, "mpuf\0\0\0\0", 8);
+	p += 8;
+	p = bench_put_box(p, 8 + 8 + 8 + 32, "moov");
+	p = bench_put_box(p, 8 + 8 + 32, "trak");
+	p = bench_put_box(p, 8 + 32, "mdia");
+	p = bench_put_box(p, 32, "mdhd");
+	memset(p, 0, 24);
+	bench_put_u32(p + 12, timescale);
+	p += 24;
+	if(bench_synthetic_data_unit(corpus, packet_id, packet_sequence_number, timestamp, 0x0, mpu_sequence_number, 0, scratch, p - scratch)) {
+		return -1;
+	}
+
+	//moof/traf/tfhd + trun (duration, size, flags per sample) and the mdat header
+	uint32_t trun_size = 8 + 4 + 4 + 4 + samples * 12;
+	uint32_t traf_size = 8 + 16 + trun_size;
+	p = scratch;
+	p = bench_put_box(p, 8 + 16 + traf_size, "moof");
+	p = bench_put_box(p, 16, "mfhd");
+	p = bench_put_u32(p, 0);
+	p = bench_put_u32(p, mpu_sequence_number);
+	p = bench_put_box(p, traf_size, "traf");
+	p = bench_put_box(p, 16, "tfhd");
+	p = bench_put_u32(p, 0x020000);
+	p = bench_put_u32(p, 1);
+	p = bench_put_box(p, trun_size, "trun");
+	p = bench_put_u32(p, 0x000701);
+	p = bench_put_u32(p, samples);
+	p = bench_put_u32(p, 0);
+	uint64_t mdat_size = 8;
+	for(uint32_t i = 0; i < samples; i++) {
+		p = bench_put_u32(p, sample_duration);
+		p = bench_put_u32(p, i == 0 ? sync_size : sample_size);
+		p = bench_put_u32(p, i == 0 ? 0x02000000 : 0x01010000);
+		mdat_size += i == 0 ? sync_size : sample_size;
+	}
+	p = bench_put_box(p, (uint32_t)mdat_size, "mdat");
+	if(bench_synthetic_data_unit(corpus, packet_id, packet_sequence_number, timestamp, 0x1, mpu_sequence_number, 0, scratch, p - scratch)) {
+		return -1;
+	}
+
+	for(uint32_t i = 0; i < samples; i++) {
+		uint32_t size = i == 0 ? sync_size : sample_size;
+		memset(scratch, (uint8_t)(i + 1), size);
+		if(bench_synthetic_data_unit(corpus, packet_id, packet_sequence_number, timestamp, 0x2, mpu_sequence_number, i + 1, scratch, size)) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int bench_corpus_synthetic(bench_corpus_t* corpus) {
+	uint8_t* scratch = malloc(256 * 1024);
+	uint32_t video_packet_sequence_number = 0;
+	uint32_t audio_packet_sequence_number = 0;
+	int ret = scratch ? 0 : -1;
+
+	//~6 Mbit/s of 60 fps video, ~128 kbit/s of 48 kHz audio
+	for(uint32_t mpu_sequence_number = 1; !ret && mpu_sequence_number <= BENCH_SYNTHETIC_MPUS; mpu_sequence_number++) {
+		ret = bench_synthetic_mpu(corpus, BENCH_SYNTHETIC_VIDEO_ID, &video_packet_sequence_number, mpu_sequence_number, 90000, 60, 1500, 120000, 10500, scratch) ||
+				bench_synthetic_mpu(corpus, BENCH_SYNTHETIC_AUDIO_ID, &audio_packet_sequence_number, mpu_sequence_number, 48000, 47, 1024, 340, 340, scratch);
+	}
+	free(scratch);
+
+	corpus->name = "synthetic";
+	return ret;
+}
+
+/**
+ * pipeline
+ */
+
+static bench_asset_t* bench_asset_get(bench_pipeline_t* bench_pipeline, uint16_t packet_id) {
+	bench_asset_t* free_asset = NULL;
+	for(int i = 0; i < BENCH_MAX_ASSETS; i++) {
+		bench_asset_t* bench_asset = &bench_pipeline->assets[i];
+		if(bench_asset->in_use && bench_asset->packet_id == packet_id) {
+			return bench_asset;
+		}
+		if(!bench_asset->in_use && !free_asset) {
+			free_asset = bench_asset;
+		}
+	}
+	if(free_asset) {
+		memset(free_asset, 0, sizeof(bench_asset_t));
+		free_asset->in_use = true;
+		free_asset->packet_id = packet_id;
+		mpu_reassembly_buffer_init(&free_asset->mpu_metadata);
+		mpu_reassembly_buffer_init(&free_asset->movie_fragment_metadata);
+	}
+	return free_asset;
+}
+
+static void bench_pipeline_free(bench_pipeline_t* bench_pipeline) {
+	for(int i = 0; i < BENCH_MAX_ASSETS; i++) {
+		bench_asset_t* bench_asset = &bench_pipeline->assets[i];
+		if(bench_asset->in_use) {
+			mpu_reassembly_buffer_free(&bench_asset->mpu_metadata);
+			mpu_reassembly_buffer_free(&bench_asset->movie_fragment_metadata);
+			mfu_sample_emitter_free(&bench_asset->mfu_sample_emitter);
+			free(bench_asset->sample_table);
+		}
+	}
+	memset(bench_pipeline, 0, sizeof(bench_pipeline_t));
+}
+
+static void bench_sample_emit(void* context, const mfu_sample_t* mfu_sample) {
+	bench_stats_t* bench_stats = context;
+	bench_stats->samples++;
+	bench_stats->sample_bytes += mfu_sample->size;
+	for(size_t i = 0; i < mfu_sample->size; i += 64) {
+		bench_stats->checksum += mfu_sample->data[i];
+	}
+}
+
+//the payload of the first child of type in [data, data + length), walking one level of boxes
+static const uint8_t* bench_box_find(const uint8_t* data, size_t length, const char* type, size_t* payload_length) {
+	while(length >= 8) {
+		uint64_t size = (uint32_t)data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
+		size_t header = 8;
+		if(size == 1 && length >= 16) {
+			size = (uint64_t)((uint32_t)data[8] << 24 | data[9] << 16 | data[10] << 8 | data[11]) << 32 |
+					((uint32_t)data[12] << 24 | data[13] << 16 | data[14] << 8 | data[15]);
+			header = 16;
+		} else if(size == 0) {
+			size = length;
+		}
+		if(size < header) {
+			return NULL;
+		}
+		if(!memcmp(&data[4], type, 4)) {
+			//the mdat after a moof runs past the movie fragment metadata, only its header is ours
+			*payload_length = (size > length ? length : size) - header;
+			return &data[header];
+		}
+		if(size > length) {
+			return NULL;
+		}
+		data += size;
+		length -= size;
+	}
+	return NULL;
+}
+
+//moov/trak/mdia/mdhd timescale of the first track
+static void bench_mpu_metadata(bench_asset_t* bench_asset, uint8_t* mpu_metadata, size_t length) {
+	const uint8_t* box = mpu_metadata;
+	size_t box_length = length;
+	const char* path[] = { "moov", "trak", "mdia", "mdhd" };
+	for(int i = 0; i < 4 && box; i++) {
+		box = bench_box_find(box, box_length, path[i], &box_length);
+	}
+
+	atsc3_cursor_t cursor;
+	if(!box) {
+		return;
+	}
+	atsc3_cursor_init(&cursor, (uint8_t*)box, box_length);
+	uint8_t version = atsc3_cursor_read_u8(&cursor);
+	atsc3_cursor_skip(&cursor, 3 + (version == 1 ? 16 : 8));
+	uint32_t timescale = atsc3_cursor_read_u32(&cursor);
+	if(!cursor.overrun) {
+		bench_asset->timescale = timescale;
+	}
+}
+
+//moof/traf tfhd defaults + trun into the sample table, as processMpuSampleTable does from libmp4's boxes
+static void bench_movie_fragment_metadata(bench_pipeline_t* bench_pipeline, bench_asset_t* bench_asset, uint32_t mpu_sequence_number,
+		uint8_t* movie_fragment_metadata, size_t length) {
+	size_t moof_length, traf_length, tfhd_length, trun_length;
+	const uint8_t* moof = bench_box_find(movie_fragment_metadata, length, "moof", &moof_length);
+	const uint8_t* traf = moof ? bench_box_find(moof, moof_length, "traf", &traf_length) : NULL;
+	const uint8_t* tfhd = traf ? bench_box_find(traf, traf_length, "tfhd", &tfhd_length) : NULL;
+	const uint8_t* trun = traf ? bench_box_find(traf, traf_length, "trun", &trun_length) : NULL;
+	if(!tfhd || !trun) {
+		return;
+	}
+
+	atsc3_cursor_t cursor;
+	atsc3_cursor_init(&cursor, (uint8_t*)tfhd, tfhd_length);
+	uint32_t tfhd_flags = atsc3_cursor_read_u32(&cursor) & 0xFFFFFF;
+	atsc3_cursor_skip(&cursor, 4 + ((tfhd_flags & 0x1) ? 8 : 0) + ((tfhd_flags & 0x2) ? 4 : 0));
+	uint32_t default_duration = (tfhd_flags & 0x08) ? atsc3_cursor_read_u32(&cursor) : 0;
+	uint32_t default_size = (tfhd_flags & 0x10) ? atsc3_cursor_read_u32(&cursor) : 0;
+	uint32_t default_flags = (tfhd_flags & 0x20) ? atsc3_cursor_read_u32(&cursor) : 0;
+
+	atsc3_cursor_init(&cursor, (uint8_t*)trun, trun_length);
+	uint32_t trun_flags = atsc3_cursor_read_u32(&cursor) & 0xFFFFFF;
+	uint32_t sample_count = atsc3_cursor_read_u32(&cursor);
+	atsc3_cursor_skip(&cursor, (trun_flags & 0x1) ? 4 : 0);
+	uint32_t first_sample_flags = (trun_flags & 0x4) ? atsc3_cursor_read_u32(&cursor) : 0;
+	if(cursor.overrun || !sample_count || sample_count > MFU_SAMPLE_EMITTER_MAX_SAMPLES) {
+		return;
+	}
+
+	if(sample_count > bench_asset->sample_table_capacity) {
+		mpu_sample_timing_t* sample_table = realloc(bench_asset->sample_table, sample_count * sizeof(mpu_sample_timing_t));
+		if(!sample_table) {
+			return;
+		}
+		bench_asset->sample_table = sample_table;
+		bench_asset->sample_table_capacity = sample_count;
+	}
+
+	for(uint32_t i = 0; i < sample_count; i++) {
+		mpu_sample_timing_t* sample_timing = &bench_asset->sample_table[i];
+		sample_timing->duration = (trun_flags & 0x100) ? atsc3_cursor_read_u32(&cursor) : default_duration;
+		sample_timing->size = (trun_flags & 0x200) ? atsc3_cursor_read_u32(&cursor) : default_size;
+		sample_timing->flags = (trun_flags & 0x400) ? atsc3_cursor_read_u32(&cursor) : (i == 0 && (trun_flags & 0x4)) ? first_sample_flags : default_flags;
+		sample_timing->composition_time_offset = (trun_flags & 0x800) ? (int32_t)atsc3_cursor_read_u32(&cursor) : 0;
+	}
+	if(cursor.overrun) {
+		return;
+	}
+
+	bench_pipeline->stats.sample_tables++;
+	mfu_sample_emitter_set_sample_table(&bench_asset->mfu_sample_emitter, mpu_sequence_number, bench_asset->timescale ? bench_asset->timescale : 90000,
+			bench_asset->sample_table, sample_count, bench_sample_emit, &bench_pipeline->stats);
+}
+
+static void bench_metadata_data_unit(bench_pipeline_t* bench_pipeline, bench_asset_t* bench_asset, mmtp_payload_fragments_union_t* mpu_type_packet,
+		uint8_t* data_unit, uint32_t data_unit_length) {
+	uint8_t fragment_type = mpu_type_packet->mmtp_mpu_type_packet_header.mpu_fragment_type;
+	uint8_t fragmentation_indicator = mpu_type_packet->mmtp_mpu_type_packet_header.mpu_fragmentation_indicator;
+	uint32_t mpu_sequence_number = mpu_type_packet->mmtp_mpu_type_packet_header.mpu_sequence_number;
+	mpu_reassembly_buffer_t* mpu_reassembly_buffer = fragment_type == 0x0 ? &bench_asset->mpu_metadata : &bench_asset->movie_fragment_metadata;
+
+	if(fragmentation_indicator == 0 || fragmentation_indicator == 1) {
+		mpu_reassembly_buffer_begin(mpu_reassembly_buffer, bench_asset->packet_id, mpu_sequence_number, 0);
+	} else if(!mpu_reassembly_buffer_matches(mpu_reassembly_buffer, bench_asset->packet_id, mpu_sequence_number)) {
+		return;
+	}
+	if(mpu_reassembly_buffer_append(mpu_reassembly_buffer, data_unit, data_unit_length) || fragmentation_indicator == 1 || fragmentation_indicator == 2) {
+		return;
+	}
+
+	size_t length;
+	uint8_t* metadata = mpu_reassembly_buffer_detach(mpu_reassembly_buffer, &length);
+	if(!metadata) {
+		return;
+	}
+	if(fragment_type == 0x0) {
+		bench_mpu_metadata(bench_asset, metadata, length);
+	} else {
+		bench_movie_fragment_metadata(bench_pipeline, bench_asset, mpu_sequence_number, metadata, length);
+	}
+	free(metadata);
+}
+
+static void bench_pipeline_packet(bench_pipeline_t* bench_pipeline, uint8_t* packet, size_t length) {
+	mmtp_payload_fragments_union_t mpu_type_packet;
+	atsc3_cursor_t cursor;
+	atsc3_cursor_init(&cursor, packet, length);
+
+	memset(&mpu_type_packet, 0, sizeof(mpu_type_packet));
+	if(mmtp_packet_header_parse_from_cursor(&mpu_type_packet, &cursor) || mpu_type_packet.mmtp_packet_header.mmtp_payload_type != 0x0 ||
+			mmtp_mpu_packet_header_parse_from_cursor(&mpu_type_packet, &cursor)) {
+		bench_pipeline->stats.packets_rejected++;
+		return;
+	}
+	bench_pipeline->stats.packets_parsed++;
+
+	bench_asset_t* bench_asset = bench_asset_get(bench_pipeline, mpu_type_packet.mmtp_packet_header.mmtp_packet_id);
+	if(!bench_asset) {
+		return;
+	}
+
+	//mmtp_timestamp is ntp32, 1/65536 s
+	int64_t packet_pts_us = (int64_t)mpu_type_packet.mmtp_packet_header.mmtp_timestamp * 1000000 / 65536;
+	do {
+		uint8_t* data_unit;
+		uint32_t data_unit_length;
+		if(mmtp_mpu_data_unit_parse_from_cursor(&mpu_type_packet, &cursor, &data_unit, &data_unit_length)) {
+			break;
+		}
+		bench_pipeline->stats.data_units++;
+
+		uint8_t fragment_type = mpu_type_packet.mmtp_mpu_type_packet_header.mpu_fragment_type;
+		if(fragment_type == 0x0 || fragment_type == 0x1) {
+			bench_metadata_data_unit(bench_pipeline, bench_asset, &mpu_type_packet, data_unit, data_unit_length);
+		} else if(fragment_type == 0x2 && mpu_type_packet.mmtp_mpu_type_packet_header.mpu_timed_flag) {
+			mfu_sample_emitter_push(&bench_asset->mfu_sample_emitter, mpu_type_packet.mmtp_mpu_type_packet_header.mpu_sequence_number,
+					mpu_type_packet.mpu_data_unit_payload_fragments_timed.sample_number,
+					mpu_type_packet.mmtp_mpu_type_packet_header.mpu_fragmentation_indicator,
+					mpu_type_packet.mmtp_mpu_type_packet_header.mpu_fragmentation_counter,
+					data_unit, data_unit_length, packet_pts_us, bench_sample_emit, &bench_pipeline->stats);
+		}
+	} while(mpu_type_packet.mmtp_mpu_type_packet_header.mpu_aggregation_flag && atsc3_cursor_remaining(&cursor));
+}
+
+static int64_t bench_now_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int bench_compare_u32(const void* a, const void* b) {
+	uint32_t x = *(const uint32_t*)a;
+	uint32_t y = *(const uint32_t*)b;
+	return x < y ? -1 : x > y;
+}
+
+static int bench_run(bench_corpus_t* corpus, int iterations) {
+	if(!corpus->packets_n) {
+		_BENCH_ERROR("%s: no packets", corpus->name);
+		return -1;
+	}
+
+	size_t samples_n = corpus->packets_n * iterations;
+	uint32_t* latency_ns = malloc(samples_n * sizeof(uint32_t));
+	//the pipeline holds views into the packet, parse a private copy so the corpus stays pristine between iterations
+	uint8_t* packet = malloc(UINT16_MAX);
+	bench_pipeline_t* bench_pipeline = calloc(1, sizeof(bench_pipeline_t));
+	if(!latency_ns || !packet || !bench_pipeline) {
+		free(latency_ns);
+		free(packet);
+		free(bench_pipeline);
+		return -1;
+	}
+
+	bench_stats_t stats = { 0 };
+	int64_t elapsed_ns = 0;
+	bench_allocations = 0;
+
+	for(int iteration = 0; iteration < iterations; iteration++) {
+		for(size_t i = 0; i < corpus->packets_n; i++) {
+			size_t length = corpus->offsets[i + 1] - corpus->offsets[i];
+			memcpy(packet, &corpus->data[corpus->offsets[i]], length);
+
+			bench_counting = true;
+			int64_t start_ns = bench_now_ns();
+			bench_pipeline_packet(bench_pipeline, packet, length);
+			int64_t packet_ns = bench_now_ns() - start_ns;
+			bench_counting = false;
+
+			elapsed_ns += packet_ns;
+			latency_ns[iteration * corpus->packets_n + i] = packet_ns > UINT32_MAX ? UINT32_MAX : (uint32_t)packet_ns;
+		}
+
+		//what is still pending at the end of the corpus is flushed, as on close
+		for(int i = 0; i < BENCH_MAX_ASSETS; i++) {
+			if(bench_pipeline->assets[i].in_use) {
+				mfu_sample_emitter_flush(&bench_pipeline->assets[i].mfu_sample_emitter, bench_sample_emit, &bench_pipeline->stats);
+			}
+		}
+		stats = bench_pipeline->stats;
+		bench_pipeline_free(bench_pipeline);
+	}
+
+	qsort(latency_ns, samples_n, sizeof(uint32_t), bench_compare_u32);
+	double seconds = elapsed_ns / 1e9;
+	uint64_t packets = (uint64_t)corpus->packets_n * iterations;
+
+	_BENCH_PRINTLN("%s: packets: %zu, bytes: %zu, iterations: %d, rejected: %llu, samples: %llu, sample tables: %llu, checksum: %08x",
+			corpus->name, corpus->packets_n, corpus->size, iterations, (unsigned long long)stats.packets_rejected,
+			(unsigned long long)stats.samples, (unsigned long long)stats.sample_tables, stats.checksum);
+	_BENCH_PRINTLN("%s: packets/s: %.0f, MB/s: %.1f, allocations/packet: %.3f, p50: %u ns, p99: %u ns",
+			corpus->name, seconds > 0 ? packets / seconds : 0, seconds > 0 ? corpus->size * (double)iterations / seconds / 1e6 : 0,
+			(double)bench_allocations / packets, latency_ns[samples_n / 2], latency_ns[(samples_n * 99) / 100]);
+
+	free(latency_ns);
+	free(packet);
+	free(bench_pipeline);
+	return 0;
+}
+
+int main(int argc, char* argv[]) {
+	int iterations = BENCH_DEFAULT_ITERATIONS;
+	uint32_t dst_ip_addr = 0;
+	uint16_t dst_port = 0;
+	int failed = 0;
+	int corpora = 0;
+
+	for(int i = 1; i < argc; i++) {
+		if(!strcmp(argv[i], "-n") && i + 1 < argc) {
+			iterations = atoi(argv[++i]);
+			if(iterations < 1) {
+				iterations = 1;
+			}
+		} else if(!strcmp(argv[i], "-d") && i + 1 < argc) {
+			char* dst = argv[++i];
+			char* port = strchr(dst, ':');
+			if(port) {
+				*port++ = '\0';
+				dst_port = atoi(port);
+			}
+			if(*dst && udp_flow_parse_ip_addr(dst, &dst_ip_addr)) {
+				_BENCH_ERROR("-d %s: expected dst_ip:dst_port", dst);
+				return -1;
+			}
+		} else {
+			bench_corpus_t corpus = { 0 };
+			if(bench_corpus_load_pcap(&corpus, argv[i], dst_ip_addr, dst_port) || bench_run(&corpus, iterations)) {
+				failed = -1;
+			}
+			bench_corpus_free(&corpus);
+			corpora++;
+		}
+	}
+
+	if(!corpora) {
+		bench_corpus_t corpus = { 0 };
+		if(bench_corpus_synthetic(&corpus) || bench_run(&corpus, iterations)) {
+			failed = -1;
+		}
+		bench_corpus_free(&corpus);
+	}
+
+	return failed;
+}
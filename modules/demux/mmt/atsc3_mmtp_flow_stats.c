@@ -0,0 +1,138 @@
+/*
+ * atsc3_mmtp_flow_stats.c
+ *
+ *  Created on: Feb 23, 2019
+ *      Author: jjustman
+ */
+
+#include "atsc3_mmtp_flow_stats.h"
+
+#include <string.h>
+
+void mmtp_flow_stats_init(mmtp_flow_stats_t* mmtp_flow_stats) {
+	memset(mmtp_flow_stats, 0, sizeof(mmtp_flow_stats_t));
+}
+
+static void __mmtp_flow_stats_sequence(mmtp_flow_stats_t* mmtp_flow_stats, uint32_t packet_sequence_number, bool fec_recovered) {
+	if(!mmtp_flow_stats->has_next_packet_sequence_number) {
+		mmtp_flow_stats->has_next_packet_sequence_number = true;
+		mmtp_flow_stats->next_packet_sequence_number = packet_sequence_number + 1;
+		return;
+	}
+
+	int32_t delta = (int32_t)(packet_sequence_number - mmtp_flow_stats->next_packet_sequence_number);
+	if(delta >= 0) {
+		if(delta > 0) {
+			mmtp_flow_stats->packets_lost += (uint32_t)delta;
+			mmtp_flow_stats->gaps++;
+		}
+		mmtp_flow_stats->next_packet_sequence_number = packet_sequence_number + 1;
+		return;
+	}
+
+	//late, it fills a gap we already counted
+	if(!fec_recovered) {
+		mmtp_flow_stats->packets_out_of_order++;
+	}
+	if(mmtp_flow_stats->packets_lost) {
+		mmtp_flow_stats->packets_lost--;
+	}
+}
+
+void mmtp_flow_stats_push_packet(mmtp_flow_stats_t* mmtp_flow_stats, uint32_t packet_sequence_number, size_t length,
+		uint32_t mmtp_timestamp, int64_t arrival_us, bool fec_recovered) {
+	__mmtp_flow_stats_sequence(mmtp_flow_stats, packet_sequence_number, fec_recovered);
+
+	//a recovered packet's arrival says nothing about the network
+	if(fec_recovered) {
+		mmtp_flow_stats->packets_fec_recovered++;
+		return;
+	}
+
+	mmtp_flow_stats->packets++;
+	mmtp_flow_stats->bytes += length;
+
+	//D(i-1,i) = (R_i - R_i-1) - (S_i - S_i-1), J += (|D| - J) / 16
+	if(mmtp_flow_stats->has_transit) {
+		int64_t send_delta_us = (int64_t)(int32_t)(mmtp_timestamp - mmtp_flow_stats->last_mmtp_timestamp) * 1000000 / 65536;
+		int64_t d = (arrival_us - mmtp_flow_stats->last_arrival_us) - send_delta_us;
+		if(d < 0) {
+			d = -d;
+		}
+		mmtp_flow_stats->jitter_q4 += d - ((mmtp_flow_stats->jitter_q4 + 8) >> 4);
+	}
+	mmtp_flow_stats->has_transit = true;
+	mmtp_flow_stats->last_mmtp_timestamp = mmtp_timestamp;
+	mmtp_flow_stats->last_arrival_us = arrival_us;
+}
+
+void mmtp_flow_stats_push_mfu(mmtp_flow_stats_t* mmtp_flow_stats, uint32_t mpu_sequence_number, int64_t arrival_us) {
+	if(mmtp_flow_stats->has_mpu && mmtp_flow_stats->mpu_sequence_number == mpu_sequence_number) {
+		return;
+	}
+
+	if(mmtp_flow_stats->has_mpu && !mmtp_flow_stats->mpu_is_complete) {
+		mmtp_flow_stats->mpus_incomplete++;
+	}
+	mmtp_flow_stats->has_mpu = true;
+	mmtp_flow_stats->mpu_is_complete = false;
+	mmtp_flow_stats->mpu_sequence_number = mpu_sequence_number;
+	mmtp_flow_stats->mpu_first_arrival_us = arrival_us;
+}
+
+void mmtp_flow_stats_mpu_complete(mmtp_flow_stats_t* mmtp_flow_stats, uint32_t mpu_sequence_number, int64_t now_us) {
+	if(!mmtp_flow_stats->has_mpu || mmtp_flow_stats->mpu_is_complete || mmtp_flow_stats->mpu_sequence_number != mpu_sequence_number) {
+		return;
+	}
+	mmtp_flow_stats->mpu_is_complete = true;
+	mmtp_flow_stats->mpus_completed++;
+
+	int64_t latency_us = now_us - mmtp_flow_stats->mpu_first_arrival_us;
+	int bucket = 0;
+	while(bucket < MMTP_FLOW_STATS_LATENCY_BUCKETS - 1 && latency_us >= mmtp_flow_stats_latency_bucket_max_us(bucket)) {
+		bucket++;
+	}
+	mmtp_flow_stats->reassembly_latency_histogram[bucket]++;
+}
+
+int64_t mmtp_flow_stats_latency_bucket_max_us(int bucket) {
+	if(bucket >= MMTP_FLOW_STATS_LATENCY_BUCKETS - 1) {
+		return INT64_MAX;
+	}
+	return (int64_t)1000 << bucket;
+}
+
+int64_t mmtp_flow_stats_latency_percentile_us(const mmtp_flow_stats_t* mmtp_flow_stats, unsigned percentile) {
+	uint64_t total = 0;
+	for(int i=0; i < MMTP_FLOW_STATS_LATENCY_BUCKETS; i++) {
+		total += mmtp_flow_stats->reassembly_latency_histogram[i];
+	}
+	if(!total) {
+		return -1;
+	}
+
+	//smallest bucket covering at least percentile% of the MPUs
+	uint64_t wanted = (total * (percentile > 100 ? 100 : percentile) + 99) / 100;
+	uint64_t seen = 0;
+	for(int i=0; i < MMTP_FLOW_STATS_LATENCY_BUCKETS; i++) {
+		seen += mmtp_flow_stats->reassembly_latency_histogram[i];
+		if(seen >= wanted && seen) {
+			return mmtp_flow_stats_latency_bucket_max_us(i);
+		}
+	}
+	return INT64_MAX;
+}
+
+void mmtp_flow_stats_dump(const mmtp_flow_stats_t* mmtp_flow_stats, uint16_t mmtp_packet_id) {
+	_MMTP_FLOW_STATS_INFO("mmtp_flow_stats: packet_id: %hu, packets: %llu, bytes: %llu, lost: %llu in %llu gaps, out of order: %llu, fec recovered: %llu, mpus completed: %llu, incomplete: %llu, jitter: %lld us",
+			mmtp_packet_id,
+			(unsigned long long)mmtp_flow_stats->packets,
+			(unsigned long long)mmtp_flow_stats->bytes,
+			(unsigned long long)mmtp_flow_stats->packets_lost,
+			(unsigned long long)mmtp_flow_stats->gaps,
+			(unsigned long long)mmtp_flow_stats->packets_out_of_order,
+			(unsigned long long)mmtp_flow_stats->packets_fec_recovered,
+			(unsigned long long)mmtp_flow_stats->mpus_completed,
+			(unsigned long long)mmtp_flow_stats->mpus_incomplete,
+			(long long)mmtp_flow_stats_jitter_us(mmtp_flow_stats));
+}
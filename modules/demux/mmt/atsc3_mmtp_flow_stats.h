@@ -0,0 +1,86 @@
+/*
+ * atsc3_mmtp_flow_stats.h
+ *
+ *  Created on: Feb 23, 2019
+ *      Author: jjustman
+ *
+ * per packet_id ingest health counters, cheap enough to be kept for every packet.
+ *
+ * sequence: packet_sequence_number jumps ahead count as lost and as a gap, packets arriving behind the
+ * expected packet_sequence_number count as out of order and are taken back off the lost count.
+ *
+ * jitter: RFC 3550 interarrival jitter of the mmtp_timestamp (the sender clock the pcr is recovered from)
+ * against the arrival time.
+ *
+ * mpus: a timed MPU is complete once all of its samples were emitted, the reassembly latency is the time
+ * from its first MFU arriving until then. an MPU that is still incomplete when the next one starts is
+ * counted as incomplete.
+ *
+ * not thread-safe, all calls for a flow must come from the same thread.
+ */
+
+#ifndef MODULES_DEMUX_MMT_ATSC3_MMTP_FLOW_STATS_H_
+#define MODULES_DEMUX_MMT_ATSC3_MMTP_FLOW_STATS_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define _MMTP_FLOW_STATS_PRINTLN(...) printf(__VA_ARGS__);printf("\n")
+#define _MMTP_FLOW_STATS_INFO(...)    printf("%s:%d:INFO :",__FILE__,__LINE__);_MMTP_FLOW_STATS_PRINTLN(__VA_ARGS__);
+
+//reassembly latency buckets: under 1 ms, then doubling up to 2^(n-2) ms, the last is everything above
+#define MMTP_FLOW_STATS_LATENCY_BUCKETS 14
+
+typedef struct mmtp_flow_stats {
+	uint64_t	packets;
+	uint64_t	bytes;
+	uint64_t	packets_lost;				//packet_sequence_numbers skipped and not seen since
+	uint64_t	gaps;						//runs of skipped packet_sequence_numbers
+	uint64_t	packets_out_of_order;		//behind the expected packet_sequence_number, duplicates included
+	uint64_t	packets_fec_recovered;
+	uint64_t	mpus_completed;
+	uint64_t	mpus_incomplete;
+	uint64_t	reassembly_latency_histogram[MMTP_FLOW_STATS_LATENCY_BUCKETS];
+
+	//jitter, in us and scaled by 16 as in RFC 3550 A.8
+	int64_t		jitter_q4;
+
+	bool		has_next_packet_sequence_number;
+	uint32_t	next_packet_sequence_number;
+	bool		has_transit;
+	uint32_t	last_mmtp_timestamp;
+	int64_t		last_arrival_us;
+
+	bool		has_mpu;
+	bool		mpu_is_complete;
+	uint32_t	mpu_sequence_number;
+	int64_t		mpu_first_arrival_us;
+} mmtp_flow_stats_t;
+
+void mmtp_flow_stats_init(mmtp_flow_stats_t* mmtp_flow_stats);
+
+//a packet as received, mmtp_timestamp in the ntp short format. recovered packets only count as recovered
+void mmtp_flow_stats_push_packet(mmtp_flow_stats_t* mmtp_flow_stats, uint32_t packet_sequence_number, size_t length,
+		uint32_t mmtp_timestamp, int64_t arrival_us, bool fec_recovered);
+
+//every timed MFU of an MPU, in release order
+void mmtp_flow_stats_push_mfu(mmtp_flow_stats_t* mmtp_flow_stats, uint32_t mpu_sequence_number, int64_t arrival_us);
+
+//all samples of mpu_sequence_number were emitted, further calls for it are ignored
+void mmtp_flow_stats_mpu_complete(mmtp_flow_stats_t* mmtp_flow_stats, uint32_t mpu_sequence_number, int64_t now_us);
+
+static inline int64_t mmtp_flow_stats_jitter_us(const mmtp_flow_stats_t* mmtp_flow_stats) {
+	return mmtp_flow_stats->jitter_q4 >> 4;
+}
+
+//upper bound of a latency bucket in us, INT64_MAX for the last one
+int64_t mmtp_flow_stats_latency_bucket_max_us(int bucket);
+
+//upper bound of the bucket holding the given percentile (0-100) of completed MPUs, -1 if there are none
+int64_t mmtp_flow_stats_latency_percentile_us(const mmtp_flow_stats_t* mmtp_flow_stats, unsigned percentile);
+
+void mmtp_flow_stats_dump(const mmtp_flow_stats_t* mmtp_flow_stats, uint16_t mmtp_packet_id);
+
+#endif /* MODULES_DEMUX_MMT_ATSC3_MMTP_FLOW_STATS_H_ */
@@ -0,0 +1,143 @@
+/*
+ *
+ * atsc3_mmtp_flow_stats_test.c:  driver for per packet_id sequence, jitter and MPU reassembly counters
+ *
+ */
+
+#include "atsc3_mmtp_flow_stats.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define __UNIT_TEST 1
+#ifdef __UNIT_TEST
+
+//20 ms in the ntp short format
+#define __TEST_NTP32_20MS 1311
+
+int test_mmtp_flow_stats_sequence();
+int test_mmtp_flow_stats_sequence_wrap();
+int test_mmtp_flow_stats_jitter();
+int test_mmtp_flow_stats_mpu();
+
+int main() {
+	int failed = 0;
+
+	failed |= test_mmtp_flow_stats_sequence();
+	failed |= test_mmtp_flow_stats_sequence_wrap();
+	failed |= test_mmtp_flow_stats_jitter();
+	failed |= test_mmtp_flow_stats_mpu();
+
+	return failed;
+}
+
+//0 1 2 5 6 3 7 (8 recovered) 10: 3 and 4 go missing, 3 shows up late, 8 and 9 are missing until 8 is recovered
+int test_mmtp_flow_stats_sequence() {
+	mmtp_flow_stats_t stats;
+	mmtp_flow_stats_init(&stats);
+
+	const uint32_t received[] = { 0, 1, 2, 5, 6, 3, 7, 10 };
+	for(size_t i=0; i < sizeof(received) / sizeof(received[0]); i++) {
+		mmtp_flow_stats_push_packet(&stats, received[i], 1000, 0, 0, false);
+	}
+	mmtp_flow_stats_push_packet(&stats, 8, 1000, 0, 0, true);
+
+	if(stats.packets != 8 || stats.bytes != 8000 || stats.gaps != 2 || stats.packets_lost != 2 ||
+			stats.packets_out_of_order != 1 || stats.packets_fec_recovered != 1) {
+		_MMTP_FLOW_STATS_INFO("test_mmtp_flow_stats_sequence: packets: %llu, gaps: %llu, lost: %llu, out of order: %llu, recovered: %llu",
+				(unsigned long long)stats.packets, (unsigned long long)stats.gaps, (unsigned long long)stats.packets_lost,
+				(unsigned long long)stats.packets_out_of_order, (unsigned long long)stats.packets_fec_recovered);
+		return -1;
+	}
+	return 0;
+}
+
+int test_mmtp_flow_stats_sequence_wrap() {
+	mmtp_flow_stats_t stats;
+	mmtp_flow_stats_init(&stats);
+
+	mmtp_flow_stats_push_packet(&stats, UINT32_MAX - 1, 100, 0, 0, false);
+	mmtp_flow_stats_push_packet(&stats, UINT32_MAX, 100, 0, 0, false);
+	mmtp_flow_stats_push_packet(&stats, 1, 100, 0, 0, false);
+
+	if(stats.packets_lost != 1 || stats.gaps != 1 || stats.packets_out_of_order) {
+		_MMTP_FLOW_STATS_INFO("test_mmtp_flow_stats_sequence_wrap: lost: %llu, gaps: %llu, out of order: %llu",
+				(unsigned long long)stats.packets_lost, (unsigned long long)stats.gaps, (unsigned long long)stats.packets_out_of_order);
+		return -1;
+	}
+	return 0;
+}
+
+//packets sent every 20 ms arrive every 20 ms with no jitter, then alternate 15 and 25 ms apart
+int test_mmtp_flow_stats_jitter() {
+	mmtp_flow_stats_t stats;
+	mmtp_flow_stats_init(&stats);
+
+	uint32_t mmtp_timestamp = 0xFFFF0000;	//wraps the ntp short format along the way
+	int64_t arrival_us = 1000000;
+	for(uint32_t i=0; i < 100; i++) {
+		mmtp_flow_stats_push_packet(&stats, i, 100, mmtp_timestamp, arrival_us, false);
+		mmtp_timestamp += __TEST_NTP32_20MS;
+		arrival_us += 20000;
+	}
+	if(mmtp_flow_stats_jitter_us(&stats) > 10) {
+		_MMTP_FLOW_STATS_INFO("test_mmtp_flow_stats_jitter: steady flow, jitter: %lld us", (long long)mmtp_flow_stats_jitter_us(&stats));
+		return -1;
+	}
+
+	for(uint32_t i=100; i < 400; i++) {
+		mmtp_flow_stats_push_packet(&stats, i, 100, mmtp_timestamp, arrival_us, false);
+		mmtp_timestamp += __TEST_NTP32_20MS;
+		arrival_us += (i & 1) ? 25000 : 15000;
+	}
+
+	//|D| is 5 ms every packet, J converges on it
+	int64_t jitter_us = mmtp_flow_stats_jitter_us(&stats);
+	if(jitter_us < 4900 || jitter_us > 5100) {
+		_MMTP_FLOW_STATS_INFO("test_mmtp_flow_stats_jitter: alternating flow, jitter: %lld us", (long long)jitter_us);
+		return -1;
+	}
+	return 0;
+}
+
+//MPU 1 completes after 3 ms, MPU 2 never does, MPU 3 completes after 300 ms
+int test_mmtp_flow_stats_mpu() {
+	mmtp_flow_stats_t stats;
+	mmtp_flow_stats_init(&stats);
+
+	mmtp_flow_stats_push_mfu(&stats, 1, 0);
+	mmtp_flow_stats_push_mfu(&stats, 1, 1000);
+	mmtp_flow_stats_mpu_complete(&stats, 1, 3000);
+	mmtp_flow_stats_mpu_complete(&stats, 1, 9000);
+
+	mmtp_flow_stats_push_mfu(&stats, 2, 10000);
+	mmtp_flow_stats_mpu_complete(&stats, 1, 12000);
+
+	mmtp_flow_stats_push_mfu(&stats, 3, 20000);
+	mmtp_flow_stats_mpu_complete(&stats, 3, 320000);
+
+	if(stats.mpus_completed != 2 || stats.mpus_incomplete != 1 ||
+			stats.reassembly_latency_histogram[2] != 1 || stats.reassembly_latency_histogram[9] != 1) {
+		_MMTP_FLOW_STATS_INFO("test_mmtp_flow_stats_mpu: completed: %llu, incomplete: %llu",
+				(unsigned long long)stats.mpus_completed, (unsigned long long)stats.mpus_incomplete);
+		return -1;
+	}
+
+	if(mmtp_flow_stats_latency_percentile_us(&stats, 50) != 4000 || mmtp_flow_stats_latency_percentile_us(&stats, 99) != 512000) {
+		_MMTP_FLOW_STATS_INFO("test_mmtp_flow_stats_mpu: p50: %lld, p99: %lld",
+				(long long)mmtp_flow_stats_latency_percentile_us(&stats, 50), (long long)mmtp_flow_stats_latency_percentile_us(&stats, 99));
+		return -1;
+	}
+
+	mmtp_flow_stats_t empty;
+	mmtp_flow_stats_init(&empty);
+	if(mmtp_flow_stats_latency_percentile_us(&empty, 50) != -1) {
+		return -1;
+	}
+	return 0;
+}
+
+#endif
@@ -0,0 +1,141 @@
+/*
+ *
+ * atsc3_mmtp_fragment_store_test.c:  driver for mpu fragment store lifecycle, ring recycling and max_bytes eviction
+ *
+ */
+
+#include "atsc3_mmtp_types.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define __UNIT_TEST 1
+#ifdef __UNIT_TEST
+
+#define TEST_FRAGMENT_PAYLOAD_LENGTH 1000
+
+static int __released_payload_count = 0;
+
+//payloads are opaque to the store, use a heap allocation as our stand-in block_t
+void __test_payload_release(block_t* mpu_data_unit_payload) {
+	__released_payload_count++;
+	free(mpu_data_unit_payload);
+}
+
+void __assign_test_mfu(mmtp_sub_flow_t* mmtp_sub_flow, uint32_t mpu_sequence_number) {
+	mmtp_payload_fragments_union_t* mmtp_packet = mmtp_fragment_store_packet_alloc(mmtp_sub_flow->mmtp_sub_flow_vector);
+
+	mmtp_packet->mmtp_packet_header.mmtp_payload_type = 0x00;
+	mmtp_packet->mmtp_packet_header.mmtp_packet_id = mmtp_sub_flow->mmtp_packet_id;
+	mmtp_packet->mmtp_mpu_type_packet_header.mpu_fragment_type = 0x02;
+	mmtp_packet->mmtp_mpu_type_packet_header.mpu_timed_flag = 1;
+	mmtp_packet->mmtp_mpu_type_packet_header.mpu_sequence_number = mpu_sequence_number;
+	mmtp_packet->mmtp_mpu_type_packet_header.mpu_data_unit_payload = malloc(TEST_FRAGMENT_PAYLOAD_LENGTH);
+	mmtp_packet->mmtp_mpu_type_packet_header.mpu_data_unit_payload_length = TEST_FRAGMENT_PAYLOAD_LENGTH;
+
+	mmtp_sub_flow_push_mmtp_packet(mmtp_sub_flow, mmtp_packet);
+	mpu_fragments_assign_to_payload_vector(mmtp_sub_flow, mmtp_packet);
+}
+
+int test_mmtp_fragment_store_ring_recycle();
+int test_mmtp_fragment_store_max_bytes_eviction();
+
+int main() {
+	int failed = 0;
+
+	failed |= test_mmtp_fragment_store_ring_recycle();
+	failed |= test_mmtp_fragment_store_max_bytes_eviction();
+
+	return failed;
+}
+
+int test_mmtp_fragment_store_ring_recycle() {
+	mmtp_sub_flow_vector_t mmtp_sub_flow_vector;
+	mmtp_sub_flow_vector_init(&mmtp_sub_flow_vector);
+	mmtp_fragment_store_configure(&mmtp_sub_flow_vector, 0, __test_payload_release);
+	__released_payload_count = 0;
+
+	mmtp_sub_flow_t* mmtp_sub_flow = mmtp_sub_flow_vector_get_or_set_packet_id(&mmtp_sub_flow_vector, 0x23);
+
+	//emit mpu 0 after its fragments arrive, then run past the ring so every slot is reused once
+	for(int i=0; i < 4; i++) {
+		__assign_test_mfu(mmtp_sub_flow, 0);
+	}
+	mmtp_fragment_store_mpu_complete(mmtp_sub_flow, 0);
+	mmtp_fragment_store_mpu_emitted(mmtp_sub_flow, 0);
+
+	for(uint32_t mpu_sequence_number=1; mpu_sequence_number <= MPU_IN_FLIGHT_RING_SIZE + 1; mpu_sequence_number++) {
+		__assign_test_mfu(mmtp_sub_flow, mpu_sequence_number);
+	}
+
+	mmtp_fragment_store_t* fragment_store = &mmtp_sub_flow_vector.fragment_store;
+
+	//mpu 0 was emitted before its slot was reused, mpu 1 was still collecting
+	if(__released_payload_count != 5 || fragment_store->stats.mpus_recycled != 2 || fragment_store->stats.mpus_evicted != 1 ||
+		fragment_store->bytes_in_use != MPU_IN_FLIGHT_RING_SIZE * TEST_FRAGMENT_PAYLOAD_LENGTH) {
+		_MMTP_ERROR("test_mmtp_fragment_store_ring_recycle: released: %d, recycled: %llu, evicted: %llu, bytes_in_use: %zu",
+				__released_payload_count, (unsigned long long)fragment_store->stats.mpus_recycled,
+				(unsigned long long)fragment_store->stats.mpus_evicted, fragment_store->bytes_in_use);
+		return -1;
+	}
+
+	mmtp_sub_flow_vector_free(&mmtp_sub_flow_vector);
+	if(__released_payload_count != 5 + MPU_IN_FLIGHT_RING_SIZE || fragment_store->bytes_in_use != 0) {
+		_MMTP_ERROR("test_mmtp_fragment_store_ring_recycle: after free, released: %d, bytes_in_use: %zu", __released_payload_count, fragment_store->bytes_in_use);
+		return -1;
+	}
+
+	_MMTP_INFO("test_mmtp_fragment_store_ring_recycle: released %d payloads", __released_payload_count);
+	return 0;
+}
+
+int test_mmtp_fragment_store_max_bytes_eviction() {
+	mmtp_sub_flow_vector_t mmtp_sub_flow_vector;
+	mmtp_sub_flow_vector_init(&mmtp_sub_flow_vector);
+	mmtp_fragment_store_configure(&mmtp_sub_flow_vector, 3 * TEST_FRAGMENT_PAYLOAD_LENGTH, __test_payload_release);
+	__released_payload_count = 0;
+
+	mmtp_sub_flow_t* video_sub_flow = mmtp_sub_flow_vector_get_or_set_packet_id(&mmtp_sub_flow_vector, 0x23);
+	mmtp_sub_flow_t* audio_sub_flow = mmtp_sub_flow_vector_get_or_set_packet_id(&mmtp_sub_flow_vector, 0x24);
+
+	__assign_test_mfu(video_sub_flow, 10);
+	__assign_test_mfu(audio_sub_flow, 20);
+	__assign_test_mfu(audio_sub_flow, 21);
+	mmtp_fragment_store_mpu_emitted(audio_sub_flow, 21);
+
+	//over the ceiling: emitted audio mpu 21 goes before the older, still collecting video mpu 10
+	__assign_test_mfu(video_sub_flow, 11);
+
+	mmtp_fragment_store_t* fragment_store = &mmtp_sub_flow_vector.fragment_store;
+	if(mpu_data_unit_payload_fragments_find_mpu_sequence_number(&audio_sub_flow->mpu_fragments->media_fragment_unit_vector, 21) ||
+		!mpu_data_unit_payload_fragments_find_mpu_sequence_number(&video_sub_flow->mpu_fragments->media_fragment_unit_vector, 10) ||
+		fragment_store->stats.mpus_evicted != 0) {
+		_MMTP_ERROR("test_mmtp_fragment_store_max_bytes_eviction: emitted mpu was not recycled first");
+		return -1;
+	}
+
+	//next oldest is video mpu 10
+	__assign_test_mfu(video_sub_flow, 12);
+	if(mpu_data_unit_payload_fragments_find_mpu_sequence_number(&video_sub_flow->mpu_fragments->media_fragment_unit_vector, 10) ||
+		fragment_store->stats.mpus_evicted != 1 || fragment_store->stats.bytes_evicted != TEST_FRAGMENT_PAYLOAD_LENGTH ||
+		fragment_store->bytes_in_use > fragment_store->max_bytes) {
+		_MMTP_ERROR("test_mmtp_fragment_store_max_bytes_eviction: evicted: %llu, bytes_in_use: %zu",
+				(unsigned long long)fragment_store->stats.mpus_evicted, fragment_store->bytes_in_use);
+		return -1;
+	}
+
+	mmtp_fragment_store_stats_dump(&mmtp_sub_flow_vector);
+	mmtp_sub_flow_vector_free(&mmtp_sub_flow_vector);
+
+	if(__released_payload_count != 5) {
+		_MMTP_ERROR("test_mmtp_fragment_store_max_bytes_eviction: released: %d", __released_payload_count);
+		return -1;
+	}
+
+	return 0;
+}
+
+#endif
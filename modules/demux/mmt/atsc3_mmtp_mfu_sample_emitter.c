@@ -0,0 +1,413 @@
+/*
+ * atsc3_mmtp_mfu_sample_emitter.c
+ *
+ *  Created on: Feb 8, 2019
+ *      Author: jjustman
+ */
+
+#include "atsc3_mmtp_mfu_sample_emitter.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static int64_t __mfu_sample_emitter_rescale_us(int64_t value, uint32_t timescale) {
+	if(!timescale) {
+		return 0;
+	}
+	return (value / timescale) * 1000000 + ((value % timescale) * 1000000) / timescale;
+}
+
+static int __mfu_sample_emitter_reserve_slots(mfu_sample_emitter_t* mfu_sample_emitter, uint32_t count) {
+	if(count <= mfu_sample_emitter->slots_capacity) {
+		return 0;
+	}
+
+	uint32_t new_capacity = mfu_sample_emitter->slots_capacity ? mfu_sample_emitter->slots_capacity : 64;
+	while(new_capacity < count) {
+		new_capacity *= 2;
+	}
+
+	mfu_sample_slot_t* slots = realloc(mfu_sample_emitter->slots, new_capacity * sizeof(mfu_sample_slot_t));
+	if(!slots) {
+		return -1;
+	}
+	memset(&slots[mfu_sample_emitter->slots_capacity], 0, (new_capacity - mfu_sample_emitter->slots_capacity) * sizeof(mfu_sample_slot_t));
+
+	mfu_sample_emitter->slots = slots;
+	mfu_sample_emitter->slots_capacity = new_capacity;
+
+	return 0;
+}
+
+static int __mfu_sample_slot_append(mfu_sample_slot_t* slot, const uint8_t* payload, size_t payload_len) {
+	if(slot->size + payload_len > MFU_SAMPLE_EMITTER_MAX_SAMPLE_SIZE) {
+		return -1;
+	}
+
+	if(slot->size + payload_len > slot->capacity) {
+		size_t new_capacity = slot->capacity ? slot->capacity : 4096;
+		while(new_capacity < slot->size + payload_len) {
+			new_capacity *= 2;
+		}
+
+		uint8_t* data = realloc(slot->data, new_capacity);
+		if(!data) {
+			return -1;
+		}
+		slot->data = data;
+		slot->capacity = new_capacity;
+	}
+
+	memcpy(&slot->data[slot->size], payload, payload_len);
+	slot->size += payload_len;
+
+	return 0;
+}
+
+//grow the current MPU to count samples, clearing per-sample state left over from earlier MPUs (buffers are kept)
+static int __mfu_sample_emitter_extend_slots(mfu_sample_emitter_t* mfu_sample_emitter, uint32_t count) {
+	if(count <= mfu_sample_emitter->slots_count) {
+		return 0;
+	}
+
+	if(__mfu_sample_emitter_reserve_slots(mfu_sample_emitter, count)) {
+		return -1;
+	}
+
+	for(uint32_t i = mfu_sample_emitter->slots_count; i < count; i++) {
+		mfu_sample_slot_t* slot = &mfu_sample_emitter->slots[i];
+		slot->size = 0;
+		slot->has_data = false;
+		slot->has_first_fragment = false;
+		slot->is_complete = false;
+		slot->is_lost = false;
+		slot->has_gap = false;
+	}
+	mfu_sample_emitter->slots_count = count;
+
+	return 0;
+}
+
+static void __mfu_sample_emitter_reset(mfu_sample_emitter_t* mfu_sample_emitter, uint32_t mpu_sequence_number) {
+	mfu_sample_emitter->in_use = true;
+	mfu_sample_emitter->mpu_sequence_number = mpu_sequence_number;
+	mfu_sample_emitter->slots_count = 0;
+	mfu_sample_emitter->next_sample_number = 1;
+	mfu_sample_emitter->has_mpu_decode_time_anchor = false;
+
+	if(mfu_sample_emitter->low_latency && mfu_sample_emitter->has_sample_table) {
+		//keep the last trun as our prediction for this MPU until its own arrives
+		mfu_sample_emitter->sample_table_is_predicted = true;
+		__mfu_sample_emitter_extend_slots(mfu_sample_emitter, mfu_sample_emitter->sample_table_count);
+	} else {
+		mfu_sample_emitter->has_sample_table = false;
+		mfu_sample_emitter->sample_table_is_predicted = false;
+		mfu_sample_emitter->sample_table_count = 0;
+	}
+}
+
+static int64_t __mfu_sample_emitter_decode_time(mfu_sample_emitter_t* mfu_sample_emitter, uint32_t sample_number) {
+	int64_t decode_time = 0;
+	for(uint32_t i=0; i < sample_number - 1 && i < mfu_sample_emitter->sample_table_count; i++) {
+		decode_time += mfu_sample_emitter->sample_table[i].duration;
+	}
+	return decode_time;
+}
+
+static mfu_mpu_presentation_time_t* __mfu_sample_emitter_find_mpu_presentation_time(mfu_sample_emitter_t* mfu_sample_emitter, uint32_t mpu_sequence_number) {
+	mfu_mpu_presentation_time_t* mpu_presentation_time = &mfu_sample_emitter->mpu_presentation_times[mpu_sequence_number % MFU_SAMPLE_EMITTER_MPU_PRESENTATION_TIMES];
+	if(!mpu_presentation_time->is_set || mpu_presentation_time->mpu_sequence_number != mpu_sequence_number) {
+		return NULL;
+	}
+	return mpu_presentation_time;
+}
+
+static void __mfu_sample_emitter_emit_sample(mfu_sample_emitter_t* mfu_sample_emitter, uint32_t sample_number, mfu_sample_emit_f emit, void* context) {
+	mfu_sample_slot_t* slot = &mfu_sample_emitter->slots[sample_number - 1];
+
+	mfu_sample_t mfu_sample;
+	memset(&mfu_sample, 0, sizeof(mfu_sample_t));
+
+	mfu_sample.mpu_sequence_number = mfu_sample_emitter->mpu_sequence_number;
+	mfu_sample.sample_number = sample_number;
+	mfu_sample.data = slot->data;
+	mfu_sample.size = slot->size;
+	mfu_sample.is_sync = true;
+	mfu_sample.slot = slot;
+
+	if(mfu_sample_emitter->has_sample_table && sample_number <= mfu_sample_emitter->sample_table_count) {
+		//decode time of this sample relative to the start of the MPU
+		int64_t decode_time = __mfu_sample_emitter_decode_time(mfu_sample_emitter, sample_number);
+		const mpu_sample_timing_t* sample_timing = &mfu_sample_emitter->sample_table[sample_number - 1];
+
+		if(!mfu_sample_emitter->has_mpu_decode_time_anchor) {
+			const mfu_mpu_presentation_time_t* mpu_presentation_time = __mfu_sample_emitter_find_mpu_presentation_time(mfu_sample_emitter, mfu_sample_emitter->mpu_sequence_number);
+			if(mpu_presentation_time) {
+				mfu_sample_emitter->mpu_decode_time_anchor_us = mpu_presentation_time->mpu_presentation_time_us -
+						__mfu_sample_emitter_rescale_us(mfu_sample_emitter->sample_table[0].composition_time_offset, mfu_sample_emitter->timescale);
+			} else {
+				mfu_sample_emitter->mpu_decode_time_anchor_us = slot->packet_pts_us - __mfu_sample_emitter_rescale_us(decode_time, mfu_sample_emitter->timescale);
+			}
+			mfu_sample_emitter->has_mpu_decode_time_anchor = true;
+		}
+
+		mfu_sample.dts_us = mfu_sample_emitter->mpu_decode_time_anchor_us + __mfu_sample_emitter_rescale_us(decode_time, mfu_sample_emitter->timescale);
+		mfu_sample.pts_us = mfu_sample_emitter->mpu_decode_time_anchor_us + __mfu_sample_emitter_rescale_us(decode_time + sample_timing->composition_time_offset, mfu_sample_emitter->timescale);
+		mfu_sample.duration_us = __mfu_sample_emitter_rescale_us(sample_timing->duration, mfu_sample_emitter->timescale);
+		mfu_sample.is_sync = !(sample_timing->flags & MFU_SAMPLE_FLAG_IS_NON_SYNC);
+		mfu_sample.is_corrupt = sample_timing->size && sample_timing->size != slot->size;
+		mfu_sample.has_sample_table = true;
+		mfu_sample.is_predicted = mfu_sample_emitter->sample_table_is_predicted;
+
+		if(mfu_sample.is_predicted) {
+			//a predicted size mismatch says nothing about the sample
+			mfu_sample.is_corrupt = false;
+			mfu_sample_emitter->stats.samples_emitted_with_predicted_sample_table++;
+		}
+	} else {
+		mfu_sample.dts_us = slot->packet_pts_us;
+		mfu_sample.pts_us = slot->packet_pts_us;
+		mfu_sample_emitter->stats.samples_emitted_without_sample_table++;
+	}
+
+	if(slot->has_gap || !slot->is_complete) {
+		mfu_sample.is_corrupt = true;
+		mfu_sample_emitter->stats.samples_emitted_partial++;
+	}
+
+	_MFU_SAMPLE_EMITTER_DEBUG("emit: mpu_sequence_number: %u, sample_number: %u, size: %zu, pts: %lld",
+			mfu_sample.mpu_sequence_number, sample_number, mfu_sample.size, (long long)mfu_sample.pts_us);
+
+	emit(context, &mfu_sample);
+	mfu_sample_emitter->stats.samples_emitted++;
+}
+
+static bool __mfu_sample_emitter_has_later_complete_samples(mfu_sample_emitter_t* mfu_sample_emitter) {
+	uint32_t complete = 0;
+	for(uint32_t i = mfu_sample_emitter->next_sample_number; i < mfu_sample_emitter->slots_count; i++) {
+		if(mfu_sample_emitter->slots[i].is_complete && ++complete >= MFU_SAMPLE_EMITTER_REORDER_SAMPLES) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * emit in decode order while the next sample is ready, skipping samples that are lost
+ * or have fallen MFU_SAMPLE_EMITTER_REORDER_SAMPLES behind.
+ *
+ * without a trun we can't time anything, so nothing leaves until it arrives or the MPU is flushed.
+ */
+static void __mfu_sample_emitter_drain(mfu_sample_emitter_t* mfu_sample_emitter, bool flush, mfu_sample_emit_f emit, void* context) {
+	if(!mfu_sample_emitter->has_sample_table && !flush) {
+		return;
+	}
+
+	while(mfu_sample_emitter->next_sample_number <= mfu_sample_emitter->slots_count) {
+		mfu_sample_slot_t* slot = &mfu_sample_emitter->slots[mfu_sample_emitter->next_sample_number - 1];
+
+		if(slot->is_complete) {
+			__mfu_sample_emitter_emit_sample(mfu_sample_emitter, mfu_sample_emitter->next_sample_number, emit, context);
+		} else if(flush || slot->is_lost || __mfu_sample_emitter_has_later_complete_samples(mfu_sample_emitter)) {
+			if(mfu_sample_emitter->emit_partial_samples && !slot->is_lost && slot->size) {
+				__mfu_sample_emitter_emit_sample(mfu_sample_emitter, mfu_sample_emitter->next_sample_number, emit, context);
+			} else {
+				mfu_sample_emitter->stats.samples_dropped++;
+			}
+		} else {
+			return;
+		}
+
+		mfu_sample_emitter->next_sample_number++;
+	}
+}
+
+static bool __mfu_sample_emitter_is_newer(uint32_t mpu_sequence_number, uint32_t current) {
+	return (int32_t)(mpu_sequence_number - current) > 0;
+}
+
+/**
+ * make mpu_sequence_number the current MPU, flushing an older one.
+ * returns -1 if mpu_sequence_number is older than the MPU in progress
+ */
+static int __mfu_sample_emitter_select_mpu(mfu_sample_emitter_t* mfu_sample_emitter, uint32_t mpu_sequence_number, mfu_sample_emit_f emit, void* context) {
+	if(!mfu_sample_emitter->in_use) {
+		__mfu_sample_emitter_reset(mfu_sample_emitter, mpu_sequence_number);
+		return 0;
+	}
+
+	if(mfu_sample_emitter->mpu_sequence_number == mpu_sequence_number) {
+		return 0;
+	}
+
+	if(!__mfu_sample_emitter_is_newer(mpu_sequence_number, mfu_sample_emitter->mpu_sequence_number)) {
+		return -1;
+	}
+
+	mfu_sample_emitter_flush(mfu_sample_emitter, emit, context);
+	__mfu_sample_emitter_reset(mfu_sample_emitter, mpu_sequence_number);
+
+	return 0;
+}
+
+int mfu_sample_emitter_set_sample_table(mfu_sample_emitter_t* mfu_sample_emitter, uint32_t mpu_sequence_number, uint32_t timescale,
+		const mpu_sample_timing_t* sample_table, uint32_t sample_table_count, mfu_sample_emit_f emit, void* context) {
+
+	if(!timescale || !sample_table_count || sample_table_count > MFU_SAMPLE_EMITTER_MAX_SAMPLES) {
+		_MFU_SAMPLE_EMITTER_ERROR("mfu_sample_emitter_set_sample_table: mpu_sequence_number: %u, invalid timescale: %u or sample_count: %u", mpu_sequence_number, timescale, sample_table_count);
+		return -1;
+	}
+
+	if(__mfu_sample_emitter_select_mpu(mfu_sample_emitter, mpu_sequence_number, emit, context)) {
+		return -1;
+	}
+
+	if(sample_table_count > mfu_sample_emitter->sample_table_capacity) {
+		mpu_sample_timing_t* table = realloc(mfu_sample_emitter->sample_table, sample_table_count * sizeof(mpu_sample_timing_t));
+		if(!table) {
+			return -1;
+		}
+		mfu_sample_emitter->sample_table = table;
+		mfu_sample_emitter->sample_table_capacity = sample_table_count;
+	}
+
+	if(__mfu_sample_emitter_extend_slots(mfu_sample_emitter, sample_table_count)) {
+		return -1;
+	}
+
+	memcpy(mfu_sample_emitter->sample_table, sample_table, sample_table_count * sizeof(mpu_sample_timing_t));
+	mfu_sample_emitter->sample_table_count = sample_table_count;
+	mfu_sample_emitter->timescale = timescale;
+	mfu_sample_emitter->has_sample_table = true;
+	mfu_sample_emitter->sample_table_is_predicted = false;
+
+	__mfu_sample_emitter_drain(mfu_sample_emitter, false, emit, context);
+
+	return 0;
+}
+
+int mfu_sample_emitter_push(mfu_sample_emitter_t* mfu_sample_emitter, uint32_t mpu_sequence_number, uint32_t sample_number,
+		uint8_t mpu_fragmentation_indicator, uint8_t mpu_fragmentation_counter, const uint8_t* payload, size_t payload_len,
+		int64_t packet_pts_us, mfu_sample_emit_f emit, void* context) {
+
+	if(!sample_number || sample_number > MFU_SAMPLE_EMITTER_MAX_SAMPLES) {
+		return -1;
+	}
+
+	if(__mfu_sample_emitter_select_mpu(mfu_sample_emitter, mpu_sequence_number, emit, context) ||
+		sample_number < mfu_sample_emitter->next_sample_number) {
+		mfu_sample_emitter->stats.fragments_late++;
+		return -1;
+	}
+
+	if(__mfu_sample_emitter_extend_slots(mfu_sample_emitter, sample_number)) {
+		return -1;
+	}
+
+	mfu_sample_slot_t* slot = &mfu_sample_emitter->slots[sample_number - 1];
+	if(slot->is_complete || slot->is_lost) {
+		//duplicate, or the rest of a sample we already gave up on
+		return 0;
+	}
+
+	if(!slot->has_data) {
+		slot->packet_pts_us = packet_pts_us;
+		slot->has_data = true;
+	}
+
+	switch(mpu_fragmentation_indicator) {
+		case 0x00:
+			//complete data unit
+			slot->size = 0;
+			slot->has_gap = false;
+			slot->has_first_fragment = true;
+			slot->is_complete = true;
+			break;
+
+		case 0x01:
+			//first fragment, mpu_fragmentation_counter is the number of fragments that follow
+			slot->size = 0;
+			slot->has_gap = false;
+			slot->has_first_fragment = true;
+			slot->next_fragment_counter = mpu_fragmentation_counter - 1;
+			slot->is_complete = (mpu_fragmentation_counter == 0);
+			break;
+
+		default:
+			//middle (0x02) or last (0x03) fragment, anything out of order means a fragment was lost
+			if(!slot->has_first_fragment || mpu_fragmentation_counter != slot->next_fragment_counter) {
+				if(!mfu_sample_emitter->emit_partial_samples) {
+					slot->is_lost = true;
+					break;
+				}
+				//keep what we have and carry on from this fragment
+				slot->has_gap = true;
+				slot->has_first_fragment = true;
+			}
+			slot->next_fragment_counter = mpu_fragmentation_counter - 1;
+			slot->is_complete = (mpu_fragmentation_indicator == 0x03);
+			break;
+	}
+
+	if(!slot->is_lost && __mfu_sample_slot_append(slot, payload, payload_len)) {
+		slot->is_lost = true;
+	}
+	if(slot->is_lost) {
+		slot->is_complete = false;
+	}
+
+	__mfu_sample_emitter_drain(mfu_sample_emitter, false, emit, context);
+
+	return 0;
+}
+
+void mfu_sample_emitter_set_low_latency(mfu_sample_emitter_t* mfu_sample_emitter, bool low_latency) {
+	mfu_sample_emitter->low_latency = low_latency;
+}
+
+void mfu_sample_emitter_set_emit_partial_samples(mfu_sample_emitter_t* mfu_sample_emitter, bool emit_partial_samples) {
+	mfu_sample_emitter->emit_partial_samples = emit_partial_samples;
+}
+
+void mfu_sample_emitter_set_mpu_presentation_time(mfu_sample_emitter_t* mfu_sample_emitter, uint32_t mpu_sequence_number, int64_t mpu_presentation_time_us) {
+	//an MPU this far back has long been anchored, its slot goes to the newer one
+	mfu_mpu_presentation_time_t* mpu_presentation_time = &mfu_sample_emitter->mpu_presentation_times[mpu_sequence_number % MFU_SAMPLE_EMITTER_MPU_PRESENTATION_TIMES];
+	mpu_presentation_time->is_set = true;
+	mpu_presentation_time->mpu_sequence_number = mpu_sequence_number;
+	mpu_presentation_time->mpu_presentation_time_us = mpu_presentation_time_us;
+}
+
+bool mfu_sample_emitter_is_mpu_complete(mfu_sample_emitter_t* mfu_sample_emitter) {
+	return mfu_sample_emitter->in_use && mfu_sample_emitter->has_sample_table && !mfu_sample_emitter->sample_table_is_predicted &&
+			mfu_sample_emitter->next_sample_number > mfu_sample_emitter->sample_table_count;
+}
+
+void mfu_sample_emitter_flush(mfu_sample_emitter_t* mfu_sample_emitter, mfu_sample_emit_f emit, void* context) {
+	if(!mfu_sample_emitter->in_use) {
+		return;
+	}
+
+	__mfu_sample_emitter_drain(mfu_sample_emitter, true, emit, context);
+}
+
+uint8_t* mfu_sample_take_data(const mfu_sample_t* mfu_sample) {
+	mfu_sample_slot_t* slot = mfu_sample->slot;
+	if(!slot || !slot->data || !slot->size) {
+		return NULL;
+	}
+
+	uint8_t* data = slot->data;
+	slot->data = NULL;
+	slot->capacity = 0;
+	return data;
+}
+
+void mfu_sample_emitter_free(mfu_sample_emitter_t* mfu_sample_emitter) {
+	for(uint32_t i=0; i < mfu_sample_emitter->slots_capacity; i++) {
+		free(mfu_sample_emitter->slots[i].data);
+	}
+	free(mfu_sample_emitter->slots);
+	free(mfu_sample_emitter->sample_table);
+
+	memset(mfu_sample_emitter, 0, sizeof(mfu_sample_emitter_t));
+}
@@ -0,0 +1,184 @@
+/*
+ * atsc3_mmtp_mfu_sample_emitter.h
+ *
+ *  Created on: Feb 8, 2019
+ *      Author: jjustman
+ *
+ * sample-accurate MFU emission: MFU fragments are collected per sample_number, and each sample
+ * (access unit) is emitted in decode order as soon as all of its fragments have arrived, with
+ * size/duration/composition offset taken from the movie fragment trun instead of assuming a
+ * fixed 60 sample GOP at 59.94fps.
+ *
+ * samples completed before the trun for their MPU is known are held, and emitted (with packet
+ * derived timing) when the next MPU starts if the trun never shows up.
+ *
+ * in low_latency mode nothing is held: until the trun for the MPU arrives, the previous MPU's trun
+ * is used as a prediction (GOP structure and frame rate rarely change between MPUs), so each sample
+ * leaves as soon as its last fragment is in.
+ *
+ * a sample with missing fragments is dropped by default; with emit_partial_samples set, whatever did
+ * arrive is emitted in fragment order and flagged is_corrupt so the decoder can conceal it.
+ *
+ * a zeroed mfu_sample_emitter_t is ready to use.
+ */
+
+#ifndef MODULES_DEMUX_MMT_ATSC3_MMTP_MFU_SAMPLE_EMITTER_H_
+#define MODULES_DEMUX_MMT_ATSC3_MMTP_MFU_SAMPLE_EMITTER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define _MFU_SAMPLE_EMITTER_PRINTLN(...) printf(__VA_ARGS__);printf("\n")
+#define _MFU_SAMPLE_EMITTER_ERROR(...)   printf("%s:%d:ERROR:",__FILE__,__LINE__);_MFU_SAMPLE_EMITTER_PRINTLN(__VA_ARGS__);
+#define _MFU_SAMPLE_EMITTER_INFO(...)    printf("%s:%d:INFO :",__FILE__,__LINE__);_MFU_SAMPLE_EMITTER_PRINTLN(__VA_ARGS__);
+#define _MFU_SAMPLE_EMITTER_DEBUG(...)
+
+//upper bound on samples per MPU we will track, anything past this is dropped
+#define MFU_SAMPLE_EMITTER_MAX_SAMPLES 1024
+
+//upper bound on a single access unit
+#define MFU_SAMPLE_EMITTER_MAX_SAMPLE_SIZE (8 * 1024 * 1024)
+
+//a sample still missing fragments is given up once this many later samples are complete
+#define MFU_SAMPLE_EMITTER_REORDER_SAMPLES 4
+
+//ISO 14496-12 sample_flags: sample_is_non_sync_sample
+#define MFU_SAMPLE_FLAG_IS_NON_SYNC 0x00010000
+
+//per-sample entry from the trun, with tfhd defaults already applied
+typedef struct mpu_sample_timing {
+	uint32_t	size;
+	uint32_t	duration;
+	int32_t		composition_time_offset;
+	uint32_t	flags;
+} mpu_sample_timing_t;
+
+struct mfu_sample_slot;
+
+typedef struct mfu_sample {
+	uint32_t		mpu_sequence_number;
+	uint32_t		sample_number;			//1-based, as carried in the MFU header
+
+	const uint8_t*	data;
+	size_t			size;
+
+	int64_t			pts_us;
+	int64_t			dts_us;
+	int64_t			duration_us;			//0 if unknown
+	bool			is_sync;
+	bool			is_corrupt;				//size disagrees with the trun, or fragments are missing
+	bool			has_sample_table;		//timing came from the trun rather than the mmtp packet timestamp
+	bool			is_predicted;			//low_latency: timing came from the previous MPU's trun
+
+	struct mfu_sample_slot* slot;			//backing buffer, see mfu_sample_take_data
+} mfu_sample_t;
+
+//the sample data is only valid for the duration of the callback, unless taken with mfu_sample_take_data
+typedef void (*mfu_sample_emit_f)(void* context, const mfu_sample_t* mfu_sample);
+
+typedef struct mfu_sample_slot {
+	uint8_t*	data;
+	size_t		capacity;
+	size_t		size;
+
+	bool		has_data;
+	bool		has_first_fragment;
+	bool		is_complete;
+	bool		is_lost;
+	bool		has_gap;				//emit_partial_samples: fragments are missing from data
+	uint8_t		next_fragment_counter;
+
+	int64_t		packet_pts_us;			//from the first fragment we saw
+} mfu_sample_slot_t;
+
+typedef struct mfu_sample_emitter_stats {
+	uint64_t	samples_emitted;
+	uint64_t	samples_emitted_without_sample_table;
+	uint64_t	samples_emitted_with_predicted_sample_table;
+	uint64_t	samples_emitted_partial;
+	uint64_t	samples_dropped;
+	uint64_t	fragments_late;
+} mfu_sample_emitter_stats_t;
+
+#define MFU_SAMPLE_EMITTER_MPU_PRESENTATION_TIMES 8
+
+typedef struct mfu_mpu_presentation_time {
+	bool		is_set;
+	uint32_t	mpu_sequence_number;
+	int64_t		mpu_presentation_time_us;
+} mfu_mpu_presentation_time_t;
+
+typedef struct mfu_sample_emitter {
+	bool					low_latency;
+	bool					emit_partial_samples;
+	bool					in_use;
+	uint32_t				mpu_sequence_number;
+
+	mfu_sample_slot_t*		slots;
+	uint32_t				slots_count;		//highest sample_number seen (or sample_count from the trun)
+	uint32_t				slots_capacity;
+	uint32_t				next_sample_number;
+
+	//from the trun
+	bool					has_sample_table;
+	uint32_t				timescale;
+	mpu_sample_timing_t*	sample_table;
+	uint32_t				sample_table_count;
+	uint32_t				sample_table_capacity;
+	bool					sample_table_is_predicted;
+
+	//decode time of sample 1, back-computed from the packet timestamp of the first sample we emit
+	bool					has_mpu_decode_time_anchor;
+	int64_t					mpu_decode_time_anchor_us;
+
+	//MPU presentation times (e.g. from the MPT MPU_timestamp_descriptor), preferred over the packet timestamp when known.
+	//signaling runs ahead of the media, so keep a few upcoming MPUs keyed by mpu_sequence_number
+	mfu_mpu_presentation_time_t	mpu_presentation_times[MFU_SAMPLE_EMITTER_MPU_PRESENTATION_TIMES];
+
+	mfu_sample_emitter_stats_t stats;
+} mfu_sample_emitter_t;
+
+/**
+ * attach the trun for mpu_sequence_number, emitting any samples that were waiting on it.
+ * a newer mpu_sequence_number flushes the MPU in progress first.
+ */
+int mfu_sample_emitter_set_sample_table(mfu_sample_emitter_t* mfu_sample_emitter, uint32_t mpu_sequence_number, uint32_t timescale,
+		const mpu_sample_timing_t* sample_table, uint32_t sample_table_count, mfu_sample_emit_f emit, void* context);
+
+/**
+ * add one timed MFU payload, emitting every sample that becomes ready in decode order.
+ * packet_pts_us is the mmtp packet timestamp, used to anchor the MPU and when no trun is available.
+ */
+int mfu_sample_emitter_push(mfu_sample_emitter_t* mfu_sample_emitter, uint32_t mpu_sequence_number, uint32_t sample_number,
+		uint8_t mpu_fragmentation_indicator, uint8_t mpu_fragmentation_counter, const uint8_t* payload, size_t payload_len,
+		int64_t packet_pts_us, mfu_sample_emit_f emit, void* context);
+
+void mfu_sample_emitter_set_low_latency(mfu_sample_emitter_t* mfu_sample_emitter, bool low_latency);
+
+//emit samples with missing fragments flagged is_corrupt instead of dropping them
+void mfu_sample_emitter_set_emit_partial_samples(mfu_sample_emitter_t* mfu_sample_emitter, bool emit_partial_samples);
+
+/**
+ * presentation time of the first sample (in presentation order) of mpu_sequence_number, in the same
+ * clock as packet_pts_us. may be set ahead of the MPU's first fragment.
+ */
+void mfu_sample_emitter_set_mpu_presentation_time(mfu_sample_emitter_t* mfu_sample_emitter, uint32_t mpu_sequence_number, int64_t mpu_presentation_time_us);
+
+//true once every sample of the current MPU from the trun has been emitted or given up
+bool mfu_sample_emitter_is_mpu_complete(mfu_sample_emitter_t* mfu_sample_emitter);
+
+//emit what is complete for the current MPU, drop the rest
+void mfu_sample_emitter_flush(mfu_sample_emitter_t* mfu_sample_emitter, mfu_sample_emit_f emit, void* context);
+
+/**
+ * from inside the emit callback, take ownership of the assembled sample data instead of copying it.
+ * the caller frees it with free(); the slot grows a new buffer for the next MPU.
+ * NULL if there is nothing to take.
+ */
+uint8_t* mfu_sample_take_data(const mfu_sample_t* mfu_sample);
+
+void mfu_sample_emitter_free(mfu_sample_emitter_t* mfu_sample_emitter);
+
+#endif /* MODULES_DEMUX_MMT_ATSC3_MMTP_MFU_SAMPLE_EMITTER_H_ */
@@ -0,0 +1,334 @@
+/*
+ *
+ * atsc3_mmtp_mfu_sample_emitter_test.c:  driver for trun driven per-sample MFU emission
+ *
+ */
+
+#include "atsc3_mmtp_mfu_sample_emitter.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define __UNIT_TEST 1
+#ifdef __UNIT_TEST
+
+#define TEST_TIMESCALE 		90000
+#define TEST_SAMPLE_DURATION	1500	//60fps
+#define TEST_MAX_EMITTED	16
+
+typedef struct test_emitted {
+	int				count;
+	mfu_sample_t	samples[TEST_MAX_EMITTED];
+	size_t			first_byte[TEST_MAX_EMITTED];
+} test_emitted_t;
+
+void __test_emit(void* context, const mfu_sample_t* mfu_sample) {
+	test_emitted_t* emitted = context;
+	if(emitted->count < TEST_MAX_EMITTED) {
+		emitted->samples[emitted->count] = *mfu_sample;
+		emitted->samples[emitted->count].data = NULL;
+		emitted->first_byte[emitted->count] = mfu_sample->size ? mfu_sample->data[0] : 0;
+	}
+	emitted->count++;
+}
+
+void __test_sample_table(mpu_sample_timing_t* sample_table, uint32_t count) {
+	for(uint32_t i=0; i < count; i++) {
+		sample_table[i].size = 3;
+		sample_table[i].duration = TEST_SAMPLE_DURATION;
+		sample_table[i].composition_time_offset = 0;
+		sample_table[i].flags = i ? MFU_SAMPLE_FLAG_IS_NON_SYNC : 0;
+	}
+}
+
+int test_mfu_sample_emitter_per_sample_emission();
+int test_mfu_sample_emitter_held_until_sample_table();
+int test_mfu_sample_emitter_lost_fragment();
+int test_mfu_sample_emitter_partial_sample();
+int test_mfu_sample_emitter_low_latency();
+int test_mfu_sample_emitter_take_data();
+
+int main() {
+	int failed = 0;
+
+	failed |= test_mfu_sample_emitter_per_sample_emission();
+	failed |= test_mfu_sample_emitter_held_until_sample_table();
+	failed |= test_mfu_sample_emitter_lost_fragment();
+	failed |= test_mfu_sample_emitter_partial_sample();
+	failed |= test_mfu_sample_emitter_low_latency();
+	failed |= test_mfu_sample_emitter_take_data();
+
+	return failed;
+}
+
+//trun first, then each sample goes out as soon as its last fragment arrives
+int test_mfu_sample_emitter_per_sample_emission() {
+	mfu_sample_emitter_t mfu_sample_emitter;
+	memset(&mfu_sample_emitter, 0, sizeof(mfu_sample_emitter_t));
+	test_emitted_t emitted;
+	memset(&emitted, 0, sizeof(test_emitted_t));
+
+	mpu_sample_timing_t sample_table[3];
+	__test_sample_table(sample_table, 3);
+	mfu_sample_emitter_set_sample_table(&mfu_sample_emitter, 100, TEST_TIMESCALE, sample_table, 3, __test_emit, &emitted);
+
+	uint8_t sample_1[] = { 0x11, 0x12, 0x13 };
+	uint8_t sample_2[] = { 0x21, 0x22, 0x23 };
+
+	//sample 1 as three fragments
+	mfu_sample_emitter_push(&mfu_sample_emitter, 100, 1, 0x01, 2, &sample_1[0], 1, 1000000, __test_emit, &emitted);
+	mfu_sample_emitter_push(&mfu_sample_emitter, 100, 1, 0x02, 1, &sample_1[1], 1, 1000000, __test_emit, &emitted);
+	if(emitted.count != 0) {
+		_MFU_SAMPLE_EMITTER_ERROR("test_mfu_sample_emitter_per_sample_emission: emitted before the last fragment");
+		return -1;
+	}
+	mfu_sample_emitter_push(&mfu_sample_emitter, 100, 1, 0x03, 0, &sample_1[2], 1, 1000000, __test_emit, &emitted);
+	if(emitted.count != 1 || emitted.samples[0].size != 3 || emitted.first_byte[0] != 0x11 || !emitted.samples[0].is_sync ||
+		emitted.samples[0].duration_us != 16666 || emitted.samples[0].is_corrupt) {
+		_MFU_SAMPLE_EMITTER_ERROR("test_mfu_sample_emitter_per_sample_emission: sample 1, count: %d, size: %zu, duration: %lld",
+				emitted.count, emitted.samples[0].size, (long long)emitted.samples[0].duration_us);
+		return -1;
+	}
+
+	//sample 2 complete in one data unit
+	mfu_sample_emitter_push(&mfu_sample_emitter, 100, 2, 0x00, 0, sample_2, 3, 1005000, __test_emit, &emitted);
+	if(emitted.count != 2 || emitted.first_byte[1] != 0x21 || emitted.samples[1].is_sync ||
+		emitted.samples[1].dts_us - emitted.samples[0].dts_us != 16666) {
+		_MFU_SAMPLE_EMITTER_ERROR("test_mfu_sample_emitter_per_sample_emission: sample 2, count: %d, dts delta: %lld",
+				emitted.count, (long long)(emitted.samples[1].dts_us - emitted.samples[0].dts_us));
+		return -1;
+	}
+
+	if(mfu_sample_emitter_is_mpu_complete(&mfu_sample_emitter)) {
+		_MFU_SAMPLE_EMITTER_ERROR("test_mfu_sample_emitter_per_sample_emission: mpu complete with sample 3 outstanding");
+		return -1;
+	}
+
+	mfu_sample_emitter_push(&mfu_sample_emitter, 100, 3, 0x00, 0, sample_2, 3, 1010000, __test_emit, &emitted);
+	if(!mfu_sample_emitter_is_mpu_complete(&mfu_sample_emitter)) {
+		_MFU_SAMPLE_EMITTER_ERROR("test_mfu_sample_emitter_per_sample_emission: mpu not complete after sample 3");
+		return -1;
+	}
+
+	mfu_sample_emitter_free(&mfu_sample_emitter);
+	return 0;
+}
+
+//samples that complete before the trun are held, then released in order once it arrives
+int test_mfu_sample_emitter_held_until_sample_table() {
+	mfu_sample_emitter_t mfu_sample_emitter;
+	memset(&mfu_sample_emitter, 0, sizeof(mfu_sample_emitter_t));
+	test_emitted_t emitted;
+	memset(&emitted, 0, sizeof(test_emitted_t));
+
+	uint8_t sample[] = { 0x31, 0x32, 0x33 };
+
+	mfu_sample_emitter_push(&mfu_sample_emitter, 7, 1, 0x00, 0, sample, 3, 2000000, __test_emit, &emitted);
+	mfu_sample_emitter_push(&mfu_sample_emitter, 7, 2, 0x00, 0, sample, 3, 2000000, __test_emit, &emitted);
+	if(emitted.count != 0) {
+		_MFU_SAMPLE_EMITTER_ERROR("test_mfu_sample_emitter_held_until_sample_table: emitted %d samples without a trun", emitted.count);
+		return -1;
+	}
+
+	mpu_sample_timing_t sample_table[2];
+	__test_sample_table(sample_table, 2);
+	sample_table[1].composition_time_offset = 3000;
+	mfu_sample_emitter_set_sample_table(&mfu_sample_emitter, 7, TEST_TIMESCALE, sample_table, 2, __test_emit, &emitted);
+
+	if(emitted.count != 2 || emitted.samples[1].pts_us - emitted.samples[1].dts_us != 33334 || !emitted.samples[1].has_sample_table) {
+		_MFU_SAMPLE_EMITTER_ERROR("test_mfu_sample_emitter_held_until_sample_table: count: %d", emitted.count);
+		return -1;
+	}
+
+	//next MPU with no trun, flushed by the one after it using packet timing
+	mfu_sample_emitter_push(&mfu_sample_emitter, 8, 1, 0x00, 0, sample, 3, 3000000, __test_emit, &emitted);
+	mfu_sample_emitter_push(&mfu_sample_emitter, 9, 1, 0x00, 0, sample, 3, 4000000, __test_emit, &emitted);
+	if(emitted.count != 3 || emitted.samples[2].has_sample_table || emitted.samples[2].pts_us != 3000000 ||
+		mfu_sample_emitter.stats.samples_emitted_without_sample_table != 1) {
+		_MFU_SAMPLE_EMITTER_ERROR("test_mfu_sample_emitter_held_until_sample_table: fallback count: %d", emitted.count);
+		return -1;
+	}
+
+	//late fragment for an MPU we already moved past
+	if(!mfu_sample_emitter_push(&mfu_sample_emitter, 8, 2, 0x00, 0, sample, 3, 3000000, __test_emit, &emitted) ||
+		mfu_sample_emitter.stats.fragments_late != 1) {
+		_MFU_SAMPLE_EMITTER_ERROR("test_mfu_sample_emitter_held_until_sample_table: late fragment accepted");
+		return -1;
+	}
+
+	mfu_sample_emitter_free(&mfu_sample_emitter);
+	return 0;
+}
+
+//a missing middle fragment drops only that sample, the output keeps moving
+int test_mfu_sample_emitter_lost_fragment() {
+	mfu_sample_emitter_t mfu_sample_emitter;
+	memset(&mfu_sample_emitter, 0, sizeof(mfu_sample_emitter_t));
+	test_emitted_t emitted;
+	memset(&emitted, 0, sizeof(test_emitted_t));
+
+	mpu_sample_timing_t sample_table[3];
+	__test_sample_table(sample_table, 3);
+	mfu_sample_emitter_set_sample_table(&mfu_sample_emitter, 1, TEST_TIMESCALE, sample_table, 3, __test_emit, &emitted);
+
+	uint8_t sample[] = { 0x41, 0x42, 0x43 };
+
+	mfu_sample_emitter_push(&mfu_sample_emitter, 1, 1, 0x01, 2, &sample[0], 1, 0, __test_emit, &emitted);
+	//counter 1 never arrives
+	mfu_sample_emitter_push(&mfu_sample_emitter, 1, 1, 0x03, 0, &sample[2], 1, 0, __test_emit, &emitted);
+	mfu_sample_emitter_push(&mfu_sample_emitter, 1, 2, 0x00, 0, sample, 3, 0, __test_emit, &emitted);
+	mfu_sample_emitter_push(&mfu_sample_emitter, 1, 3, 0x00, 0, sample, 3, 0, __test_emit, &emitted);
+
+	if(emitted.count != 2 || emitted.samples[0].sample_number != 2 || mfu_sample_emitter.stats.samples_dropped != 1 ||
+		!mfu_sample_emitter_is_mpu_complete(&mfu_sample_emitter)) {
+		_MFU_SAMPLE_EMITTER_ERROR("test_mfu_sample_emitter_lost_fragment: count: %d, dropped: %llu",
+				emitted.count, (unsigned long long)mfu_sample_emitter.stats.samples_dropped);
+		return -1;
+	}
+
+	_MFU_SAMPLE_EMITTER_INFO("test_mfu_sample_emitter_lost_fragment: emitted: %llu, dropped: %llu",
+			(unsigned long long)mfu_sample_emitter.stats.samples_emitted, (unsigned long long)mfu_sample_emitter.stats.samples_dropped);
+
+	mfu_sample_emitter_free(&mfu_sample_emitter);
+	return 0;
+}
+
+//emit_partial_samples: the same loss goes out with what arrived, flagged corrupt
+int test_mfu_sample_emitter_partial_sample() {
+	mfu_sample_emitter_t mfu_sample_emitter;
+	memset(&mfu_sample_emitter, 0, sizeof(mfu_sample_emitter_t));
+	mfu_sample_emitter_set_emit_partial_samples(&mfu_sample_emitter, true);
+	test_emitted_t emitted;
+	memset(&emitted, 0, sizeof(test_emitted_t));
+
+	mpu_sample_timing_t sample_table[3];
+	__test_sample_table(sample_table, 3);
+	mfu_sample_emitter_set_sample_table(&mfu_sample_emitter, 1, TEST_TIMESCALE, sample_table, 3, __test_emit, &emitted);
+
+	uint8_t sample[] = { 0x61, 0x62, 0x63 };
+
+	mfu_sample_emitter_push(&mfu_sample_emitter, 1, 1, 0x01, 2, &sample[0], 1, 0, __test_emit, &emitted);
+	//counter 1 never arrives
+	mfu_sample_emitter_push(&mfu_sample_emitter, 1, 1, 0x03, 0, &sample[2], 1, 0, __test_emit, &emitted);
+	if(emitted.count != 1 || emitted.samples[0].size != 2 || emitted.first_byte[0] != 0x61 || !emitted.samples[0].is_corrupt) {
+		_MFU_SAMPLE_EMITTER_ERROR("test_mfu_sample_emitter_partial_sample: sample 1, count: %d, size: %zu, corrupt: %d",
+				emitted.count, emitted.samples[0].size, emitted.samples[0].is_corrupt);
+		return -1;
+	}
+
+	//sample 2 never gets its last fragment, it is emitted once the MPU is flushed
+	mfu_sample_emitter_push(&mfu_sample_emitter, 1, 2, 0x01, 1, &sample[0], 1, 0, __test_emit, &emitted);
+	mfu_sample_emitter_push(&mfu_sample_emitter, 1, 3, 0x00, 0, sample, 3, 0, __test_emit, &emitted);
+	mfu_sample_emitter_flush(&mfu_sample_emitter, __test_emit, &emitted);
+
+	if(emitted.count != 3 || emitted.samples[1].sample_number != 2 || !emitted.samples[1].is_corrupt || emitted.samples[2].is_corrupt ||
+		mfu_sample_emitter.stats.samples_emitted_partial != 2 || mfu_sample_emitter.stats.samples_dropped) {
+		_MFU_SAMPLE_EMITTER_ERROR("test_mfu_sample_emitter_partial_sample: count: %d, partial: %llu, dropped: %llu",
+				emitted.count, (unsigned long long)mfu_sample_emitter.stats.samples_emitted_partial, (unsigned long long)mfu_sample_emitter.stats.samples_dropped);
+		return -1;
+	}
+
+	mfu_sample_emitter_free(&mfu_sample_emitter);
+	return 0;
+}
+
+//low_latency: the next MPU goes out sample by sample on the previous trun, anchored on the MPU presentation time
+int test_mfu_sample_emitter_low_latency() {
+	mfu_sample_emitter_t mfu_sample_emitter;
+	memset(&mfu_sample_emitter, 0, sizeof(mfu_sample_emitter_t));
+	mfu_sample_emitter_set_low_latency(&mfu_sample_emitter, true);
+	test_emitted_t emitted;
+	memset(&emitted, 0, sizeof(test_emitted_t));
+
+	mpu_sample_timing_t sample_table[2];
+	__test_sample_table(sample_table, 2);
+	sample_table[0].composition_time_offset = 3000;
+
+	uint8_t sample[] = { 0x51, 0x52, 0x53 };
+
+	mfu_sample_emitter_set_sample_table(&mfu_sample_emitter, 20, TEST_TIMESCALE, sample_table, 2, __test_emit, &emitted);
+	mfu_sample_emitter_push(&mfu_sample_emitter, 20, 1, 0x00, 0, sample, 3, 1000000, __test_emit, &emitted);
+	mfu_sample_emitter_push(&mfu_sample_emitter, 20, 2, 0x00, 0, sample, 3, 1000000, __test_emit, &emitted);
+
+	//mpu 21 has no trun yet
+	mfu_sample_emitter_set_mpu_presentation_time(&mfu_sample_emitter, 21, 5000000);
+	mfu_sample_emitter_push(&mfu_sample_emitter, 21, 1, 0x00, 0, sample, 3, 4900000, __test_emit, &emitted);
+
+	if(emitted.count != 3 || !emitted.samples[2].is_predicted || emitted.samples[2].pts_us != 5000000 ||
+		emitted.samples[2].duration_us != 16666 || mfu_sample_emitter.stats.samples_emitted_with_predicted_sample_table != 1) {
+		_MFU_SAMPLE_EMITTER_ERROR("test_mfu_sample_emitter_low_latency: count: %d, pts: %lld, predicted: %d",
+				emitted.count, (long long)emitted.samples[2].pts_us, emitted.samples[2].is_predicted);
+		return -1;
+	}
+
+	//predicted MPUs are not complete until their own trun confirms them
+	mfu_sample_emitter_push(&mfu_sample_emitter, 21, 2, 0x00, 0, sample, 3, 4900000, __test_emit, &emitted);
+	if(emitted.count != 4 || mfu_sample_emitter_is_mpu_complete(&mfu_sample_emitter)) {
+		_MFU_SAMPLE_EMITTER_ERROR("test_mfu_sample_emitter_low_latency: predicted mpu reported complete");
+		return -1;
+	}
+
+	mfu_sample_emitter_set_sample_table(&mfu_sample_emitter, 21, TEST_TIMESCALE, sample_table, 2, __test_emit, &emitted);
+	if(emitted.count != 4 || !mfu_sample_emitter_is_mpu_complete(&mfu_sample_emitter)) {
+		_MFU_SAMPLE_EMITTER_ERROR("test_mfu_sample_emitter_low_latency: count: %d after trun", emitted.count);
+		return -1;
+	}
+
+	mfu_sample_emitter_free(&mfu_sample_emitter);
+	return 0;
+}
+
+typedef struct test_taken {
+	int			count;
+	uint8_t*	data[TEST_MAX_EMITTED];
+	size_t		size[TEST_MAX_EMITTED];
+} test_taken_t;
+
+void __test_emit_take(void* context, const mfu_sample_t* mfu_sample) {
+	test_taken_t* taken = context;
+	if(taken->count < TEST_MAX_EMITTED) {
+		taken->data[taken->count] = mfu_sample_take_data(mfu_sample);
+		taken->size[taken->count] = mfu_sample->size;
+	}
+	taken->count++;
+}
+
+//a taken sample buffer belongs to the caller, the slot grows a fresh one for the next MPU
+int test_mfu_sample_emitter_take_data() {
+	mfu_sample_emitter_t mfu_sample_emitter;
+	memset(&mfu_sample_emitter, 0, sizeof(mfu_sample_emitter_t));
+	test_taken_t taken;
+	memset(&taken, 0, sizeof(test_taken_t));
+	int ret = 0;
+
+	mpu_sample_timing_t sample_table[1];
+	__test_sample_table(sample_table, 1);
+
+	uint8_t sample_1[] = { 0x61, 0x62, 0x63 };
+	uint8_t sample_2[] = { 0x71, 0x72, 0x73 };
+
+	mfu_sample_emitter_set_sample_table(&mfu_sample_emitter, 30, TEST_TIMESCALE, sample_table, 1, __test_emit_take, &taken);
+	mfu_sample_emitter_push(&mfu_sample_emitter, 30, 1, 0x01, 1, &sample_1[0], 1, 1000000, __test_emit_take, &taken);
+	mfu_sample_emitter_push(&mfu_sample_emitter, 30, 1, 0x03, 0, &sample_1[1], 2, 1000000, __test_emit_take, &taken);
+
+	mfu_sample_emitter_set_sample_table(&mfu_sample_emitter, 31, TEST_TIMESCALE, sample_table, 1, __test_emit_take, &taken);
+	mfu_sample_emitter_push(&mfu_sample_emitter, 31, 1, 0x00, 0, sample_2, 3, 1016666, __test_emit_take, &taken);
+
+	if(taken.count != 2 || !taken.data[0] || !taken.data[1] || taken.data[0] == taken.data[1] ||
+		taken.size[0] != 3 || memcmp(taken.data[0], sample_1, 3) || taken.size[1] != 3 || memcmp(taken.data[1], sample_2, 3) ||
+		mfu_sample_emitter.slots[0].data || mfu_sample_emitter.slots[0].capacity) {
+		_MFU_SAMPLE_EMITTER_ERROR("test_mfu_sample_emitter_take_data: count: %d", taken.count);
+		ret = -1;
+	}
+
+	for(int i=0; i < taken.count && i < TEST_MAX_EMITTED; i++) {
+		free(taken.data[i]);
+	}
+	mfu_sample_emitter_free(&mfu_sample_emitter);
+	return ret;
+}
+
+#endif
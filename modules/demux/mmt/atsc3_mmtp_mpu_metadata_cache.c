@@ -0,0 +1,390 @@
+/*
+ * atsc3_mmtp_mpu_metadata_cache.c
+ *
+ *  Created on: Feb 14, 2019
+ *      Author: jjustman
+ */
+
+#include "atsc3_mmtp_mpu_metadata_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+//file layout, all integers big endian:
+//	magic, then per entry:
+//	u16 scope_length, scope, u16 packet_id, u32 asset_id_length, asset_id, u32 asset_type, u32 asset_timescale,
+//	u32 mpu_metadata_length, mpu_metadata
+#define MPU_METADATA_CACHE_FILE_MAGIC "MMTPMC01"
+#define MPU_METADATA_CACHE_FILE_MAGIC_LENGTH 8
+
+void mpu_metadata_cache_init(mpu_metadata_cache_t* mpu_metadata_cache, size_t max_entries) {
+	memset(mpu_metadata_cache, 0, sizeof(mpu_metadata_cache_t));
+	mpu_metadata_cache->max_entries = max_entries ? max_entries : MPU_METADATA_CACHE_DEFAULT_MAX_ENTRIES;
+}
+
+static void __mpu_metadata_cache_entry_clear(mpu_metadata_cache_entry_t* entry) {
+	free(entry->scope);
+	free(entry->asset_id);
+	free(entry->mpu_metadata);
+	memset(entry, 0, sizeof(mpu_metadata_cache_entry_t));
+}
+
+static mpu_metadata_cache_entry_t* __mpu_metadata_cache_lookup(mpu_metadata_cache_t* mpu_metadata_cache, const char* scope, uint16_t packet_id) {
+	for(size_t i = 0; i < mpu_metadata_cache->entries_n; i++) {
+		mpu_metadata_cache_entry_t* entry = &mpu_metadata_cache->entries[i];
+		if(entry->packet_id == packet_id && !strcmp(entry->scope, scope)) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+//existing entry for scope/packet_id, or a new empty one, evicting the least recently used when full
+static mpu_metadata_cache_entry_t* __mpu_metadata_cache_get_or_create(mpu_metadata_cache_t* mpu_metadata_cache, const char* scope, uint16_t packet_id) {
+	if(!scope || strlen(scope) > MPU_METADATA_CACHE_MAX_SCOPE) {
+		return NULL;
+	}
+
+	mpu_metadata_cache_entry_t* entry = __mpu_metadata_cache_lookup(mpu_metadata_cache, scope, packet_id);
+	if(entry) {
+		entry->last_used = ++mpu_metadata_cache->use_counter;
+		return entry;
+	}
+
+	char* scope_copy = strdup(scope);
+	if(!scope_copy) {
+		return NULL;
+	}
+
+	if(mpu_metadata_cache->entries_n >= mpu_metadata_cache->max_entries) {
+		size_t lru = 0;
+		for(size_t i = 1; i < mpu_metadata_cache->entries_n; i++) {
+			if(mpu_metadata_cache->entries[i].last_used < mpu_metadata_cache->entries[lru].last_used) {
+				lru = i;
+			}
+		}
+		_MPU_METADATA_CACHE_DEBUG("evicting %s packet_id: %u", mpu_metadata_cache->entries[lru].scope, mpu_metadata_cache->entries[lru].packet_id);
+		entry = &mpu_metadata_cache->entries[lru];
+		__mpu_metadata_cache_entry_clear(entry);
+		mpu_metadata_cache->stats.evictions++;
+	} else {
+		mpu_metadata_cache_entry_t* entries = realloc(mpu_metadata_cache->entries, (mpu_metadata_cache->entries_n + 1) * sizeof(mpu_metadata_cache_entry_t));
+		if(!entries) {
+			free(scope_copy);
+			return NULL;
+		}
+		mpu_metadata_cache->entries = entries;
+		entry = &entries[mpu_metadata_cache->entries_n++];
+		memset(entry, 0, sizeof(mpu_metadata_cache_entry_t));
+	}
+
+	entry->scope = scope_copy;
+	entry->packet_id = packet_id;
+	entry->last_used = ++mpu_metadata_cache->use_counter;
+	return entry;
+}
+
+mpu_metadata_cache_entry_t* mpu_metadata_cache_find(mpu_metadata_cache_t* mpu_metadata_cache, const char* scope, uint16_t packet_id) {
+	mpu_metadata_cache_entry_t* entry = scope ? __mpu_metadata_cache_lookup(mpu_metadata_cache, scope, packet_id) : NULL;
+	if(!entry || !entry->mpu_metadata) {
+		mpu_metadata_cache->stats.misses++;
+		return NULL;
+	}
+
+	mpu_metadata_cache->stats.hits++;
+	entry->last_used = ++mpu_metadata_cache->use_counter;
+	return entry;
+}
+
+//locate the top level box of type in buf, returns its length or 0
+static size_t __mpu_metadata_cache_find_box(const uint8_t* buf, size_t length, const char* type, const uint8_t** box) {
+	size_t offset = 0;
+
+	while(length - offset >= 8) {
+		const uint8_t* p = buf + offset;
+		uint64_t box_size = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+
+		if(box_size == 1) {
+			if(length - offset < 16) {
+				return 0;
+			}
+			box_size = 0;
+			for(int i = 8; i < 16; i++) {
+				box_size = (box_size << 8) | p[i];
+			}
+		} else if(box_size == 0) {
+			box_size = length - offset;
+		}
+
+		if(box_size < 8 || box_size > length - offset) {
+			return 0;
+		}
+
+		if(!memcmp(p + 4, type, 4)) {
+			*box = p;
+			return (size_t)box_size;
+		}
+		offset += (size_t)box_size;
+	}
+	return 0;
+}
+
+bool mpu_metadata_cache_moov_equals(const uint8_t* a, size_t a_length, const uint8_t* b, size_t b_length) {
+	const uint8_t* a_moov = NULL;
+	const uint8_t* b_moov = NULL;
+	size_t a_moov_length = a ? __mpu_metadata_cache_find_box(a, a_length, "moov", &a_moov) : 0;
+	size_t b_moov_length = b ? __mpu_metadata_cache_find_box(b, b_length, "moov", &b_moov) : 0;
+
+	//the mmpu box carries the mpu_sequence_number, only the moov is expected to stay the same from one MPU to the next
+	if(!a_moov_length || !b_moov_length) {
+		return false;
+	}
+	return a_moov_length == b_moov_length && !memcmp(a_moov, b_moov, a_moov_length);
+}
+
+int mpu_metadata_cache_put_mpu_metadata(mpu_metadata_cache_t* mpu_metadata_cache, const char* scope, uint16_t packet_id,
+		const uint8_t* mpu_metadata, size_t mpu_metadata_length) {
+	if(!mpu_metadata || !mpu_metadata_length || mpu_metadata_length > MPU_METADATA_CACHE_MAX_MPU_METADATA) {
+		return -1;
+	}
+
+	mpu_metadata_cache_entry_t* entry = __mpu_metadata_cache_get_or_create(mpu_metadata_cache, scope, packet_id);
+	if(!entry) {
+		return -1;
+	}
+
+	if(entry->mpu_metadata && mpu_metadata_cache_moov_equals(entry->mpu_metadata, entry->mpu_metadata_length, mpu_metadata, mpu_metadata_length)) {
+		return 0;
+	}
+
+	uint8_t* copy = malloc(mpu_metadata_length);
+	if(!copy) {
+		return -1;
+	}
+	memcpy(copy, mpu_metadata, mpu_metadata_length);
+
+	if(entry->mpu_metadata) {
+		mpu_metadata_cache->stats.moov_changes++;
+		_MPU_METADATA_CACHE_INFO("%s packet_id: %u, moov changed", scope, packet_id);
+	}
+	free(entry->mpu_metadata);
+	entry->mpu_metadata = copy;
+	entry->mpu_metadata_length = mpu_metadata_length;
+	mpu_metadata_cache->is_dirty = true;
+
+	return 1;
+}
+
+int mpu_metadata_cache_put_asset(mpu_metadata_cache_t* mpu_metadata_cache, const char* scope, uint16_t packet_id,
+		const uint8_t* asset_id, uint32_t asset_id_length, uint32_t asset_type, uint32_t asset_timescale) {
+	if(asset_id_length > MPU_METADATA_CACHE_MAX_ASSET_ID || (asset_id_length && !asset_id)) {
+		return -1;
+	}
+
+	mpu_metadata_cache_entry_t* entry = __mpu_metadata_cache_get_or_create(mpu_metadata_cache, scope, packet_id);
+	if(!entry) {
+		return -1;
+	}
+
+	if(entry->asset_id_length == asset_id_length && (!asset_id_length || !memcmp(entry->asset_id, asset_id, asset_id_length))
+			&& entry->asset_type == asset_type && entry->asset_timescale == asset_timescale) {
+		return 0;
+	}
+
+	int changed = 0;
+	if(entry->asset_id_length && (entry->asset_id_length != asset_id_length || memcmp(entry->asset_id, asset_id, asset_id_length))) {
+		//a different asset now rides on this packet_id, whatever we have for it is of no use
+		_MPU_METADATA_CACHE_INFO("%s packet_id: %u, asset_id changed, dropping cached mpu metadata", scope, packet_id);
+		free(entry->mpu_metadata);
+		entry->mpu_metadata = NULL;
+		entry->mpu_metadata_length = 0;
+		mpu_metadata_cache->stats.asset_changes++;
+		changed = 1;
+	}
+
+	uint8_t* copy = NULL;
+	if(asset_id_length) {
+		copy = malloc(asset_id_length);
+		if(!copy) {
+			return -1;
+		}
+		memcpy(copy, asset_id, asset_id_length);
+	}
+	free(entry->asset_id);
+	entry->asset_id = copy;
+	entry->asset_id_length = asset_id_length;
+	entry->asset_type = asset_type;
+	entry->asset_timescale = asset_timescale;
+	mpu_metadata_cache->is_dirty = true;
+
+	return changed;
+}
+
+static bool __mpu_metadata_cache_write_u16(FILE* fp, uint16_t v) {
+	uint8_t b[2] = { v >> 8, v };
+	return fwrite(b, 1, 2, fp) == 2;
+}
+
+static bool __mpu_metadata_cache_write_u32(FILE* fp, uint32_t v) {
+	uint8_t b[4] = { v >> 24, v >> 16, v >> 8, v };
+	return fwrite(b, 1, 4, fp) == 4;
+}
+
+static bool __mpu_metadata_cache_write_bytes(FILE* fp, const void* buf, size_t length) {
+	return !length || fwrite(buf, 1, length, fp) == length;
+}
+
+int mpu_metadata_cache_save(mpu_metadata_cache_t* mpu_metadata_cache, const char* path) {
+	size_t tmp_path_length = strlen(path) + 5;
+	char* tmp_path = malloc(tmp_path_length);
+	if(!tmp_path) {
+		return -1;
+	}
+	snprintf(tmp_path, tmp_path_length, "%s.tmp", path);
+
+	FILE* fp = fopen(tmp_path, "wb");
+	if(!fp) {
+		_MPU_METADATA_CACHE_ERROR("unable to open %s for writing", tmp_path);
+		free(tmp_path);
+		return -1;
+	}
+
+	bool ok = __mpu_metadata_cache_write_bytes(fp, MPU_METADATA_CACHE_FILE_MAGIC, MPU_METADATA_CACHE_FILE_MAGIC_LENGTH);
+	for(size_t i = 0; ok && i < mpu_metadata_cache->entries_n; i++) {
+		mpu_metadata_cache_entry_t* entry = &mpu_metadata_cache->entries[i];
+		if(!entry->mpu_metadata) {
+			continue;
+		}
+		size_t scope_length = strlen(entry->scope);
+		ok = __mpu_metadata_cache_write_u16(fp, scope_length)
+			&& __mpu_metadata_cache_write_bytes(fp, entry->scope, scope_length)
+			&& __mpu_metadata_cache_write_u16(fp, entry->packet_id)
+			&& __mpu_metadata_cache_write_u32(fp, entry->asset_id_length)
+			&& __mpu_metadata_cache_write_bytes(fp, entry->asset_id, entry->asset_id_length)
+			&& __mpu_metadata_cache_write_u32(fp, entry->asset_type)
+			&& __mpu_metadata_cache_write_u32(fp, entry->asset_timescale)
+			&& __mpu_metadata_cache_write_u32(fp, entry->mpu_metadata_length)
+			&& __mpu_metadata_cache_write_bytes(fp, entry->mpu_metadata, entry->mpu_metadata_length);
+	}
+
+	if(fclose(fp) || !ok || rename(tmp_path, path)) {
+		_MPU_METADATA_CACHE_ERROR("unable to write %s", path);
+		remove(tmp_path);
+		free(tmp_path);
+		return -1;
+	}
+
+	free(tmp_path);
+	mpu_metadata_cache->is_dirty = false;
+	return 0;
+}
+
+static bool __mpu_metadata_cache_read_u16(FILE* fp, uint16_t* v) {
+	uint8_t b[2];
+	if(fread(b, 1, 2, fp) != 2) {
+		return false;
+	}
+	*v = (b[0] << 8) | b[1];
+	return true;
+}
+
+static bool __mpu_metadata_cache_read_u32(FILE* fp, uint32_t* v) {
+	uint8_t b[4];
+	if(fread(b, 1, 4, fp) != 4) {
+		return false;
+	}
+	*v = ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | b[3];
+	return true;
+}
+
+//length bytes into a new buffer (NUL terminated), NULL on a short read
+static uint8_t* __mpu_metadata_cache_read_bytes(FILE* fp, size_t length) {
+	uint8_t* buf = malloc(length + 1);
+	if(!buf) {
+		return NULL;
+	}
+	if(length && fread(buf, 1, length, fp) != length) {
+		free(buf);
+		return NULL;
+	}
+	buf[length] = '\0';
+	return buf;
+}
+
+int mpu_metadata_cache_load(mpu_metadata_cache_t* mpu_metadata_cache, const char* path) {
+	FILE* fp = fopen(path, "rb");
+	if(!fp) {
+		return -1;
+	}
+
+	char magic[MPU_METADATA_CACHE_FILE_MAGIC_LENGTH];
+	if(fread(magic, 1, sizeof(magic), fp) != sizeof(magic) || memcmp(magic, MPU_METADATA_CACHE_FILE_MAGIC, sizeof(magic))) {
+		_MPU_METADATA_CACHE_ERROR("%s is not an mpu metadata cache", path);
+		fclose(fp);
+		return -1;
+	}
+
+	int loaded = 0;
+	for(;;) {
+		uint16_t scope_length, packet_id;
+		uint32_t asset_id_length, asset_type, asset_timescale, mpu_metadata_length;
+		char* scope = NULL;
+		uint8_t* asset_id = NULL;
+		uint8_t* mpu_metadata = NULL;
+
+		if(!__mpu_metadata_cache_read_u16(fp, &scope_length)) {
+			break;
+		}
+		bool ok = scope_length <= MPU_METADATA_CACHE_MAX_SCOPE
+			&& (scope = (char*)__mpu_metadata_cache_read_bytes(fp, scope_length))
+			&& __mpu_metadata_cache_read_u16(fp, &packet_id)
+			&& __mpu_metadata_cache_read_u32(fp, &asset_id_length)
+			&& asset_id_length <= MPU_METADATA_CACHE_MAX_ASSET_ID
+			&& (asset_id = __mpu_metadata_cache_read_bytes(fp, asset_id_length))
+			&& __mpu_metadata_cache_read_u32(fp, &asset_type)
+			&& __mpu_metadata_cache_read_u32(fp, &asset_timescale)
+			&& __mpu_metadata_cache_read_u32(fp, &mpu_metadata_length)
+			&& mpu_metadata_length && mpu_metadata_length <= MPU_METADATA_CACHE_MAX_MPU_METADATA
+			&& (mpu_metadata = __mpu_metadata_cache_read_bytes(fp, mpu_metadata_length))
+			&& strlen(scope) == scope_length;
+
+		if(ok) {
+			ok = mpu_metadata_cache_put_asset(mpu_metadata_cache, scope, packet_id, asset_id, asset_id_length, asset_type, asset_timescale) >= 0
+				&& mpu_metadata_cache_put_mpu_metadata(mpu_metadata_cache, scope, packet_id, mpu_metadata, mpu_metadata_length) >= 0;
+		} else {
+			_MPU_METADATA_CACHE_ERROR("%s: damaged entry after %d entries, ignoring the rest", path, loaded);
+		}
+
+		free(scope);
+		free(asset_id);
+		free(mpu_metadata);
+		if(!ok) {
+			break;
+		}
+		loaded++;
+	}
+
+	fclose(fp);
+	//what we just read is already on disk
+	mpu_metadata_cache->is_dirty = false;
+	return loaded;
+}
+
+void mpu_metadata_cache_stats_dump(mpu_metadata_cache_t* mpu_metadata_cache) {
+	_MPU_METADATA_CACHE_INFO("mpu metadata cache: entries: %zu, hits: %llu, misses: %llu, moov changes: %llu, asset changes: %llu, evictions: %llu",
+			mpu_metadata_cache->entries_n,
+			(unsigned long long)mpu_metadata_cache->stats.hits,
+			(unsigned long long)mpu_metadata_cache->stats.misses,
+			(unsigned long long)mpu_metadata_cache->stats.moov_changes,
+			(unsigned long long)mpu_metadata_cache->stats.asset_changes,
+			(unsigned long long)mpu_metadata_cache->stats.evictions);
+}
+
+void mpu_metadata_cache_free(mpu_metadata_cache_t* mpu_metadata_cache) {
+	for(size_t i = 0; i < mpu_metadata_cache->entries_n; i++) {
+		__mpu_metadata_cache_entry_clear(&mpu_metadata_cache->entries[i]);
+	}
+	free(mpu_metadata_cache->entries);
+	mpu_metadata_cache->entries = NULL;
+	mpu_metadata_cache->entries_n = 0;
+}
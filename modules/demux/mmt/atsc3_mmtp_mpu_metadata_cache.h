@@ -0,0 +1,105 @@
+/*
+ * atsc3_mmtp_mpu_metadata_cache.h
+ *
+ *  Created on: Feb 14, 2019
+ *      Author: jjustman
+ *
+ * last MPU metadata (ftyp/mmpu/moov) and MPT asset seen for each packet_id of a service, so tracks can be
+ * set up the moment a service is tuned instead of waiting for the next MPU to start.
+ *
+ * entries are keyed by a scope (the service or flow the packet_id belongs to) and packet_id, and checked
+ * against the MPT asset_id once it is signaled. the cache can be saved to and loaded from a file so it
+ * outlives the session; at most max_entries are kept, least recently used go first.
+ *
+ * not thread-safe.
+ */
+
+#ifndef MODULES_DEMUX_MMT_ATSC3_MMTP_MPU_METADATA_CACHE_H_
+#define MODULES_DEMUX_MMT_ATSC3_MMTP_MPU_METADATA_CACHE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define _MPU_METADATA_CACHE_PRINTLN(...) printf(__VA_ARGS__);printf("\n")
+#define _MPU_METADATA_CACHE_ERROR(...)   printf("%s:%d:ERROR:",__FILE__,__LINE__);_MPU_METADATA_CACHE_PRINTLN(__VA_ARGS__);
+#define _MPU_METADATA_CACHE_INFO(...)    printf("%s:%d:INFO :",__FILE__,__LINE__);_MPU_METADATA_CACHE_PRINTLN(__VA_ARGS__);
+#define _MPU_METADATA_CACHE_DEBUG(...)
+
+#define MPU_METADATA_CACHE_DEFAULT_MAX_ENTRIES	64
+
+//anything larger is not an MPU metadata we want to keep around
+#define MPU_METADATA_CACHE_MAX_MPU_METADATA		(4 * 1024 * 1024)
+#define MPU_METADATA_CACHE_MAX_ASSET_ID			1024
+#define MPU_METADATA_CACHE_MAX_SCOPE			256
+
+typedef struct mpu_metadata_cache_entry {
+	char*		scope;					//e.g. the service's destination ip:port
+	uint16_t	packet_id;
+
+	//from the MPT, asset_id_length 0 until signaled
+	uint32_t	asset_id_length;
+	uint8_t*	asset_id;
+	uint32_t	asset_type;
+	uint32_t	asset_timescale;
+
+	//ftyp/mmpu/moov data unit as received, NULL until seen
+	uint8_t*	mpu_metadata;
+	size_t		mpu_metadata_length;
+
+	uint64_t	last_used;
+} mpu_metadata_cache_entry_t;
+
+typedef struct mpu_metadata_cache_stats {
+	uint64_t	hits;
+	uint64_t	misses;
+	uint64_t	moov_changes;			//mpu metadata that no longer matched what was cached
+	uint64_t	asset_changes;			//asset_id on a packet_id changed, the cached metadata was dropped
+	uint64_t	evictions;
+} mpu_metadata_cache_stats_t;
+
+typedef struct mpu_metadata_cache {
+	mpu_metadata_cache_entry_t*	entries;
+	size_t						entries_n;
+	size_t						max_entries;
+
+	uint64_t					use_counter;
+	bool						is_dirty;		//changed since loaded or saved
+
+	mpu_metadata_cache_stats_t	stats;
+} mpu_metadata_cache_t;
+
+void mpu_metadata_cache_init(mpu_metadata_cache_t* mpu_metadata_cache, size_t max_entries);
+
+//entry with mpu metadata for scope/packet_id, or NULL
+mpu_metadata_cache_entry_t* mpu_metadata_cache_find(mpu_metadata_cache_t* mpu_metadata_cache, const char* scope, uint16_t packet_id);
+
+/**
+ * keep the mpu metadata received on scope/packet_id.
+ * returns 1 if its moov differs from the one cached (or none was), 0 if it is the same, -1 on error
+ */
+int mpu_metadata_cache_put_mpu_metadata(mpu_metadata_cache_t* mpu_metadata_cache, const char* scope, uint16_t packet_id,
+		const uint8_t* mpu_metadata, size_t mpu_metadata_length);
+
+/**
+ * record the MPT asset carried on scope/packet_id.
+ * returns 1 if a different asset_id was cached there, its mpu metadata is dropped; 0 otherwise, -1 on error
+ */
+int mpu_metadata_cache_put_asset(mpu_metadata_cache_t* mpu_metadata_cache, const char* scope, uint16_t packet_id,
+		const uint8_t* asset_id, uint32_t asset_id_length, uint32_t asset_type, uint32_t asset_timescale);
+
+//true if both buffers carry a byte for byte identical moov box
+bool mpu_metadata_cache_moov_equals(const uint8_t* a, size_t a_length, const uint8_t* b, size_t b_length);
+
+/**
+ * entries with mpu metadata are written to path through a temporary file and renamed over it.
+ * load adds what it can read from path, stopping at the first damaged entry
+ */
+int mpu_metadata_cache_save(mpu_metadata_cache_t* mpu_metadata_cache, const char* path);
+int mpu_metadata_cache_load(mpu_metadata_cache_t* mpu_metadata_cache, const char* path);
+
+void mpu_metadata_cache_stats_dump(mpu_metadata_cache_t* mpu_metadata_cache);
+void mpu_metadata_cache_free(mpu_metadata_cache_t* mpu_metadata_cache);
+
+#endif /* MODULES_DEMUX_MMT_ATSC3_MMTP_MPU_METADATA_CACHE_H_ */
@@ -0,0 +1,232 @@
+/*
+ *
+ * atsc3_mmtp_mpu_metadata_cache_test.c:  driver for the per service mpu metadata cache, moov change and asset change
+ * detection, lru eviction and persistence
+ *
+ */
+
+#include "atsc3_mmtp_mpu_metadata_cache.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+#define __UNIT_TEST 1
+#ifdef __UNIT_TEST
+
+#define TEST_SCOPE		"239.255.10.1:8000"
+#define TEST_PACKET_ID	35
+
+//ftyp, mmpu with the mpu_sequence_number in its last byte, then a moov with a one byte payload
+#define TEST_MPU_METADATA_LENGTH (16 + 12 + 9)
+
+void __test_mpu_metadata(uint8_t* buf, uint8_t mpu_sequence_number, uint8_t moov_payload) {
+	const uint8_t ftyp[16] = { 0, 0, 0, 16, 'f', 't', 'y', 'p', 'm', 'p', 'u', 'f', 0, 0, 0, 0 };
+	const uint8_t mmpu[12] = { 0, 0, 0, 12, 'm', 'm', 'p', 'u', 0, 0, 0, 0 };
+	const uint8_t moov[9] = { 0, 0, 0, 9, 'm', 'o', 'o', 'v', 0 };
+
+	memcpy(buf, ftyp, sizeof(ftyp));
+	memcpy(buf + 16, mmpu, sizeof(mmpu));
+	buf[16 + 11] = mpu_sequence_number;
+	memcpy(buf + 28, moov, sizeof(moov));
+	buf[28 + 8] = moov_payload;
+}
+
+int test_mpu_metadata_cache_put_find();
+int test_mpu_metadata_cache_asset_change();
+int test_mpu_metadata_cache_eviction();
+int test_mpu_metadata_cache_save_load();
+int test_mpu_metadata_cache_load_damaged();
+
+int main() {
+	int failed = 0;
+
+	failed |= test_mpu_metadata_cache_put_find();
+	failed |= test_mpu_metadata_cache_asset_change();
+	failed |= test_mpu_metadata_cache_eviction();
+	failed |= test_mpu_metadata_cache_save_load();
+	failed |= test_mpu_metadata_cache_load_damaged();
+
+	return failed;
+}
+
+//a new mmpu with the same moov is not a change, a different moov is
+int test_mpu_metadata_cache_put_find() {
+	mpu_metadata_cache_t mpu_metadata_cache;
+	mpu_metadata_cache_init(&mpu_metadata_cache, 0);
+	uint8_t mpu_metadata[TEST_MPU_METADATA_LENGTH];
+
+	if(mpu_metadata_cache_find(&mpu_metadata_cache, TEST_SCOPE, TEST_PACKET_ID)) {
+		_MPU_METADATA_CACHE_ERROR("test_mpu_metadata_cache_put_find: hit on an empty cache");
+		return -1;
+	}
+
+	__test_mpu_metadata(mpu_metadata, 1, 0xAA);
+	int first = mpu_metadata_cache_put_mpu_metadata(&mpu_metadata_cache, TEST_SCOPE, TEST_PACKET_ID, mpu_metadata, sizeof(mpu_metadata));
+	__test_mpu_metadata(mpu_metadata, 2, 0xAA);
+	int same_moov = mpu_metadata_cache_put_mpu_metadata(&mpu_metadata_cache, TEST_SCOPE, TEST_PACKET_ID, mpu_metadata, sizeof(mpu_metadata));
+	__test_mpu_metadata(mpu_metadata, 3, 0xBB);
+	int new_moov = mpu_metadata_cache_put_mpu_metadata(&mpu_metadata_cache, TEST_SCOPE, TEST_PACKET_ID, mpu_metadata, sizeof(mpu_metadata));
+
+	if(first != 1 || same_moov != 0 || new_moov != 1 || mpu_metadata_cache.stats.moov_changes != 1) {
+		_MPU_METADATA_CACHE_ERROR("test_mpu_metadata_cache_put_find: first: %d, same_moov: %d, new_moov: %d", first, same_moov, new_moov);
+		return -1;
+	}
+
+	mpu_metadata_cache_entry_t* entry = mpu_metadata_cache_find(&mpu_metadata_cache, TEST_SCOPE, TEST_PACKET_ID);
+	if(!entry || entry->mpu_metadata_length != sizeof(mpu_metadata) || memcmp(entry->mpu_metadata, mpu_metadata, sizeof(mpu_metadata))) {
+		_MPU_METADATA_CACHE_ERROR("test_mpu_metadata_cache_put_find: cached mpu metadata mismatch");
+		return -1;
+	}
+	if(mpu_metadata_cache_find(&mpu_metadata_cache, "239.255.10.2:8000", TEST_PACKET_ID) ||
+			mpu_metadata_cache_find(&mpu_metadata_cache, TEST_SCOPE, TEST_PACKET_ID + 1)) {
+		_MPU_METADATA_CACHE_ERROR("test_mpu_metadata_cache_put_find: hit on another scope or packet_id");
+		return -1;
+	}
+
+	mpu_metadata_cache_free(&mpu_metadata_cache);
+	return 0;
+}
+
+//a different asset_id on the packet_id drops what was cached for it
+int test_mpu_metadata_cache_asset_change() {
+	mpu_metadata_cache_t mpu_metadata_cache;
+	mpu_metadata_cache_init(&mpu_metadata_cache, 0);
+	uint8_t mpu_metadata[TEST_MPU_METADATA_LENGTH];
+	__test_mpu_metadata(mpu_metadata, 1, 0xAA);
+
+	const uint8_t asset_a[] = "asset-a";
+	const uint8_t asset_b[] = "asset-b";
+
+	int first = mpu_metadata_cache_put_asset(&mpu_metadata_cache, TEST_SCOPE, TEST_PACKET_ID, asset_a, sizeof(asset_a), 0x68657631, 90000);
+	mpu_metadata_cache_put_mpu_metadata(&mpu_metadata_cache, TEST_SCOPE, TEST_PACKET_ID, mpu_metadata, sizeof(mpu_metadata));
+	int same = mpu_metadata_cache_put_asset(&mpu_metadata_cache, TEST_SCOPE, TEST_PACKET_ID, asset_a, sizeof(asset_a), 0x68657631, 90000);
+	if(first != 0 || same != 0 || !mpu_metadata_cache_find(&mpu_metadata_cache, TEST_SCOPE, TEST_PACKET_ID)) {
+		_MPU_METADATA_CACHE_ERROR("test_mpu_metadata_cache_asset_change: first: %d, same: %d", first, same);
+		return -1;
+	}
+
+	int changed = mpu_metadata_cache_put_asset(&mpu_metadata_cache, TEST_SCOPE, TEST_PACKET_ID, asset_b, sizeof(asset_b), 0x68657631, 90000);
+	if(changed != 1 || mpu_metadata_cache_find(&mpu_metadata_cache, TEST_SCOPE, TEST_PACKET_ID) || mpu_metadata_cache.stats.asset_changes != 1) {
+		_MPU_METADATA_CACHE_ERROR("test_mpu_metadata_cache_asset_change: changed: %d, stale mpu metadata still cached", changed);
+		return -1;
+	}
+
+	mpu_metadata_cache_free(&mpu_metadata_cache);
+	return 0;
+}
+
+//the least recently used entry makes room for a new one
+int test_mpu_metadata_cache_eviction() {
+	mpu_metadata_cache_t mpu_metadata_cache;
+	mpu_metadata_cache_init(&mpu_metadata_cache, 2);
+	uint8_t mpu_metadata[TEST_MPU_METADATA_LENGTH];
+	__test_mpu_metadata(mpu_metadata, 1, 0xAA);
+
+	mpu_metadata_cache_put_mpu_metadata(&mpu_metadata_cache, TEST_SCOPE, 1, mpu_metadata, sizeof(mpu_metadata));
+	mpu_metadata_cache_put_mpu_metadata(&mpu_metadata_cache, TEST_SCOPE, 2, mpu_metadata, sizeof(mpu_metadata));
+	mpu_metadata_cache_find(&mpu_metadata_cache, TEST_SCOPE, 1);
+	mpu_metadata_cache_put_mpu_metadata(&mpu_metadata_cache, TEST_SCOPE, 3, mpu_metadata, sizeof(mpu_metadata));
+
+	if(mpu_metadata_cache.entries_n != 2 || mpu_metadata_cache.stats.evictions != 1 ||
+			!mpu_metadata_cache_find(&mpu_metadata_cache, TEST_SCOPE, 1) ||
+			mpu_metadata_cache_find(&mpu_metadata_cache, TEST_SCOPE, 2) ||
+			!mpu_metadata_cache_find(&mpu_metadata_cache, TEST_SCOPE, 3)) {
+		_MPU_METADATA_CACHE_ERROR("test_mpu_metadata_cache_eviction: entries: %zu, evictions: %llu",
+				mpu_metadata_cache.entries_n, (unsigned long long)mpu_metadata_cache.stats.evictions);
+		return -1;
+	}
+
+	mpu_metadata_cache_free(&mpu_metadata_cache);
+	return 0;
+}
+
+int test_mpu_metadata_cache_save_load() {
+	char path[] = "/tmp/atsc3_mmtp_mpu_metadata_cache_test_XXXXXX";
+	int fd = mkstemp(path);
+	if(fd < 0) {
+		return -1;
+	}
+	close(fd);
+
+	mpu_metadata_cache_t mpu_metadata_cache;
+	mpu_metadata_cache_init(&mpu_metadata_cache, 0);
+	uint8_t mpu_metadata[TEST_MPU_METADATA_LENGTH];
+	__test_mpu_metadata(mpu_metadata, 7, 0xCC);
+	const uint8_t asset_id[] = "asset-a";
+
+	mpu_metadata_cache_put_asset(&mpu_metadata_cache, TEST_SCOPE, TEST_PACKET_ID, asset_id, sizeof(asset_id), 0x68657631, 90000);
+	mpu_metadata_cache_put_mpu_metadata(&mpu_metadata_cache, TEST_SCOPE, TEST_PACKET_ID, mpu_metadata, sizeof(mpu_metadata));
+	//asset without mpu metadata is not worth saving
+	mpu_metadata_cache_put_asset(&mpu_metadata_cache, TEST_SCOPE, TEST_PACKET_ID + 1, asset_id, sizeof(asset_id), 0x6d703461, 48000);
+
+	int saved = mpu_metadata_cache_save(&mpu_metadata_cache, path);
+	mpu_metadata_cache_free(&mpu_metadata_cache);
+
+	mpu_metadata_cache_init(&mpu_metadata_cache, 0);
+	int loaded = mpu_metadata_cache_load(&mpu_metadata_cache, path);
+	remove(path);
+
+	mpu_metadata_cache_entry_t* entry = mpu_metadata_cache_find(&mpu_metadata_cache, TEST_SCOPE, TEST_PACKET_ID);
+	if(saved || loaded != 1 || !entry || mpu_metadata_cache.is_dirty ||
+			entry->asset_id_length != sizeof(asset_id) || memcmp(entry->asset_id, asset_id, sizeof(asset_id)) ||
+			entry->asset_type != 0x68657631 || entry->asset_timescale != 90000 ||
+			entry->mpu_metadata_length != sizeof(mpu_metadata) || memcmp(entry->mpu_metadata, mpu_metadata, sizeof(mpu_metadata))) {
+		_MPU_METADATA_CACHE_ERROR("test_mpu_metadata_cache_save_load: saved: %d, loaded: %d", saved, loaded);
+		return -1;
+	}
+
+	mpu_metadata_cache_free(&mpu_metadata_cache);
+	return 0;
+}
+
+//entries before a truncated one are kept, a file with the wrong magic is rejected
+int test_mpu_metadata_cache_load_damaged() {
+	char path[] = "/tmp/atsc3_mmtp_mpu_metadata_cache_test_XXXXXX";
+	int fd = mkstemp(path);
+	if(fd < 0) {
+		return -1;
+	}
+	close(fd);
+
+	mpu_metadata_cache_t mpu_metadata_cache;
+	mpu_metadata_cache_init(&mpu_metadata_cache, 0);
+	uint8_t mpu_metadata[TEST_MPU_METADATA_LENGTH];
+	__test_mpu_metadata(mpu_metadata, 1, 0xAA);
+	mpu_metadata_cache_put_mpu_metadata(&mpu_metadata_cache, TEST_SCOPE, 1, mpu_metadata, sizeof(mpu_metadata));
+	mpu_metadata_cache_put_mpu_metadata(&mpu_metadata_cache, TEST_SCOPE, 2, mpu_metadata, sizeof(mpu_metadata));
+	mpu_metadata_cache_save(&mpu_metadata_cache, path);
+	mpu_metadata_cache_free(&mpu_metadata_cache);
+
+	FILE* fp = fopen(path, "rb+");
+	fseek(fp, 0, SEEK_END);
+	long length = ftell(fp);
+	fclose(fp);
+	truncate(path, length - 5);
+
+	mpu_metadata_cache_init(&mpu_metadata_cache, 0);
+	int truncated = mpu_metadata_cache_load(&mpu_metadata_cache, path);
+	bool kept_first = mpu_metadata_cache_find(&mpu_metadata_cache, TEST_SCOPE, 1) && !mpu_metadata_cache_find(&mpu_metadata_cache, TEST_SCOPE, 2);
+	mpu_metadata_cache_free(&mpu_metadata_cache);
+
+	fp = fopen(path, "wb");
+	fwrite("NOTACACHE", 1, 9, fp);
+	fclose(fp);
+
+	mpu_metadata_cache_init(&mpu_metadata_cache, 0);
+	int bad_magic = mpu_metadata_cache_load(&mpu_metadata_cache, path);
+	remove(path);
+
+	if(truncated != 1 || !kept_first || bad_magic != -1 || mpu_metadata_cache.entries_n) {
+		_MPU_METADATA_CACHE_ERROR("test_mpu_metadata_cache_load_damaged: truncated: %d, kept_first: %d, bad_magic: %d", truncated, kept_first, bad_magic);
+		return -1;
+	}
+
+	mpu_metadata_cache_free(&mpu_metadata_cache);
+	return 0;
+}
+
+#endif
@@ -0,0 +1,114 @@
+/*
+ * atsc3_mmtp_mpu_reassembly.c
+ *
+ *  Created on: Feb 4, 2019
+ *      Author: jjustman
+ */
+
+#include "atsc3_mmtp_mpu_reassembly.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static int __mpu_reassembly_buffer_reserve(mpu_reassembly_buffer_t* mpu_reassembly_buffer, size_t required) {
+	if(required <= mpu_reassembly_buffer->capacity) {
+		return 0;
+	}
+
+	if(required > MPU_REASSEMBLE_MAX_BUFFER) {
+		return -1;
+	}
+
+	size_t new_capacity = mpu_reassembly_buffer->capacity ? mpu_reassembly_buffer->capacity : MPU_REASSEMBLY_BUFFER_MIN_CAPACITY;
+	while(new_capacity < required) {
+		new_capacity *= 2;
+	}
+	if(new_capacity > MPU_REASSEMBLE_MAX_BUFFER) {
+		new_capacity = MPU_REASSEMBLE_MAX_BUFFER;
+	}
+
+	uint8_t* data = realloc(mpu_reassembly_buffer->data, new_capacity);
+	if(!data) {
+		return -1;
+	}
+
+	mpu_reassembly_buffer->data = data;
+	mpu_reassembly_buffer->capacity = new_capacity;
+
+	return 0;
+}
+
+void mpu_reassembly_buffer_init(mpu_reassembly_buffer_t* mpu_reassembly_buffer) {
+	memset(mpu_reassembly_buffer, 0, sizeof(mpu_reassembly_buffer_t));
+}
+
+int mpu_reassembly_buffer_begin(mpu_reassembly_buffer_t* mpu_reassembly_buffer, uint16_t mmtp_packet_id, uint32_t mpu_sequence_number, size_t size_hint) {
+	if(mpu_reassembly_buffer->in_use && mpu_reassembly_buffer->size) {
+		_MPU_REASSEMBLY_DEBUG("mpu_reassembly_buffer_begin: discarding incomplete mpu, packet_id: %hu, mpu_sequence_number: %u, pending: %zu bytes",
+				mpu_reassembly_buffer->mmtp_packet_id, mpu_reassembly_buffer->mpu_sequence_number, mpu_reassembly_buffer->size);
+	}
+
+	mpu_reassembly_buffer->in_use = true;
+	mpu_reassembly_buffer->mmtp_packet_id = mmtp_packet_id;
+	mpu_reassembly_buffer->mpu_sequence_number = mpu_sequence_number;
+	mpu_reassembly_buffer->size = 0;
+
+	if(!size_hint) {
+		//leave a little headroom so a slightly larger MPU doesn't force a doubling
+		size_hint = mpu_reassembly_buffer->last_completed_size + mpu_reassembly_buffer->last_completed_size / 8;
+	}
+
+	if(size_hint > MPU_REASSEMBLE_MAX_BUFFER) {
+		size_hint = MPU_REASSEMBLE_MAX_BUFFER;
+	}
+
+	return __mpu_reassembly_buffer_reserve(mpu_reassembly_buffer, size_hint);
+}
+
+bool mpu_reassembly_buffer_matches(mpu_reassembly_buffer_t* mpu_reassembly_buffer, uint16_t mmtp_packet_id, uint32_t mpu_sequence_number) {
+	return mpu_reassembly_buffer->in_use &&
+			mpu_reassembly_buffer->mmtp_packet_id == mmtp_packet_id &&
+			mpu_reassembly_buffer->mpu_sequence_number == mpu_sequence_number;
+}
+
+int mpu_reassembly_buffer_append(mpu_reassembly_buffer_t* mpu_reassembly_buffer, const uint8_t* fragment, size_t fragment_len) {
+	if(!fragment_len) {
+		return 0;
+	}
+
+	if(__mpu_reassembly_buffer_reserve(mpu_reassembly_buffer, mpu_reassembly_buffer->size + fragment_len)) {
+		_MPU_REASSEMBLY_ERROR("mpu_reassembly_buffer_append: packet_id: %hu, mpu_sequence_number: %u, size: %zu + %zu exceeds %d",
+				mpu_reassembly_buffer->mmtp_packet_id, mpu_reassembly_buffer->mpu_sequence_number,
+				mpu_reassembly_buffer->size, fragment_len, MPU_REASSEMBLE_MAX_BUFFER);
+		return -1;
+	}
+
+	memcpy(mpu_reassembly_buffer->data + mpu_reassembly_buffer->size, fragment, fragment_len);
+	mpu_reassembly_buffer->size += fragment_len;
+
+	return 0;
+}
+
+uint8_t* mpu_reassembly_buffer_detach(mpu_reassembly_buffer_t* mpu_reassembly_buffer, size_t* mpu_len) {
+	uint8_t* data = NULL;
+	*mpu_len = 0;
+
+	if(mpu_reassembly_buffer->size) {
+		data = mpu_reassembly_buffer->data;
+		*mpu_len = mpu_reassembly_buffer->size;
+		mpu_reassembly_buffer->last_completed_size = mpu_reassembly_buffer->size;
+
+		mpu_reassembly_buffer->data = NULL;
+		mpu_reassembly_buffer->capacity = 0;
+	}
+
+	mpu_reassembly_buffer->size = 0;
+	mpu_reassembly_buffer->in_use = false;
+
+	return data;
+}
+
+void mpu_reassembly_buffer_free(mpu_reassembly_buffer_t* mpu_reassembly_buffer) {
+	free(mpu_reassembly_buffer->data);
+	mpu_reassembly_buffer_init(mpu_reassembly_buffer);
+}
@@ -0,0 +1,72 @@
+/*
+ * atsc3_mmtp_mpu_reassembly.h
+ *
+ *  Created on: Feb 4, 2019
+ *      Author: jjustman
+ *
+ * linear-time MPU reassembly: fragments for one (packet_id, mpu_sequence_number) are
+ * appended into a single contiguous buffer that grows geometrically, and the buffer is
+ * handed off exactly once when the MPU completes, instead of re-gathering on every fragment.
+ */
+
+#ifndef MODULES_DEMUX_MMT_ATSC3_MMTP_MPU_REASSEMBLY_H_
+#define MODULES_DEMUX_MMT_ATSC3_MMTP_MPU_REASSEMBLY_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+//kept in sync with atsc3_mmtp_types.h, redeclared so the VLC-only demuxers can use this without the libatsc3 types
+#ifndef UPPER_BOUND_MPU_FRAGMENT_SIZE
+#define UPPER_BOUND_MPU_FRAGMENT_SIZE 1432
+#endif
+
+#ifndef MPU_REASSEMBLE_MAX_BUFFER
+#define MPU_REASSEMBLE_MAX_BUFFER 8192000
+#endif
+
+#define _MPU_REASSEMBLY_PRINTLN(...) printf(__VA_ARGS__);printf("\n")
+#define _MPU_REASSEMBLY_ERROR(...)   printf("%s:%d:ERROR:",__FILE__,__LINE__);_MPU_REASSEMBLY_PRINTLN(__VA_ARGS__);
+#define _MPU_REASSEMBLY_DEBUG(...)
+
+//initial allocation when we have no size hint from the MPU metadata or a previous MPU
+#define MPU_REASSEMBLY_BUFFER_MIN_CAPACITY (64 * UPPER_BOUND_MPU_FRAGMENT_SIZE)
+
+typedef struct mpu_reassembly_buffer {
+	bool		in_use;
+	uint16_t	mmtp_packet_id;
+	uint32_t	mpu_sequence_number;
+
+	uint8_t*	data;
+	size_t		size;
+	size_t		capacity;
+
+	//size of the last completed MPU for this flow, used to pre-size the next one
+	size_t		last_completed_size;
+} mpu_reassembly_buffer_t;
+
+void mpu_reassembly_buffer_init(mpu_reassembly_buffer_t* mpu_reassembly_buffer);
+
+/**
+ * start collecting a new MPU, discarding any pending (incomplete) data.
+ *
+ * size_hint is the expected MPU size in bytes if known (e.g. from the MPU metadata), or 0 to
+ * size from the previous MPU of this flow.
+ */
+int mpu_reassembly_buffer_begin(mpu_reassembly_buffer_t* mpu_reassembly_buffer, uint16_t mmtp_packet_id, uint32_t mpu_sequence_number, size_t size_hint);
+
+bool mpu_reassembly_buffer_matches(mpu_reassembly_buffer_t* mpu_reassembly_buffer, uint16_t mmtp_packet_id, uint32_t mpu_sequence_number);
+
+//returns -1 if the append would exceed MPU_REASSEMBLE_MAX_BUFFER or allocation fails
+int mpu_reassembly_buffer_append(mpu_reassembly_buffer_t* mpu_reassembly_buffer, const uint8_t* fragment, size_t fragment_len);
+
+/**
+ * complete the MPU and transfer ownership of the reassembled bytes to the caller (free() when done),
+ * returns NULL if nothing was collected.
+ */
+uint8_t* mpu_reassembly_buffer_detach(mpu_reassembly_buffer_t* mpu_reassembly_buffer, size_t* mpu_len);
+
+void mpu_reassembly_buffer_free(mpu_reassembly_buffer_t* mpu_reassembly_buffer);
+
+#endif /* MODULES_DEMUX_MMT_ATSC3_MMTP_MPU_REASSEMBLY_H_ */
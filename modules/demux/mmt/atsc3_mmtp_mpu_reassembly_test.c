@@ -0,0 +1,92 @@
+/*
+ *
+ * atsc3_mmtp_mpu_reassembly_test.c:  driver for linear mpu reassembly buffer growth and hand-off
+ *
+ */
+
+#include "atsc3_mmtp_mpu_reassembly.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define __UNIT_TEST 1
+#ifdef __UNIT_TEST
+
+int test_mpu_reassembly_buffer_append_and_detach();
+int test_mpu_reassembly_buffer_max_size();
+
+int main() {
+	int failed = 0;
+
+	failed |= test_mpu_reassembly_buffer_append_and_detach();
+	failed |= test_mpu_reassembly_buffer_max_size();
+
+	return failed;
+}
+
+int test_mpu_reassembly_buffer_append_and_detach() {
+	mpu_reassembly_buffer_t mpu_reassembly_buffer;
+	uint8_t fragment[UPPER_BOUND_MPU_FRAGMENT_SIZE];
+	int fragment_count = 1500;
+
+	mpu_reassembly_buffer_init(&mpu_reassembly_buffer);
+	mpu_reassembly_buffer_begin(&mpu_reassembly_buffer, 35, 1, 0);
+
+	for(int i=0; i < fragment_count; i++) {
+		memset(fragment, i & 0xFF, sizeof(fragment));
+		if(mpu_reassembly_buffer_append(&mpu_reassembly_buffer, fragment, sizeof(fragment))) {
+			_MPU_REASSEMBLY_ERROR("test_mpu_reassembly_buffer_append_and_detach: append %d failed", i);
+			return -1;
+		}
+	}
+
+	if(!mpu_reassembly_buffer_matches(&mpu_reassembly_buffer, 35, 1) || mpu_reassembly_buffer_matches(&mpu_reassembly_buffer, 35, 2)) {
+		_MPU_REASSEMBLY_ERROR("test_mpu_reassembly_buffer_append_and_detach: key mismatch");
+		return -1;
+	}
+
+	size_t mpu_len;
+	uint8_t* mpu = mpu_reassembly_buffer_detach(&mpu_reassembly_buffer, &mpu_len);
+	if(!mpu || mpu_len != fragment_count * sizeof(fragment) || mpu[0] != 0 || mpu[mpu_len - 1] != ((fragment_count - 1) & 0xFF)) {
+		_MPU_REASSEMBLY_ERROR("test_mpu_reassembly_buffer_append_and_detach: reassembled mpu len: %zu", mpu_len);
+		return -1;
+	}
+	free(mpu);
+
+	//next mpu should be pre-sized from the last one
+	mpu_reassembly_buffer_begin(&mpu_reassembly_buffer, 35, 2, 0);
+	if(mpu_reassembly_buffer.capacity < mpu_len) {
+		_MPU_REASSEMBLY_ERROR("test_mpu_reassembly_buffer_append_and_detach: capacity: %zu not pre-sized from %zu", mpu_reassembly_buffer.capacity, mpu_len);
+		return -1;
+	}
+
+	mpu_reassembly_buffer_free(&mpu_reassembly_buffer);
+	printf("test_mpu_reassembly_buffer_append_and_detach: reassembled %d fragments, %zu bytes\n", fragment_count, mpu_len);
+
+	return 0;
+}
+
+int test_mpu_reassembly_buffer_max_size() {
+	mpu_reassembly_buffer_t mpu_reassembly_buffer;
+	uint8_t* fragment = calloc(1, MPU_REASSEMBLE_MAX_BUFFER);
+
+	mpu_reassembly_buffer_init(&mpu_reassembly_buffer);
+	mpu_reassembly_buffer_begin(&mpu_reassembly_buffer, 35, 1, 0);
+
+	if(mpu_reassembly_buffer_append(&mpu_reassembly_buffer, fragment, MPU_REASSEMBLE_MAX_BUFFER) ||
+		!mpu_reassembly_buffer_append(&mpu_reassembly_buffer, fragment, 1)) {
+		_MPU_REASSEMBLY_ERROR("test_mpu_reassembly_buffer_max_size: MPU_REASSEMBLE_MAX_BUFFER not enforced");
+		return -1;
+	}
+
+	mpu_reassembly_buffer_free(&mpu_reassembly_buffer);
+	free(fragment);
+	printf("test_mpu_reassembly_buffer_max_size: rejected append past %d bytes\n", MPU_REASSEMBLE_MAX_BUFFER);
+
+	return 0;
+}
+
+#endif
@@ -6,6 +6,11 @@
  */
 
 #include "atsc3_mmtp_ntp32_to_pts.h"
+#include "atsc3_trace.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
 
 /**
  * convert ntp "short-format" packet time into a future re-clocked pts
@@ -19,16 +24,13 @@
  * 	instead
  */
 
-void compute_ntp32_to_seconds_microseconds(uint32_t timestamp, uint16_t *seconds, uint16_t *microseconds) {
+void compute_ntp32_to_seconds_microseconds(uint32_t timestamp, uint16_t *seconds, uint32_t *microseconds) {
 	//->mmtp_packet_header.mmtp_timestamp, &mmtp_packet->mmtp_packet_header.mmtp_timestamp_s, &mmtp_packet->mmtp_packet_header.mmtp_timestamp_us);
 
 	*seconds = (timestamp >> 16) & 0xFFFF;
 
-	//this is where things get messsy..
-	uint16_t tmp_mmtp_fractional_s =  (timestamp & 0xFFFF);
-	//1329481807 * (10 ^ 6) / 2 ^ 32 = 309544 (roughtly)
-	*microseconds = (uint16_t)( (double)tmp_mmtp_fractional_s * 1.0e6 / (double)(1LL<<16) );
-
+	//fraction is in 1/65536 s, up to 999985 us, so it needs more than 16 bits
+	*microseconds = ntp32_fraction_to_microseconds(timestamp & 0xFFFF);
 }
 /*
  *
@@ -36,16 +38,14 @@ void compute_ntp32_to_seconds_microseconds(uint32_t timestamp, uint16_t *seconds
  */
 
 
-uint64_t compute_relative_ntp32_pts(uint64_t first_pts, uint16_t mmtp_timestamp_s, uint16_t mmtp_timestamp_microseconds) {
+uint64_t compute_relative_ntp32_pts(uint64_t first_pts, uint16_t mmtp_timestamp_s, uint32_t mmtp_timestamp_microseconds) {
 
 	uint64_t pts = REBASE_PTS_OFFSET + (mmtp_timestamp_s * uS) + mmtp_timestamp_microseconds - first_pts;
 
-	printf("%d:compute_relative_ntp32_pts: pts is: %llu\n", __LINE__, pts);
-
 	return pts;
 }
 
-int64_t rebase_now_with_ntp32(uint16_t mmtp_timestamp_s, uint16_t mmtp_timestamp_microseconds) {
+int64_t rebase_now_with_ntp32(uint16_t mmtp_timestamp_s, uint32_t mmtp_timestamp_microseconds) {
 	struct timespec ts;
 	timespec_get(&ts, TIME_UTC);
 
@@ -53,12 +53,141 @@ int64_t rebase_now_with_ntp32(uint16_t mmtp_timestamp_s, uint16_t mmtp_timestamp
 
 	//convert to timespec with rolled over bias
 	uint64_t quantized = REBASE_PTS_OFFSET + ((((ts.tv_sec / 65535)) * 65535) * uS) + ((ts.tv_nsec) / 1000ULL) ; // convert tv_sec & tv_usec to millisecond
-	printf("%d:now_t: %llu, quantized: %llu, mmtp_timestamp_s: %d, \n", __LINE__, now_t, quantized, mmtp_timestamp_s);
+	_ATSC3_TRACE_TRACE("now_t: %"PRIu64", quantized: %"PRIu64", mmtp_timestamp_s: %d", now_t, quantized, mmtp_timestamp_s);
 
 	uint64_t pts = quantized + (mmtp_timestamp_s * uS) + mmtp_timestamp_microseconds;
 
-	printf("%d:utc_now_t is: %llu, rebase_now_with_ntp32: re-quantized is %llu, computed jitter is: %llu \n", __LINE__, now_t, pts, (pts - now_t));
+	_ATSC3_TRACE_TRACE("utc_now_t is: %"PRIu64", rebase_now_with_ntp32: re-quantized is %"PRIu64", computed jitter is: %"PRIu64, now_t, pts, (pts - now_t));
 
 	return pts;
 }
 
+
+void mmtp_clock_recovery_init(mmtp_clock_recovery_t* mmtp_clock_recovery, int64_t window_us) {
+	memset(mmtp_clock_recovery, 0, sizeof(mmtp_clock_recovery_t));
+	mmtp_clock_recovery->window_us = window_us > 0 ? window_us : MMTP_CLOCK_RECOVERY_DEFAULT_WINDOW_US;
+	mmtp_clock_recovery->last_clock_us = MMTP_CLOCK_RECOVERY_INVALID;
+}
+
+/**
+ * extended is in 1/65536 s since the anchor and may be negative (a presentation time before the first packet),
+ * fraction_low carries the bottom 16 bits of a 64 bit ntp fraction.
+ *
+ * whole seconds and the 32 bit fraction are converted separately so nothing accumulates or overflows
+ */
+static int64_t __mmtp_clock_recovery_extended_to_us(int64_t extended, uint16_t fraction_low) {
+	int64_t seconds = extended >= 0 ? extended / 65536 : -((-extended + 65535) / 65536);
+	uint64_t fraction = ((uint64_t)(extended - seconds * 65536) << 16) | fraction_low;
+
+	return MMTP_CLOCK_RECOVERY_TIMELINE_ORIGIN_US + seconds * (int64_t)uS + (int64_t)((fraction * uS + (1ULL << 31)) >> 32);
+}
+
+//signed distance from the reference, the short format wraps every 65536 s so anything within +-32768 s is unambiguous
+static int64_t __mmtp_clock_recovery_extend(mmtp_clock_recovery_t* mmtp_clock_recovery, uint32_t ntp32) {
+	return mmtp_clock_recovery->last_ntp32_extended + (int32_t)(ntp32 - mmtp_clock_recovery->last_ntp32);
+}
+
+int64_t mmtp_clock_recovery_ntp32_to_timeline_us(mmtp_clock_recovery_t* mmtp_clock_recovery, uint32_t ntp32) {
+	if(!mmtp_clock_recovery->has_timeline) {
+		mmtp_clock_recovery->has_timeline = true;
+		mmtp_clock_recovery->last_ntp32 = ntp32;
+		mmtp_clock_recovery->last_ntp32_extended = 0;
+		return __mmtp_clock_recovery_extended_to_us(0, 0);
+	}
+
+	int64_t extended = __mmtp_clock_recovery_extend(mmtp_clock_recovery, ntp32);
+
+	//only move the reference forward so a reordered packet can't drag it back across a wrap
+	if(extended > mmtp_clock_recovery->last_ntp32_extended) {
+		if(ntp32 < mmtp_clock_recovery->last_ntp32) {
+			mmtp_clock_recovery->stats.rollovers++;
+		}
+		mmtp_clock_recovery->last_ntp32 = ntp32;
+		mmtp_clock_recovery->last_ntp32_extended = extended;
+	}
+
+	return __mmtp_clock_recovery_extended_to_us(extended, 0);
+}
+
+int64_t mmtp_clock_recovery_ntp64_to_timeline_us(mmtp_clock_recovery_t* mmtp_clock_recovery, uint64_t ntp64) {
+	if(!mmtp_clock_recovery->has_timeline) {
+		return MMTP_CLOCK_RECOVERY_INVALID;
+	}
+
+	//middle 32 bits are the short format the packet timestamps are in
+	int64_t extended = __mmtp_clock_recovery_extend(mmtp_clock_recovery, (uint32_t)(ntp64 >> 16));
+
+	return __mmtp_clock_recovery_extended_to_us(extended, ntp64 & 0xFFFF);
+}
+
+int64_t mmtp_clock_recovery_push(mmtp_clock_recovery_t* mmtp_clock_recovery, uint32_t ntp32, int64_t arrival_us) {
+	int64_t timeline_us = mmtp_clock_recovery_ntp32_to_timeline_us(mmtp_clock_recovery, ntp32);
+	int64_t offset_us = arrival_us - timeline_us;
+
+	mmtp_clock_recovery->stats.packets++;
+
+	if(mmtp_clock_recovery->has_offset && llabs(offset_us - mmtp_clock_recovery->offset_us) > MMTP_CLOCK_RECOVERY_DISCONTINUITY_US) {
+		_MMTP_CLOCK_RECOVERY_INFO("mmtp_clock_recovery: discontinuity, offset moved from %lld to %lld us", (long long)mmtp_clock_recovery->offset_us, (long long)offset_us);
+		mmtp_clock_recovery->stats.discontinuities++;
+		mmtp_clock_recovery->has_offset = false;
+		mmtp_clock_recovery->last_clock_us = MMTP_CLOCK_RECOVERY_INVALID;
+
+		//a sender that stepped back must still move the unwrap reference
+		mmtp_clock_recovery->last_ntp32_extended = __mmtp_clock_recovery_extend(mmtp_clock_recovery, ntp32);
+		mmtp_clock_recovery->last_ntp32 = ntp32;
+	}
+
+	if(!mmtp_clock_recovery->has_offset) {
+		mmtp_clock_recovery->has_offset = true;
+		mmtp_clock_recovery->window_start_us = arrival_us;
+		mmtp_clock_recovery->window_min_offset_us = offset_us;
+		mmtp_clock_recovery->previous_window_min_offset_us = INT64_MAX;
+		mmtp_clock_recovery->offset_us = offset_us;
+		return timeline_us;
+	}
+
+	//minimum over the current and the previous window, so an old minimum ages out after at most two windows (and follows drift)
+	if(arrival_us - mmtp_clock_recovery->window_start_us >= mmtp_clock_recovery->window_us) {
+		mmtp_clock_recovery->previous_window_min_offset_us = mmtp_clock_recovery->window_min_offset_us;
+		mmtp_clock_recovery->window_min_offset_us = offset_us;
+		mmtp_clock_recovery->window_start_us = arrival_us;
+	} else if(offset_us < mmtp_clock_recovery->window_min_offset_us) {
+		mmtp_clock_recovery->window_min_offset_us = offset_us;
+	}
+
+	mmtp_clock_recovery->offset_us = mmtp_clock_recovery->window_min_offset_us < mmtp_clock_recovery->previous_window_min_offset_us ?
+			mmtp_clock_recovery->window_min_offset_us : mmtp_clock_recovery->previous_window_min_offset_us;
+
+	int64_t delay_us = offset_us - mmtp_clock_recovery->offset_us;
+	mmtp_clock_recovery->stats.jitter_us += (delay_us - mmtp_clock_recovery->stats.jitter_us) / 16;
+	if(delay_us > mmtp_clock_recovery->stats.jitter_max_us) {
+		mmtp_clock_recovery->stats.jitter_max_us = delay_us;
+	}
+
+	return timeline_us;
+}
+
+int64_t mmtp_clock_recovery_now(mmtp_clock_recovery_t* mmtp_clock_recovery, int64_t now_us) {
+	if(!mmtp_clock_recovery->has_offset) {
+		return MMTP_CLOCK_RECOVERY_INVALID;
+	}
+
+	int64_t clock_us = now_us - mmtp_clock_recovery->offset_us;
+
+	//the offset rises when a low minimum ages out, hold the clock rather than step it back
+	if(mmtp_clock_recovery->last_clock_us != MMTP_CLOCK_RECOVERY_INVALID && clock_us < mmtp_clock_recovery->last_clock_us) {
+		clock_us = mmtp_clock_recovery->last_clock_us;
+	}
+	mmtp_clock_recovery->last_clock_us = clock_us;
+
+	return clock_us;
+}
+
+void mmtp_clock_recovery_stats_dump(mmtp_clock_recovery_t* mmtp_clock_recovery) {
+	_MMTP_CLOCK_RECOVERY_INFO("mmtp_clock_recovery: packets: %llu, rollovers: %llu, discontinuities: %llu, jitter: %lld us, jitter max: %lld us",
+			(unsigned long long)mmtp_clock_recovery->stats.packets,
+			(unsigned long long)mmtp_clock_recovery->stats.rollovers,
+			(unsigned long long)mmtp_clock_recovery->stats.discontinuities,
+			(long long)mmtp_clock_recovery->stats.jitter_us,
+			(long long)mmtp_clock_recovery->stats.jitter_max_us);
+}
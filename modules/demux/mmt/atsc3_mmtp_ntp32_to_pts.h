@@ -9,9 +9,15 @@
 #define MODULES_DEMUX_MMT_MMTP_NTP32_TO_PTS_H_
 
 #include "atsc3_utils.h"
+#include <stdbool.h>
+#include <stdint.h>
 #include <time.h>
 #include <stdio.h>
 
+#define _MMTP_CLOCK_RECOVERY_PRINTLN(...) printf(__VA_ARGS__);printf("\n")
+#define _MMTP_CLOCK_RECOVERY_INFO(...)    printf("%s:%d:INFO :",__FILE__,__LINE__);_MMTP_CLOCK_RECOVERY_PRINTLN(__VA_ARGS__);
+#define _MMTP_CLOCK_RECOVERY_DEBUG(...)
+
 
 /**
  * convert ntp "short-format" packet time into a future re-clocked pts
@@ -26,9 +32,86 @@
  */
 #define REBASE_PTS_OFFSET 0
 
-void compute_ntp32_to_seconds_microseconds(uint32_t timestamp, uint16_t *seconds, uint16_t *microseconds);
-uint64_t compute_relative_ntp32_pts(uint64_t first_pts, uint16_t mmtp_timestamp_s, uint16_t mmtp_timestamp_microseconds);
-int64_t rebase_now_with_ntp32(uint16_t mmtp_timestamp_s, uint16_t mmtp_timestamp_microseconds);
+void compute_ntp32_to_seconds_microseconds(uint32_t timestamp, uint16_t *seconds, uint32_t *microseconds);
+uint64_t compute_relative_ntp32_pts(uint64_t first_pts, uint16_t mmtp_timestamp_s, uint32_t mmtp_timestamp_microseconds);
+int64_t rebase_now_with_ntp32(uint16_t mmtp_timestamp_s, uint32_t mmtp_timestamp_microseconds);
+
+//exact 1/65536 s -> us, rounded to nearest
+static inline uint32_t ntp32_fraction_to_microseconds(uint16_t fraction) {
+	return (uint32_t)(((uint64_t)fraction * uS + 0x8000) >> 16);
+}
+
+
+/**
+ * mmtp clock recovery
+ *
+ * maps the sender's 32 bit ntp short-format mmtp_timestamp (and 64 bit ntp presentation times, e.g.
+ * from the MPU_timestamp_descriptor) onto one continuous microsecond timeline, unwrapped across the
+ * 65536 s rollover and anchored so the first timestamp seen lands on MMTP_CLOCK_RECOVERY_TIMELINE_ORIGIN_US.
+ *
+ * every packet's arrival time is compared with its send time. network and receive jitter only ever
+ * add delay, so the smallest arrival - send offset seen over the last one to two windows is the
+ * transit time of an undelayed packet; now - that offset is the sender's clock as of now, which is
+ * what the PCR should follow. the output is kept monotonic unless a discontinuity is detected.
+ *
+ * arrival and now must come from the same local clock (e.g. vlc_tick_now()).
+ */
+#define MMTP_CLOCK_RECOVERY_TIMELINE_ORIGIN_US	1000000
+#define MMTP_CLOCK_RECOVERY_DEFAULT_WINDOW_US	2000000
+
+//an offset further than this from the estimate is a sender clock jump (or a stalled receiver), start over
+#define MMTP_CLOCK_RECOVERY_DISCONTINUITY_US	5000000
+
+#define MMTP_CLOCK_RECOVERY_INVALID				INT64_MIN
+
+typedef struct mmtp_clock_recovery_stats {
+	uint64_t	packets;
+	uint64_t	rollovers;				//65536 s wraps of the ntp short-format seconds
+	uint64_t	discontinuities;
+	int64_t		jitter_us;				//smoothed delay over the undelayed transit time
+	int64_t		jitter_max_us;
+} mmtp_clock_recovery_stats_t;
+
+typedef struct mmtp_clock_recovery {
+	int64_t		window_us;
+
+	//timeline
+	bool		has_timeline;
+	uint32_t	last_ntp32;
+	int64_t		last_ntp32_extended;	//1/65536 s units since the anchor, no wrap
+
+	//offset (arrival - timeline) filter
+	bool		has_offset;
+	int64_t		window_start_us;
+	int64_t		window_min_offset_us;
+	int64_t		previous_window_min_offset_us;
+	int64_t		offset_us;
+
+	int64_t		last_clock_us;
+
+	mmtp_clock_recovery_stats_t stats;
+} mmtp_clock_recovery_t;
+
+void mmtp_clock_recovery_init(mmtp_clock_recovery_t* mmtp_clock_recovery, int64_t window_us);
+
+//timeline position of a packet timestamp, the first call anchors the timeline
+int64_t mmtp_clock_recovery_ntp32_to_timeline_us(mmtp_clock_recovery_t* mmtp_clock_recovery, uint32_t ntp32);
+
+//timeline position of a full ntp timestamp (32.32), MMTP_CLOCK_RECOVERY_INVALID before any packet timestamp was seen
+int64_t mmtp_clock_recovery_ntp64_to_timeline_us(mmtp_clock_recovery_t* mmtp_clock_recovery, uint64_t ntp64);
+
+/**
+ * feed the send time of a received packet and when it arrived.
+ * returns the packet's timeline position
+ */
+int64_t mmtp_clock_recovery_push(mmtp_clock_recovery_t* mmtp_clock_recovery, uint32_t ntp32, int64_t arrival_us);
+
+/**
+ * the sender's timeline as of now_us, jitter filtered and non-decreasing between discontinuities.
+ * MMTP_CLOCK_RECOVERY_INVALID until the first packet was pushed
+ */
+int64_t mmtp_clock_recovery_now(mmtp_clock_recovery_t* mmtp_clock_recovery, int64_t now_us);
 
+void mmtp_clock_recovery_stats_dump(mmtp_clock_recovery_t* mmtp_clock_recovery);
 
 #endif /* MODULES_DEMUX_MMT_MMTP_NTP32_TO_PTS_H_ */
@@ -0,0 +1,201 @@
+/*
+ *
+ * atsc3_mmtp_ntp32_to_pts_test.c:  driver for ntp short-format conversion and mmtp clock recovery
+ *
+ */
+
+#include "atsc3_mmtp_ntp32_to_pts.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define __UNIT_TEST 1
+#ifdef __UNIT_TEST
+
+#define _MMTP_CLOCK_RECOVERY_TEST_ERROR(...)   printf("%s:%d:ERROR:",__FILE__,__LINE__);_MMTP_CLOCK_RECOVERY_PRINTLN(__VA_ARGS__);
+
+//ntp short format for a time in us
+#define TEST_NTP32(us) ((uint32_t)((((uint64_t)(us) << 16) + uS / 2) / uS))
+
+int test_compute_ntp32_to_seconds_microseconds();
+int test_mmtp_clock_recovery_rollover();
+int test_mmtp_clock_recovery_ntp64();
+int test_mmtp_clock_recovery_jitter();
+int test_mmtp_clock_recovery_discontinuity();
+
+int main() {
+	int failed = 0;
+
+	failed |= test_compute_ntp32_to_seconds_microseconds();
+	failed |= test_mmtp_clock_recovery_rollover();
+	failed |= test_mmtp_clock_recovery_ntp64();
+	failed |= test_mmtp_clock_recovery_jitter();
+	failed |= test_mmtp_clock_recovery_discontinuity();
+
+	return failed;
+}
+
+//fractions over 65 ms used to be truncated to 16 bits
+int test_compute_ntp32_to_seconds_microseconds() {
+	uint16_t seconds = 0;
+	uint32_t microseconds = 0;
+
+	compute_ntp32_to_seconds_microseconds(0x00070000 | 0x8000, &seconds, &microseconds);
+	if(seconds != 7 || microseconds != 500000) {
+		_MMTP_CLOCK_RECOVERY_TEST_ERROR("test_compute_ntp32_to_seconds_microseconds: 7.5 s -> %hu s %u us", seconds, microseconds);
+		return -1;
+	}
+
+	compute_ntp32_to_seconds_microseconds(0xFFFFFFFF, &seconds, &microseconds);
+	if(seconds != 65535 || microseconds != 999985) {
+		_MMTP_CLOCK_RECOVERY_TEST_ERROR("test_compute_ntp32_to_seconds_microseconds: max -> %hu s %u us", seconds, microseconds);
+		return -1;
+	}
+
+	//every fraction round trips within half a tick
+	for(uint32_t fraction=0; fraction <= 0xFFFF; fraction++) {
+		uint32_t us = ntp32_fraction_to_microseconds(fraction);
+		if(TEST_NTP32(us) != fraction) {
+			_MMTP_CLOCK_RECOVERY_TEST_ERROR("test_compute_ntp32_to_seconds_microseconds: fraction 0x%04x -> %u us", fraction, us);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+//a stream starting just before the 65536 s wrap keeps counting up through it
+int test_mmtp_clock_recovery_rollover() {
+	mmtp_clock_recovery_t mmtp_clock_recovery;
+	mmtp_clock_recovery_init(&mmtp_clock_recovery, 0);
+
+	uint64_t start_us = 65530 * uS;
+	int64_t last_timeline_us = 0;
+
+	for(uint64_t i=0; i <= 12000; i++) {
+		uint64_t send_us = start_us + i * 1000;
+		int64_t timeline_us = mmtp_clock_recovery_ntp32_to_timeline_us(&mmtp_clock_recovery, TEST_NTP32(send_us));
+		int64_t expected_us = MMTP_CLOCK_RECOVERY_TIMELINE_ORIGIN_US + (int64_t)(i * 1000);
+
+		if(llabs(timeline_us - expected_us) > 16 || timeline_us < last_timeline_us) {
+			_MMTP_CLOCK_RECOVERY_TEST_ERROR("test_mmtp_clock_recovery_rollover: packet %llu at %lld, expected %lld", (unsigned long long)i, (long long)timeline_us, (long long)expected_us);
+			return -1;
+		}
+		last_timeline_us = timeline_us;
+	}
+
+	//a late packet from before the wrap still lands before it
+	int64_t late_us = mmtp_clock_recovery_ntp32_to_timeline_us(&mmtp_clock_recovery, TEST_NTP32(start_us + 5000000));
+	if(mmtp_clock_recovery.stats.rollovers != 1 || llabs(late_us - (MMTP_CLOCK_RECOVERY_TIMELINE_ORIGIN_US + 5000000)) > 16) {
+		_MMTP_CLOCK_RECOVERY_TEST_ERROR("test_mmtp_clock_recovery_rollover: rollovers: %llu, late packet at %lld", (unsigned long long)mmtp_clock_recovery.stats.rollovers, (long long)late_us);
+		return -1;
+	}
+
+	return 0;
+}
+
+//MPU presentation times are full 64 bit ntp and map onto the same timeline as the packet timestamps
+int test_mmtp_clock_recovery_ntp64() {
+	mmtp_clock_recovery_t mmtp_clock_recovery;
+	mmtp_clock_recovery_init(&mmtp_clock_recovery, 0);
+
+	uint64_t ntp_seconds = 3759000000ULL;
+
+	if(mmtp_clock_recovery_ntp64_to_timeline_us(&mmtp_clock_recovery, ntp_seconds << 32) != MMTP_CLOCK_RECOVERY_INVALID) {
+		_MMTP_CLOCK_RECOVERY_TEST_ERROR("test_mmtp_clock_recovery_ntp64: converted without an anchor");
+		return -1;
+	}
+
+	mmtp_clock_recovery_ntp32_to_timeline_us(&mmtp_clock_recovery, (uint32_t)((ntp_seconds << 32) >> 16));
+
+	//1.25 s later, and 0.5 s earlier than the anchor
+	int64_t after_us = mmtp_clock_recovery_ntp64_to_timeline_us(&mmtp_clock_recovery, ((ntp_seconds + 1) << 32) | 0x40000000);
+	int64_t before_us = mmtp_clock_recovery_ntp64_to_timeline_us(&mmtp_clock_recovery, ((ntp_seconds - 1) << 32) | 0x80000000);
+
+	if(after_us != MMTP_CLOCK_RECOVERY_TIMELINE_ORIGIN_US + 1250000 || before_us != MMTP_CLOCK_RECOVERY_TIMELINE_ORIGIN_US - 500000) {
+		_MMTP_CLOCK_RECOVERY_TEST_ERROR("test_mmtp_clock_recovery_ntp64: after: %lld, before: %lld", (long long)after_us, (long long)before_us);
+		return -1;
+	}
+
+	return 0;
+}
+
+//packets every 1 ms with up to 80 ms of random delay: the clock must follow the sender within a couple of ms and never step back
+int test_mmtp_clock_recovery_jitter() {
+	mmtp_clock_recovery_t mmtp_clock_recovery;
+	mmtp_clock_recovery_init(&mmtp_clock_recovery, 500000);
+	srand(1);
+
+	int64_t transit_us = 30000;
+	int64_t local_epoch_us = 9000000000LL;
+	uint64_t send_start_us = 1234 * uS;
+	int64_t last_clock_us = MMTP_CLOCK_RECOVERY_INVALID;
+	int64_t worst_error_us = 0;
+	int64_t now_us = 0;
+
+	for(int64_t i=0; i < 10000; i++) {
+		int64_t send_us = i * 1000;
+		int64_t arrival_us = local_epoch_us + send_us + transit_us + (rand() % 80000);
+		if(i % 97 == 0) {
+			arrival_us = local_epoch_us + send_us + transit_us;
+		}
+
+		mmtp_clock_recovery_push(&mmtp_clock_recovery, TEST_NTP32(send_start_us + send_us), arrival_us);
+
+		//the local clock only moves forward, whatever order packets show up in
+		if(arrival_us > now_us) {
+			now_us = arrival_us;
+		}
+		int64_t clock_us = mmtp_clock_recovery_now(&mmtp_clock_recovery, now_us);
+		if(last_clock_us != MMTP_CLOCK_RECOVERY_INVALID && clock_us < last_clock_us) {
+			_MMTP_CLOCK_RECOVERY_TEST_ERROR("test_mmtp_clock_recovery_jitter: clock stepped back from %lld to %lld", (long long)last_clock_us, (long long)clock_us);
+			return -1;
+		}
+		last_clock_us = clock_us;
+
+		//where the sender is now
+		int64_t sender_now_us = MMTP_CLOCK_RECOVERY_TIMELINE_ORIGIN_US + now_us - local_epoch_us - transit_us;
+		if(i >= 200 && llabs(clock_us - sender_now_us) > worst_error_us) {
+			worst_error_us = llabs(clock_us - sender_now_us);
+		}
+	}
+
+	if(worst_error_us > 2000 || mmtp_clock_recovery.stats.jitter_max_us < 70000) {
+		_MMTP_CLOCK_RECOVERY_TEST_ERROR("test_mmtp_clock_recovery_jitter: worst error: %lld us, jitter max: %lld us", (long long)worst_error_us, (long long)mmtp_clock_recovery.stats.jitter_max_us);
+		return -1;
+	}
+
+	mmtp_clock_recovery_stats_dump(&mmtp_clock_recovery);
+	return 0;
+}
+
+//a sender clock jump resets the estimate instead of freezing the clock
+int test_mmtp_clock_recovery_discontinuity() {
+	mmtp_clock_recovery_t mmtp_clock_recovery;
+	mmtp_clock_recovery_init(&mmtp_clock_recovery, 0);
+
+	int64_t arrival_us = 5000000;
+	for(int i=0; i < 100; i++, arrival_us += 10000) {
+		mmtp_clock_recovery_push(&mmtp_clock_recovery, TEST_NTP32(100 * uS + i * 10000), arrival_us);
+	}
+	int64_t before_us = mmtp_clock_recovery_now(&mmtp_clock_recovery, arrival_us);
+
+	//sender jumps back 60 s
+	for(int i=0; i < 100; i++, arrival_us += 10000) {
+		mmtp_clock_recovery_push(&mmtp_clock_recovery, TEST_NTP32(40 * uS + i * 10000), arrival_us);
+	}
+	int64_t after_us = mmtp_clock_recovery_now(&mmtp_clock_recovery, arrival_us);
+
+	if(mmtp_clock_recovery.stats.discontinuities != 1 || llabs((before_us - after_us) - 60 * (int64_t)uS) > 100) {
+		_MMTP_CLOCK_RECOVERY_TEST_ERROR("test_mmtp_clock_recovery_discontinuity: discontinuities: %llu, before: %lld, after: %lld",
+				(unsigned long long)mmtp_clock_recovery.stats.discontinuities, (long long)before_us, (long long)after_us);
+		return -1;
+	}
+
+	return 0;
+}
+
+#endif
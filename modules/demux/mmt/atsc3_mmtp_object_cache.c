@@ -0,0 +1,167 @@
+/*
+ * atsc3_mmtp_object_cache.c
+ *
+ *  Created on: Feb 18, 2019
+ *      Author: jjustman
+ */
+
+#include "atsc3_mmtp_object_cache.h"
+
+#include <string.h>
+
+void mmtp_object_cache_init(mmtp_object_cache_t* mmtp_object_cache, const mmtp_object_sink_t* sink) {
+	memset(mmtp_object_cache, 0, sizeof(mmtp_object_cache_t));
+	if(sink) {
+		mmtp_object_cache->sink = *sink;
+	}
+}
+
+static bool __mmtp_object_key_equals(const mmtp_object_key_t* a, const mmtp_object_key_t* b) {
+	return a->service_id == b->service_id && a->packet_id == b->packet_id &&
+			a->mpu_sequence_number == b->mpu_sequence_number && a->item_id == b->item_id;
+}
+
+bool mmtp_object_cache_is_done(mmtp_object_cache_t* mmtp_object_cache, const mmtp_object_key_t* key) {
+	for(size_t i = 0; i < mmtp_object_cache->done_n; i++) {
+		if(__mmtp_object_key_equals(&mmtp_object_cache->done[i], key)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void __mmtp_object_cache_done_add(mmtp_object_cache_t* mmtp_object_cache, const mmtp_object_key_t* key) {
+	mmtp_object_cache->done[mmtp_object_cache->done_next] = *key;
+	mmtp_object_cache->done_next = (mmtp_object_cache->done_next + 1) & (MMTP_OBJECT_CACHE_DONE_SIZE - 1);
+	if(mmtp_object_cache->done_n < MMTP_OBJECT_CACHE_DONE_SIZE) {
+		mmtp_object_cache->done_n++;
+	}
+}
+
+static mmtp_object_in_flight_t* __mmtp_object_cache_in_flight_find(mmtp_object_cache_t* mmtp_object_cache, const mmtp_object_key_t* key) {
+	for(int i = 0; i < MMTP_OBJECT_CACHE_MAX_IN_FLIGHT; i++) {
+		mmtp_object_in_flight_t* in_flight = &mmtp_object_cache->in_flight[i];
+		if(in_flight->in_use && __mmtp_object_key_equals(&in_flight->key, key)) {
+			return in_flight;
+		}
+	}
+	return NULL;
+}
+
+static void __mmtp_object_cache_end(mmtp_object_cache_t* mmtp_object_cache, mmtp_object_in_flight_t* in_flight, bool complete) {
+	if(complete) {
+		mmtp_object_cache->stats.objects_completed++;
+		__mmtp_object_cache_done_add(mmtp_object_cache, &in_flight->key);
+	} else {
+		mmtp_object_cache->stats.objects_incomplete++;
+		_MMTP_OBJECT_CACHE_DEBUG("packet_id: %hu, mpu_sequence_number: %u, item_id: %u, incomplete after %llu bytes",
+				in_flight->key.packet_id, in_flight->key.mpu_sequence_number, in_flight->key.item_id, (unsigned long long)in_flight->length);
+	}
+
+	if(mmtp_object_cache->sink.object_end) {
+		mmtp_object_cache->sink.object_end(mmtp_object_cache->sink.context, &in_flight->key, in_flight->length, complete);
+	}
+	in_flight->in_use = false;
+}
+
+static void __mmtp_object_cache_data(mmtp_object_cache_t* mmtp_object_cache, mmtp_object_in_flight_t* in_flight, const uint8_t* data, size_t length) {
+	if(length && mmtp_object_cache->sink.object_data) {
+		mmtp_object_cache->sink.object_data(mmtp_object_cache->sink.context, &in_flight->key, in_flight->length, data, length);
+	}
+	in_flight->length += length;
+	in_flight->last_used = ++mmtp_object_cache->use_counter;
+	mmtp_object_cache->stats.bytes_delivered += length;
+}
+
+//a free slot for key, closing the least recently fed object when all are taken
+static mmtp_object_in_flight_t* __mmtp_object_cache_begin(mmtp_object_cache_t* mmtp_object_cache, const mmtp_object_key_t* key) {
+	mmtp_object_in_flight_t* in_flight = NULL;
+	for(int i = 0; i < MMTP_OBJECT_CACHE_MAX_IN_FLIGHT; i++) {
+		mmtp_object_in_flight_t* candidate = &mmtp_object_cache->in_flight[i];
+		if(!candidate->in_use) {
+			in_flight = candidate;
+			break;
+		}
+		if(!in_flight || candidate->last_used < in_flight->last_used) {
+			in_flight = candidate;
+		}
+	}
+
+	if(in_flight->in_use) {
+		__mmtp_object_cache_end(mmtp_object_cache, in_flight, false);
+	}
+
+	memset(in_flight, 0, sizeof(mmtp_object_in_flight_t));
+	in_flight->in_use = true;
+	in_flight->key = *key;
+	in_flight->last_used = ++mmtp_object_cache->use_counter;
+
+	if(mmtp_object_cache->sink.object_begin) {
+		mmtp_object_cache->sink.object_begin(mmtp_object_cache->sink.context, key);
+	}
+	return in_flight;
+}
+
+int mmtp_object_cache_push(mmtp_object_cache_t* mmtp_object_cache, const mmtp_object_key_t* key, uint8_t fragmentation_indicator,
+		uint8_t fragmentation_counter, const uint8_t* data, size_t length) {
+
+	mmtp_object_in_flight_t* in_flight = __mmtp_object_cache_in_flight_find(mmtp_object_cache, key);
+
+	//a repeat of what was already handed on; an object still in flight is never in the done list
+	if(!in_flight && mmtp_object_cache_is_done(mmtp_object_cache, key)) {
+		mmtp_object_cache->stats.fragments_repeated++;
+		return 0;
+	}
+
+	if(fragmentation_indicator == 0 || fragmentation_indicator == 1) {
+		//a new first fragment restarts the object, whatever was collected of it is lost
+		if(in_flight) {
+			__mmtp_object_cache_end(mmtp_object_cache, in_flight, false);
+		}
+		in_flight = __mmtp_object_cache_begin(mmtp_object_cache, key);
+		__mmtp_object_cache_data(mmtp_object_cache, in_flight, data, length);
+
+		if(fragmentation_indicator == 0) {
+			__mmtp_object_cache_end(mmtp_object_cache, in_flight, true);
+			return 1;
+		}
+		in_flight->fragmentation_counter = fragmentation_counter - 1;
+		return 0;
+	}
+
+	if(!in_flight) {
+		mmtp_object_cache->stats.fragments_orphaned++;
+		return 0;
+	}
+
+	//counts down to 0 on the last fragment
+	if(fragmentation_counter != in_flight->fragmentation_counter || (fragmentation_indicator == 3) != (fragmentation_counter == 0)) {
+		__mmtp_object_cache_end(mmtp_object_cache, in_flight, false);
+		return 0;
+	}
+
+	__mmtp_object_cache_data(mmtp_object_cache, in_flight, data, length);
+	if(fragmentation_indicator == 3) {
+		__mmtp_object_cache_end(mmtp_object_cache, in_flight, true);
+		return 1;
+	}
+	in_flight->fragmentation_counter--;
+	return 0;
+}
+
+void mmtp_object_cache_stats_dump(mmtp_object_cache_t* mmtp_object_cache) {
+	_MMTP_OBJECT_CACHE_INFO("mmtp_object_cache: completed: %llu, incomplete: %llu, repeated fragments: %llu, orphaned fragments: %llu, bytes: %llu",
+			(unsigned long long)mmtp_object_cache->stats.objects_completed,
+			(unsigned long long)mmtp_object_cache->stats.objects_incomplete,
+			(unsigned long long)mmtp_object_cache->stats.fragments_repeated,
+			(unsigned long long)mmtp_object_cache->stats.fragments_orphaned,
+			(unsigned long long)mmtp_object_cache->stats.bytes_delivered);
+}
+
+void mmtp_object_cache_free(mmtp_object_cache_t* mmtp_object_cache) {
+	for(int i = 0; i < MMTP_OBJECT_CACHE_MAX_IN_FLIGHT; i++) {
+		if(mmtp_object_cache->in_flight[i].in_use) {
+			__mmtp_object_cache_end(mmtp_object_cache, &mmtp_object_cache->in_flight[i], false);
+		}
+	}
+}
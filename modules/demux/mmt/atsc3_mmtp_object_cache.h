@@ -0,0 +1,103 @@
+/*
+ * atsc3_mmtp_object_cache.h
+ *
+ *  Created on: Feb 18, 2019
+ *      Author: jjustman
+ *
+ * assembles non-timed items (non-timed MFUs of an MPU, payload_type 0x00) and generic objects (payload_type 0x01)
+ * from their data unit fragments, e.g. caption resources, application files or ESG fragments.
+ *
+ * nothing is buffered here: each fragment is handed to the sink as it arrives, in order, with its offset into
+ * the object, and the object is closed once its last fragment is in. a fragmentation_counter that skips, or a
+ * middle/last fragment with no first, closes the object as incomplete instead.
+ *
+ * the keys of the last MMTP_OBJECT_CACHE_DONE_SIZE completed objects are remembered, so carousel repeats of an
+ * object already handed on are skipped rather than delivered again.
+ *
+ * not thread-safe.
+ */
+
+#ifndef MODULES_DEMUX_MMT_ATSC3_MMTP_OBJECT_CACHE_H_
+#define MODULES_DEMUX_MMT_ATSC3_MMTP_OBJECT_CACHE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define _MMTP_OBJECT_CACHE_PRINTLN(...) printf(__VA_ARGS__);printf("\n")
+#define _MMTP_OBJECT_CACHE_ERROR(...)   printf("%s:%d:ERROR:",__FILE__,__LINE__);_MMTP_OBJECT_CACHE_PRINTLN(__VA_ARGS__);
+#define _MMTP_OBJECT_CACHE_INFO(...)    printf("%s:%d:INFO :",__FILE__,__LINE__);_MMTP_OBJECT_CACHE_PRINTLN(__VA_ARGS__);
+#define _MMTP_OBJECT_CACHE_DEBUG(...)
+
+//objects being assembled at once, the least recently fed is closed as incomplete past this
+#define MMTP_OBJECT_CACHE_MAX_IN_FLIGHT		16
+//completed object keys remembered for repeat suppression, power of two
+#define MMTP_OBJECT_CACHE_DONE_SIZE			256
+
+typedef struct mmtp_object_key {
+	uint16_t	service_id;				//0 for a single stream
+	uint16_t	packet_id;
+	uint32_t	mpu_sequence_number;	//the MPU of a non-timed item, or the generic object's object id
+	uint32_t	item_id;				//non_timed_mfu_item_id, 0 for generic objects
+} mmtp_object_key_t;
+
+/**
+ * where assembled objects go: begin, then data for each fragment in order, then end.
+ * complete is false if fragments were lost, what was handed over by data is then to be discarded
+ */
+typedef struct mmtp_object_sink {
+	void*	context;
+	void	(*object_begin)(void* context, const mmtp_object_key_t* key);
+	void	(*object_data)(void* context, const mmtp_object_key_t* key, uint64_t offset, const uint8_t* data, size_t length);
+	void	(*object_end)(void* context, const mmtp_object_key_t* key, uint64_t length, bool complete);
+} mmtp_object_sink_t;
+
+typedef struct mmtp_object_in_flight {
+	bool				in_use;
+	mmtp_object_key_t	key;
+	uint64_t			length;					//bytes handed to the sink so far
+	uint8_t				fragmentation_counter;	//expected on the next fragment
+	uint64_t			last_used;
+} mmtp_object_in_flight_t;
+
+typedef struct mmtp_object_cache_stats {
+	uint64_t	objects_completed;
+	uint64_t	objects_incomplete;
+	uint64_t	fragments_repeated;		//of an object already completed
+	uint64_t	fragments_orphaned;		//middle or last fragment of an object never begun
+	uint64_t	bytes_delivered;
+} mmtp_object_cache_stats_t;
+
+typedef struct mmtp_object_cache {
+	mmtp_object_sink_t			sink;
+
+	mmtp_object_in_flight_t		in_flight[MMTP_OBJECT_CACHE_MAX_IN_FLIGHT];
+	uint64_t					use_counter;
+
+	mmtp_object_key_t			done[MMTP_OBJECT_CACHE_DONE_SIZE];
+	size_t						done_n;
+	size_t						done_next;
+
+	mmtp_object_cache_stats_t	stats;
+} mmtp_object_cache_t;
+
+void mmtp_object_cache_init(mmtp_object_cache_t* mmtp_object_cache, const mmtp_object_sink_t* sink);
+
+/**
+ * one data unit of object key, with the mpu_fragmentation_indicator (0 complete, 1 first, 2 middle, 3 last)
+ * and mpu_fragmentation_counter of its packet.
+ * returns 1 if the object was completed by it, 0 otherwise
+ */
+int mmtp_object_cache_push(mmtp_object_cache_t* mmtp_object_cache, const mmtp_object_key_t* key, uint8_t fragmentation_indicator,
+		uint8_t fragmentation_counter, const uint8_t* data, size_t length);
+
+//true if key was completed recently enough to still be remembered
+bool mmtp_object_cache_is_done(mmtp_object_cache_t* mmtp_object_cache, const mmtp_object_key_t* key);
+
+void mmtp_object_cache_stats_dump(mmtp_object_cache_t* mmtp_object_cache);
+
+//objects still being assembled are closed as incomplete
+void mmtp_object_cache_free(mmtp_object_cache_t* mmtp_object_cache);
+
+#endif /* MODULES_DEMUX_MMT_ATSC3_MMTP_OBJECT_CACHE_H_ */
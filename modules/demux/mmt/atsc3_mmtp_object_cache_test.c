@@ -0,0 +1,195 @@
+/*
+ *
+ * atsc3_mmtp_object_cache_test.c:  driver for non-timed item and generic object assembly
+ *
+ */
+
+#include "atsc3_mmtp_object_cache.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define __UNIT_TEST 1
+#ifdef __UNIT_TEST
+
+#define TEST_OBJECT_MAX 1024
+
+typedef struct test_sink {
+	int			begun;
+	int			completed;
+	int			incomplete;
+	bool		out_of_order;
+	uint8_t		object[TEST_OBJECT_MAX];
+	uint64_t	object_length;
+	mmtp_object_key_t last_key;
+} test_sink_t;
+
+void __test_object_begin(void* context, const mmtp_object_key_t* key) {
+	test_sink_t* test_sink = context;
+	test_sink->begun++;
+	test_sink->object_length = 0;
+	test_sink->last_key = *key;
+}
+
+void __test_object_data(void* context, const mmtp_object_key_t* key, uint64_t offset, const uint8_t* data, size_t length) {
+	test_sink_t* test_sink = context;
+	if(offset != test_sink->object_length || offset + length > TEST_OBJECT_MAX) {
+		test_sink->out_of_order = true;
+		return;
+	}
+	memcpy(&test_sink->object[offset], data, length);
+	test_sink->object_length += length;
+}
+
+void __test_object_end(void* context, const mmtp_object_key_t* key, uint64_t length, bool complete) {
+	test_sink_t* test_sink = context;
+	if(complete) {
+		test_sink->completed++;
+	} else {
+		test_sink->incomplete++;
+	}
+	if(length != test_sink->object_length) {
+		test_sink->out_of_order = true;
+	}
+}
+
+void __test_init(mmtp_object_cache_t* mmtp_object_cache, test_sink_t* test_sink) {
+	memset(test_sink, 0, sizeof(test_sink_t));
+	mmtp_object_sink_t sink = { test_sink, __test_object_begin, __test_object_data, __test_object_end };
+	mmtp_object_cache_init(mmtp_object_cache, &sink);
+}
+
+int test_mmtp_object_cache_fragmented();
+int test_mmtp_object_cache_gap();
+int test_mmtp_object_cache_repeat();
+int test_mmtp_object_cache_in_flight_limit();
+
+int main() {
+	int failed = 0;
+
+	failed |= test_mmtp_object_cache_fragmented();
+	failed |= test_mmtp_object_cache_gap();
+	failed |= test_mmtp_object_cache_repeat();
+	failed |= test_mmtp_object_cache_in_flight_limit();
+
+	return failed;
+}
+
+//first, middle and last fragments arrive at the sink in order, as they are pushed
+int test_mmtp_object_cache_fragmented() {
+	mmtp_object_cache_t mmtp_object_cache;
+	test_sink_t test_sink;
+	__test_init(&mmtp_object_cache, &test_sink);
+
+	mmtp_object_key_t key = { 0, 100, 7, 3 };
+	mmtp_object_cache_push(&mmtp_object_cache, &key, 1, 2, (const uint8_t*)"abc", 3);
+	if(test_sink.begun != 1 || test_sink.object_length != 3) {
+		_MMTP_OBJECT_CACHE_ERROR("test_mmtp_object_cache_fragmented: first fragment not streamed, length: %llu", (unsigned long long)test_sink.object_length);
+		return -1;
+	}
+	mmtp_object_cache_push(&mmtp_object_cache, &key, 2, 1, (const uint8_t*)"defg", 4);
+	int completed = mmtp_object_cache_push(&mmtp_object_cache, &key, 3, 0, (const uint8_t*)"h", 1);
+
+	if(completed != 1 || test_sink.completed != 1 || test_sink.out_of_order || test_sink.object_length != 8 ||
+			memcmp(test_sink.object, "abcdefgh", 8) || mmtp_object_cache.stats.objects_completed != 1) {
+		_MMTP_OBJECT_CACHE_ERROR("test_mmtp_object_cache_fragmented: completed: %d, length: %llu", test_sink.completed, (unsigned long long)test_sink.object_length);
+		return -1;
+	}
+
+	//a complete data unit is begun and ended at once
+	mmtp_object_key_t single = { 0, 100, 7, 4 };
+	if(mmtp_object_cache_push(&mmtp_object_cache, &single, 0, 0, (const uint8_t*)"xyz", 3) != 1 || test_sink.completed != 2 || test_sink.object_length != 3) {
+		_MMTP_OBJECT_CACHE_ERROR("test_mmtp_object_cache_fragmented: single data unit not delivered");
+		return -1;
+	}
+
+	mmtp_object_cache_free(&mmtp_object_cache);
+	return 0;
+}
+
+//a skipped fragmentation_counter closes the object as incomplete, the rest of it is orphaned
+int test_mmtp_object_cache_gap() {
+	mmtp_object_cache_t mmtp_object_cache;
+	test_sink_t test_sink;
+	__test_init(&mmtp_object_cache, &test_sink);
+
+	mmtp_object_key_t key = { 1, 200, 9, 0 };
+	mmtp_object_cache_push(&mmtp_object_cache, &key, 1, 3, (const uint8_t*)"ab", 2);
+	mmtp_object_cache_push(&mmtp_object_cache, &key, 2, 1, (const uint8_t*)"cd", 2);
+	mmtp_object_cache_push(&mmtp_object_cache, &key, 3, 0, (const uint8_t*)"ef", 2);
+
+	if(test_sink.incomplete != 1 || test_sink.completed || mmtp_object_cache.stats.fragments_orphaned != 1 ||
+			mmtp_object_cache_is_done(&mmtp_object_cache, &key)) {
+		_MMTP_OBJECT_CACHE_ERROR("test_mmtp_object_cache_gap: incomplete: %d, completed: %d, orphaned: %llu", test_sink.incomplete, test_sink.completed,
+				(unsigned long long)mmtp_object_cache.stats.fragments_orphaned);
+		return -1;
+	}
+
+	//the next carousel pass completes it
+	mmtp_object_cache_push(&mmtp_object_cache, &key, 1, 1, (const uint8_t*)"ab", 2);
+	mmtp_object_cache_push(&mmtp_object_cache, &key, 3, 0, (const uint8_t*)"cd", 2);
+	if(test_sink.completed != 1 || test_sink.object_length != 4 || !mmtp_object_cache_is_done(&mmtp_object_cache, &key)) {
+		_MMTP_OBJECT_CACHE_ERROR("test_mmtp_object_cache_gap: not completed on repeat");
+		return -1;
+	}
+
+	mmtp_object_cache_free(&mmtp_object_cache);
+	return 0;
+}
+
+//carousel repeats of a completed object are not delivered again
+int test_mmtp_object_cache_repeat() {
+	mmtp_object_cache_t mmtp_object_cache;
+	test_sink_t test_sink;
+	__test_init(&mmtp_object_cache, &test_sink);
+
+	mmtp_object_key_t key = { 0, 300, 1, 1 };
+	for(int pass = 0; pass < 3; pass++) {
+		mmtp_object_cache_push(&mmtp_object_cache, &key, 1, 1, (const uint8_t*)"ab", 2);
+		mmtp_object_cache_push(&mmtp_object_cache, &key, 3, 0, (const uint8_t*)"cd", 2);
+	}
+
+	if(test_sink.begun != 1 || test_sink.completed != 1 || mmtp_object_cache.stats.fragments_repeated != 4) {
+		_MMTP_OBJECT_CACHE_ERROR("test_mmtp_object_cache_repeat: begun: %d, repeated: %llu", test_sink.begun,
+				(unsigned long long)mmtp_object_cache.stats.fragments_repeated);
+		return -1;
+	}
+
+	mmtp_object_cache_free(&mmtp_object_cache);
+	return 0;
+}
+
+//past MMTP_OBJECT_CACHE_MAX_IN_FLIGHT open objects the least recently fed is given up on, free closes the rest
+int test_mmtp_object_cache_in_flight_limit() {
+	mmtp_object_cache_t mmtp_object_cache;
+	test_sink_t test_sink;
+	__test_init(&mmtp_object_cache, &test_sink);
+
+	for(uint32_t i = 0; i <= MMTP_OBJECT_CACHE_MAX_IN_FLIGHT; i++) {
+		mmtp_object_key_t key = { 0, 400, 1, i };
+		mmtp_object_cache_push(&mmtp_object_cache, &key, 1, 1, (const uint8_t*)"a", 1);
+	}
+	if(test_sink.incomplete != 1) {
+		_MMTP_OBJECT_CACHE_ERROR("test_mmtp_object_cache_in_flight_limit: incomplete: %d", test_sink.incomplete);
+		return -1;
+	}
+
+	mmtp_object_key_t first = { 0, 400, 1, 0 };
+	mmtp_object_cache_push(&mmtp_object_cache, &first, 3, 0, (const uint8_t*)"b", 1);
+	if(mmtp_object_cache.stats.fragments_orphaned != 1) {
+		_MMTP_OBJECT_CACHE_ERROR("test_mmtp_object_cache_in_flight_limit: evicted object still in flight");
+		return -1;
+	}
+
+	mmtp_object_cache_free(&mmtp_object_cache);
+	if(test_sink.incomplete != 1 + MMTP_OBJECT_CACHE_MAX_IN_FLIGHT) {
+		_MMTP_OBJECT_CACHE_ERROR("test_mmtp_object_cache_in_flight_limit: incomplete after free: %d", test_sink.incomplete);
+		return -1;
+	}
+	return 0;
+}
+
+#endif
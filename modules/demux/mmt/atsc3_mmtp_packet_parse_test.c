@@ -0,0 +1,136 @@
+/*
+ *
+ * atsc3_mmtp_packet_parse_test.c:  driver for in-place mmtp packet header, mpu header and data unit parsing
+ *
+ */
+
+#include "atsc3_mmtp_types.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define __UNIT_TEST 1
+#ifdef __UNIT_TEST
+
+//v=0, packet_id=0x0023, mpu mode, aggregated mpu metadata data units of 4 and 3 bytes, mpu_sequence_number=0x12ce
+static char* __get_test_mmtp_aggregated_mpu_metadata_packet()	{ return "00000023afb90000000000010000000100130100000012ce0004aabbccdd0003eeff00"; }
+
+//v=0, packet_id=0x0023, truncated data unit length
+static char* __get_test_mmtp_truncated_data_unit_packet()		{ return "00000023afb90000000000010000000100090100000012ce0040aabb"; }
+
+int test_mmtp_aggregated_mpu_metadata_packet(char* base64_payload);
+int test_mmtp_truncated_data_unit_packet(char* base64_payload);
+
+int main() {
+	int failed = 0;
+
+	failed |= test_mmtp_aggregated_mpu_metadata_packet(__get_test_mmtp_aggregated_mpu_metadata_packet());
+	failed |= test_mmtp_truncated_data_unit_packet(__get_test_mmtp_truncated_data_unit_packet());
+
+	return failed;
+}
+
+
+
+void __create_binary_payload(char *test_payload_base64, uint8_t **binary_payload, int * binary_payload_size) {
+	int test_payload_base64_length = strlen(test_payload_base64);
+	int test_payload_binary_size = test_payload_base64_length/2;
+
+	uint8_t *test_payload_binary = calloc(test_payload_binary_size, sizeof(uint8_t));
+
+	for (size_t count = 0; count < test_payload_binary_size; count++) {
+	        sscanf(test_payload_base64, "%2hhx", &test_payload_binary[count]);
+	        test_payload_base64 += 2;
+	}
+
+	*binary_payload = test_payload_binary;
+	*binary_payload_size = test_payload_binary_size;
+}
+
+int test_mmtp_aggregated_mpu_metadata_packet(char* base64_payload) {
+	uint8_t* binary_payload;
+	int binary_payload_size;
+
+	__create_binary_payload(base64_payload, &binary_payload, &binary_payload_size);
+
+	mmtp_payload_fragments_union_t* mmtp_packet = calloc(1, sizeof(mmtp_payload_fragments_union_t));
+	atsc3_cursor_t cursor;
+	atsc3_cursor_init(&cursor, binary_payload, binary_payload_size);
+
+	if(mmtp_packet_header_parse_from_cursor(mmtp_packet, &cursor) || mmtp_mpu_packet_header_parse_from_cursor(mmtp_packet, &cursor)) {
+		_MMTP_ERROR("test_mmtp_aggregated_mpu_metadata_packet: header parse failed");
+		return -1;
+	}
+
+	if(mmtp_packet->mmtp_packet_header.mmtp_packet_id != 0x23 || mmtp_packet->mmtp_mpu_type_packet_header.mpu_sequence_number != 0x12ce ||
+		!mmtp_packet->mmtp_mpu_type_packet_header.mpu_aggregation_flag) {
+		_MMTP_ERROR("test_mmtp_aggregated_mpu_metadata_packet: packet_id: %hu, mpu_sequence_number: %u, aggregation: %d",
+				mmtp_packet->mmtp_packet_header.mmtp_packet_id, mmtp_packet->mmtp_mpu_type_packet_header.mpu_sequence_number,
+				mmtp_packet->mmtp_mpu_type_packet_header.mpu_aggregation_flag);
+		return -1;
+	}
+
+	uint32_t expected_lengths[] = { 4, 3 };
+	int data_unit_count = 0;
+
+	while(atsc3_cursor_remaining(&cursor) > 0) {
+		uint8_t* data_unit_payload;
+		uint32_t data_unit_payload_length;
+
+		if(mmtp_mpu_data_unit_parse_from_cursor(mmtp_packet, &cursor, &data_unit_payload, &data_unit_payload_length)) {
+			_MMTP_ERROR("test_mmtp_aggregated_mpu_metadata_packet: data unit %d parse failed", data_unit_count);
+			return -1;
+		}
+
+		//views must point into the original buffer, not a copy
+		if(data_unit_count > 1 || data_unit_payload_length != expected_lengths[data_unit_count] ||
+			data_unit_payload < binary_payload || data_unit_payload + data_unit_payload_length > binary_payload + binary_payload_size) {
+			_MMTP_ERROR("test_mmtp_aggregated_mpu_metadata_packet: data unit %d, length: %u", data_unit_count, data_unit_payload_length);
+			return -1;
+		}
+		data_unit_count++;
+	}
+
+	_MMTP_INFO("test_mmtp_aggregated_mpu_metadata_packet: parsed %d data units", data_unit_count);
+
+	free(mmtp_packet);
+	free(binary_payload);
+
+	return data_unit_count == 2 ? 0 : -1;
+}
+
+int test_mmtp_truncated_data_unit_packet(char* base64_payload) {
+	uint8_t* binary_payload;
+	int binary_payload_size;
+
+	__create_binary_payload(base64_payload, &binary_payload, &binary_payload_size);
+
+	mmtp_payload_fragments_union_t* mmtp_packet = calloc(1, sizeof(mmtp_payload_fragments_union_t));
+	atsc3_cursor_t cursor;
+	atsc3_cursor_init(&cursor, binary_payload, binary_payload_size);
+
+	uint8_t* data_unit_payload = NULL;
+	uint32_t data_unit_payload_length = 0;
+
+	if(mmtp_packet_header_parse_from_cursor(mmtp_packet, &cursor) || mmtp_mpu_packet_header_parse_from_cursor(mmtp_packet, &cursor)) {
+		_MMTP_ERROR("test_mmtp_truncated_data_unit_packet: header parse failed");
+		return -1;
+	}
+
+	if(!mmtp_mpu_data_unit_parse_from_cursor(mmtp_packet, &cursor, &data_unit_payload, &data_unit_payload_length)) {
+		_MMTP_ERROR("test_mmtp_truncated_data_unit_packet: data unit length past end of packet was accepted, length: %u", data_unit_payload_length);
+		return -1;
+	}
+
+	_MMTP_INFO("test_mmtp_truncated_data_unit_packet: rejected truncated data unit");
+
+	free(mmtp_packet);
+	free(binary_payload);
+
+	return 0;
+}
+
+#endif
@@ -0,0 +1,241 @@
+/*
+ * atsc3_mmtp_reorder_window.c
+ *
+ *  Created on: Feb 9, 2019
+ *      Author: jjustman
+ */
+
+#include "atsc3_mmtp_reorder_window.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static mmtp_reorder_window_entry_t* __mmtp_reorder_window_entry(mmtp_reorder_window_t* mmtp_reorder_window, uint32_t packet_sequence_number) {
+	return &mmtp_reorder_window->entries[packet_sequence_number % mmtp_reorder_window->max_packets];
+}
+
+static void __mmtp_reorder_window_release_entry(mmtp_reorder_window_t* mmtp_reorder_window, mmtp_reorder_window_entry_t* entry,
+		mmtp_reorder_window_release_f release, void* context) {
+	void* item = entry->item;
+
+	entry->in_use = false;
+	entry->item = NULL;
+	mmtp_reorder_window->held_count--;
+	mmtp_reorder_window->stats.packets_reordered++;
+
+	release(context, item);
+}
+
+//release held packets while the next expected one is present
+static void __mmtp_reorder_window_drain(mmtp_reorder_window_t* mmtp_reorder_window, mmtp_reorder_window_release_f release, void* context) {
+	while(mmtp_reorder_window->held_count) {
+		mmtp_reorder_window_entry_t* entry = __mmtp_reorder_window_entry(mmtp_reorder_window, mmtp_reorder_window->next_packet_sequence_number);
+		if(!entry->in_use || entry->packet_sequence_number != mmtp_reorder_window->next_packet_sequence_number) {
+			return;
+		}
+
+		__mmtp_reorder_window_release_entry(mmtp_reorder_window, entry, release, context);
+		mmtp_reorder_window->next_packet_sequence_number++;
+	}
+}
+
+/**
+ * move the window up to packet_sequence_number, releasing held packets in order and counting
+ * everything missing in between as lost
+ */
+static void __mmtp_reorder_window_skip_to(mmtp_reorder_window_t* mmtp_reorder_window, uint32_t packet_sequence_number,
+		mmtp_reorder_window_release_f release, void* context) {
+	bool in_gap = false;
+
+	while(mmtp_reorder_window->next_packet_sequence_number != packet_sequence_number) {
+		if(!mmtp_reorder_window->held_count) {
+			//nothing left in the window, jump the rest in one go
+			mmtp_reorder_window->stats.packets_lost += (uint32_t)(packet_sequence_number - mmtp_reorder_window->next_packet_sequence_number);
+			if(!in_gap) {
+				mmtp_reorder_window->stats.gaps++;
+			}
+			mmtp_reorder_window->next_packet_sequence_number = packet_sequence_number;
+			return;
+		}
+
+		mmtp_reorder_window_entry_t* entry = __mmtp_reorder_window_entry(mmtp_reorder_window, mmtp_reorder_window->next_packet_sequence_number);
+		if(entry->in_use && entry->packet_sequence_number == mmtp_reorder_window->next_packet_sequence_number) {
+			__mmtp_reorder_window_release_entry(mmtp_reorder_window, entry, release, context);
+			in_gap = false;
+		} else {
+			mmtp_reorder_window->stats.packets_lost++;
+			if(!in_gap) {
+				mmtp_reorder_window->stats.gaps++;
+				in_gap = true;
+			}
+		}
+		mmtp_reorder_window->next_packet_sequence_number++;
+	}
+}
+
+//packet_sequence_number of the first held packet, only valid while held_count > 0
+static uint32_t __mmtp_reorder_window_first_held(mmtp_reorder_window_t* mmtp_reorder_window) {
+	for(uint32_t i=0; i < mmtp_reorder_window->max_packets; i++) {
+		uint32_t packet_sequence_number = mmtp_reorder_window->next_packet_sequence_number + i;
+		mmtp_reorder_window_entry_t* entry = __mmtp_reorder_window_entry(mmtp_reorder_window, packet_sequence_number);
+		if(entry->in_use && entry->packet_sequence_number == packet_sequence_number) {
+			return packet_sequence_number;
+		}
+	}
+	return mmtp_reorder_window->next_packet_sequence_number;
+}
+
+//the gap at the head of the window became visible when the earliest held packet arrived
+static int64_t __mmtp_reorder_window_oldest_arrival(mmtp_reorder_window_t* mmtp_reorder_window) {
+	int64_t oldest_arrival_us = INT64_MAX;
+	for(uint32_t i=0; i < mmtp_reorder_window->max_packets; i++) {
+		mmtp_reorder_window_entry_t* entry = &mmtp_reorder_window->entries[i];
+		if(entry->in_use && entry->arrival_us < oldest_arrival_us) {
+			oldest_arrival_us = entry->arrival_us;
+		}
+	}
+	return oldest_arrival_us;
+}
+
+int mmtp_reorder_window_init(mmtp_reorder_window_t* mmtp_reorder_window, uint32_t max_packets, int64_t max_hold_us) {
+	memset(mmtp_reorder_window, 0, sizeof(mmtp_reorder_window_t));
+
+	if(max_packets > MMTP_REORDER_WINDOW_MAX_PACKETS) {
+		_MMTP_REORDER_WINDOW_ERROR("mmtp_reorder_window_init: max_packets: %u over limit: %u, clamping", max_packets, MMTP_REORDER_WINDOW_MAX_PACKETS);
+		max_packets = MMTP_REORDER_WINDOW_MAX_PACKETS;
+	}
+
+	//a power of two keeps packet_sequence_number % max_packets consistent across the 32 bit wrap
+	if(max_packets) {
+		uint32_t ring_size = 1;
+		while(ring_size < max_packets) {
+			ring_size <<= 1;
+		}
+		max_packets = ring_size;
+
+		mmtp_reorder_window->entries = calloc(max_packets, sizeof(mmtp_reorder_window_entry_t));
+		if(!mmtp_reorder_window->entries) {
+			return -1;
+		}
+	}
+
+	mmtp_reorder_window->max_packets = max_packets;
+	mmtp_reorder_window->max_hold_us = max_hold_us;
+
+	return 0;
+}
+
+int mmtp_reorder_window_push(mmtp_reorder_window_t* mmtp_reorder_window, uint32_t packet_sequence_number, int64_t now_us, void* item,
+		mmtp_reorder_window_release_f release, void* context) {
+
+	if(!mmtp_reorder_window->max_packets) {
+		mmtp_reorder_window->stats.packets_in_order++;
+		release(context, item);
+		return 0;
+	}
+
+	if(!mmtp_reorder_window->has_next_packet_sequence_number) {
+		mmtp_reorder_window->has_next_packet_sequence_number = true;
+		mmtp_reorder_window->next_packet_sequence_number = packet_sequence_number;
+	}
+
+	int32_t distance = (int32_t)(packet_sequence_number - mmtp_reorder_window->next_packet_sequence_number);
+
+	//too far behind to be reordering, the sender restarted its sequence
+	if(distance < -(int32_t)mmtp_reorder_window->max_packets) {
+		_MMTP_REORDER_WINDOW_DEBUG("mmtp_reorder_window_push: packet_sequence_number: %u, expecting: %u, restarting",
+				packet_sequence_number, mmtp_reorder_window->next_packet_sequence_number);
+		mmtp_reorder_window_reset(mmtp_reorder_window, release, context);
+		mmtp_reorder_window->has_next_packet_sequence_number = true;
+		mmtp_reorder_window->next_packet_sequence_number = packet_sequence_number;
+		distance = 0;
+	}
+
+	if(distance < 0) {
+		mmtp_reorder_window->stats.packets_late++;
+		return -1;
+	}
+
+	//fast path, nothing outstanding
+	if(distance == 0 && !mmtp_reorder_window->held_count) {
+		mmtp_reorder_window->next_packet_sequence_number++;
+		mmtp_reorder_window->stats.packets_in_order++;
+		release(context, item);
+		return 0;
+	}
+
+	//too far ahead for the ring, give up on the oldest gap(s) to make room
+	if((uint32_t)distance >= mmtp_reorder_window->max_packets) {
+		__mmtp_reorder_window_skip_to(mmtp_reorder_window, packet_sequence_number - mmtp_reorder_window->max_packets + 1, release, context);
+		__mmtp_reorder_window_drain(mmtp_reorder_window, release, context);
+
+		if(mmtp_reorder_window->next_packet_sequence_number == packet_sequence_number && !mmtp_reorder_window->held_count) {
+			mmtp_reorder_window->next_packet_sequence_number++;
+			mmtp_reorder_window->stats.packets_in_order++;
+			release(context, item);
+			return 0;
+		}
+	}
+
+	mmtp_reorder_window_entry_t* entry = __mmtp_reorder_window_entry(mmtp_reorder_window, packet_sequence_number);
+	if(entry->in_use) {
+		mmtp_reorder_window->stats.packets_duplicate++;
+		return -1;
+	}
+
+	entry->in_use = true;
+	entry->packet_sequence_number = packet_sequence_number;
+	entry->arrival_us = now_us;
+	entry->item = item;
+	mmtp_reorder_window->held_count++;
+
+	_MMTP_REORDER_WINDOW_DEBUG("mmtp_reorder_window_push: holding packet_sequence_number: %u, expecting: %u, held: %u",
+			packet_sequence_number, mmtp_reorder_window->next_packet_sequence_number, mmtp_reorder_window->held_count);
+
+	__mmtp_reorder_window_drain(mmtp_reorder_window, release, context);
+	mmtp_reorder_window_expire(mmtp_reorder_window, now_us, release, context);
+
+	return 0;
+}
+
+void mmtp_reorder_window_expire(mmtp_reorder_window_t* mmtp_reorder_window, int64_t now_us, mmtp_reorder_window_release_f release, void* context) {
+	while(mmtp_reorder_window->held_count && now_us - __mmtp_reorder_window_oldest_arrival(mmtp_reorder_window) >= mmtp_reorder_window->max_hold_us) {
+		__mmtp_reorder_window_skip_to(mmtp_reorder_window, __mmtp_reorder_window_first_held(mmtp_reorder_window), release, context);
+		__mmtp_reorder_window_drain(mmtp_reorder_window, release, context);
+	}
+}
+
+void mmtp_reorder_window_flush(mmtp_reorder_window_t* mmtp_reorder_window, mmtp_reorder_window_release_f release, void* context) {
+	while(mmtp_reorder_window->held_count) {
+		__mmtp_reorder_window_skip_to(mmtp_reorder_window, __mmtp_reorder_window_first_held(mmtp_reorder_window), release, context);
+		__mmtp_reorder_window_drain(mmtp_reorder_window, release, context);
+	}
+}
+
+void mmtp_reorder_window_reset(mmtp_reorder_window_t* mmtp_reorder_window, mmtp_reorder_window_release_f release, void* context) {
+	mmtp_reorder_window_flush(mmtp_reorder_window, release, context);
+	if(mmtp_reorder_window->has_next_packet_sequence_number) {
+		mmtp_reorder_window->stats.resyncs++;
+	}
+	mmtp_reorder_window->has_next_packet_sequence_number = false;
+}
+
+void mmtp_reorder_window_stats_dump(mmtp_reorder_window_t* mmtp_reorder_window, uint16_t mmtp_packet_id) {
+	_MMTP_REORDER_WINDOW_INFO("mmtp_reorder_window: packet_id: %hu, in order: %llu, reordered: %llu, late: %llu, duplicate: %llu, lost: %llu in %llu gaps, resyncs: %llu",
+			mmtp_packet_id,
+			(unsigned long long)mmtp_reorder_window->stats.packets_in_order,
+			(unsigned long long)mmtp_reorder_window->stats.packets_reordered,
+			(unsigned long long)mmtp_reorder_window->stats.packets_late,
+			(unsigned long long)mmtp_reorder_window->stats.packets_duplicate,
+			(unsigned long long)mmtp_reorder_window->stats.packets_lost,
+			(unsigned long long)mmtp_reorder_window->stats.gaps,
+			(unsigned long long)mmtp_reorder_window->stats.resyncs);
+}
+
+void mmtp_reorder_window_free(mmtp_reorder_window_t* mmtp_reorder_window) {
+	if(mmtp_reorder_window->held_count) {
+		_MMTP_REORDER_WINDOW_ERROR("mmtp_reorder_window_free: %u packets still held", mmtp_reorder_window->held_count);
+	}
+	free(mmtp_reorder_window->entries);
+	memset(mmtp_reorder_window, 0, sizeof(mmtp_reorder_window_t));
+}
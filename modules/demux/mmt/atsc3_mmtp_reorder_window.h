@@ -0,0 +1,98 @@
+/*
+ * atsc3_mmtp_reorder_window.h
+ *
+ *  Created on: Feb 9, 2019
+ *      Author: jjustman
+ *
+ * per packet_id reorder window keyed on packet_sequence_number.
+ *
+ * packets arriving in sequence are released straight through without being stored. anything ahead of
+ * the next expected packet_sequence_number is held in a ring of max_packets entries until the gap is
+ * filled, the ring would overflow, or the gap has been open for longer than max_hold_us; then the
+ * missing packets are given up on and the held ones are released in order.
+ *
+ * packets behind the window (already released or given up on) and duplicates are refused, the caller
+ * still owns them. a packet more than max_packets behind is taken as the sender restarting its
+ * packet_sequence_number instead: what is held is flushed and the window starts over from that packet.
+ *
+ * not thread-safe, all calls for a window must come from the same thread.
+ */
+
+#ifndef MODULES_DEMUX_MMT_ATSC3_MMTP_REORDER_WINDOW_H_
+#define MODULES_DEMUX_MMT_ATSC3_MMTP_REORDER_WINDOW_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define _MMTP_REORDER_WINDOW_PRINTLN(...) printf(__VA_ARGS__);printf("\n")
+#define _MMTP_REORDER_WINDOW_ERROR(...)   printf("%s:%d:ERROR:",__FILE__,__LINE__);_MMTP_REORDER_WINDOW_PRINTLN(__VA_ARGS__);
+#define _MMTP_REORDER_WINDOW_INFO(...)    printf("%s:%d:INFO :",__FILE__,__LINE__);_MMTP_REORDER_WINDOW_PRINTLN(__VA_ARGS__);
+#define _MMTP_REORDER_WINDOW_DEBUG(...)
+
+#define MMTP_REORDER_WINDOW_DEFAULT_MAX_PACKETS	64
+#define MMTP_REORDER_WINDOW_DEFAULT_MAX_HOLD_US	50000
+
+//upper bound on max_packets, the ring is allocated up front
+#define MMTP_REORDER_WINDOW_MAX_PACKETS			4096
+
+//hands an item back to the caller in packet_sequence_number order
+typedef void (*mmtp_reorder_window_release_f)(void* context, void* item);
+
+typedef struct mmtp_reorder_window_entry {
+	bool		in_use;
+	uint32_t	packet_sequence_number;
+	int64_t		arrival_us;
+	void*		item;
+} mmtp_reorder_window_entry_t;
+
+typedef struct mmtp_reorder_window_stats {
+	uint64_t	packets_in_order;		//released without being held
+	uint64_t	packets_reordered;		//held, then released in order
+	uint64_t	packets_late;			//refused, already released or given up on
+	uint64_t	packets_duplicate;		//refused, already held
+	uint64_t	packets_lost;			//never arrived in time
+	uint64_t	gaps;					//runs of lost packets
+	uint64_t	resyncs;				//restarts on a backward jump or a reset
+} mmtp_reorder_window_stats_t;
+
+typedef struct mmtp_reorder_window {
+	uint32_t						max_packets;	//rounded up to a power of two, 0 disables reordering
+	int64_t							max_hold_us;
+
+	mmtp_reorder_window_entry_t*	entries;		//ring indexed by packet_sequence_number % max_packets
+	uint32_t						held_count;
+
+	bool							has_next_packet_sequence_number;
+	uint32_t						next_packet_sequence_number;
+
+	mmtp_reorder_window_stats_t		stats;
+} mmtp_reorder_window_t;
+
+int mmtp_reorder_window_init(mmtp_reorder_window_t* mmtp_reorder_window, uint32_t max_packets, int64_t max_hold_us);
+
+/**
+ * add item, releasing it and any held items that are now in order.
+ * now_us is any monotonic clock, used to age held packets.
+ *
+ * returns 0 if the window took the item, -1 if it is late or a duplicate and still belongs to the caller
+ */
+int mmtp_reorder_window_push(mmtp_reorder_window_t* mmtp_reorder_window, uint32_t packet_sequence_number, int64_t now_us, void* item,
+		mmtp_reorder_window_release_f release, void* context);
+
+//give up on gaps that have been open longer than max_hold_us
+void mmtp_reorder_window_expire(mmtp_reorder_window_t* mmtp_reorder_window, int64_t now_us, mmtp_reorder_window_release_f release, void* context);
+
+//release everything held in order, skipping the gaps
+void mmtp_reorder_window_flush(mmtp_reorder_window_t* mmtp_reorder_window, mmtp_reorder_window_release_f release, void* context);
+
+//flush, then take the next packet pushed as the start of the sequence, e.g. on a sender clock discontinuity
+void mmtp_reorder_window_reset(mmtp_reorder_window_t* mmtp_reorder_window, mmtp_reorder_window_release_f release, void* context);
+
+void mmtp_reorder_window_stats_dump(mmtp_reorder_window_t* mmtp_reorder_window, uint16_t mmtp_packet_id);
+
+//flush first, anything still held is not released
+void mmtp_reorder_window_free(mmtp_reorder_window_t* mmtp_reorder_window);
+
+#endif /* MODULES_DEMUX_MMT_ATSC3_MMTP_REORDER_WINDOW_H_ */
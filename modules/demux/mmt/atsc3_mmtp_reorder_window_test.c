@@ -0,0 +1,255 @@
+/*
+ *
+ * atsc3_mmtp_reorder_window_test.c:  driver for packet_sequence_number reordering, gap and duplicate handling
+ *
+ */
+
+#include "atsc3_mmtp_reorder_window.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define __UNIT_TEST 1
+#ifdef __UNIT_TEST
+
+#define TEST_MAX_PACKETS	8
+#define TEST_MAX_HOLD_US	10000
+#define TEST_MAX_RELEASED	64
+
+typedef struct test_released {
+	int			count;
+	uintptr_t	items[TEST_MAX_RELEASED];
+} test_released_t;
+
+void __test_release(void* context, void* item) {
+	test_released_t* released = context;
+	if(released->count < TEST_MAX_RELEASED) {
+		released->items[released->count] = (uintptr_t)item;
+	}
+	released->count++;
+}
+
+//items are their own packet_sequence_number
+int __test_push(mmtp_reorder_window_t* mmtp_reorder_window, uint32_t packet_sequence_number, int64_t now_us, test_released_t* released) {
+	return mmtp_reorder_window_push(mmtp_reorder_window, packet_sequence_number, now_us, (void*)(uintptr_t)packet_sequence_number, __test_release, released);
+}
+
+int __test_expect(const char* test, test_released_t* released, const uintptr_t* expected, int expected_count) {
+	if(released->count != expected_count) {
+		_MMTP_REORDER_WINDOW_ERROR("%s: released: %d, expected: %d", test, released->count, expected_count);
+		return -1;
+	}
+	for(int i=0; i < expected_count; i++) {
+		if(released->items[i] != expected[i]) {
+			_MMTP_REORDER_WINDOW_ERROR("%s: released[%d]: %lu, expected: %lu", test, i, (unsigned long)released->items[i], (unsigned long)expected[i]);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int test_mmtp_reorder_window_reorder();
+int test_mmtp_reorder_window_gap_expires();
+int test_mmtp_reorder_window_overflow();
+int test_mmtp_reorder_window_late_and_duplicate();
+int test_mmtp_reorder_window_wraparound();
+int test_mmtp_reorder_window_restart();
+
+int main() {
+	int failed = 0;
+
+	failed |= test_mmtp_reorder_window_reorder();
+	failed |= test_mmtp_reorder_window_gap_expires();
+	failed |= test_mmtp_reorder_window_overflow();
+	failed |= test_mmtp_reorder_window_late_and_duplicate();
+	failed |= test_mmtp_reorder_window_wraparound();
+	failed |= test_mmtp_reorder_window_restart();
+
+	return failed;
+}
+
+//a swapped pair is put back in order, in-order traffic is never held
+int test_mmtp_reorder_window_reorder() {
+	mmtp_reorder_window_t mmtp_reorder_window;
+	mmtp_reorder_window_init(&mmtp_reorder_window, TEST_MAX_PACKETS, TEST_MAX_HOLD_US);
+	test_released_t released;
+	memset(&released, 0, sizeof(test_released_t));
+
+	__test_push(&mmtp_reorder_window, 10, 0, &released);
+	__test_push(&mmtp_reorder_window, 12, 0, &released);
+	__test_push(&mmtp_reorder_window, 13, 0, &released);
+	if(released.count != 1 || mmtp_reorder_window.held_count != 2) {
+		_MMTP_REORDER_WINDOW_ERROR("test_mmtp_reorder_window_reorder: released: %d, held: %u", released.count, mmtp_reorder_window.held_count);
+		return -1;
+	}
+	__test_push(&mmtp_reorder_window, 11, 0, &released);
+	__test_push(&mmtp_reorder_window, 14, 0, &released);
+
+	const uintptr_t expected[] = { 10, 11, 12, 13, 14 };
+	if(__test_expect("test_mmtp_reorder_window_reorder", &released, expected, 5) ||
+		mmtp_reorder_window.stats.packets_in_order != 2 || mmtp_reorder_window.stats.packets_reordered != 3 || mmtp_reorder_window.stats.packets_lost) {
+		return -1;
+	}
+
+	mmtp_reorder_window_free(&mmtp_reorder_window);
+	return 0;
+}
+
+//a missing packet is given up on after max_hold_us, the held packets behind it are released
+int test_mmtp_reorder_window_gap_expires() {
+	mmtp_reorder_window_t mmtp_reorder_window;
+	mmtp_reorder_window_init(&mmtp_reorder_window, TEST_MAX_PACKETS, TEST_MAX_HOLD_US);
+	test_released_t released;
+	memset(&released, 0, sizeof(test_released_t));
+
+	__test_push(&mmtp_reorder_window, 0, 0, &released);
+	__test_push(&mmtp_reorder_window, 3, 1000, &released);
+	__test_push(&mmtp_reorder_window, 4, 2000, &released);
+	mmtp_reorder_window_expire(&mmtp_reorder_window, 1000 + TEST_MAX_HOLD_US - 1, __test_release, &released);
+	if(released.count != 1) {
+		_MMTP_REORDER_WINDOW_ERROR("test_mmtp_reorder_window_gap_expires: released: %d before max_hold_us", released.count);
+		return -1;
+	}
+
+	mmtp_reorder_window_expire(&mmtp_reorder_window, 1000 + TEST_MAX_HOLD_US, __test_release, &released);
+
+	//1 and 2 turning up now are too late
+	if(__test_push(&mmtp_reorder_window, 2, 1000 + TEST_MAX_HOLD_US, &released) != -1) {
+		_MMTP_REORDER_WINDOW_ERROR("test_mmtp_reorder_window_gap_expires: late packet accepted");
+		return -1;
+	}
+	__test_push(&mmtp_reorder_window, 5, 1000 + TEST_MAX_HOLD_US, &released);
+
+	const uintptr_t expected[] = { 0, 3, 4, 5 };
+	if(__test_expect("test_mmtp_reorder_window_gap_expires", &released, expected, 4) ||
+		mmtp_reorder_window.stats.packets_lost != 2 || mmtp_reorder_window.stats.gaps != 1 || mmtp_reorder_window.stats.packets_late != 1) {
+		_MMTP_REORDER_WINDOW_ERROR("test_mmtp_reorder_window_gap_expires: lost: %llu, gaps: %llu",
+				(unsigned long long)mmtp_reorder_window.stats.packets_lost, (unsigned long long)mmtp_reorder_window.stats.gaps);
+		return -1;
+	}
+
+	mmtp_reorder_window_free(&mmtp_reorder_window);
+	return 0;
+}
+
+//a packet too far ahead for the ring pushes the oldest gap out
+int test_mmtp_reorder_window_overflow() {
+	mmtp_reorder_window_t mmtp_reorder_window;
+	mmtp_reorder_window_init(&mmtp_reorder_window, TEST_MAX_PACKETS, TEST_MAX_HOLD_US);
+	test_released_t released;
+	memset(&released, 0, sizeof(test_released_t));
+
+	__test_push(&mmtp_reorder_window, 0, 0, &released);
+	__test_push(&mmtp_reorder_window, 2, 0, &released);
+	__test_push(&mmtp_reorder_window, 4, 0, &released);
+	//9 needs next >= 2
+	__test_push(&mmtp_reorder_window, 9, 0, &released);
+
+	const uintptr_t expected_overflow[] = { 0, 2 };
+	if(__test_expect("test_mmtp_reorder_window_overflow", &released, expected_overflow, 2) || mmtp_reorder_window.next_packet_sequence_number != 3) {
+		return -1;
+	}
+
+	//a jump far ahead (e.g. a sender restart) releases everything held and waits just behind it
+	__test_push(&mmtp_reorder_window, 100000, 0, &released);
+	const uintptr_t expected_resync[] = { 0, 2, 4, 9 };
+	if(__test_expect("test_mmtp_reorder_window_overflow", &released, expected_resync, 4) ||
+		mmtp_reorder_window.held_count != 1 || mmtp_reorder_window.next_packet_sequence_number != 100000 - TEST_MAX_PACKETS + 1) {
+		return -1;
+	}
+
+	mmtp_reorder_window_flush(&mmtp_reorder_window, __test_release, &released);
+	mmtp_reorder_window_free(&mmtp_reorder_window);
+	return 0;
+}
+
+int test_mmtp_reorder_window_late_and_duplicate() {
+	mmtp_reorder_window_t mmtp_reorder_window;
+	mmtp_reorder_window_init(&mmtp_reorder_window, TEST_MAX_PACKETS, TEST_MAX_HOLD_US);
+	test_released_t released;
+	memset(&released, 0, sizeof(test_released_t));
+
+	__test_push(&mmtp_reorder_window, 50, 0, &released);
+	__test_push(&mmtp_reorder_window, 52, 0, &released);
+
+	if(__test_push(&mmtp_reorder_window, 52, 0, &released) != -1 || __test_push(&mmtp_reorder_window, 50, 0, &released) != -1) {
+		_MMTP_REORDER_WINDOW_ERROR("test_mmtp_reorder_window_late_and_duplicate: duplicate accepted");
+		return -1;
+	}
+
+	mmtp_reorder_window_flush(&mmtp_reorder_window, __test_release, &released);
+
+	const uintptr_t expected[] = { 50, 52 };
+	if(__test_expect("test_mmtp_reorder_window_late_and_duplicate", &released, expected, 2) ||
+		mmtp_reorder_window.stats.packets_duplicate != 1 || mmtp_reorder_window.stats.packets_late != 1 || mmtp_reorder_window.stats.packets_lost != 1) {
+		return -1;
+	}
+
+	mmtp_reorder_window_free(&mmtp_reorder_window);
+	return 0;
+}
+
+//packet_sequence_number is 32 bits and wraps
+int test_mmtp_reorder_window_wraparound() {
+	mmtp_reorder_window_t mmtp_reorder_window;
+	mmtp_reorder_window_init(&mmtp_reorder_window, TEST_MAX_PACKETS, TEST_MAX_HOLD_US);
+	test_released_t released;
+	memset(&released, 0, sizeof(test_released_t));
+
+	__test_push(&mmtp_reorder_window, 0xFFFFFFFE, 0, &released);
+	__test_push(&mmtp_reorder_window, 0x00000000, 0, &released);
+	__test_push(&mmtp_reorder_window, 0xFFFFFFFF, 0, &released);
+	__test_push(&mmtp_reorder_window, 0x00000001, 0, &released);
+
+	const uintptr_t expected[] = { 0xFFFFFFFE, 0xFFFFFFFF, 0x00000000, 0x00000001 };
+	if(__test_expect("test_mmtp_reorder_window_wraparound", &released, expected, 4)) {
+		return -1;
+	}
+
+	_MMTP_REORDER_WINDOW_INFO("test_mmtp_reorder_window_wraparound: released: %d in order", released.count);
+
+	mmtp_reorder_window_free(&mmtp_reorder_window);
+	return 0;
+}
+
+//a jump back past the window is a sender restart, a reset starts over from whatever comes next
+int test_mmtp_reorder_window_restart() {
+	mmtp_reorder_window_t mmtp_reorder_window;
+	mmtp_reorder_window_init(&mmtp_reorder_window, TEST_MAX_PACKETS, TEST_MAX_HOLD_US);
+	test_released_t released;
+	memset(&released, 0, sizeof(test_released_t));
+
+	__test_push(&mmtp_reorder_window, 1000, 0, &released);
+	__test_push(&mmtp_reorder_window, 1002, 0, &released);
+
+	//just behind the window is still late
+	if(__test_push(&mmtp_reorder_window, 1001 - TEST_MAX_PACKETS, 0, &released) != -1) {
+		_MMTP_REORDER_WINDOW_ERROR("test_mmtp_reorder_window_restart: late packet accepted");
+		return -1;
+	}
+
+	//1002 is flushed, the window restarts at 5 and reorders from there
+	__test_push(&mmtp_reorder_window, 5, 0, &released);
+	__test_push(&mmtp_reorder_window, 7, 0, &released);
+	__test_push(&mmtp_reorder_window, 6, 0, &released);
+
+	mmtp_reorder_window_reset(&mmtp_reorder_window, __test_release, &released);
+	__test_push(&mmtp_reorder_window, 900, 0, &released);
+	__test_push(&mmtp_reorder_window, 901, 0, &released);
+
+	const uintptr_t expected[] = { 1000, 1002, 5, 6, 7, 900, 901 };
+	if(__test_expect("test_mmtp_reorder_window_restart", &released, expected, 7) ||
+		mmtp_reorder_window.stats.resyncs != 2 || mmtp_reorder_window.stats.packets_late != 1 || mmtp_reorder_window.held_count) {
+		_MMTP_REORDER_WINDOW_ERROR("test_mmtp_reorder_window_restart: resyncs: %llu, late: %llu",
+				(unsigned long long)mmtp_reorder_window.stats.resyncs, (unsigned long long)mmtp_reorder_window.stats.packets_late);
+		return -1;
+	}
+
+	mmtp_reorder_window_free(&mmtp_reorder_window);
+	return 0;
+}
+
+#endif
@@ -9,6 +9,7 @@
 
 #include <assert.h>
 #include <limits.h>
+#include <string.h>
 
 
 
@@ -17,125 +18,346 @@ void mmtp_sub_flow_vector_init(mmtp_sub_flow_vector_t *mmtp_sub_flow_vector) {
 	__PRINTF_DEBUG("%d:mmtp_sub_flow_vector_init: %p\n", __LINE__, mmtp_sub_flow_vector);
 
 	atsc3_vector_init(mmtp_sub_flow_vector);
+	mmtp_sub_flow_vector->packet_id_index = NULL;
+	mmtp_sub_flow_vector->packet_id_index_capacity = 0;
+
+	memset(&mmtp_sub_flow_vector->fragment_store, 0, sizeof(mmtp_fragment_store_t));
+	mmtp_sub_flow_vector->fragment_store.max_bytes = MMTP_FRAGMENT_STORE_DEFAULT_MAX_BYTES;
+	atsc3_slab_pool_init(&mmtp_sub_flow_vector->fragment_store.packet_pool, "mmtp_packet", sizeof(mmtp_payload_fragments_union_t), MMTP_FRAGMENT_STORE_PACKETS_PER_SLAB);
 	__PRINTF_DEBUG("%d:mmtp_sub_flow_vector_init: %p\n", __LINE__, mmtp_sub_flow_vector);
 }
+
+static void mmtp_fragment_store_packet_release(mmtp_fragment_store_t* fragment_store, mmtp_payload_fragments_union_t* mmtp_packet) {
+	if(mmtp_packet->mmtp_packet_header.mmtp_payload_type == 0x00 && mmtp_packet->mmtp_mpu_type_packet_header.mpu_data_unit_payload && fragment_store->payload_release) {
+		fragment_store->payload_release(mmtp_packet->mmtp_mpu_type_packet_header.mpu_data_unit_payload);
+	}
+	atsc3_slab_pool_free(&fragment_store->packet_pool, mmtp_packet);
+}
+
+mmtp_payload_fragments_union_t* mmtp_fragment_store_packet_alloc(mmtp_sub_flow_vector_t *mmtp_sub_flow_vector) {
+	return atsc3_slab_pool_alloc(&mmtp_sub_flow_vector->fragment_store.packet_pool);
+}
+
+//packets not (yet) handed to the store, the payload is left to the caller
+void mmtp_fragment_store_packet_free(mmtp_sub_flow_vector_t *mmtp_sub_flow_vector, mmtp_payload_fragments_union_t* mmtp_packet) {
+	atsc3_slab_pool_free(&mmtp_sub_flow_vector->fragment_store.packet_pool, mmtp_packet);
+}
+
 /**
+ * release every fragment held by this mpu and return the slot to MPU_STATE_FREE
+ */
+static void mpu_data_unit_payload_fragments_recycle(mmtp_fragment_store_t* fragment_store, mpu_data_unit_payload_fragments_t* entry) {
+	if(entry->mpu_state == MPU_STATE_FREE) {
+		return;
+	}
+
+	size_t fragment_count = entry->timed_fragments_vector.size + entry->nontimed_fragments_vector.size;
+
+	if(entry->mpu_state != MPU_STATE_EMITTED) {
+		fragment_store->stats.mpus_evicted++;
+		fragment_store->stats.fragments_evicted += fragment_count;
+		fragment_store->stats.bytes_evicted += entry->mpu_bytes;
+	}
+	fragment_store->stats.mpus_recycled++;
+
+	for(size_t i=0; i < entry->timed_fragments_vector.size; i++) {
+		mmtp_fragment_store_packet_release(fragment_store, entry->timed_fragments_vector.data[i]);
+	}
+	for(size_t i=0; i < entry->nontimed_fragments_vector.size; i++) {
+		mmtp_fragment_store_packet_release(fragment_store, entry->nontimed_fragments_vector.data[i]);
+	}
+
+	//keep the vector allocations for the next mpu in this slot
+	entry->timed_fragments_vector.size = 0;
+	entry->nontimed_fragments_vector.size = 0;
+
+	fragment_store->bytes_in_use -= entry->mpu_bytes;
+	entry->mpu_bytes = 0;
+	entry->mpu_state = MPU_STATE_FREE;
+}
 
-static struct vlc_player_program *
-vlc_player_program_vector_FindById(vlc_player_program_vector *vec, int id,
-                                   size_t *idx)
-{
-    for (size_t i = 0; i < vec->size; ++i)
-    {
-        struct vlc_player_program *prgm = vec->data[i];
-        if (prgm->group_id == id)
-        {
-            if (idx)
-                *idx = i;
-            return prgm;
-        }
-    }
-    return NULL;
+static void mpu_data_unit_payload_fragments_vector_recycle_all(mmtp_fragment_store_t* fragment_store, mpu_data_unit_payload_fragments_vector_t *vec) {
+	for(int i=0; i < MPU_IN_FLIGHT_RING_SIZE; i++) {
+		mpu_data_unit_payload_fragments_recycle(fragment_store, &vec->slots[i]);
+	}
 }
-**/
 
+static void mmtp_sub_flow_free(mmtp_sub_flow_t* mmtp_sub_flow) {
+	mmtp_fragment_store_t* fragment_store = &mmtp_sub_flow->mmtp_sub_flow_vector->fragment_store;
 
+	if(mmtp_sub_flow->mpu_fragments) {
+		mpu_data_unit_payload_fragments_vector_recycle_all(fragment_store, &mmtp_sub_flow->mpu_fragments->mpu_metadata_fragments_vector);
+		mpu_data_unit_payload_fragments_vector_recycle_all(fragment_store, &mmtp_sub_flow->mpu_fragments->mpu_movie_fragment_metadata_vector);
+		mpu_data_unit_payload_fragments_vector_recycle_all(fragment_store, &mmtp_sub_flow->mpu_fragments->media_fragment_unit_vector);
 
-mpu_data_unit_payload_fragments_t* mpu_data_unit_payload_fragments_find_mpu_sequence_number(mpu_data_unit_payload_fragments_vector_t *vec, uint32_t mpu_sequence_number) {
-	for (size_t i = 0; i < vec->size; ++i) {
-		mpu_data_unit_payload_fragments_t *mpu_fragments = vec->data[i];
+		mpu_data_unit_payload_fragments_vector_free(&mmtp_sub_flow->mpu_fragments->mpu_metadata_fragments_vector);
+		mpu_data_unit_payload_fragments_vector_free(&mmtp_sub_flow->mpu_fragments->mpu_movie_fragment_metadata_vector);
+		mpu_data_unit_payload_fragments_vector_free(&mmtp_sub_flow->mpu_fragments->media_fragment_unit_vector);
+		free(mmtp_sub_flow->mpu_fragments);
+	}
+
+	atsc3_vector_destroy(&mmtp_sub_flow->mmtp_generic_object_fragments_vector);
+	atsc3_vector_destroy(&mmtp_sub_flow->mmtp_signalling_message_fragements_vector);
+	atsc3_vector_destroy(&mmtp_sub_flow->mmtp_repair_symbol_vector);
+	free(mmtp_sub_flow);
+}
+
+void mmtp_sub_flow_vector_free(mmtp_sub_flow_vector_t *mmtp_sub_flow_vector) {
+	for(size_t i=0; i < mmtp_sub_flow_vector->size; i++) {
+		mmtp_sub_flow_free(mmtp_sub_flow_vector->data[i]);
+	}
+	atsc3_vector_destroy(mmtp_sub_flow_vector);
+	atsc3_vector_init(mmtp_sub_flow_vector);
+
+	free(mmtp_sub_flow_vector->packet_id_index);
+	mmtp_sub_flow_vector->packet_id_index = NULL;
+	mmtp_sub_flow_vector->packet_id_index_capacity = 0;
 
-		if (mpu_fragments->mpu_sequence_number == mpu_sequence_number) {
-			return vec->data[i];
+	atsc3_slab_pool_destroy(&mmtp_sub_flow_vector->fragment_store.packet_pool);
+}
+
+void mmtp_fragment_store_configure(mmtp_sub_flow_vector_t *mmtp_sub_flow_vector, size_t max_bytes, mmtp_payload_release_f payload_release) {
+	mmtp_sub_flow_vector->fragment_store.max_bytes = max_bytes;
+	mmtp_sub_flow_vector->fragment_store.payload_release = payload_release;
+}
+
+/**
+ * drop-oldest: recycle the least recently created mpus (emitted ones first) across all sub_flows
+ * until we are back under max_bytes, never touching the mpu currently being appended to
+ */
+static void mmtp_fragment_store_enforce_max_bytes(mmtp_sub_flow_vector_t *vec, mpu_data_unit_payload_fragments_t* in_progress) {
+	mmtp_fragment_store_t* fragment_store = &vec->fragment_store;
+
+	while(fragment_store->max_bytes && fragment_store->bytes_in_use > fragment_store->max_bytes) {
+		mpu_data_unit_payload_fragments_t* oldest = NULL;
+
+		for(size_t i=0; i < vec->size; i++) {
+			mpu_fragments_t* mpu_fragments = vec->data[i]->mpu_fragments;
+			if(!mpu_fragments) {
+				continue;
+			}
+
+			mpu_data_unit_payload_fragments_vector_t* rings[] = {
+				&mpu_fragments->mpu_metadata_fragments_vector,
+				&mpu_fragments->mpu_movie_fragment_metadata_vector,
+				&mpu_fragments->media_fragment_unit_vector
+			};
+
+			for(int r=0; r < 3; r++) {
+				for(int j=0; j < MPU_IN_FLIGHT_RING_SIZE; j++) {
+					mpu_data_unit_payload_fragments_t* entry = &rings[r]->slots[j];
+					if(entry->mpu_state == MPU_STATE_FREE || entry == in_progress) {
+						continue;
+					}
+
+					if(!oldest ||
+						(entry->mpu_state == MPU_STATE_EMITTED && oldest->mpu_state != MPU_STATE_EMITTED) ||
+						((entry->mpu_state == MPU_STATE_EMITTED) == (oldest->mpu_state == MPU_STATE_EMITTED) && entry->mpu_created_order < oldest->mpu_created_order)) {
+						oldest = entry;
+					}
+				}
+			}
+		}
+
+		if(!oldest) {
+			//only the in-progress mpu is left, let it run over the ceiling
+			return;
 		}
+
+		__PRINTF_DEBUG("%d:mmtp_fragment_store_enforce_max_bytes, recycling mpu_sequence_number: %u, bytes: %zu\n", __LINE__, oldest->mpu_sequence_number, oldest->mpu_bytes);
+		mpu_data_unit_payload_fragments_recycle(fragment_store, oldest);
+	}
+}
+
+static void mmtp_fragment_store_mpu_set_state(mmtp_sub_flow_t* mmtp_sub_flow, uint32_t mpu_sequence_number, mpu_state_t mpu_state) {
+	mpu_fragments_t* mpu_fragments = mmtp_sub_flow->mpu_fragments;
+	mpu_data_unit_payload_fragments_vector_t* rings[] = {
+		&mpu_fragments->mpu_metadata_fragments_vector,
+		&mpu_fragments->mpu_movie_fragment_metadata_vector,
+		&mpu_fragments->media_fragment_unit_vector
+	};
+
+	for(int r=0; r < 3; r++) {
+		mpu_data_unit_payload_fragments_t* entry = mpu_data_unit_payload_fragments_find_mpu_sequence_number(rings[r], mpu_sequence_number);
+		if(entry && entry->mpu_state < mpu_state) {
+			entry->mpu_state = mpu_state;
+		}
+	}
+}
+
+void mmtp_fragment_store_mpu_complete(mmtp_sub_flow_t* mmtp_sub_flow, uint32_t mpu_sequence_number) {
+	mmtp_sub_flow->mmtp_sub_flow_vector->fragment_store.stats.mpus_completed++;
+	mmtp_fragment_store_mpu_set_state(mmtp_sub_flow, mpu_sequence_number, MPU_STATE_COMPLETE);
+}
+
+void mmtp_fragment_store_mpu_emitted(mmtp_sub_flow_t* mmtp_sub_flow, uint32_t mpu_sequence_number) {
+	mmtp_sub_flow->mmtp_sub_flow_vector->fragment_store.stats.mpus_emitted++;
+	mmtp_fragment_store_mpu_set_state(mmtp_sub_flow, mpu_sequence_number, MPU_STATE_EMITTED);
+}
+
+void mmtp_fragment_store_stats_dump(mmtp_sub_flow_vector_t *mmtp_sub_flow_vector) {
+	mmtp_fragment_store_t* fragment_store = &mmtp_sub_flow_vector->fragment_store;
+
+	_MMTP_INFO("fragment store: bytes_in_use: %zu, max_bytes: %zu, mpus created: %llu, completed: %llu, emitted: %llu, recycled: %llu, evicted: %llu (fragments: %llu, bytes: %llu)",
+			fragment_store->bytes_in_use,
+			fragment_store->max_bytes,
+			(unsigned long long)fragment_store->stats.mpus_created,
+			(unsigned long long)fragment_store->stats.mpus_completed,
+			(unsigned long long)fragment_store->stats.mpus_emitted,
+			(unsigned long long)fragment_store->stats.mpus_recycled,
+			(unsigned long long)fragment_store->stats.mpus_evicted,
+			(unsigned long long)fragment_store->stats.fragments_evicted,
+			(unsigned long long)fragment_store->stats.bytes_evicted);
+}
+
+static inline size_t mmtp_sub_flow_index_slot(uint16_t mmtp_packet_id, size_t capacity) {
+	//fibonacci hash, packet_id's are usually small and sequential
+	return ((uint32_t)mmtp_packet_id * 2654435769u >> 16) & (capacity - 1);
+}
+
+static void mmtp_sub_flow_index_insert(mmtp_sub_flow_t** packet_id_index, size_t capacity, mmtp_sub_flow_t* mmtp_sub_flow) {
+	size_t slot = mmtp_sub_flow_index_slot(mmtp_sub_flow->mmtp_packet_id, capacity);
+	while(packet_id_index[slot]) {
+		slot = (slot + 1) & (capacity - 1);
+	}
+	packet_id_index[slot] = mmtp_sub_flow;
+}
+
+static int mmtp_sub_flow_index_grow(mmtp_sub_flow_vector_t *vec) {
+	size_t new_capacity = vec->packet_id_index_capacity ? vec->packet_id_index_capacity * 2 : MMTP_SUB_FLOW_INDEX_MIN_CAPACITY;
+	mmtp_sub_flow_t** new_index = calloc(new_capacity, sizeof(mmtp_sub_flow_t*));
+	if(!new_index) {
+		return -1;
+	}
+
+	for(size_t i=0; i < vec->size; i++) {
+		mmtp_sub_flow_index_insert(new_index, new_capacity, vec->data[i]);
+	}
+
+	free(vec->packet_id_index);
+	vec->packet_id_index = new_index;
+	vec->packet_id_index_capacity = new_capacity;
+
+	return 0;
+}
+
+mpu_data_unit_payload_fragments_t* mpu_data_unit_payload_fragments_find_mpu_sequence_number(mpu_data_unit_payload_fragments_vector_t *vec, uint32_t mpu_sequence_number) {
+	mpu_data_unit_payload_fragments_t *mpu_fragments = &vec->slots[mpu_sequence_number & (MPU_IN_FLIGHT_RING_SIZE - 1)];
+
+	if (mpu_fragments->mpu_state != MPU_STATE_FREE && mpu_fragments->mpu_sequence_number == mpu_sequence_number) {
+		return mpu_fragments;
 	}
 	return NULL;
 }
 
 
-mpu_data_unit_payload_fragments_t* mpu_data_unit_payload_fragments_get_or_set_mpu_sequence_number_from_packet(mpu_data_unit_payload_fragments_vector_t *vec, mmtp_payload_fragments_union_t *mpu_type_packet) {
+static mpu_data_unit_payload_fragments_t* mpu_data_unit_payload_fragments_get_or_set_mpu_sequence_number(mmtp_fragment_store_t* fragment_store, mpu_data_unit_payload_fragments_vector_t *vec, uint32_t mpu_sequence_number) {
+	mpu_data_unit_payload_fragments_t *entry = &vec->slots[mpu_sequence_number & (MPU_IN_FLIGHT_RING_SIZE - 1)];
 
-	mpu_data_unit_payload_fragments_t *entry = mpu_data_unit_payload_fragments_find_mpu_sequence_number(vec, mpu_type_packet->mmtp_mpu_type_packet_header.mpu_sequence_number);
-	if(!entry) {
-		entry = calloc(1, sizeof(mpu_data_unit_payload_fragments_t));
+	if(entry->mpu_state != MPU_STATE_FREE && entry->mpu_sequence_number == mpu_sequence_number) {
+		return entry;
+	}
 
-		entry->mpu_sequence_number = mpu_type_packet->mmtp_mpu_type_packet_header.mpu_sequence_number;
-		atsc3_vector_init(&entry->timed_fragments_vector);
-		atsc3_vector_init(&entry->nontimed_fragments_vector);
-		atsc3_vector_push(vec, entry);
+	if(entry->mpu_state != MPU_STATE_FREE) {
+		__PRINTF_DEBUG("%d:mpu_data_unit_payload_fragments_get_or_set, evicting mpu_sequence_number: %u for: %u\n", __LINE__, entry->mpu_sequence_number, mpu_sequence_number);
+		if(entry->mpu_state != MPU_STATE_EMITTED) {
+			vec->evicted_count++;
+		}
+		mpu_data_unit_payload_fragments_recycle(fragment_store, entry);
 	}
 
+	entry->mpu_state = MPU_STATE_COLLECTING;
+	entry->mpu_sequence_number = mpu_sequence_number;
+	entry->mpu_created_order = fragment_store->next_created_order++;
+	fragment_store->stats.mpus_created++;
+
 	return entry;
 }
 
+void mpu_data_unit_payload_fragments_vector_free(mpu_data_unit_payload_fragments_vector_t *vec) {
+	for(int i=0; i < MPU_IN_FLIGHT_RING_SIZE; i++) {
+		atsc3_vector_destroy(&vec->slots[i].timed_fragments_vector);
+		atsc3_vector_init(&vec->slots[i].timed_fragments_vector);
+		atsc3_vector_destroy(&vec->slots[i].nontimed_fragments_vector);
+		atsc3_vector_init(&vec->slots[i].nontimed_fragments_vector);
+		vec->slots[i].mpu_state = MPU_STATE_FREE;
+	}
+}
 
 
 void allocate_mmtp_sub_flow_mpu_fragments(mmtp_sub_flow_t* entry) {
 	entry->mpu_fragments = calloc(1, sizeof(mpu_fragments_t));
 	entry->mpu_fragments->mmtp_sub_flow = entry;
+	entry->mpu_fragments->mmtp_packet_id = entry->mmtp_packet_id;
 
-	atsc3_vector_init(&entry->mpu_fragments->all_mpu_fragments_vector);
-	atsc3_vector_init(&entry->mpu_fragments->mpu_metadata_fragments_vector);
-	atsc3_vector_init(&entry->mpu_fragments->mpu_movie_fragment_metadata_vector);
-	atsc3_vector_init(&entry->mpu_fragments->media_fragment_unit_vector);
+	//mpu in-flight rings are zeroed by calloc
 }
 
-//push this to mpu_fragments_vector->all_fragments_vector first,
-// 	then re-assign once fragment_type and fragmentation info are parsed
-//mpu_sequence_number *SHOULD* only be resolved from the interior all_fragments_vector for tuple lookup
 mpu_fragments_t* mpu_fragments_get_or_set_packet_id(mmtp_sub_flow_t* mmtp_sub_flow, uint16_t mmtp_packet_id) {
 
 	mpu_fragments_t *entry = mmtp_sub_flow->mpu_fragments;
 	if(!entry) {
-		__PRINTF_DEBUG("*** %d:mpu_fragments_get_or_set_packet_id - adding vector: %p, all_fragments_vector is: %p\n",
-				__LINE__, entry, entry->all_mpu_fragments_vector);
+		__PRINTF_DEBUG("*** %d:mpu_fragments_get_or_set_packet_id - allocating mpu_fragments for packet_id: %u\n", __LINE__, mmtp_packet_id);
 
 		allocate_mmtp_sub_flow_mpu_fragments(mmtp_sub_flow);
+		entry = mmtp_sub_flow->mpu_fragments;
 	}
 
 	return entry;
 }
 
+/**
+ * hand ownership of mpu_type_packet (and its mpu_data_unit_payload) to the fragment store,
+ * it is released when its mpu is recycled. mpu_type_packet must be unique per data unit.
+ */
 void mpu_fragments_assign_to_payload_vector(mmtp_sub_flow_t* mmtp_sub_flow, mmtp_payload_fragments_union_t* mpu_type_packet) {
-	//use mmtp_sub_flow ref, find packet_id, map into mpu/mfu vector
-//	mmtp_sub_flow_t mmtp_sub_flow = mpu_type_packet->mpu_
-
+	mmtp_sub_flow_vector_t* mmtp_sub_flow_vector = mmtp_sub_flow->mmtp_sub_flow_vector;
+	mmtp_fragment_store_t* fragment_store = &mmtp_sub_flow_vector->fragment_store;
 	mpu_fragments_t *mpu_fragments = mmtp_sub_flow->mpu_fragments;
-	__PRINTF_TRACE("%d:mpu_fragments_assign_to_payload_vector - mpu_fragments is:, all_mpu_frags_vector.size: %d %p\n", __LINE__, mpu_fragments, mpu_fragments->all_mpu_fragments_vector.size);
 
-	mpu_data_unit_payload_fragments_t *to_assign_payload_vector = NULL;
+	mpu_data_unit_payload_fragments_vector_t* ring = NULL;
 	if(mpu_type_packet->mmtp_mpu_type_packet_header.mpu_fragment_type == 0x00) {
 		//push to mpu_metadata fragments vector
-		to_assign_payload_vector = mpu_data_unit_payload_fragments_get_or_set_mpu_sequence_number_from_packet(&mpu_fragments->mpu_metadata_fragments_vector, mpu_type_packet);
+		ring = &mpu_fragments->mpu_metadata_fragments_vector;
 	} else if(mpu_type_packet->mmtp_mpu_type_packet_header.mpu_fragment_type == 0x01) {
 		//push to mpu_movie_fragment
-		to_assign_payload_vector = mpu_data_unit_payload_fragments_get_or_set_mpu_sequence_number_from_packet(&mpu_fragments->mpu_movie_fragment_metadata_vector, mpu_type_packet);
+		ring = &mpu_fragments->mpu_movie_fragment_metadata_vector;
 	} else if(mpu_type_packet->mmtp_mpu_type_packet_header.mpu_fragment_type == 0x02) {
 		//push to media_fragment
-		to_assign_payload_vector = mpu_data_unit_payload_fragments_get_or_set_mpu_sequence_number_from_packet(&mpu_fragments->media_fragment_unit_vector, mpu_type_packet);
+		ring = &mpu_fragments->media_fragment_unit_vector;
+	} else {
+		mmtp_fragment_store_packet_release(fragment_store, mpu_type_packet);
+		return;
 	}
 
-	if(to_assign_payload_vector) {
-		__PRINTF_TRACE("%d: to_assign_payload_vector, sequence_number: %d, size is: %d\n", __LINE__, mpu_type_packet->mmtp_mpu_type_packet_header.mpu_sequence_number, to_assign_payload_vector->timed_fragments_vector.size);
-		if(mpu_type_packet->mmtp_mpu_type_packet_header.mpu_timed_flag) {
-			__PRINTF_TRACE("%d:mpu_data_unit_payload_fragments_get_or_set_mpu_sequence_number_from_packet, sequence_number: %d, pushing to timed_fragments_vector: %p", __LINE__, to_assign_payload_vector->mpu_sequence_number, to_assign_payload_vector->timed_fragments_vector);
-			atsc3_vector_push(&to_assign_payload_vector->timed_fragments_vector, mpu_type_packet);
-		} else {
-			atsc3_vector_push(&to_assign_payload_vector->nontimed_fragments_vector, mpu_type_packet);
-		}
+	mpu_data_unit_payload_fragments_t *to_assign_payload_vector = mpu_data_unit_payload_fragments_get_or_set_mpu_sequence_number(fragment_store, ring, mpu_type_packet->mmtp_mpu_type_packet_header.mpu_sequence_number);
 
+	__PRINTF_TRACE("%d: to_assign_payload_vector, sequence_number: %d, size is: %zu\n", __LINE__, mpu_type_packet->mmtp_mpu_type_packet_header.mpu_sequence_number, to_assign_payload_vector->timed_fragments_vector.size);
+	if(mpu_type_packet->mmtp_mpu_type_packet_header.mpu_timed_flag) {
+		atsc3_vector_push(&to_assign_payload_vector->timed_fragments_vector, mpu_type_packet);
+	} else {
+		atsc3_vector_push(&to_assign_payload_vector->nontimed_fragments_vector, mpu_type_packet);
 	}
+
+	to_assign_payload_vector->mpu_bytes += mpu_type_packet->mmtp_mpu_type_packet_header.mpu_data_unit_payload_length;
+	fragment_store->bytes_in_use += mpu_type_packet->mmtp_mpu_type_packet_header.mpu_data_unit_payload_length;
+
+	mmtp_fragment_store_enforce_max_bytes(mmtp_sub_flow_vector, to_assign_payload_vector);
 }
 
 
 
 mmtp_sub_flow_t* mmtp_sub_flow_vector_find_packet_id(mmtp_sub_flow_vector_t *vec, uint16_t mmtp_packet_id) {
-	for (size_t i = 0; i < vec->size; ++i) {
-		mmtp_sub_flow_t *mmtp_sub_flow = vec->data[i];
+	if(!vec->packet_id_index_capacity) {
+		return NULL;
+	}
 
-		if (mmtp_sub_flow->mmtp_packet_id == mmtp_packet_id) {
-			return mmtp_sub_flow;
+	size_t slot = mmtp_sub_flow_index_slot(mmtp_packet_id, vec->packet_id_index_capacity);
+	while(vec->packet_id_index[slot]) {
+		if (vec->packet_id_index[slot]->mmtp_packet_id == mmtp_packet_id) {
+			return vec->packet_id_index[slot];
 		}
+		slot = (slot + 1) & (vec->packet_id_index_capacity - 1);
 	}
 	return NULL;
 }
@@ -156,12 +378,23 @@ mmtp_sub_flow_t* mmtp_sub_flow_vector_get_or_set_packet_id(mmtp_sub_flow_vector_
 	if(!entry) {
 		entry = calloc(1, sizeof(mmtp_sub_flow_t));
 		entry->mmtp_packet_id = mmtp_packet_id;
+		entry->mmtp_sub_flow_vector = vec;
 		allocate_mmtp_sub_flow_mpu_fragments(entry);
 		atsc3_vector_init(&entry->mmtp_generic_object_fragments_vector);
 		atsc3_vector_init(&entry->mmtp_signalling_message_fragements_vector);
 		atsc3_vector_init(&entry->mmtp_repair_symbol_vector);
+		mmtp_flow_stats_init(&entry->flow_stats);
 
 		atsc3_vector_push(vec, entry);
+
+		if(vec->size * 2 > vec->packet_id_index_capacity) {
+			//rebuilds the index, including this entry
+			if(mmtp_sub_flow_index_grow(vec)) {
+				abort();
+			}
+		} else {
+			mmtp_sub_flow_index_insert(vec->packet_id_index, vec->packet_id_index_capacity, entry);
+		}
 	}
 
 	return entry;
@@ -213,22 +446,18 @@ mmtp_payload_fragments_union_t* mmtp_packet_create(block_t * raw_packet,
 	return entry;
 }
 
+/**
+ * associate this packet with its sub_flow.
+ *
+ * mpu packets are retained by the fragment store once their data unit is parsed, see mpu_fragments_assign_to_payload_vector,
+ * other payload types are not retained yet and remain owned by the caller.
+ */
 void mmtp_sub_flow_push_mmtp_packet(mmtp_sub_flow_t *mmtp_sub_flow, mmtp_payload_fragments_union_t *mmtp_packet) {
 	mmtp_packet->mmtp_packet_header.mmtp_sub_flow = mmtp_sub_flow;
 
 	__PRINTF_DEBUG("%d:mmtp_sub_flow_push_mmtp_packet, mmtp_payload_type: 0x%x\n", __LINE__, mmtp_packet->mmtp_packet_header.mmtp_payload_type);
 	if(mmtp_packet->mmtp_packet_header.mmtp_payload_type == 0x00) {
-		//(mmtp_mpu_type_packet_header_fields_t*
-		//defer, we don;'t know enough about the type
-		mpu_fragments_t *mpu_fragments = mpu_fragments_get_or_set_packet_id(mmtp_sub_flow, mmtp_packet->mmtp_packet_header.mmtp_packet_id);
-		atsc3_vector_push(&mpu_fragments->all_mpu_fragments_vector, mmtp_packet);
-
-	} else if(mmtp_packet->mmtp_packet_header.mmtp_payload_type == 0x01) {
-		atsc3_vector_push(&mmtp_sub_flow->mmtp_generic_object_fragments_vector, mmtp_packet);
-	} else if(mmtp_packet->mmtp_packet_header.mmtp_payload_type == 0x02) {
-		atsc3_vector_push(&mmtp_sub_flow->mmtp_signalling_message_fragements_vector, mmtp_packet);
-	} else if(mmtp_packet->mmtp_packet_header.mmtp_payload_type == 0x03) {
-		atsc3_vector_push(&mmtp_sub_flow->mmtp_repair_symbol_vector, mmtp_packet);
+		mpu_fragments_get_or_set_packet_id(mmtp_sub_flow, mmtp_packet->mmtp_packet_header.mmtp_packet_id);
 	}
 }
 
@@ -251,7 +480,7 @@ void mmtp_sub_flow_push_mmtp_packet(mmtp_sub_flow_t *mmtp_sub_flow, mmtp_payload
 
 
 //returns pointer from udp_raw_buf where we completed header parsing
-uint8_t* mmtp_packet_header_parse_from_raw_packet(mmtp_payload_fragments_union_t *mmtp_packet, uint8_t* udp_raw_buf, uint8_t udp_raw_buf_size) {
+uint8_t* mmtp_packet_header_parse_from_raw_packet(mmtp_payload_fragments_union_t *mmtp_packet, uint8_t* udp_raw_buf, int udp_raw_buf_size) {
 
 	if(udp_raw_buf_size < 20) {
 		//bail, the min header is at least 20 bytes
@@ -259,53 +488,33 @@ uint8_t* mmtp_packet_header_parse_from_raw_packet(mmtp_payload_fragments_union_t
 		return NULL;
 	}
 
-	uint8_t *raw_buf = udp_raw_buf;
-	uint8_t *buf = udp_raw_buf;
+	atsc3_cursor_t cursor;
+	atsc3_cursor_init(&cursor, udp_raw_buf, udp_raw_buf_size);
 
-	uint8_t mmtp_packet_preamble[20];
+	if(mmtp_packet_header_parse_from_cursor(mmtp_packet, &cursor)) {
+		return NULL;
+	}
 
-	//msg_Warn( p_demux, "buf pos before extract is: %p", (void *)buf);
-	buf = extract(buf, mmtp_packet_preamble, 20);
-	//msg_Warn( p_demux, "buf pos is now %p vs %p", new_buf_pos, (void *)buf);
+	return cursor.pos;
+}
 
-//		msg_Dbg( p_demux, "raw packet size is: %d, first byte: 0x%X", mmtp_raw_packet_size, mmtp_packet_preamble[0]);
+/**
+ * parse the mmtp packet header in place, leaving the cursor at the start of the payload header.
+ *
+ * mmtp_header_extension_value is a borrowed pointer into the raw datagram, it is only valid as long as raw_packet is
+ */
+int mmtp_packet_header_parse_from_cursor(mmtp_payload_fragments_union_t* mmtp_packet, atsc3_cursor_t* cursor) {
 
-//	if(false) {
-//		char buffer[(mmtp_raw_packet_size * 3)+1];
-//
-//		for(int i=0; i < mmtp_raw_packet_size; i++) {
-//			if(i>1 && (i+1)%8 == 0) {
-//				sn__PRINTF_DEBUG(buffer + (i*3), 4, "%02X\n", raw_buf[i]);
-//			} else {
-//				sn__PRINTF_DEBUG(buffer + (i*3), 4, "%02X ", raw_buf[i]);
-//			}
-//		}
-//		msg_Info(p_demux, "raw packet payload is:\n%s", buffer);
-//	}
+	uint8_t* mmtp_packet_preamble = atsc3_cursor_take(cursor, 16);
+	if(!mmtp_packet_preamble) {
+		_MMTP_ERROR("mmtp_packet_header_parse_from_cursor, short packet: %zu bytes", atsc3_cursor_remaining(cursor));
+		return -1;
+	}
 
 	mmtp_packet->mmtp_packet_header.mmtp_packet_version = (mmtp_packet_preamble[0] & 0xC0) >> 6;
 	mmtp_packet->mmtp_packet_header.packet_counter_flag = (mmtp_packet_preamble[0] & 0x20) >> 5;
 	mmtp_packet->mmtp_packet_header.fec_type = (mmtp_packet_preamble[0] & 0x18) >> 3;
 
-	//v=0 vs v=1 attributes in the first 2 octets
-	uint8_t  mmtp_payload_type = 0;
-	uint8_t  mmtp_header_extension_flag = 0;
-	uint8_t  mmtp_rap_flag = 0;
-	uint8_t  mmtp_qos_flag = 0;
-
-	uint8_t  mmtp_flow_identifer_flag = 0;
-	uint8_t  mmtp_flow_extension_flag = 0;
-
-	uint8_t  mmtp_header_compression = 0;
-	uint8_t	 mmtp_indicator_ref_header_flag = 0;
-
-	uint8_t mmtp_type_of_bitrate = 0;
-	uint8_t mmtp_delay_sensitivity = 0;
-	uint8_t mmtp_transmission_priority = 0;
-
-	uint16_t mmtp_header_extension_type = 0;
-	uint16_t mmtp_header_extension_length = 0;
-
 	if(mmtp_packet->mmtp_packet_header.mmtp_packet_version == 0x00) {
 		//after fec_type, with v=0, next bitmask is 0x4 >>2
 		//0000 0010
@@ -316,19 +525,16 @@ uint8_t* mmtp_packet_header_parse_from_raw_packet(mmtp_payload_fragments_union_t
 		//6 bits right aligned
 		mmtp_packet->mmtp_packet_header.mmtp_payload_type = mmtp_packet_preamble[1] & 0x3f;
 		if(mmtp_packet->mmtp_packet_header.mmtp_header_extension_flag & 0x1) {
-			mmtp_packet->mmtp_packet_header.mmtp_header_extension_type = (mmtp_packet_preamble[16]) << 8 | mmtp_packet_preamble[17];
-			mmtp_packet->mmtp_packet_header.mmtp_header_extension_length = (mmtp_packet_preamble[18]) << 8 | mmtp_packet_preamble[19];
-		} else {
-			//walk back by 4 bytes
-			buf-=4;
+			mmtp_packet->mmtp_packet_header.mmtp_header_extension_type = atsc3_cursor_read_u16(cursor);
+			mmtp_packet->mmtp_packet_header.mmtp_header_extension_length = atsc3_cursor_read_u16(cursor);
 		}
 	} else if(mmtp_packet->mmtp_packet_header.mmtp_packet_version == 0x01) {
 		//bitmask is 0000 00
 		//0000 0100
 		//V1CF EXRQ
-		mmtp_packet->mmtp_packet_header.mmtp_header_extension_flag = mmtp_packet_preamble[0] & 0x4 >> 2; //X
+		mmtp_packet->mmtp_packet_header.mmtp_header_extension_flag = (mmtp_packet_preamble[0] & 0x4) >> 2;	//X
 		mmtp_packet->mmtp_packet_header.mmtp_rap_flag = (mmtp_packet_preamble[0] & 0x2) >> 1;				//RAP
-		mmtp_packet->mmtp_packet_header.mmtp_qos_flag = mmtp_packet_preamble[0] & 0x1;					//QOS
+		mmtp_packet->mmtp_packet_header.mmtp_qos_flag = mmtp_packet_preamble[0] & 0x1;						//QOS
 		//0000 0000
 		//FEBI TYPE
 		//4 bits for preamble right aligned
@@ -340,50 +546,164 @@ uint8_t* mmtp_packet_header_parse_from_raw_packet(mmtp_payload_fragments_union_t
 
 		mmtp_packet->mmtp_packet_header.mmtp_payload_type = mmtp_packet_preamble[1] & 0xF;
 
+		uint8_t* qos_block = atsc3_cursor_take(cursor, 2);
+		if(!qos_block) {
+			goto error;
+		}
+
 		//TB 2 bits
-		mmtp_packet->mmtp_packet_header.mmtp_type_of_bitrate = ((mmtp_packet_preamble[16] & 0x40) >> 6) | ((mmtp_packet_preamble[16] & 0x20) >> 5);
+		mmtp_packet->mmtp_packet_header.mmtp_type_of_bitrate = ((qos_block[0] & 0x40) >> 6) | ((qos_block[0] & 0x20) >> 5);
 
 		//DS 3 bits
-		mmtp_packet->mmtp_packet_header.mmtp_delay_sensitivity = ((mmtp_packet_preamble[16] & 0x10) >> 4) | ((mmtp_packet_preamble[16] & 0x8) >> 3) | ((mmtp_packet_preamble[16] & 0x4) >> 2);
+		mmtp_packet->mmtp_packet_header.mmtp_delay_sensitivity = ((qos_block[0] & 0x10) >> 4) | ((qos_block[0] & 0x8) >> 3) | ((qos_block[0] & 0x4) >> 2);
 
 		//TP 3 bits
-		mmtp_packet->mmtp_packet_header.mmtp_transmission_priority =(( mmtp_packet_preamble[16] & 0x02) << 2) | ((mmtp_packet_preamble[16] & 0x1) << 1) | ((mmtp_packet_preamble[17] & 0x80) >>7);
+		mmtp_packet->mmtp_packet_header.mmtp_transmission_priority =(( qos_block[0] & 0x02) << 2) | ((qos_block[0] & 0x1) << 1) | ((qos_block[1] & 0x80) >>7);
 
-		mmtp_packet->mmtp_packet_header.flow_label = mmtp_packet_preamble[17] & 0x7f;
+		mmtp_packet->mmtp_packet_header.flow_label = qos_block[1] & 0x7f;
 
-		//header extension is offset by 2 bytes in v=1, so an additional block chain read is needed to get extension length
+		//header extension is offset by 2 bytes in v=1
 		if(mmtp_packet->mmtp_packet_header.mmtp_header_extension_flag & 0x1) {
-			mmtp_packet->mmtp_packet_header.mmtp_header_extension_type = (mmtp_packet_preamble[18] << 8) | mmtp_packet_preamble[19];
-
-	//		msg_Warn( p_demux, "mmtp_demuxer - dping mmtp_header_extension_length_bytes: %d",  mmtp_header_extension_type);
-
-			uint8_t mmtp_header_extension_length_bytes[2];
-			buf = extract(buf, mmtp_header_extension_length_bytes, 2);
-
-			mmtp_packet->mmtp_packet_header.mmtp_header_extension_length = mmtp_header_extension_length_bytes[0] << 8 | mmtp_header_extension_length_bytes[1];
-		} else {
-			//walk us back for mmtp payload type header parsing
-			buf-=2;
+			mmtp_packet->mmtp_packet_header.mmtp_header_extension_type = atsc3_cursor_read_u16(cursor);
+			mmtp_packet->mmtp_packet_header.mmtp_header_extension_length = atsc3_cursor_read_u16(cursor);
 		}
 	} else {
 		_MMTP_ERROR("mmtp_demuxer - unknown packet version of 0x%X", mmtp_packet->mmtp_packet_header.mmtp_packet_version);
 		goto error;
-	//	free( raw_buf );
+	}
+
+	if(mmtp_packet->mmtp_packet_header.mmtp_header_extension_flag & 0x1) {
+		//reference the header extension value in place rather than copying it out
+		mmtp_packet->mmtp_packet_header.mmtp_header_extension_value = atsc3_cursor_take(cursor, mmtp_packet->mmtp_packet_header.mmtp_header_extension_length);
 	}
 
 	mmtp_packet->mmtp_packet_header.mmtp_packet_id			= mmtp_packet_preamble[2]  << 8  | mmtp_packet_preamble[3];
-	mmtp_packet->mmtp_packet_header.mmtp_timestamp 			= mmtp_packet_preamble[4]  << 24 | mmtp_packet_preamble[5]  << 16 | mmtp_packet_preamble[6]   << 8 | mmtp_packet_preamble[7];
+	mmtp_packet->mmtp_packet_header.mmtp_timestamp 			= (uint32_t)mmtp_packet_preamble[4]  << 24 | mmtp_packet_preamble[5]  << 16 | mmtp_packet_preamble[6]   << 8 | mmtp_packet_preamble[7];
 	compute_ntp32_to_seconds_microseconds(mmtp_packet->mmtp_packet_header.mmtp_timestamp, &mmtp_packet->mmtp_packet_header.mmtp_timestamp_s, &mmtp_packet->mmtp_packet_header.mmtp_timestamp_us);
 
-	mmtp_packet->mmtp_packet_header.packet_sequence_number	= mmtp_packet_preamble[8]  << 24 | mmtp_packet_preamble[9]  << 16 | mmtp_packet_preamble[10]  << 8 | mmtp_packet_preamble[11];
-	mmtp_packet->mmtp_packet_header.packet_counter 			= mmtp_packet_preamble[12] << 24 | mmtp_packet_preamble[13] << 16 | mmtp_packet_preamble[14]  << 8 | mmtp_packet_preamble[15];
+	mmtp_packet->mmtp_packet_header.packet_sequence_number	= (uint32_t)mmtp_packet_preamble[8]  << 24 | mmtp_packet_preamble[9]  << 16 | mmtp_packet_preamble[10]  << 8 | mmtp_packet_preamble[11];
+	mmtp_packet->mmtp_packet_header.packet_counter 			= (uint32_t)mmtp_packet_preamble[12] << 24 | mmtp_packet_preamble[13] << 16 | mmtp_packet_preamble[14]  << 8 | mmtp_packet_preamble[15];
 
-	return buf;
-//	p_sys->raw_buf = raw_buf;
-//	p_sys->buf =  buf;
+	if(cursor->overrun) {
+		_MMTP_ERROR("mmtp_packet_header_parse_from_cursor, header extends past end of packet, packet_id: %hu", mmtp_packet->mmtp_packet_header.mmtp_packet_id);
+		goto error;
+	}
+
+	return 0;
 
 error:
-	return NULL;
+	return -1;
+}
+
+/**
+ * mpu mode (payload_type==0x00) payload header: length, fragmentation info, counter and mpu_sequence_number
+ */
+int mmtp_mpu_packet_header_parse_from_cursor(mmtp_payload_fragments_union_t* mpu_type_packet, atsc3_cursor_t* cursor) {
+
+	mpu_type_packet->mmtp_mpu_type_packet_header.mpu_payload_length = atsc3_cursor_read_u16(cursor);
+
+	uint8_t mpu_fragmentation_info = atsc3_cursor_read_u8(cursor);
+	mpu_type_packet->mmtp_mpu_type_packet_header.mpu_fragment_type = (mpu_fragmentation_info & 0xF0) >> 4;
+	mpu_type_packet->mmtp_mpu_type_packet_header.mpu_timed_flag = (mpu_fragmentation_info & 0x8) >> 3;
+	mpu_type_packet->mmtp_mpu_type_packet_header.mpu_fragmentation_indicator = (mpu_fragmentation_info & 0x6) >> 1;
+	mpu_type_packet->mmtp_mpu_type_packet_header.mpu_aggregation_flag = (mpu_fragmentation_info & 0x1);
+
+	mpu_type_packet->mmtp_mpu_type_packet_header.mpu_fragmentation_counter = atsc3_cursor_read_u8(cursor);
+	mpu_type_packet->mmtp_mpu_type_packet_header.mpu_sequence_number = atsc3_cursor_read_u32(cursor);
+
+	if(cursor->overrun) {
+		_MMTP_ERROR("mmtp_mpu_packet_header_parse_from_cursor, short mpu payload header, packet_id: %hu", mpu_type_packet->mmtp_packet_header.mmtp_packet_id);
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * parse the next data unit (and its MFU DU header, if any) and return its payload as a view into the datagram.
+ *
+ * call in a loop while mpu_aggregation_flag is set and the cursor has data remaining.
+ *
+ * MFU DU headers are followed by an MMTHSample on the first (or only) fragment of a sample:
+ *
+ 	aligned(8) class MMTHSample {
+	   unsigned int(32) sequence_number;
+	   if (is_timed) {
+		  signed int(8) trackrefindex;
+		  unsigned int(32) movie_fragment_sequence_number
+		  unsigned int(32) samplenumber;
+		  unsigned int(8)  priority;
+		  unsigned int(8)  dependency_counter;
+		  unsigned int(32) offset;
+		  unsigned int(32) length;
+		  multiLayerInfo();
+	   } else {
+		  unsigned int(16) item_ID;
+	   }
+	}
+ */
+int mmtp_mpu_data_unit_parse_from_cursor(mmtp_payload_fragments_union_t* mpu_type_packet, atsc3_cursor_t* cursor, uint8_t** data_unit_payload, uint32_t* data_unit_payload_length) {
+
+	size_t data_unit_end = cursor->end - cursor->start;
+
+	//only read DU length if mpu_aggregation_flag=1
+	if(mpu_type_packet->mmtp_mpu_type_packet_header.mpu_aggregation_flag) {
+		mpu_type_packet->mmtp_mpu_type_packet_header.data_unit_length = atsc3_cursor_read_u16(cursor);
+		data_unit_end = atsc3_cursor_offset(cursor) + mpu_type_packet->mmtp_mpu_type_packet_header.data_unit_length;
+	}
+
+	if(mpu_type_packet->mmtp_mpu_type_packet_header.mpu_fragment_type == 0x2) {
+		uint8_t mpu_fragmentation_indicator = mpu_type_packet->mmtp_mpu_type_packet_header.mpu_fragmentation_indicator;
+
+		if(mpu_type_packet->mmtp_mpu_type_packet_header.mpu_timed_flag) {
+			//112 bits in aggregate, 14 bytes
+			mpu_type_packet->mpu_data_unit_payload_fragments_timed.movie_fragment_sequence_number 	= atsc3_cursor_read_u32(cursor);
+			mpu_type_packet->mpu_data_unit_payload_fragments_timed.sample_number				 	= atsc3_cursor_read_u32(cursor);
+			mpu_type_packet->mpu_data_unit_payload_fragments_timed.offset     					  	= atsc3_cursor_read_u32(cursor);
+			mpu_type_packet->mpu_data_unit_payload_fragments_timed.priority 						= atsc3_cursor_read_u8(cursor);
+			mpu_type_packet->mpu_data_unit_payload_fragments_timed.dep_counter						= atsc3_cursor_read_u8(cursor);
+
+			//skip the MMTHSample box if this is our first fragment or we are a complete fragment
+			if(mpu_fragmentation_indicator == 0 || mpu_fragmentation_indicator == 1) {
+				//sequence_number + 19 byte timed block + multiLayerInfo box length and name
+				atsc3_cursor_skip(cursor, 4 + 19 + 4 + 4);
+				uint8_t multilayer_flag = atsc3_cursor_read_u8(cursor);
+
+				//if MSB is 1, then read multilevel struct, otherwise just pull layer info...
+				if((multilayer_flag >> 7) & 0x01) {
+					atsc3_cursor_skip(cursor, 4);
+				} else {
+					atsc3_cursor_skip(cursor, 2);
+				}
+			}
+		} else {
+			mpu_type_packet->mpu_data_unit_payload_fragments_nontimed.non_timed_mfu_item_id = atsc3_cursor_read_u32(cursor);
+
+			//MMTHSample, like the timed one, leads the first fragment or a complete item
+			if(mpu_fragmentation_indicator == 0 || mpu_fragmentation_indicator == 1) {
+				mpu_type_packet->mpu_data_unit_payload_fragments_nontimed.mmthsample_sequence_number 	= atsc3_cursor_read_u32(cursor);
+				mpu_type_packet->mpu_data_unit_payload_fragments_nontimed.mmthsample_item_id 			= atsc3_cursor_read_u16(cursor);
+			}
+		}
+	}
+
+	size_t data_unit_start = atsc3_cursor_offset(cursor);
+	if(cursor->overrun || data_unit_end < data_unit_start) {
+		_MMTP_ERROR("mmtp_mpu_data_unit_parse_from_cursor, truncated data unit, packet_id: %hu, mpu_sequence_number: %u",
+				mpu_type_packet->mmtp_packet_header.mmtp_packet_id,
+				mpu_type_packet->mmtp_mpu_type_packet_header.mpu_sequence_number);
+		return -1;
+	}
+
+	*data_unit_payload_length = data_unit_end - data_unit_start;
+	*data_unit_payload = atsc3_cursor_take(cursor, *data_unit_payload_length);
+
+	if(!*data_unit_payload) {
+		_MMTP_ERROR("mmtp_mpu_data_unit_parse_from_cursor, data_unit_length: %u past end of packet", *data_unit_payload_length);
+		return -1;
+	}
+
+	return 0;
 }
 
 
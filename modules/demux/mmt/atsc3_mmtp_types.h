@@ -9,7 +9,11 @@
 #define MODULES_DEMUX_MMT_MMTP_TYPES_H_
 
 #include "atsc3_vector.h"
+#include "atsc3_utils.h"
+#include "atsc3_slab_pool.h"
 #include "atsc3_mmtp_ntp32_to_pts.h"
+#include "atsc3_trace.h"
+#include "atsc3_mmtp_flow_stats.h"
 //#include <vlc_common.h>
 //#include <vlc_vector.h>
 
@@ -29,12 +33,11 @@
 
 #define __LOG_MPU_REASSEMBLY(...)
 
-#define __LOG_DEBUG(...)
-//(msg_Info(__VA_ARGS__))
-#define __LOG_TRACE(...)
-#define __PRINTF_DEBUG(...)
-//(printf(__VA_ARGS__))
-#define __PRINTF_TRACE(...)
+//per-packet sites: the level is checked before the arguments are evaluated, and sites above ATSC3_TRACE_COMPILE_LEVEL are compiled out
+#define __LOG_DEBUG(...) do { if(ATSC3_TRACE_ENABLED(ATSC3_TRACE_LEVEL_DEBUG)) { msg_Dbg(__VA_ARGS__); } } while(0)
+#define __LOG_TRACE(...) do { if(ATSC3_TRACE_ENABLED(ATSC3_TRACE_LEVEL_TRACE)) { msg_Dbg(__VA_ARGS__); } } while(0)
+#define __PRINTF_DEBUG(...) _ATSC3_TRACE_DEBUG(__VA_ARGS__)
+#define __PRINTF_TRACE(...) _ATSC3_TRACE_TRACE(__VA_ARGS__)
 
 
 
@@ -66,7 +69,7 @@
 
 
 typedef struct mmtp_sub_flow mmtp_sub_flow_t;
-typedef struct block block_t;
+typedef struct block_t block_t;
 
 #define _MMTP_PACKET_HEADER_FIELDS 						\
 	block_t*			raw_packet;						\
@@ -92,7 +95,7 @@ typedef struct block block_t;
 	uint16_t		    mmtp_packet_id; 				\
 	uint32_t		    mmtp_timestamp;					\
 	uint16_t		    mmtp_timestamp_s;				\
-	uint16_t		    mmtp_timestamp_us;				\
+	uint32_t		    mmtp_timestamp_us;				\
 	uint32_t		    packet_sequence_number;			\
 	uint32_t		    packet_counter;					\
 
@@ -115,6 +118,7 @@ typedef struct {
 	uint32_t mpu_sequence_number;			\
 	uint16_t data_unit_length;				\
 	block_t *mpu_data_unit_payload;			\
+	uint32_t mpu_data_unit_payload_length;	\
 
 //DO NOT REFERENCE INTEREMDIATE STRUCTS DIRECTLY
 typedef struct {
@@ -137,6 +141,8 @@ typedef struct {
 typedef struct {
 	_MMTP_MPU_TYPE_PACKET_HEADER_FIELDS;
 	uint32_t non_timed_mfu_item_id;
+	uint32_t mmthsample_sequence_number;	//from the MMTHSample on the first (or only) fragment of the item
+	uint16_t mmthsample_item_id;
 
 } __mpu_data_unit_payload_fragments_nontimed_t;
 
@@ -194,15 +200,44 @@ typedef struct ATSC3_VECTOR(mmtp_payload_fragments_union_t *) 	mmtp_generic_obje
 typedef struct ATSC3_VECTOR(mmtp_payload_fragments_union_t *) 	mmtp_signalling_message_fragments_vector_t;
 typedef struct ATSC3_VECTOR(mmtp_payload_fragments_union_t *) 	mmtp_repair_symbol_vector_t;
 
+/**
+ * MPU lifecycle in the fragment store:
+ *
+ * 	FREE -> COLLECTING (first fragment of the mpu_sequence_number) -> COMPLETE -> EMITTED -> FREE (recycled)
+ *
+ * recycling releases every fragment (and its payload) held by the slot. EMITTED slots are recycled
+ * lazily, when their ring slot is needed again, when the store is over its byte ceiling, or on free.
+ */
+typedef enum {
+	MPU_STATE_FREE = 0,
+	MPU_STATE_COLLECTING,
+	MPU_STATE_COMPLETE,
+	MPU_STATE_EMITTED,
+} mpu_state_t;
+
 //todo, make this union
 typedef struct {
+	mpu_state_t mpu_state;
+	uint64_t mpu_created_order;
+	size_t	 mpu_bytes;
 	uint32_t mpu_sequence_number;
 	mpu_data_unit_payload_fragments_timed_vector_t 		timed_fragments_vector;
 	mpu_data_unit_payload_fragments_nontimed_vector_t 	nontimed_fragments_vector;
 
 } mpu_data_unit_payload_fragments_t;
 
-typedef struct ATSC3_VECTOR(mpu_data_unit_payload_fragments_t *) mpu_data_unit_payload_fragments_vector_t;
+/**
+ * bounded ring of in-flight MPUs, indexed by mpu_sequence_number & (MPU_IN_FLIGHT_RING_SIZE-1)
+ *
+ * a new mpu_sequence_number landing on an occupied slot evicts the older MPU and reuses its
+ * fragment vectors, so lookups are O(1) and the ring never grows for long running live streams
+ */
+#define MPU_IN_FLIGHT_RING_SIZE 8
+
+typedef struct {
+	mpu_data_unit_payload_fragments_t	slots[MPU_IN_FLIGHT_RING_SIZE];
+	uint32_t							evicted_count;
+} mpu_data_unit_payload_fragments_vector_t;
 
 
 //partial refactoring from vlc to libatsc3
@@ -250,8 +285,6 @@ typedef struct {
 	mmtp_sub_flow_t *mmtp_sub_flow;
 	uint16_t mmtp_packet_id;
 
-	mpu_type_packet_header_fields_vector_t 		all_mpu_fragments_vector;
-
 	//MPU Fragment type collections for reconstruction/recovery of fragments
 
 	//MPU metadata, 							mpu_fragment_type==0x00
@@ -272,8 +305,11 @@ typedef struct {
  */
 
 
+typedef struct mmtp_sub_flow_vector mmtp_sub_flow_vector_t;
+
 typedef struct mmtp_sub_flow {
 	uint16_t mmtp_packet_id;
+	mmtp_sub_flow_vector_t*						mmtp_sub_flow_vector;
 
 	//mmtp payload type collections for reconstruction/recovery of payload types
 
@@ -290,26 +326,81 @@ typedef struct mmtp_sub_flow {
 	//repair symbol:							payload_type==0x03
 	mmtp_repair_symbol_vector_t 				mmtp_repair_symbol_vector;
 
+	mmtp_flow_stats_t							flow_stats;
+
 } mmtp_sub_flow_t;
 
 
 //todo - refactor mpu_fragments to vector, create a new tuple class for mmtp_sub_flow_sequence
 
 
-typedef struct ATSC3_VECTOR(mmtp_sub_flow_t*) mmtp_sub_flow_vector_t;
+/**
+ * all sub_flows (iterable via size/data like any ATSC3_VECTOR) plus an open-addressing
+ * packet_id -> sub_flow index with linear probing, kept at <= 50% load
+ */
+#define MMTP_SUB_FLOW_INDEX_MIN_CAPACITY 16
+
+//default byte ceiling for all fragment payloads held across every sub_flow
+#define MMTP_FRAGMENT_STORE_DEFAULT_MAX_BYTES (64 * 1024 * 1024)
+
+//packet structs are carved from slabs of this many entries, ~1s of a 20Mbit/s service per slab
+#define MMTP_FRAGMENT_STORE_PACKETS_PER_SLAB 2048
+
+typedef void (*mmtp_payload_release_f)(block_t* mpu_data_unit_payload);
+
+typedef struct mmtp_fragment_store_stats {
+	uint64_t	mpus_created;
+	uint64_t	mpus_completed;
+	uint64_t	mpus_emitted;
+	uint64_t	mpus_recycled;
+	uint64_t	mpus_evicted;			//recycled before they were emitted
+	uint64_t	fragments_evicted;
+	uint64_t	bytes_evicted;
+} mmtp_fragment_store_stats_t;
+
+typedef struct mmtp_fragment_store {
+	size_t							max_bytes;		//0 for no ceiling
+	size_t							bytes_in_use;
+	uint64_t						next_created_order;
+	mmtp_payload_release_f			payload_release;
+	mmtp_fragment_store_stats_t		stats;
+
+	atsc3_slab_pool_t				packet_pool;	//backing for every mmtp_payload_fragments_union_t we hand out
+} mmtp_fragment_store_t;
+
+struct mmtp_sub_flow_vector {
+	struct ATSC3_VECTOR(mmtp_sub_flow_t*);
+
+	mmtp_sub_flow_t**	packet_id_index;
+	size_t				packet_id_index_capacity;
+
+	mmtp_fragment_store_t fragment_store;
+};
 
 
 void mmtp_sub_flow_vector_init(mmtp_sub_flow_vector_t *mmtp_sub_flow_vector);
+void mmtp_sub_flow_vector_free(mmtp_sub_flow_vector_t *mmtp_sub_flow_vector);
+
+//payload_release is called for each mpu_data_unit_payload when its MPU is recycled
+void mmtp_fragment_store_configure(mmtp_sub_flow_vector_t *mmtp_sub_flow_vector, size_t max_bytes, mmtp_payload_release_f payload_release);
+void mmtp_fragment_store_mpu_complete(mmtp_sub_flow_t* mmtp_sub_flow, uint32_t mpu_sequence_number);
+void mmtp_fragment_store_mpu_emitted(mmtp_sub_flow_t* mmtp_sub_flow, uint32_t mpu_sequence_number);
+void mmtp_fragment_store_stats_dump(mmtp_sub_flow_vector_t *mmtp_sub_flow_vector);
+
+/**
+ * per-packet allocation from the fragment store packet pool, returns a zeroed packet.
+ * packets handed to mpu_fragments_assign_to_payload_vector are returned to the pool by the store,
+ * anything else must be given back with mmtp_fragment_store_packet_free.
+ */
+mmtp_payload_fragments_union_t* mmtp_fragment_store_packet_alloc(mmtp_sub_flow_vector_t *mmtp_sub_flow_vector);
+void mmtp_fragment_store_packet_free(mmtp_sub_flow_vector_t *mmtp_sub_flow_vector, mmtp_payload_fragments_union_t* mmtp_packet);
 
 
 mpu_data_unit_payload_fragments_t* mpu_data_unit_payload_fragments_find_mpu_sequence_number(mpu_data_unit_payload_fragments_vector_t *vec, uint32_t mpu_sequence_number);
-mpu_data_unit_payload_fragments_t* mpu_data_unit_payload_fragments_get_or_set_mpu_sequence_number_from_packet(mpu_data_unit_payload_fragments_vector_t *vec, mmtp_payload_fragments_union_t *mpu_type_packet);
+void mpu_data_unit_payload_fragments_vector_free(mpu_data_unit_payload_fragments_vector_t *vec);
 
 
 void allocate_mmtp_sub_flow_mpu_fragments(mmtp_sub_flow_t* entry);
-//push this to mpu_fragments_vector->all_fragments_vector first,
-// 	then re-assign once fragment_type and fragmentation info are parsed
-//mpu_sequence_number *SHOULD* only be resolved from the interior all_fragments_vector for tuple lookup
 mpu_fragments_t* mpu_fragments_get_or_set_packet_id(mmtp_sub_flow_t* mmtp_sub_flow, uint16_t mmtp_packet_id);
 void mpu_fragments_assign_to_payload_vector(mmtp_sub_flow_t* mmtp_sub_flow, mmtp_payload_fragments_union_t* mpu_type_packet);
 
@@ -340,7 +431,12 @@ void mmtp_sub_flow_push_mmtp_packet(mmtp_sub_flow_t *mmtp_sub_flow, mmtp_payload
 
 
 //returns pointer from udp_raw_buf where we completed header parsing
-uint8_t* mmtp_packet_header_parse_from_raw_packet(mmtp_payload_fragments_union_t *mmtp_packet, uint8_t* udp_raw_buf, uint8_t udp_raw_buf_size);
+uint8_t* mmtp_packet_header_parse_from_raw_packet(mmtp_payload_fragments_union_t *mmtp_packet, uint8_t* udp_raw_buf, int udp_raw_buf_size);
+
+//zero-copy parsing, walks the raw datagram in place, returns 0 on success
+int mmtp_packet_header_parse_from_cursor(mmtp_payload_fragments_union_t* mmtp_packet, atsc3_cursor_t* cursor);
+int mmtp_mpu_packet_header_parse_from_cursor(mmtp_payload_fragments_union_t* mpu_type_packet, atsc3_cursor_t* cursor);
+int mmtp_mpu_data_unit_parse_from_cursor(mmtp_payload_fragments_union_t* mpu_type_packet, atsc3_cursor_t* cursor, uint8_t** data_unit_payload, uint32_t* data_unit_payload_length);
 void mmtp_packet_header_dump(mmtp_payload_fragments_union_t* mmtp_payload_fragments);
 
 #endif /* MODULES_DEMUX_MMT_MMTP_TYPES_H_ */
@@ -0,0 +1,158 @@
+/*
+ * atsc3_pcap_reader.c
+ *
+ *  Created on: Feb 20, 2019
+ *      Author: jjustman
+ */
+
+#include "atsc3_pcap_reader.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define PCAP_READER_GLOBAL_HEADER_LENGTH	24
+#define PCAP_READER_RECORD_HEADER_LENGTH	16
+
+#define PCAP_READER_ETHERTYPE_IPV4			0x0800
+#define PCAP_READER_ETHERTYPE_VLAN			0x8100
+#define PCAP_READER_ETHERTYPE_QINQ			0x88A8
+#define PCAP_READER_ETHERNET_HEADER_LENGTH	14
+#define PCAP_READER_SLL_HEADER_LENGTH		16
+#define PCAP_READER_NULL_HEADER_LENGTH		4
+//BSD loopback address family, host byte order of the capturing machine
+#define PCAP_READER_AF_INET					2
+
+static uint32_t __pcap_reader_u32(const atsc3_pcap_reader_t* atsc3_pcap_reader, const uint8_t* p) {
+	if(atsc3_pcap_reader->is_swapped) {
+		return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+	}
+	return (uint32_t)p[3] << 24 | p[2] << 16 | p[1] << 8 | p[0];
+}
+
+int atsc3_pcap_reader_open(atsc3_pcap_reader_t* atsc3_pcap_reader, FILE* fp) {
+	memset(atsc3_pcap_reader, 0, sizeof(atsc3_pcap_reader_t));
+
+	uint8_t header[PCAP_READER_GLOBAL_HEADER_LENGTH];
+	if(fread(header, 1, sizeof(header), fp) != sizeof(header)) {
+		return -1;
+	}
+
+	//the magic as written by the capturing host tells us its byte order
+	uint32_t magic = (uint32_t)header[3] << 24 | header[2] << 16 | header[1] << 8 | header[0];
+	uint32_t magic_swapped = (uint32_t)header[0] << 24 | header[1] << 16 | header[2] << 8 | header[3];
+	if(magic == PCAP_READER_MAGIC_US || magic == PCAP_READER_MAGIC_NS) {
+		atsc3_pcap_reader->is_nanosecond = magic == PCAP_READER_MAGIC_NS;
+	} else if(magic_swapped == PCAP_READER_MAGIC_US || magic_swapped == PCAP_READER_MAGIC_NS) {
+		atsc3_pcap_reader->is_swapped = true;
+		atsc3_pcap_reader->is_nanosecond = magic_swapped == PCAP_READER_MAGIC_NS;
+	} else {
+		_PCAP_READER_ERROR("atsc3_pcap_reader_open: not a pcap file, magic: 0x%08x", magic);
+		return -1;
+	}
+
+	atsc3_pcap_reader->snaplen = __pcap_reader_u32(atsc3_pcap_reader, &header[16]);
+	atsc3_pcap_reader->linktype = __pcap_reader_u32(atsc3_pcap_reader, &header[20]) & 0x0FFFFFFF;
+	atsc3_pcap_reader->fp = fp;
+
+	return 0;
+}
+
+int atsc3_pcap_reader_next(atsc3_pcap_reader_t* atsc3_pcap_reader, atsc3_pcap_record_t* atsc3_pcap_record) {
+	uint8_t header[PCAP_READER_RECORD_HEADER_LENGTH];
+	size_t header_read = fread(header, 1, sizeof(header), atsc3_pcap_reader->fp);
+	if(header_read == 0) {
+		return 1;
+	}
+	if(header_read != sizeof(header)) {
+		_PCAP_READER_ERROR("atsc3_pcap_reader_next: truncated record header after %llu records", (unsigned long long)atsc3_pcap_reader->stats.records);
+		return -1;
+	}
+
+	uint32_t ts_sec = __pcap_reader_u32(atsc3_pcap_reader, &header[0]);
+	uint32_t ts_frac = __pcap_reader_u32(atsc3_pcap_reader, &header[4]);
+	uint32_t incl_len = __pcap_reader_u32(atsc3_pcap_reader, &header[8]);
+	uint32_t orig_len = __pcap_reader_u32(atsc3_pcap_reader, &header[12]);
+
+	if(incl_len > PCAP_READER_MAX_RECORD) {
+		_PCAP_READER_ERROR("atsc3_pcap_reader_next: record of %u bytes, damaged file", incl_len);
+		return -1;
+	}
+
+	if(incl_len > atsc3_pcap_reader->buffer_capacity) {
+		uint8_t* buffer = realloc(atsc3_pcap_reader->buffer, incl_len);
+		if(!buffer) {
+			return -1;
+		}
+		atsc3_pcap_reader->buffer = buffer;
+		atsc3_pcap_reader->buffer_capacity = incl_len;
+	}
+
+	if(fread(atsc3_pcap_reader->buffer, 1, incl_len, atsc3_pcap_reader->fp) != incl_len) {
+		_PCAP_READER_ERROR("atsc3_pcap_reader_next: truncated record of %u bytes", incl_len);
+		return -1;
+	}
+
+	atsc3_pcap_record->timestamp_us = (int64_t)ts_sec * 1000000 + (atsc3_pcap_reader->is_nanosecond ? ts_frac / 1000 : ts_frac);
+	atsc3_pcap_record->data = atsc3_pcap_reader->buffer;
+	atsc3_pcap_record->length = incl_len;
+	atsc3_pcap_record->original_length = orig_len;
+
+	atsc3_pcap_reader->stats.records++;
+	if(incl_len < orig_len) {
+		atsc3_pcap_reader->stats.records_truncated++;
+	}
+
+	return 0;
+}
+
+int atsc3_pcap_link_to_ipv4(uint32_t linktype, uint8_t* data, size_t length, uint8_t** ipv4, size_t* ipv4_length) {
+	size_t offset = 0;
+
+	if(linktype == PCAP_READER_LINKTYPE_ETHERNET) {
+		if(length < PCAP_READER_ETHERNET_HEADER_LENGTH) {
+			return -1;
+		}
+		offset = 12;
+		uint16_t ethertype = data[offset] << 8 | data[offset + 1];
+		while(ethertype == PCAP_READER_ETHERTYPE_VLAN || ethertype == PCAP_READER_ETHERTYPE_QINQ) {
+			offset += 4;
+			if(length < offset + 2) {
+				return -1;
+			}
+			ethertype = data[offset] << 8 | data[offset + 1];
+		}
+		if(ethertype != PCAP_READER_ETHERTYPE_IPV4) {
+			return -1;
+		}
+		offset += 2;
+	} else if(linktype == PCAP_READER_LINKTYPE_LINUX_SLL) {
+		if(length < PCAP_READER_SLL_HEADER_LENGTH || (data[14] << 8 | data[15]) != PCAP_READER_ETHERTYPE_IPV4) {
+			return -1;
+		}
+		offset = PCAP_READER_SLL_HEADER_LENGTH;
+	} else if(linktype == PCAP_READER_LINKTYPE_NULL || linktype == PCAP_READER_LINKTYPE_LOOP) {
+		//either byte order, AF_INET is 2 everywhere
+		if(length < PCAP_READER_NULL_HEADER_LENGTH || (data[0] != PCAP_READER_AF_INET && data[3] != PCAP_READER_AF_INET)) {
+			return -1;
+		}
+		offset = PCAP_READER_NULL_HEADER_LENGTH;
+	} else if(linktype != PCAP_READER_LINKTYPE_RAW && linktype != PCAP_READER_LINKTYPE_IPV4) {
+		return -1;
+	}
+
+	if(length <= offset || (data[offset] >> 4) != 4) {
+		return -1;
+	}
+
+	*ipv4 = data + offset;
+	*ipv4_length = length - offset;
+	return 0;
+}
+
+void atsc3_pcap_reader_close(atsc3_pcap_reader_t* atsc3_pcap_reader) {
+	if(atsc3_pcap_reader->fp) {
+		fclose(atsc3_pcap_reader->fp);
+	}
+	free(atsc3_pcap_reader->buffer);
+	memset(atsc3_pcap_reader, 0, sizeof(atsc3_pcap_reader_t));
+}
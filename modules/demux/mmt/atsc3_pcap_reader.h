@@ -0,0 +1,88 @@
+/*
+ * atsc3_pcap_reader.h
+ *
+ *  Created on: Feb 20, 2019
+ *      Author: jjustman
+ *
+ * reads libpcap capture files (microsecond or nanosecond, either byte order) record by record, and strips
+ * the link layer down to the ipv4 packet for udp_flow_parse_ipv4. no libpcap needed, captures can be
+ * replayed without a network interface.
+ *
+ * link types: ethernet (with 802.1Q tags), raw ip, linux cooked (SLL) and BSD loopback.
+ *
+ * not thread-safe.
+ */
+
+#ifndef MODULES_DEMUX_MMT_ATSC3_PCAP_READER_H_
+#define MODULES_DEMUX_MMT_ATSC3_PCAP_READER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define _PCAP_READER_PRINTLN(...) printf(__VA_ARGS__);printf("\n")
+#define _PCAP_READER_ERROR(...)   printf("%s:%d:ERROR:",__FILE__,__LINE__);_PCAP_READER_PRINTLN(__VA_ARGS__);
+#define _PCAP_READER_INFO(...)    printf("%s:%d:INFO :",__FILE__,__LINE__);_PCAP_READER_PRINTLN(__VA_ARGS__);
+#define _PCAP_READER_DEBUG(...)
+
+#define PCAP_READER_MAGIC_US		0xA1B2C3D4
+#define PCAP_READER_MAGIC_NS		0xA1B23C4D
+
+#define PCAP_READER_LINKTYPE_NULL		0
+#define PCAP_READER_LINKTYPE_ETHERNET	1
+#define PCAP_READER_LINKTYPE_RAW		101
+#define PCAP_READER_LINKTYPE_LOOP		108
+#define PCAP_READER_LINKTYPE_LINUX_SLL	113
+#define PCAP_READER_LINKTYPE_IPV4		228
+
+//records claiming more than this are taken as a damaged file
+#define PCAP_READER_MAX_RECORD			262144
+
+typedef struct atsc3_pcap_record {
+	int64_t		timestamp_us;
+	uint8_t*	data;			//valid until the next atsc3_pcap_reader_next
+	size_t		length;			//captured bytes
+	size_t		original_length;
+} atsc3_pcap_record_t;
+
+typedef struct atsc3_pcap_reader_stats {
+	uint64_t	records;
+	uint64_t	records_truncated;	//captured shorter than they were on the wire
+} atsc3_pcap_reader_stats_t;
+
+typedef struct atsc3_pcap_reader {
+	FILE*		fp;
+	bool		is_swapped;
+	bool		is_nanosecond;
+	uint32_t	linktype;
+	uint32_t	snaplen;
+
+	uint8_t*	buffer;
+	size_t		buffer_capacity;
+
+	atsc3_pcap_reader_stats_t stats;
+} atsc3_pcap_reader_t;
+
+/**
+ * read the global header of fp, which the reader then owns.
+ * returns -1 if fp is not a pcap file; fp is left open for the caller then
+ */
+int atsc3_pcap_reader_open(atsc3_pcap_reader_t* atsc3_pcap_reader, FILE* fp);
+
+/**
+ * the next record.
+ * returns 0, 1 at the end of the file, -1 if the file is damaged
+ */
+int atsc3_pcap_reader_next(atsc3_pcap_reader_t* atsc3_pcap_reader, atsc3_pcap_record_t* atsc3_pcap_record);
+
+/**
+ * the ipv4 packet carried by a record of linktype, in place.
+ * returns -1 for anything else (ipv6, arp, ...)
+ */
+int atsc3_pcap_link_to_ipv4(uint32_t linktype, uint8_t* data, size_t length, uint8_t** ipv4, size_t* ipv4_length);
+
+//closes the file
+void atsc3_pcap_reader_close(atsc3_pcap_reader_t* atsc3_pcap_reader);
+
+#endif /* MODULES_DEMUX_MMT_ATSC3_PCAP_READER_H_ */
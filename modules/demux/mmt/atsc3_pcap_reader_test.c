@@ -0,0 +1,196 @@
+/*
+ *
+ * atsc3_pcap_reader_test.c:  driver for pcap file reading and link layer stripping down to ipv4/udp
+ *
+ */
+
+#include "atsc3_pcap_reader.h"
+#include "atsc3_udp_flow.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+#define __UNIT_TEST 1
+#ifdef __UNIT_TEST
+
+//172.16.200.1:50000 -> 239.255.10.1:51001, 4 byte payload
+static const uint8_t __test_datagram[] = {
+	0x45, 0x00, 0x00, 0x20, 0x00, 0x00, 0x40, 0x00, 0x40, 0x11, 0x00, 0x00,
+	0xAC, 0x10, 0xC8, 0x01,
+	0xEF, 0xFF, 0x0A, 0x01,
+	0xC3, 0x50, 0xC7, 0x39, 0x00, 0x0C, 0x00, 0x00,
+	0xDE, 0xAD, 0xBE, 0xEF
+};
+
+void __test_put_u32(uint8_t* p, uint32_t v, bool big_endian) {
+	if(big_endian) {
+		p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+	} else {
+		p[3] = v >> 24; p[2] = v >> 16; p[1] = v >> 8; p[0] = v;
+	}
+}
+
+void __test_write_global_header(FILE* fp, uint32_t magic, uint32_t linktype, bool big_endian) {
+	uint8_t header[24] = { 0 };
+	__test_put_u32(&header[0], magic, big_endian);
+	header[big_endian ? 5 : 4] = 2;		//version 2.4
+	header[big_endian ? 7 : 6] = 4;
+	__test_put_u32(&header[16], 65535, big_endian);
+	__test_put_u32(&header[20], linktype, big_endian);
+	fwrite(header, 1, sizeof(header), fp);
+}
+
+void __test_write_record(FILE* fp, uint32_t ts_sec, uint32_t ts_frac, const uint8_t* link, size_t link_length, bool big_endian) {
+	uint8_t header[16];
+	__test_put_u32(&header[0], ts_sec, big_endian);
+	__test_put_u32(&header[4], ts_frac, big_endian);
+	__test_put_u32(&header[8], link_length + sizeof(__test_datagram), big_endian);
+	__test_put_u32(&header[12], link_length + sizeof(__test_datagram), big_endian);
+	fwrite(header, 1, sizeof(header), fp);
+	fwrite(link, 1, link_length, fp);
+	fwrite(__test_datagram, 1, sizeof(__test_datagram), fp);
+}
+
+//every record of the file carries __test_datagram, stamped ts_sec + n * 20 ms. fp is closed
+int __test_read_back(FILE* fp, int records, int64_t first_us, const char* name) {
+	rewind(fp);
+	atsc3_pcap_reader_t atsc3_pcap_reader;
+	if(atsc3_pcap_reader_open(&atsc3_pcap_reader, fp)) {
+		_PCAP_READER_ERROR("%s: not opened", name);
+		fclose(fp);
+		return -1;
+	}
+
+	atsc3_pcap_record_t atsc3_pcap_record;
+	int read = 0;
+	int ret;
+	while(!(ret = atsc3_pcap_reader_next(&atsc3_pcap_reader, &atsc3_pcap_record))) {
+		uint8_t* ipv4;
+		size_t ipv4_length;
+		udp_flow_t udp_flow;
+		uint8_t* payload;
+		size_t payload_length;
+
+		if(atsc3_pcap_record.timestamp_us != first_us + read * 20000 ||
+				atsc3_pcap_link_to_ipv4(atsc3_pcap_reader.linktype, atsc3_pcap_record.data, atsc3_pcap_record.length, &ipv4, &ipv4_length) ||
+				udp_flow_parse_ipv4(ipv4, ipv4_length, &udp_flow, &payload, &payload_length) ||
+				udp_flow.dst_ip_addr != 0xEFFF0A01 || udp_flow.dst_port != 51001 || payload_length != 4 || memcmp(payload, "\xDE\xAD\xBE\xEF", 4)) {
+			_PCAP_READER_ERROR("%s: record %d, timestamp: %lld, not parsed", name, read, (long long)atsc3_pcap_record.timestamp_us);
+			atsc3_pcap_reader_close(&atsc3_pcap_reader);
+			return -1;
+		}
+		read++;
+	}
+
+	atsc3_pcap_reader_close(&atsc3_pcap_reader);
+	if(ret != 1 || read != records) {
+		_PCAP_READER_ERROR("%s: read %d of %d records, ret: %d", name, read, records, ret);
+		return -1;
+	}
+	return 0;
+}
+
+int test_atsc3_pcap_reader_ethernet();
+int test_atsc3_pcap_reader_raw_big_endian_ns();
+int test_atsc3_pcap_reader_sll();
+int test_atsc3_pcap_reader_damaged();
+
+int main() {
+	int failed = 0;
+
+	failed |= test_atsc3_pcap_reader_ethernet();
+	failed |= test_atsc3_pcap_reader_raw_big_endian_ns();
+	failed |= test_atsc3_pcap_reader_sll();
+	failed |= test_atsc3_pcap_reader_damaged();
+
+	return failed;
+}
+
+//little endian microsecond capture, ethernet with and without an 802.1Q tag, an arp frame in between is not ipv4
+int test_atsc3_pcap_reader_ethernet() {
+	FILE* fp = tmpfile();
+	const uint8_t ethernet[] = { 0x01, 0x00, 0x5E, 0x7F, 0x0A, 0x01, 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x08, 0x00 };
+	const uint8_t vlan[] = { 0x01, 0x00, 0x5E, 0x7F, 0x0A, 0x01, 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x81, 0x00, 0x00, 0x64, 0x08, 0x00 };
+	const uint8_t arp[] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x08, 0x06 };
+
+	__test_write_global_header(fp, PCAP_READER_MAGIC_US, PCAP_READER_LINKTYPE_ETHERNET, false);
+	__test_write_record(fp, 1550000000, 0, ethernet, sizeof(ethernet), false);
+	__test_write_record(fp, 1550000000, 20000, vlan, sizeof(vlan), false);
+
+	if(__test_read_back(fp, 2, 1550000000LL * 1000000, "test_atsc3_pcap_reader_ethernet")) {
+		return -1;
+	}
+
+	uint8_t frame[sizeof(arp) + sizeof(__test_datagram)];
+	memcpy(frame, arp, sizeof(arp));
+	memcpy(&frame[sizeof(arp)], __test_datagram, sizeof(__test_datagram));
+	uint8_t* ipv4;
+	size_t ipv4_length;
+	if(!atsc3_pcap_link_to_ipv4(PCAP_READER_LINKTYPE_ETHERNET, frame, sizeof(frame), &ipv4, &ipv4_length)) {
+		_PCAP_READER_ERROR("test_atsc3_pcap_reader_ethernet: arp taken as ipv4");
+		return -1;
+	}
+	return 0;
+}
+
+//big endian nanosecond capture of raw ip
+int test_atsc3_pcap_reader_raw_big_endian_ns() {
+	FILE* fp = tmpfile();
+	__test_write_global_header(fp, PCAP_READER_MAGIC_NS, PCAP_READER_LINKTYPE_RAW, true);
+	for(int i = 0; i < 3; i++) {
+		__test_write_record(fp, 10, 500000000 + i * 20000000, NULL, 0, true);
+	}
+
+	return __test_read_back(fp, 3, 10500000, "test_atsc3_pcap_reader_raw_big_endian_ns");
+}
+
+int test_atsc3_pcap_reader_sll() {
+	FILE* fp = tmpfile();
+	const uint8_t sll[] = { 0x00, 0x00, 0x00, 0x01, 0x00, 0x06, 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x00, 0x00, 0x08, 0x00 };
+	__test_write_global_header(fp, PCAP_READER_MAGIC_US, PCAP_READER_LINKTYPE_LINUX_SLL, false);
+	__test_write_record(fp, 0, 0, sll, sizeof(sll), false);
+
+	return __test_read_back(fp, 1, 0, "test_atsc3_pcap_reader_sll");
+}
+
+//not a capture, and a capture cut short in the middle of a record
+int test_atsc3_pcap_reader_damaged() {
+	FILE* fp = tmpfile();
+	fwrite("not a pcap file, not at all", 1, 27, fp);
+	rewind(fp);
+	atsc3_pcap_reader_t atsc3_pcap_reader;
+	if(!atsc3_pcap_reader_open(&atsc3_pcap_reader, fp)) {
+		_PCAP_READER_ERROR("test_atsc3_pcap_reader_damaged: text file opened");
+		return -1;
+	}
+	fclose(fp);
+
+	fp = tmpfile();
+	__test_write_global_header(fp, PCAP_READER_MAGIC_US, PCAP_READER_LINKTYPE_RAW, false);
+	__test_write_record(fp, 0, 0, NULL, 0, false);
+	fflush(fp);
+	long length = ftell(fp);
+	__test_write_record(fp, 0, 20000, NULL, 0, false);
+	fflush(fp);
+	if(ftruncate(fileno(fp), length + 20)) {
+		fclose(fp);
+		return -1;
+	}
+
+	rewind(fp);
+	atsc3_pcap_record_t atsc3_pcap_record;
+	if(atsc3_pcap_reader_open(&atsc3_pcap_reader, fp) || atsc3_pcap_reader_next(&atsc3_pcap_reader, &atsc3_pcap_record) ||
+			atsc3_pcap_reader_next(&atsc3_pcap_reader, &atsc3_pcap_record) != -1) {
+		_PCAP_READER_ERROR("test_atsc3_pcap_reader_damaged: truncated record not reported");
+		atsc3_pcap_reader_close(&atsc3_pcap_reader);
+		return -1;
+	}
+	atsc3_pcap_reader_close(&atsc3_pcap_reader);
+	return 0;
+}
+
+#endif
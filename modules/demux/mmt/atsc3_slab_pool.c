@@ -0,0 +1,99 @@
+/*
+ * atsc3_slab_pool.c
+ *
+ *  Created on: Feb 6, 2019
+ *      Author: jjustman
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "atsc3_slab_pool.h"
+
+//slab header is padded so the first object keeps ATSC3_SLAB_POOL_ALIGNMENT
+#define ATSC3_SLAB_POOL_HEADER_SIZE ((sizeof(atsc3_slab_pool_slab_t) + ATSC3_SLAB_POOL_ALIGNMENT - 1) & ~(size_t)(ATSC3_SLAB_POOL_ALIGNMENT - 1))
+
+void atsc3_slab_pool_init(atsc3_slab_pool_t* pool, const char* name, size_t object_size, size_t objects_per_slab) {
+	memset(pool, 0, sizeof(atsc3_slab_pool_t));
+
+	if(object_size < sizeof(atsc3_slab_pool_free_entry_t)) {
+		object_size = sizeof(atsc3_slab_pool_free_entry_t);
+	}
+
+	pool->name = name;
+	pool->object_size = (object_size + ATSC3_SLAB_POOL_ALIGNMENT - 1) & ~(size_t)(ATSC3_SLAB_POOL_ALIGNMENT - 1);
+	pool->objects_per_slab = objects_per_slab ? objects_per_slab : 1;
+}
+
+static int atsc3_slab_pool_grow(atsc3_slab_pool_t* pool) {
+	atsc3_slab_pool_slab_t* slab = malloc(ATSC3_SLAB_POOL_HEADER_SIZE + pool->object_size * pool->objects_per_slab);
+	if(!slab) {
+		_ATSC3_SLAB_POOL_ERROR("atsc3_slab_pool_grow: %s: unable to allocate slab of %zu objects", pool->name, pool->objects_per_slab);
+		return -1;
+	}
+
+	slab->next = pool->slabs;
+	pool->slabs = slab;
+	pool->slab_count++;
+
+	//thread objects onto the free list back to front so allocations walk the slab in address order
+	uint8_t* objects = (uint8_t*)slab + ATSC3_SLAB_POOL_HEADER_SIZE;
+	for(size_t i = pool->objects_per_slab; i > 0; i--) {
+		atsc3_slab_pool_free_entry_t* entry = (atsc3_slab_pool_free_entry_t*)(objects + (i - 1) * pool->object_size);
+		entry->next = pool->free_list;
+		pool->free_list = entry;
+	}
+
+	return 0;
+}
+
+void* atsc3_slab_pool_alloc(atsc3_slab_pool_t* pool) {
+	if(!pool->free_list && atsc3_slab_pool_grow(pool)) {
+		return NULL;
+	}
+
+	atsc3_slab_pool_free_entry_t* entry = pool->free_list;
+	pool->free_list = entry->next;
+
+	pool->objects_in_use++;
+	if(pool->objects_in_use > pool->objects_in_use_high_water) {
+		pool->objects_in_use_high_water = pool->objects_in_use;
+	}
+
+	memset(entry, 0, pool->object_size);
+	return entry;
+}
+
+void atsc3_slab_pool_free(atsc3_slab_pool_t* pool, void* object) {
+	if(!object) {
+		return;
+	}
+
+	atsc3_slab_pool_free_entry_t* entry = object;
+	entry->next = pool->free_list;
+	pool->free_list = entry;
+	pool->objects_in_use--;
+}
+
+void atsc3_slab_pool_stats_dump(atsc3_slab_pool_t* pool) {
+	_ATSC3_SLAB_POOL_INFO("slab pool: %s, object_size: %zu, slabs: %zu (%zu objects each), in use: %zu, high water: %zu",
+			pool->name, pool->object_size, pool->slab_count, pool->objects_per_slab, pool->objects_in_use, pool->objects_in_use_high_water);
+}
+
+void atsc3_slab_pool_destroy(atsc3_slab_pool_t* pool) {
+	if(pool->objects_in_use) {
+		_ATSC3_SLAB_POOL_ERROR("atsc3_slab_pool_destroy: %s: %zu objects still in use", pool->name, pool->objects_in_use);
+	}
+
+	atsc3_slab_pool_slab_t* slab = pool->slabs;
+	while(slab) {
+		atsc3_slab_pool_slab_t* next = slab->next;
+		free(slab);
+		slab = next;
+	}
+
+	pool->slabs = NULL;
+	pool->free_list = NULL;
+	pool->slab_count = 0;
+	pool->objects_in_use = 0;
+}
@@ -0,0 +1,63 @@
+/*
+ * atsc3_slab_pool.h
+ *
+ *  Created on: Feb 6, 2019
+ *      Author: jjustman
+ *
+ * fixed-size object pool for per-packet allocations (mmtp packet headers, payload block views).
+ *
+ * objects are carved out of slabs of objects_per_slab entries and recycled through an intrusive
+ * free list, so steady-state packet processing never touches malloc/free. slabs are only returned
+ * on atsc3_slab_pool_destroy.
+ *
+ * not thread-safe: alloc and free must happen on the same thread (the demux thread).
+ */
+
+#ifndef MODULES_DEMUX_MMT_ATSC3_SLAB_POOL_H_
+#define MODULES_DEMUX_MMT_ATSC3_SLAB_POOL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define _ATSC3_SLAB_POOL_PRINTLN(...) printf(__VA_ARGS__);printf("\n")
+#define _ATSC3_SLAB_POOL_ERROR(...)   printf("%s:%d:ERROR:",__FILE__,__LINE__);_ATSC3_SLAB_POOL_PRINTLN(__VA_ARGS__);
+#define _ATSC3_SLAB_POOL_INFO(...)    printf("%s:%d:INFO :",__FILE__,__LINE__);_ATSC3_SLAB_POOL_PRINTLN(__VA_ARGS__);
+
+#define ATSC3_SLAB_POOL_ALIGNMENT 16
+
+typedef struct atsc3_slab_pool_free_entry {
+	struct atsc3_slab_pool_free_entry* next;
+} atsc3_slab_pool_free_entry_t;
+
+typedef struct atsc3_slab_pool_slab {
+	struct atsc3_slab_pool_slab* next;
+} atsc3_slab_pool_slab_t;
+
+typedef struct atsc3_slab_pool {
+	const char*						name;
+	size_t							object_size;
+	size_t							objects_per_slab;
+
+	atsc3_slab_pool_slab_t*			slabs;
+	atsc3_slab_pool_free_entry_t*	free_list;
+
+	size_t							slab_count;
+	size_t							objects_in_use;
+	size_t							objects_in_use_high_water;
+} atsc3_slab_pool_t;
+
+void atsc3_slab_pool_init(atsc3_slab_pool_t* pool, const char* name, size_t object_size, size_t objects_per_slab);
+
+//returns a zeroed object, or NULL if a new slab could not be allocated
+void* atsc3_slab_pool_alloc(atsc3_slab_pool_t* pool);
+
+void atsc3_slab_pool_free(atsc3_slab_pool_t* pool, void* object);
+
+void atsc3_slab_pool_stats_dump(atsc3_slab_pool_t* pool);
+
+//all objects must have been returned, outstanding objects are leaked into freed memory otherwise
+void atsc3_slab_pool_destroy(atsc3_slab_pool_t* pool);
+
+#endif /* MODULES_DEMUX_MMT_ATSC3_SLAB_POOL_H_ */
@@ -0,0 +1,104 @@
+/*
+ *
+ * atsc3_slab_pool_test.c:  driver for fixed-size object pool reuse and slab growth
+ *
+ */
+
+#include "atsc3_slab_pool.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define __UNIT_TEST 1
+#ifdef __UNIT_TEST
+
+#define TEST_OBJECT_SIZE 		100
+#define TEST_OBJECTS_PER_SLAB	4
+
+int test_atsc3_slab_pool_reuse();
+int test_atsc3_slab_pool_grow();
+
+int main() {
+	int failed = 0;
+
+	failed |= test_atsc3_slab_pool_reuse();
+	failed |= test_atsc3_slab_pool_grow();
+
+	return failed;
+}
+
+int test_atsc3_slab_pool_reuse() {
+	atsc3_slab_pool_t pool;
+	atsc3_slab_pool_init(&pool, "test_reuse", TEST_OBJECT_SIZE, TEST_OBJECTS_PER_SLAB);
+
+	uint8_t* first = atsc3_slab_pool_alloc(&pool);
+	memset(first, 0xAA, TEST_OBJECT_SIZE);
+	atsc3_slab_pool_free(&pool, first);
+
+	//a freed object comes straight back, zeroed, without another slab
+	uint8_t* second = atsc3_slab_pool_alloc(&pool);
+	for(int i=0; i < TEST_OBJECT_SIZE; i++) {
+		if(second[i]) {
+			_ATSC3_SLAB_POOL_ERROR("test_atsc3_slab_pool_reuse: byte %d not zeroed", i);
+			return -1;
+		}
+	}
+
+	if(first != second || pool.slab_count != 1 || ((uintptr_t)second % ATSC3_SLAB_POOL_ALIGNMENT)) {
+		_ATSC3_SLAB_POOL_ERROR("test_atsc3_slab_pool_reuse: first: %p, second: %p, slabs: %zu", first, second, pool.slab_count);
+		return -1;
+	}
+
+	atsc3_slab_pool_free(&pool, second);
+	atsc3_slab_pool_destroy(&pool);
+
+	return 0;
+}
+
+int test_atsc3_slab_pool_grow() {
+	atsc3_slab_pool_t pool;
+	atsc3_slab_pool_init(&pool, "test_grow", TEST_OBJECT_SIZE, TEST_OBJECTS_PER_SLAB);
+
+	void* objects[TEST_OBJECTS_PER_SLAB * 3];
+	for(int i=0; i < TEST_OBJECTS_PER_SLAB * 3; i++) {
+		objects[i] = atsc3_slab_pool_alloc(&pool);
+		memset(objects[i], i, TEST_OBJECT_SIZE);
+	}
+
+	if(pool.slab_count != 3 || pool.objects_in_use != TEST_OBJECTS_PER_SLAB * 3) {
+		_ATSC3_SLAB_POOL_ERROR("test_atsc3_slab_pool_grow: slabs: %zu, in use: %zu", pool.slab_count, pool.objects_in_use);
+		return -1;
+	}
+
+	//objects must not overlap
+	for(int i=0; i < TEST_OBJECTS_PER_SLAB * 3; i++) {
+		if(((uint8_t*)objects[i])[TEST_OBJECT_SIZE - 1] != (uint8_t)i) {
+			_ATSC3_SLAB_POOL_ERROR("test_atsc3_slab_pool_grow: object %d was overwritten", i);
+			return -1;
+		}
+	}
+
+	for(int i=0; i < TEST_OBJECTS_PER_SLAB * 3; i++) {
+		atsc3_slab_pool_free(&pool, objects[i]);
+	}
+
+	//steady state: churn through the free list without growing
+	for(int i=0; i < 1000; i++) {
+		atsc3_slab_pool_free(&pool, atsc3_slab_pool_alloc(&pool));
+	}
+
+	if(pool.slab_count != 3 || pool.objects_in_use != 0 || pool.objects_in_use_high_water != TEST_OBJECTS_PER_SLAB * 3) {
+		_ATSC3_SLAB_POOL_ERROR("test_atsc3_slab_pool_grow: after churn, slabs: %zu, in use: %zu", pool.slab_count, pool.objects_in_use);
+		return -1;
+	}
+
+	atsc3_slab_pool_stats_dump(&pool);
+	atsc3_slab_pool_destroy(&pool);
+
+	return 0;
+}
+
+#endif
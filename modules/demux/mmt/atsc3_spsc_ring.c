@@ -0,0 +1,54 @@
+/*
+ * atsc3_spsc_ring.c
+ *
+ *  Created on: Feb 11, 2019
+ *      Author: jjustman
+ */
+
+#include "atsc3_spsc_ring.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+int atsc3_spsc_ring_init(atsc3_spsc_ring_t* ring, uint32_t capacity) {
+	memset(ring, 0, sizeof(atsc3_spsc_ring_t));
+
+	if(!capacity) {
+		return -1;
+	}
+
+	if(capacity > ATSC3_SPSC_RING_MAX_CAPACITY) {
+		_ATSC3_SPSC_RING_ERROR("atsc3_spsc_ring_init: capacity: %u over limit: %u, clamping", capacity, ATSC3_SPSC_RING_MAX_CAPACITY);
+		capacity = ATSC3_SPSC_RING_MAX_CAPACITY;
+	}
+
+	//a power of two lets the free running head/tail wrap at 2^32 and index with a mask
+	uint32_t ring_size = 1;
+	while(ring_size < capacity) {
+		ring_size <<= 1;
+	}
+
+	ring->slots = calloc(ring_size, sizeof(void*));
+	if(!ring->slots) {
+		return -1;
+	}
+
+	ring->mask = ring_size - 1;
+	atomic_init(&ring->head, 0);
+	atomic_init(&ring->tail, 0);
+
+	return 0;
+}
+
+void atsc3_spsc_ring_stats_dump(atsc3_spsc_ring_t* ring, const char* name) {
+	_ATSC3_SPSC_RING_INFO("atsc3_spsc_ring: %s, capacity: %u, depth high water: %u, refused full: %llu",
+			name,
+			atsc3_spsc_ring_capacity(ring),
+			ring->depth_high_water,
+			(unsigned long long)ring->push_full);
+}
+
+void atsc3_spsc_ring_free(atsc3_spsc_ring_t* ring) {
+	free(ring->slots);
+	ring->slots = NULL;
+}
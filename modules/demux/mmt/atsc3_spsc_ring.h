@@ -0,0 +1,104 @@
+/*
+ * atsc3_spsc_ring.h
+ *
+ *  Created on: Feb 11, 2019
+ *      Author: jjustman
+ *
+ * bounded lock-free single producer / single consumer ring of pointers, used to hand datagrams
+ * from the receive thread to the demux thread without taking a lock per packet.
+ *
+ * exactly one thread may push and exactly one (other) thread may pop. the producer only writes
+ * tail and the consumer only writes head, each on its own cache line, and each side keeps a cached
+ * copy of the other's index so the shared line is only re-read when the ring looks full / empty.
+ *
+ * the ring never blocks: push fails when full and pop returns NULL when empty, waiting is up to
+ * the caller.
+ */
+
+#ifndef MODULES_DEMUX_MMT_ATSC3_SPSC_RING_H_
+#define MODULES_DEMUX_MMT_ATSC3_SPSC_RING_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define _ATSC3_SPSC_RING_PRINTLN(...) printf(__VA_ARGS__);printf("\n")
+#define _ATSC3_SPSC_RING_ERROR(...)   printf("%s:%d:ERROR:",__FILE__,__LINE__);_ATSC3_SPSC_RING_PRINTLN(__VA_ARGS__);
+#define _ATSC3_SPSC_RING_INFO(...)    printf("%s:%d:INFO :",__FILE__,__LINE__);_ATSC3_SPSC_RING_PRINTLN(__VA_ARGS__);
+
+#define ATSC3_SPSC_RING_CACHE_LINE	64
+
+//upper bound on capacity, the slots are allocated up front
+#define ATSC3_SPSC_RING_MAX_CAPACITY	(1 << 20)
+
+typedef struct atsc3_spsc_ring {
+	void**				slots;
+	uint32_t			mask;			//capacity - 1, capacity is a power of two
+
+	//consumer side
+	_Alignas(ATSC3_SPSC_RING_CACHE_LINE)
+	atomic_uint			head;
+	uint32_t			tail_cached;
+
+	//producer side
+	_Alignas(ATSC3_SPSC_RING_CACHE_LINE)
+	atomic_uint			tail;
+	uint32_t			head_cached;
+	uint64_t			push_full;		//pushes refused because the consumer fell behind
+	uint32_t			depth_high_water;
+} atsc3_spsc_ring_t;
+
+//capacity is rounded up to a power of two
+int atsc3_spsc_ring_init(atsc3_spsc_ring_t* ring, uint32_t capacity);
+
+static inline uint32_t atsc3_spsc_ring_capacity(const atsc3_spsc_ring_t* ring) {
+	return ring->mask + 1;
+}
+
+//producer only, returns -1 if the ring is full and item still belongs to the caller
+static inline int atsc3_spsc_ring_push(atsc3_spsc_ring_t* ring, void* item) {
+	uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+	if(tail - ring->head_cached > ring->mask) {
+		ring->head_cached = atomic_load_explicit(&ring->head, memory_order_acquire);
+		if(tail - ring->head_cached > ring->mask) {
+			ring->push_full++;
+			return -1;
+		}
+	}
+
+	ring->slots[tail & ring->mask] = item;
+	atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+
+	if(tail + 1 - ring->head_cached > ring->depth_high_water) {
+		ring->depth_high_water = tail + 1 - ring->head_cached;
+	}
+
+	return 0;
+}
+
+//consumer only, NULL if the ring is empty
+static inline void* atsc3_spsc_ring_pop(atsc3_spsc_ring_t* ring) {
+	uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+	if(head == ring->tail_cached) {
+		ring->tail_cached = atomic_load_explicit(&ring->tail, memory_order_acquire);
+		if(head == ring->tail_cached) {
+			return NULL;
+		}
+	}
+
+	void* item = ring->slots[head & ring->mask];
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+	return item;
+}
+
+void atsc3_spsc_ring_stats_dump(atsc3_spsc_ring_t* ring, const char* name);
+
+//both threads must be done with the ring, items still queued are not released
+void atsc3_spsc_ring_free(atsc3_spsc_ring_t* ring);
+
+#endif /* MODULES_DEMUX_MMT_ATSC3_SPSC_RING_H_ */
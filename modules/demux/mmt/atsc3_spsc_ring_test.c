@@ -0,0 +1,163 @@
+/*
+ *
+ * atsc3_spsc_ring_test.c:  driver for the receive -> demux thread handoff ring
+ *
+ */
+
+#include "atsc3_spsc_ring.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define __UNIT_TEST 1
+#ifdef __UNIT_TEST
+
+#define TEST_THREADED_ITEMS	2000000
+
+int test_atsc3_spsc_ring_full_empty();
+int test_atsc3_spsc_ring_wraparound();
+int test_atsc3_spsc_ring_threaded();
+
+int main() {
+	int failed = 0;
+
+	failed |= test_atsc3_spsc_ring_full_empty();
+	failed |= test_atsc3_spsc_ring_wraparound();
+	failed |= test_atsc3_spsc_ring_threaded();
+
+	return failed;
+}
+
+int test_atsc3_spsc_ring_full_empty() {
+	atsc3_spsc_ring_t ring;
+
+	//rounded up to 8
+	if(atsc3_spsc_ring_init(&ring, 5) || atsc3_spsc_ring_capacity(&ring) != 8) {
+		_ATSC3_SPSC_RING_ERROR("test_atsc3_spsc_ring_full_empty: capacity not rounded to 8");
+		return -1;
+	}
+
+	if(atsc3_spsc_ring_pop(&ring)) {
+		_ATSC3_SPSC_RING_ERROR("test_atsc3_spsc_ring_full_empty: pop from an empty ring");
+		return -1;
+	}
+
+	for(uintptr_t i=1; i <= 8; i++) {
+		if(atsc3_spsc_ring_push(&ring, (void*)i)) {
+			_ATSC3_SPSC_RING_ERROR("test_atsc3_spsc_ring_full_empty: push %lu refused", (unsigned long)i);
+			return -1;
+		}
+	}
+
+	if(!atsc3_spsc_ring_push(&ring, (void*)9) || ring.push_full != 1 || ring.depth_high_water != 8) {
+		_ATSC3_SPSC_RING_ERROR("test_atsc3_spsc_ring_full_empty: full ring accepted a push");
+		return -1;
+	}
+
+	for(uintptr_t i=1; i <= 8; i++) {
+		if((uintptr_t)atsc3_spsc_ring_pop(&ring) != i) {
+			_ATSC3_SPSC_RING_ERROR("test_atsc3_spsc_ring_full_empty: pop %lu out of order", (unsigned long)i);
+			return -1;
+		}
+	}
+
+	if(atsc3_spsc_ring_pop(&ring)) {
+		_ATSC3_SPSC_RING_ERROR("test_atsc3_spsc_ring_full_empty: drained ring not empty");
+		return -1;
+	}
+
+	atsc3_spsc_ring_free(&ring);
+	return 0;
+}
+
+//head and tail are free running, make sure they index correctly across the 32 bit wrap
+int test_atsc3_spsc_ring_wraparound() {
+	atsc3_spsc_ring_t ring;
+	atsc3_spsc_ring_init(&ring, 4);
+
+	atomic_store(&ring.head, UINT32_MAX - 2);
+	atomic_store(&ring.tail, UINT32_MAX - 2);
+	ring.head_cached = ring.tail_cached = UINT32_MAX - 2;
+
+	uintptr_t next_pop = 1;
+	for(uintptr_t i=1; i <= 16; i++) {
+		if(atsc3_spsc_ring_push(&ring, (void*)i)) {
+			_ATSC3_SPSC_RING_ERROR("test_atsc3_spsc_ring_wraparound: push %lu refused", (unsigned long)i);
+			return -1;
+		}
+		if(i % 3 == 0) {
+			while(next_pop <= i) {
+				if((uintptr_t)atsc3_spsc_ring_pop(&ring) != next_pop) {
+					_ATSC3_SPSC_RING_ERROR("test_atsc3_spsc_ring_wraparound: expected %lu", (unsigned long)next_pop);
+					return -1;
+				}
+				next_pop++;
+			}
+		}
+	}
+
+	atsc3_spsc_ring_free(&ring);
+	return 0;
+}
+
+typedef struct test_producer {
+	atsc3_spsc_ring_t*	ring;
+	uint64_t			pushed;
+} test_producer_t;
+
+void* __test_producer(void* arg) {
+	test_producer_t* producer = arg;
+	for(uintptr_t i=1; i <= TEST_THREADED_ITEMS; i++) {
+		while(atsc3_spsc_ring_push(producer->ring, (void*)i)) {
+			sched_yield();
+		}
+		producer->pushed++;
+	}
+	return NULL;
+}
+
+//a small ring forces both full and empty handoffs between the two threads
+int test_atsc3_spsc_ring_threaded() {
+	atsc3_spsc_ring_t ring;
+	atsc3_spsc_ring_init(&ring, 64);
+
+	test_producer_t producer = { &ring, 0 };
+	pthread_t producer_thread;
+	if(pthread_create(&producer_thread, NULL, __test_producer, &producer)) {
+		_ATSC3_SPSC_RING_ERROR("test_atsc3_spsc_ring_threaded: pthread_create failed");
+		return -1;
+	}
+
+	uintptr_t expected = 1;
+	while(expected <= TEST_THREADED_ITEMS) {
+		void* item = atsc3_spsc_ring_pop(&ring);
+		if(!item) {
+			sched_yield();
+			continue;
+		}
+		if((uintptr_t)item != expected) {
+			_ATSC3_SPSC_RING_ERROR("test_atsc3_spsc_ring_threaded: got %lu, expected %lu", (unsigned long)(uintptr_t)item, (unsigned long)expected);
+			pthread_join(producer_thread, NULL);
+			return -1;
+		}
+		expected++;
+	}
+
+	pthread_join(producer_thread, NULL);
+
+	if(producer.pushed != TEST_THREADED_ITEMS || atsc3_spsc_ring_pop(&ring)) {
+		_ATSC3_SPSC_RING_ERROR("test_atsc3_spsc_ring_threaded: pushed: %llu", (unsigned long long)producer.pushed);
+		return -1;
+	}
+
+	atsc3_spsc_ring_stats_dump(&ring, "test_atsc3_spsc_ring_threaded");
+	atsc3_spsc_ring_free(&ring);
+	return 0;
+}
+
+#endif
@@ -0,0 +1,184 @@
+/*
+ * atsc3_trace.c
+ *
+ *  Created on: Feb 21, 2019
+ *      Author: jjustman
+ */
+
+#include "atsc3_trace.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ATSC3_TRACE_LINE_MAX 1024
+
+atomic_int atsc3_trace_level = ATSC3_TRACE_LEVEL_WARN;
+
+//guards the sink list, the levels and the calls in flight, never held across a sink call
+static pthread_mutex_t		__atsc3_trace_lock = PTHREAD_MUTEX_INITIALIZER;
+//signaled when the last call in flight on a sink returns
+static pthread_cond_t		__atsc3_trace_idle = PTHREAD_COND_INITIALIZER;
+static atsc3_trace_sink_t*	__atsc3_trace_sinks;
+static int					__atsc3_trace_stdout_level = ATSC3_TRACE_LEVEL_WARN;
+
+static const char* __atsc3_trace_level_names[] = { "NONE ", "ERROR", "WARN ", "INFO ", "DEBUG", "TRACE" };
+
+static const char* __atsc3_trace_event_names[ATSC3_TRACE_EVENT_MAX] = {
+	"none",
+	"packet",
+	"packet_dropped",
+	"packet_released",
+	"fec_recovered",
+	"mpu_fragment",
+	"sample",
+	"pcr"
+};
+
+static int __atsc3_trace_clamp_level(int level) {
+	if(level < ATSC3_TRACE_LEVEL_NONE) {
+		return ATSC3_TRACE_LEVEL_NONE;
+	} else if(level > ATSC3_TRACE_LEVEL_TRACE) {
+		return ATSC3_TRACE_LEVEL_TRACE;
+	}
+	return level;
+}
+
+//with the lock held
+static void __atsc3_trace_update_level() {
+	int level = __atsc3_trace_sinks ? ATSC3_TRACE_LEVEL_NONE : __atsc3_trace_stdout_level;
+	for(atsc3_trace_sink_t* trace_sink = __atsc3_trace_sinks; trace_sink; trace_sink = trace_sink->next) {
+		if(trace_sink->level > level) {
+			level = trace_sink->level;
+		}
+	}
+	atomic_store_explicit(&atsc3_trace_level, level, memory_order_relaxed);
+}
+
+void atsc3_trace_set_level(int level) {
+	pthread_mutex_lock(&__atsc3_trace_lock);
+	__atsc3_trace_stdout_level = __atsc3_trace_clamp_level(level);
+	__atsc3_trace_update_level();
+	pthread_mutex_unlock(&__atsc3_trace_lock);
+}
+
+void atsc3_trace_sink_register(atsc3_trace_sink_t* trace_sink, atsc3_trace_sink_f sink, void* context, int level) {
+	trace_sink->sink = sink;
+	trace_sink->context = context;
+	trace_sink->level = __atsc3_trace_clamp_level(level);
+	trace_sink->calls = 0;
+	trace_sink->next = NULL;
+
+	//appended, lines keep going to the first sink registered while it stays
+	pthread_mutex_lock(&__atsc3_trace_lock);
+	atsc3_trace_sink_t** link = &__atsc3_trace_sinks;
+	while(*link) {
+		link = &(*link)->next;
+	}
+	*link = trace_sink;
+	__atsc3_trace_update_level();
+	pthread_mutex_unlock(&__atsc3_trace_lock);
+}
+
+void atsc3_trace_sink_unregister(atsc3_trace_sink_t* trace_sink) {
+	pthread_mutex_lock(&__atsc3_trace_lock);
+	for(atsc3_trace_sink_t** link = &__atsc3_trace_sinks; *link; link = &(*link)->next) {
+		if(*link == trace_sink) {
+			*link = trace_sink->next;
+			break;
+		}
+	}
+	__atsc3_trace_update_level();
+
+	//no new call can pick it up now, wait out the ones that did
+	while(trace_sink->calls) {
+		pthread_cond_wait(&__atsc3_trace_idle, &__atsc3_trace_lock);
+	}
+	pthread_mutex_unlock(&__atsc3_trace_lock);
+	trace_sink->next = NULL;
+}
+
+void atsc3_trace_log(int level, const char* file, int line, const char* format, ...) {
+	char message[ATSC3_TRACE_LINE_MAX];
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(message, sizeof(message), format, args);
+	va_end(args);
+
+	//printf style sites end their own lines
+	if(length > 0 && (size_t)length < sizeof(message) && message[length - 1] == '\n') {
+		message[length - 1] = '\0';
+	}
+
+	//with sinks registered the level is the highest of theirs, they all share the first one
+	if(level > atomic_load_explicit(&atsc3_trace_level, memory_order_relaxed)) {
+		return;
+	}
+
+	pthread_mutex_lock(&__atsc3_trace_lock);
+	atsc3_trace_sink_t* trace_sink = __atsc3_trace_sinks;
+	if(trace_sink) {
+		trace_sink->calls++;
+	}
+	pthread_mutex_unlock(&__atsc3_trace_lock);
+
+	if(trace_sink) {
+		trace_sink->sink(trace_sink->context, level, file, line, message);
+
+		pthread_mutex_lock(&__atsc3_trace_lock);
+		if(!--trace_sink->calls) {
+			pthread_cond_broadcast(&__atsc3_trace_idle);
+		}
+		pthread_mutex_unlock(&__atsc3_trace_lock);
+		return;
+	}
+	printf("%s:%d:%s:%s\n", file, line, __atsc3_trace_level_names[level > ATSC3_TRACE_LEVEL_TRACE ? ATSC3_TRACE_LEVEL_TRACE : level], message);
+}
+
+int atsc3_trace_ring_init(atsc3_trace_ring_t* ring, uint32_t capacity) {
+	memset(ring, 0, sizeof(atsc3_trace_ring_t));
+	if(!capacity) {
+		return 0;
+	}
+	if(capacity > ATSC3_TRACE_RING_MAX_CAPACITY) {
+		capacity = ATSC3_TRACE_RING_MAX_CAPACITY;
+	}
+
+	uint32_t rounded = 1;
+	while(rounded < capacity) {
+		rounded <<= 1;
+	}
+
+	ring->events = calloc(rounded, sizeof(atsc3_trace_event_t));
+	if(!ring->events) {
+		return -1;
+	}
+	ring->mask = rounded - 1;
+	return 0;
+}
+
+const char* atsc3_trace_event_name(uint16_t event_id) {
+	return event_id < ATSC3_TRACE_EVENT_MAX ? __atsc3_trace_event_names[event_id] : "unknown";
+}
+
+size_t atsc3_trace_ring_dump(atsc3_trace_ring_t* ring, FILE* fp) {
+	if(!ring->events) {
+		return 0;
+	}
+
+	uint64_t capacity = (uint64_t)ring->mask + 1;
+	uint64_t first = ring->written > capacity ? ring->written - capacity : 0;
+	for(uint64_t i = first; i < ring->written; i++) {
+		const atsc3_trace_event_t* event = &ring->events[i & ring->mask];
+		fprintf(fp, "%" PRId64 " %-16s packet_id: %5hu, a: %10u, b: %10u, c: %" PRId64 "\n",
+				event->time_us, atsc3_trace_event_name(event->event_id), event->packet_id, event->a, event->b, event->c);
+	}
+	return ring->written - first;
+}
+
+void atsc3_trace_ring_free(atsc3_trace_ring_t* ring) {
+	free(ring->events);
+	memset(ring, 0, sizeof(atsc3_trace_ring_t));
+}
@@ -0,0 +1,164 @@
+/*
+ * atsc3_trace.h
+ *
+ *  Created on: Feb 21, 2019
+ *      Author: jjustman
+ *
+ * leveled logging and a binary event ring for the per-packet paths.
+ *
+ * text: _ATSC3_TRACE(level, ...) checks the level before any argument is evaluated, and sites above
+ * ATSC3_TRACE_COMPILE_LEVEL are removed by the compiler altogether (build with e.g.
+ * -DATSC3_TRACE_COMPILE_LEVEL=ATSC3_TRACE_LEVEL_TRACE to keep them).
+ *
+ * trace sites carry no instance, so there is a single process wide sink: its context must not belong
+ * to any one user (e.g. a demuxer), or lines from every other user would be attributed to it. each user
+ * registers the shared sink and its level in a sink struct it owns, lines go to the first one still
+ * registered at the highest level of them all, and to stdout at the atsc3_trace_set_level level
+ * (ATSC3_TRACE_LEVEL_WARN) while there is none. unregistering waits for the calls in flight on that
+ * sink struct.
+ *
+ * events: fixed size records (no formatting) into a power of two ring that overwrites its oldest
+ * entries, so the last few thousand packets can be dumped when something goes wrong. a ring has a
+ * single writer, recording and dumping must happen on the same thread.
+ */
+
+#ifndef MODULES_DEMUX_MMT_ATSC3_TRACE_H_
+#define MODULES_DEMUX_MMT_ATSC3_TRACE_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define ATSC3_TRACE_LEVEL_NONE	0
+#define ATSC3_TRACE_LEVEL_ERROR	1
+#define ATSC3_TRACE_LEVEL_WARN	2
+#define ATSC3_TRACE_LEVEL_INFO	3
+#define ATSC3_TRACE_LEVEL_DEBUG	4
+#define ATSC3_TRACE_LEVEL_TRACE	5
+
+#ifndef ATSC3_TRACE_COMPILE_LEVEL
+#define ATSC3_TRACE_COMPILE_LEVEL ATSC3_TRACE_LEVEL_DEBUG
+#endif
+
+//compile with -DATSC3_TRACE_EVENTS=0 to remove every event site
+#ifndef ATSC3_TRACE_EVENTS
+#define ATSC3_TRACE_EVENTS 1
+#endif
+
+//highest level of any registered sink, only a cheap check before a line is formatted
+extern atomic_int atsc3_trace_level;
+
+#define ATSC3_TRACE_ENABLED(level) ((level) <= ATSC3_TRACE_COMPILE_LEVEL && \
+		(level) <= atomic_load_explicit(&atsc3_trace_level, memory_order_relaxed))
+
+#define _ATSC3_TRACE(level, ...) do { \
+		if(ATSC3_TRACE_ENABLED(level)) { \
+			atsc3_trace_log(level, __FILE__, __LINE__, __VA_ARGS__); \
+		} \
+	} while(0)
+
+#define _ATSC3_TRACE_ERROR(...) _ATSC3_TRACE(ATSC3_TRACE_LEVEL_ERROR, __VA_ARGS__)
+#define _ATSC3_TRACE_WARN(...)  _ATSC3_TRACE(ATSC3_TRACE_LEVEL_WARN, __VA_ARGS__)
+#define _ATSC3_TRACE_INFO(...)  _ATSC3_TRACE(ATSC3_TRACE_LEVEL_INFO, __VA_ARGS__)
+#define _ATSC3_TRACE_DEBUG(...) _ATSC3_TRACE(ATSC3_TRACE_LEVEL_DEBUG, __VA_ARGS__)
+#define _ATSC3_TRACE_TRACE(...) _ATSC3_TRACE(ATSC3_TRACE_LEVEL_TRACE, __VA_ARGS__)
+
+//the line is only valid for the duration of the call
+typedef void (*atsc3_trace_sink_f)(void* context, int level, const char* file, int line, const char* message);
+
+typedef struct atsc3_trace_sink {
+	atsc3_trace_sink_f			sink;
+	void*						context;
+	int							level;
+	unsigned					calls;		//in flight, unregister waits for them
+	struct atsc3_trace_sink*	next;		//registered after this one
+} atsc3_trace_sink_t;
+
+//level of the lines printed to stdout while no sink is registered
+void atsc3_trace_set_level(int level);
+
+void atsc3_trace_sink_register(atsc3_trace_sink_t* trace_sink, atsc3_trace_sink_f sink, void* context, int level);
+
+//returns once no line is being sent through trace_sink
+void atsc3_trace_sink_unregister(atsc3_trace_sink_t* trace_sink);
+
+void atsc3_trace_log(int level, const char* file, int line, const char* format, ...)
+#if defined(__GNUC__)
+	__attribute__((format(printf, 4, 5)))
+#endif
+	;
+
+/**
+ * events
+ */
+
+typedef enum atsc3_trace_event_id {
+	ATSC3_TRACE_EVENT_NONE = 0,
+	ATSC3_TRACE_EVENT_PACKET,			//a: packet_sequence_number, b: payload_type << 16 | length, c: mmtp_timestamp
+	ATSC3_TRACE_EVENT_PACKET_DROPPED,	//a: reason, b: length, c: packet_sequence_number if late
+	ATSC3_TRACE_EVENT_PACKET_RELEASED,	//a: packet_sequence_number, b: packets lost so far on its packet_id, in sequence order
+	ATSC3_TRACE_EVENT_FEC_RECOVERED,	//a: packet_sequence_number
+	ATSC3_TRACE_EVENT_MPU_FRAGMENT,		//a: mpu_sequence_number, b: fragment_type << 16 | fragmentation_indicator << 8 | counter, c: length
+	ATSC3_TRACE_EVENT_SAMPLE,			//a: mpu_sequence_number, b: sample_number, c: dts
+	ATSC3_TRACE_EVENT_PCR,				//a: service_id, 0 for single stream input, c: pcr
+	ATSC3_TRACE_EVENT_MAX
+} atsc3_trace_event_id_t;
+
+//ATSC3_TRACE_EVENT_PACKET_DROPPED reasons
+#define ATSC3_TRACE_DROP_SIZE			1
+#define ATSC3_TRACE_DROP_HEADER			2
+#define ATSC3_TRACE_DROP_FEC_PAYLOAD_ID	3
+#define ATSC3_TRACE_DROP_LATE			4
+
+typedef struct atsc3_trace_event {
+	int64_t		time_us;
+	uint16_t	event_id;
+	uint16_t	packet_id;
+	uint32_t	a;
+	uint32_t	b;
+	int64_t		c;
+} atsc3_trace_event_t;
+
+//upper bound on ring capacity, the events are allocated up front
+#define ATSC3_TRACE_RING_MAX_CAPACITY	(1 << 20)
+
+typedef struct atsc3_trace_ring {
+	atsc3_trace_event_t*	events;
+	uint32_t				mask;		//capacity - 1, 0 if the ring is disabled
+	uint64_t				written;	//events ever recorded, the oldest are overwritten
+} atsc3_trace_ring_t;
+
+//capacity is rounded up to a power of two, 0 leaves the ring disabled
+int atsc3_trace_ring_init(atsc3_trace_ring_t* ring, uint32_t capacity);
+
+static inline void atsc3_trace_ring_record(atsc3_trace_ring_t* ring, int64_t time_us, atsc3_trace_event_id_t event_id, uint16_t packet_id,
+		uint32_t a, uint32_t b, int64_t c) {
+	if(!ring->events) {
+		return;
+	}
+	atsc3_trace_event_t* event = &ring->events[ring->written++ & ring->mask];
+	event->time_us = time_us;
+	event->event_id = event_id;
+	event->packet_id = packet_id;
+	event->a = a;
+	event->b = b;
+	event->c = c;
+}
+
+#if ATSC3_TRACE_EVENTS
+#define _ATSC3_TRACE_EVENT(ring, time_us, event_id, packet_id, a, b, c) atsc3_trace_ring_record(ring, time_us, event_id, packet_id, a, b, c)
+#else
+//never evaluated, only keeps the arguments referenced
+#define _ATSC3_TRACE_EVENT(ring, time_us, event_id, packet_id, a, b, c) do { if(0) { atsc3_trace_ring_record(ring, time_us, event_id, packet_id, a, b, c); } } while(0)
+#endif
+
+const char* atsc3_trace_event_name(uint16_t event_id);
+
+//oldest first, one line per event. returns the number of events written
+size_t atsc3_trace_ring_dump(atsc3_trace_ring_t* ring, FILE* fp);
+
+void atsc3_trace_ring_free(atsc3_trace_ring_t* ring);
+
+#endif /* MODULES_DEMUX_MMT_ATSC3_TRACE_H_ */
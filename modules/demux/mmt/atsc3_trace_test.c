@@ -0,0 +1,207 @@
+/*
+ *
+ * atsc3_trace_test.c:  driver for leveled trace lines and the per-packet event ring
+ *
+ */
+
+#include "atsc3_trace.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define __UNIT_TEST 1
+#ifdef __UNIT_TEST
+
+static int __test_evaluated;
+static int __test_sink_calls;
+static int __test_sink_level;
+static char __test_sink_message[256];
+
+int __test_side_effect() {
+	return ++__test_evaluated;
+}
+
+//context counts the lines this sink got
+void __test_sink(void* context, int level, const char* file, int line, const char* message) {
+	__test_sink_calls++;
+	__test_sink_level = level;
+	snprintf(__test_sink_message, sizeof(__test_sink_message), "%s", message);
+	if(context) {
+		(*(int*)context)++;
+	}
+}
+
+int test_atsc3_trace_level();
+int test_atsc3_trace_sink();
+int test_atsc3_trace_sink_instances();
+int test_atsc3_trace_ring_overwrite();
+int test_atsc3_trace_ring_disabled();
+
+int main() {
+	int failed = 0;
+
+	failed |= test_atsc3_trace_level();
+	failed |= test_atsc3_trace_sink();
+	failed |= test_atsc3_trace_sink_instances();
+	failed |= test_atsc3_trace_ring_overwrite();
+	failed |= test_atsc3_trace_ring_disabled();
+
+	return failed;
+}
+
+//arguments of disabled lines are never evaluated, trace lines are compiled out whatever the runtime level
+int test_atsc3_trace_level() {
+	atsc3_trace_sink_t trace_sink;
+	atsc3_trace_sink_register(&trace_sink, __test_sink, NULL, ATSC3_TRACE_LEVEL_WARN);
+	__test_evaluated = 0;
+	__test_sink_calls = 0;
+
+	_ATSC3_TRACE_DEBUG("debug: %d", __test_side_effect());
+	_ATSC3_TRACE_INFO("info: %d", __test_side_effect());
+	if(__test_evaluated || __test_sink_calls) {
+		printf("test_atsc3_trace_level: disabled lines evaluated: %d, sent: %d\n", __test_evaluated, __test_sink_calls);
+		atsc3_trace_sink_unregister(&trace_sink);
+		return -1;
+	}
+
+	_ATSC3_TRACE_WARN("warn: %d", __test_side_effect());
+	atsc3_trace_sink_unregister(&trace_sink);
+	if(__test_evaluated != 1 || __test_sink_calls != 1 || __test_sink_level != ATSC3_TRACE_LEVEL_WARN) {
+		printf("test_atsc3_trace_level: warn line evaluated: %d, sent: %d\n", __test_evaluated, __test_sink_calls);
+		return -1;
+	}
+
+	atsc3_trace_sink_register(&trace_sink, __test_sink, NULL, ATSC3_TRACE_LEVEL_TRACE + 10);
+	if(trace_sink.level != ATSC3_TRACE_LEVEL_TRACE || atomic_load(&atsc3_trace_level) != ATSC3_TRACE_LEVEL_TRACE) {
+		printf("test_atsc3_trace_level: level not clamped: %d\n", atomic_load(&atsc3_trace_level));
+		atsc3_trace_sink_unregister(&trace_sink);
+		return -1;
+	}
+	_ATSC3_TRACE_TRACE("trace: %d", __test_side_effect());
+	atsc3_trace_sink_unregister(&trace_sink);
+	if(__test_evaluated != 1 || __test_sink_calls != 1) {
+		printf("test_atsc3_trace_level: trace line not compiled out\n");
+		return -1;
+	}
+
+	atsc3_trace_sink_register(&trace_sink, __test_sink, NULL, ATSC3_TRACE_LEVEL_NONE);
+	_ATSC3_TRACE_ERROR("error: %d", __test_side_effect());
+	atsc3_trace_sink_unregister(&trace_sink);
+	if(__test_evaluated != 1 || __test_sink_calls != 1) {
+		printf("test_atsc3_trace_level: error line sent at level none\n");
+		return -1;
+	}
+
+	//back to the stdout level once no sink is left
+	if(atomic_load(&atsc3_trace_level) != ATSC3_TRACE_LEVEL_WARN) {
+		printf("test_atsc3_trace_level: level not restored: %d\n", atomic_load(&atsc3_trace_level));
+		return -1;
+	}
+	return 0;
+}
+
+//printf style lines lose their trailing newline on the way to the sink
+int test_atsc3_trace_sink() {
+	atsc3_trace_sink_t trace_sink;
+	atsc3_trace_sink_register(&trace_sink, __test_sink, NULL, ATSC3_TRACE_LEVEL_WARN);
+	_ATSC3_TRACE_ERROR("packet_id: %hu, dropped\n", (uint16_t)35);
+	atsc3_trace_sink_unregister(&trace_sink);
+	if(strcmp(__test_sink_message, "packet_id: 35, dropped") || __test_sink_level != ATSC3_TRACE_LEVEL_ERROR) {
+		printf("test_atsc3_trace_sink: got '%s', level: %d\n", __test_sink_message, __test_sink_level);
+		return -1;
+	}
+	return 0;
+}
+
+//two users share the first sink registered, at the highest level of the two, until it is unregistered
+int test_atsc3_trace_sink_instances() {
+	int first_lines = 0;
+	int second_lines = 0;
+	atsc3_trace_sink_t first;
+	atsc3_trace_sink_t second;
+	atsc3_trace_sink_register(&first, __test_sink, &first_lines, ATSC3_TRACE_LEVEL_WARN);
+	atsc3_trace_sink_register(&second, __test_sink, &second_lines, ATSC3_TRACE_LEVEL_DEBUG);
+
+	//enabled by the second user, still sent to the shared first sink
+	_ATSC3_TRACE_DEBUG("debug");
+	_ATSC3_TRACE_WARN("warn");
+	atsc3_trace_sink_unregister(&first);
+	_ATSC3_TRACE_DEBUG("debug");
+	int level = atomic_load(&atsc3_trace_level);
+	atsc3_trace_sink_unregister(&second);
+
+	if(first_lines != 2 || second_lines != 1 || level != ATSC3_TRACE_LEVEL_DEBUG) {
+		printf("test_atsc3_trace_sink_instances: first: %d, second: %d, level: %d\n", first_lines, second_lines, level);
+		return -1;
+	}
+
+	//a later user does not take the lines over
+	atsc3_trace_sink_register(&first, __test_sink, &first_lines, ATSC3_TRACE_LEVEL_WARN);
+	atsc3_trace_sink_register(&second, __test_sink, &second_lines, ATSC3_TRACE_LEVEL_WARN);
+	_ATSC3_TRACE_WARN("warn");
+	atsc3_trace_sink_unregister(&second);
+	_ATSC3_TRACE_WARN("warn");
+	atsc3_trace_sink_unregister(&first);
+	if(first_lines != 4 || second_lines != 1) {
+		printf("test_atsc3_trace_sink_instances: after the second closed, first: %d, second: %d\n", first_lines, second_lines);
+		return -1;
+	}
+	return 0;
+}
+
+//a capacity of 5 is rounded to 8, after 20 events the last 8 are dumped oldest first
+int test_atsc3_trace_ring_overwrite() {
+	atsc3_trace_ring_t ring;
+	if(atsc3_trace_ring_init(&ring, 5) || ring.mask != 7) {
+		printf("test_atsc3_trace_ring_overwrite: ring not rounded up, mask: %u\n", ring.mask);
+		return -1;
+	}
+
+	for(uint32_t i = 0; i < 20; i++) {
+		_ATSC3_TRACE_EVENT(&ring, 1000 + i, ATSC3_TRACE_EVENT_PACKET, 35, i, 0, 0);
+	}
+
+	FILE* fp = tmpfile();
+	size_t dumped = atsc3_trace_ring_dump(&ring, fp);
+	atsc3_trace_ring_free(&ring);
+	if(dumped != 8) {
+		printf("test_atsc3_trace_ring_overwrite: dumped %zu events\n", dumped);
+		fclose(fp);
+		return -1;
+	}
+
+	rewind(fp);
+	char line[256];
+	int lines = 0;
+	while(fgets(line, sizeof(line), fp)) {
+		long long time_us;
+		char name[32];
+		unsigned packet_id, a;
+		if(sscanf(line, "%lld %31s packet_id: %u, a: %u", &time_us, name, &packet_id, &a) != 4 ||
+				time_us != 1012 + lines || strcmp(name, "packet") || packet_id != 35 || a != 12 + lines) {
+			printf("test_atsc3_trace_ring_overwrite: line %d: %s", lines, line);
+			fclose(fp);
+			return -1;
+		}
+		lines++;
+	}
+	fclose(fp);
+	return lines == 8 ? 0 : -1;
+}
+
+int test_atsc3_trace_ring_disabled() {
+	atsc3_trace_ring_t ring;
+	atsc3_trace_ring_init(&ring, 0);
+	_ATSC3_TRACE_EVENT(&ring, 0, ATSC3_TRACE_EVENT_PCR, 0, 0, 0, 0);
+	if(ring.written || atsc3_trace_ring_dump(&ring, stdout)) {
+		printf("test_atsc3_trace_ring_disabled: events recorded\n");
+		return -1;
+	}
+	atsc3_trace_ring_free(&ring);
+	return 0;
+}
+
+#endif
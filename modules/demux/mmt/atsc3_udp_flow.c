@@ -0,0 +1,172 @@
+/*
+ * atsc3_udp_flow.c
+ *
+ *  Created on: Feb 10, 2019
+ *      Author: jjustman
+ */
+
+#include "atsc3_udp_flow.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define UDP_FLOW_IPV4_MIN_HEADER_LEN	20
+#define UDP_FLOW_UDP_HEADER_LEN			8
+#define UDP_FLOW_IP_PROTOCOL_UDP		0x11
+
+int udp_flow_parse_ipv4(uint8_t* buf, size_t len, udp_flow_t* udp_flow, uint8_t** payload, size_t* payload_len) {
+	atsc3_cursor_t cursor;
+	atsc3_cursor_init(&cursor, buf, len);
+
+	uint8_t version_ihl = atsc3_cursor_read_u8(&cursor);
+	size_t ip_header_len = (version_ihl & 0x0F) * 4;
+	if((version_ihl >> 4) != 4 || ip_header_len < UDP_FLOW_IPV4_MIN_HEADER_LEN || len < ip_header_len + UDP_FLOW_UDP_HEADER_LEN) {
+		return -1;
+	}
+
+	atsc3_cursor_skip(&cursor, 1); //tos
+	uint16_t total_len = atsc3_cursor_read_u16(&cursor);
+	atsc3_cursor_skip(&cursor, 2); //identification
+	uint16_t flags_fragment_offset = atsc3_cursor_read_u16(&cursor);
+	atsc3_cursor_skip(&cursor, 1); //ttl
+	uint8_t protocol = atsc3_cursor_read_u8(&cursor);
+	atsc3_cursor_skip(&cursor, 2); //header checksum
+	udp_flow->src_ip_addr = atsc3_cursor_read_u32(&cursor);
+	udp_flow->dst_ip_addr = atsc3_cursor_read_u32(&cursor);
+
+	//more fragments set or a non-zero offset, we don't reassemble ip fragments
+	if(protocol != UDP_FLOW_IP_PROTOCOL_UDP || (flags_fragment_offset & 0x3FFF)) {
+		return -1;
+	}
+
+	//trailing link layer padding is not part of the datagram
+	if(total_len >= ip_header_len + UDP_FLOW_UDP_HEADER_LEN && total_len < len) {
+		len = total_len;
+	}
+
+	atsc3_cursor_init(&cursor, buf + ip_header_len, len - ip_header_len);
+	udp_flow->src_port = atsc3_cursor_read_u16(&cursor);
+	udp_flow->dst_port = atsc3_cursor_read_u16(&cursor);
+	uint16_t udp_len = atsc3_cursor_read_u16(&cursor);
+	atsc3_cursor_skip(&cursor, 2); //checksum
+
+	if(cursor.overrun || udp_len < UDP_FLOW_UDP_HEADER_LEN || udp_len > len - ip_header_len) {
+		return -1;
+	}
+
+	*payload = buf + ip_header_len + UDP_FLOW_UDP_HEADER_LEN;
+	*payload_len = udp_len - UDP_FLOW_UDP_HEADER_LEN;
+
+	return 0;
+}
+
+int udp_flow_parse_ip_addr(const char* ip_addr_s, uint32_t* ip_addr) {
+	if(!ip_addr_s) {
+		return -1;
+	}
+
+	uint32_t addr = 0;
+	const char* p = ip_addr_s;
+	for(int octet=0; octet < 4; octet++) {
+		if(*p < '0' || *p > '9') {
+			return -1;
+		}
+		unsigned value = 0;
+		while(*p >= '0' && *p <= '9') {
+			value = value * 10 + (*p++ - '0');
+			if(value > 255) {
+				return -1;
+			}
+		}
+		if(octet < 3 && *p++ != '.') {
+			return -1;
+		}
+		addr = (addr << 8) | value;
+	}
+
+	if(*p) {
+		return -1;
+	}
+
+	*ip_addr = addr;
+	return 0;
+}
+
+udp_flow_service_t* udp_flow_service_map_find(udp_flow_service_map_t* udp_flow_service_map, uint32_t dst_ip_addr, uint16_t dst_port) {
+	for(size_t i=0; i < udp_flow_service_map->services_n; i++) {
+		udp_flow_service_t* udp_flow_service = &udp_flow_service_map->services[i];
+		if(udp_flow_service->dst_ip_addr == dst_ip_addr && udp_flow_service->dst_port == dst_port) {
+			return udp_flow_service;
+		}
+	}
+	return NULL;
+}
+
+udp_flow_service_t* udp_flow_service_map_find_service_id(udp_flow_service_map_t* udp_flow_service_map, uint16_t service_id) {
+	for(size_t i=0; i < udp_flow_service_map->services_n; i++) {
+		if(udp_flow_service_map->services[i].service_id == service_id) {
+			return &udp_flow_service_map->services[i];
+		}
+	}
+	return NULL;
+}
+
+int udp_flow_service_map_update_from_slt(udp_flow_service_map_t* udp_flow_service_map, slt_table_t* slt_table) {
+	int changed = 0;
+
+	for(int i=0; i < slt_table->service_entry_n; i++) {
+		service_t* service = slt_table->service_entry[i];
+		broadcast_svc_signaling_t* broadcast_svc_signaling = &service->broadcast_svc_signaling;
+
+		uint32_t dst_ip_addr;
+		if(!broadcast_svc_signaling->sls_destination_udp_port || udp_flow_parse_ip_addr(broadcast_svc_signaling->sls_destination_ip_address, &dst_ip_addr)) {
+			_UDP_FLOW_DEBUG("udp_flow_service_map_update_from_slt: service_id: %hu has no BroadcastSvcSignaling flow", service->service_id);
+			continue;
+		}
+		uint16_t dst_port = (uint16_t)atoi(broadcast_svc_signaling->sls_destination_udp_port);
+
+		udp_flow_service_t* udp_flow_service = udp_flow_service_map_find_service_id(udp_flow_service_map, service->service_id);
+		if(!udp_flow_service) {
+			if(udp_flow_service_map->services_n == udp_flow_service_map->services_capacity) {
+				size_t new_capacity = udp_flow_service_map->services_capacity ? udp_flow_service_map->services_capacity * 2 : 8;
+				udp_flow_service_t* services = realloc(udp_flow_service_map->services, new_capacity * sizeof(udp_flow_service_t));
+				if(!services) {
+					return -1;
+				}
+				udp_flow_service_map->services = services;
+				udp_flow_service_map->services_capacity = new_capacity;
+			}
+			udp_flow_service = &udp_flow_service_map->services[udp_flow_service_map->services_n++];
+			memset(udp_flow_service, 0, sizeof(udp_flow_service_t));
+			udp_flow_service->service_id = service->service_id;
+		} else if(udp_flow_service->dst_ip_addr == dst_ip_addr && udp_flow_service->dst_port == dst_port &&
+				udp_flow_service->sls_protocol == broadcast_svc_signaling->sls_protocol) {
+			udp_flow_service->slt_svc_seq_num = service->slt_svc_seq_num;
+			continue;
+		}
+
+		udp_flow_service->sls_protocol = broadcast_svc_signaling->sls_protocol;
+		udp_flow_service->dst_ip_addr = dst_ip_addr;
+		udp_flow_service->dst_port = dst_port;
+		udp_flow_service->slt_svc_seq_num = service->slt_svc_seq_num;
+
+		free(udp_flow_service->short_service_name);
+		udp_flow_service->short_service_name = service->short_service_name ? strdup(service->short_service_name) : NULL;
+
+		_UDP_FLOW_INFO("udp_flow_service_map: service_id: %hu, sls_protocol: %d, destination: %u.%u.%u.%u:%hu, name: %s",
+				udp_flow_service->service_id, udp_flow_service->sls_protocol,
+				(dst_ip_addr >> 24) & 0xFF, (dst_ip_addr >> 16) & 0xFF, (dst_ip_addr >> 8) & 0xFF, dst_ip_addr & 0xFF, dst_port,
+				udp_flow_service->short_service_name ? udp_flow_service->short_service_name : "");
+		changed++;
+	}
+
+	return changed;
+}
+
+void udp_flow_service_map_free(udp_flow_service_map_t* udp_flow_service_map) {
+	for(size_t i=0; i < udp_flow_service_map->services_n; i++) {
+		free(udp_flow_service_map->services[i].short_service_name);
+	}
+	free(udp_flow_service_map->services);
+	memset(udp_flow_service_map, 0, sizeof(udp_flow_service_map_t));
+}
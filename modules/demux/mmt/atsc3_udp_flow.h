@@ -0,0 +1,86 @@
+/*
+ * atsc3_udp_flow.h
+ *
+ *  Created on: Feb 10, 2019
+ *      Author: jjustman
+ *
+ * ip/udp flow classification for full PLP ingest: one input carries the LLS and every service's
+ * MMTP session on their own destination ip:port, as listed per service in the SLT
+ * (BroadcastSvcSignaling slsDestinationIpAddress / slsDestinationUdpPort).
+ *
+ * udp_flow_parse_ipv4 strips the ipv4/udp headers in place, and udp_flow_service_map keeps the
+ * SLT's destination flow -> service_id mapping so each datagram can be handed to its service.
+ */
+
+#ifndef MODULES_DEMUX_MMT_ATSC3_UDP_FLOW_H_
+#define MODULES_DEMUX_MMT_ATSC3_UDP_FLOW_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "atsc3_lls.h"
+
+#define _UDP_FLOW_PRINTLN(...) printf(__VA_ARGS__);printf("\n")
+#define _UDP_FLOW_ERROR(...)   printf("%s:%d:ERROR:",__FILE__,__LINE__);_UDP_FLOW_PRINTLN(__VA_ARGS__);
+#define _UDP_FLOW_INFO(...)    printf("%s:%d:INFO :",__FILE__,__LINE__);_UDP_FLOW_PRINTLN(__VA_ARGS__);
+#define _UDP_FLOW_DEBUG(...)
+
+//A/331 LLS: 224.0.23.60:4937
+#define UDP_FLOW_LLS_DST_IP_ADDR	0xE000173C
+#define UDP_FLOW_LLS_DST_PORT		4937
+
+//A/331 slsProtocol
+#define UDP_FLOW_SLS_PROTOCOL_ROUTE	1
+#define UDP_FLOW_SLS_PROTOCOL_MMTP	2
+
+typedef struct udp_flow {
+	uint32_t	src_ip_addr;
+	uint32_t	dst_ip_addr;
+	uint16_t	src_port;
+	uint16_t	dst_port;
+} udp_flow_t;
+
+typedef struct udp_flow_service {
+	uint16_t	service_id;
+	int			sls_protocol;
+	uint32_t	dst_ip_addr;
+	uint16_t	dst_port;
+	char*		short_service_name;
+	uint8_t		slt_svc_seq_num;
+} udp_flow_service_t;
+
+typedef struct udp_flow_service_map {
+	udp_flow_service_t*	services;
+	size_t				services_n;
+	size_t				services_capacity;
+} udp_flow_service_map_t;
+
+/**
+ * parse the ipv4 and udp headers at the start of buf, returning the udp payload in place.
+ * returns -1 for anything that is not an unfragmented ipv4/udp datagram
+ */
+int udp_flow_parse_ipv4(uint8_t* buf, size_t len, udp_flow_t* udp_flow, uint8_t** payload, size_t* payload_len);
+
+//"239.255.10.1" -> 0xEFFF0A01
+int udp_flow_parse_ip_addr(const char* ip_addr_s, uint32_t* ip_addr);
+
+static inline bool udp_flow_is_lls(const udp_flow_t* udp_flow) {
+	return udp_flow->dst_ip_addr == UDP_FLOW_LLS_DST_IP_ADDR && udp_flow->dst_port == UDP_FLOW_LLS_DST_PORT;
+}
+
+/**
+ * add or refresh every service in slt_table that signals a destination flow.
+ * returns the number of services added or whose flow changed, -1 on error
+ */
+int udp_flow_service_map_update_from_slt(udp_flow_service_map_t* udp_flow_service_map, slt_table_t* slt_table);
+
+//NULL if no service in the map is delivered on this destination
+udp_flow_service_t* udp_flow_service_map_find(udp_flow_service_map_t* udp_flow_service_map, uint32_t dst_ip_addr, uint16_t dst_port);
+
+udp_flow_service_t* udp_flow_service_map_find_service_id(udp_flow_service_map_t* udp_flow_service_map, uint16_t service_id);
+
+void udp_flow_service_map_free(udp_flow_service_map_t* udp_flow_service_map);
+
+#endif /* MODULES_DEMUX_MMT_ATSC3_UDP_FLOW_H_ */
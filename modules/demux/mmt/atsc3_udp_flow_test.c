@@ -0,0 +1,144 @@
+/*
+ *
+ * atsc3_udp_flow_test.c:  driver for ipv4/udp header parsing and SLT destination flow -> service mapping
+ *
+ */
+
+#include "atsc3_udp_flow.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define __UNIT_TEST 1
+#ifdef __UNIT_TEST
+
+int test_udp_flow_parse_ipv4();
+int test_udp_flow_parse_ip_addr();
+int test_udp_flow_service_map();
+
+int main() {
+	int failed = 0;
+
+	failed |= test_udp_flow_parse_ipv4();
+	failed |= test_udp_flow_parse_ip_addr();
+	failed |= test_udp_flow_service_map();
+
+	return failed;
+}
+
+//172.16.200.1:50000 -> 239.255.10.1:51001, 4 byte payload, 2 bytes of trailing padding
+int test_udp_flow_parse_ipv4() {
+	uint8_t datagram[] = {
+		0x45, 0x00, 0x00, 0x20, 0x00, 0x00, 0x40, 0x00, 0x40, 0x11, 0x00, 0x00,
+		0xAC, 0x10, 0xC8, 0x01,
+		0xEF, 0xFF, 0x0A, 0x01,
+		0xC3, 0x50, 0xC7, 0x39, 0x00, 0x0C, 0x00, 0x00,
+		0xDE, 0xAD, 0xBE, 0xEF,
+		0x00, 0x00
+	};
+
+	udp_flow_t udp_flow;
+	uint8_t* payload = NULL;
+	size_t payload_len = 0;
+
+	if(udp_flow_parse_ipv4(datagram, sizeof(datagram), &udp_flow, &payload, &payload_len) ||
+		udp_flow.src_ip_addr != 0xAC10C801 || udp_flow.dst_ip_addr != 0xEFFF0A01 || udp_flow.src_port != 50000 || udp_flow.dst_port != 51001 ||
+		payload != &datagram[28] || payload_len != 4) {
+		_UDP_FLOW_ERROR("test_udp_flow_parse_ipv4: dst: 0x%08x:%hu, payload_len: %zu", udp_flow.dst_ip_addr, udp_flow.dst_port, payload_len);
+		return -1;
+	}
+
+	//tcp is refused
+	datagram[9] = 0x06;
+	if(!udp_flow_parse_ipv4(datagram, sizeof(datagram), &udp_flow, &payload, &payload_len)) {
+		_UDP_FLOW_ERROR("test_udp_flow_parse_ipv4: accepted a non-udp datagram");
+		return -1;
+	}
+	datagram[9] = 0x11;
+
+	//as is anything shorter than its headers
+	if(!udp_flow_parse_ipv4(datagram, 24, &udp_flow, &payload, &payload_len)) {
+		_UDP_FLOW_ERROR("test_udp_flow_parse_ipv4: accepted a truncated datagram");
+		return -1;
+	}
+
+	return 0;
+}
+
+int test_udp_flow_parse_ip_addr() {
+	uint32_t ip_addr = 0;
+
+	if(udp_flow_parse_ip_addr("224.0.23.60", &ip_addr) || ip_addr != UDP_FLOW_LLS_DST_IP_ADDR) {
+		_UDP_FLOW_ERROR("test_udp_flow_parse_ip_addr: 224.0.23.60 -> 0x%08x", ip_addr);
+		return -1;
+	}
+
+	if(!udp_flow_parse_ip_addr("239.255.10", &ip_addr) || !udp_flow_parse_ip_addr("239.256.10.1", &ip_addr) ||
+		!udp_flow_parse_ip_addr("239.255.10.1x", &ip_addr) || !udp_flow_parse_ip_addr(NULL, &ip_addr)) {
+		_UDP_FLOW_ERROR("test_udp_flow_parse_ip_addr: accepted a malformed address");
+		return -1;
+	}
+
+	return 0;
+}
+
+void __test_service_init(service_t* service, uint16_t service_id, int sls_protocol, char* ip_addr, char* port, char* name) {
+	memset(service, 0, sizeof(service_t));
+	service->service_id = service_id;
+	service->short_service_name = name;
+	service->broadcast_svc_signaling.sls_protocol = sls_protocol;
+	service->broadcast_svc_signaling.sls_destination_ip_address = ip_addr;
+	service->broadcast_svc_signaling.sls_destination_udp_port = port;
+}
+
+int test_udp_flow_service_map() {
+	service_t services[3];
+	service_t* service_entry[3] = { &services[0], &services[1], &services[2] };
+	__test_service_init(&services[0], 1001, UDP_FLOW_SLS_PROTOCOL_MMTP, "239.255.10.1", "51001", "ATEME MMT 1");
+	__test_service_init(&services[1], 1002, UDP_FLOW_SLS_PROTOCOL_MMTP, "239.255.10.2", "51002", "ATEME MMT 2");
+	__test_service_init(&services[2], 5009, UDP_FLOW_SLS_PROTOCOL_ROUTE, "239.255.20.9", "52009", "ESG");
+
+	slt_table_t slt_table;
+	memset(&slt_table, 0, sizeof(slt_table_t));
+	slt_table.service_entry = service_entry;
+	slt_table.service_entry_n = 3;
+
+	udp_flow_service_map_t udp_flow_service_map;
+	memset(&udp_flow_service_map, 0, sizeof(udp_flow_service_map_t));
+
+	if(udp_flow_service_map_update_from_slt(&udp_flow_service_map, &slt_table) != 3) {
+		_UDP_FLOW_ERROR("test_udp_flow_service_map: first SLT did not add 3 services");
+		return -1;
+	}
+
+	udp_flow_service_t* udp_flow_service = udp_flow_service_map_find(&udp_flow_service_map, 0xEFFF0A02, 51002);
+	if(!udp_flow_service || udp_flow_service->service_id != 1002 || strcmp(udp_flow_service->short_service_name, "ATEME MMT 2") ||
+		udp_flow_service_map_find(&udp_flow_service_map, 0xEFFF0A02, 51001)) {
+		_UDP_FLOW_ERROR("test_udp_flow_service_map: lookup by destination flow failed");
+		return -1;
+	}
+
+	//the same SLT again changes nothing, a moved service is picked up
+	if(udp_flow_service_map_update_from_slt(&udp_flow_service_map, &slt_table) != 0) {
+		_UDP_FLOW_ERROR("test_udp_flow_service_map: repeated SLT reported changes");
+		return -1;
+	}
+
+	services[0].broadcast_svc_signaling.sls_destination_udp_port = "51101";
+	if(udp_flow_service_map_update_from_slt(&udp_flow_service_map, &slt_table) != 1 || udp_flow_service_map.services_n != 3 ||
+		udp_flow_service_map_find(&udp_flow_service_map, 0xEFFF0A01, 51001) ||
+		udp_flow_service_map_find(&udp_flow_service_map, 0xEFFF0A01, 51101)->service_id != 1001) {
+		_UDP_FLOW_ERROR("test_udp_flow_service_map: moved service not remapped");
+		return -1;
+	}
+
+	_UDP_FLOW_INFO("test_udp_flow_service_map: %zu services mapped", udp_flow_service_map.services_n);
+
+	udp_flow_service_map_free(&udp_flow_service_map);
+	return 0;
+}
+
+#endif
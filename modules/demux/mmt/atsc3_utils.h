@@ -10,6 +10,8 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
 
 #include "fixups.h"
 
@@ -37,6 +39,85 @@
 
 void* extract(uint8_t *bufPosPtr, uint8_t *dest, int size);
 
+/**
+ * bounds-checked read cursor over a borrowed buffer (e.g. a received udp datagram)
+ *
+ * lets us walk the packet in place instead of extract()'ing every field into a scratch copy.
+ * reads past the end return 0 and latch overrun, so a parser can check once when it is done
+ */
+typedef struct atsc3_cursor {
+	uint8_t*	start;
+	uint8_t*	pos;
+	uint8_t*	end;
+	bool		overrun;
+} atsc3_cursor_t;
+
+static inline void atsc3_cursor_init(atsc3_cursor_t* cursor, uint8_t* buf, size_t len) {
+	cursor->start = buf;
+	cursor->pos = buf;
+	cursor->end = buf + len;
+	cursor->overrun = false;
+}
+
+static inline size_t atsc3_cursor_remaining(const atsc3_cursor_t* cursor) {
+	return cursor->pos < cursor->end ? (size_t)(cursor->end - cursor->pos) : 0;
+}
+
+static inline size_t atsc3_cursor_offset(const atsc3_cursor_t* cursor) {
+	return (size_t)(cursor->pos - cursor->start);
+}
+
+static inline bool atsc3_cursor_has(atsc3_cursor_t* cursor, size_t len) {
+	if(atsc3_cursor_remaining(cursor) < len) {
+		cursor->overrun = true;
+		return false;
+	}
+	return true;
+}
+
+//returns a pointer to len bytes in place and advances past them, or NULL if the buffer is too short
+static inline uint8_t* atsc3_cursor_take(atsc3_cursor_t* cursor, size_t len) {
+	if(!atsc3_cursor_has(cursor, len)) {
+		return NULL;
+	}
+	uint8_t* ptr = cursor->pos;
+	cursor->pos += len;
+	return ptr;
+}
+
+static inline void atsc3_cursor_skip(atsc3_cursor_t* cursor, size_t len) {
+	if(atsc3_cursor_has(cursor, len)) {
+		cursor->pos += len;
+	} else {
+		cursor->pos = cursor->end;
+	}
+}
+
+static inline uint8_t atsc3_cursor_read_u8(atsc3_cursor_t* cursor) {
+	if(!atsc3_cursor_has(cursor, 1)) return 0;
+	return *cursor->pos++;
+}
+
+static inline uint16_t atsc3_cursor_read_u16(atsc3_cursor_t* cursor) {
+	if(!atsc3_cursor_has(cursor, 2)) return 0;
+	uint16_t val = (cursor->pos[0] << 8) | cursor->pos[1];
+	cursor->pos += 2;
+	return val;
+}
+
+static inline uint32_t atsc3_cursor_read_u32(atsc3_cursor_t* cursor) {
+	if(!atsc3_cursor_has(cursor, 4)) return 0;
+	uint32_t val = ((uint32_t)cursor->pos[0] << 24) | (cursor->pos[1] << 16) | (cursor->pos[2] << 8) | cursor->pos[3];
+	cursor->pos += 4;
+	return val;
+}
+
+static inline uint64_t atsc3_cursor_read_u64(atsc3_cursor_t* cursor) {
+	uint64_t hi = atsc3_cursor_read_u32(cursor);
+	uint64_t lo = atsc3_cursor_read_u32(cursor);
+	return (hi << 32) | lo;
+}
+
 //key=value or key="value" attribute par collection parsing and searching
 typedef struct kvp {
 	char* key;
@@ -0,0 +1,404 @@
+/*
+ * atsc3_xml_pull.c
+ *
+ *  Created on: Feb 25, 2019
+ *      Author: jjustman
+ */
+
+#include "atsc3_xml_pull.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+static inline bool __is_space(char c) {
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+//offset of needle at or after from, size if it is not there
+static size_t __find(const atsc3_xml_pull_t* xml_pull, size_t from, const char* needle) {
+	size_t needle_len = strlen(needle);
+	while(from + needle_len <= xml_pull->size) {
+		const char* p = memchr(&xml_pull->buf[from], needle[0], xml_pull->size - from - needle_len + 1);
+		if(!p) {
+			break;
+		}
+		from = p - xml_pull->buf;
+		if(!memcmp(p, needle, needle_len)) {
+			return from;
+		}
+		from++;
+	}
+	return xml_pull->size;
+}
+
+static bool __starts_with(const atsc3_xml_pull_t* xml_pull, const char* prefix) {
+	size_t prefix_len = strlen(prefix);
+	return xml_pull->pos + prefix_len <= xml_pull->size && !memcmp(&xml_pull->buf[xml_pull->pos], prefix, prefix_len);
+}
+
+//name up to whitespace, '/' or '>', without its namespace prefix
+static size_t __read_name(atsc3_xml_pull_t* xml_pull, size_t from) {
+	size_t end = from;
+	while(end < xml_pull->size && !__is_space(xml_pull->buf[end]) && xml_pull->buf[end] != '/' && xml_pull->buf[end] != '>') {
+		end++;
+	}
+	const char* colon = memchr(&xml_pull->buf[from], ':', end - from);
+	size_t local = colon ? (size_t)(colon - xml_pull->buf) + 1 : from;
+	xml_pull->name.p = &xml_pull->buf[local];
+	xml_pull->name.len = end - local;
+	return end;
+}
+
+void atsc3_xml_pull_init(atsc3_xml_pull_t* xml_pull, const uint8_t* buf, size_t size) {
+	memset(xml_pull, 0, sizeof(atsc3_xml_pull_t));
+	xml_pull->buf = (const char*)buf;
+	xml_pull->size = size;
+}
+
+static atsc3_xml_pull_event_t __start_tag(atsc3_xml_pull_t* xml_pull) {
+	size_t name_end = __read_name(xml_pull, xml_pull->pos + 1);
+	if(!xml_pull->name.len) {
+		_ATSC3_XML_PULL_ERROR("atsc3_xml_pull: start tag without a name at offset: %zu", xml_pull->pos);
+		return ATSC3_XML_PULL_ERROR;
+	}
+
+	//'>' may be quoted in an attribute value
+	size_t end = name_end;
+	char quote = 0;
+	while(end < xml_pull->size && (quote || xml_pull->buf[end] != '>')) {
+		char c = xml_pull->buf[end];
+		if(quote) {
+			if(c == quote) {
+				quote = 0;
+			}
+		} else if(c == '"' || c == '\'') {
+			quote = c;
+		}
+		end++;
+	}
+	if(end >= xml_pull->size) {
+		_ATSC3_XML_PULL_ERROR("atsc3_xml_pull: unterminated start tag at offset: %zu", xml_pull->pos);
+		return ATSC3_XML_PULL_ERROR;
+	}
+
+	xml_pull->end_pending = end > name_end && xml_pull->buf[end - 1] == '/';
+	xml_pull->attributes.p = &xml_pull->buf[name_end];
+	xml_pull->attributes.len = end - name_end - (xml_pull->end_pending ? 1 : 0);
+	xml_pull->pos = end + 1;
+	xml_pull->depth++;
+	return ATSC3_XML_PULL_START;
+}
+
+static atsc3_xml_pull_event_t __end_tag(atsc3_xml_pull_t* xml_pull) {
+	__read_name(xml_pull, xml_pull->pos + 2);
+	size_t end = __find(xml_pull, xml_pull->pos, ">");
+	if(end >= xml_pull->size || xml_pull->depth <= 0) {
+		_ATSC3_XML_PULL_ERROR("atsc3_xml_pull: unexpected end tag at offset: %zu, depth: %d", xml_pull->pos, xml_pull->depth);
+		return ATSC3_XML_PULL_ERROR;
+	}
+	xml_pull->attributes.len = 0;
+	xml_pull->pos = end + 1;
+	xml_pull->depth--;
+	return ATSC3_XML_PULL_END;
+}
+
+//skips pos past the terminator of a markup declaration, false if it is never terminated
+static bool __skip_to(atsc3_xml_pull_t* xml_pull, size_t from, const char* terminator) {
+	size_t end = __find(xml_pull, from, terminator);
+	if(end >= xml_pull->size) {
+		_ATSC3_XML_PULL_ERROR("atsc3_xml_pull: missing '%s' after offset: %zu", terminator, xml_pull->pos);
+		return false;
+	}
+	xml_pull->pos = end + strlen(terminator);
+	return true;
+}
+
+atsc3_xml_pull_event_t atsc3_xml_pull_next(atsc3_xml_pull_t* xml_pull) {
+	if(xml_pull->end_pending) {
+		xml_pull->end_pending = false;
+		xml_pull->attributes.len = 0;
+		xml_pull->depth--;
+		return ATSC3_XML_PULL_END;
+	}
+
+	while(xml_pull->pos < xml_pull->size) {
+		const char* p = &xml_pull->buf[xml_pull->pos];
+
+		if(*p != '<') {
+			const char* next = memchr(p, '<', xml_pull->size - xml_pull->pos);
+			size_t end = next ? (size_t)(next - xml_pull->buf) : xml_pull->size;
+			const char* text_end = &xml_pull->buf[end];
+			xml_pull->pos = end;
+
+			//inflated payloads may carry their NUL terminator
+			while(p < text_end && (__is_space(*p) || !*p)) {
+				p++;
+			}
+			while(text_end > p && (__is_space(text_end[-1]) || !text_end[-1])) {
+				text_end--;
+			}
+			if(p == text_end) {
+				continue;
+			}
+			xml_pull->text.p = p;
+			xml_pull->text.len = text_end - p;
+			return ATSC3_XML_PULL_TEXT;
+		}
+
+		if(__starts_with(xml_pull, "<?")) {
+			if(!__skip_to(xml_pull, xml_pull->pos + 2, "?>")) {
+				return ATSC3_XML_PULL_ERROR;
+			}
+		} else if(__starts_with(xml_pull, "<!--")) {
+			if(!__skip_to(xml_pull, xml_pull->pos + 4, "-->")) {
+				return ATSC3_XML_PULL_ERROR;
+			}
+		} else if(__starts_with(xml_pull, "<![CDATA[")) {
+			size_t from = xml_pull->pos + 9;
+			if(!__skip_to(xml_pull, from, "]]>")) {
+				return ATSC3_XML_PULL_ERROR;
+			}
+			xml_pull->text.p = &xml_pull->buf[from];
+			xml_pull->text.len = xml_pull->pos - 3 - from;
+			return ATSC3_XML_PULL_TEXT;
+		} else if(__starts_with(xml_pull, "<!")) {
+			if(!__skip_to(xml_pull, xml_pull->pos + 2, ">")) {
+				return ATSC3_XML_PULL_ERROR;
+			}
+		} else if(__starts_with(xml_pull, "</")) {
+			return __end_tag(xml_pull);
+		} else {
+			return __start_tag(xml_pull);
+		}
+	}
+
+	if(xml_pull->depth) {
+		_ATSC3_XML_PULL_ERROR("atsc3_xml_pull: document ends inside an element, depth: %d", xml_pull->depth);
+		return ATSC3_XML_PULL_ERROR;
+	}
+	return ATSC3_XML_PULL_EOF;
+}
+
+atsc3_xml_pull_event_t atsc3_xml_pull_skip_element(atsc3_xml_pull_t* xml_pull) {
+	int depth = xml_pull->depth - 1;
+	for(;;) {
+		atsc3_xml_pull_event_t event = atsc3_xml_pull_next(xml_pull);
+		if(event == ATSC3_XML_PULL_ERROR || event == ATSC3_XML_PULL_EOF) {
+			return ATSC3_XML_PULL_ERROR;
+		}
+		if(event == ATSC3_XML_PULL_END && xml_pull->depth == depth) {
+			return ATSC3_XML_PULL_END;
+		}
+	}
+}
+
+bool atsc3_xml_pull_attribute(const atsc3_xml_pull_t* xml_pull, const char* name, atsc3_xml_view_t* value) {
+	const char* p = xml_pull->attributes.p;
+	const char* end = p + xml_pull->attributes.len;
+	size_t name_len = strlen(name);
+
+	while(p < end) {
+		while(p < end && __is_space(*p)) {
+			p++;
+		}
+		const char* attribute_name = p;
+		while(p < end && !__is_space(*p) && *p != '=') {
+			p++;
+		}
+		size_t attribute_name_len = p - attribute_name;
+		while(p < end && __is_space(*p)) {
+			p++;
+		}
+		if(p >= end || *p != '=') {
+			return false;
+		}
+		p++;
+		while(p < end && __is_space(*p)) {
+			p++;
+		}
+		if(p >= end || (*p != '"' && *p != '\'')) {
+			return false;
+		}
+		const char* value_end = memchr(p + 1, *p, end - p - 1);
+		if(!value_end) {
+			return false;
+		}
+		if(attribute_name_len == name_len && !memcmp(attribute_name, name, name_len)) {
+			value->p = p + 1;
+			value->len = value_end - p - 1;
+			return true;
+		}
+		p = value_end + 1;
+	}
+	return false;
+}
+
+bool atsc3_xml_view_equals(atsc3_xml_view_t view, const char* str) {
+	return strlen(str) == view.len && !memcmp(view.p, str, view.len);
+}
+
+bool atsc3_xml_view_to_int(atsc3_xml_view_t view, int* value) {
+	const char* p = view.p;
+	const char* end = view.p + view.len;
+	while(p < end && __is_space(*p)) {
+		p++;
+	}
+	while(end > p && __is_space(end[-1])) {
+		end--;
+	}
+
+	bool negative = false;
+	if(p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		p++;
+	}
+	if(p == end) {
+		return false;
+	}
+
+	long long scratch = 0;
+	for(; p < end; p++) {
+		if(*p < '0' || *p > '9') {
+			return false;
+		}
+		scratch = scratch * 10 + (*p - '0');
+		if(scratch > (long long)INT_MAX + 1) {
+			return false;
+		}
+	}
+	if(negative) {
+		scratch = -scratch;
+	}
+	if(scratch > INT_MAX) {
+		return false;
+	}
+	*value = (int)scratch;
+	return true;
+}
+
+bool atsc3_xml_view_to_bool(atsc3_xml_view_t view) {
+	return atsc3_xml_view_equals(view, "true") || atsc3_xml_view_equals(view, "1");
+}
+
+bool atsc3_xml_view_next_token(atsc3_xml_view_t* list, atsc3_xml_view_t* token) {
+	while(list->len && __is_space(*list->p)) {
+		list->p++;
+		list->len--;
+	}
+	if(!list->len) {
+		return false;
+	}
+	token->p = list->p;
+	while(list->len && !__is_space(*list->p)) {
+		list->p++;
+		list->len--;
+	}
+	token->len = list->p - token->p;
+	return true;
+}
+
+static size_t __utf8_encode(uint32_t code_point, char* out) {
+	if(code_point < 0x80) {
+		out[0] = code_point;
+		return 1;
+	} else if(code_point < 0x800) {
+		out[0] = 0xC0 | (code_point >> 6);
+		out[1] = 0x80 | (code_point & 0x3F);
+		return 2;
+	} else if(code_point < 0x10000) {
+		out[0] = 0xE0 | (code_point >> 12);
+		out[1] = 0x80 | ((code_point >> 6) & 0x3F);
+		out[2] = 0x80 | (code_point & 0x3F);
+		return 3;
+	}
+	out[0] = 0xF0 | (code_point >> 18);
+	out[1] = 0x80 | ((code_point >> 12) & 0x3F);
+	out[2] = 0x80 | ((code_point >> 6) & 0x3F);
+	out[3] = 0x80 | (code_point & 0x3F);
+	return 4;
+}
+
+//length of the reference at p written to out, 0 if it is not one we know
+static size_t __entity_decode(const char* p, const char* end, char* out, size_t* written) {
+	const char* semicolon = memchr(p, ';', end - p);
+	if(!semicolon) {
+		return 0;
+	}
+	atsc3_xml_view_t entity = { p + 1, semicolon - p - 1 };
+
+	static const struct { const char* name; char c; } predefined[] = {
+		{ "lt", '<' }, { "gt", '>' }, { "amp", '&' }, { "quot", '"' }, { "apos", '\'' }
+	};
+	for(size_t i=0; i < sizeof(predefined) / sizeof(predefined[0]); i++) {
+		if(atsc3_xml_view_equals(entity, predefined[i].name)) {
+			out[0] = predefined[i].c;
+			*written = 1;
+			return semicolon - p + 1;
+		}
+	}
+
+	if(entity.len < 2 || entity.p[0] != '#') {
+		return 0;
+	}
+	bool hex = entity.p[1] == 'x';
+	const char* digit = entity.p + (hex ? 2 : 1);
+	if(digit == semicolon) {
+		return 0;
+	}
+	uint32_t code_point = 0;
+	for(; digit < semicolon; digit++) {
+		int d;
+		if(*digit >= '0' && *digit <= '9') {
+			d = *digit - '0';
+		} else if(hex && *digit >= 'a' && *digit <= 'f') {
+			d = *digit - 'a' + 10;
+		} else if(hex && *digit >= 'A' && *digit <= 'F') {
+			d = *digit - 'A' + 10;
+		} else {
+			return 0;
+		}
+		code_point = code_point * (hex ? 16 : 10) + d;
+		if(code_point > 0x10FFFF) {
+			return 0;
+		}
+	}
+	if(!code_point) {
+		return 0;
+	}
+	*written = __utf8_encode(code_point, out);
+	return semicolon - p + 1;
+}
+
+char* atsc3_xml_view_strdup(atsc3_xml_view_t view) {
+	//a resolved reference is never longer than the reference itself
+	char* str = malloc(view.len + 1);
+	if(!str) {
+		return NULL;
+	}
+
+	const char* p = view.p;
+	const char* end = view.p + view.len;
+	char* out = str;
+	while(p < end) {
+		const char* amp = memchr(p, '&', end - p);
+		size_t run = amp ? (size_t)(amp - p) : (size_t)(end - p);
+		memcpy(out, p, run);
+		out += run;
+		p += run;
+		if(!amp) {
+			break;
+		}
+
+		size_t written = 0;
+		size_t consumed = __entity_decode(p, end, out, &written);
+		if(consumed) {
+			out += written;
+			p += consumed;
+		} else {
+			*out++ = *p++;
+		}
+	}
+	*out = '\0';
+	return str;
+}
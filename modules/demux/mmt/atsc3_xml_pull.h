@@ -0,0 +1,78 @@
+/*
+ * atsc3_xml_pull.h
+ *
+ *  Created on: Feb 25, 2019
+ *      Author: jjustman
+ *
+ * pull parser for the small, attribute heavy XML documents carried in LLS tables.
+ *
+ * atsc3_xml_pull_next walks the buffer one tag at a time and never builds a tree or copies: element names,
+ * attribute values and text are views into the buffer, only valid as long as it is. attributes are looked up
+ * by name against the span of the current start tag, so a table builder fills its structs in the same pass
+ * and only copies the values it keeps (atsc3_xml_view_strdup, which also resolves entity references).
+ *
+ * the XML declaration, comments, processing instructions and DOCTYPE are skipped, CDATA sections are returned
+ * as text. end tag names are not checked against their start tag, only the nesting depth is tracked.
+ */
+
+#ifndef MODULES_DEMUX_MMT_ATSC3_XML_PULL_H_
+#define MODULES_DEMUX_MMT_ATSC3_XML_PULL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define _ATSC3_XML_PULL_PRINTLN(...) printf(__VA_ARGS__);printf("\n")
+#define _ATSC3_XML_PULL_ERROR(...)   printf("%s:%d:ERROR:",__FILE__,__LINE__);_ATSC3_XML_PULL_PRINTLN(__VA_ARGS__);
+
+typedef struct atsc3_xml_view {
+	const char*	p;
+	size_t		len;
+} atsc3_xml_view_t;
+
+typedef enum {
+	ATSC3_XML_PULL_ERROR = -1,
+	ATSC3_XML_PULL_EOF = 0,
+	ATSC3_XML_PULL_START,		//<name ...>, or <name .../> which is followed by its END
+	ATSC3_XML_PULL_END,			//</name>
+	ATSC3_XML_PULL_TEXT,		//character data, runs of only whitespace are skipped
+} atsc3_xml_pull_event_t;
+
+typedef struct atsc3_xml_pull {
+	const char*			buf;
+	size_t				size;
+	size_t				pos;
+
+	int					depth;			//of the current element, the root is 1
+	atsc3_xml_view_t	name;			//local name of the current element, without its namespace prefix
+	atsc3_xml_view_t	attributes;		//between the name and the end of the start tag
+	atsc3_xml_view_t	text;
+	bool				end_pending;	//the last START was an empty element tag
+} atsc3_xml_pull_t;
+
+void atsc3_xml_pull_init(atsc3_xml_pull_t* xml_pull, const uint8_t* buf, size_t size);
+
+atsc3_xml_pull_event_t atsc3_xml_pull_next(atsc3_xml_pull_t* xml_pull);
+
+//after a START, skips its content up to and including its END
+atsc3_xml_pull_event_t atsc3_xml_pull_skip_element(atsc3_xml_pull_t* xml_pull);
+
+//raw value of an attribute of the current start tag, entity references are left as they are
+bool atsc3_xml_pull_attribute(const atsc3_xml_pull_t* xml_pull, const char* name, atsc3_xml_view_t* value);
+
+bool atsc3_xml_view_equals(atsc3_xml_view_t view, const char* str);
+
+//decimal integer, surrounding whitespace allowed. false if empty, not a number or out of range
+bool atsc3_xml_view_to_int(atsc3_xml_view_t view, int* value);
+
+//xs:boolean, "true" or "1"
+bool atsc3_xml_view_to_bool(atsc3_xml_view_t view);
+
+//splits a whitespace separated list, false once there are no items left
+bool atsc3_xml_view_next_token(atsc3_xml_view_t* list, atsc3_xml_view_t* token);
+
+//NUL terminated copy with the predefined and numeric entity references resolved, NULL on allocation failure
+char* atsc3_xml_view_strdup(atsc3_xml_view_t view);
+
+#endif /* MODULES_DEMUX_MMT_ATSC3_XML_PULL_H_ */
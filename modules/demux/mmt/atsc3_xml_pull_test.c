@@ -0,0 +1,236 @@
+/*
+ *
+ * atsc3_xml_pull_test.c:  driver for the LLS pull parser and the SLT / SystemTime table builders
+ *
+ */
+
+#include "atsc3_xml_pull.h"
+#include "atsc3_lls.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define __UNIT_TEST 1
+#ifdef __UNIT_TEST
+
+#define __TEST_SLT_SERVICES 100
+
+int test_xml_pull_events();
+int test_xml_pull_attributes();
+int test_xml_pull_malformed();
+int test_xml_pull_slt_services();
+int test_xml_pull_system_time();
+
+int main() {
+	int failed = 0;
+
+	failed |= test_xml_pull_events();
+	failed |= test_xml_pull_attributes();
+	failed |= test_xml_pull_malformed();
+	failed |= test_xml_pull_slt_services();
+	failed |= test_xml_pull_system_time();
+
+	return failed;
+}
+
+static void __xml_pull_init_str(atsc3_xml_pull_t* xml_pull, const char* xml) {
+	atsc3_xml_pull_init(xml_pull, (const uint8_t*)xml, strlen(xml));
+}
+
+//declaration, comments and DOCTYPE are skipped, empty elements get their END, prefixes are dropped
+int test_xml_pull_events() {
+	const char* xml = "<?xml version=\"1.0\"?>\n<!DOCTYPE SLT>\n<!-- c -->"
+			"<slt:SLT a=\"1\">\n  <Service b='2'/>text<![CDATA[<raw>]]><Other></Other>\n</slt:SLT>\n";
+
+	struct { atsc3_xml_pull_event_t event; const char* value; int depth; } expected[] = {
+		{ ATSC3_XML_PULL_START,	"SLT",		1 },
+		{ ATSC3_XML_PULL_START,	"Service",	2 },
+		{ ATSC3_XML_PULL_END,	"Service",	1 },
+		{ ATSC3_XML_PULL_TEXT,	"text",		1 },
+		{ ATSC3_XML_PULL_TEXT,	"<raw>",	1 },
+		{ ATSC3_XML_PULL_START,	"Other",	2 },
+		{ ATSC3_XML_PULL_END,	"Other",	1 },
+		{ ATSC3_XML_PULL_END,	"SLT",		0 },
+		{ ATSC3_XML_PULL_EOF,	NULL,		0 },
+	};
+
+	atsc3_xml_pull_t xml_pull;
+	__xml_pull_init_str(&xml_pull, xml);
+	for(size_t i=0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+		atsc3_xml_pull_event_t event = atsc3_xml_pull_next(&xml_pull);
+		atsc3_xml_view_t view = event == ATSC3_XML_PULL_TEXT ? xml_pull.text : xml_pull.name;
+		if(event != expected[i].event || xml_pull.depth != expected[i].depth ||
+				(expected[i].value && !atsc3_xml_view_equals(view, expected[i].value))) {
+			printf("test_xml_pull_events: event %zu: %d, depth: %d, value: %.*s\n", i, event, xml_pull.depth, (int)view.len, view.p);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int test_xml_pull_attributes() {
+	const char* xml = "<Service serviceId=\"1001\" shortServiceName = 'A&amp;B &#x41;&#66;&bogus; <>' a=\"x>y\" id=\" -12 \" list=\" 50  51\t52 \"/>";
+
+	atsc3_xml_pull_t xml_pull;
+	__xml_pull_init_str(&xml_pull, xml);
+	if(atsc3_xml_pull_next(&xml_pull) != ATSC3_XML_PULL_START) {
+		printf("test_xml_pull_attributes: no start tag\n");
+		return -1;
+	}
+
+	atsc3_xml_view_t value;
+	int i;
+	if(!atsc3_xml_pull_attribute(&xml_pull, "serviceId", &value) || !atsc3_xml_view_to_int(value, &i) || i != 1001) {
+		printf("test_xml_pull_attributes: serviceId\n");
+		return -1;
+	}
+	if(atsc3_xml_pull_attribute(&xml_pull, "service", &value) || atsc3_xml_pull_attribute(&xml_pull, "Id", &value)) {
+		printf("test_xml_pull_attributes: partial attribute name matched\n");
+		return -1;
+	}
+	if(!atsc3_xml_pull_attribute(&xml_pull, "a", &value) || !atsc3_xml_view_equals(value, "x>y")) {
+		printf("test_xml_pull_attributes: quoted '>'\n");
+		return -1;
+	}
+	if(!atsc3_xml_pull_attribute(&xml_pull, "id", &value) || !atsc3_xml_view_to_int(value, &i) || i != -12) {
+		printf("test_xml_pull_attributes: negative int\n");
+		return -1;
+	}
+
+	char* name = NULL;
+	if(!atsc3_xml_pull_attribute(&xml_pull, "shortServiceName", &value) || !(name = atsc3_xml_view_strdup(value)) ||
+			strcmp(name, "A&B AB&bogus; <>")) {
+		printf("test_xml_pull_attributes: shortServiceName: %s\n", name);
+		free(name);
+		return -1;
+	}
+	free(name);
+
+	atsc3_xml_view_t list, token;
+	int sum = 0, n = 0;
+	atsc3_xml_pull_attribute(&xml_pull, "list", &list);
+	while(atsc3_xml_view_next_token(&list, &token)) {
+		if(atsc3_xml_view_to_int(token, &i)) {
+			sum += i;
+			n++;
+		}
+	}
+	if(n != 3 || sum != 153) {
+		printf("test_xml_pull_attributes: list: %d items, sum: %d\n", n, sum);
+		return -1;
+	}
+
+	atsc3_xml_view_t not_int = { "12a", 3 };
+	atsc3_xml_view_t too_big = { "2147483648", 10 };
+	atsc3_xml_view_t empty = { "", 0 };
+	if(atsc3_xml_view_to_int(not_int, &i) || atsc3_xml_view_to_int(too_big, &i) || atsc3_xml_view_to_int(empty, &i)) {
+		printf("test_xml_pull_attributes: bad ints accepted\n");
+		return -1;
+	}
+
+	return atsc3_xml_pull_next(&xml_pull) == ATSC3_XML_PULL_END && atsc3_xml_pull_next(&xml_pull) == ATSC3_XML_PULL_EOF ? 0 : -1;
+}
+
+static atsc3_xml_pull_event_t __xml_pull_drain(const char* xml) {
+	atsc3_xml_pull_t xml_pull;
+	__xml_pull_init_str(&xml_pull, xml);
+	atsc3_xml_pull_event_t event;
+	while((event = atsc3_xml_pull_next(&xml_pull)) > ATSC3_XML_PULL_EOF);
+	return event;
+}
+
+int test_xml_pull_malformed() {
+	const char* malformed[] = {
+		"<SLT><Service/>",
+		"<SLT></SLT></SLT>",
+		"<SLT a=\"1",
+		"<SLT><!-- never closed </SLT>",
+		"< a/>",
+	};
+	for(size_t i=0; i < sizeof(malformed) / sizeof(malformed[0]); i++) {
+		if(__xml_pull_drain(malformed[i]) != ATSC3_XML_PULL_ERROR) {
+			printf("test_xml_pull_malformed: accepted: %s\n", malformed[i]);
+			return -1;
+		}
+	}
+	return __xml_pull_drain("<SLT/>") == ATSC3_XML_PULL_EOF ? 0 : -1;
+}
+
+//more services than the old fixed array held, with unsupported children in between
+int test_xml_pull_slt_services() {
+	size_t xml_size = 512 + __TEST_SLT_SERVICES * 512;
+	char* xml = calloc(1, xml_size);
+	size_t len = snprintf(xml, xml_size, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+			"<SLT xmlns=\"tag:atsc.org,2016:XMLSchemas/ATSC3/Delivery/SLT/1.0/\" bsid=\"50 51\">");
+	for(int i=0; i < __TEST_SLT_SERVICES; i++) {
+		len += snprintf(xml + len, xml_size - len, "<Service serviceId=\"%d\" globalServiceID=\"urn:atsc:serviceid:%d\" majorChannelNo=\"10\" "
+				"minorChannelNo=\"%d\" serviceCategory=\"1\" shortServiceName=\"S&amp;%d\" sltSvcSeqNum=\"3\">"
+				"<SvcCapabilities><Capability>x</Capability></SvcCapabilities>"
+				"<BroadcastSvcSignaling slsProtocol=\"2\" slsDestinationIpAddress=\"239.255.10.%d\" slsDestinationUdpPort=\"%d\" slsSourceIpAddress=\"172.16.200.1\"/>"
+				"</Service>", 1000 + i, i, i, i, i, 51000 + i);
+	}
+	len += snprintf(xml + len, xml_size - len, "</SLT>");
+
+	lls_table_t* lls_table = calloc(1, sizeof(lls_table_t));
+	lls_table->lls_table_id = SLT;
+
+	atsc3_xml_pull_t xml_pull;
+	atsc3_xml_pull_init(&xml_pull, (const uint8_t*)xml, len);
+	int ret = lls_create_table_type_instance(lls_table, &xml_pull);
+	free(xml);
+
+	slt_table_t* slt_table = &lls_table->slt_table;
+	if(ret || slt_table->service_entry_n != __TEST_SLT_SERVICES || slt_table->bsid_n != 2 || slt_table->bsid[1] != 51) {
+		printf("test_xml_pull_slt_services: ret: %d, services: %d, bsid_n: %d\n", ret, slt_table->service_entry_n, slt_table->bsid_n);
+		lls_table_free(lls_table);
+		return -1;
+	}
+
+	for(int i=0; i < __TEST_SLT_SERVICES; i++) {
+		service_t* service = slt_table->service_entry[i];
+		char short_service_name[16];
+		char sls_destination_udp_port[16];
+		snprintf(short_service_name, sizeof(short_service_name), "S&%d", i);
+		snprintf(sls_destination_udp_port, sizeof(sls_destination_udp_port), "%d", 51000 + i);
+		if(service->service_id != 1000 + i || service->minor_channel_no != i || service->slt_svc_seq_num != 3 ||
+				strcmp(service->short_service_name, short_service_name) ||
+				service->broadcast_svc_signaling.sls_protocol != 2 ||
+				strcmp(service->broadcast_svc_signaling.sls_destination_udp_port, sls_destination_udp_port)) {
+			printf("test_xml_pull_slt_services: service %d: service_id: %hu, name: %s\n", i, service->service_id, service->short_service_name);
+			lls_table_free(lls_table);
+			return -1;
+		}
+	}
+
+	lls_table_free(lls_table);
+	return 0;
+}
+
+int test_xml_pull_system_time() {
+	const char* xml = "<?xml version=\"1.0\"?><SystemTime xmlns=\"http://www.atsc.org/XMLSchemas/ATSC3/Delivery/SYSTIME/1.0/\" "
+			"currentUtcOffset=\"37\" ptpPrepend=\"1\" leap59=\"true\" leap61=\"false\" utcLocalOffset=\"-PT5H\" dsStatus=\"1\" dsDayOfMonth=\"10\" dsHour=\"2\"/>";
+
+	lls_table_t* lls_table = calloc(1, sizeof(lls_table_t));
+	lls_table->lls_table_id = SystemTime;
+
+	atsc3_xml_pull_t xml_pull;
+	__xml_pull_init_str(&xml_pull, xml);
+	int ret = lls_create_table_type_instance(lls_table, &xml_pull);
+
+	system_time_table_t* system_time_table = &lls_table->system_time_table;
+	if(ret || system_time_table->current_utc_offset != 37 || system_time_table->ptp_prepend != 1 ||
+			!system_time_table->leap59 || system_time_table->leap61 || !system_time_table->ds_status ||
+			system_time_table->ds_day_of_month != 10 || system_time_table->ds_hour != 2 ||
+			strcmp(system_time_table->utc_local_offset, "-PT5H")) {
+		printf("test_xml_pull_system_time: ret: %d\n", ret);
+		lls_table_free(lls_table);
+		return -1;
+	}
+	lls_table_free(lls_table);
+	return 0;
+}
+
+#endif
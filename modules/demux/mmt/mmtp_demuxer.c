@@ -254,6 +254,10 @@ firefox http://127.0.0.1:8080
  * e.g. tcprewrite --fixcsum -i 2018-12-17-mmt-airwavz-bad-checksums.pcap -o 2018-12-17-mmt-airwavz-recalc.pcap
  * replay via, e.g. bittwist -i enp0s6 2018-12-17-mmt-airwavz-recalc.pcap -v
  *
+ * or without a network at all, with the pcap:// access (see mmtp_pcap_access.c), checksums are not checked:
+ * vlc --demux=mmtp --pcap-dst=239.255.10.2:51002 pcap:///tmp/2018-12-17-mmt-airwavz-bad-checksums.pcap
+ * add --no-pcap-realtime to read the capture as fast as the demuxer goes
+ *
  *
  * lastly, i then have a host only interface between my ubuntu and mac configured in parallels, but mac's management of the mulitcast routes is a bit weird,
  * the two scripts will revoke any autoconfigured interface mulitcast routes, and then manually add the dedicated 224 route to the virtual host-only network:
@@ -278,12 +282,13 @@ sudo route -nv add -net 224.0.0.0/4 -interface vnic1
 
 
 #include "atsc3_utils.h"
-#include "mmtp_types.h"
 #include "mmtp_stats_marquee.h"
+#include "mmtp_pcap_access.h"
 
 /** cascasde libmp4 headers here ***/
 
 #include "mp4.h"
+#include "vlc_libatsc3_types.h"
 
 #include <vlc_common.h>
 #include <vlc_demux.h>
@@ -297,8 +302,12 @@ sudo route -nv add -net 224.0.0.0/4 -interface vnic1
 #include <vlc_url.h>
 #include <vlc_vector.h>
 #include <vlc_filter.h>
+#include <vlc_interrupt.h>
+#include <vlc_fs.h>
+#include <vlc_actions.h>
 
 #include <assert.h>
+#include <errno.h>
 #include <limits.h>
 #include "../codec/cc.h"
 #include "heif.h"
@@ -325,6 +334,101 @@ block_t* reassembled_mpu_final;
 
 #define ACCESS_TEXT N_("MMTP Demuxer module")
 
+#define MAX_BUFFERED_BYTES_TEXT N_("Maximum buffered MPU bytes")
+#define MAX_BUFFERED_BYTES_LONGTEXT N_("Upper bound on MPU fragment payload bytes held for reassembly across all packet_ids, " \
+		"the oldest MPUs are dropped once it is exceeded (0 for unbounded).")
+
+#define LOW_LATENCY_TEXT N_("Ultra-low-latency sample output")
+#define LOW_LATENCY_LONGTEXT N_("Forward each sample as soon as its last fragment arrives, timed from the previous MPU's " \
+		"movie fragment until the current one is received, and drive the PCR per sample instead of buffering whole MPUs.")
+
+#define REORDER_PACKETS_TEXT N_("Reorder window (packets)")
+#define REORDER_PACKETS_LONGTEXT N_("Number of packets per packet_id that may be held to put out-of-order packets back " \
+		"in packet_sequence_number order (0 to disable).")
+
+#define REORDER_MS_TEXT N_("Reorder window (ms)")
+#define REORDER_MS_LONGTEXT N_("Longest time a missing packet is waited for before it is treated as lost.")
+
+#define EMIT_CORRUPT_SAMPLES_TEXT N_("Emit incomplete samples")
+#define EMIT_CORRUPT_SAMPLES_LONGTEXT N_("Pass samples with lost fragments to the decoder flagged as corrupted instead of dropping them.")
+
+#define IP_INPUT_TEXT N_("Full PLP ip input")
+#define IP_INPUT_LONGTEXT N_("Input datagrams carry their IPv4/UDP headers (e.g. a whole PLP). Services are found from the LLS SLT " \
+		"by destination address and port, and every MMTP service is demuxed into its own program.")
+
+#define PCR_DELAY_TEXT N_("PCR delay (ms)")
+#define PCR_DELAY_LONGTEXT N_("How far the PCR is held behind the sender clock recovered from the packet timestamps, " \
+		"to absorb network jitter. The demuxer adds its own reassembly delay on top as it measures it.")
+
+#define RECEIVE_RING_TEXT N_("Receive ring (datagrams)")
+#define RECEIVE_RING_LONGTEXT N_("Read datagrams of a live input on a dedicated thread and queue up to this many for the " \
+                                 "demuxer, so parsing and reassembly never stall the socket. 0 reads on the demux thread, " \
+                                 "as do inputs that can be paced (files, pcap replay without pcap-realtime).")
+
+#define MPU_METADATA_CACHE_TEXT N_("Cache MPU metadata")
+#define MPU_METADATA_CACHE_LONGTEXT N_("Keep the last MPU metadata of every asset in the user cache directory, so the tracks " \
+		"of a service are set up as soon as it is tuned instead of at the start of its next MPU.")
+
+#define HRBM_TEXT N_("Follow the HRBM")
+#define HRBM_LONGTEXT N_("Size the buffered bytes, reorder window and PCR delay of a service from its signaled " \
+		"Hypothetical Receiver Buffer Model. mmtp-max-buffered-bytes remains the ceiling.")
+
+#define OBJECTS_TEXT N_("Collect non-timed objects")
+#define OBJECTS_LONGTEXT N_("Assemble non-timed MPU items and generic objects (caption resources, application files, " \
+		"ESG fragments) and keep the last ones received as attachments.")
+
+#define AL_FEC_TEXT N_("AL-FEC recovery")
+#define AL_FEC_LONGTEXT N_("Recover lost source packets from AL-FEC repair packets. The repair symbols are taken to be " \
+		"a systematic Reed-Solomon code over GF(2^8) with a Cauchy matrix. No AL_FEC message is decoded to check the " \
+		"signaled FEC code, so this is off by default and only for senders known to use this code.")
+
+#define STATS_INTERVAL_TEXT N_("Flow statistics interval (s)")
+#define STATS_INTERVAL_LONGTEXT N_("How often the per packet_id counters (packets, loss, reordering, FEC recoveries, MPUs, " \
+		"reassembly latency, timestamp jitter) are published to the media information. 0 disables publishing.")
+
+#define TRACE_LEVEL_TEXT N_("Trace level")
+#define TRACE_LEVEL_LONGTEXT N_("libatsc3 log level, 0 (none) to 5 (trace). Lines above the level the plugin was built " \
+		"with are compiled out.")
+
+#define TRACE_EVENTS_TEXT N_("Trace event ring (events)")
+#define TRACE_EVENTS_LONGTEXT N_("Record the last packets, drops, FEC recoveries, fragments, samples and PCRs in a binary " \
+		"ring of this many events, written to the user cache directory on mmtp-trace-dump-key and on close. 0 disables it.")
+
+#define TRACE_DUMP_KEY_TEXT N_("Trace event dump hotkey")
+#define TRACE_DUMP_KEY_LONGTEXT N_("Key writing the mmtp-trace-events ring to the user cache directory, e.g. \"Ctrl+Shift+t\". " \
+		"Pick one no other hotkey uses. Empty leaves only the dump on close.")
+
+#define PCAP_DST_TEXT N_("Destination flow")
+#define PCAP_DST_LONGTEXT N_("Replay the datagrams sent to this ip:port (or ip, or :port). Empty replays every udp datagram.")
+#define PCAP_REALTIME_TEXT N_("Capture pacing")
+#define PCAP_REALTIME_LONGTEXT N_("Release datagrams at the pace they were captured at. Otherwise they are read as fast as " \
+		"the demuxer takes them, for benchmarking.")
+#define PCAP_IP_HEADERS_TEXT N_("Keep ip headers")
+#define PCAP_IP_HEADERS_LONGTEXT N_("Hand on whole IPv4 packets instead of udp payloads, for mmtp-ip-input.")
+
+//PCR lead over the dts of the sample just sent in low latency mode
+#define MMTP_LOW_LATENCY_PCR_DELAY VLC_TICK_FROM_MS(100)
+#define MMTP_PCR_DELAY_DEFAULT_MS 200
+#define MMTP_PCR_UPDATE_INTERVAL VLC_TICK_FROM_MS(40)
+//headroom added to the measured reassembly lag, and its ceiling
+#define MMTP_PCR_LAG_MARGIN VLC_TICK_FROM_MS(100)
+#define MMTP_PCR_LAG_MAX VLC_TICK_FROM_SEC(10)
+#define MMTP_RECEIVE_RING_DEFAULT_SIZE 4096
+#define MMTP_RECV_DROPS_POLL_INTERVAL VLC_TICK_FROM_SEC(1)
+//how late past its hold a reorder gap is given up on while no datagram arrives
+#define MMTP_REORDER_EXPIRE_INTERVAL VLC_TICK_FROM_MS(10)
+#define MMTP_MPU_METADATA_CACHE_FILE "mmtp-mpu-metadata.cache"
+#define MMTP_TRACE_FILE "mmtp-trace.log"
+#define MMTP_STATS_INTERVAL_DEFAULT_S 5
+//fragments are held until their whole MPU is in, longer than the HRBM holds packets
+#define MMTP_HRBM_BUFFER_HEADROOM 2
+#define MMTP_HRBM_MIN_BUFFERED_BYTES (1024 * 1024)
+#define MMTP_HRBM_MIN_REORDER_HOLD VLC_TICK_FROM_MS(10)
+#define MMTP_HRBM_MAX_DELAY VLC_TICK_FROM_SEC(10)
+//completed objects kept as attachments, oldest go first, and the largest one kept
+#define MMTP_OBJECT_ATTACHMENTS_MAX 64
+#define MMTP_OBJECT_MAX_SIZE (16 * 1024 * 1024)
+
 static int  Open( vlc_object_t * );
 static void Close ( vlc_object_t * );
 
@@ -353,8 +457,47 @@ vlc_module_begin ()
   //               FILE_TEXT, FILE_LONGTEXT)
   //  add_bool( "demuxdump-append", false, APPEND_TEXT, APPEND_LONGTEXT,
   //           false )
+    add_integer( "mmtp-max-buffered-bytes", MMTP_FRAGMENT_STORE_DEFAULT_MAX_BYTES,
+                 MAX_BUFFERED_BYTES_TEXT, MAX_BUFFERED_BYTES_LONGTEXT, true )
+    add_bool( "mmtp-low-latency", false, LOW_LATENCY_TEXT, LOW_LATENCY_LONGTEXT, true )
+    add_integer( "mmtp-reorder-packets", MMTP_REORDER_WINDOW_DEFAULT_MAX_PACKETS,
+                 REORDER_PACKETS_TEXT, REORDER_PACKETS_LONGTEXT, true )
+        change_integer_range( 0, MMTP_REORDER_WINDOW_MAX_PACKETS )
+    add_integer( "mmtp-reorder-ms", MMTP_REORDER_WINDOW_DEFAULT_MAX_HOLD_US / 1000,
+                 REORDER_MS_TEXT, REORDER_MS_LONGTEXT, true )
+    add_bool( "mmtp-emit-corrupt-samples", false, EMIT_CORRUPT_SAMPLES_TEXT, EMIT_CORRUPT_SAMPLES_LONGTEXT, true )
+    add_bool( "mmtp-ip-input", false, IP_INPUT_TEXT, IP_INPUT_LONGTEXT, true )
+    add_integer( "mmtp-receive-ring", MMTP_RECEIVE_RING_DEFAULT_SIZE,
+                 RECEIVE_RING_TEXT, RECEIVE_RING_LONGTEXT, true )
+        change_integer_range( 0, ATSC3_SPSC_RING_MAX_CAPACITY )
+    add_integer( "mmtp-pcr-delay", MMTP_PCR_DELAY_DEFAULT_MS,
+                 PCR_DELAY_TEXT, PCR_DELAY_LONGTEXT, true )
+        change_integer_range( 0, 10000 )
+    add_bool( "mmtp-mpu-metadata-cache", true, MPU_METADATA_CACHE_TEXT, MPU_METADATA_CACHE_LONGTEXT, true )
+    add_bool( "mmtp-hrbm", true, HRBM_TEXT, HRBM_LONGTEXT, true )
+    add_bool( "mmtp-objects", true, OBJECTS_TEXT, OBJECTS_LONGTEXT, true )
+    add_bool( "mmtp-al-fec", false, AL_FEC_TEXT, AL_FEC_LONGTEXT, true )
+    add_integer( "mmtp-stats-interval", MMTP_STATS_INTERVAL_DEFAULT_S, STATS_INTERVAL_TEXT, STATS_INTERVAL_LONGTEXT, true )
+        change_integer_range( 0, 3600 )
+    add_integer( "mmtp-trace-level", ATSC3_TRACE_LEVEL_WARN, TRACE_LEVEL_TEXT, TRACE_LEVEL_LONGTEXT, true )
+        change_integer_range( ATSC3_TRACE_LEVEL_NONE, ATSC3_TRACE_LEVEL_TRACE )
+    add_integer( "mmtp-trace-events", 0, TRACE_EVENTS_TEXT, TRACE_EVENTS_LONGTEXT, true )
+        change_integer_range( 0, ATSC3_TRACE_RING_MAX_CAPACITY )
+    add_string( "mmtp-trace-dump-key", NULL, TRACE_DUMP_KEY_TEXT, TRACE_DUMP_KEY_LONGTEXT, true )
     set_callbacks( Open, Close )
     add_shortcut( "MMTP" )
+
+    add_submodule()
+        set_shortname( "pcap" )
+        set_description( N_("MMTP/LLS pcap replay") )
+        set_category( CAT_INPUT )
+        set_subcategory( SUBCAT_INPUT_ACCESS )
+        set_capability( "access", 0 )
+        add_string( "pcap-dst", NULL, PCAP_DST_TEXT, PCAP_DST_LONGTEXT, true )
+        add_bool( "pcap-realtime", true, PCAP_REALTIME_TEXT, PCAP_REALTIME_LONGTEXT, true )
+        add_bool( "pcap-ip-headers", false, PCAP_IP_HEADERS_TEXT, PCAP_IP_HEADERS_LONGTEXT, true )
+        set_callbacks( OpenPcapAccess, ClosePcapAccess )
+        add_shortcut( "pcap" )
 vlc_module_end ()
 
 
@@ -362,7 +505,17 @@ static int   Demux   ( demux_t * );
 static int   Control ( demux_t *, int, va_list );
 
 void processMpuPacket(demux_t* p_obj, mmtp_sub_flow_t *mmtp_sub_flow, mmtp_payload_fragments_union_t* mpu_type_packet);
+static mmtp_pcr_clock_t* mmtp_pcr_clock_get(demux_sys_t *p_sys, mmtp_service_t *mmtp_service);
+static vlc_tick_t mmtp_demuxer_clock_now(demux_sys_t *p_sys);
+static void mmtp_pcr_clock_init(mmtp_pcr_clock_t *pcr_clock);
+static void mmtp_demuxer_update_pcr(demux_t *p_demux, mmtp_service_t *mmtp_service, vlc_tick_t now);
+static void mmtp_demuxer_reorder_expire(demux_t *p_demux, vlc_tick_t now);
 void createTracksFromMpuMetadata(demux_t *p_obj, mmtp_sub_flow_t* mmtp_sub_flow);
+static int processMpuMetadata(demux_t *p_demux, mmtp_sub_flow_t *mmtp_sub_flow, const uint8_t *p_mpu_metadata, size_t i_mpu_metadata);
+static void releaseMpuMetadataTracks(demux_t *p_demux, mpu_isobmff_fragment_parameters_t *isobmff_parameters);
+static void mmtp_objects_open(demux_t *p_demux);
+static void mmtp_objects_close(demux_t *p_demux);
+static void processLlsSlt(void *context, lls_table_ref_t *lls_table_ref);
 
 void dumpMpu(demux_t *p_demux, block_t *mpu);
 void dumpMfu(demux_t *p_demux, block_t *mpu);
@@ -412,6 +565,7 @@ static int  ProbeFragments( demux_t *p_demux, mpu_isobmff_fragment_parameters_t*
  * l	 	108        		* 3.0 show LLS messages from 224.0.23.60/4937
  * p     	112    		show pps and packet loss statistics via packet counter gaps
  * s    	115			show signalling messages
+ * mmtp-trace-dump-key		dump the mmtp-trace-events ring to the user cache directory
  * key-up	2293760			* 3.0 increment channel
  * key-down 2359296			* 3.0 decrement channel
  */
@@ -426,6 +580,13 @@ static int vlc_key_to_action (vlc_object_t *obj, const char *varname, vlc_value_
 
     vlc_object_t *my_object_ref = d;
 
+    //the ring has a single writer, Demux dumps it on its next call
+    demux_sys_t *p_sys = ((demux_t *)my_object_ref)->p_sys;
+    if(p_sys->i_trace_dump_key != KEY_UNSET && keycode == p_sys->i_trace_dump_key) {
+        atomic_store(&p_sys->b_trace_dump, true);
+        return VLC_SUCCESS;
+    }
+
  //   vlc_object_t *my_object_ref = obj;
 
     switch(keycode) {
@@ -454,488 +615,1544 @@ static int vlc_key_to_action (vlc_object_t *obj, const char *varname, vlc_value_
     return VLC_SUCCESS;
 }
 
-
-
-/*
- * Initializes the MMTP demuxer
+/**
+ * receive stage (mmtp-receive-ring)
  *
- * set some default values and init our mmtp sub flow vector for re-assembly
+ * MmtpReceiveThread only reads datagrams and pushes them on the spsc ring, Demux pops them and runs
+ * parse, reorder, reassembly and es_out as before. when the ring is full the datagram is dropped, as a
+ * full socket buffer would, instead of blocking the socket behind a slow demux. that only holds for
+ * live input: a stream that can be paced (a file, a pcap replayed as fast as possible) is read on the
+ * demux thread instead, where nothing is lost and reading waits for the demuxer.
+ *
+ * the demux thread only sleeps once the ring is empty: it raises b_receive_waiting and re-checks the
+ * ring before waiting, and the receive thread posts the semaphore only when that flag is set.
+ * with reordering on, receive_timer wakes it as well, so reorder gaps are given up on while nothing arrives.
  */
+static void mmtp_receive_wakeup(demux_sys_t *p_sys) {
+	atomic_thread_fence(memory_order_seq_cst);
+	if(atomic_exchange(&p_sys->b_receive_waiting, false))
+		vlc_sem_post(&p_sys->receive_sem);
+}
 
-static int Open( vlc_object_t * p_this )
-{
-    demux_t *p_demux = (demux_t*)p_this;
-    demux_sys_t *p_sys = NULL;
+/**
+ * stamp the datagram with its arrival time if the access did not, and once a second ask the access
+ * how many datagrams it lost before we could read them, so socket overflow can be told apart from
+ * network loss (reorder window gaps). called on the thread reading p_demux->s
+ */
+static void mmtp_receive_stamp(demux_t *p_demux, block_t *p_block) {
+	demux_sys_t *p_sys = p_demux->p_sys;
+	vlc_tick_t now = vlc_tick_now();
+	uint64_t i_drops;
 
-    p_demux->pf_demux = Demux;
-    p_demux->pf_control = Control;
+	if(p_block->i_dts == VLC_TICK_INVALID)
+		p_block->i_dts = now;
 
-    p_sys = calloc( 1, sizeof( demux_sys_t ) );
+	if(now < p_sys->i_recv_drops_next_poll)
+		return;
+	p_sys->i_recv_drops_next_poll = now + MMTP_RECV_DROPS_POLL_INTERVAL;
 
+	if(vlc_stream_Control(p_demux->s, STREAM_GET_RECV_DROPS, &i_drops) == VLC_SUCCESS &&
+			i_drops > atomic_load(&p_sys->i_recv_drops)) {
+		msg_Warn(p_demux, "mmtp_demuxer - socket receive buffer overflowed, %"PRIu64" datagrams dropped before they were read",
+				i_drops - atomic_load(&p_sys->i_recv_drops));
+		atomic_store(&p_sys->i_recv_drops, i_drops);
+	}
+}
 
-    if ( !p_sys )
-          return VLC_EGENERIC;
+static void *MmtpReceiveThread(void *p_data) {
+	demux_t *p_demux = p_data;
+	demux_sys_t *p_sys = p_demux->p_sys;
 
-    p_demux->p_sys = p_sys;
+	for(;;) {
+		block_t *p_block = vlc_stream_ReadBlock(p_demux->s);
+		int canc = vlc_savecancel();
 
-    p_sys->obj = p_this;
-    p_sys->context.i_lastseqnumber = UINT32_MAX;
-    p_sys->p_mpu_block = NULL;
+		if(!p_block) {
+			if(vlc_stream_Eof(p_demux->s)) {
+				atomic_store(&p_sys->b_receive_eof, true);
+				mmtp_receive_wakeup(p_sys);
+				vlc_restorecancel(canc);
+				break;
+			}
+			vlc_restorecancel(canc);
+			continue;
+		}
 
-//    p_sys->b_seekable = true;
-//    p_sys->b_fragmented = true;
+		mmtp_receive_stamp(p_demux, p_block);
+		if(atsc3_spsc_ring_push(&p_sys->receive_ring, p_block)) {
+			block_Release(p_block);
+		} else {
+			mmtp_receive_wakeup(p_sys);
+		}
+		vlc_restorecancel(canc);
+	}
 
-    //vlc_stream_fifo doesn't support seeking, which is required for libmp4 box parsing, so double buffer into s_frag
+	return NULL;
+}
 
-    p_sys->last_mpu_sequence_number = -1;
-    p_sys->last_mpu_fragment_type = -1;
-    p_sys->has_processed_ftype_moov = 0;
+//NULL on end of stream or when the input is interrupted
+static void mmtp_receive_timer(void *data) {
+	mmtp_receive_wakeup(data);
+}
 
-    mmtp_sub_flow_vector_init(&p_sys->mmtp_sub_flow_vector);
+//NULL at eof, on interrupt, or when woken by receive_timer with nothing read
+static block_t *mmtp_receive_ring_pop(demux_t *p_demux) {
+	demux_sys_t *p_sys = p_demux->p_sys;
 
+	for(;;) {
+		block_t *p_block = atsc3_spsc_ring_pop(&p_sys->receive_ring);
+		if(p_block)
+			return p_block;
 
-    var_Create(VLC_OBJECT(p_this)->obj.libvlc, "key-pressed", VLC_VAR_INTEGER);
-    var_AddCallback(p_this->obj.libvlc, "key-pressed", vlc_key_to_action, (void*)p_this);
+		//everything was pushed before eof was raised
+		if(atomic_load(&p_sys->b_receive_eof))
+			return atsc3_spsc_ring_pop(&p_sys->receive_ring);
 
+		atomic_store(&p_sys->b_receive_waiting, true);
+		atomic_thread_fence(memory_order_seq_cst);
 
-    __LOG_INFO(p_demux, "mmtp_demuxer.open() - complete, p_sys->mmtp_sub_flow_vector is: %p", p_sys->mmtp_sub_flow_vector);
+		p_block = atsc3_spsc_ring_pop(&p_sys->receive_ring);
+		if(p_block) {
+			//a post that raced us only costs one spurious wakeup later on
+			atomic_store(&p_sys->b_receive_waiting, false);
+			return p_block;
+		}
 
-    return VLC_SUCCESS;
+		if(!atomic_load(&p_sys->b_receive_eof) && vlc_sem_wait_i11e(&p_sys->receive_sem))
+			return NULL;
+		if(!p_sys->b_receive_timer)
+			continue;
+		return atsc3_spsc_ring_pop(&p_sys->receive_ring);
+	}
 }
 
+static void mmtp_receive_thread_start(demux_t *p_demux, uint32_t i_ring_size) {
+	demux_sys_t *p_sys = p_demux->p_sys;
 
-/**
- * Destroys the MMTP-demuxer
- *
- * todo: clear our re-assembly vectors
- */
-static void Close( vlc_object_t *p_this )
-{
-    demux_t *p_demux = (demux_t*)p_this;
+	if(!i_ring_size || atsc3_spsc_ring_init(&p_sys->receive_ring, i_ring_size))
+		return;
+
+	vlc_sem_init(&p_sys->receive_sem, 0);
+	atomic_init(&p_sys->b_receive_waiting, false);
+	atomic_init(&p_sys->b_receive_eof, false);
+
+	if(vlc_clone(&p_sys->receive_thread, MmtpReceiveThread, p_demux, VLC_THREAD_PRIORITY_INPUT)) {
+		msg_Warn(p_demux, "mmtp_demuxer - unable to start the receive thread, reading on the demux thread");
+		vlc_sem_destroy(&p_sys->receive_sem);
+		atsc3_spsc_ring_free(&p_sys->receive_ring);
+		return;
+	}
+
+	p_sys->b_receive_thread = true;
+
+	if(p_sys->i_reorder_packets && !vlc_timer_create(&p_sys->receive_timer, mmtp_receive_timer, p_sys)) {
+		p_sys->b_receive_timer = true;
+		vlc_timer_schedule(p_sys->receive_timer, false, MMTP_REORDER_EXPIRE_INTERVAL, MMTP_REORDER_EXPIRE_INTERVAL);
+	}
+}
+
+static void mmtp_receive_thread_stop(demux_t *p_demux) {
 	demux_sys_t *p_sys = p_demux->p_sys;
+	block_t *p_block;
 
+	if(!p_sys->b_receive_thread)
+		return;
 
-    if(p_sys) {
-    	free(p_sys);
-    }
-    p_demux->p_sys = NULL;
+	if(p_sys->b_receive_timer) {
+		vlc_timer_destroy(p_sys->receive_timer);
+		p_sys->b_receive_timer = false;
+	}
 
-    __LOG_INFO(p_demux, "mmtp_demuxer.close()");
+	vlc_cancel(p_sys->receive_thread);
+	vlc_join(p_sys->receive_thread, NULL);
+	p_sys->b_receive_thread = false;
+
+	while((p_block = atsc3_spsc_ring_pop(&p_sys->receive_ring)))
+		block_Release(p_block);
+
+	atsc3_spsc_ring_stats_dump(&p_sys->receive_ring, "mmtp_receive_ring");
+	atsc3_spsc_ring_free(&p_sys->receive_ring);
+	vlc_sem_destroy(&p_sys->receive_sem);
 }
 
-/**
- *
- * mmtp demuxer,
- * 	rebuild UDP packets into one MFU packet, push to es for output
- *
- * 	todo:
- * 		decode
- *
- * use p_sys->s for udp,
- * use p_sys->s_frag for fragmented mp4 demux / decoding
- *
- */
+static const char* mmtp_cache_scope_get(demux_sys_t *p_sys, mmtp_service_t *mmtp_service) {
+	return mmtp_service ? mmtp_service->psz_cache_scope : p_sys->psz_cache_scope;
+}
 
-static int Demux( demux_t *p_demux )
-{
+//mmtp-mpu-metadata-cache lives in the user cache directory, whatever is in there from an earlier session is loaded
+static void mmtp_mpu_metadata_cache_open(demux_t *p_demux) {
 	demux_sys_t *p_sys = p_demux->p_sys;
-	mmtp_sub_flow_vector_t *mmtp_sub_flow_vector = &p_sys->mmtp_sub_flow_vector;
-	mmtp_sub_flow_t *mmtp_sub_flow = NULL;
-	mmtp_payload_fragments_union_t *mmtp_packet_header = NULL;
-	block_t *mmtp_raw_packet_block;
 
-	ssize_t mmtp_raw_packet_size = -1;
+	char *psz_dir = config_GetUserDir(VLC_CACHE_DIR);
+	if(!psz_dir)
+		return;
 
-	//__LOG_INFO(p_demux, "mmtp_demuxer.demux()");
+	if(vlc_mkdir(psz_dir, 0700) && errno != EEXIST) {
+		msg_Warn(p_demux, "mmtp_demuxer - cannot create %s, mpu metadata cache disabled", psz_dir);
+	} else if(asprintf(&p_sys->psz_mpu_metadata_cache_path, "%s" DIR_SEP MMTP_MPU_METADATA_CACHE_FILE, psz_dir) == -1) {
+		p_sys->psz_mpu_metadata_cache_path = NULL;
+	}
+	free(psz_dir);
 
-    /* Get a new MMTP packet, use p_demux->s as the blocking reference and 1514 as the max mtu in udp.c*/
-    //vlc_stream_Block will try and fill MAX_MTU_SIZE instead of relying on the
-    //  MMTP udp frame size
-    //readPartial still reads a block_chain
-    // if( !( mmtp_raw_packet_size = vlc_stream_ReadPartial( p_demux->s, (void*)rawBuf, MAX_MMTP_SIZE ) ) )
+	if(p_sys->psz_mpu_metadata_cache_path) {
+		int i_loaded = mpu_metadata_cache_load(&p_sys->mpu_metadata_cache, p_sys->psz_mpu_metadata_cache_path);
+		if(i_loaded > 0) {
+			msg_Dbg(p_demux, "mmtp_demuxer - %d cached mpu metadata loaded from %s", i_loaded, p_sys->psz_mpu_metadata_cache_path);
+		}
+	}
+}
 
-	block_t *read_block;
+static void mmtp_mpu_metadata_cache_close(demux_t *p_demux) {
+	demux_sys_t *p_sys = p_demux->p_sys;
 
-    if( !( read_block = vlc_stream_ReadBlock( p_demux->s) ) )
-    {
-		msg_Err( p_demux, "mmtp_demuxer - access request returned null!");
-		return VLC_DEMUXER_SUCCESS;
+	if(p_sys->psz_mpu_metadata_cache_path) {
+		if(p_sys->mpu_metadata_cache.is_dirty && mpu_metadata_cache_save(&p_sys->mpu_metadata_cache, p_sys->psz_mpu_metadata_cache_path)) {
+			msg_Warn(p_demux, "mmtp_demuxer - cannot save the mpu metadata cache to %s", p_sys->psz_mpu_metadata_cache_path);
+		}
+		mpu_metadata_cache_stats_dump(&p_sys->mpu_metadata_cache);
 	}
+	mpu_metadata_cache_free(&p_sys->mpu_metadata_cache);
+	free(p_sys->psz_mpu_metadata_cache_path);
+	free(p_sys->psz_cache_scope);
+}
+
+/**
+ * libatsc3 log lines carry no demuxer and are shared by all of them, so they go to the vlc log of the
+ * libvlc instance, at the level the trace site asked for.
+ * mmtp-trace-events keeps per-packet events in a binary ring instead, dumped on mmtp-trace-dump-key,
+ * DEMUX_MMTP_DUMP_TRACE_EVENTS and on close
+ */
+static void mmtp_trace_sink(void *context, int level, const char *file, int line, const char *message) {
+	int i_type = level <= ATSC3_TRACE_LEVEL_ERROR ? VLC_MSG_ERR :
+				 level == ATSC3_TRACE_LEVEL_WARN ? VLC_MSG_WARN :
+				 level == ATSC3_TRACE_LEVEL_INFO ? VLC_MSG_INFO : VLC_MSG_DBG;
+	vlc_Log((vlc_object_t *)context, i_type, vlc_module_name, file, line, "atsc3_trace", "%s", message);
+}
 
-    __LOG_TRACE(p_demux, "%d:mmtp_demuxer: vlc_stream_readblock size is: %d", __LINE__, read_block->i_buffer);
-    mmtp_raw_packet_size =  read_block->i_buffer;
+static void mmtp_trace_open(demux_t *p_demux) {
+	demux_sys_t *p_sys = p_demux->p_sys;
 
-   	if( mmtp_raw_packet_size > MAX_MMTP_SIZE || mmtp_raw_packet_size < MIN_MMTP_SIZE) {
-   		msg_Err( p_demux, "%d:mmtp_demuxer - size from UDP was under/over heureis/max, dropping %d bytes", __LINE__, mmtp_raw_packet_size);
-   		//   		free(raw_buf); //only free raw_buf
-   		return VLC_DEMUXER_SUCCESS;
-   	}
+	atsc3_trace_sink_register(&p_sys->trace_sink, mmtp_trace_sink, p_demux->obj.libvlc, var_InheritInteger(p_demux, "mmtp-trace-level"));
 
+	atomic_init(&p_sys->b_trace_dump, false);
+	char *psz_key = var_InheritString(p_demux, "mmtp-trace-dump-key");
+	p_sys->i_trace_dump_key = psz_key ? vlc_str2keycode(psz_key) : KEY_UNSET;
+	if(psz_key && *psz_key && p_sys->i_trace_dump_key == KEY_UNSET) {
+		msg_Warn(p_demux, "mmtp_demuxer - mmtp-trace-dump-key: unknown key %s", psz_key);
+	}
+	free(psz_key);
+	if(atsc3_trace_ring_init(&p_sys->trace_ring, var_InheritInteger(p_demux, "mmtp-trace-events"))) {
+		msg_Warn(p_demux, "mmtp_demuxer - cannot allocate the trace event ring, mmtp-trace-events disabled");
+	}
+}
 
-	mmtp_raw_packet_block = block_Duplicate(read_block);
+//appended to MMTP_TRACE_FILE in the user cache directory, one block per dump
+static void mmtp_trace_dump(demux_t *p_demux) {
+	demux_sys_t *p_sys = p_demux->p_sys;
 
-	mmtp_packet_header = mmtp_packet_header_allocate_from_raw_packet(mmtp_raw_packet_block);
+	if(!p_sys->trace_ring.events)
+		return;
 
-	int i_status = mmtp_packet_header_parse_from_raw_packet(mmtp_packet_header, p_demux);
-	if(i_status != VLC_DEMUXER_SUCCESS) {
-   		msg_Err( p_demux, "%d:mmtp_demuxer - mmtp_packet_header_parse_from_raw_packet failed, dropping packet", __LINE__);
+	char *psz_dir = config_GetUserDir(VLC_CACHE_DIR);
+	char *psz_path = NULL;
+	if(!psz_dir)
+		return;
+	if((vlc_mkdir(psz_dir, 0700) && errno != EEXIST) ||
+			asprintf(&psz_path, "%s" DIR_SEP MMTP_TRACE_FILE, psz_dir) == -1) {
+		psz_path = NULL;
+	}
+	free(psz_dir);
 
-   		return VLC_DEMUXER_SUCCESS;
+	FILE *fp = psz_path ? vlc_fopen(psz_path, "a") : NULL;
+	if(!fp) {
+		msg_Warn(p_demux, "mmtp_demuxer - cannot write the trace event ring to %s", psz_path ? psz_path : MMTP_TRACE_FILE);
+		free(psz_path);
+		return;
 	}
+	fprintf(fp, "--- %s, %"PRIu64" events recorded\n", p_demux->psz_location ? p_demux->psz_location : "", p_sys->trace_ring.written);
+	size_t i_dumped = atsc3_trace_ring_dump(&p_sys->trace_ring, fp);
+	fclose(fp);
 
-	//resync our buf positions
-	uint8_t *raw_buf = p_sys->raw_buf;
-	uint8_t *buf = p_sys->buf;
+	msg_Info(p_demux, "mmtp_demuxer - %zu trace events written to %s", i_dumped, psz_path);
+	free(psz_path);
+}
 
-	//create a sub_flow with this packet_id
-	__LOG_DEBUG( p_demux, "%d:mmtp_demuxer, after mmtp_packet_header_parse_from_raw_packet, mmtp_packet_id is: %d, mmtp_payload_type: 0x%x, packet_counter: %d, remaining len: %d, mmtp_raw_packet_size: %d, buf: %p, raw_buf:%p",
-			__LINE__,
-			mmtp_packet_header->mmtp_packet_header.mmtp_packet_id,
-			mmtp_packet_header->mmtp_packet_header.mmtp_payload_type,
-			mmtp_packet_header->mmtp_packet_header.packet_counter,
-			(mmtp_raw_packet_size - (buf - raw_buf)),
-			mmtp_raw_packet_size,
-			buf,
-			raw_buf);
+static void mmtp_trace_close(demux_t *p_demux) {
+	demux_sys_t *p_sys = p_demux->p_sys;
 
-	mmtp_sub_flow = mmtp_sub_flow_vector_get_or_set_packet_id(mmtp_sub_flow_vector, mmtp_packet_header->mmtp_packet_header.mmtp_packet_id);
-	__LOG_DEBUG( p_demux, "%d:mmtp_demuxer - mmtp_sub_flow is: %p, mmtp_sub_flow->mpu_fragments: %p", __LINE__, mmtp_sub_flow, mmtp_sub_flow->mpu_fragments);
+	mmtp_trace_dump(p_demux);
+	atsc3_trace_sink_unregister(&p_sys->trace_sink);
+	atsc3_trace_ring_free(&p_sys->trace_ring);
+}
 
-	//push this to the proper fragment container, continue parsing below
-	mmtp_sub_flow_push_mmtp_packet(mmtp_sub_flow, mmtp_packet_header);
+/**
+ * flow stats: per packet_id counters, kept for every packet and published every mmtp-stats-interval as one
+ * media information category per flow, where the http interface and the info dialog pick them up
+ */
+//i_max_us is a latency bucket upper bound, the last bucket has none
+static void mmtp_flow_stats_add_latency_info(input_item_t *p_item, const char *psz_category, const char *psz_name, int64_t i_max_us) {
+	if(i_max_us == INT64_MAX) {
+		input_item_AddInfo(p_item, psz_category, psz_name, "over %"PRId64" ms", mmtp_flow_stats_latency_bucket_max_us(MMTP_FLOW_STATS_LATENCY_BUCKETS - 2) / 1000);
+	} else {
+		input_item_AddInfo(p_item, psz_category, psz_name, "under %"PRId64" ms", i_max_us / 1000);
+	}
+}
 
-	//if our header extension length is set, then block extract the header extension length, adn we should be at our payload data
-	uint8_t *mmtp_header_extension_value = NULL;
+static void mmtp_flow_stats_publish_vector(demux_t *p_demux, mmtp_service_t *mmtp_service, mmtp_sub_flow_vector_t *mmtp_sub_flow_vector) {
+	input_item_t *p_item = p_demux->p_input_item;
+	char psz_category[64];
 
-	if(mmtp_packet_header->mmtp_packet_header.mmtp_header_extension_flag & 0x1) {
-		//clamp mmtp_header_extension_length
-		mmtp_packet_header->mmtp_packet_header.mmtp_header_extension_length = MIN(mmtp_packet_header->mmtp_packet_header.mmtp_header_extension_length, 2^16);
+	for(size_t i=0; i < mmtp_sub_flow_vector->size; i++) {
+		mmtp_sub_flow_t *mmtp_sub_flow = mmtp_sub_flow_vector->data[i];
+		const mmtp_flow_stats_t *stats = &mmtp_sub_flow->flow_stats;
+		if(!stats->packets && !stats->packets_fec_recovered)
+			continue;
 
-		__LOG_DEBUG( p_demux, "mmtp_header_extension_flag, header extension size: %d, packet version: %d, payload_type: 0x%X, packet_id 0x%hu, timestamp: 0x%X, packet_sequence_number: 0x%X, packet_counter: 0x%X",
-				mmtp_packet_header->mmtp_packet_header.mmtp_packet_version,
-				mmtp_packet_header->mmtp_packet_header.mmtp_header_extension_length,
-				mmtp_packet_header->mmtp_packet_header.mmtp_payload_type,
-				mmtp_packet_header->mmtp_packet_header.mmtp_packet_id,
-				mmtp_packet_header->mmtp_packet_header.mmtp_timestamp,
-				mmtp_packet_header->mmtp_packet_header.packet_sequence_number,
-				mmtp_packet_header->mmtp_packet_header.packet_counter);
+		if(mmtp_service) {
+			snprintf(psz_category, sizeof(psz_category), "MMTP service %hu, packet_id %hu", mmtp_service->service_id, mmtp_sub_flow->mmtp_packet_id);
+		} else {
+			snprintf(psz_category, sizeof(psz_category), "MMTP packet_id %hu", mmtp_sub_flow->mmtp_packet_id);
+		}
 
-		mmtp_packet_header->mmtp_packet_header.mmtp_header_extension_value = malloc(mmtp_packet_header->mmtp_packet_header.mmtp_header_extension_length);
-		//read the header extension value up to the extension length field 2^16
-		buf = extract(buf, &mmtp_packet_header->mmtp_packet_header.mmtp_header_extension_value, mmtp_packet_header->mmtp_packet_header.mmtp_header_extension_length);
-	}
+		input_item_AddInfo(p_item, psz_category, _("Packets"), "%"PRIu64, stats->packets);
+		input_item_AddInfo(p_item, psz_category, _("Bytes"), "%"PRIu64, stats->bytes);
+		input_item_AddInfo(p_item, psz_category, _("Lost packets"), "%"PRIu64" in %"PRIu64" gaps", stats->packets_lost, stats->gaps);
+		input_item_AddInfo(p_item, psz_category, _("Out of order packets"), "%"PRIu64, stats->packets_out_of_order);
+		input_item_AddInfo(p_item, psz_category, _("FEC recovered packets"), "%"PRIu64, stats->packets_fec_recovered);
+		input_item_AddInfo(p_item, psz_category, _("MPUs completed"), "%"PRIu64, stats->mpus_completed);
+		input_item_AddInfo(p_item, psz_category, _("MPUs incomplete"), "%"PRIu64, stats->mpus_incomplete);
+		input_item_AddInfo(p_item, psz_category, _("Timestamp jitter"), "%"PRId64" us", mmtp_flow_stats_jitter_us(stats));
+
+		if(!stats->mpus_completed)
+			continue;
+
+		//p50/p99 are bucket upper bounds, the histogram is "bound in ms: count" per non-empty bucket
+		char psz_histogram[MMTP_FLOW_STATS_LATENCY_BUCKETS * 32];
+		size_t i_histogram = 0;
+		psz_histogram[0] = '\0';
+		for(int j=0; j < MMTP_FLOW_STATS_LATENCY_BUCKETS; j++) {
+			if(!stats->reassembly_latency_histogram[j])
+				continue;
+			int64_t i_max_us = mmtp_flow_stats_latency_bucket_max_us(j);
+			int i_len = i_max_us == INT64_MAX ?
+					snprintf(&psz_histogram[i_histogram], sizeof(psz_histogram) - i_histogram, "%s>%"PRId64": %"PRIu64,
+							i_histogram ? ", " : "", mmtp_flow_stats_latency_bucket_max_us(j - 1) / 1000, stats->reassembly_latency_histogram[j]) :
+					snprintf(&psz_histogram[i_histogram], sizeof(psz_histogram) - i_histogram, "%s<%"PRId64": %"PRIu64,
+							i_histogram ? ", " : "", i_max_us / 1000, stats->reassembly_latency_histogram[j]);
+			if(i_len < 0 || (size_t)i_len >= sizeof(psz_histogram) - i_histogram)
+				break;
+			i_histogram += i_len;
+		}
 
-	if(mmtp_packet_header->mmtp_packet_header.mmtp_payload_type == 0x1) {
-		msg_Warn(p_demux, "%d:mmtp_payload_type: DROPPING payload: 0x1 - generic object", __LINE__);
-		goto done;
+		mmtp_flow_stats_add_latency_info(p_item, psz_category, _("Reassembly latency p50"), mmtp_flow_stats_latency_percentile_us(stats, 50));
+		mmtp_flow_stats_add_latency_info(p_item, psz_category, _("Reassembly latency p99"), mmtp_flow_stats_latency_percentile_us(stats, 99));
+		input_item_AddInfo(p_item, psz_category, _("Reassembly latency (ms)"), "%s", psz_histogram);
 	}
+}
 
-	if(mmtp_packet_header->mmtp_packet_header.mmtp_payload_type == 0x2) {
-		msg_Warn(p_demux, "%d:mmtp_payload_type: DROPPING payload: 0x2 - signalling message", __LINE__);
-		goto done;
-	}
+static void mmtp_flow_stats_publish(demux_t *p_demux) {
+	demux_sys_t *p_sys = p_demux->p_sys;
 
-	if(mmtp_packet_header->mmtp_packet_header.mmtp_payload_type == 0x0) {
-		//VECTOR:  TODO - refactor this into helper method
+	if(!p_demux->p_input_item)
+		return;
 
-		//pull the mpu and frag iformation
+	mmtp_flow_stats_publish_vector(p_demux, NULL, &p_sys->mmtp_sub_flow_vector);
+	for(int i=0; i < p_sys->i_services; i++) {
+		mmtp_flow_stats_publish_vector(p_demux, p_sys->pp_services[i], &p_sys->pp_services[i]->mmtp_sub_flow_vector);
+	}
 
-		uint8_t mpu_payload_length_block[2];
-		uint16_t mpu_payload_length = 0;
+	input_item_AddInfo(p_demux->p_input_item, "MMTP", _("Socket receive drops"), "%"PRIu64, (uint64_t)atomic_load(&p_sys->i_recv_drops));
+	if(p_sys->b_ip_input) {
+		input_item_AddInfo(p_demux->p_input_item, "MMTP", _("Datagrams without an SLT service"), "%"PRIu64, p_sys->i_unmatched_datagrams);
+		input_item_AddInfo(p_demux->p_input_item, "MMTP", _("LLS tables parsed"), "%"PRIu64, p_sys->lls_table_manager.tables_changed);
+		input_item_AddInfo(p_demux->p_input_item, "MMTP", _("LLS tables skipped as unchanged"), "%"PRIu64, p_sys->lls_table_manager.tables_unchanged);
+	}
+}
 
-		//msg_Warn( p_demux, "buf pos before mpu_payload_length extract is: %p", (void *)buf);
-		buf = extract(buf, &mpu_payload_length_block, 2);
-		mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_payload_length = (mpu_payload_length_block[0] << 8) | mpu_payload_length_block[1];
-		//__LOG_DEBUG( p_demux, "mmtp_demuxer - doing mpu_payload_length: %hu (0x%X 0x%X)",  mpu_payload_length, mpu_payload_length_block[0], mpu_payload_length_block[1]);
+static size_t mmtp_flow_stats_snapshot_vector(mmtp_flow_stats_entry_t *p_entries, uint16_t service_id, mmtp_sub_flow_vector_t *mmtp_sub_flow_vector) {
+	for(size_t i=0; i < mmtp_sub_flow_vector->size; i++) {
+		p_entries[i].service_id = service_id;
+		p_entries[i].mmtp_packet_id = mmtp_sub_flow_vector->data[i]->mmtp_packet_id;
+		p_entries[i].flow_stats = mmtp_sub_flow_vector->data[i]->flow_stats;
+	}
+	return mmtp_sub_flow_vector->size;
+}
 
-		uint8_t mpu_fragmentation_info;
-		//msg_Warn( p_demux, "buf pos before extract is: %p", (void *)buf);
-		buf = extract(buf, &mpu_fragmentation_info, 1);
+//DEMUX_GET_MMTP_FLOW_STATS
+static int mmtp_flow_stats_snapshot(demux_t *p_demux, mmtp_flow_stats_entry_t **pp_entries, size_t *pi_entries) {
+	demux_sys_t *p_sys = p_demux->p_sys;
 
-		mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_fragment_type = (mpu_fragmentation_info & 0xF0) >> 4;
-		mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_timed_flag = (mpu_fragmentation_info & 0x8) >> 3;
-		mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_fragmentation_indicator = (mpu_fragmentation_info & 0x6) >> 1;
-		mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_aggregation_flag = (mpu_fragmentation_info & 0x1);
+	size_t i_entries = p_sys->mmtp_sub_flow_vector.size;
+	for(int i=0; i < p_sys->i_services; i++) {
+		i_entries += p_sys->pp_services[i]->mmtp_sub_flow_vector.size;
+	}
+	if(!i_entries)
+		return VLC_EGENERIC;
 
-		__LOG_DEBUG( p_demux, "%d:mmtp_demuxer - mmtp packet: mpu_fragmentation_info is: 0x%x, mpu_fragment_type: 0x%x, mpu_timed_flag: 0x%x, mpu_fragmentation_indicator: 0x%x, mpu_aggregation_flag: 0x%x",
-					__LINE__,
-					mpu_fragmentation_info,
-					mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_fragment_type,
-					mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_timed_flag,
-					mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_fragmentation_indicator,
-					mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_aggregation_flag);
+	mmtp_flow_stats_entry_t *p_entries = vlc_alloc(i_entries, sizeof(mmtp_flow_stats_entry_t));
+	if(!p_entries)
+		return VLC_ENOMEM;
 
+	size_t i_entry = mmtp_flow_stats_snapshot_vector(p_entries, 0, &p_sys->mmtp_sub_flow_vector);
+	for(int i=0; i < p_sys->i_services; i++) {
+		i_entry += mmtp_flow_stats_snapshot_vector(&p_entries[i_entry], p_sys->pp_services[i]->service_id, &p_sys->pp_services[i]->mmtp_sub_flow_vector);
+	}
 
+	*pp_entries = p_entries;
+	*pi_entries = i_entries;
+	return VLC_SUCCESS;
+}
 
-		uint8_t mpu_fragmentation_counter;
-		//msg_Warn( p_demux, "buf pos before extract is: %p", (void *)buf);
-		buf = extract(buf, &mpu_fragmentation_counter, 1);
-		mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_fragmentation_counter = mpu_fragmentation_counter;
+/**
+ * set up every asset last seen on this service from its cached mpu metadata, so the ES and decoders are ready
+ * before the first MPU arrives. MFUs are held back until a random access point, as we may join mid-MPU
+ */
+static void restoreMpuMetadataFromCache(demux_t *p_demux, mmtp_service_t *mmtp_service, mmtp_sub_flow_vector_t *mmtp_sub_flow_vector) {
+	demux_sys_t *p_sys = p_demux->p_sys;
+	const char *psz_scope = mmtp_cache_scope_get(p_sys, mmtp_service);
 
-		//re-fanagle
-		uint8_t mpu_sequence_number_block[4];
+	if(!p_sys->psz_mpu_metadata_cache_path || !psz_scope)
+		return;
 
-		buf = extract(buf, &mpu_sequence_number_block, 4);
-		mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_sequence_number = (mpu_sequence_number_block[0] << 24)  | (mpu_sequence_number_block[1] <<16) | (mpu_sequence_number_block[2] << 8) | (mpu_sequence_number_block[3]);
-		__LOG_DEBUG( p_demux, "%d:mmtp_demuxer - mmtp packet: mpu_payload_length: %hu (0x%X 0x%X), mpu_fragmentation_counter: %d, mpu_sequence_number: %d",
-				__LINE__,
-				mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_payload_length,
-				mpu_payload_length_block[0],
-				mpu_payload_length_block[1],
-				mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_fragmentation_counter,
-				mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_sequence_number);
+	for(size_t i=0; i < p_sys->mpu_metadata_cache.entries_n; i++) {
+		mpu_metadata_cache_entry_t *entry = &p_sys->mpu_metadata_cache.entries[i];
+		if(!entry->mpu_metadata || strcmp(entry->scope, psz_scope)) {
+			continue;
+		}
+		entry = mpu_metadata_cache_find(&p_sys->mpu_metadata_cache, psz_scope, entry->packet_id);
 
+		mmtp_sub_flow_t *mmtp_sub_flow = mmtp_sub_flow_vector_get_or_set_packet_id(mmtp_sub_flow_vector, entry->packet_id);
+		if(!mmtp_sub_flow) {
+			continue;
+		}
 
-		mpu_fragments_assign_to_payload_vector(mmtp_sub_flow, mmtp_packet_header);
+		mpu_isobmff_fragment_parameters_t *isobmff_parameters = &mmtp_sub_flow->mpu_fragments->mpu_isobmff_fragment_parameters;
+		if(isobmff_parameters->mpu_fragments_p_root_box) {
+			continue;
+		}
+		isobmff_parameters->mmtp_service = mmtp_service;
+		if(entry->asset_type) {
+			isobmff_parameters->i_asset_type = VLC_FOURCC((entry->asset_type >> 24) & 0xFF, (entry->asset_type >> 16) & 0xFF,
+					(entry->asset_type >> 8) & 0xFF, entry->asset_type & 0xFF);
+		}
+		isobmff_parameters->i_asset_timescale = entry->asset_timescale;
 
-		//VECTOR: assign data unit payload once parsed, eventually replacing processMpuPacket
+		if(processMpuMetadata(p_demux, mmtp_sub_flow, entry->mpu_metadata, entry->mpu_metadata_length) != VLC_SUCCESS) {
+			continue;
+		}
+		isobmff_parameters->b_mpu_metadata_from_cache = true;
+		isobmff_parameters->b_wait_rap = true;
 
-		int remainingPacketLen = -1;
+		msg_Dbg(p_demux, "mmtp_demuxer - %s packet_id: %hu, tracks set up from cached mpu metadata", psz_scope, entry->packet_id);
+	}
+}
 
-		//todo - if FEC_type != 0, parse out source_FEC_payload_ID trailing bits...
-		do {
-			//pull out aggregate packets data unit length
-			int to_read_packet_length = -1;
-			//mpu_fragment_type
 
-			//only read DU length if mpu_aggregation_flag=1
-			if(mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_aggregation_flag) {
-				uint8_t data_unit_length_block[2];
-				buf = extract(buf, &data_unit_length_block, 2);
-				mmtp_packet_header->mmtp_mpu_type_packet_header.data_unit_length = (data_unit_length_block[0] << 8) | (data_unit_length_block[1]);
-				to_read_packet_length = mmtp_packet_header->mmtp_mpu_type_packet_header.data_unit_length;
-				__LOG_DEBUG(p_demux, "%d:mpu data unit size: %d, mpu_aggregation_flag:1, to_read_packet_length: %d",
-						__LINE__, mmtp_packet_header->mmtp_mpu_type_packet_header.data_unit_length, to_read_packet_length);
+/*
+ * Initializes the MMTP demuxer
+ *
+ * set some default values and init our mmtp sub flow vector for re-assembly
+ */
 
-			} else {
-				to_read_packet_length = mmtp_raw_packet_size - (buf-raw_buf);
-				__LOG_DEBUG(p_demux, "%d:skipping data_unit_size: mpu_aggregation_flag:0, raw packet size: %d, buf: %p, raw_buf: %p, to_read_packet_length: %d",
-						__LINE__, mmtp_raw_packet_size, buf, raw_buf, to_read_packet_length);
-			}
+static int Open( vlc_object_t * p_this )
+{
+    demux_t *p_demux = (demux_t*)p_this;
+    demux_sys_t *p_sys = NULL;
 
-			//if we are MPU metadata or movie fragment metadatas
-			if(mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_fragment_type != 0x2) {
-				//read our packet length just as a mpu metadata fragment or movie fragment metadata
-				//read our packet length without any mfu
-				block_t *tmp_mpu_fragment = block_Alloc(to_read_packet_length);
-				__LOG_DEBUG(p_demux, "%d::creating tmp_mpu_fragment, setting block_t->i_buffer to: %d", __LINE__, to_read_packet_length);
+    p_demux->pf_demux = Demux;
+    p_demux->pf_control = Control;
 
-				buf = extract(buf, tmp_mpu_fragment->p_buffer, to_read_packet_length);
-				tmp_mpu_fragment->i_buffer = to_read_packet_length;
+    p_sys = calloc( 1, sizeof( demux_sys_t ) );
 
-				mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_data_unit_payload = block_Duplicate(tmp_mpu_fragment);
 
-				processMpuPacket(p_demux, mmtp_sub_flow, mmtp_packet_header);
+    if ( !p_sys )
+          return VLC_EGENERIC;
 
-				remainingPacketLen = mmtp_raw_packet_size - (buf - raw_buf);
-				//this should only be non-zero if mpu_aggregration_flag=1
-				//__LOG_INFO(p_demux, "%d::mpu_fragment_type: %hu, remainingPacketLen: %d", __LINE__, mpu_fragment_type, remainingPacketLen);
+    p_demux->p_sys = p_sys;
 
-			} else {
-				//mfu's have time and un-timed additional DU headers, so recalc to_read_packet_len after doing extract
-				//we use the du_header field
-				//parse data unit header here based upon mpu timed flag
-
-				/**
-				* MFU mpu_fragmentation_indicator==1's are prefixed by the following box, need to remove
-				*
-				aligned(8) class MMTHSample {
-				   unsigned int(32) sequence_number;
-				   if (is_timed) {
-
-					//interior block is 152 bits, or 19 bytes
-					  signed int(8) trackrefindex;
-					  unsigned int(32) movie_fragment_sequence_number
-					  unsigned int(32) samplenumber;
-					  unsigned int(8)  priority;
-					  unsigned int(8)  dependency_counter;
-					  unsigned int(32) offset;
-					  unsigned int(32) length;
-					//end interior block
-
-					  multiLayerInfo();
-				} else {
-						//additional 2 bytes to chomp for non timed delivery
-					  unsigned int(16) item_ID;
-				   }
-				}
+    p_sys->obj = p_this;
+    p_sys->context.i_lastseqnumber = UINT32_MAX;
+    p_sys->p_mpu_block = NULL;
 
-				aligned(8) class multiLayerInfo extends Box("muli") {
-				   bit(1) multilayer_flag;
-				   bit(7) reserved0;
-				   if (multilayer_flag==1) {
-					   //32 bits
-					  bit(3) dependency_id;
-					  bit(1) depth_flag;
-					  bit(4) reserved1;
-					  bit(3) temporal_id;
-					  bit(1) reserved2;
-					  bit(4) quality_id;
-					  bit(6) priority_id;
-				   }  bit(10) view_id;
-				   else{
-					   //16bits
-					  bit(6) layer_id;
-					  bit(3) temporal_id;
-					  bit(7) reserved3;
-				} }
-				*/
-
-				uint8_t mmthsample_len;
-				uint8_t mmthsample_sequence_number[4];
-
-				if(mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_timed_flag) {
-
-				//	uint16_t seconds;
-				//	uint16_t microseconds;
-					compute_ntp32_to_seconds_microseconds(mmtp_packet_header->mpu_data_unit_payload_fragments_timed.mmtp_timestamp, &mmtp_packet_header->mpu_data_unit_payload_fragments_timed.mmtp_timestamp_s, &mmtp_packet_header->mpu_data_unit_payload_fragments_timed.mmtp_timestamp_us);
-					__LOG_INFO(p_demux, "%d: converting mmtp_timestamp: %u to seconds: %hu, microseconds: %hu", __LINE__, mmtp_packet_header->mpu_data_unit_payload_fragments_timed.mmtp_timestamp, mmtp_packet_header->mpu_data_unit_payload_fragments_timed.mmtp_timestamp_s, mmtp_packet_header->mpu_data_unit_payload_fragments_timed.mmtp_timestamp_us);
-					//on first init, p_sys->first_pts will always be 0 from calloc
-					uint64_t pts = compute_relative_ntp32_pts(p_sys->first_pts, mmtp_packet_header->mpu_data_unit_payload_fragments_timed.mmtp_timestamp_s, mmtp_packet_header->mpu_data_unit_payload_fragments_timed.mmtp_timestamp_us);
-					if(!p_sys->has_set_first_pts) {
-						p_sys->first_pts = pts;
-						p_sys->has_set_first_pts = 1;
-					}
-
-					//build our PTS
-					mmtp_packet_header->mpu_data_unit_payload_fragments_timed.pts = pts;
-
-					//112 bits in aggregate, 14 bytes
-					uint8_t timed_mfu_block[14];
-					buf = extract(buf, timed_mfu_block, 14);
-
-					mmtp_packet_header->mpu_data_unit_payload_fragments_timed.movie_fragment_sequence_number 	= (timed_mfu_block[0] << 24) | (timed_mfu_block[1] << 16) | (timed_mfu_block[2]  << 8) | (timed_mfu_block[3]);
-					mmtp_packet_header->mpu_data_unit_payload_fragments_timed.sample_number				 	  	= (timed_mfu_block[4] << 24) | (timed_mfu_block[5] << 16) | (timed_mfu_block[6]  << 8) | (timed_mfu_block[7]);
-					mmtp_packet_header->mpu_data_unit_payload_fragments_timed.offset     					  	= (timed_mfu_block[8] << 24) | (timed_mfu_block[9] << 16) | (timed_mfu_block[10] << 8) | (timed_mfu_block[11]);
-					mmtp_packet_header->mpu_data_unit_payload_fragments_timed.priority 							= timed_mfu_block[12];
-					mmtp_packet_header->mpu_data_unit_payload_fragments_timed.dep_counter						= timed_mfu_block[13];
-
-					//parse out mmthsample block if this is our first fragment or we are a complete fragment,
-					if(mmtp_packet_header->mpu_data_unit_payload_fragments_timed.mpu_fragmentation_indicator == 0 || mmtp_packet_header->mpu_data_unit_payload_fragments_timed.mpu_fragmentation_indicator == 1) {
-
-						//MMTHSample does not subclass box...
-						//buf = extract(buf, &mmthsample_len, 1);
-						buf = extract(buf, mmthsample_sequence_number, 4);
-
-						uint8_t mmthsample_timed_block[19];
-						buf = extract(buf, mmthsample_timed_block, 19);
-
-						//read multilayerinfo
-						uint8_t multilayerinfo_box_length[4];
-						uint8_t multilayerinfo_box_name[4];
-						uint8_t multilayer_flag;
-
-						buf = extract(buf, multilayerinfo_box_length, 4);
-						buf = extract(buf, multilayerinfo_box_name, 4);
-
-						buf = extract(buf, &multilayer_flag, 1);
-
-						int is_multilayer = (multilayer_flag >> 7) & 0x01;
-						//if MSB is 1, then read multilevel struct, otherwise just pull layer info...
-						if(is_multilayer) {
-							uint8_t multilayer_data_block[4];
-							buf = extract(buf, multilayer_data_block, 4);
-
-						} else {
-							uint8_t multilayer_layer_id_temporal_id[2];
-							buf = extract(buf, multilayer_layer_id_temporal_id, 2);
-						}
-
-						__LOG_INFO(p_demux, "%d:mpu mode (0x02), timed MFU, mpu_fragmentation_indicator: %d, movie_fragment_seq_num: %u, sample_num: %u, offset: %u, pri: %d, dep_counter: %d, multilayer: %d, mpu_sequence_number: %u",
-							__LINE__,
-							mmtp_packet_header->mpu_data_unit_payload_fragments_timed.mpu_fragmentation_indicator,
-							mmtp_packet_header->mpu_data_unit_payload_fragments_timed.movie_fragment_sequence_number,
-							mmtp_packet_header->mpu_data_unit_payload_fragments_timed.sample_number,
-							mmtp_packet_header->mpu_data_unit_payload_fragments_timed.offset,
-							mmtp_packet_header->mpu_data_unit_payload_fragments_timed.priority,
-							mmtp_packet_header->mpu_data_unit_payload_fragments_timed.dep_counter,
-							is_multilayer,
-							mmtp_packet_header->mpu_data_unit_payload_fragments_timed.mpu_sequence_number);
-					} else {
-						__LOG_INFO(p_demux, "%d:mpu mode (0x02), timed MFU, mpu_fragmentation_indicator: %d, movie_fragment_seq_num: %u, sample_num: %u, offset: %u, pri: %d, dep_counter: %d, mpu_sequence_number: %u",
-							__LINE__,
-							mmtp_packet_header->mpu_data_unit_payload_fragments_timed.mpu_fragmentation_indicator,
-							mmtp_packet_header->mpu_data_unit_payload_fragments_timed.movie_fragment_sequence_number,
-							mmtp_packet_header->mpu_data_unit_payload_fragments_timed.sample_number,
-							mmtp_packet_header->mpu_data_unit_payload_fragments_timed.offset,
-							mmtp_packet_header->mpu_data_unit_payload_fragments_timed.priority,
-							mmtp_packet_header->mpu_data_unit_payload_fragments_timed.dep_counter,
-							mmtp_packet_header->mpu_data_unit_payload_fragments_timed.mpu_sequence_number);
-					}
-					//end mfu box read
-
-					to_read_packet_length = mmtp_raw_packet_size - (buf - raw_buf);
-				} else {
-					uint8_t non_timed_mfu_block[4];
-					uint32_t non_timed_mfu_item_id;
-					//only 32 bits
-					buf = extract(buf, non_timed_mfu_block, 4);
-					mmtp_packet_header->mpu_data_unit_payload_fragments_nontimed.non_timed_mfu_item_id = (non_timed_mfu_block[0] << 24) | (non_timed_mfu_block[1] << 16) | (non_timed_mfu_block[2] << 8) | non_timed_mfu_block[3];
-
-					if(mmtp_packet_header->mpu_data_unit_payload_fragments_nontimed.mpu_fragmentation_indicator == 1) {
-						//MMTHSample does not subclass box...
-						//buf = extract(buf, &mmthsample_len, 1);
-
-						buf = extract(buf, mmthsample_sequence_number, 4);
-
-						uint8_t mmthsample_item_id[2];
-						buf = extract(buf, mmthsample_sequence_number, 2);
-						//end reading of mmthsample box
-					}
-
-					__LOG_DEBUG(p_demux, "mpu mode (0x02), non-timed MFU, item_id is: %zu", mmtp_packet_header->mpu_data_unit_payload_fragments_nontimed.non_timed_mfu_item_id);
-					to_read_packet_length = mmtp_raw_packet_size - (buf - raw_buf);
-				}
+//    p_sys->b_seekable = true;
+//    p_sys->b_fragmented = true;
 
-				__LOG_TRACE( p_demux, "%d:before reading fragment packet: reading length: %d (mmtp_raw_packet_size: %d, buf: %p, raw_buf:%p)",
-						__LINE__,
-						to_read_packet_length,
-						mmtp_raw_packet_size,
-						buf,
-						raw_buf);
+    //vlc_stream_fifo doesn't support seeking, which is required for libmp4 box parsing, so double buffer into s_frag
 
-				block_t *tmp_mpu_fragment = block_Alloc(to_read_packet_length);
-				//__LOG_INFO(p_demux, "%d::creating tmp_mpu_fragment, setting block_t->i_buffer to: %d", __LINE__, to_read_packet_length);
+    p_sys->last_mpu_sequence_number = -1;
+    p_sys->last_mpu_fragment_type = -1;
+    p_sys->has_processed_ftype_moov = 0;
 
-				buf = extract(buf, tmp_mpu_fragment->p_buffer, to_read_packet_length);
-				tmp_mpu_fragment->i_buffer = to_read_packet_length;
-				tmp_mpu_fragment->i_pts = mmtp_packet_header->mpu_data_unit_payload_fragments_timed.pts;
-				tmp_mpu_fragment->i_length = 16683;
+    mmtp_sub_flow_vector_init(&p_sys->mmtp_sub_flow_vector);
+    mmtp_block_view_pools_init(p_sys);
+    p_sys->b_low_latency = var_InheritBool(p_demux, "mmtp-low-latency");
+    p_sys->i_reorder_packets = var_InheritInteger(p_demux, "mmtp-reorder-packets");
+    p_sys->i_reorder_hold = VLC_TICK_FROM_MS(var_InheritInteger(p_demux, "mmtp-reorder-ms"));
+    p_sys->i_max_buffered_bytes = var_InheritInteger(p_demux, "mmtp-max-buffered-bytes");
+    p_sys->b_hrbm = var_InheritBool(p_demux, "mmtp-hrbm");
+    p_sys->b_emit_corrupt_samples = var_InheritBool(p_demux, "mmtp-emit-corrupt-samples");
+    p_sys->b_ip_input = var_InheritBool(p_demux, "mmtp-ip-input");
+    lls_table_manager_init(&p_sys->lls_table_manager);
+    lls_table_manager_subscribe(&p_sys->lls_table_manager, SLT, processLlsSlt, p_demux);
+    p_sys->i_pcr_delay = VLC_TICK_FROM_MS(var_InheritInteger(p_demux, "mmtp-pcr-delay"));
+    mmtp_pcr_clock_init(&p_sys->pcr_clock);
+    p_sys->b_al_fec = var_InheritBool(p_demux, "mmtp-al-fec");
+    //recovered packets are only of use while the reorder window still waits for them
+    mmtp_al_fec_decoder_init(&p_sys->al_fec, p_sys->i_reorder_hold);
+    mmtp_fragment_store_configure(&p_sys->mmtp_sub_flow_vector, p_sys->i_max_buffered_bytes, block_Release);
+
+    mmtp_trace_open(p_demux);
+    p_sys->i_stats_interval = VLC_TICK_FROM_SEC(var_InheritInteger(p_demux, "mmtp-stats-interval"));
 
-				mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_data_unit_payload = block_Duplicate(tmp_mpu_fragment);
+    var_Create(VLC_OBJECT(p_this)->obj.libvlc, "key-pressed", VLC_VAR_INTEGER);
+    var_AddCallback(p_this->obj.libvlc, "key-pressed", vlc_key_to_action, (void*)p_this);
 
-				//send off only the CLEAN mdat payload from our MFU
-				processMpuPacket(p_demux, mmtp_sub_flow, mmtp_packet_header);
+    atomic_init(&p_sys->i_recv_drops, 0);
 
-				remainingPacketLen = mmtp_raw_packet_size - (buf - raw_buf);
-				__LOG_TRACE( p_demux, "%d:after reading fragment packet: remainingPacketLen: %d",
-										__LINE__,
-										remainingPacketLen);
+    //a single stream is known by its location, ip input services by their destination once the SLT names them
+    mpu_metadata_cache_init(&p_sys->mpu_metadata_cache, MPU_METADATA_CACHE_DEFAULT_MAX_ENTRIES);
+    if(var_InheritBool(p_demux, "mmtp-mpu-metadata-cache")) {
+        mmtp_mpu_metadata_cache_open(p_demux);
+        if(!p_sys->b_ip_input && p_demux->psz_location) {
+            p_sys->psz_cache_scope = strdup(p_demux->psz_location);
+            restoreMpuMetadataFromCache(p_demux, NULL, &p_sys->mmtp_sub_flow_vector);
+        }
+    }
 
-			}
+    p_sys->b_objects = var_InheritBool(p_demux, "mmtp-objects");
+    mmtp_objects_open(p_demux);
 
-		} while(mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_aggregation_flag && remainingPacketLen>0);
-	}
+    //last, the receive thread reads p_sys as soon as it starts
+    if(vlc_stream_Control(p_demux->s, STREAM_CAN_CONTROL_PACE, &p_sys->b_can_control_pace))
+        p_sys->b_can_control_pace = false;
+    if(!p_sys->b_can_control_pace)
+        mmtp_receive_thread_start(p_demux, var_InheritInteger(p_demux, "mmtp-receive-ring"));
 
-	__LOG_TRACE(p_demux, "%d:demux - return", __LINE__);
 
-done:
-	return VLC_DEMUXER_SUCCESS;
+    __LOG_INFO(p_demux, "mmtp_demuxer.open() - complete, p_sys->mmtp_sub_flow_vector is: %p", p_sys->mmtp_sub_flow_vector);
+
+    return VLC_SUCCESS;
 }
 
 
-/** todo - add
- * DEMUX_SET_GROUP_DEFAULT ?
- *
- * DEMUX_FILTER_DISABLE
- *
+/**
+ * non-timed items and generic objects: the object cache streams each one in as its fragments arrive,
+ * it is chained here and kept as an attachment once complete
  */
-static int Control( demux_t *p_demux, int i_query, va_list args )
-{
-   // __LOG_INFO(p_demux, "control: query is: %d", i_query);
-	demux_sys_t *p_sys = p_demux->p_sys;
+static mmtp_object_buffer_t* mmtp_object_buffer_find(demux_sys_t *p_sys, const mmtp_object_key_t *key) {
+	for(int i=0; i < MMTP_OBJECT_CACHE_MAX_IN_FLIGHT; i++) {
+		mmtp_object_buffer_t *mmtp_object_buffer = &p_sys->object_buffers[i];
+		if(mmtp_object_buffer->b_in_use && !memcmp(&mmtp_object_buffer->key, key, sizeof(mmtp_object_key_t))) {
+			return mmtp_object_buffer;
+		}
+	}
+	return NULL;
+}
 
-    bool *pb;
+static void mmtp_object_begin(void *context, const mmtp_object_key_t *key) {
+	demux_sys_t *p_sys = ((demux_t*)context)->p_sys;
+
+	//the object cache never has more than MMTP_OBJECT_CACHE_MAX_IN_FLIGHT objects open
+	for(int i=0; i < MMTP_OBJECT_CACHE_MAX_IN_FLIGHT; i++) {
+		mmtp_object_buffer_t *mmtp_object_buffer = &p_sys->object_buffers[i];
+		if(!mmtp_object_buffer->b_in_use) {
+			memset(mmtp_object_buffer, 0, sizeof(mmtp_object_buffer_t));
+			mmtp_object_buffer->b_in_use = true;
+			mmtp_object_buffer->key = *key;
+			mmtp_object_buffer->pp_chain_last = &mmtp_object_buffer->p_chain;
+			return;
+		}
+	}
+}
+
+static void mmtp_object_data(void *context, const mmtp_object_key_t *key, uint64_t offset, const uint8_t *data, size_t length) {
+	VLC_UNUSED(offset);
+	demux_sys_t *p_sys = ((demux_t*)context)->p_sys;
+	mmtp_object_buffer_t *mmtp_object_buffer = mmtp_object_buffer_find(p_sys, key);
+
+	if(!mmtp_object_buffer || mmtp_object_buffer->b_overflow)
+		return;
+
+	block_t *p_block = NULL;
+	if(mmtp_object_buffer->i_size + length <= MMTP_OBJECT_MAX_SIZE) {
+		p_block = block_Alloc(length);
+	}
+	if(!p_block) {
+		mmtp_object_buffer->b_overflow = true;
+		return;
+	}
+	//data is a view into the datagram
+	memcpy(p_block->p_buffer, data, length);
+	block_ChainLastAppend(&mmtp_object_buffer->pp_chain_last, p_block);
+	mmtp_object_buffer->i_size += length;
+}
+
+static void mmtp_object_attachment_add(demux_t *p_demux, input_attachment_t *p_attachment) {
+	demux_sys_t *p_sys = p_demux->p_sys;
+
+	//a newer version of the same object replaces it, a repetition of the same bytes changes nothing
+	for(int i=0; i < p_sys->i_object_attachments; i++) {
+		input_attachment_t *p_held = p_sys->pp_object_attachments[i];
+		if(!strcmp(p_held->psz_name, p_attachment->psz_name)) {
+			if(p_held->i_data == p_attachment->i_data &&
+					(!p_held->i_data || !memcmp(p_held->p_data, p_attachment->p_data, p_held->i_data))) {
+				vlc_input_attachment_Delete(p_attachment);
+				return;
+			}
+			vlc_input_attachment_Delete(p_sys->pp_object_attachments[i]);
+			TAB_ERASE(p_sys->i_object_attachments, p_sys->pp_object_attachments, i);
+			break;
+		}
+	}
+	if(p_sys->i_object_attachments >= MMTP_OBJECT_ATTACHMENTS_MAX) {
+		vlc_input_attachment_Delete(p_sys->pp_object_attachments[0]);
+		TAB_ERASE(p_sys->i_object_attachments, p_sys->pp_object_attachments, 0);
+	}
+	TAB_APPEND(p_sys->i_object_attachments, p_sys->pp_object_attachments, p_attachment);
+	p_sys->i_updates |= INPUT_UPDATE_META;
+}
+
+static void mmtp_object_end(void *context, const mmtp_object_key_t *key, uint64_t length, bool complete) {
+	demux_t *p_demux = context;
+	demux_sys_t *p_sys = p_demux->p_sys;
+	mmtp_object_buffer_t *mmtp_object_buffer = mmtp_object_buffer_find(p_sys, key);
+
+	if(!mmtp_object_buffer)
+		return;
+
+	if(complete && mmtp_object_buffer->b_overflow) {
+		msg_Warn(p_demux, "%d:mmtp_demuxer - packet_id: %hu, item_id: %u, object of %"PRIu64" bytes too large, dropping",
+				__LINE__, key->packet_id, key->item_id, length);
+	} else if(complete) {
+		block_t *p_object = block_ChainGather(mmtp_object_buffer->p_chain);
+		mmtp_object_buffer->p_chain = NULL;
+
+		char *psz_name;
+		if(asprintf(&psz_name, "mmtp-%hu-%hu-%u-%u", key->service_id, key->packet_id, key->mpu_sequence_number, key->item_id) != -1) {
+			input_attachment_t *p_attachment = vlc_input_attachment_New(psz_name, "application/octet-stream",
+					key->item_id ? "MMTP non-timed item" : "MMTP generic object",
+					p_object ? p_object->p_buffer : NULL, p_object ? p_object->i_buffer : 0);
+			if(p_attachment) {
+				mmtp_object_attachment_add(p_demux, p_attachment);
+				__LOG_DEBUG(p_demux, "%d:mmtp_demuxer - object %s complete, %"PRIu64" bytes", __LINE__, psz_name, length);
+			}
+			free(psz_name);
+		}
+		if(p_object) {
+			block_Release(p_object);
+		}
+	}
+
+	block_ChainRelease(mmtp_object_buffer->p_chain);
+	memset(mmtp_object_buffer, 0, sizeof(mmtp_object_buffer_t));
+}
+
+static void mmtp_objects_open(demux_t *p_demux) {
+	demux_sys_t *p_sys = p_demux->p_sys;
+	mmtp_object_sink_t mmtp_object_sink = { p_demux, mmtp_object_begin, mmtp_object_data, mmtp_object_end };
+
+	mmtp_object_cache_init(&p_sys->object_cache, &mmtp_object_sink);
+}
+
+static void mmtp_objects_close(demux_t *p_demux) {
+	demux_sys_t *p_sys = p_demux->p_sys;
+
+	//objects still open are ended as incomplete, which releases their chains
+	mmtp_object_cache_free(&p_sys->object_cache);
+	if(p_sys->object_cache.stats.objects_completed || p_sys->object_cache.stats.objects_incomplete) {
+		mmtp_object_cache_stats_dump(&p_sys->object_cache);
+	}
+	for(int i=0; i < p_sys->i_object_attachments; i++) {
+		vlc_input_attachment_Delete(p_sys->pp_object_attachments[i]);
+	}
+	TAB_CLEAN(p_sys->i_object_attachments, p_sys->pp_object_attachments);
+}
+
+static void processMmtpObjectDataUnit(demux_t *p_demux, const mmtp_object_key_t *key, mmtp_payload_fragments_union_t *mmtp_packet_header,
+		const uint8_t *data_unit_payload, size_t data_unit_payload_length) {
+	demux_sys_t *p_sys = p_demux->p_sys;
+
+	if(!p_sys->b_objects)
+		return;
+
+	mmtp_object_cache_push(&p_sys->object_cache, key,
+			mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_fragmentation_indicator,
+			mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_fragmentation_counter,
+			data_unit_payload, data_unit_payload_length);
+}
+
+/**
+ * generic object mode (payload_type 0x01): the payload header is laid out like the mpu mode one, its 32 bit
+ * sequence number naming the object, and carries a single data unit
+ */
+static void processGenericObjectPayload(demux_t *p_demux, mmtp_service_t *mmtp_service, mmtp_payload_fragments_union_t *mmtp_packet_header, atsc3_cursor_t *cursor) {
+	if(mmtp_mpu_packet_header_parse_from_cursor(mmtp_packet_header, cursor)) {
+		return;
+	}
+	if(mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_aggregation_flag) {
+		__LOG_DEBUG(p_demux, "%d:mmtp_demuxer - packet_id: %hu, aggregated generic objects are not supported, dropping",
+				__LINE__, mmtp_packet_header->mmtp_packet_header.mmtp_packet_id);
+		return;
+	}
+
+	mmtp_object_key_t key = {
+		.service_id = mmtp_service ? mmtp_service->service_id : 0,
+		.packet_id = mmtp_packet_header->mmtp_packet_header.mmtp_packet_id,
+		.mpu_sequence_number = mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_sequence_number,
+	};
+	size_t i_data_unit = atsc3_cursor_remaining(cursor);
+	processMmtpObjectDataUnit(p_demux, &key, mmtp_packet_header, atsc3_cursor_take(cursor, i_data_unit), i_data_unit);
+}
+
+/**
+ * parse and dispatch the data units of an mpu mode packet, in packet_sequence_number order
+ */
+static void processMpuDataUnits(demux_t* p_demux, mmtp_sub_flow_t* mmtp_sub_flow, mmtp_payload_fragments_union_t* mmtp_packet_header,
+		mmtp_raw_packet_ref_t* mmtp_raw_packet_ref, atsc3_cursor_t* cursor) {
+	demux_sys_t *p_sys = p_demux->p_sys;
+	mmtp_sub_flow_vector_t *mmtp_sub_flow_vector = mmtp_sub_flow->mmtp_sub_flow_vector;
+
+	//header fields are copied out, only the data unit views keep the datagram alive past here
+	mmtp_packet_header->mmtp_packet_header.raw_packet = NULL;
+	mmtp_packet_header->mmtp_packet_header.mmtp_header_extension_value = NULL;
+
+	//each aggregated data unit is stored as its own packet, seeded from the mpu header we just parsed
+	mmtp_payload_fragments_union_t mpu_packet_template = *mmtp_packet_header;
+	bool has_more_data_units;
+
+	do {
+		uint8_t *data_unit_payload = NULL;
+		uint32_t data_unit_payload_length = 0;
+
+		if(!mmtp_packet_header) {
+			mmtp_packet_header = mmtp_fragment_store_packet_alloc(mmtp_sub_flow_vector);
+			if(!mmtp_packet_header) {
+				break;
+			}
+			*mmtp_packet_header = mpu_packet_template;
+		}
+
+		if(mmtp_mpu_data_unit_parse_from_cursor(mmtp_packet_header, cursor, &data_unit_payload, &data_unit_payload_length)) {
+			msg_Warn(p_demux, "%d:mmtp_demuxer - truncated data unit, packet_id: %hu, dropping remainder of packet", __LINE__, mmtp_packet_header->mmtp_packet_header.mmtp_packet_id);
+			break;
+		}
+
+		has_more_data_units = mpu_packet_template.mmtp_mpu_type_packet_header.mpu_aggregation_flag && atsc3_cursor_remaining(cursor) > 0;
+
+		//non-timed items are streamed to the object cache, they never take up room in the fragment store
+		if(mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_fragment_type == 0x2 && !mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_timed_flag) {
+			mmtp_service_t *mmtp_service = mmtp_sub_flow->mpu_fragments->mpu_isobmff_fragment_parameters.mmtp_service;
+			mmtp_object_key_t key = {
+				.service_id = mmtp_service ? mmtp_service->service_id : 0,
+				.packet_id = mmtp_packet_header->mmtp_packet_header.mmtp_packet_id,
+				.mpu_sequence_number = mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_sequence_number,
+				.item_id = mmtp_packet_header->mpu_data_unit_payload_fragments_nontimed.non_timed_mfu_item_id,
+			};
+			processMmtpObjectDataUnit(p_demux, &key, mmtp_packet_header, data_unit_payload, data_unit_payload_length);
+			*mmtp_packet_header = mpu_packet_template;
+			continue;
+		}
+
+		block_t *tmp_mpu_fragment = mmtp_block_view_new(&p_sys->mmtp_block_view_pool, mmtp_raw_packet_ref, data_unit_payload, data_unit_payload_length);
+		if(!tmp_mpu_fragment) {
+			break;
+		}
+
+		//mfu's carry presentation time, mpu metadata and movie fragment metadata are passed thru as-is
+		if(mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_fragment_type == 0x2 && mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_timed_flag) {
+			//same timeline the pcr is recovered on, unwrapped across the 65536 s ntp short-format rollover
+			mmtp_pcr_clock_t *pcr_clock = mmtp_pcr_clock_get(p_sys, mmtp_sub_flow->mpu_fragments->mpu_isobmff_fragment_parameters.mmtp_service);
+			uint64_t pts = mmtp_clock_recovery_ntp32_to_timeline_us(&pcr_clock->mmtp_clock_recovery, mmtp_packet_header->mpu_data_unit_payload_fragments_timed.mmtp_timestamp);
+			if(!p_sys->has_set_first_pts) {
+				p_sys->first_pts = pts;
+				p_sys->has_set_first_pts = 1;
+			}
+
+			//build our PTS
+			mmtp_packet_header->mpu_data_unit_payload_fragments_timed.pts = pts;
+			mmtp_flow_stats_push_mfu(&mmtp_sub_flow->flow_stats, mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_sequence_number,
+					mmtp_raw_packet_ref->p_block->i_dts);
+
+			__LOG_DEBUG(p_demux, "%d:mpu mode (0x02), timed MFU, mpu_fragmentation_indicator: %d, movie_fragment_seq_num: %u, sample_num: %u, offset: %u, pri: %d, dep_counter: %d, mpu_sequence_number: %u",
+				__LINE__,
+				mmtp_packet_header->mpu_data_unit_payload_fragments_timed.mpu_fragmentation_indicator,
+				mmtp_packet_header->mpu_data_unit_payload_fragments_timed.movie_fragment_sequence_number,
+				mmtp_packet_header->mpu_data_unit_payload_fragments_timed.sample_number,
+				mmtp_packet_header->mpu_data_unit_payload_fragments_timed.offset,
+				mmtp_packet_header->mpu_data_unit_payload_fragments_timed.priority,
+				mmtp_packet_header->mpu_data_unit_payload_fragments_timed.dep_counter,
+				mmtp_packet_header->mpu_data_unit_payload_fragments_timed.mpu_sequence_number);
+
+			tmp_mpu_fragment->i_pts = mmtp_packet_header->mpu_data_unit_payload_fragments_timed.pts;
+		}
+
+		mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_data_unit_payload = tmp_mpu_fragment;
+		mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_data_unit_payload_length = data_unit_payload_length;
+
+		//the fragment store owns this packet and its payload from here on, it may be recycled on a later assign
+		mpu_fragments_assign_to_payload_vector(mmtp_sub_flow, mmtp_packet_header);
+
+		//send off only the CLEAN mdat payload from our MFU
+		processMpuPacket(p_demux, mmtp_sub_flow, mmtp_packet_header);
+		mmtp_packet_header = NULL;
+
+		__LOG_TRACE( p_demux, "%d:after reading fragment packet: remaining: %zu", __LINE__, atsc3_cursor_remaining(cursor));
+	} while(has_more_data_units);
+
+	//packets not handed to the fragment store are still ours
+	if(mmtp_packet_header) {
+		mmtp_fragment_store_packet_free(mmtp_sub_flow_vector, mmtp_packet_header);
+	}
+}
+
+static void processMmtpReorderPacket(void* context, void* item) {
+	demux_t *p_demux = context;
+	demux_sys_t *p_sys = p_demux->p_sys;
+	mmtp_reorder_packet_t *mmtp_reorder_packet = item;
+	mmtp_payload_fragments_union_t *mmtp_packet_header = mmtp_reorder_packet->mmtp_packet_header;
+	vlc_tick_t i_arrival = mmtp_reorder_packet->mmtp_raw_packet_ref->p_block->i_dts;
+
+	_ATSC3_TRACE_EVENT(&p_sys->trace_ring, i_arrival, ATSC3_TRACE_EVENT_PACKET_RELEASED,
+			mmtp_packet_header->mmtp_packet_header.mmtp_packet_id, mmtp_packet_header->mmtp_packet_header.packet_sequence_number,
+			mmtp_reorder_packet->mmtp_sub_flow->mpu_fragments->mpu_isobmff_fragment_parameters.mmtp_reorder_window.stats.packets_lost, 0);
+	_ATSC3_TRACE_EVENT(&p_sys->trace_ring, i_arrival, ATSC3_TRACE_EVENT_MPU_FRAGMENT,
+			mmtp_packet_header->mmtp_packet_header.mmtp_packet_id, mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_sequence_number,
+			(uint32_t)mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_fragment_type << 16 |
+			mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_fragmentation_indicator << 8 |
+			mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_fragmentation_counter,
+			mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_payload_length);
+
+	processMpuDataUnits(p_demux, mmtp_reorder_packet->mmtp_sub_flow, mmtp_reorder_packet->mmtp_packet_header,
+			mmtp_reorder_packet->mmtp_raw_packet_ref, &mmtp_reorder_packet->cursor);
+
+	mmtp_raw_packet_ref_release(mmtp_reorder_packet->mmtp_raw_packet_ref);
+	atsc3_slab_pool_free(&p_sys->mmtp_reorder_packet_pool, mmtp_reorder_packet);
+}
+
+//drop whatever is still held on close, nothing downstream wants it
+static void discardMmtpReorderPacket(void* context, void* item) {
+	demux_t *p_demux = context;
+	demux_sys_t *p_sys = p_demux->p_sys;
+	mmtp_reorder_packet_t *mmtp_reorder_packet = item;
+
+	mmtp_fragment_store_packet_free(mmtp_reorder_packet->mmtp_sub_flow->mmtp_sub_flow_vector, mmtp_reorder_packet->mmtp_packet_header);
+	mmtp_raw_packet_ref_release(mmtp_reorder_packet->mmtp_raw_packet_ref);
+	atsc3_slab_pool_free(&p_sys->mmtp_reorder_packet_pool, mmtp_reorder_packet);
+}
+
+static mmtp_service_t* mmtp_service_find(demux_sys_t *p_sys, uint16_t service_id) {
+	for(int i=0; i < p_sys->i_services; i++) {
+		if(p_sys->pp_services[i]->service_id == service_id) {
+			return p_sys->pp_services[i];
+		}
+	}
+	return NULL;
+}
+
+/**
+ * a newly signalled MMTP service gets its own sub_flows and es_out group, titled with the SLT shortServiceName
+ */
+static mmtp_service_t* mmtp_service_new(demux_t *p_demux, udp_flow_service_t *udp_flow_service) {
+	demux_sys_t *p_sys = p_demux->p_sys;
+
+	mmtp_service_t *mmtp_service = calloc(1, sizeof(mmtp_service_t));
+	if(!mmtp_service) {
+		return NULL;
+	}
+	mmtp_service->service_id = udp_flow_service->service_id;
+	mmtp_service->i_group = udp_flow_service->service_id;
+	mmtp_pcr_clock_init(&mmtp_service->pcr_clock);
+	mmtp_al_fec_decoder_init(&mmtp_service->al_fec, p_sys->i_reorder_hold);
+	mmtp_sub_flow_vector_init(&mmtp_service->mmtp_sub_flow_vector);
+	mmtp_fragment_store_configure(&mmtp_service->mmtp_sub_flow_vector, p_sys->i_max_buffered_bytes, block_Release);
+
+	if(asprintf(&mmtp_service->psz_cache_scope, "%u.%u.%u.%u:%hu", (udp_flow_service->dst_ip_addr >> 24) & 0xFF, (udp_flow_service->dst_ip_addr >> 16) & 0xFF,
+			(udp_flow_service->dst_ip_addr >> 8) & 0xFF, udp_flow_service->dst_ip_addr & 0xFF, udp_flow_service->dst_port) == -1) {
+		mmtp_service->psz_cache_scope = NULL;
+	}
+
+	TAB_APPEND(p_sys->i_services, p_sys->pp_services, mmtp_service);
+
+	vlc_meta_t *p_meta = vlc_meta_New();
+	if(p_meta) {
+		if(udp_flow_service->short_service_name) {
+			vlc_meta_SetTitle(p_meta, udp_flow_service->short_service_name);
+		}
+		es_out_Control(p_demux->out, ES_OUT_SET_GROUP_META, mmtp_service->i_group, p_meta);
+		vlc_meta_Delete(p_meta);
+	}
+
+	msg_Info(p_demux, "mmtp_demuxer - adding service_id: %hu (%s) as program %d", mmtp_service->service_id,
+			udp_flow_service->short_service_name ? udp_flow_service->short_service_name : "", mmtp_service->i_group);
+
+	restoreMpuMetadataFromCache(p_demux, mmtp_service, &mmtp_service->mmtp_sub_flow_vector);
+
+	return mmtp_service;
+}
+
+/**
+ * LLS on 224.0.23.60:4937, every MMTP service in a new or changed SLT becomes a program
+ */
+//lls_table_manager subscriber, only called with an SLT that is new or changed its version
+static void processLlsSlt(void *context, lls_table_ref_t *lls_table_ref) {
+	demux_t *p_demux = (demux_t*)context;
+	demux_sys_t *p_sys = p_demux->p_sys;
+
+	if(udp_flow_service_map_update_from_slt(&p_sys->udp_flow_service_map, &lls_table_ref->lls_table->slt_table) > 0) {
+		for(size_t i=0; i < p_sys->udp_flow_service_map.services_n; i++) {
+			udp_flow_service_t *udp_flow_service = &p_sys->udp_flow_service_map.services[i];
+			if(udp_flow_service->sls_protocol == UDP_FLOW_SLS_PROTOCOL_MMTP && !mmtp_service_find(p_sys, udp_flow_service->service_id)) {
+				mmtp_service_new(p_demux, udp_flow_service);
+			}
+		}
+	}
+}
+
+static void processLlsTable(demux_t *p_demux, uint8_t *p_lls, size_t i_lls) {
+	demux_sys_t *p_sys = p_demux->p_sys;
+
+	if(i_lls > INT_MAX || lls_table_manager_push(&p_sys->lls_table_manager, p_lls, i_lls) < 0) {
+		__LOG_DEBUG(p_demux, "%d:processLlsTable: unable to parse LLS table, size: %zu", __LINE__, i_lls);
+	}
+}
+
+static mmtp_signaling_t* mmtp_signaling_get(demux_sys_t *p_sys, mmtp_service_t *mmtp_service) {
+	return mmtp_service ? &mmtp_service->signaling : &p_sys->signaling;
+}
+
+static mmtp_al_fec_decoder_t* mmtp_al_fec_get(demux_sys_t *p_sys, mmtp_service_t *mmtp_service) {
+	return mmtp_service ? &mmtp_service->al_fec : &p_sys->al_fec;
+}
+
+//mmtp-reorder-ms, or what the service's HRBM allows for
+static vlc_tick_t mmtp_reorder_hold_get(demux_sys_t *p_sys, mmtp_service_t *mmtp_service) {
+	mmtp_signaling_t *mmtp_signaling = mmtp_signaling_get(p_sys, mmtp_service);
+	return mmtp_signaling->i_hrbm_reorder_hold ? mmtp_signaling->i_hrbm_reorder_hold : p_sys->i_reorder_hold;
+}
+
+typedef struct mmtp_signaling_context {
+	demux_t*				p_demux;
+	mmtp_service_t*			mmtp_service;
+	mmtp_sub_flow_vector_t*	mmtp_sub_flow_vector;
+} mmtp_signaling_context_t;
+
+/**
+ * add the asset's ES as soon as the MPT names its codec, so the program and decoder are up before the
+ * first mpu metadata. TrackCreateES takes it over with the full format from the moov
+ */
+static void mmtp_signaled_es_create(demux_t *p_demux, mpu_isobmff_fragment_parameters_t *isobmff_parameters) {
+	if(isobmff_parameters->p_signaled_es || isobmff_parameters->i_tracks) {
+		return;
+	}
+
+	es_format_t fmt;
+	switch(isobmff_parameters->i_asset_type) {
+		case VLC_FOURCC('h','e','v','1'):
+		case VLC_FOURCC('h','v','c','1'):
+			es_format_Init(&fmt, VIDEO_ES, VLC_CODEC_HEVC);
+			break;
+		case VLC_FOURCC('a','v','c','1'):
+		case VLC_FOURCC('a','v','c','3'):
+			es_format_Init(&fmt, VIDEO_ES, VLC_CODEC_H264);
+			break;
+		case VLC_FOURCC('m','p','4','a'):
+			es_format_Init(&fmt, AUDIO_ES, VLC_CODEC_MP4A);
+			break;
+		case VLC_FOURCC('a','c','-','3'):
+			es_format_Init(&fmt, AUDIO_ES, VLC_CODEC_A52);
+			break;
+		case VLC_FOURCC('e','c','-','3'):
+			es_format_Init(&fmt, AUDIO_ES, VLC_CODEC_EAC3);
+			break;
+		case VLC_FOURCC('s','t','p','p'):
+			es_format_Init(&fmt, SPU_ES, VLC_CODEC_TTML);
+			break;
+		default:
+			//everything else waits for its sample entry
+			return;
+	}
+
+	if(isobmff_parameters->mmtp_service) {
+		fmt.i_group = isobmff_parameters->mmtp_service->i_group;
+	}
+
+	isobmff_parameters->p_signaled_es = es_out_Add(p_demux->out, &fmt);
+	es_format_Clean(&fmt);
+
+	msg_Dbg(p_demux, "mmtp_demuxer - signaled es for asset_type: %4.4s: %p", (const char *)&isobmff_parameters->i_asset_type, isobmff_parameters->p_signaled_es);
+}
+
+/**
+ * map every asset of an MP table onto its packet_id's sub_flow: codec, timescale and the MPU presentation
+ * times from the MPU_timestamp_descriptor, on the same timeline as the packet timestamps
+ */
+static void processMpTable(mmtp_signaling_context_t *mmtp_signaling_context, mp_table_t *mp_table) {
+	demux_t *p_demux = mmtp_signaling_context->p_demux;
+	demux_sys_t *p_sys = p_demux->p_sys;
+	mmtp_pcr_clock_t *pcr_clock = mmtp_pcr_clock_get(p_sys, mmtp_signaling_context->mmtp_service);
+
+	for(int i=0; i < mp_table->number_of_assets; i++) {
+		mp_table_asset_t *mp_table_asset = &mp_table->mp_table_asset[i];
+
+		//assets delivered on another flow (ipv4/ipv6/ts/url) are not ours to demux
+		uint16_t packet_id;
+		if(!mp_table_asset_get_packet_id(mp_table_asset, &packet_id)) {
+			continue;
+		}
+
+		mmtp_sub_flow_t *mmtp_sub_flow = mmtp_sub_flow_vector_get_or_set_packet_id(mmtp_signaling_context->mmtp_sub_flow_vector, packet_id);
+		if(!mmtp_sub_flow) {
+			continue;
+		}
+
+		mpu_isobmff_fragment_parameters_t *isobmff_parameters = &mmtp_sub_flow->mpu_fragments->mpu_isobmff_fragment_parameters;
+		isobmff_parameters->mmtp_service = mmtp_signaling_context->mmtp_service;
+
+		if(!isobmff_parameters->i_asset_type) {
+			msg_Info(p_demux, "mmtp_demuxer - MPT: packet_id: %hu, asset_type: %c%c%c%c, timescale: %u", packet_id,
+					(mp_table_asset->asset_type >> 24) & 0xFF, (mp_table_asset->asset_type >> 16) & 0xFF,
+					(mp_table_asset->asset_type >> 8) & 0xFF, mp_table_asset->asset_type & 0xFF, mp_table_asset->asset_timescale);
+		}
+		isobmff_parameters->i_asset_type = VLC_FOURCC((mp_table_asset->asset_type >> 24) & 0xFF, (mp_table_asset->asset_type >> 16) & 0xFF,
+				(mp_table_asset->asset_type >> 8) & 0xFF, mp_table_asset->asset_type & 0xFF);
+		if(mp_table_asset->asset_timescale_flag) {
+			isobmff_parameters->i_asset_timescale = mp_table_asset->asset_timescale;
+		}
+
+		//another asset on this packet_id, tracks from its cached mpu metadata would describe the old one
+		const char *psz_scope = mmtp_cache_scope_get(p_sys, mmtp_signaling_context->mmtp_service);
+		if(p_sys->psz_mpu_metadata_cache_path && psz_scope &&
+				mpu_metadata_cache_put_asset(&p_sys->mpu_metadata_cache, psz_scope, packet_id, mp_table_asset->asset_id, mp_table_asset->asset_id_length,
+						mp_table_asset->asset_type, mp_table_asset->asset_timescale_flag ? mp_table_asset->asset_timescale : 0) > 0 &&
+				isobmff_parameters->b_mpu_metadata_from_cache) {
+			msg_Info(p_demux, "mmtp_demuxer - packet_id: %hu, asset changed, dropping tracks set up from cached mpu metadata", packet_id);
+			releaseMpuMetadataTracks(p_demux, isobmff_parameters);
+		}
+
+		mmtp_signaled_es_create(p_demux, isobmff_parameters);
+
+		mmt_signaling_message_mpu_timestamp_descriptor_t *mpu_timestamp_descriptor = mp_table_asset->mpu_timestamp_descriptor;
+		for(int j=0; mpu_timestamp_descriptor && j < mpu_timestamp_descriptor->mpu_tuple_n; j++) {
+			int64_t mpu_presentation_time_us = mmtp_clock_recovery_ntp64_to_timeline_us(&pcr_clock->mmtp_clock_recovery, mpu_timestamp_descriptor->mpu_tuple[j].mpu_presentation_time);
+			if(mpu_presentation_time_us == MMTP_CLOCK_RECOVERY_INVALID) {
+				continue;
+			}
+
+			__LOG_DEBUG(p_demux, "%d:processMpTable - packet_id: %hu, mpu_sequence_number: %u, presentation time: %"PRId64,
+					__LINE__, packet_id, mpu_timestamp_descriptor->mpu_tuple[j].mpu_sequence_number, mpu_presentation_time_us);
+
+			mfu_sample_emitter_set_mpu_presentation_time(&isobmff_parameters->mfu_sample_emitter, mpu_timestamp_descriptor->mpu_tuple[j].mpu_sequence_number, mpu_presentation_time_us);
+		}
+	}
+}
+
+/**
+ * the HRBM holds packets for fixed_end_to_end_delay in at most max_buffer_size bytes, and packets later than
+ * max_transmission_delay are past the model: the service's buffered bytes, reorder hold and pcr delay follow
+ */
+static void applyHrbm(mmtp_signaling_context_t *mmtp_signaling_context, const hrbm_message_t *hrbm_message) {
+	demux_t *p_demux = mmtp_signaling_context->p_demux;
+	demux_sys_t *p_sys = p_demux->p_sys;
+	mmtp_service_t *mmtp_service = mmtp_signaling_context->mmtp_service;
+	mmtp_sub_flow_vector_t *mmtp_sub_flow_vector = mmtp_signaling_context->mmtp_sub_flow_vector;
+
+	if(hrbm_message->max_buffer_size) {
+		size_t i_max_bytes = __MIN(__MAX((size_t)hrbm_message->max_buffer_size * MMTP_HRBM_BUFFER_HEADROOM, (size_t)MMTP_HRBM_MIN_BUFFERED_BYTES), p_sys->i_max_buffered_bytes);
+		mmtp_fragment_store_configure(mmtp_sub_flow_vector, i_max_bytes, block_Release);
+	}
+
+	vlc_tick_t i_delay = __MIN(VLC_TICK_FROM_MS(hrbm_message->fixed_end_to_end_delay), MMTP_HRBM_MAX_DELAY);
+	mmtp_pcr_clock_get(p_sys, mmtp_service)->i_hrbm_delay = i_delay;
+
+	if(hrbm_message->max_transmission_delay) {
+		vlc_tick_t i_reorder_hold = __MAX(VLC_TICK_FROM_MS(hrbm_message->max_transmission_delay), MMTP_HRBM_MIN_REORDER_HOLD);
+		if(i_delay) {
+			i_reorder_hold = __MIN(i_reorder_hold, i_delay);
+		}
+		mmtp_signaling_get(p_sys, mmtp_service)->i_hrbm_reorder_hold = i_reorder_hold;
+
+		//windows already running, and the AL-FEC blocks feeding them
+		for(size_t i=0; i < mmtp_sub_flow_vector->size; i++) {
+			mmtp_sub_flow_t *mmtp_sub_flow = mmtp_sub_flow_vector->data[i];
+			if(mmtp_sub_flow->mpu_fragments) {
+				mmtp_sub_flow->mpu_fragments->mpu_isobmff_fragment_parameters.mmtp_reorder_window.max_hold_us = i_reorder_hold;
+			}
+		}
+		mmtp_al_fec_get(p_sys, mmtp_service)->max_hold_us = i_reorder_hold;
+	}
+
+	msg_Dbg(p_demux, "mmtp_demuxer - HRBM applied: buffered bytes: %zu, reorder hold: %"PRId64" ms, pcr delay: %"PRId64" ms",
+			mmtp_sub_flow_vector->fragment_store.max_bytes, MS_FROM_VLC_TICK(mmtp_reorder_hold_get(p_sys, mmtp_service)),
+			MS_FROM_VLC_TICK(i_delay ? i_delay : p_sys->i_pcr_delay));
+}
+
+static void processSignallingMessage(void *context, mmt_signaling_message_t *mmt_signaling_message) {
+	mmtp_signaling_context_t *mmtp_signaling_context = context;
+	demux_t *p_demux = mmtp_signaling_context->p_demux;
+
+	if(mmt_signaling_message->message_id == PA_message) {
+		pa_message_t *pa_message = mmt_signaling_message->payload;
+		for(int i=0; i < pa_message->mp_table_n; i++) {
+			processMpTable(mmtp_signaling_context, &pa_message->mp_table[i]);
+		}
+	} else if(mmt_signaling_message->message_id >= MPT_message_start && mmt_signaling_message->message_id <= MPT_message_end) {
+		processMpTable(mmtp_signaling_context, &((mpt_message_t*)mmt_signaling_message->payload)->mp_table);
+	} else if(mmt_signaling_message->message_id == HRBM_message) {
+		mmtp_signaling_t *mmtp_signaling = mmtp_signaling_get(p_demux->p_sys, mmtp_signaling_context->mmtp_service);
+		hrbm_message_t *hrbm_message = mmt_signaling_message->payload;
+
+		bool b_changed = !mmtp_signaling->has_hrbm || memcmp(&mmtp_signaling->hrbm_message, hrbm_message, sizeof(hrbm_message_t));
+		if(b_changed) {
+			msg_Dbg(p_demux, "mmtp_demuxer - HRBM: packet_id: %hu, max_buffer_size: %u, fixed_end_to_end_delay: %u ms, max_transmission_delay: %u ms",
+					mmt_signaling_message->packet_id, hrbm_message->max_buffer_size, hrbm_message->fixed_end_to_end_delay, hrbm_message->max_transmission_delay);
+		}
+		mmtp_signaling->has_hrbm = true;
+		mmtp_signaling->hrbm_message = *hrbm_message;
+		if(b_changed && ((demux_sys_t*)p_demux->p_sys)->b_hrbm) {
+			applyHrbm(mmtp_signaling_context, hrbm_message);
+		}
+	} else {
+		__LOG_TRACE(p_demux, "%d:processSignallingMessage - packet_id: %hu, message_id: 0x%04x not decoded", __LINE__,
+				mmt_signaling_message->packet_id, mmt_signaling_message->message_id);
+	}
+}
+
+static void processSignallingPayload(demux_t *p_demux, mmtp_service_t *mmtp_service, mmtp_sub_flow_vector_t *mmtp_sub_flow_vector,
+		mmtp_payload_fragments_union_t *mmtp_packet_header, atsc3_cursor_t *cursor) {
+	mmtp_signaling_t *mmtp_signaling = mmtp_signaling_get(p_demux->p_sys, mmtp_service);
+	mmtp_signaling_context_t mmtp_signaling_context = { p_demux, mmtp_service, mmtp_sub_flow_vector };
+
+	if(mmt_signaling_message_payload_parse(&mmtp_signaling->reassembly, mmtp_packet_header, cursor, processSignallingMessage, &mmtp_signaling_context)) {
+		msg_Warn(p_demux, "%d:mmtp_demuxer - malformed signaling message, packet_id: %hu", __LINE__, mmtp_packet_header->mmtp_packet_header.mmtp_packet_id);
+	}
+}
+
+static void closeMmtpSignaling(demux_t *p_demux, mmtp_signaling_t *mmtp_signaling) {
+	if(mmtp_signaling->reassembly.stats.messages) {
+		__LOG_INFO(p_demux, "mmtp_demuxer.close() - signaling messages: %"PRIu64" (not supported: %"PRIu64", malformed: %"PRIu64"), fragmented messages dropped: %"PRIu64,
+				mmtp_signaling->reassembly.stats.messages, mmtp_signaling->reassembly.stats.messages_not_supported,
+				mmtp_signaling->reassembly.stats.messages_malformed, mmtp_signaling->reassembly.stats.fragments_dropped);
+	}
+	mmt_signaling_message_reassembly_free(&mmtp_signaling->reassembly);
+}
+
+static void closeMmtpAlFec(mmtp_al_fec_decoder_t *mmtp_al_fec_decoder) {
+	if(mmtp_al_fec_decoder->stats.source_packets || mmtp_al_fec_decoder->stats.repair_packets) {
+		mmtp_al_fec_decoder_stats_dump(mmtp_al_fec_decoder);
+	}
+	mmtp_al_fec_decoder_free(mmtp_al_fec_decoder);
+}
+
+static void closeMmtpSubFlowVector(demux_t *p_demux, mmtp_sub_flow_vector_t *mmtp_sub_flow_vector) {
+	for(size_t i=0; i < mmtp_sub_flow_vector->size; i++) {
+		mmtp_sub_flow_t* mmtp_sub_flow = mmtp_sub_flow_vector->data[i];
+		mmtp_flow_stats_dump(&mmtp_sub_flow->flow_stats, mmtp_sub_flow->mmtp_packet_id);
+		if(mmtp_sub_flow->mpu_fragments) {
+			mpu_isobmff_fragment_parameters_t* isobmff_parameters = &mmtp_sub_flow->mpu_fragments->mpu_isobmff_fragment_parameters;
+
+			mmtp_reorder_window_flush(&isobmff_parameters->mmtp_reorder_window, discardMmtpReorderPacket, p_demux);
+			mmtp_reorder_window_stats_dump(&isobmff_parameters->mmtp_reorder_window, mmtp_sub_flow->mmtp_packet_id);
+			mmtp_reorder_window_free(&isobmff_parameters->mmtp_reorder_window);
+
+			__LOG_INFO(p_demux, "mmtp_demuxer.close() - packet_id: %hu, samples emitted: %"PRIu64" (without trun: %"PRIu64", predicted trun: %"PRIu64", partial: %"PRIu64"), dropped: %"PRIu64", late fragments: %"PRIu64,
+					mmtp_sub_flow->mmtp_packet_id,
+					isobmff_parameters->mfu_sample_emitter.stats.samples_emitted,
+					isobmff_parameters->mfu_sample_emitter.stats.samples_emitted_without_sample_table,
+					isobmff_parameters->mfu_sample_emitter.stats.samples_emitted_with_predicted_sample_table,
+					isobmff_parameters->mfu_sample_emitter.stats.samples_emitted_partial,
+					isobmff_parameters->mfu_sample_emitter.stats.samples_dropped,
+					isobmff_parameters->mfu_sample_emitter.stats.fragments_late);
+
+			mfu_sample_emitter_free(&isobmff_parameters->mfu_sample_emitter);
+
+			//signaled but never taken over by a track
+			if(isobmff_parameters->p_signaled_es) {
+				es_out_Del(p_demux->out, isobmff_parameters->p_signaled_es);
+				isobmff_parameters->p_signaled_es = NULL;
+			}
+		}
+	}
+	mmtp_fragment_store_stats_dump(mmtp_sub_flow_vector);
+	mmtp_sub_flow_vector_free(mmtp_sub_flow_vector);
+}
+
+/**
+ * Destroys the MMTP-demuxer
+ *
+ * todo: clear our re-assembly vectors
+ */
+static void Close( vlc_object_t *p_this )
+{
+    demux_t *p_demux = (demux_t*)p_this;
+	demux_sys_t *p_sys = p_demux->p_sys;
+
+    if(p_sys) {
+    	var_DelCallback(p_this->obj.libvlc, "key-pressed", vlc_key_to_action, (void*)p_this);
+    	mmtp_receive_thread_stop(p_demux);
+    	if(p_sys->i_stats_interval)
+    		mmtp_flow_stats_publish(p_demux);
+
+    	closeMmtpSubFlowVector(p_demux, &p_sys->mmtp_sub_flow_vector);
+    	closeMmtpSignaling(p_demux, &p_sys->signaling);
+    	closeMmtpAlFec(&p_sys->al_fec);
+    	if(p_sys->pcr_clock.mmtp_clock_recovery.stats.packets) {
+    		__LOG_INFO(p_demux, "mmtp_demuxer.close() - pcr lag: %"PRId64" ms", MS_FROM_VLC_TICK(p_sys->pcr_clock.i_lag));
+    		mmtp_clock_recovery_stats_dump(&p_sys->pcr_clock.mmtp_clock_recovery);
+    	}
+
+    	for(int i=0; i < p_sys->i_services; i++) {
+    		mmtp_service_t *mmtp_service = p_sys->pp_services[i];
+    		__LOG_INFO(p_demux, "mmtp_demuxer.close() - service_id: %hu, pcr lag: %"PRId64" ms", mmtp_service->service_id, MS_FROM_VLC_TICK(mmtp_service->pcr_clock.i_lag));
+    		mmtp_clock_recovery_stats_dump(&mmtp_service->pcr_clock.mmtp_clock_recovery);
+    		closeMmtpSubFlowVector(p_demux, &mmtp_service->mmtp_sub_flow_vector);
+    		closeMmtpSignaling(p_demux, &mmtp_service->signaling);
+    		closeMmtpAlFec(&mmtp_service->al_fec);
+    		free(mmtp_service->psz_cache_scope);
+    		free(mmtp_service);
+    	}
+    	TAB_CLEAN(p_sys->i_services, p_sys->pp_services);
+    	udp_flow_service_map_free(&p_sys->udp_flow_service_map);
+    	if(p_sys->lls_table_manager.tables_received) {
+    		lls_table_manager_stats_dump(&p_sys->lls_table_manager);
+    	}
+    	lls_table_manager_free(&p_sys->lls_table_manager);
+    	mmtp_mpu_metadata_cache_close(p_demux);
+    	mmtp_objects_close(p_demux);
+    	if(p_sys->i_unmatched_datagrams) {
+    		__LOG_INFO(p_demux, "mmtp_demuxer.close() - %"PRIu64" datagrams on flows without an SLT service", p_sys->i_unmatched_datagrams);
+    	}
+    	//the reorder window lost counts above include these, whatever is left over is network loss
+    	if(atomic_load(&p_sys->i_recv_drops)) {
+    		__LOG_INFO(p_demux, "mmtp_demuxer.close() - %"PRIu64" datagrams dropped by the socket receive buffer", (uint64_t)atomic_load(&p_sys->i_recv_drops));
+    	}
+
+    	mmtp_block_view_pools_destroy(p_sys);
+    	mmtp_trace_close(p_demux);
+
+    	free(p_sys);
+    }
+    p_demux->p_sys = NULL;
+
+    __LOG_INFO(p_demux, "mmtp_demuxer.close()");
+}
+
+typedef struct mmtp_al_fec_context {
+	demux_t*				p_demux;
+	mmtp_service_t*			mmtp_service;
+	mmtp_sub_flow_vector_t*	mmtp_sub_flow_vector;
+	vlc_tick_t				i_arrival;			//of the packet that completed the recovery
+} mmtp_al_fec_context_t;
+
+static void processMmtpPacket(demux_t *p_demux, mmtp_service_t *mmtp_service, mmtp_sub_flow_vector_t *mmtp_sub_flow_vector,
+		block_t *read_block, uint8_t *p_mmtp_packet, size_t i_mmtp_packet, bool b_fec_recovered);
+
+//a source packet rebuilt from repair symbols goes through the same path as a received one, minus AL-FEC
+static void processFecRecoveredPacket(void *context, uint32_t ss_id, const uint8_t *packet, size_t packet_length) {
+	mmtp_al_fec_context_t *mmtp_al_fec_context = context;
+
+	block_t *p_block = block_Alloc(packet_length);
+	if(!p_block) {
+		return;
+	}
+	memcpy(p_block->p_buffer, packet, packet_length);
+	p_block->i_dts = mmtp_al_fec_context->i_arrival;
+
+	__LOG_DEBUG(mmtp_al_fec_context->p_demux, "%d:processFecRecoveredPacket - ss_id: %u, %zu bytes", __LINE__, ss_id, packet_length);
+
+	processMmtpPacket(mmtp_al_fec_context->p_demux, mmtp_al_fec_context->mmtp_service, mmtp_al_fec_context->mmtp_sub_flow_vector,
+			p_block, p_block->p_buffer, p_block->i_buffer, true);
+}
+
+/**
+ * one MMTP packet, from the wire or rebuilt by AL-FEC: read_block is consumed
+ */
+static void processMmtpPacket(demux_t *p_demux, mmtp_service_t *mmtp_service, mmtp_sub_flow_vector_t *mmtp_sub_flow_vector,
+		block_t *read_block, uint8_t *p_mmtp_packet, size_t i_mmtp_packet, bool b_fec_recovered)
+{
+	demux_sys_t *p_sys = p_demux->p_sys;
+	mmtp_sub_flow_t *mmtp_sub_flow = NULL;
+	mmtp_payload_fragments_union_t *mmtp_packet_header = NULL;
+	mmtp_raw_packet_ref_t *mmtp_raw_packet_ref = NULL;
+	atsc3_cursor_t cursor;
+
+	ssize_t mmtp_raw_packet_size = i_mmtp_packet;
+
+   	if( mmtp_raw_packet_size > MAX_MMTP_SIZE || mmtp_raw_packet_size < MIN_MMTP_SIZE) {
+   		__LOG_DEBUG( p_demux, "%d:mmtp_demuxer - size from UDP was under/over heureis/max, dropping %zd bytes", __LINE__, mmtp_raw_packet_size);
+   		_ATSC3_TRACE_EVENT(&p_sys->trace_ring, read_block->i_dts, ATSC3_TRACE_EVENT_PACKET_DROPPED, 0, ATSC3_TRACE_DROP_SIZE, i_mmtp_packet, 0);
+   		block_Release(read_block);
+   		return;
+   	}
+
+   	//parse in place over the received datagram, data units are handed off as views into read_block
+	mmtp_raw_packet_ref = mmtp_raw_packet_ref_new(&p_sys->mmtp_raw_packet_ref_pool, read_block);
+	if(!mmtp_raw_packet_ref) {
+		block_Release(read_block);
+		return;
+	}
+
+	mmtp_packet_header = mmtp_fragment_store_packet_alloc(mmtp_sub_flow_vector);
+	if(!mmtp_packet_header) {
+		mmtp_raw_packet_ref_release(mmtp_raw_packet_ref);
+		return;
+	}
+	mmtp_packet_header->mmtp_packet_header.raw_packet = read_block;
+
+	atsc3_cursor_init(&cursor, p_mmtp_packet, i_mmtp_packet);
+
+	if(mmtp_packet_header_parse_from_cursor(mmtp_packet_header, &cursor)) {
+   		__LOG_DEBUG( p_demux, "%d:mmtp_demuxer - mmtp_packet_header_parse_from_cursor failed, dropping packet", __LINE__);
+   		_ATSC3_TRACE_EVENT(&p_sys->trace_ring, read_block->i_dts, ATSC3_TRACE_EVENT_PACKET_DROPPED, 0, ATSC3_TRACE_DROP_HEADER, i_mmtp_packet, 0);
+   		mmtp_fragment_store_packet_free(mmtp_sub_flow_vector, mmtp_packet_header);
+   		mmtp_raw_packet_ref_release(mmtp_raw_packet_ref);
+
+   		return;
+	}
+
+	_ATSC3_TRACE_EVENT(&p_sys->trace_ring, read_block->i_dts, b_fec_recovered ? ATSC3_TRACE_EVENT_FEC_RECOVERED : ATSC3_TRACE_EVENT_PACKET,
+			mmtp_packet_header->mmtp_packet_header.mmtp_packet_id, mmtp_packet_header->mmtp_packet_header.packet_sequence_number,
+			(uint32_t)mmtp_packet_header->mmtp_packet_header.mmtp_payload_type << 16 | (i_mmtp_packet & 0xFFFF),
+			mmtp_packet_header->mmtp_packet_header.mmtp_timestamp);
+
+	//create a sub_flow with this packet_id
+	__LOG_DEBUG( p_demux, "%d:mmtp_demuxer, after mmtp_packet_header_parse_from_cursor, mmtp_packet_id is: %d, mmtp_payload_type: 0x%x, packet_counter: %d, remaining len: %zu, mmtp_raw_packet_size: %zd",
+			__LINE__,
+			mmtp_packet_header->mmtp_packet_header.mmtp_packet_id,
+			mmtp_packet_header->mmtp_packet_header.mmtp_payload_type,
+			mmtp_packet_header->mmtp_packet_header.packet_counter,
+			atsc3_cursor_remaining(&cursor),
+			mmtp_raw_packet_size);
+
+	//AL-FEC: repair symbols only feed the decoder, source packets are kept for it less their trailing source_FEC_payload_ID.
+	//without mmtp-al-fec repair packets are dropped and source packets only lose their source_FEC_payload_ID
+	mmtp_al_fec_context_t mmtp_al_fec_context = { p_demux, mmtp_service, mmtp_sub_flow_vector, read_block->i_dts };
+	mmtp_al_fec_decoder_t *mmtp_al_fec_decoder = mmtp_al_fec_get(p_sys, mmtp_service);
+	if(mmtp_packet_header->mmtp_packet_header.mmtp_payload_type == 0x3) {
+		if(p_sys->b_al_fec && mmtp_al_fec_decoder_push_repair(mmtp_al_fec_decoder, cursor.pos, atsc3_cursor_remaining(&cursor), read_block->i_dts, processFecRecoveredPacket, &mmtp_al_fec_context)) {
+			__LOG_DEBUG(p_demux, "%d:mmtp_demuxer - packet_id: %hu, malformed repair packet", __LINE__, mmtp_packet_header->mmtp_packet_header.mmtp_packet_id);
+		}
+		goto done;
+	}
+
+	if(mmtp_packet_header->mmtp_packet_header.fec_type == 0x1 && !b_fec_recovered) {
+		if(atsc3_cursor_remaining(&cursor) < MMTP_AL_FEC_SOURCE_FEC_PAYLOAD_ID_LENGTH) {
+			__LOG_DEBUG(p_demux, "%d:mmtp_demuxer - packet_id: %hu, no room for source_FEC_payload_ID, dropping packet", __LINE__, mmtp_packet_header->mmtp_packet_header.mmtp_packet_id);
+			_ATSC3_TRACE_EVENT(&p_sys->trace_ring, read_block->i_dts, ATSC3_TRACE_EVENT_PACKET_DROPPED, mmtp_packet_header->mmtp_packet_header.mmtp_packet_id,
+					ATSC3_TRACE_DROP_FEC_PAYLOAD_ID, i_mmtp_packet, 0);
+			goto done;
+		}
+		cursor.end -= MMTP_AL_FEC_SOURCE_FEC_PAYLOAD_ID_LENGTH;
+		if(p_sys->b_al_fec) {
+			mmtp_al_fec_decoder_push_source(mmtp_al_fec_decoder, GetDWBE(cursor.end), p_mmtp_packet, cursor.end - p_mmtp_packet,
+					read_block->i_dts, processFecRecoveredPacket, &mmtp_al_fec_context);
+		}
+	}
+
+	mmtp_sub_flow = mmtp_sub_flow_vector_get_or_set_packet_id(mmtp_sub_flow_vector, mmtp_packet_header->mmtp_packet_header.mmtp_packet_id);
+	__LOG_DEBUG( p_demux, "%d:mmtp_demuxer - mmtp_sub_flow is: %p, mmtp_sub_flow->mpu_fragments: %p", __LINE__, mmtp_sub_flow, mmtp_sub_flow->mpu_fragments);
+	mmtp_sub_flow->mpu_fragments->mpu_isobmff_fragment_parameters.mmtp_service = mmtp_service;
+	mmtp_flow_stats_push_packet(&mmtp_sub_flow->flow_stats, mmtp_packet_header->mmtp_packet_header.packet_sequence_number, i_mmtp_packet,
+			mmtp_packet_header->mmtp_packet_header.mmtp_timestamp, read_block->i_dts, b_fec_recovered);
+
+	//every packet's send time against its arrival, whatever its payload, drives the pcr. a recovered packet's arrival says nothing
+	if(!b_fec_recovered) {
+		mmtp_clock_recovery_push(&mmtp_pcr_clock_get(p_sys, mmtp_service)->mmtp_clock_recovery, mmtp_packet_header->mmtp_packet_header.mmtp_timestamp, read_block->i_dts);
+		mmtp_demuxer_update_pcr(p_demux, mmtp_service, mmtp_demuxer_clock_now(p_sys));
+	}
+
+	//push this to the proper fragment container, continue parsing below
+	mmtp_sub_flow_push_mmtp_packet(mmtp_sub_flow, mmtp_packet_header);
+
+	if(mmtp_packet_header->mmtp_packet_header.mmtp_header_extension_flag & 0x1) {
+		__LOG_DEBUG( p_demux, "mmtp_header_extension_flag, header extension size: %d, packet version: %d, payload_type: 0x%X, packet_id 0x%hu, timestamp: 0x%X, packet_sequence_number: 0x%X, packet_counter: 0x%X",
+				mmtp_packet_header->mmtp_packet_header.mmtp_header_extension_length,
+				mmtp_packet_header->mmtp_packet_header.mmtp_packet_version,
+				mmtp_packet_header->mmtp_packet_header.mmtp_payload_type,
+				mmtp_packet_header->mmtp_packet_header.mmtp_packet_id,
+				mmtp_packet_header->mmtp_packet_header.mmtp_timestamp,
+				mmtp_packet_header->mmtp_packet_header.packet_sequence_number,
+				mmtp_packet_header->mmtp_packet_header.packet_counter);
+	}
+
+	if(mmtp_packet_header->mmtp_packet_header.mmtp_payload_type == 0x1) {
+		processGenericObjectPayload(p_demux, mmtp_service, mmtp_packet_header, &cursor);
+		goto done;
+	}
+
+	if(mmtp_packet_header->mmtp_packet_header.mmtp_payload_type == 0x2) {
+		processSignallingPayload(p_demux, mmtp_service, mmtp_sub_flow_vector, mmtp_packet_header, &cursor);
+		goto done;
+	}
+
+	if(mmtp_packet_header->mmtp_packet_header.mmtp_payload_type == 0x0) {
+		//pull the mpu and frag iformation
+		if(mmtp_mpu_packet_header_parse_from_cursor(mmtp_packet_header, &cursor)) {
+			goto done;
+		}
+
+		__LOG_DEBUG( p_demux, "%d:mmtp_demuxer - mmtp packet: mpu_fragment_type: 0x%x, mpu_timed_flag: 0x%x, mpu_fragmentation_indicator: 0x%x, mpu_aggregation_flag: 0x%x, mpu_payload_length: %hu, mpu_fragmentation_counter: %d, mpu_sequence_number: %d",
+					__LINE__,
+					mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_fragment_type,
+					mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_timed_flag,
+					mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_fragmentation_indicator,
+					mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_aggregation_flag,
+					mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_payload_length,
+					mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_fragmentation_counter,
+					mmtp_packet_header->mmtp_mpu_type_packet_header.mpu_sequence_number);
+
+		//hand off to this packet_id's reorder window, data units are parsed once the packet is released in sequence order
+		mmtp_reorder_packet_t *mmtp_reorder_packet = atsc3_slab_pool_alloc(&p_sys->mmtp_reorder_packet_pool);
+		if(!mmtp_reorder_packet) {
+			goto done;
+		}
+		mmtp_reorder_packet->mmtp_sub_flow = mmtp_sub_flow;
+		mmtp_reorder_packet->mmtp_packet_header = mmtp_packet_header;
+		mmtp_reorder_packet->mmtp_raw_packet_ref = mmtp_raw_packet_ref;
+		mmtp_reorder_packet->cursor = cursor;
+
+		mpu_isobmff_fragment_parameters_t *isobmff_parameters = &mmtp_sub_flow->mpu_fragments->mpu_isobmff_fragment_parameters;
+		if(!isobmff_parameters->mmtp_reorder_window.entries && p_sys->i_reorder_packets) {
+			mmtp_reorder_window_init(&isobmff_parameters->mmtp_reorder_window, p_sys->i_reorder_packets, mmtp_reorder_hold_get(p_sys, mmtp_service));
+		}
+
+		//held packets age on arrival stamps, a pcap replayed as fast as possible would otherwise never hold anything
+		if(mmtp_reorder_window_push(&isobmff_parameters->mmtp_reorder_window, mmtp_packet_header->mmtp_packet_header.packet_sequence_number,
+				read_block->i_dts, mmtp_reorder_packet, processMmtpReorderPacket, p_demux)) {
+			__LOG_DEBUG(p_demux, "%d:mmtp_demuxer - packet_id: %hu, packet_sequence_number: %u is late or a duplicate, dropping",
+					__LINE__, mmtp_packet_header->mmtp_packet_header.mmtp_packet_id, mmtp_packet_header->mmtp_packet_header.packet_sequence_number);
+			_ATSC3_TRACE_EVENT(&p_sys->trace_ring, read_block->i_dts, ATSC3_TRACE_EVENT_PACKET_DROPPED, mmtp_packet_header->mmtp_packet_header.mmtp_packet_id,
+					ATSC3_TRACE_DROP_LATE, i_mmtp_packet, mmtp_packet_header->mmtp_packet_header.packet_sequence_number);
+			atsc3_slab_pool_free(&p_sys->mmtp_reorder_packet_pool, mmtp_reorder_packet);
+			goto done;
+		}
+
+		//the reorder window owns the header and our datagram reference now
+		return;
+	}
+
+	__LOG_TRACE(p_demux, "%d:demux - return", __LINE__);
+
+done:
+	//packets not handed to the fragment store are still ours
+	if(mmtp_packet_header) {
+		mmtp_fragment_store_packet_free(mmtp_sub_flow_vector, mmtp_packet_header);
+	}
+	mmtp_raw_packet_ref_release(mmtp_raw_packet_ref);
+}
+
+
+/**
+ *
+ * mmtp demuxer,
+ * 	rebuild UDP packets into one MFU packet, push to es for output
+ *
+ * 	todo:
+ * 		decode
+ *
+ * use p_sys->s for udp,
+ * use p_sys->s_frag for fragmented mp4 demux / decoding
+ *
+ */
+
+static int Demux( demux_t *p_demux )
+{
+	demux_sys_t *p_sys = p_demux->p_sys;
+	mmtp_sub_flow_vector_t *mmtp_sub_flow_vector = &p_sys->mmtp_sub_flow_vector;
+
+	//__LOG_INFO(p_demux, "mmtp_demuxer.demux()");
+
+    /* Get a new MMTP packet, use p_demux->s as the blocking reference and 1514 as the max mtu in udp.c*/
+    //vlc_stream_Block will try and fill MAX_MTU_SIZE instead of relying on the
+    //  MMTP udp frame size
+    //readPartial still reads a block_chain
+    // if( !( mmtp_raw_packet_size = vlc_stream_ReadPartial( p_demux->s, (void*)rawBuf, MAX_MMTP_SIZE ) ) )
+
+	block_t *read_block;
+
+	//the ring has a single writer, so it is dumped here rather than from the hotkey callback
+	if( atomic_load_explicit( &p_sys->b_trace_dump, memory_order_relaxed ) && atomic_exchange( &p_sys->b_trace_dump, false ) )
+		mmtp_trace_dump( p_demux );
+
+	if( p_sys->i_reorder_packets )
+		mmtp_demuxer_reorder_expire( p_demux, mmtp_demuxer_clock_now( p_sys ) );
+
+	if( p_sys->b_receive_thread )
+	{
+		if( !( read_block = mmtp_receive_ring_pop( p_demux ) ) )
+			return atomic_load( &p_sys->b_receive_eof ) ? VLC_DEMUXER_EOF : VLC_DEMUXER_SUCCESS;
+	}
+	else if( !( read_block = vlc_stream_ReadBlock( p_demux->s) ) )
+    {
+		msg_Err( p_demux, "mmtp_demuxer - access request returned null!");
+		return VLC_DEMUXER_SUCCESS;
+	}
+	else
+		mmtp_receive_stamp( p_demux, read_block );
+
+    __LOG_TRACE(p_demux, "%d:mmtp_demuxer: vlc_stream_readblock size is: %zu", __LINE__, read_block->i_buffer);
+    p_sys->i_last_arrival = read_block->i_dts;
+
+    //paced by arrival time, so no extra clock read per datagram
+    if( p_sys->i_stats_interval && read_block->i_dts >= p_sys->i_stats_next_publish )
+    {
+    	if( p_sys->i_stats_next_publish )
+    		mmtp_flow_stats_publish( p_demux );
+    	p_sys->i_stats_next_publish = read_block->i_dts + p_sys->i_stats_interval;
+    }
+
+    uint8_t *p_mmtp_packet = read_block->p_buffer;
+    size_t i_mmtp_packet = read_block->i_buffer;
+    mmtp_service_t *mmtp_service = NULL;
+
+    //full PLP input, route each datagram by its destination flow: LLS, a known service, or dropped
+    if( p_sys->b_ip_input )
+    {
+    	udp_flow_t udp_flow;
+    	if( udp_flow_parse_ipv4( read_block->p_buffer, read_block->i_buffer, &udp_flow, &p_mmtp_packet, &i_mmtp_packet ) )
+    	{
+    		p_sys->i_unmatched_datagrams++;
+    		block_Release(read_block);
+    		return VLC_DEMUXER_SUCCESS;
+    	}
+
+    	if( udp_flow_is_lls( &udp_flow ) )
+    	{
+    		processLlsTable( p_demux, p_mmtp_packet, i_mmtp_packet );
+    		block_Release(read_block);
+    		return VLC_DEMUXER_SUCCESS;
+    	}
+
+    	udp_flow_service_t *udp_flow_service = udp_flow_service_map_find( &p_sys->udp_flow_service_map, udp_flow.dst_ip_addr, udp_flow.dst_port );
+    	if( udp_flow_service )
+    		mmtp_service = mmtp_service_find( p_sys, udp_flow_service->service_id );
+
+    	if( !mmtp_service )
+    	{
+    		p_sys->i_unmatched_datagrams++;
+    		block_Release(read_block);
+    		return VLC_DEMUXER_SUCCESS;
+    	}
+    	mmtp_sub_flow_vector = &mmtp_service->mmtp_sub_flow_vector;
+    }
+
+    processMmtpPacket( p_demux, mmtp_service, mmtp_sub_flow_vector, read_block, p_mmtp_packet, i_mmtp_packet, false );
+
+    return VLC_DEMUXER_SUCCESS;
+}
+
+
+/** todo - add
+ * DEMUX_SET_GROUP_DEFAULT ?
+ *
+ * DEMUX_FILTER_DISABLE
+ *
+ */
+static int Control( demux_t *p_demux, int i_query, va_list args )
+{
+   // __LOG_INFO(p_demux, "control: query is: %d", i_query);
+	demux_sys_t *p_sys = p_demux->p_sys;
+
+    bool *pb;
     double f, *pf;
 
     unsigned *flags;
@@ -944,14 +2161,22 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
     {
     	case DEMUX_CAN_SEEK:
         case DEMUX_CAN_PAUSE:
+            pb = va_arg ( args, bool* );
+            *pb = false;
+            break;
+
+        //a pcap replayed without pcap-realtime, or a file, is read as fast as the input core lets us
         case DEMUX_CAN_CONTROL_PACE:
             pb = va_arg ( args, bool* );
-            *pb = false;
+            *pb = p_sys->b_can_control_pace;
             break;
 
 
+        //the pcr already trails the recovered sender clock by mmtp-pcr-delay, only the network caching goes on top.
+        //low latency keeps the pcr just behind each sample sent, any caching would undo it
         case DEMUX_GET_PTS_DELAY:
-                    *va_arg( args, vlc_tick_t * ) =1000000;
+        	*va_arg( args, vlc_tick_t * ) = p_sys->b_low_latency ? MMTP_LOW_LATENCY_PCR_DELAY :
+        			VLC_TICK_FROM_MS( var_InheritInteger( p_demux, "network-caching" ) );
         	return VLC_SUCCESS;
 
         case DEMUX_GET_META:
@@ -978,9 +2203,53 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
 			*va_arg( args, vlc_tick_t * ) = p_sys->last_pts - p_sys->first_pts;
 			break;
 
+        case DEMUX_GET_MMTP_FLOW_STATS:
+        {
+        	mmtp_flow_stats_entry_t **pp_entries = va_arg( args, mmtp_flow_stats_entry_t ** );
+        	size_t *pi_entries = va_arg( args, size_t * );
+        	return mmtp_flow_stats_snapshot( p_demux, pp_entries, pi_entries );
+        }
+
+        case DEMUX_MMTP_DUMP_TRACE_EVENTS:
+        	if( !p_sys->trace_ring.events )
+        		return VLC_EGENERIC;
+        	mmtp_trace_dump( p_demux );
+        	return VLC_SUCCESS;
+
+        //attachments are only fetched again once an object was added or changed
+        case DEMUX_TEST_AND_CLEAR_FLAGS:
+        {
+        	flags = va_arg( args, unsigned * );
+        	*flags &= p_sys->i_updates;
+        	p_sys->i_updates &= ~*flags;
+        	return VLC_SUCCESS;
+        }
+
         case DEMUX_GET_ATTACHMENTS:
-        	return VLC_EGENERIC;
-        	break;
+        {
+        	input_attachment_t ***ppp_attach = va_arg( args, input_attachment_t*** );
+        	int *pi_int = va_arg( args, int * );
+
+        	if( p_sys->i_object_attachments <= 0 )
+        		return VLC_EGENERIC;
+
+        	*ppp_attach = vlc_alloc( p_sys->i_object_attachments, sizeof(input_attachment_t*) );
+        	if( !*ppp_attach )
+        		return VLC_ENOMEM;
+        	for( int i = 0; i < p_sys->i_object_attachments; i++ )
+        	{
+        		(*ppp_attach)[i] = vlc_input_attachment_Duplicate( p_sys->pp_object_attachments[i] );
+        		if( !(*ppp_attach)[i] )
+        		{
+        			for( int j = 0; j < i; j++ )
+        				vlc_input_attachment_Delete( (*ppp_attach)[j] );
+        			free( *ppp_attach );
+        			return VLC_ENOMEM;
+        		}
+        	}
+        	*pi_int = p_sys->i_object_attachments;
+        	return VLC_SUCCESS;
+        }
     }
 
     return VLC_SUCCESS; //demux_vaControlHelper( p_demux->s, 0, -1, 0, 1, i_query, args );
@@ -1039,6 +2308,322 @@ static int Control( demux_t *p_demux, int i_query, va_list args )
 
 //mpu_type_packet->mmtp_mpu_type_packet_header.
 
+/**
+ * es_out sink for mfu_sample_emitter, each sample is copied out of the emitter into its own block
+ */
+typedef struct mfu_sample_es_out_context {
+	demux_t*		p_demux;
+	mp4_track_t*	p_track;
+	mmtp_service_t*	mmtp_service;
+	uint16_t		mmtp_packet_id;
+} mfu_sample_es_out_context_t;
+
+static void mmtp_pcr_clock_init(mmtp_pcr_clock_t *pcr_clock) {
+	memset(pcr_clock, 0, sizeof(mmtp_pcr_clock_t));
+	mmtp_clock_recovery_init(&pcr_clock->mmtp_clock_recovery, MMTP_CLOCK_RECOVERY_DEFAULT_WINDOW_US);
+	pcr_clock->i_pcr = VLC_TICK_INVALID;
+}
+
+static mmtp_pcr_clock_t* mmtp_pcr_clock_get(demux_sys_t *p_sys, mmtp_service_t *mmtp_service) {
+	return mmtp_service ? &mmtp_service->pcr_clock : &p_sys->pcr_clock;
+}
+
+//the receiver clock the sender clock is recovered against: the wall clock for live input, the arrival stamps of a
+//paced one, which a pcap replayed as fast as possible takes from its capture timebase
+static vlc_tick_t mmtp_demuxer_clock_now(demux_sys_t *p_sys) {
+	return p_sys->b_can_control_pace ? p_sys->i_last_arrival : vlc_tick_now();
+}
+
+//es_out_SetPCR for a single udp stream, the service's own group pcr for mmtp-ip-input
+static void mmtp_demuxer_set_pcr(demux_t *p_demux, mmtp_service_t *mmtp_service, vlc_tick_t i_pcr) {
+	demux_sys_t *p_sys = p_demux->p_sys;
+	mmtp_pcr_clock_t *pcr_clock = mmtp_pcr_clock_get(p_sys, mmtp_service);
+
+	pcr_clock->i_pcr = i_pcr;
+	pcr_clock->has_set_first_pcr = true;
+	_ATSC3_TRACE_EVENT(&p_sys->trace_ring, vlc_tick_now(), ATSC3_TRACE_EVENT_PCR, 0, mmtp_service ? mmtp_service->service_id : 0, 0, i_pcr);
+
+	if(mmtp_service) {
+		es_out_Control(p_demux->out, ES_OUT_SET_GROUP_PCR, mmtp_service->i_group, i_pcr);
+	} else {
+		es_out_SetPCR(p_demux->out, i_pcr);
+	}
+}
+
+//the recovered sender clock held back by mmtp-pcr-delay (or the HRBM delay) and the measured reassembly lag, VLC_TICK_INVALID until recovered
+static vlc_tick_t mmtp_pcr_clock_target(demux_sys_t *p_sys, mmtp_pcr_clock_t *pcr_clock, vlc_tick_t now) {
+	int64_t i_clock = mmtp_clock_recovery_now(&pcr_clock->mmtp_clock_recovery, now);
+	if(i_clock == MMTP_CLOCK_RECOVERY_INVALID) {
+		return VLC_TICK_INVALID;
+	}
+
+	vlc_tick_t i_delay = pcr_clock->i_hrbm_delay ? pcr_clock->i_hrbm_delay : p_sys->i_pcr_delay;
+	return VLC_TICK_0 + i_clock - i_delay - pcr_clock->i_lag;
+}
+
+//a sender restart also restarts packet_sequence_number, release what is held and start each window over
+static void mmtp_reorder_windows_reset(demux_t *p_demux, mmtp_sub_flow_vector_t *mmtp_sub_flow_vector) {
+	for(size_t i=0; i < mmtp_sub_flow_vector->size; i++) {
+		mmtp_sub_flow_t *mmtp_sub_flow = mmtp_sub_flow_vector->data[i];
+		if(mmtp_sub_flow->mpu_fragments) {
+			mmtp_reorder_window_reset(&mmtp_sub_flow->mpu_fragments->mpu_isobmff_fragment_parameters.mmtp_reorder_window,
+					processMmtpReorderPacket, p_demux);
+		}
+	}
+}
+
+static void mmtp_reorder_windows_expire(demux_t *p_demux, mmtp_sub_flow_vector_t *mmtp_sub_flow_vector, vlc_tick_t now) {
+	for(size_t i=0; i < mmtp_sub_flow_vector->size; i++) {
+		mmtp_sub_flow_t *mmtp_sub_flow = mmtp_sub_flow_vector->data[i];
+		if(mmtp_sub_flow->mpu_fragments && mmtp_sub_flow->mpu_fragments->mpu_isobmff_fragment_parameters.mmtp_reorder_window.held_count) {
+			mmtp_reorder_window_expire(&mmtp_sub_flow->mpu_fragments->mpu_isobmff_fragment_parameters.mmtp_reorder_window, now,
+					processMmtpReorderPacket, p_demux);
+		}
+	}
+}
+
+//a push only ages its own packet_id's window, the others (and every window while nothing arrives) are aged here
+static void mmtp_demuxer_reorder_expire(demux_t *p_demux, vlc_tick_t now) {
+	demux_sys_t *p_sys = p_demux->p_sys;
+
+	mmtp_reorder_windows_expire(p_demux, &p_sys->mmtp_sub_flow_vector, now);
+	for(int i=0; i < p_sys->i_services; i++) {
+		mmtp_reorder_windows_expire(p_demux, &p_sys->pp_services[i]->mmtp_sub_flow_vector, now);
+	}
+}
+
+/**
+ * pcr from the recovered sender clock, low latency mode drives the pcr from each sample sent instead
+ */
+static void mmtp_demuxer_update_pcr(demux_t *p_demux, mmtp_service_t *mmtp_service, vlc_tick_t now) {
+	demux_sys_t *p_sys = p_demux->p_sys;
+	mmtp_pcr_clock_t *pcr_clock = mmtp_pcr_clock_get(p_sys, mmtp_service);
+
+	//the sender clock jumped, start over instead of holding the pcr until it catches up
+	if(pcr_clock->discontinuities != pcr_clock->mmtp_clock_recovery.stats.discontinuities) {
+		pcr_clock->discontinuities = pcr_clock->mmtp_clock_recovery.stats.discontinuities;
+		msg_Warn(p_demux, "mmtp_demuxer - sender clock discontinuity, resetting pcr and reorder windows");
+		mmtp_reorder_windows_reset(p_demux, mmtp_service ? &mmtp_service->mmtp_sub_flow_vector : &p_sys->mmtp_sub_flow_vector);
+		if(!p_sys->b_low_latency) {
+			es_out_Control(p_demux->out, ES_OUT_RESET_PCR);
+			pcr_clock->has_set_first_pcr = false;
+			pcr_clock->i_lag = 0;
+			pcr_clock->i_next_pcr_update = now;
+		}
+	}
+
+	if(p_sys->b_low_latency) {
+		return;
+	}
+
+	if(now < pcr_clock->i_next_pcr_update) {
+		return;
+	}
+	pcr_clock->i_next_pcr_update = now + MMTP_PCR_UPDATE_INTERVAL;
+
+	vlc_tick_t i_pcr = mmtp_pcr_clock_target(p_sys, pcr_clock, now);
+	if(i_pcr == VLC_TICK_INVALID || i_pcr <= VLC_TICK_0 || (pcr_clock->has_set_first_pcr && i_pcr <= pcr_clock->i_pcr)) {
+		return;
+	}
+
+	mmtp_demuxer_set_pcr(p_demux, mmtp_service, i_pcr);
+}
+
+static void mfu_sample_es_out_send(void* context, const mfu_sample_t* mfu_sample) {
+	mfu_sample_es_out_context_t* mfu_sample_es_out_context = context;
+
+	//the emitter already assembled the sample, hand its buffer to the block rather than copying it again
+	block_t* p_block;
+	uint8_t* p_data = mfu_sample_take_data(mfu_sample);
+	if(p_data) {
+		p_block = block_heap_Alloc(p_data, mfu_sample->size);
+	} else {
+		p_block = block_Alloc(mfu_sample->size);
+		if(p_block && mfu_sample->size) {
+			memcpy(p_block->p_buffer, mfu_sample->data, mfu_sample->size);
+		}
+	}
+	if(!p_block) {
+		return;
+	}
+
+	p_block->i_pts = VLC_TICK_0 + mfu_sample->pts_us;
+	p_block->i_dts = VLC_TICK_0 + mfu_sample->dts_us;
+	p_block->i_length = mfu_sample->duration_us;
+	if(mfu_sample->is_corrupt) {
+		p_block->i_flags |= BLOCK_FLAG_CORRUPTED;
+	}
+
+	//keep the clock just behind what we send instead of a one-shot multi-second cushion
+	demux_sys_t *p_sys = mfu_sample_es_out_context->p_demux->p_sys;
+	mmtp_pcr_clock_t *pcr_clock = mmtp_pcr_clock_get(p_sys, mfu_sample_es_out_context->mmtp_service);
+	if(p_sys->b_low_latency && p_block->i_dts > VLC_TICK_0 + MMTP_LOW_LATENCY_PCR_DELAY) {
+		vlc_tick_t i_pcr = p_block->i_dts - MMTP_LOW_LATENCY_PCR_DELAY;
+		if(!pcr_clock->has_set_first_pcr || i_pcr > pcr_clock->i_pcr) {
+			mmtp_demuxer_set_pcr(mfu_sample_es_out_context->p_demux, mfu_sample_es_out_context->mmtp_service, i_pcr);
+		}
+	} else if(!p_sys->b_low_latency && pcr_clock->has_set_first_pcr && pcr_clock->i_lag < MMTP_PCR_LAG_MAX) {
+		//this sample left reassembly behind where the pcr is headed, hold the pcr back by as much from now on
+		vlc_tick_t i_pcr_target = mmtp_pcr_clock_target(p_sys, pcr_clock, mmtp_demuxer_clock_now(p_sys));
+		if(i_pcr_target != VLC_TICK_INVALID && p_block->i_dts < i_pcr_target + MMTP_PCR_UPDATE_INTERVAL) {
+			pcr_clock->i_lag = __MIN(pcr_clock->i_lag + i_pcr_target + MMTP_PCR_UPDATE_INTERVAL - p_block->i_dts + MMTP_PCR_LAG_MARGIN, MMTP_PCR_LAG_MAX);
+			msg_Dbg(mfu_sample_es_out_context->p_demux, "mmtp_demuxer - sample dts: %"PRId64" behind pcr: %"PRId64", pcr lag now: %"PRId64" ms",
+					p_block->i_dts, i_pcr_target, MS_FROM_VLC_TICK(pcr_clock->i_lag));
+		}
+	}
+
+	__LOG_DEBUG(mfu_sample_es_out_context->p_demux, "%d:mfu_sample_es_out_send: track: %d, mpu_sequence_number: %u, sample: %u, size: %zu, pts: %"PRId64", dts: %"PRId64", length: %"PRId64", sync: %d, from trun: %d",
+			__LINE__, mfu_sample_es_out_context->p_track->i_track_ID, mfu_sample->mpu_sequence_number, mfu_sample->sample_number, mfu_sample->size,
+			p_block->i_pts, p_block->i_dts, p_block->i_length, mfu_sample->is_sync, mfu_sample->has_sample_table);
+	_ATSC3_TRACE_EVENT(&p_sys->trace_ring, vlc_tick_now(), ATSC3_TRACE_EVENT_SAMPLE, mfu_sample_es_out_context->mmtp_packet_id,
+			mfu_sample->mpu_sequence_number, mfu_sample->sample_number, p_block->i_dts);
+
+	es_out_Send(mfu_sample_es_out_context->p_demux->out, mfu_sample_es_out_context->p_track->p_es, p_block);
+}
+
+/**
+ * build the per-sample table for this MPU from the first traf of the reparsed moof (tfhd defaults + trun)
+ */
+static void processMpuSampleTable(demux_t* p_obj, mmtp_sub_flow_t *mmtp_sub_flow, mmtp_payload_fragments_union_t* mpu_type_packet, mfu_sample_es_out_context_t* mfu_sample_es_out_context) {
+	mpu_isobmff_fragment_parameters_t *isobmff_parameters = &mmtp_sub_flow->mpu_fragments->mpu_isobmff_fragment_parameters;
+	if(!isobmff_parameters->mpu_fragments_p_moof) {
+		return;
+	}
+
+	MP4_Box_t* p_tfhd = MP4_BoxGet(isobmff_parameters->mpu_fragments_p_moof, "traf/tfhd");
+	MP4_Box_t* p_trun = MP4_BoxGet(isobmff_parameters->mpu_fragments_p_moof, "traf/trun");
+	if(!p_tfhd || !p_trun || !BOXDATA(p_tfhd) || !BOXDATA(p_trun)) {
+		msg_Warn(p_obj, "%d:processMpuSampleTable - no traf/tfhd or traf/trun in moof, mpu_sequence_number: %u", __LINE__, mpu_type_packet->mmtp_mpu_type_packet_header.mpu_sequence_number);
+		return;
+	}
+
+	const MP4_Box_data_tfhd_t* p_tfhd_data = BOXDATA(p_tfhd);
+	const MP4_Box_data_trun_t* p_trun_data = BOXDATA(p_trun);
+
+	if(!p_trun_data->i_sample_count || p_trun_data->i_sample_count > MFU_SAMPLE_EMITTER_MAX_SAMPLES) {
+		msg_Warn(p_obj, "%d:processMpuSampleTable - trun sample_count: %u out of range", __LINE__, p_trun_data->i_sample_count);
+		return;
+	}
+
+	mpu_sample_timing_t* sample_table = calloc(p_trun_data->i_sample_count, sizeof(mpu_sample_timing_t));
+	if(!sample_table) {
+		return;
+	}
+
+	for(uint32_t i=0; i < p_trun_data->i_sample_count; i++) {
+		const MP4_descriptor_trun_sample_t* p_sample = &p_trun_data->p_samples[i];
+		mpu_sample_timing_t* sample_timing = &sample_table[i];
+
+		sample_timing->duration = (p_trun_data->i_flags & MP4_TRUN_SAMPLE_DURATION) ? p_sample->i_duration :
+									(p_tfhd_data->i_flags & MP4_TFHD_DFLT_SAMPLE_DURATION) ? p_tfhd_data->i_default_sample_duration : 0;
+		sample_timing->size = (p_trun_data->i_flags & MP4_TRUN_SAMPLE_SIZE) ? p_sample->i_size :
+									(p_tfhd_data->i_flags & MP4_TFHD_DFLT_SAMPLE_SIZE) ? p_tfhd_data->i_default_sample_size : 0;
+
+		if(i == 0 && (p_trun_data->i_flags & MP4_TRUN_FIRST_FLAGS)) {
+			sample_timing->flags = p_trun_data->i_first_sample_flags;
+		} else if(p_trun_data->i_flags & MP4_TRUN_SAMPLE_FLAGS) {
+			sample_timing->flags = p_sample->i_flags;
+		} else if(p_tfhd_data->i_flags & MP4_TFHD_DFLT_SAMPLE_FLAGS) {
+			sample_timing->flags = p_tfhd_data->i_default_sample_flags;
+		}
+
+		if(p_trun_data->i_flags & MP4_TRUN_SAMPLE_TIME_OFFSET) {
+			sample_timing->composition_time_offset = p_trun_data->i_version ? p_sample->i_composition_time_offset.v1 : (int32_t)p_sample->i_composition_time_offset.v0;
+		}
+	}
+
+	__LOG_DEBUG(p_obj, "%d:processMpuSampleTable - mpu_sequence_number: %u, timescale: %u, sample_count: %u, first duration: %u",
+			__LINE__, mpu_type_packet->mmtp_mpu_type_packet_header.mpu_sequence_number, mfu_sample_es_out_context->p_track->i_timescale,
+			p_trun_data->i_sample_count, sample_table[0].duration);
+
+	mfu_sample_emitter_set_low_latency(&isobmff_parameters->mfu_sample_emitter, ((demux_sys_t*)p_obj->p_sys)->b_low_latency);
+	mfu_sample_emitter_set_emit_partial_samples(&isobmff_parameters->mfu_sample_emitter, ((demux_sys_t*)p_obj->p_sys)->b_emit_corrupt_samples);
+	mfu_sample_emitter_set_sample_table(&isobmff_parameters->mfu_sample_emitter,
+			mpu_type_packet->mmtp_mpu_type_packet_header.mpu_sequence_number,
+			mfu_sample_es_out_context->p_track->i_timescale ? mfu_sample_es_out_context->p_track->i_timescale : isobmff_parameters->i_asset_timescale,
+			sample_table, p_trun_data->i_sample_count,
+			mfu_sample_es_out_send, mfu_sample_es_out_context);
+
+	if(mfu_sample_emitter_is_mpu_complete(&isobmff_parameters->mfu_sample_emitter)) {
+		mmtp_flow_stats_mpu_complete(&mmtp_sub_flow->flow_stats, mpu_type_packet->mmtp_mpu_type_packet_header.mpu_sequence_number, vlc_tick_now());
+		mmtp_fragment_store_mpu_complete(mmtp_sub_flow, mpu_type_packet->mmtp_mpu_type_packet_header.mpu_sequence_number);
+		mmtp_fragment_store_mpu_emitted(mmtp_sub_flow, mpu_type_packet->mmtp_mpu_type_packet_header.mpu_sequence_number);
+	}
+
+	free(sample_table);
+}
+
+/**
+ * parse an MPU metadata data unit (ftyp/mmpu/moov) and create its tracks. it is copied, as the moof of every
+ * movie fragment is later parsed together with it
+ */
+static int processMpuMetadata(demux_t *p_demux, mmtp_sub_flow_t *mmtp_sub_flow, const uint8_t *p_mpu_metadata, size_t i_mpu_metadata) {
+	mpu_isobmff_fragment_parameters_t *isobmff_parameters = &mmtp_sub_flow->mpu_fragments->mpu_isobmff_fragment_parameters;
+
+	block_t *p_mpu_metadata_block = block_Alloc(i_mpu_metadata);
+	if(!p_mpu_metadata_block)
+		return VLC_ENOMEM;
+	memcpy(p_mpu_metadata_block->p_buffer, p_mpu_metadata, i_mpu_metadata);
+
+	stream_t* tmp_box_stream = vlc_stream_MemoryNew( p_demux, p_mpu_metadata_block->p_buffer, p_mpu_metadata_block->i_buffer, true);
+	MP4_Box_t *p_root = tmp_box_stream ? MP4_BoxGetRoot(tmp_box_stream) : NULL;
+	if(!p_root) {
+		msg_Warn( p_demux, "%d:processMpuMetadata - MPU: MP4_BoxGetRoot returned null", __LINE__);
+		if(tmp_box_stream)
+			vlc_stream_Delete(tmp_box_stream);
+		block_Release(p_mpu_metadata_block);
+		return VLC_EGENERIC;
+	}
+
+	isobmff_parameters->mpu_fragment_block_t = p_mpu_metadata_block;
+	isobmff_parameters->mpu_fragments_p_root_box = p_root;
+	isobmff_parameters->mpu_fragments_p_moov = MP4_BoxGet(p_root, "/moov" );
+
+	__LOG_DEBUG(p_demux, "%d:processMpuMetadata - MP4_BoxGetRoot, p_root: %p", __LINE__, isobmff_parameters->mpu_fragments_p_root_box);
+
+	//dont delete stream fragment here
+	createTracksFromMpuMetadata(p_demux, mmtp_sub_flow);
+	if( isobmff_parameters->i_tracks && isobmff_parameters->track[0].fmt.i_cat == VIDEO_ES ) {
+		__VIDEO_OUTPUT_ES_FORMAT = &isobmff_parameters->track[0].fmt;
+	}
+
+	return VLC_SUCCESS;
+}
+
+/**
+ * undo processMpuMetadata so the next MPU metadata sets the tracks up again. the first track's ES is kept as
+ * the signaled ES, so its decoder is reconfigured rather than torn down
+ */
+static void releaseMpuMetadataTracks(demux_t *p_demux, mpu_isobmff_fragment_parameters_t *isobmff_parameters) {
+	for(unsigned i=0; i < isobmff_parameters->i_tracks; i++) {
+		mp4_track_t *p_track = &isobmff_parameters->track[i];
+		if(p_track->p_es) {
+			if(!isobmff_parameters->p_signaled_es)
+				isobmff_parameters->p_signaled_es = p_track->p_es;
+			else
+				es_out_Del(p_demux->out, p_track->p_es);
+		}
+		if(__VIDEO_OUTPUT_ES_FORMAT == &p_track->fmt)
+			__VIDEO_OUTPUT_ES_FORMAT = NULL;
+		es_format_Clean(&p_track->fmt);
+	}
+	free(isobmff_parameters->track);
+	isobmff_parameters->track = NULL;
+	isobmff_parameters->i_tracks = 0;
+
+	if(isobmff_parameters->mpu_fragments_p_root_box)
+		MP4_BoxFree(isobmff_parameters->mpu_fragments_p_root_box);
+	isobmff_parameters->mpu_fragments_p_root_box = NULL;
+	isobmff_parameters->mpu_fragments_p_moov = NULL;
+
+	if(isobmff_parameters->mpu_fragment_block_t)
+		block_Release(isobmff_parameters->mpu_fragment_block_t);
+	isobmff_parameters->mpu_fragment_block_t = NULL;
+
+	isobmff_parameters->b_mpu_metadata_from_cache = false;
+	isobmff_parameters->b_wait_rap = false;
+}
+
 void processMpuPacket(demux_t* p_obj, mmtp_sub_flow_t *mmtp_sub_flow, mmtp_payload_fragments_union_t* mpu_type_packet) {
 
     mpu_isobmff_fragment_parameters_t *isobmff_parameters = &mmtp_sub_flow->mpu_fragments->mpu_isobmff_fragment_parameters;
@@ -1095,58 +2680,62 @@ void processMpuPacket(demux_t* p_obj, mmtp_sub_flow_t *mmtp_sub_flow, mmtp_paylo
 																			isobmff_parameters->mpu_fragments_p_root_box,
 																			isobmff_parameters->mpu_fragments_p_moov);
 
-		if(mpu_type_packet->mmtp_mpu_type_packet_header.mpu_fragment_type == 0x00 && !isobmff_parameters->mpu_fragments_p_root_box) {
-			__LOG_DEBUG(p_obj, "%d:processMpuPacket - MPU metadata - creating new root_box", __LINE__ );
-
-			//firts, make a copy of the block_t buffer for re-constituion later with movie fragment metadata
-			isobmff_parameters->mpu_fragment_block_t = block_Duplicate(tmp_mpu_fragment);
-
-			stream_t* tmp_box_stream = vlc_stream_MemoryNew( p_obj, isobmff_parameters->mpu_fragment_block_t->p_buffer, isobmff_parameters->mpu_fragment_block_t->i_buffer, true);
-			MP4_Box_t *p_root = MP4_BoxGetRoot(tmp_box_stream);
-		    if(!p_root) {
-		        msg_Warn( p_obj, "%d:processMpuPacket - MPU: MP4_BoxGetRoot returned null", __LINE__);
-		        return;
-		    }
-
-		    isobmff_parameters->mpu_fragments_p_root_box = p_root;
-		    isobmff_parameters->mpu_fragments_p_moov = MP4_BoxGet(p_root, "/moov" );
-
-		    __LOG_DEBUG(p_obj, "%d:processMpuPacket - MP4_BoxGetRoot, p_root: %p", __LINE__, isobmff_parameters->mpu_fragments_p_root_box);
-
-			//remap into p_demux
-
-		    __LOG_DEBUG(p_obj, "%d:processMpuPacket - createTracksFromMpuMetadata, !p_root_box", __LINE__ );
+		if(mpu_type_packet->mmtp_mpu_type_packet_header.mpu_fragment_type == 0x00) {
+			demux_sys_t *p_sys = p_obj->p_sys;
+			const char *psz_scope = mmtp_cache_scope_get(p_sys, isobmff_parameters->mmtp_service);
+			if(p_sys->psz_mpu_metadata_cache_path && psz_scope) {
+				mpu_metadata_cache_put_mpu_metadata(&p_sys->mpu_metadata_cache, psz_scope, mmtp_sub_flow->mmtp_packet_id,
+						tmp_mpu_fragment->p_buffer, tmp_mpu_fragment->i_buffer);
+			}
 
-			createTracksFromMpuMetadata(p_obj, mmtp_sub_flow);
-			if( isobmff_parameters->track[0].fmt.i_cat == VIDEO_ES ) {
-				__VIDEO_OUTPUT_ES_FORMAT = &isobmff_parameters->track[0].fmt;
+			//first live mpu metadata after a tune from the cache: a new MPU starts here, keep the tracks unless the moov changed
+			if(isobmff_parameters->b_mpu_metadata_from_cache) {
+				isobmff_parameters->b_mpu_metadata_from_cache = false;
+				isobmff_parameters->b_wait_rap = false;
+				if(!mpu_metadata_cache_moov_equals(isobmff_parameters->mpu_fragment_block_t->p_buffer, isobmff_parameters->mpu_fragment_block_t->i_buffer,
+						tmp_mpu_fragment->p_buffer, tmp_mpu_fragment->i_buffer)) {
+					msg_Info(p_obj, "%d:processMpuPacket - packet_id: %hu, cached mpu metadata is out of date, rebuilding tracks", __LINE__, mmtp_sub_flow->mmtp_packet_id);
+					releaseMpuMetadataTracks(p_obj, isobmff_parameters);
+				}
 			}
 
-		   //dont delete stream fragment here
-		//	vlc_stream_Delete(tmp_mpu_fragment_stream);
+			if(!isobmff_parameters->mpu_fragments_p_root_box) {
+				__LOG_DEBUG(p_obj, "%d:processMpuPacket - MPU metadata - creating new root_box", __LINE__ );
+				processMpuMetadata(p_obj, mmtp_sub_flow, tmp_mpu_fragment->p_buffer, tmp_mpu_fragment->i_buffer);
+			}
 
 		} else if(mpu_type_packet->mmtp_mpu_type_packet_header.mpu_fragment_type == 0x01) {
 
 			//get our isobmff_parameters->mp4_mpu_metadata_box_s =  vlc_stream_MemoryNew( p_obj, tmp_mpu_fragment->p_buffer, tmp_mpu_fragment->i_buffer, true);
 			//and combine with our movie fragment metadata
-			block_t *first = calloc(1, sizeof(block_t));
-			block_t **reassembled_mpu = &first;
-			block_ChainLastAppend(&reassembled_mpu, block_Duplicate(isobmff_parameters->mpu_fragment_block_t));
-			block_ChainLastAppend(&reassembled_mpu, block_Duplicate(tmp_mpu_fragment));
-			isobmff_parameters->mp4_movie_fragment_block_t = block_ChainGather(first);
+			//the moof tree only lives for this packet: the box tree is read into memory, so the gathered block and stream go right after parsing
+			block_t *p_chain = NULL;
+			block_t **pp_chain_last = &p_chain;
+			if(isobmff_parameters->mpu_fragment_block_t) {
+				block_ChainLastAppend(&pp_chain_last, block_Duplicate(isobmff_parameters->mpu_fragment_block_t));
+			}
+			block_ChainLastAppend(&pp_chain_last, block_Duplicate(tmp_mpu_fragment));
+			block_t *p_movie_fragment_block = block_ChainGather(p_chain);
+			if(!p_movie_fragment_block) {
+				return;
+			}
 #define __REPARSE_MFU 1
 #ifdef __REPARSE_MFU
 
-			stream_t* tmp_box_stream = vlc_stream_MemoryNew( p_obj, isobmff_parameters->mp4_movie_fragment_block_t->p_buffer, isobmff_parameters->mp4_movie_fragment_block_t->i_buffer, true);
-
-			MP4_Box_t *p_moof = MP4_BoxGetRoot(tmp_box_stream);
+			MP4_Box_t *p_moof = NULL;
+			stream_t* tmp_box_stream = vlc_stream_MemoryNew( p_obj, p_movie_fragment_block->p_buffer, p_movie_fragment_block->i_buffer, true);
+			if(tmp_box_stream) {
+				p_moof = MP4_BoxGetRoot(tmp_box_stream);
+				vlc_stream_Delete(tmp_box_stream);
+			}
+			block_Release(p_movie_fragment_block);
 			if(!p_moof) {
 				msg_Warn( p_obj, "%d:processMpuPacket - MovieFragmentMetadata: MP4_BoxGetRoot returned null", __LINE__);
 				return;
 			}
 			isobmff_parameters->mpu_fragments_p_moof =  MP4_BoxGet(p_moof, "/moof");
 
-		    msg_Warn(p_obj, "%d:processMpuPacket - MP4_BoxGetRoot, p_moof: %p ", __LINE__, isobmff_parameters->mpu_fragments_p_moof);
+		    __LOG_DEBUG(p_obj, "%d:processMpuPacket - MP4_BoxGetRoot, p_moof: %p ", __LINE__, isobmff_parameters->mpu_fragments_p_moof);
 
 			//TODO - parsae out
 //			 [traf] size=8+1016
@@ -1164,6 +2753,16 @@ void processMpuPacket(demux_t* p_obj, mmtp_sub_flow_t *mmtp_sub_flow, mmtp_paylo
 					mpu_type_packet->mmtp_mpu_type_packet_header.mpu_fragment_type,
 					isobmff_parameters->mpu_fragments_p_root_box );
 
+			//per-sample size/duration/cts for this MPU, releases any samples that were waiting on it
+			if(isobmff_parameters->mpu_fragments_p_root_box && isobmff_parameters->i_tracks) {
+				mfu_sample_es_out_context_t mfu_sample_es_out_context = { p_obj, &isobmff_parameters->track[0], isobmff_parameters->mmtp_service, mmtp_sub_flow->mmtp_packet_id };
+				processMpuSampleTable(p_obj, mmtp_sub_flow, mpu_type_packet, &mfu_sample_es_out_context);
+			}
+
+			isobmff_parameters->mpu_fragments_p_moof = NULL;
+			MP4_BoxFree(p_moof);
+#else
+			block_Release(p_movie_fragment_block);
 #endif
 		}
 		return;
@@ -1181,347 +2780,55 @@ void processMpuPacket(demux_t* p_obj, mmtp_sub_flow_t *mmtp_sub_flow, mmtp_paylo
 	int i_track = 0;
     mp4_track_t *p_track = &isobmff_parameters->track[i_track];
 
-	//set dummy PCR for now...
-	struct timespec ts;
-	timespec_get(&ts, TIME_UTC);
-
-	uint64_t t = ((ts.tv_sec) * uS) + ((ts.tv_nsec) / 1000ULL) ; // convert tv_sec & tv_usec to millisecond
+	//pcr comes from the recovered sender clock in Demux, or per sample in low latency mode
 	demux_sys_t *p_sys_priv = p_obj->p_sys;
-	if(!p_sys_priv->has_set_first_pcr) {
-		p_sys_priv->first_pcr = t;
-	}
-	//uint64_t new_pcr = t - p_sys_priv->first_pcr;
-	uint64_t pcr_buf = 4000000; //250000
-	//msg_Info(p_obj, "%d:mpu pts is: %llu", __LINE__, mpu_type_packet->mpu_data_unit_payload_fragments_timed.pts);
-
-	//
-	uint64_t new_pcr = mpu_type_packet->mpu_data_unit_payload_fragments_timed.pts > pcr_buf ? mpu_type_packet->mpu_data_unit_payload_fragments_timed.pts - pcr_buf : mpu_type_packet->mpu_data_unit_payload_fragments_timed.pts;
-
-	//convert to microseconds
-//	es_out_SetPCR( p_obj->out, new_pcr);
 
-//	msg_Info(p_obj, "%d:es_out_setPcr, compairing from new: %	llu, to last: %llu", new_pcr, mpu_type_packet->mpu_data_unit_payload_fragments_timed.last_pt);
-
-
-	if(!p_sys_priv->has_set_first_pcr && new_pcr > mpu_type_packet->mpu_data_unit_payload_fragments_timed.last_pts ) {
-	//	msg_Info(p_obj, "%d:es_out_setPcr - using PTS-buf: %llu", __LINE__, new_pcr);
-
-		es_out_SetPCR(p_obj->out, new_pcr);
-		p_sys_priv->has_set_first_pcr = 1;
-
-	// 	mpu_type_packet->mpu_data_unit_payload_fragments_timed.last_pts = new_pcr;
-	}
-
-	//es_out_SetPCR(p_obj->out, mpu_type_packet->mpu_data_unit_payload_fragments_timed.pts);
-
-	//allow for single audio fragment push
-	if( isobmff_parameters->track[i_track].fmt.i_cat == AUDIO_ES ) {
-		if(mpu_type_packet->mmtp_mpu_type_packet_header.mpu_fragmentation_indicator == 0x00) {
-			tmp_mpu_fragment->i_length = 21333;
-
-			//audio samples should be at
-			//entry 0000 = sample_duration:21333, sample_size:512, sample_flags:2000000, sample_composition_time_offset:0
-			//entry 0001 = sample_duration:21333, sample_size:513, sample_flags:10000, sample_composition_time_offset:0
-
-			if(mpu_type_packet->mpu_data_unit_payload_fragments_timed.pts) {
-				msg_Info(p_obj, "%d: setting tmp_mpu_fragment.pts = %llu, pcr: %llu, last_pts: %llu", __LINE__, mpu_type_packet->mpu_data_unit_payload_fragments_timed.pts, new_pcr, p_sys_priv->last_pts);
-				tmp_mpu_fragment->i_pts = mpu_type_packet->mpu_data_unit_payload_fragments_timed.pts;
-			}
-
-			es_out_Send( p_obj->out, p_track->p_es, tmp_mpu_fragment);
-
-			if(mpu_type_packet->mpu_data_unit_payload_fragments_timed.pts) {
-				p_sys_priv->last_pts = mpu_type_packet->mpu_data_unit_payload_fragments_timed.pts;
+	//emit each access unit as soon as all of its fragments are in, timing comes from the moof trun
+	if(mpu_type_packet->mmtp_mpu_type_packet_header.mpu_fragment_type == 0x02 && mpu_type_packet->mmtp_mpu_type_packet_header.mpu_timed_flag) {
+		//samples ahead of the first random access point after a tune from the cache are of no use to the decoder
+		if(isobmff_parameters->b_wait_rap) {
+			if(!mpu_type_packet->mmtp_mpu_type_packet_header.mmtp_rap_flag) {
+				__LOG_TRACE(p_obj, "%d:processMpuPacket - packet_id: %hu, waiting for a random access point, dropping MFU", __LINE__, mmtp_sub_flow->mmtp_packet_id);
+				return;
 			}
-
-		} else {
-			msg_Err(p_obj, "%d:process_packet - dropping fragmented audio!", __LINE__);
-		}
-	}
-
-#ifdef __SINGLE_MFU_PUSH
-	if(mpu_type_packet->mmtp_mpu_type_packet_header.mpu_fragmentation_indicator == 0x00) {
-		//TODO - use traf/tfdt for actual sample decoding time based upon mvhd.timescale (p_sys->i_timescale)
-		//for now, use the rational 1001 * uS / 60000 * uS ~ 16000us
-
-		if(mpu_type_packet->mpu_data_unit_payload_fragments_timed.pts) {
-			msg_Info(p_obj, "%d: setting tmp_mpu_fragment.pts = %llu, pcr: %llu, last_pts: %llu", __LINE__, mpu_type_packet->mpu_data_unit_payload_fragments_timed.pts, new_pcr, p_sys_priv->last_pts);
-			tmp_mpu_fragment->i_pts = mpu_type_packet->mpu_data_unit_payload_fragments_timed.pts;
-		}
-
-		if( isobmff_parameters->track[i_track].fmt.i_cat == VIDEO_ES ) {
-			tmp_mpu_fragment->i_length = 16683; //1001 * uS / 60000 * uS;
-
-		    //  entry 0000 = sample_duration:16683, sample_size:89965, sample_flags:2000000, sample_composition_time_offset:50050
-		} else {
-			//audio samples should be at
-			//entry 0000 = sample_duration:21333, sample_size:512, sample_flags:2000000, sample_composition_time_offset:0
-			//entry 0001 = sample_duration:21333, sample_size:513, sample_flags:10000, sample_composition_time_offset:0
-			tmp_mpu_fragment->i_length = 21333;
-
-		}
-
-		// p_track->p_es,
-		//isobmff_parameters->mpu_fragments_p_root_box,
-		//block_ChainLastAppend(&reassembled_mpu_final, tmp_mpu_fragment);
-	//	es_out_Send( p_obj->out, p_track->p_es, tmp_mpu_fragment);
-		
-		if(mpu_type_packet->mpu_data_unit_payload_fragments_timed.pts) {
-			p_sys_priv->last_pts = mpu_type_packet->mpu_data_unit_payload_fragments_timed.pts;
+			isobmff_parameters->b_wait_rap = false;
 		}
 
-		__LOG_MPU_REASSEMBLY(p_obj, "%d:SENDING SINGLE:      track: %d, mmtp_packet_id: %u, mpu_sequence_number: %u, size: %d, pts: %llu, sample: %u, offset: %u, mpu_fragment_type: %hu, mpu_fragmentation_indication: %u, tmp_mpu_fragment: %p",
-				__LINE__,
-				p_track->i_track_ID,
-				mpu_type_packet->mmtp_mpu_type_packet_header.mmtp_packet_id,
-				mpu_type_packet->mmtp_mpu_type_packet_header.mpu_sequence_number,
-
-				tmp_mpu_fragment->i_buffer, t/1000000,
-				mpu_type_packet->mpu_data_unit_payload_fragments_timed.sample_number,
-				mpu_type_packet->mpu_data_unit_payload_fragments_timed.offset,
-				mpu_type_packet->mmtp_mpu_type_packet_header.mpu_fragment_type,
-				mpu_type_packet->mmtp_mpu_type_packet_header.mpu_fragmentation_indicator,
-				(void*) tmp_mpu_fragment);
-	}
-
-#endif
-
-	if(mpu_type_packet->mmtp_mpu_type_packet_header.mpu_fragmentation_indicator == 0x01 || mpu_type_packet->mmtp_mpu_type_packet_header.mpu_fragmentation_indicator == 0x02) {
+		mfu_sample_emitter_t* mfu_sample_emitter = &isobmff_parameters->mfu_sample_emitter;
+		mfu_sample_es_out_context_t mfu_sample_es_out_context = { p_obj, p_track, isobmff_parameters->mmtp_service, mmtp_sub_flow->mmtp_packet_id };
+		mfu_sample_emitter_set_low_latency(mfu_sample_emitter, p_sys_priv->b_low_latency);
+		mfu_sample_emitter_set_emit_partial_samples(mfu_sample_emitter, p_sys_priv->b_emit_corrupt_samples);
 
-		//we should already be pushed into
-		//mpu_type_packet->mmtp_mpu_type_packet_header.mmtp_sub_flow->mpu_fragments
-		//pull from mmtp_sub_flow accessors
-		//	block_ChainAppend(&mmtp_sub_flow->p_mpu_block, block_Duplicate(tmp_mpu_fragment));
-
-	}
+		__LOG_MPU_REASSEMBLY(p_obj, "%d; track: %d, mmtp_packet_id: %u, mpu_sequence_number: %u, sample: %u, offset: %u, mpu_fragmentation_indication: %u, mpu_fragmentation_counter: %u, payload size: %d",
+					__LINE__,
+					p_track->i_track_ID,
+					mpu_type_packet->mmtp_mpu_type_packet_header.mmtp_packet_id,
+					mpu_type_packet->mmtp_mpu_type_packet_header.mpu_sequence_number,
+					mpu_type_packet->mpu_data_unit_payload_fragments_timed.sample_number,
+					mpu_type_packet->mpu_data_unit_payload_fragments_timed.offset,
+					mpu_type_packet->mmtp_mpu_type_packet_header.mpu_fragmentation_indicator,
+					mpu_type_packet->mmtp_mpu_type_packet_header.mpu_fragmentation_counter,
+					tmp_mpu_fragment->i_buffer);
 
-	__LOG_MPU_REASSEMBLY(p_obj, "%d; track: %d, mmtp_packet_id: %u, mpu_sequence_number: %u, sample: %u, offset: %u, mpu_fragment_type: %u, mpu_fragmentation_indication: %u, payload size: %d",
-				__LINE__,
-				p_track->i_track_ID,
-				mpu_type_packet->mmtp_mpu_type_packet_header.mmtp_packet_id,
+		mfu_sample_emitter_push(mfu_sample_emitter,
 				mpu_type_packet->mmtp_mpu_type_packet_header.mpu_sequence_number,
 				mpu_type_packet->mpu_data_unit_payload_fragments_timed.sample_number,
-				mpu_type_packet->mpu_data_unit_payload_fragments_timed.offset,
-				mpu_type_packet->mmtp_mpu_type_packet_header.mpu_fragment_type,
 				mpu_type_packet->mmtp_mpu_type_packet_header.mpu_fragmentation_indicator,
-				mpu_type_packet->mpu_data_unit_payload_fragments_timed.mpu_data_unit_payload->i_buffer);
-
-	//assume mpu_fragmentation_indicator == 0x03 is robust our signal to push to the decoder
-	//and few if any out-of-order fragments will show up
-	if(mpu_type_packet->mpu_data_unit_payload_fragments_timed.sample_number == 60 &&
-			(mpu_type_packet->mmtp_mpu_type_packet_header.mpu_fragmentation_indicator == 0x03 || mpu_type_packet->mmtp_mpu_type_packet_header.mpu_fragmentation_indicator == 0x00)) {
-
-		//combine with mmtp_sub_flow->mpu_fragments->media_fragment_unit_vector mpu_data_unit_payload_fragments_vector_t
-		//where mpu_sequence_number == mpu_type_packet->mmtp_mpu_type_packet_header.mpu_sequence_number
-
-		//raise(SIGABRT);
-
-		mmtp_sub_flow_t* packet_subflow = mpu_type_packet->mmtp_packet_header.mmtp_sub_flow;
-		__LOG_MPU_REASSEMBLY(p_obj, "%d:processMpuPacket - reassemble", __LINE__);
-
-		mpu_data_unit_payload_fragments_t *data_unit_payload_types = mpu_data_unit_payload_fragments_find_mpu_sequence_number(&packet_subflow->mpu_fragments->media_fragment_unit_vector, mpu_type_packet->mmtp_mpu_type_packet_header.mpu_sequence_number);
-		if(!data_unit_payload_types) {
-			msg_Warn(p_obj, "%d:processMpuPacket - reassemble - data_unit_payload_types is null, returning", __LINE__);
-
-			return;
-		}
-
-		mpu_data_unit_payload_fragments_timed_vector_t *data_unit_payload_fragments = &data_unit_payload_types->timed_fragments_vector;
-		//todo - vectorize and add in mpu_sequence_number
-		int total_fragments = data_unit_payload_fragments->size;
-		__LOG_MPU_REASSEMBLY(p_obj, "%d:processMpuPacket - total_fragments: %d", __LINE__, total_fragments);
-
-		int pre_alloc_size = total_fragments * UPPER_BOUND_MPU_FRAGMENT_SIZE;
-		if( pre_alloc_size > MPU_REASSEMBLE_MAX_BUFFER) {
-			msg_Warn(p_obj, "%d:processMpuPacket - estimated pre_alloc_size of: %d (fragment count: #d) is greater than %d, truncating", __LINE__, pre_alloc_size, total_fragments, MPU_REASSEMBLE_MAX_BUFFER);
-			total_fragments = __MIN(total_fragments, (MPU_REASSEMBLE_MAX_BUFFER / UPPER_BOUND_MPU_FRAGMENT_SIZE));
-		}
-
-		__LOG_MPU_REASSEMBLY(p_obj, "%d:processMpuPacket - reassembly, total size before filtering is: %d", __LINE__, total_fragments);
-
-		//todo - add in HRBD support for how large of a buffer we should keep around
-		//each packet
-		//todo - sort by fragmentation counter DESC
-		block_t *first = calloc(1, sizeof(block_t));
-		block_t **reassembled_mpu = &first;
-		int first_fragment_counter = -1;
-		int last_fragment_counter = -1;
-		int started_with_first_fragment_of_du = 0;
-		int ended_with_last_fragment_of_du = 0;
-		int total_sample_count = 0;
-
-		for(int i=0; i < total_fragments; i++) {
-			mmtp_payload_fragments_union_t* packet = data_unit_payload_fragments->data[i];
-
-			//only pass thru MFU fragment types for re-assembly, mpu metadat and movie fragment metadata will be prepended later
-			if(packet->mpu_data_unit_payload_fragments_timed.mpu_fragment_type == 0x02) { // && packet->mpu_data_unit_payload_fragments_timed.mpu_fragmentation_indicator != 0x00)  {
-				__LOG_MPU_REASSEMBLY(p_obj, "%d:processMpuPacket:reassembly - appending, mpu_sequence_number: %d, mpu_fragment_type:%d, mpu_fragmentation_indicator: %d, sample_number: %d, fragment_counter: %d, offset: %d, payload size: %d (%p)",
-									__LINE__,
-									packet->mpu_data_unit_payload_fragments_timed.mpu_sequence_number,
-									packet->mpu_data_unit_payload_fragments_timed.mpu_fragment_type,
-									packet->mpu_data_unit_payload_fragments_timed.mpu_fragmentation_indicator,
-									packet->mpu_data_unit_payload_fragments_timed.sample_number,
-									packet->mpu_data_unit_payload_fragments_timed.mpu_fragmentation_counter,
-									packet->mpu_data_unit_payload_fragments_timed.offset,
-									packet->mpu_data_unit_payload_fragments_timed.mpu_data_unit_payload->i_buffer,
-									packet->mpu_data_unit_payload_fragments_timed.mpu_data_unit_payload);
-
-				block_ChainLastAppend(&reassembled_mpu, packet->mpu_data_unit_payload_fragments_timed.mpu_data_unit_payload);
-
-				//capture some aggregate metrics here
-				if(first_fragment_counter == -1) {
-					first_fragment_counter = packet->mpu_data_unit_payload_fragments_timed.mpu_fragmentation_counter;
-					started_with_first_fragment_of_du = (packet->mpu_data_unit_payload_fragments_timed.mpu_fragmentation_indicator == 0x01);
-				}
-				last_fragment_counter = packet->mpu_data_unit_payload_fragments_timed.mpu_fragmentation_counter;
-				ended_with_last_fragment_of_du = (packet->mpu_data_unit_payload_fragments_timed.mpu_fragmentation_indicator == 0x03);
-				total_sample_count++;
-
-			} else {
-				__LOG_MPU_REASSEMBLY(p_obj, "%d:processMpuPacket:reassembly - omitting,  mpu_sequence_number: %d, mpu_fragment_type:%d, mpu_fragmentation_indicator: %d, sample_number: %d, fragment_counter: %d, payload size: %d (%p)",
-									__LINE__,
-									packet->mpu_data_unit_payload_fragments_timed.mpu_sequence_number,
-									packet->mpu_data_unit_payload_fragments_timed.mpu_fragment_type,
-									packet->mpu_data_unit_payload_fragments_timed.mpu_fragmentation_indicator,
-									packet->mpu_data_unit_payload_fragments_timed.sample_number,
-									packet->mpu_data_unit_payload_fragments_timed.mpu_fragmentation_counter,
-									packet->mpu_data_unit_payload_fragments_timed.offset,
-									packet->mpu_data_unit_payload_fragments_timed.mpu_data_unit_payload->i_buffer,
-									packet->mpu_data_unit_payload_fragments_timed.mpu_data_unit_payload);
-			}
-		}
-
-
-
-		//borrowed from es.c
-
-		block_t *p_block_out = first;
-
-
-		while( p_block_out )
-		{
-			block_t *p_next = p_block_out->p_next;
-
-			/* Correct timestamp */
-//			if( p_sys->p_packetizer->fmt_out.i_cat == VIDEO_ES )
-//			{
-//				if( p_block_out->i_pts == VLC_TICK_INVALID &&
-//					p_block_out->i_dts == VLC_TICK_INVALID )
-//					p_block_out->i_dts = VLC_TICK_0 + p_sys->i_pts + VLC_TICK_FROM_SEC(1) / p_sys->f_fps;
-//				if( p_block_out->i_dts != VLC_TICK_INVALID )
-//					p_sys->i_pts = p_block_out->i_dts - VLC_TICK_0;
-//			}
-//			else
-//			{
-//				p_sys->i_pts = p_block_out->i_pts - VLC_TICK_0;
-//			}
-//
-//			if( p_block_out->i_pts != VLC_TICK_INVALID )
-//			{
-//				p_block_out->i_pts += p_sys->i_time_offset;
-//			}
-//			if( p_block_out->i_dts != VLC_TICK_INVALID )
-//			{
-//				p_block_out->i_dts += p_sys->i_time_offset;
-//				es_out_SetPCR( p_demux->out, p_block_out->i_dts );
-//			}
-			/* Re-estimate bitrate */
-//			if( p_sys->b_estimate_bitrate && p_sys->i_pts > VLC_TICK_FROM_MS(500) )
-//				p_sys->i_bitrate_avg = 8 * CLOCK_FREQ * p_sys->i_bytes
-//									   / (p_sys->i_pts - 1);
-//			p_sys->i_bytes += p_block_out->i_buffer;
-
-			block_t* p_block_es_out = block_Duplicate(p_block_out);
-			p_block_es_out->p_next = NULL;
-
-			__LOG_INFO(p_obj, "%d:es_out_send with block: pts: %llu, length: %llu, size: %d", __LINE__, p_block_es_out->i_pts, p_block_es_out->i_length, p_block_es_out->i_buffer);
-			es_out_Send( p_obj->out, p_track->p_es, p_block_es_out);
-//			es_out_Send( p_demux->out, p_sys->p_es, p_block_out );
-
-//			if(mpu_type_packet->mpu_data_unit_payload_fragments_timed.pts) {
-//				msg_Info(p_obj, "%d: setting tmp_mpu_fragment.pts = %llu, pcr: %llu, last_pts: %llu", __LINE__, mpu_type_packet->mpu_data_unit_payload_fragments_timed.pts, new_pcr, p_sys_priv->last_pts);
-//
-//				//reassembled_mpu_final->i_pts = mpu_type_packet->mpu_data_unit_payload_fragments_timed.pts;
-//			}
-			//reassembled_mpu_final->i_length = 16683 * 60; //1001 * uS / 60000 * uS;
-
-			p_block_out = p_next;
-		}
-
-
-
-
-
-
-
-
-
-		//todo, re-sequence these by fragmentation_counter DESC,
-		block_t* reassembled_mpu_final = block_ChainGather(block_Duplicate(first));
-
-		char myFilePathName[128];
-		snprintf(myFilePathName, 128, "mmtp.packetid.%d.mpu_sequence_number.%d.mpu_sample_number%d", mpu_type_packet->mmtp_mpu_type_packet_header.mmtp_packet_id,
-				mpu_type_packet->mmtp_mpu_type_packet_header.mpu_sequence_number,			mpu_type_packet->mpu_data_unit_payload_fragments_timed.sample_number);
-
-		//concat wtih header box...
-		FILE *f = fopen(myFilePathName, "w");
-		if(!f) {
-			msg_Err(p_obj, "::dumpMpu ******* UNABLE TO OPEN FILE %s", myFilePathName);
-			return;
-		}
-
-		for(int i=0; i < isobmff_parameters->mp4_movie_fragment_block_t->i_buffer; i++) {
-			fputc(isobmff_parameters->mp4_movie_fragment_block_t->p_buffer[i], f);
-		}
-
-		for(int i=0; i < reassembled_mpu_final->i_buffer; i++) {
-			fputc(reassembled_mpu_final->p_buffer[i], f);
-		}
-		fclose(f);
-
-	//	block_t* reassembled_mpu_final = first;
-	//	block_ChainLastAppend(&reassembled_mpu_final, reassembled_mpu);
-
-		int samples_missing =  first_fragment_counter - last_fragment_counter - total_sample_count + 1;
-
-		msg_Info(p_obj, "%d:REASSEMBLE METRICS: samples present count: %d, starting w/ first fragment: %c, start fragment #: %d, ending w/ last fragment: %c, end fragment #: %d, missing: %d",
-					__LINE__,
-					total_sample_count,
-					started_with_first_fragment_of_du ? 'T':'F', first_fragment_counter,
-					ended_with_last_fragment_of_du ? 'T' : 'F', last_fragment_counter,
-					samples_missing);
-
-//		if(!started_with_first_fragment_of_du || !ended_with_last_fragment_of_du || samples_missing > 5) {
-//			reassembled_mpu_final->i_flags |= BLOCK_FLAG_CORRUPTED;
-//		} else {
-//			reassembled_mpu_final->i_flags &= ~BLOCK_FLAG_CORRUPTED;
-//		}
-
-
-		msg_Info(p_obj, "%d:SENDING REASSEMBLED: track: %d, mmtp_packet_id: %u, mpu_sequence_number: %u, size: %d, pts: %llu, sample: %u, offset: %u, mpu_fragment_type: %hu, mpu_fragmentation_indication: %u, tmp_mpu_fragment: %p",
-			__LINE__,
-			p_track->i_track_ID,
-
-			mpu_type_packet->mmtp_mpu_type_packet_header.mmtp_packet_id,
-			mpu_type_packet->mmtp_mpu_type_packet_header.mpu_sequence_number,
-
-			reassembled_mpu_final->i_buffer,
-			reassembled_mpu_final->i_pts,
-			mpu_type_packet->mpu_data_unit_payload_fragments_timed.sample_number,
-			mpu_type_packet->mpu_data_unit_payload_fragments_timed.offset,
-			mpu_type_packet->mmtp_mpu_type_packet_header.mpu_fragment_type,
-			mpu_type_packet->mmtp_mpu_type_packet_header.mpu_fragmentation_indicator,
-			(void*) reassembled_mpu_final);
-
-
+				mpu_type_packet->mmtp_mpu_type_packet_header.mpu_fragmentation_counter,
+				tmp_mpu_fragment->p_buffer, tmp_mpu_fragment->i_buffer,
+				mpu_type_packet->mpu_data_unit_payload_fragments_timed.pts,
+				mfu_sample_es_out_send, &mfu_sample_es_out_context);
 
 		if(mpu_type_packet->mpu_data_unit_payload_fragments_timed.pts) {
 			p_sys_priv->last_pts = mpu_type_packet->mpu_data_unit_payload_fragments_timed.pts;
 		}
 
-		block_Release(reassembled_mpu_final);
-
-		vlc_vector_clear(data_unit_payload_fragments);
+		if(mfu_sample_emitter_is_mpu_complete(mfu_sample_emitter)) {
+			mmtp_flow_stats_mpu_complete(&mmtp_sub_flow->flow_stats, mpu_type_packet->mmtp_mpu_type_packet_header.mpu_sequence_number, vlc_tick_now());
+			//fragments stay in the store until their ring slot is reused or the byte ceiling is hit
+			mmtp_fragment_store_mpu_complete(mmtp_sub_flow, mpu_type_packet->mmtp_mpu_type_packet_header.mpu_sequence_number);
+			mmtp_fragment_store_mpu_emitted(mmtp_sub_flow, mpu_type_packet->mmtp_mpu_type_packet_header.mpu_sequence_number);
+		}
 	}
 
 	__LOG_TRACE(p_obj, "%d:processMpuPacket - return - mpu_fragment_type=0x%x, p_root_box: %p", __LINE__,
@@ -2112,7 +3419,7 @@ static void TrackGetESSampleRate( demux_t *p_demux, mpu_isobmff_fragment_paramet
  * TrackCreateES:
  * Create ES and PES to init decoder if needed, for a track starting at i_chunk
  */
-static int TrackCreateES( demux_t *p_demux, mmtp_sub_flow_t* mmtp_sub_flow, mp4_track_t *p_track,
+static int TrackCreateES( demux_t *p_demux, mpu_isobmff_fragment_parameters_t* isobmff_parameters, mp4_track_t *p_track,
                           unsigned int i_chunk, es_out_id_t **pp_es )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
@@ -2170,7 +3477,7 @@ static int TrackCreateES( demux_t *p_demux, mmtp_sub_flow_t* mmtp_sub_flow, mp4_
 			}
 
 			/* Set frame rate */
-			TrackGetESSampleRate( p_demux, mmtp_sub_flow,
+			TrackGetESSampleRate( p_demux, isobmff_parameters,
 								  &p_track->fmt.video.i_frame_rate,
 								  &p_track->fmt.video.i_frame_rate_base,
 								  p_track, i_sample_description_index, i_chunk );
@@ -2223,9 +3530,28 @@ static int TrackCreateES( demux_t *p_demux, mmtp_sub_flow_t* mmtp_sub_flow, mp4_
 			break;
     }
 
-    if( pp_es ) {
+    //mmtp-ip-input: every service is its own program
+    mmtp_service_t *mmtp_service = isobmff_parameters->mmtp_service;
+    if( mmtp_service )
+        p_track->fmt.i_group = mmtp_service->i_group;
+
+    //the ES added from the MPT asset_type only needs its format filled in
+    es_out_id_t *p_signaled_es = NULL;
+    if( pp_es )
+    {
+        p_signaled_es = isobmff_parameters->p_signaled_es;
+        isobmff_parameters->p_signaled_es = NULL;
+    }
+    if( p_signaled_es &&
+        es_out_Control( p_demux->out, ES_OUT_SET_ES_FMT, p_signaled_es, &p_track->fmt ) == VLC_SUCCESS )
+    {
+        *pp_es = p_signaled_es;
+    }
+    else if( pp_es ) {
         __LOG_INFO(p_demux, "%d:TrackCreateES - pp_es is: %p",__LINE__, pp_es);
 
+        if( p_signaled_es )
+            es_out_Del( p_demux->out, p_signaled_es );
         *pp_es = MP4_AddTrackES( p_demux->out, p_track );
     } else {
         __LOG_INFO(p_demux, "%d:TrackCreateES - pp_es is null",__LINE__);
@@ -72,6 +72,7 @@ sudo route -nv add -net 224.0.0.0/4 -interface vnic1
 
 /** cascasde libmp4 headers here ***/
 #include "mp4.h"
+#include "atsc3_mmtp_mpu_reassembly.h"
 
 #include <vlc_demux.h>
 #include <vlc_charset.h>                           /* EnsureUTF8 */
@@ -192,9 +193,9 @@ typedef struct
 {
 	vlc_object_t *obj;
 
-	//reconsititue mfu's into a p_out_muxed fifo
+	//reconsititue mfu's into a p_out_muxed fifo, gathered once per mpu
 
-	block_t *p_mpu_block;
+	mpu_reassembly_buffer_t mpu_reassembly_buffer;
 
 	//everthing below here is from libmp4
 
@@ -605,7 +606,7 @@ static int Open( vlc_object_t * p_this )
 
     p_sys->obj = p_this;
     p_sys->context.i_lastseqnumber = UINT32_MAX;
-    p_sys->p_mpu_block = NULL;
+    mpu_reassembly_buffer_init(&p_sys->mpu_reassembly_buffer);
 //    p_sys->b_seekable = true;
 //    p_sys->b_fragmented = true;
 
@@ -1019,6 +1020,8 @@ static void Close( vlc_object_t *p_this )
 
     vlc_sem_destroy(&p_sys->demux_frag_new_data_semaphore);
 
+    mpu_reassembly_buffer_free(&p_sys->mpu_reassembly_buffer);
+
     if(p_sys) {
     	free(p_sys);
     }
@@ -1493,8 +1496,8 @@ void processMpuPacket(demux_t* p_demux, uint16_t mmtp_packet_id, uint32_t mpu_se
 
 	//mpu_sequence_number
 
-	msg_Info(p_demux, "processMpuPacket - mmtp_packet_id: %hu, mpu_sequence_number: %u, sample: %u (__MFU_COUNTER: %d), offset: %u, mpu_fragment_type: %hu, mpu_fragmentation_indication: %u, tmp_mpu_fragment: %p, p_mpu_block is: %p",
-											mmtp_packet_id, mpu_sequence_number, mpu_sample_number, __MFU_COUNTER, mpu_offset, mpu_fragment_type, mpu_fragmentation_indicator, (void*) tmp_mpu_fragment, (void*)p_sys->p_mpu_block);
+	msg_Info(p_demux, "processMpuPacket - mmtp_packet_id: %hu, mpu_sequence_number: %u, sample: %u (__MFU_COUNTER: %d), offset: %u, mpu_fragment_type: %hu, mpu_fragmentation_indication: %u, tmp_mpu_fragment: %p, pending mpu size is: %zu",
+											mmtp_packet_id, mpu_sequence_number, mpu_sample_number, __MFU_COUNTER, mpu_offset, mpu_fragment_type, mpu_fragmentation_indicator, (void*) tmp_mpu_fragment, p_sys->mpu_reassembly_buffer.size);
 
 	//only flush out and process the MPU if our sequence number has incremented
 	//TODO - check mmpu box for is_complete for mpu_sequence_number, use or conditional as mpu_seuqence_number is uint32...
@@ -1505,9 +1508,17 @@ void processMpuPacket(demux_t* p_demux, uint16_t mmtp_packet_id, uint32_t mpu_se
 		//flush out our pending p_mpu block
 		//contains full ftyp, moov, etc...
 
-		if(p_sys->p_mpu_block && p_sys->p_mpu_block->i_buffer > 0) {
-			msg_Info(p_demux, "processMpuPacket ******* FINALIZING MFU ******** to ISOBMFF - last_mpu_sequence_number: %hu, mpu_sequence_number: %hu, pending p_mpu_block is: %zu", p_sys->last_mpu_sequence_number, mpu_sequence_number, p_sys->p_mpu_block->i_buffer);
-			block_t* mpu = block_ChainGather(p_sys->p_mpu_block);
+		size_t mpu_len = 0;
+		uint8_t* mpu_data = mpu_reassembly_buffer_detach(&p_sys->mpu_reassembly_buffer, &mpu_len);
+
+		if(mpu_data) {
+			msg_Info(p_demux, "processMpuPacket ******* FINALIZING MFU ******** to ISOBMFF - last_mpu_sequence_number: %hu, mpu_sequence_number: %hu, pending mpu size is: %zu", p_sys->last_mpu_sequence_number, mpu_sequence_number, mpu_len);
+
+			//hand the reassembled bytes to a block_t without another copy
+			block_t* mpu = block_heap_Alloc(mpu_data, mpu_len);
+			if(!mpu) {
+				return;
+			}
 			block_FifoPut(p_sys->s_frag_next, block_Duplicate(mpu));
 
 		//	msg_Info(p_demux, "processMpuPacket ********** FINALIZING MFU ********** mpu block i_buffer is: %zu length\nfirst 32 bits are: 0x%x 0x%x 0x%x 0x%x\nnext  32 bits are: 0x%x 0x%x 0x%x 0x%x",mpu->i_buffer, mpu->p_buffer[0], mpu->p_buffer[1], mpu->p_buffer[2], mpu->p_buffer[3], mpu->p_buffer[4], mpu->p_buffer[5], mpu->p_buffer[6], mpu->p_buffer[7]);
@@ -1527,28 +1538,24 @@ void processMpuPacket(demux_t* p_demux, uint16_t mmtp_packet_id, uint32_t mpu_se
 				//signal the demux_frag for isobmff processing
 				vlc_sem_post(&p_sys->demux_frag_new_data_semaphore);
 
-				//released in block_chainGather - block_Release(p_sys->p_mpu_block);
-
+				block_Release(mpu);
 			}
 
-			p_sys->p_mpu_block = NULL;
 		//	block_Release(mpu);
 		//	msg_Info(p_demux, "processMpuPacket ******* FINALIZING MFU ******** block_Release complete");
 
 		} else {
-			if(p_sys->p_mpu_block) {
-				msg_Warn(p_demux, "processMpuPacket - sequence number change, but p_sys->p_mpu_block->i_buffer is 0, last_mpu_sequence_number: %u, mpu_sequence_number: %u, pending p_mpu_block is: %zu", p_sys->last_mpu_sequence_number, mpu_sequence_number, p_sys->p_mpu_block->i_buffer);
-			} else {
-				msg_Warn(p_demux, "processMpuPacket - sequence number change, but p_sys->p_mpu_block is not allocated, last_mpu_sequence_number: %u, mpu_sequence_number: %u", p_sys->last_mpu_sequence_number, mpu_sequence_number);
-			}
+			msg_Warn(p_demux, "processMpuPacket - sequence number change, but no pending mpu data, last_mpu_sequence_number: %u, mpu_sequence_number: %u", p_sys->last_mpu_sequence_number, mpu_sequence_number);
 		}
 
+		//size from the previous mpu, the mpu metadata doesn't carry an mpu byte length
+		mpu_reassembly_buffer_begin(&p_sys->mpu_reassembly_buffer, mmtp_packet_id, mpu_sequence_number, 0);
+
 		p_sys->last_mpu_sequence_number = mpu_sequence_number;
 	}
 
 	if(tmp_mpu_fragment) {
 
-//		msg_Info(p_demux, "processMpuPacket - before p_mpu_block with mpu_sequence_number: %hu, mpu_sample_number: %hu, mpu_fragment_type: %d, mpu_fragmentation_indicatior: %d, p_mpu_block is: %p,", mpu_sequence_number, mpu_sample_number, mpu_fragment_type, mpu_fragmentation_indicator, (void*)p_sys->p_mpu_block);
 		dumpMfu(p_demux, tmp_mpu_fragment);
 
 		if(false && mpu_fragment_type == 0x00) {
@@ -1556,8 +1563,7 @@ void processMpuPacket(demux_t* p_demux, uint16_t mmtp_packet_id, uint32_t mpu_se
 				//only send the ftyp off at init
 				msg_Warn(p_demux, "processMpuPacket - APPENDING FTYPE for mpu_sequence_number: %u", mpu_sequence_number);
 
-				block_ChainAppend(&p_sys->p_mpu_block, block_Duplicate(tmp_mpu_fragment));
-				p_sys->p_mpu_block = block_ChainGather(p_sys->p_mpu_block);
+				mpu_reassembly_buffer_append(&p_sys->mpu_reassembly_buffer, tmp_mpu_fragment->p_buffer, tmp_mpu_fragment->i_buffer);
 
 			} else {
 
@@ -1566,12 +1572,14 @@ void processMpuPacket(demux_t* p_demux, uint16_t mmtp_packet_id, uint32_t mpu_se
 			}
 
 		} else {
-			block_ChainAppend(&p_sys->p_mpu_block, block_Duplicate(tmp_mpu_fragment));
-			p_sys->p_mpu_block = block_ChainGather(p_sys->p_mpu_block);
+			//linear append, the mpu is only gathered once when the sequence number rolls
+			if(!mpu_reassembly_buffer_matches(&p_sys->mpu_reassembly_buffer, mmtp_packet_id, mpu_sequence_number)) {
+				msg_Warn(p_demux, "processMpuPacket - mmtp_packet_id: %hu, mpu_sequence_number: %u is not the pending mpu, dropping fragment", mmtp_packet_id, mpu_sequence_number);
+			} else if(mpu_reassembly_buffer_append(&p_sys->mpu_reassembly_buffer, tmp_mpu_fragment->p_buffer, tmp_mpu_fragment->i_buffer)) {
+				msg_Warn(p_demux, "processMpuPacket - mpu_sequence_number: %u exceeds reassembly limit, dropping fragment", mpu_sequence_number);
+			}
 		}
 
-//		msg_Info(p_demux, "processMpuPacket - NEW p_mpu_block with mpu_sample_number: %hu, mpu_fragment_type: %d, mpu_fragmentation_indicatior: %d, p_mpu_block is: %p, size is now: %d", mpu_sample_number, mpu_fragment_type, mpu_fragmentation_indicator, (void*)p_sys->p_mpu_block, p_sys->p_mpu_block->i_buffer );
-
 		p_sys->last_mpu_fragment_type = mpu_fragment_type;
 	}
 }
@@ -0,0 +1,257 @@
+/*****************************************************************************
+ * mmtp_pcap_access.c: pcap:// access, replays captured MMTP/LLS udp flows
+ *****************************************************************************
+ *
+ * reads a libpcap capture file and hands the udp payload of every datagram sent to
+ * --pcap-dst (ip:port, ip, or :port) to the demuxer, one block per datagram, as the udp
+ * access would have received it. with --pcap-ip-headers the whole ipv4 packet is handed
+ * on instead, for --mmtp-ip-input. without --pcap-dst every udp datagram is let through.
+ *
+ * pacing:
+ *  --pcap-realtime (default): datagrams are released at the offsets they were captured at
+ *  --no-pcap-realtime: as fast as the demuxer reads, for throughput benchmarks. the access
+ *    then reports STREAM_CAN_CONTROL_PACE, so the demuxer reads it on its own thread and never
+ *    drops a datagram. blocks are still stamped with their capture offset and the demuxer runs
+ *    its pcr on those stamps, so its clock recovery sees the original arrival jitter.
+ *
+ * e.g.
+ *  vlc --demux=mmtp --pcap-dst=239.255.10.2:51002 pcap:///tmp/2018-12-17-mmt-airwavz.pcap
+ *  vlc --demux=mmtp --mmtp-ip-input --pcap-ip-headers pcap:///tmp/plp0.pcap
+ *
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <errno.h>
+
+#include <vlc_common.h>
+#include <vlc_access.h>
+#include <vlc_block.h>
+#include <vlc_fs.h>
+#include <vlc_interrupt.h>
+
+#include "atsc3_pcap_reader.h"
+#include "atsc3_udp_flow.h"
+#include "mmtp_pcap_access.h"
+
+typedef struct
+{
+    atsc3_pcap_reader_t reader;
+
+    uint32_t    i_dst_ip_addr;      /* 0 for any */
+    uint16_t    i_dst_port;         /* 0 for any */
+    bool        b_ip_headers;
+    bool        b_realtime;
+
+    /* capture time of the first record, and the clock it was released at */
+    int64_t     i_first_timestamp_us;
+    vlc_tick_t  i_first_tick;
+    bool        b_started;
+
+    uint64_t    i_datagrams;
+    uint64_t    i_skipped;
+} access_sys_t;
+
+static block_t *BlockPcap( stream_t *, bool * );
+static int Control( stream_t *, int, va_list );
+
+/* ip:port, ip or :port, each part left 0 to match anything */
+static int ParseDst( stream_t *p_access, const char *psz_dst,
+                     uint32_t *pi_ip_addr, uint16_t *pi_port )
+{
+    *pi_ip_addr = 0;
+    *pi_port = 0;
+    if( psz_dst == NULL || *psz_dst == '\0' )
+        return VLC_SUCCESS;
+
+    char *psz_ip = strdup( psz_dst );
+    if( unlikely(psz_ip == NULL) )
+        return VLC_ENOMEM;
+
+    int i_ret = VLC_SUCCESS;
+    char *psz_port = strchr( psz_ip, ':' );
+    if( psz_port != NULL )
+    {
+        *psz_port++ = '\0';
+        char *psz_end;
+        unsigned long i_port = strtoul( psz_port, &psz_end, 10 );
+        if( *psz_port == '\0' || *psz_end != '\0' || i_port == 0 || i_port > UINT16_MAX )
+            i_ret = VLC_EGENERIC;
+        else
+            *pi_port = i_port;
+    }
+    if( i_ret == VLC_SUCCESS && *psz_ip != '\0' &&
+        udp_flow_parse_ip_addr( psz_ip, pi_ip_addr ) )
+        i_ret = VLC_EGENERIC;
+
+    if( i_ret != VLC_SUCCESS )
+        msg_Err( p_access, "pcap-dst: cannot parse %s, expected ip:port, ip or :port", psz_dst );
+    free( psz_ip );
+    return i_ret;
+}
+
+/*****************************************************************************
+ * OpenPcapAccess: open the capture, read its global header
+ *****************************************************************************/
+int OpenPcapAccess( vlc_object_t *p_this )
+{
+    stream_t     *p_access = (stream_t*)p_this;
+    access_sys_t *sys;
+
+    if( p_access->b_preparsing || p_access->psz_filepath == NULL )
+        return VLC_EGENERIC;
+
+    sys = vlc_obj_calloc( p_this, 1, sizeof( *sys ) );
+    if( unlikely( sys == NULL ) )
+        return VLC_ENOMEM;
+
+    char *psz_dst = var_InheritString( p_access, "pcap-dst" );
+    int i_ret = ParseDst( p_access, psz_dst, &sys->i_dst_ip_addr, &sys->i_dst_port );
+    free( psz_dst );
+    if( i_ret != VLC_SUCCESS )
+        return i_ret;
+
+    sys->b_ip_headers = var_InheritBool( p_access, "pcap-ip-headers" );
+    sys->b_realtime = var_InheritBool( p_access, "pcap-realtime" );
+
+    FILE *fp = vlc_fopen( p_access->psz_filepath, "rb" );
+    if( fp == NULL )
+    {
+        msg_Err( p_access, "cannot open %s: %s", p_access->psz_filepath, vlc_strerror_c( errno ) );
+        return VLC_EGENERIC;
+    }
+    if( atsc3_pcap_reader_open( &sys->reader, fp ) )
+    {
+        msg_Err( p_access, "%s is not a libpcap capture (pcapng captures need converting, e.g. editcap -F pcap)",
+                 p_access->psz_filepath );
+        fclose( fp );
+        return VLC_EGENERIC;
+    }
+
+    msg_Dbg( p_access, "replaying %s, linktype: %"PRIu32", %s, dst %08"PRIx32":%"PRIu16,
+             p_access->psz_filepath, sys->reader.linktype,
+             sys->b_realtime ? "capture pacing" : "as fast as possible",
+             sys->i_dst_ip_addr, sys->i_dst_port );
+
+    p_access->p_sys = sys;
+    ACCESS_SET_CALLBACKS( NULL, BlockPcap, Control, NULL );
+    return VLC_SUCCESS;
+}
+
+/*****************************************************************************
+ * ClosePcapAccess:
+ *****************************************************************************/
+void ClosePcapAccess( vlc_object_t *p_this )
+{
+    stream_t     *p_access = (stream_t*)p_this;
+    access_sys_t *sys = p_access->p_sys;
+
+    msg_Dbg( p_access, "replayed %"PRIu64" datagrams, skipped %"PRIu64" of %"PRIu64" records (%"PRIu64" cut short by the capture snaplen)",
+             sys->i_datagrams, sys->i_skipped, sys->reader.stats.records, sys->reader.stats.records_truncated );
+    atsc3_pcap_reader_close( &sys->reader );
+}
+
+/*****************************************************************************
+ * Control:
+ *****************************************************************************/
+static int Control( stream_t *p_access, int i_query, va_list args )
+{
+    access_sys_t *sys = p_access->p_sys;
+    bool    *pb_bool;
+
+    switch( i_query )
+    {
+        case STREAM_CAN_SEEK:
+        case STREAM_CAN_FASTSEEK:
+        case STREAM_CAN_PAUSE:
+            pb_bool = va_arg( args, bool * );
+            *pb_bool = false;
+            break;
+
+        /* at capture pacing we are as live as the udp access */
+        case STREAM_CAN_CONTROL_PACE:
+            pb_bool = va_arg( args, bool * );
+            *pb_bool = !sys->b_realtime;
+            break;
+
+        case STREAM_GET_PTS_DELAY:
+            *va_arg( args, vlc_tick_t * ) =
+                VLC_TICK_FROM_MS(var_InheritInteger(p_access, "network-caching"));
+            break;
+
+        default:
+            return VLC_EGENERIC;
+    }
+    return VLC_SUCCESS;
+}
+
+/* the clock the record is due at: the first one now, the rest at their capture offset from it */
+static vlc_tick_t RecordTick( access_sys_t *sys, int64_t i_timestamp_us )
+{
+    if( !sys->b_started )
+    {
+        sys->b_started = true;
+        sys->i_first_timestamp_us = i_timestamp_us;
+        sys->i_first_tick = vlc_tick_now();
+    }
+
+    /* captures merged from several interfaces may step back a little */
+    int64_t i_offset_us = i_timestamp_us - sys->i_first_timestamp_us;
+    if( i_offset_us < 0 )
+        i_offset_us = 0;
+    return sys->i_first_tick + VLC_TICK_FROM_US(i_offset_us);
+}
+
+/*****************************************************************************
+ * BlockPcap: the next datagram of the flow
+ *****************************************************************************/
+static block_t *BlockPcap( stream_t *p_access, bool *restrict eof )
+{
+    access_sys_t *sys = p_access->p_sys;
+    atsc3_pcap_record_t record;
+
+    for( int i_skipped = 0; i_skipped < MMTP_PCAP_ACCESS_MAX_SKIPPED; i_skipped++ )
+    {
+        int i_ret = atsc3_pcap_reader_next( &sys->reader, &record );
+        if( i_ret )
+        {
+            if( i_ret < 0 )
+                msg_Err( p_access, "damaged capture after %"PRIu64" records, stopping", sys->reader.stats.records );
+            *eof = true;
+            return NULL;
+        }
+
+        uint8_t *p_ipv4, *p_payload;
+        size_t i_ipv4, i_payload;
+        udp_flow_t udp_flow;
+        if( atsc3_pcap_link_to_ipv4( sys->reader.linktype, record.data, record.length, &p_ipv4, &i_ipv4 ) ||
+            udp_flow_parse_ipv4( p_ipv4, i_ipv4, &udp_flow, &p_payload, &i_payload ) ||
+            ( sys->i_dst_ip_addr && udp_flow.dst_ip_addr != sys->i_dst_ip_addr ) ||
+            ( sys->i_dst_port && udp_flow.dst_port != sys->i_dst_port ) )
+        {
+            sys->i_skipped++;
+            continue;
+        }
+
+        vlc_tick_t i_tick = RecordTick( sys, record.timestamp_us );
+        if( sys->b_realtime && vlc_mwait_i11e( i_tick ) )
+        {
+            /* interrupted, the datagram is lost like it would be on a closed socket */
+            return NULL;
+        }
+
+        const uint8_t *p_data = sys->b_ip_headers ? p_ipv4 : p_payload;
+        size_t i_data = sys->b_ip_headers ? i_ipv4 : i_payload;
+        block_t *p_block = block_Alloc( i_data );
+        if( unlikely(p_block == NULL) )
+            return NULL;
+        memcpy( p_block->p_buffer, p_data, i_data );
+        p_block->i_dts = i_tick;
+
+        sys->i_datagrams++;
+        return p_block;
+    }
+    return NULL;
+}
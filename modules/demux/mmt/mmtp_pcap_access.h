@@ -0,0 +1,20 @@
+/*
+ * mmtp_pcap_access.h
+ *
+ *  Created on: Feb 20, 2019
+ *      Author: jjustman
+ *
+ * pcap:// access, replays a libpcap capture as the udp datagrams of one flow (or all of them with
+ * their ip headers for mmtp-ip-input), either at the pace they were captured or as fast as they are read
+ */
+
+#ifndef MODULES_DEMUX_MMT_MMTP_PCAP_ACCESS_H_
+#define MODULES_DEMUX_MMT_MMTP_PCAP_ACCESS_H_
+
+//records skipped in one block call before the input thread gets a chance to check for interruption
+#define MMTP_PCAP_ACCESS_MAX_SKIPPED 4096
+
+int  OpenPcapAccess ( vlc_object_t * );
+void ClosePcapAccess( vlc_object_t * );
+
+#endif /* MODULES_DEMUX_MMT_MMTP_PCAP_ACCESS_H_ */
@@ -8,12 +8,29 @@
 #ifndef MODULES_DEMUX_MMT_VLC_LIBATSC3_TYPES_H_
 #define MODULES_DEMUX_MMT_VLC_LIBATSC3_TYPES_H_
 
+#include "atsc3_mmtp_mfu_sample_emitter.h"
+#include "atsc3_mmtp_reorder_window.h"
+#include "atsc3_udp_flow.h"
+#include "atsc3_lls_table_manager.h"
+#include "atsc3_spsc_ring.h"
+#include "atsc3_mmtp_mpu_metadata_cache.h"
+#include "atsc3_mmtp_al_fec.h"
+#include "atsc3_mmtp_object_cache.h"
+
 #ifndef LIBATSC3_MPU_ISOBMFF_FRAGMENT_PARAMETERS_T_
 #define LIBATSC3_MPU_ISOBMFF_FRAGMENT_PARAMETERS_T_
 
 typedef struct {
 	mp4_track_t*	mpu_demux_track;
 	block_t*		p_mpu_block;
+	mfu_sample_emitter_t	mfu_sample_emitter;		//per access unit emission driven by the moof trun
+	mmtp_reorder_window_t	mmtp_reorder_window;	//puts this packet_id's packets back in packet_sequence_number order
+	struct mmtp_service*	mmtp_service;			//owning service for mmtp-ip-input, NULL for a single udp stream
+	uint32_t		i_asset_type;			//MPT asset_type fourcc, 0 until signaled
+	uint32_t		i_asset_timescale;		//MPT asset_timescale, 0 if not signaled
+	es_out_id_t*	p_signaled_es;			//created from the MPT ahead of the mpu metadata, handed to the first track
+	bool			b_mpu_metadata_from_cache;	//tracks were built from the mpu metadata cache, until the first live mpu metadata
+	bool			b_wait_rap;				//joined mid-MPU from the cache, MFUs are dropped until a random access point
 	uint32_t     	i_timescale;          /* movie time scale */
 	uint64_t     	i_moov_duration;
 	uint64_t     	i_cumulated_duration; /* Same as above, but not from probing, (movie time scale) */
@@ -33,8 +50,7 @@ typedef struct {
 	MP4_Box_t*		mpu_fragments_p_root_box;
 	MP4_Box_t*		mpu_fragments_p_moov;
 
-	//reconstitue per movie fragment as needed
-	block_t* 		mp4_movie_fragment_block_t;
+	//reconstitue per movie fragment as needed, only set while its packet is processed
 	MP4_Box_t*		mpu_fragments_p_moof;
 
 
@@ -49,13 +65,68 @@ typedef struct {
 
 #endif
 
+#include <vlc_atomic.h>
+#include "atsc3_mmtp_types.h"
+#include "atsc3_mmt_signaling_message.h"
+
+/**
+ * PCR for one es_out group, driven from the sender's clock recovered out of the mmtp_timestamp of every packet.
+ * i_lag grows whenever a sample leaves the demuxer behind the PCR already sent (e.g. an MPU held until its
+ * movie fragment arrives), so the PCR settles just behind what is actually sent
+ */
+typedef struct mmtp_pcr_clock {
+	mmtp_clock_recovery_t	mmtp_clock_recovery;
+	uint64_t				discontinuities;	//mmtp_clock_recovery.stats.discontinuities already acted on
+
+	bool					has_set_first_pcr;
+	vlc_tick_t				i_pcr;
+	vlc_tick_t				i_next_pcr_update;
+	vlc_tick_t				i_lag;
+	vlc_tick_t				i_hrbm_delay;		//HRBM fixed_end_to_end_delay in place of mmtp-pcr-delay, 0 until signaled
+} mmtp_pcr_clock_t;
+
+/**
+ * MMT signaling of one service: the message being put back together from fragments and the last HRBM,
+ * and the reorder hold it sets (mmtp-hrbm), 0 until signaled
+ */
+typedef struct mmtp_signaling {
+	mmt_signaling_message_reassembly_t	reassembly;
+
+	bool					has_hrbm;
+	hrbm_message_t			hrbm_message;
+	vlc_tick_t				i_hrbm_reorder_hold;
+} mmtp_signaling_t;
+
+/**
+ * one MMTP service of a full PLP input (mmtp-ip-input), found through the SLT by its destination ip:port.
+ * each service demuxes into its own sub_flows and es_out group (program), keyed by service_id
+ */
+/**
+ * an object streamed out of the object cache, chained as it arrives and gathered once complete
+ */
+typedef struct mmtp_object_buffer {
+	bool				b_in_use;
+	bool				b_overflow;		//past MMTP_OBJECT_MAX_SIZE, dropped on completion
+	mmtp_object_key_t	key;
+	block_t*			p_chain;
+	block_t**			pp_chain_last;
+	size_t				i_size;
+} mmtp_object_buffer_t;
+
+typedef struct mmtp_service {
+	uint16_t				service_id;
+	int						i_group;
+	mmtp_sub_flow_vector_t	mmtp_sub_flow_vector;
+
+	mmtp_pcr_clock_t		pcr_clock;
+	mmtp_signaling_t		signaling;
+	mmtp_al_fec_decoder_t	al_fec;
+	char*					psz_cache_scope;	//destination ip:port, keys this service in the mpu metadata cache
+} mmtp_service_t;
 
 typedef struct
 {
 	vlc_object_t *obj;
-	//hack for cross-parsing
-	uint8_t *raw_buf;
-	uint8_t *buf;
 
 	//reconsititue mfu's into a p_out_muxed fifo
 
@@ -122,48 +193,200 @@ typedef struct
 
     mmtp_sub_flow_vector_t mmtp_sub_flow_vector;
 
+    //per-packet wrappers for zero-copy data unit views, recycled instead of malloc/free per datagram
+    atsc3_slab_pool_t mmtp_raw_packet_ref_pool;
+    atsc3_slab_pool_t mmtp_block_view_pool;
+    atsc3_slab_pool_t mmtp_reorder_packet_pool;
+
+    uint32_t i_reorder_packets;			//mmtp-reorder-packets, 0 disables reordering
+    vlc_tick_t i_reorder_hold;			//mmtp-reorder-ms
+    size_t i_max_buffered_bytes;		//mmtp-max-buffered-bytes
+    bool b_hrbm;						//mmtp-hrbm: the HRBM message sizes buffers, reorder hold and pcr delay
+    bool b_emit_corrupt_samples;		//mmtp-emit-corrupt-samples: partial samples are flagged instead of dropped
+
+    bool b_ip_input;					//mmtp-ip-input: datagrams carry ipv4/udp headers, demux every MMTP service in the SLT
+    udp_flow_service_map_t udp_flow_service_map;
+    lls_table_manager_t lls_table_manager;		//LLS tables are only parsed when their version changes
+    mmtp_service_t **pp_services;
+    int i_services;
+    uint64_t i_unmatched_datagrams;		//ip input on a flow no SLT service is delivered on
+
+    //mmtp-receive-ring: datagrams are read on receive_thread and handed to Demux through receive_ring
+    bool b_can_control_pace;			//STREAM_CAN_CONTROL_PACE, no receive thread: a full ring would drop what a paced read never loses
+    vlc_tick_t i_last_arrival;			//of the last datagram read, the pcr clock of a paced input
+    bool b_receive_thread;
+    vlc_thread_t receive_thread;
+    atsc3_spsc_ring_t receive_ring;
+    vlc_sem_t receive_sem;
+    atomic_bool b_receive_waiting;		//Demux is, or is about to be, asleep on receive_sem
+    atomic_bool b_receive_eof;
+    bool b_receive_timer;				//receive_timer wakes Demux to expire reorder gaps
+    vlc_timer_t receive_timer;
+
+    //STREAM_GET_RECV_DROPS, polled by whichever thread reads the stream
+    vlc_tick_t i_recv_drops_next_poll;
+    atomic_uint_least64_t i_recv_drops;
+
     bool has_set_ntp_to_pts_offset;
     uint64_t ntp_to_pts_offset_us;
 
-    bool has_set_first_pcr;
-    uint64_t first_pcr;
+    mmtp_pcr_clock_t pcr_clock;		//single stream input, services carry their own
+    vlc_tick_t i_pcr_delay;				//mmtp-pcr-delay
+    mmtp_signaling_t signaling;			//single stream input, services carry their own
+    bool b_al_fec;						//mmtp-al-fec: the repair code is not checked against an AL_FEC message
+    mmtp_al_fec_decoder_t al_fec;		//single stream input, services carry their own
+
+    //mmtp-mpu-metadata-cache: last mpu metadata per asset, psz_mpu_metadata_cache_path is NULL when disabled
+    mpu_metadata_cache_t mpu_metadata_cache;
+    char *psz_mpu_metadata_cache_path;
+    char *psz_cache_scope;				//single stream input (its location), services carry their own
+
+    //mmtp-objects: non-timed items and generic objects, the last completed ones are kept as attachments
+    bool b_objects;
+    mmtp_object_cache_t object_cache;
+    mmtp_object_buffer_t object_buffers[MMTP_OBJECT_CACHE_MAX_IN_FLIGHT];
+    input_attachment_t **pp_object_attachments;
+    int i_object_attachments;
+    unsigned i_updates;					//INPUT_UPDATE_META once the attachments changed, DEMUX_TEST_AND_CLEAR_FLAGS
+
+    bool b_low_latency;	//mmtp-low-latency: per-sample output and PCR
+
+    //mmtp-stats-interval: flow stats are published to the input item info, 0 disables it
+    vlc_tick_t i_stats_interval;
+    vlc_tick_t i_stats_next_publish;
+
+    atsc3_trace_sink_t trace_sink;		//libatsc3 lines to this demuxer's log, at mmtp-trace-level
+
+    //mmtp-trace-events: per-packet event ring, written and dumped on the Demux thread
+    atsc3_trace_ring_t trace_ring;
+    uint_fast32_t i_trace_dump_key;		//mmtp-trace-dump-key, KEY_UNSET if none
+    atomic_bool b_trace_dump;			//set by the hotkey, the ring is dumped on the next Demux call
 
     bool has_set_first_pts;
     uint64_t first_pts;
     uint64_t last_pts;
 } demux_sys_t;
 
+/**
+ * private demux control, a snapshot of every flow's counters:
+ *
+ * 	arg1= mmtp_flow_stats_entry_t **, arg2= size_t *	res= can fail, the array is the caller's to free()
+ *
+ * like every control it must be called from the thread running Demux
+ */
+#define DEMUX_GET_MMTP_FLOW_STATS	0x4D4D5400
+
+/**
+ * private demux control, writes the mmtp-trace-events ring to the user cache directory:
+ *
+ * 	no args		res= fails if mmtp-trace-events is disabled
+ */
+#define DEMUX_MMTP_DUMP_TRACE_EVENTS	0x4D4D5401
 
-int mmtp_packet_header_parse_from_raw_packet(mmtp_payload_fragments_union_t *mmtp_packet, demux_t *p_demux ) {
+typedef struct mmtp_flow_stats_entry {
+	uint16_t			service_id;		//0 for single stream input
+	uint16_t			mmtp_packet_id;
+	mmtp_flow_stats_t	flow_stats;
+} mmtp_flow_stats_entry_t;
+
+
+/**
+ * zero-copy data unit payloads
+ *
+ * the received udp datagram is shared by every data unit parsed out of it (its i_dts is the
+ * arrival time, from the access or stamped on read): each data unit
+ * is handed to processMpuPacket as a block_t view whose p_buffer points into the datagram,
+ * and the datagram is released once the last view referencing it is released.
+ *
+ * refs and views are carved from demux_sys_t slab pools, so they must be released on the demux thread
+ * (es_out only ever receives block_Duplicate'd copies).
+ */
 
-	demux_sys_t *p_sys = p_demux->p_sys;
+#define MMTP_BLOCK_VIEW_POOL_OBJECTS_PER_SLAB 1024
 
-	//hack for joint parsing.....
-	p_sys->raw_buf = malloc( MAX_MMTP_SIZE );
-	p_sys->buf = p_sys->raw_buf; //use buf to walk thru bytes in extract method without touching rawBuf
+typedef struct mmtp_raw_packet_ref {
+	block_t*			p_block;
+	atomic_uint			i_refs;
+	atsc3_slab_pool_t*	pool;
+} mmtp_raw_packet_ref_t;
 
-	uint8_t *raw_buf = p_sys->raw_buf;
-	uint8_t *buf = p_sys->buf;
+typedef struct mmtp_block_view {
+	block_t					self;
+	mmtp_raw_packet_ref_t*	raw_packet_ref;
+	atsc3_slab_pool_t*		pool;
+} mmtp_block_view_t;
 
-	block_ChainExtract(mmtp_packet->mmtp_packet_header.raw_packet, raw_buf, MAX_MMTP_SIZE);
+/**
+ * an mpu mode packet waiting in its sub_flow's reorder window: the parsed mmtp/mpu header and the
+ * cursor positioned at its first data unit, holding a reference on the datagram
+ */
+typedef struct mmtp_reorder_packet {
+	mmtp_sub_flow_t*					mmtp_sub_flow;
+	mmtp_payload_fragments_union_t*		mmtp_packet_header;
+	mmtp_raw_packet_ref_t*				mmtp_raw_packet_ref;
+	atsc3_cursor_t						cursor;
+} mmtp_reorder_packet_t;
+
+static inline void mmtp_block_view_pools_init(demux_sys_t* p_sys) {
+	atsc3_slab_pool_init(&p_sys->mmtp_raw_packet_ref_pool, "mmtp_raw_packet_ref", sizeof(mmtp_raw_packet_ref_t), MMTP_BLOCK_VIEW_POOL_OBJECTS_PER_SLAB);
+	atsc3_slab_pool_init(&p_sys->mmtp_block_view_pool, "mmtp_block_view", sizeof(mmtp_block_view_t), MMTP_BLOCK_VIEW_POOL_OBJECTS_PER_SLAB);
+	atsc3_slab_pool_init(&p_sys->mmtp_reorder_packet_pool, "mmtp_reorder_packet", sizeof(mmtp_reorder_packet_t), MMTP_BLOCK_VIEW_POOL_OBJECTS_PER_SLAB);
+}
 
-	//	block_ChainExtract(mmtp_packet->mmtp_packet_header.raw_packet, raw_buf, MAX_MMTP_SIZE);
+//every view must have been released, e.g. after mmtp_sub_flow_vector_free
+static inline void mmtp_block_view_pools_destroy(demux_sys_t* p_sys) {
+	atsc3_slab_pool_stats_dump(&p_sys->mmtp_block_view_pool);
+	atsc3_slab_pool_destroy(&p_sys->mmtp_reorder_packet_pool);
+	atsc3_slab_pool_destroy(&p_sys->mmtp_block_view_pool);
+	atsc3_slab_pool_destroy(&p_sys->mmtp_raw_packet_ref_pool);
+}
 
+static inline mmtp_raw_packet_ref_t* mmtp_raw_packet_ref_new(atsc3_slab_pool_t* pool, block_t* p_block) {
+	mmtp_raw_packet_ref_t* raw_packet_ref = atsc3_slab_pool_alloc(pool);
+	if(!raw_packet_ref) {
+		return NULL;
+	}
 
+	raw_packet_ref->p_block = p_block;
+	raw_packet_ref->pool = pool;
+	atomic_init(&raw_packet_ref->i_refs, 1);
 
-	...
+	return raw_packet_ref;
+}
 
-	p_sys->raw_buf = raw_buf;
-	p_sys->buf =  buf;
+static inline void mmtp_raw_packet_ref_release(mmtp_raw_packet_ref_t* raw_packet_ref) {
+	if(atomic_fetch_sub_explicit(&raw_packet_ref->i_refs, 1, memory_order_acq_rel) == 1) {
+		block_Release(raw_packet_ref->p_block);
+		atsc3_slab_pool_free(raw_packet_ref->pool, raw_packet_ref);
+	}
+}
 
-	return VLC_DEMUXER_SUCCESS;
+static void mmtp_block_view_release(block_t* p_block) {
+	mmtp_block_view_t* view = container_of(p_block, mmtp_block_view_t, self);
 
-error:
+	mmtp_raw_packet_ref_release(view->raw_packet_ref);
+	atsc3_slab_pool_free(view->pool, view);
+}
 
-	return VLC_DEMUXER_EGENERIC;
+static const struct vlc_block_callbacks mmtp_block_view_cbs = {
+	mmtp_block_view_release,
+};
 
+/**
+ * wrap [p_payload, p_payload+i_payload) of the raw datagram as a block_t without copying,
+ * the returned block holds a reference on the datagram until block_Release
+ */
+static inline block_t* mmtp_block_view_new(atsc3_slab_pool_t* pool, mmtp_raw_packet_ref_t* raw_packet_ref, uint8_t* p_payload, size_t i_payload) {
+	mmtp_block_view_t* view = atsc3_slab_pool_alloc(pool);
+	if(!view) {
+		return NULL;
+	}
 
+	atomic_fetch_add_explicit(&raw_packet_ref->i_refs, 1, memory_order_relaxed);
+	view->raw_packet_ref = raw_packet_ref;
+	view->pool = pool;
 
+	return block_Init(&view->self, &mmtp_block_view_cbs, p_payload, i_payload);
 }
 
 